@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -23,6 +24,7 @@
 
 #if WLR_HAS_DRM_BACKEND
 #include <wlr/backend/drm.h>
+#include "backend/drm/drm.h"
 #include "backend/drm/monitor.h"
 #endif
 
@@ -223,15 +225,30 @@ static struct wlr_backend *attempt_headless_backend(struct wl_event_loop *loop)
 	}
 
 	size_t outputs = parse_outputs_env("WLR_HEADLESS_OUTPUTS");
+	bool unthrottled = env_parse_bool("WLR_HEADLESS_UNTHROTTLED");
 	for (size_t i = 0; i < outputs; ++i) {
-		wlr_headless_add_output(backend, 1280, 720);
+		struct wlr_output *output = wlr_headless_add_output(backend, 1280, 720);
+		if (output != NULL) {
+			wlr_headless_output_set_unthrottled(output, unthrottled);
+		}
 	}
 
 	return backend;
 }
 
-static struct wlr_backend *attempt_drm_backend(struct wlr_backend *backend, struct wlr_session *session) {
+// Time spent creating the DRM and libinput backends, logged on startup
+struct startup_timings {
+	int64_t session_msec;
+	int64_t libinput_msec;
+	int64_t find_gpus_msec;
+	int64_t drm_msec;
+};
+
+static struct wlr_backend *attempt_drm_backend(struct wlr_backend *backend,
+		struct wlr_session *session, struct startup_timings *timings) {
 #if WLR_HAS_DRM_BACKEND
+	int64_t start = get_current_time_msec();
+
 	struct wlr_device *gpus[8];
 	ssize_t num_gpus = wlr_session_find_gpus(session, 8, gpus);
 	if (num_gpus < 0) {
@@ -246,20 +263,26 @@ static struct wlr_backend *attempt_drm_backend(struct wlr_backend *backend, stru
 		wlr_log(WLR_INFO, "Found %zu GPUs", num_gpus);
 	}
 
-	struct wlr_backend *primary_drm = NULL;
+	int64_t gpus_found = get_current_time_msec();
+	if (timings != NULL) {
+		timings->find_gpus_msec = gpus_found - start;
+	}
+
+	struct wlr_backend *drms[8] = {0};
+	struct wlr_backend *primary_drm = create_drm_backends(session,
+		gpus, (size_t)num_gpus, drms);
 	for (size_t i = 0; i < (size_t)num_gpus; ++i) {
-		struct wlr_backend *drm = wlr_drm_backend_create(session, gpus[i], primary_drm);
-		if (!drm) {
+		if (drms[i] == NULL) {
 			wlr_log(WLR_ERROR, "Failed to create DRM backend");
 			continue;
 		}
+		wlr_multi_backend_add(backend, drms[i]);
+	}
 
-		if (!primary_drm) {
-			primary_drm = drm;
-		}
-
-		wlr_multi_backend_add(backend, drm);
+	if (timings != NULL) {
+		timings->drm_msec = get_current_time_msec() - gpus_found;
 	}
+
 	if (!primary_drm) {
 		wlr_log(WLR_ERROR, "Could not successfully create backend on any GPU");
 		return NULL;
@@ -309,7 +332,7 @@ static bool attempt_backend_by_name(struct wl_event_loop *loop,
 			backend = attempt_libinput_backend(*session_ptr);
 		} else {
 			// attempt_drm_backend() adds the multi drm backends itself
-			return attempt_drm_backend(multi, *session_ptr) != NULL;
+			return attempt_drm_backend(multi, *session_ptr, NULL) != NULL;
 		}
 	} else {
 		wlr_log(WLR_ERROR, "unrecognized backend '%s'", name);
@@ -392,12 +415,18 @@ struct wlr_backend *wlr_backend_autocreate(struct wl_event_loop *loop,
 	}
 
 	// Attempt DRM+libinput
+	struct startup_timings timings = {0};
+	int64_t start = get_current_time_msec();
+
 	session = session_create_and_wait(loop);
 	if (!session) {
 		wlr_log(WLR_ERROR, "Failed to start a DRM session");
 		goto error;
 	}
 
+	int64_t session_created = get_current_time_msec();
+	timings.session_msec = session_created - start;
+
 	struct wlr_backend *libinput = attempt_libinput_backend(session);
 	if (libinput) {
 		wlr_multi_backend_add(multi, libinput);
@@ -413,7 +442,9 @@ struct wlr_backend *wlr_backend_autocreate(struct wl_event_loop *loop,
 		goto error;
 	}
 
-	struct wlr_backend *primary_drm = attempt_drm_backend(multi, session);
+	timings.libinput_msec = get_current_time_msec() - session_created;
+
+	struct wlr_backend *primary_drm = attempt_drm_backend(multi, session, &timings);
 	if (primary_drm == NULL) {
 		wlr_log(WLR_ERROR, "Failed to open any DRM device");
 		goto error;
@@ -423,6 +454,11 @@ struct wlr_backend *wlr_backend_autocreate(struct wl_event_loop *loop,
 		goto error;
 	}
 
+	wlr_log(WLR_INFO, "Backends created in %"PRId64" ms (session: %"PRId64" ms, "
+		"libinput: %"PRId64" ms, GPU enumeration: %"PRId64" ms, DRM: %"PRId64" ms)",
+		get_current_time_msec() - start, timings.session_msec,
+		timings.libinput_msec, timings.find_gpus_msec, timings.drm_msec);
+
 success:
 	if (session_ptr != NULL) {
 		*session_ptr = session;
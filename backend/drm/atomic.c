@@ -1,6 +1,7 @@
 #include <drm_fourcc.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <wlr/render/drm_syncobj.h>
 #include <wlr/util/box.h>
@@ -12,6 +13,7 @@
 #include "backend/drm/iface.h"
 #include "backend/drm/util.h"
 #include "types/wlr_output.h"
+#include "util/trace.h"
 
 static char *atomic_commit_flags_str(uint32_t flags) {
 	const char *const l[] = {
@@ -71,7 +73,9 @@ static bool atomic_commit(struct atomic *atom, struct wlr_drm_backend *drm,
 		return false;
 	}
 
+	trace_begin("drm_atomic_commit");
 	int ret = drmModeAtomicCommit(drm->fd, atom->req, flags, page_flip);
+	trace_end();
 	if (ret != 0) {
 		enum wlr_log_importance log_level = WLR_ERROR;
 		if (flags & DRM_MODE_ATOMIC_TEST_ONLY) {
@@ -112,7 +116,7 @@ static bool create_mode_blob(struct wlr_drm_connector *conn,
 		return true;
 	}
 
-	if (drmModeCreatePropertyBlob(conn->backend->fd, &state->mode,
+	if (!drm_blob_cache_acquire(conn->backend, &state->mode,
 			sizeof(drmModeModeInfo), blob_id)) {
 		wlr_log_errno(WLR_ERROR, "Unable to create mode property blob");
 		return false;
@@ -143,8 +147,8 @@ static bool create_gamma_lut_blob(struct wlr_drm_backend *drm,
 		gamma[i].blue = b[i];
 	}
 
-	if (drmModeCreatePropertyBlob(drm->fd, gamma,
-			size * sizeof(*gamma), blob_id) != 0) {
+	if (!drm_blob_cache_acquire(drm, gamma,
+			size * sizeof(*gamma), blob_id)) {
 		wlr_log_errno(WLR_ERROR, "Unable to create gamma LUT property blob");
 		free(gamma);
 		return false;
@@ -154,24 +158,63 @@ static bool create_gamma_lut_blob(struct wlr_drm_backend *drm,
 	return true;
 }
 
+// Damage clips are aligned to this many pixels, which matches the usual
+// selective update granularity of panels with PSR2
+#define DAMAGE_CLIPS_ALIGN 4
+// Above this many clips, the bounding box is sent instead
+#define DAMAGE_CLIPS_MAX 16
+
+static int align_down(int value, int align) {
+	return value / align * align;
+}
+
+static int align_up(int value, int align) {
+	return (value + align - 1) / align * align;
+}
+
 bool create_fb_damage_clips_blob(struct wlr_drm_backend *drm,
 		int width, int height, const pixman_region32_t *damage, uint32_t *blob_id) {
 	pixman_region32_t clipped;
 	pixman_region32_init(&clipped);
-	pixman_region32_intersect_rect(&clipped, damage, 0, 0, width, height);
+
+	// Aligning the rectangles lets pixman merge the neighbouring ones
+	int damage_rects_len;
+	const pixman_box32_t *damage_rects =
+		pixman_region32_rectangles(damage, &damage_rects_len);
+	for (int i = 0; i < damage_rects_len; i++) {
+		const pixman_box32_t *r = &damage_rects[i];
+		int x1 = align_down(r->x1, DAMAGE_CLIPS_ALIGN);
+		int y1 = align_down(r->y1, DAMAGE_CLIPS_ALIGN);
+		int x2 = align_up(r->x2, DAMAGE_CLIPS_ALIGN);
+		int y2 = align_up(r->y2, DAMAGE_CLIPS_ALIGN);
+		pixman_region32_union_rect(&clipped, &clipped, x1, y1, x2 - x1, y2 - y1);
+	}
+	pixman_region32_intersect_rect(&clipped, &clipped, 0, 0, width, height);
 
 	int rects_len;
 	const pixman_box32_t *rects = pixman_region32_rectangles(&clipped, &rects_len);
-
-	int ret;
+	pixman_box32_t extents;
+	if (rects_len > DAMAGE_CLIPS_MAX) {
+		extents = *pixman_region32_extents(&clipped);
+		rects = &extents;
+		rects_len = 1;
+	} else if (rects_len == 0 && width > 0 && height > 0) {
+		// Without any clip, the whole plane is considered damaged and panel
+		// self-refresh stops. The contents didn't change, so a tiny clip is
+		// enough.
+		extents = (pixman_box32_t){ .x1 = 0, .y1 = 0, .x2 = 1, .y2 = 1 };
+		rects = &extents;
+		rects_len = 1;
+	}
+
+	bool ok = true;
 	if (rects_len > 0) {
-		ret = drmModeCreatePropertyBlob(drm->fd, rects, sizeof(*rects) * rects_len, blob_id);
+		ok = drm_blob_cache_acquire(drm, rects, sizeof(*rects) * rects_len, blob_id);
 	} else {
-		ret = 0;
 		*blob_id = 0;
 	}
 	pixman_region32_fini(&clipped);
-	if (ret != 0) {
+	if (!ok) {
 		wlr_log_errno(WLR_ERROR, "Failed to create FB_DAMAGE_CLIPS property blob");
 		return false;
 	}
@@ -213,12 +256,12 @@ static uint64_t pick_max_bpc(struct wlr_drm_connector *conn, struct wlr_drm_fb *
 	return target_bpc;
 }
 
-static void destroy_blob(struct wlr_drm_backend *drm, uint32_t id) {
-	if (id == 0) {
-		return;
-	}
-	if (drmModeDestroyPropertyBlob(drm->fd, id) != 0) {
-		wlr_log_errno(WLR_ERROR, "Failed to destroy blob");
+// The CRTC already holds a reference to its current blob: if the new blob is
+// the same, drop the extra reference, so that a blob different from the
+// current one always holds its own reference
+static void dedup_blob(struct wlr_drm_backend *drm, uint32_t current, uint32_t next) {
+	if (current == next) {
+		drm_blob_cache_release(drm, next);
 	}
 }
 
@@ -227,7 +270,7 @@ static void commit_blob(struct wlr_drm_backend *drm,
 	if (*current == next) {
 		return;
 	}
-	destroy_blob(drm, *current);
+	drm_blob_cache_release(drm, *current);
 	*current = next;
 }
 
@@ -236,7 +279,7 @@ static void rollback_blob(struct wlr_drm_backend *drm,
 	if (*current == next) {
 		return;
 	}
-	destroy_blob(drm, next);
+	drm_blob_cache_release(drm, next);
 }
 
 bool drm_atomic_connector_prepare(struct wlr_drm_connector_state *state, bool modeset) {
@@ -250,6 +293,7 @@ bool drm_atomic_connector_prepare(struct wlr_drm_connector_state *state, bool mo
 		if (!create_mode_blob(conn, state, &mode_id)) {
 			return false;
 		}
+		dedup_blob(drm, crtc->mode_id, mode_id);
 	}
 
 	uint32_t gamma_lut = crtc->gamma_lut;
@@ -261,13 +305,16 @@ bool drm_atomic_connector_prepare(struct wlr_drm_connector_state *state, bool mo
 			if (!drm_legacy_crtc_set_gamma(drm, crtc,
 					state->base->gamma_lut_size,
 					state->base->gamma_lut)) {
+				rollback_blob(drm, &crtc->mode_id, mode_id);
 				return false;
 			}
 		} else {
 			if (!create_gamma_lut_blob(drm, state->base->gamma_lut_size,
 					state->base->gamma_lut, &gamma_lut)) {
+				rollback_blob(drm, &crtc->mode_id, mode_id);
 				return false;
 			}
+			dedup_blob(drm, crtc->gamma_lut, gamma_lut);
 		}
 	}
 
@@ -283,7 +330,7 @@ bool drm_atomic_connector_prepare(struct wlr_drm_connector_state *state, bool mo
 		in_fence_fd = wlr_drm_syncobj_timeline_export_sync_file(state->wait_timeline,
 			state->wait_point);
 		if (in_fence_fd < 0) {
-			return false;
+			goto error_blobs;
 		}
 	}
 
@@ -292,7 +339,10 @@ bool drm_atomic_connector_prepare(struct wlr_drm_connector_state *state, bool mo
 	bool vrr_enabled = prev_vrr_enabled;
 	if ((state->base->committed & WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED)) {
 		if (state->base->adaptive_sync_enabled && !output->adaptive_sync_supported) {
-			return false;
+			if (in_fence_fd >= 0) {
+				close(in_fence_fd);
+			}
+			goto error_blobs;
 		}
 		vrr_enabled = state->base->adaptive_sync_enabled;
 	}
@@ -303,6 +353,12 @@ bool drm_atomic_connector_prepare(struct wlr_drm_connector_state *state, bool mo
 	state->primary_in_fence_fd = in_fence_fd;
 	state->vrr_enabled = vrr_enabled;
 	return true;
+
+error_blobs:
+	rollback_blob(drm, &crtc->mode_id, mode_id);
+	rollback_blob(drm, &crtc->gamma_lut, gamma_lut);
+	drm_blob_cache_release(drm, fb_damage_clips);
+	return false;
 }
 
 void drm_atomic_connector_apply_commit(struct wlr_drm_connector_state *state) {
@@ -320,7 +376,7 @@ void drm_atomic_connector_apply_commit(struct wlr_drm_connector_state *state) {
 	conn->output.adaptive_sync_status = state->vrr_enabled ?
 		WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED : WLR_OUTPUT_ADAPTIVE_SYNC_DISABLED;
 
-	destroy_blob(drm, state->fb_damage_clips);
+	drm_blob_cache_release(drm, state->fb_damage_clips);
 	if (state->primary_in_fence_fd >= 0) {
 		close(state->primary_in_fence_fd);
 	}
@@ -340,7 +396,7 @@ void drm_atomic_connector_rollback_commit(struct wlr_drm_connector_state *state)
 	rollback_blob(drm, &crtc->mode_id, state->mode_id);
 	rollback_blob(drm, &crtc->gamma_lut, state->gamma_lut);
 
-	destroy_blob(drm, state->fb_damage_clips);
+	drm_blob_cache_release(drm, state->fb_damage_clips);
 	if (state->primary_in_fence_fd >= 0) {
 		close(state->primary_in_fence_fd);
 	}
@@ -423,7 +479,8 @@ static void atomic_connector_add(struct atomic *atom,
 		atomic_add(atom, conn->id, conn->props.link_status,
 			DRM_MODE_LINK_STATUS_GOOD);
 	}
-	if (active && conn->props.content_type != 0) {
+	// Some drivers require a modeset to change the content type
+	if (modeset && active && conn->props.content_type != 0) {
 		atomic_add(atom, conn->id, conn->props.content_type,
 			DRM_MODE_CONTENT_TYPE_GRAPHICS);
 	}
@@ -482,6 +539,110 @@ static void atomic_connector_add(struct atomic *atom,
 			plane_disable(atom, crtc->cursor);
 		}
 	}
+
+	if (active && state->writeback_conn != NULL) {
+		struct wlr_drm_writeback_connector *wb_conn = state->writeback_conn;
+		atomic_add(atom, wb_conn->id, wb_conn->props.crtc_id, crtc->id);
+		atomic_add(atom, wb_conn->id, wb_conn->props.writeback_fb_id,
+			state->writeback->fb->id);
+		atomic_add(atom, wb_conn->id, wb_conn->props.writeback_out_fence_ptr,
+			(uintptr_t)&state->writeback_out_fence_fd);
+	} else if (!active && crtc->writeback != NULL) {
+		struct wlr_drm_writeback_connector *wb_conn = crtc->writeback;
+		atomic_add(atom, wb_conn->id, wb_conn->props.crtc_id, 0);
+	}
+}
+
+static bool device_state_has_crtc(const struct wlr_drm_device_state *state,
+		const struct wlr_drm_crtc *crtc) {
+	for (size_t i = 0; i < state->connectors_len; i++) {
+		const struct wlr_drm_connector_state *conn_state = &state->connectors[i];
+		if (conn_state->active && conn_state->connector->crtc == crtc) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool device_state_has_connector(const struct wlr_drm_device_state *state,
+		const struct wlr_drm_connector *conn) {
+	for (size_t i = 0; i < state->connectors_len; i++) {
+		if (state->connectors[i].connector == conn) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void atomic_add_reset(struct atomic *atom, struct wlr_drm_backend *drm,
+		const struct wlr_drm_device_state *state) {
+	struct wlr_drm_connector *conn;
+	wl_list_for_each(conn, &drm->connectors, link) {
+		if (conn->lease == NULL && !device_state_has_connector(state, conn)) {
+			atomic_add(atom, conn->id, conn->props.crtc_id, 0);
+		}
+	}
+
+	struct wlr_drm_writeback_connector *wb_conn;
+	wl_list_for_each(wb_conn, &drm->writeback_connectors, link) {
+		if (wb_conn->crtc == NULL) {
+			atomic_add(atom, wb_conn->id, wb_conn->props.crtc_id, 0);
+		}
+	}
+
+	for (size_t i = 0; i < drm->num_planes; i++) {
+		struct wlr_drm_plane *plane = &drm->planes[i];
+
+		bool used = false;
+		for (size_t j = 0; j < drm->num_crtcs; j++) {
+			struct wlr_drm_crtc *crtc = &drm->crtcs[j];
+			if (plane != crtc->primary && plane != crtc->cursor) {
+				continue;
+			}
+			// Planes of enabled CRTCs are set up by atomic_connector_add()
+			used = crtc->lease != NULL || device_state_has_crtc(state, crtc);
+			break;
+		}
+		if (!used) {
+			plane_disable(atom, plane);
+		}
+	}
+
+	for (size_t i = 0; i < drm->num_crtcs; i++) {
+		struct wlr_drm_crtc *crtc = &drm->crtcs[i];
+		if (crtc->lease != NULL || device_state_has_crtc(state, crtc)) {
+			continue;
+		}
+		atomic_add(atom, crtc->id, crtc->props.mode_id, 0);
+		atomic_add(atom, crtc->id, crtc->props.active, 0);
+	}
+}
+
+static bool connector_state_keeps_inherited_mode(
+		const struct wlr_drm_connector_state *state) {
+	struct wlr_drm_connector *conn = state->connector;
+	struct wlr_output_mode *current_mode = conn->output.current_mode;
+	if (!conn->inherited_mode || !state->active || current_mode == NULL ||
+			state->primary_fb == NULL) {
+		return false;
+	}
+	struct wlr_drm_mode *mode = wl_container_of(current_mode, mode, wlr_mode);
+	return memcmp(&mode->drm_mode, &state->mode, sizeof(state->mode)) == 0;
+}
+
+/**
+ * Check whether a modeset can be skipped because all connectors keep the
+ * configuration left by the previous DRM master (e.g. the firmware). This
+ * avoids blanking the screens on startup.
+ */
+static bool device_state_keeps_inherited_modes(
+		const struct wlr_drm_device_state *state) {
+	for (size_t i = 0; i < state->connectors_len; i++) {
+		if (!connector_state_keeps_inherited_mode(&state->connectors[i])) {
+			return false;
+		}
+	}
+	return state->connectors_len > 0;
 }
 
 static bool atomic_device_commit(struct wlr_drm_backend *drm,
@@ -495,25 +656,86 @@ static bool atomic_device_commit(struct wlr_drm_backend *drm,
 		}
 	}
 
-	struct atomic atom;
-	atomic_begin(&atom);
-
-	for (size_t i = 0; i < state->connectors_len; i++) {
-		atomic_connector_add(&atom, &state->connectors[i], state->modeset);
+	// Writeback jobs aren't included in test-only commits: they go along
+	// with the next real commit
+	bool has_writeback = false, writeback_modeset = false;
+	if (!test_only) {
+		for (size_t i = 0; i < state->connectors_len; i++) {
+			bool needs_modeset = false;
+			if (drm_connector_prepare_writeback(&state->connectors[i], &needs_modeset)) {
+				has_writeback = true;
+				writeback_modeset |= needs_modeset;
+			}
+		}
 	}
 
 	if (test_only) {
 		flags |= DRM_MODE_ATOMIC_TEST_ONLY;
 	}
-	if (state->modeset) {
-		flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
-	}
 	if (!test_only && state->nonblock) {
 		flags |= DRM_MODE_ATOMIC_NONBLOCK;
 	}
 
-	ok = atomic_commit(&atom, drm, state, page_flip, flags);
-	atomic_finish(&atom);
+	// The mode blob is still replaced with our own: a blob with the same mode
+	// doesn't require a modeset
+	bool skip_modeset = !test_only && state->modeset &&
+		!(has_writeback && writeback_modeset) &&
+		device_state_keeps_inherited_modes(state);
+
+	while (true) {
+		bool modeset = state->modeset && !skip_modeset;
+
+		struct atomic atom;
+		atomic_begin(&atom);
+
+		for (size_t i = 0; i < state->connectors_len; i++) {
+			atomic_connector_add(&atom, &state->connectors[i], modeset);
+		}
+		if (state->reset) {
+			atomic_add_reset(&atom, drm, state);
+		}
+
+		uint32_t commit_flags = flags;
+		if (modeset) {
+			commit_flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+		}
+		if (has_writeback && writeback_modeset) {
+			// Routing a writeback connector to a CRTC is a modeset
+			commit_flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+		}
+
+		if (skip_modeset) {
+			// Check first, a real commit failure would be logged as an error
+			uint32_t test_flags = DRM_MODE_ATOMIC_TEST_ONLY |
+				(commit_flags & DRM_MODE_ATOMIC_ALLOW_MODESET);
+			if (!atomic_commit(&atom, drm, state, NULL, test_flags)) {
+				atomic_finish(&atom);
+				wlr_log(WLR_DEBUG, "Cannot keep the current mode, "
+					"performing a modeset");
+				skip_modeset = false;
+				continue;
+			}
+		}
+
+		ok = atomic_commit(&atom, drm, state, page_flip, commit_flags);
+		atomic_finish(&atom);
+
+		if (ok && skip_modeset) {
+			wlr_log(WLR_INFO, "Kept the current mode, skipped modeset");
+		}
+
+		if (ok || !has_writeback) {
+			break;
+		}
+
+		// Don't let a capture request break the output: the jobs fail
+		// and the frame is committed on its own
+		wlr_log(WLR_DEBUG, "Atomic commit with writeback failed, retrying without");
+		for (size_t i = 0; i < state->connectors_len; i++) {
+			state->connectors[i].writeback_conn = NULL;
+		}
+		has_writeback = false;
+	}
 
 out:
 	for (size_t i = 0; i < state->connectors_len; i++) {
@@ -523,6 +745,9 @@ out:
 		} else {
 			drm_atomic_connector_rollback_commit(conn_state);
 		}
+		if (!test_only) {
+			drm_connector_finish_writeback(conn_state, ok);
+		}
 	}
 	return ok;
 }
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <drm_fourcc.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -60,14 +61,18 @@ static void backend_destroy(struct wlr_backend *backend) {
 
 	finish_drm_resources(drm);
 
+	wlr_log(WLR_DEBUG, "FB cache: %zu hits, %zu misses, %zu evictions",
+		drm->fb_cache.hits, drm->fb_cache.misses, drm->fb_cache.evictions);
+	wlr_log(WLR_DEBUG, "Test cache: %zu hits", drm->test_cache.hits);
+
 	struct wlr_drm_fb *fb, *fb_tmp;
 	wl_list_for_each_safe(fb, fb_tmp, &drm->fbs, link) {
 		drm_fb_destroy(fb);
 	}
 
 	free(drm->name);
-	wlr_session_close_file(drm->session, drm->dev);
 	wl_event_source_remove(drm->drm_event);
+	wlr_session_close_file(drm->session, drm->dev);
 	free(drm);
 }
 
@@ -113,17 +118,11 @@ static void handle_session_active(struct wl_listener *listener, void *data) {
 	wlr_log(WLR_INFO, "DRM FD %s", session->active ? "resumed" : "paused");
 
 	if (!session->active) {
-		// Disconnect any active connectors so that the client will modeset and
-		// rerender when the session is activated again.
-		struct wlr_drm_connector *conn;
-		wl_list_for_each(conn, &drm->connectors, link) {
-			if (conn->status == DRM_MODE_CONNECTED) {
-				wlr_output_destroy(&conn->output);
-			}
-		}
+		// Outputs are kept, commits fail until the session is resumed
 		return;
 	}
 
+	restore_drm_device(drm);
 	scan_drm_connectors(drm, NULL);
 }
 
@@ -206,11 +205,9 @@ static bool init_mgpu_renderer(struct wlr_drm_backend *drm) {
 	return true;
 }
 
-struct wlr_backend *wlr_drm_backend_create(struct wlr_session *session,
-		struct wlr_device *dev, struct wlr_backend *parent) {
-	assert(session && dev);
-	assert(!parent || wlr_backend_is_drm(parent));
-
+// Sets up the parts of the backend which need to run on the main thread
+static struct wlr_drm_backend *drm_backend_alloc(struct wlr_session *session,
+		struct wlr_device *dev) {
 	char *name = drmGetDeviceNameFromFd2(dev->fd);
 	if (name == NULL) {
 		wlr_log_errno(WLR_ERROR, "drmGetDeviceNameFromFd2() failed");
@@ -229,6 +226,7 @@ struct wlr_backend *wlr_drm_backend_create(struct wlr_session *session,
 	struct wlr_drm_backend *drm = calloc(1, sizeof(*drm));
 	if (!drm) {
 		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(name);
 		return NULL;
 	}
 	wlr_backend_init(&drm->backend, &backend_impl);
@@ -237,29 +235,24 @@ struct wlr_backend *wlr_drm_backend_create(struct wlr_session *session,
 
 	drm->session = session;
 	wl_list_init(&drm->fbs);
+	wl_list_init(&drm->fb_cache.fbs);
+	wl_list_init(&drm->blob_cache.blobs);
 	wl_list_init(&drm->connectors);
+	wl_list_init(&drm->writeback_connectors);
 	wl_list_init(&drm->page_flips);
+	wl_list_init(&drm->parent_destroy.link);
 
 	drm->dev = dev;
 	drm->fd = dev->fd;
 	drm->name = name;
 
-	if (parent != NULL) {
-		drm->parent = get_drm_backend_from_backend(parent);
-
-		drm->parent_destroy.notify = handle_parent_destroy;
-		wl_signal_add(&parent->events.destroy, &drm->parent_destroy);
-	} else {
-		wl_list_init(&drm->parent_destroy.link);
-	}
-
 	drm->dev_change.notify = handle_dev_change;
 	wl_signal_add(&dev->events.change, &drm->dev_change);
 
 	drm->dev_remove.notify = handle_dev_remove;
 	wl_signal_add(&dev->events.remove, &drm->dev_remove);
 
-	drm->drm_event = wl_event_loop_add_fd(session->event_loop, drm->fd,
+	drm->drm_event = wl_event_loop_add_fd(session->priority_event_loop, drm->fd,
 		WL_EVENT_READABLE, handle_drm_event, drm);
 	if (!drm->drm_event) {
 		wlr_log(WLR_ERROR, "Failed to create DRM event source");
@@ -269,35 +262,157 @@ struct wlr_backend *wlr_drm_backend_create(struct wlr_session *session,
 	drm->session_active.notify = handle_session_active;
 	wl_signal_add(&session->events.active, &drm->session_active);
 
-	if (!check_drm_features(drm)) {
-		goto error_event;
-	}
-
-	if (!init_drm_resources(drm)) {
-		goto error_event;
-	}
-
-	if (drm->parent && !init_mgpu_renderer(drm)) {
-		goto error_mgpu_renderer;
-	}
+	return drm;
 
-	drm->session_destroy.notify = handle_session_destroy;
-	wl_signal_add(&session->events.destroy, &drm->session_destroy);
-
-	return &drm->backend;
+error_fd:
+	wl_list_remove(&drm->dev_remove.link);
+	wl_list_remove(&drm->dev_change.link);
+	wlr_session_close_file(drm->session, dev);
+	free(drm->name);
+	free(drm);
+	return NULL;
+}
 
-error_mgpu_renderer:
-	finish_drm_renderer(&drm->mgpu_renderer);
-	finish_drm_resources(drm);
-error_event:
+static void drm_backend_free(struct wlr_drm_backend *drm) {
 	wl_list_remove(&drm->session_active.link);
 	wl_event_source_remove(drm->drm_event);
-error_fd:
 	wl_list_remove(&drm->dev_remove.link);
 	wl_list_remove(&drm->dev_change.link);
 	wl_list_remove(&drm->parent_destroy.link);
-	wlr_session_close_file(drm->session, dev);
+	wlr_session_close_file(drm->session, drm->dev);
 	free(drm->name);
 	free(drm);
+}
+
+// Only queries the kernel: safe to run for several devices in parallel
+static bool drm_backend_init_kms(struct wlr_drm_backend *drm) {
+	return check_drm_features(drm) && init_drm_resources(drm);
+}
+
+static bool drm_backend_finish_init(struct wlr_drm_backend *drm,
+		struct wlr_backend *parent) {
+	if (parent != NULL) {
+		drm->parent = get_drm_backend_from_backend(parent);
+
+		uint64_t cap;
+		if (drmGetCap(drm->parent->fd, DRM_CAP_PRIME, &cap) ||
+				!(cap & DRM_PRIME_CAP_EXPORT)) {
+			wlr_log(WLR_ERROR,
+				"PRIME export not supported on primary GPU");
+			return false;
+		}
+
+		if (!init_mgpu_renderer(drm)) {
+			finish_drm_renderer(&drm->mgpu_renderer);
+			return false;
+		}
+
+		drm->parent_destroy.notify = handle_parent_destroy;
+		wl_signal_add(&parent->events.destroy, &drm->parent_destroy);
+	}
+
+	drm->session_destroy.notify = handle_session_destroy;
+	wl_signal_add(&drm->session->events.destroy, &drm->session_destroy);
+	return true;
+}
+
+struct wlr_backend *wlr_drm_backend_create(struct wlr_session *session,
+		struct wlr_device *dev, struct wlr_backend *parent) {
+	assert(session && dev);
+	assert(!parent || wlr_backend_is_drm(parent));
+
+	struct wlr_drm_backend *drm = drm_backend_alloc(session, dev);
+	if (drm == NULL) {
+		return NULL;
+	}
+
+	if (!drm_backend_init_kms(drm)) {
+		drm_backend_free(drm);
+		return NULL;
+	}
+
+	if (!drm_backend_finish_init(drm, parent)) {
+		finish_drm_resources(drm);
+		drm_backend_free(drm);
+		return NULL;
+	}
+
+	return &drm->backend;
+}
+
+struct drm_backend_init_job {
+	struct wlr_drm_backend *drm;
+	bool ok;
+
+	pthread_t thread;
+	bool threaded;
+};
+
+static void *drm_backend_init_job_run(void *data) {
+	struct drm_backend_init_job *job = data;
+	job->ok = drm_backend_init_kms(job->drm);
 	return NULL;
 }
+
+struct wlr_backend *create_drm_backends(struct wlr_session *session,
+		struct wlr_device **devs, size_t devs_len, struct wlr_backend **backends) {
+	struct drm_backend_init_job *jobs = calloc(devs_len, sizeof(*jobs));
+	if (jobs == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	for (size_t i = 0; i < devs_len; i++) {
+		jobs[i].drm = drm_backend_alloc(session, devs[i]);
+	}
+
+	// Querying KMS resources takes a few round-trips to the kernel per
+	// object. The calling thread takes care of the first device.
+	for (size_t i = 1; i < devs_len; i++) {
+		struct drm_backend_init_job *job = &jobs[i];
+		if (job->drm == NULL) {
+			continue;
+		}
+		job->threaded = pthread_create(&job->thread, NULL,
+			drm_backend_init_job_run, job) == 0;
+		if (!job->threaded) {
+			wlr_log(WLR_DEBUG, "Failed to spawn DRM init thread");
+			drm_backend_init_job_run(job);
+		}
+	}
+	if (devs_len > 0 && jobs[0].drm != NULL) {
+		drm_backend_init_job_run(&jobs[0]);
+	}
+	for (size_t i = 1; i < devs_len; i++) {
+		if (jobs[i].threaded) {
+			pthread_join(jobs[i].thread, NULL);
+		}
+	}
+
+	// The multi-GPU renderers need the primary device
+	struct wlr_backend *primary = NULL;
+	for (size_t i = 0; i < devs_len; i++) {
+		struct drm_backend_init_job *job = &jobs[i];
+		backends[i] = NULL;
+		if (job->drm == NULL) {
+			continue;
+		}
+		if (!job->ok) {
+			drm_backend_free(job->drm);
+			continue;
+		}
+		if (!drm_backend_finish_init(job->drm, primary)) {
+			finish_drm_resources(job->drm);
+			drm_backend_free(job->drm);
+			continue;
+		}
+
+		backends[i] = &job->drm->backend;
+		if (primary == NULL) {
+			primary = backends[i];
+		}
+	}
+
+	free(jobs);
+	return primary;
+}
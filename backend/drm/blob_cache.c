@@ -0,0 +1,124 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include <xf86drmMode.h>
+#include "backend/drm/drm.h"
+
+static void blob_destroy(struct wlr_drm_backend *drm, struct wlr_drm_blob *blob) {
+	if (drmModeDestroyPropertyBlob(drm->fd, blob->id) != 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to destroy blob");
+	}
+	wl_list_remove(&blob->link);
+	free(blob->data);
+	free(blob);
+}
+
+bool drm_blob_cache_acquire(struct wlr_drm_backend *drm, const void *data,
+		size_t size, uint32_t *blob_id) {
+	struct wlr_drm_blob_cache *cache = &drm->blob_cache;
+
+	struct wlr_drm_blob *blob;
+	wl_list_for_each(blob, &cache->blobs, link) {
+		if (blob->size != size || memcmp(blob->data, data, size) != 0) {
+			continue;
+		}
+
+		if (blob->refs == 0) {
+			cache->unused_len--;
+		}
+		blob->refs++;
+		wl_list_remove(&blob->link);
+		wl_list_insert(&cache->blobs, &blob->link);
+		cache->hits++;
+		*blob_id = blob->id;
+		return true;
+	}
+
+	blob = calloc(1, sizeof(*blob));
+	if (blob == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	blob->data = malloc(size);
+	if (blob->data == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(blob);
+		return false;
+	}
+	memcpy(blob->data, data, size);
+	blob->size = size;
+
+	if (drmModeCreatePropertyBlob(drm->fd, data, size, &blob->id) != 0) {
+		free(blob->data);
+		free(blob);
+		return false;
+	}
+
+	blob->refs = 1;
+	wl_list_insert(&cache->blobs, &blob->link);
+	cache->misses++;
+	*blob_id = blob->id;
+	return true;
+}
+
+void drm_blob_cache_release(struct wlr_drm_backend *drm, uint32_t blob_id) {
+	struct wlr_drm_blob_cache *cache = &drm->blob_cache;
+
+	if (blob_id == 0) {
+		return;
+	}
+
+	struct wlr_drm_blob *blob, *found = NULL;
+	wl_list_for_each(blob, &cache->blobs, link) {
+		if (blob->id == blob_id) {
+			found = blob;
+			break;
+		}
+	}
+	if (found == NULL) {
+		// Not created by us, e.g. inherited from the previous DRM master
+		if (drmModeDestroyPropertyBlob(drm->fd, blob_id) != 0) {
+			wlr_log_errno(WLR_ERROR, "Failed to destroy blob");
+		}
+		return;
+	}
+
+	found->refs--;
+	if (found->refs > 0) {
+		return;
+	}
+
+	// Keep the blob around in case the same contents are used again, the
+	// least recently used ones are destroyed first
+	cache->unused_len++;
+	wl_list_remove(&found->link);
+	wl_list_insert(&cache->blobs, &found->link);
+
+	struct wlr_drm_blob *tmp;
+	wl_list_for_each_reverse_safe(blob, tmp, &cache->blobs, link) {
+		if (cache->unused_len <= DRM_BLOB_CACHE_SIZE) {
+			break;
+		}
+		if (blob->refs == 0) {
+			blob_destroy(drm, blob);
+			cache->unused_len--;
+		}
+	}
+}
+
+void drm_blob_cache_finish(struct wlr_drm_backend *drm) {
+	struct wlr_drm_blob_cache *cache = &drm->blob_cache;
+
+	wlr_log(WLR_DEBUG, "Blob cache: %zu hits, %zu misses",
+		cache->hits, cache->misses);
+
+	struct wlr_drm_blob *blob, *tmp;
+	wl_list_for_each_safe(blob, tmp, &cache->blobs, link) {
+		if (blob->refs > 0) {
+			wlr_log(WLR_DEBUG, "Blob %"PRIu32" still referenced on exit", blob->id);
+		}
+		blob_destroy(drm, blob);
+	}
+	cache->unused_len = 0;
+}
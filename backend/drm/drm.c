@@ -30,6 +30,7 @@
 #include "render/wlr_renderer.h"
 #include "types/wlr_output.h"
 #include "util/env.h"
+#include "util/trace.h"
 #include "config.h"
 
 #if HAVE_LIBLIFTOFF
@@ -47,6 +48,9 @@ static const uint32_t COMMIT_OUTPUT_STATE =
 	WLR_OUTPUT_STATE_WAIT_TIMELINE |
 	WLR_OUTPUT_STATE_SIGNAL_TIMELINE;
 
+// Time kept before the VRR minimum refresh deadline when repeating frames
+#define LFC_MARGIN_MS 2
+
 static const uint32_t SUPPORTED_OUTPUT_STATE =
 	WLR_OUTPUT_STATE_BACKEND_OPTIONAL | COMMIT_OUTPUT_STATE;
 
@@ -65,15 +69,6 @@ bool check_drm_features(struct wlr_drm_backend *drm) {
 		return false;
 	}
 
-	if (drm->parent) {
-		if (drmGetCap(drm->parent->fd, DRM_CAP_PRIME, &cap) ||
-				!(cap & DRM_PRIME_CAP_EXPORT)) {
-			wlr_log(WLR_ERROR,
-				"PRIME export not supported on primary GPU");
-			return false;
-		}
-	}
-
 	if (drmSetClientCap(drm->fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1)) {
 		wlr_log(WLR_ERROR, "DRM universal planes unsupported");
 		return false;
@@ -120,6 +115,11 @@ bool check_drm_features(struct wlr_drm_backend *drm) {
 	}
 #endif
 
+	if (drm->iface == &atomic_iface &&
+			drmSetClientCap(drm->fd, DRM_CLIENT_CAP_WRITEBACK_CONNECTORS, 1) == 0) {
+		wlr_log(WLR_DEBUG, "DRM_CLIENT_CAP_WRITEBACK_CONNECTORS supported");
+	}
+
 	if (drm->iface == &legacy_iface) {
 		drm->supports_tearing_page_flips = drmGetCap(drm->fd, DRM_CAP_ASYNC_PAGE_FLIP, &cap) == 0 && cap == 1;
 	} else {
@@ -136,6 +136,8 @@ bool check_drm_features(struct wlr_drm_backend *drm) {
 			drm->addfb2_modifiers ? "supported" : "unsupported");
 	}
 
+	drm->vrr_lfc = env_parse_bool("WLR_DRM_VRR_LFC");
+
 	return true;
 }
 
@@ -352,6 +354,8 @@ bool init_drm_resources(struct wlr_drm_backend *drm) {
 		goto error_crtcs;
 	}
 
+	init_drm_writeback_connectors(drm);
+
 	drmModeFreeResources(res);
 
 	return true;
@@ -386,13 +390,14 @@ void finish_drm_resources(struct wlr_drm_backend *drm) {
 	for (size_t i = 0; i < drm->num_crtcs; ++i) {
 		struct wlr_drm_crtc *crtc = &drm->crtcs[i];
 
-		if (crtc->mode_id && crtc->own_mode_id) {
-			drmModeDestroyPropertyBlob(drm->fd, crtc->mode_id);
-		}
-		if (crtc->gamma_lut) {
-			drmModeDestroyPropertyBlob(drm->fd, crtc->gamma_lut);
+		if (crtc->own_mode_id) {
+			drm_blob_cache_release(drm, crtc->mode_id);
 		}
+		drm_blob_cache_release(drm, crtc->gamma_lut);
 	}
+	drm_blob_cache_finish(drm);
+
+	finish_drm_writeback_connectors(drm);
 
 	free(drm->crtcs);
 
@@ -552,6 +557,22 @@ static void drm_connector_set_pending_page_flip(struct wlr_drm_connector *conn,
 	conn->pending_page_flip = page_flip;
 }
 
+static void drm_connector_discard_mailbox(struct wlr_drm_connector *conn) {
+	if (!conn->mailbox.pending) {
+		return;
+	}
+
+	// The frame will never be displayed
+	struct wlr_output_event_present present_event = {
+		.commit_seq = conn->mailbox.commit_seq,
+		.presented = false,
+	};
+	output_defer_present(&conn->output, present_event);
+
+	wlr_output_state_finish(&conn->mailbox.state);
+	conn->mailbox.pending = false;
+}
+
 static void drm_connector_apply_commit(const struct wlr_drm_connector_state *state,
 		struct wlr_drm_page_flip *page_flip) {
 	struct wlr_drm_connector *conn = state->connector;
@@ -559,10 +580,15 @@ static void drm_connector_apply_commit(const struct wlr_drm_connector_state *sta
 
 	drm_fb_copy(&crtc->primary->queued_fb, state->primary_fb);
 	crtc->primary->viewport = state->primary_viewport;
+	if (state->base->committed & WLR_OUTPUT_STATE_BUFFER) {
+		drm_surface_mark_committed(&crtc->primary->mgpu_surf);
+	}
 	if (crtc->cursor != NULL) {
 		drm_fb_copy(&crtc->cursor->queued_fb, state->cursor_fb);
 	}
 	drm_fb_clear(&conn->cursor_pending_fb);
+	conn->cursor_plane_visible = state->active && crtc->cursor != NULL &&
+		drm_connector_is_cursor_visible(conn);
 
 	struct wlr_drm_layer *layer;
 	wl_list_for_each(layer, &crtc->layers, link) {
@@ -570,12 +596,23 @@ static void drm_connector_apply_commit(const struct wlr_drm_connector_state *sta
 	}
 
 	drm_connector_set_pending_page_flip(conn, page_flip);
+	conn->inherited_mode = false;
+
+	if (state->base->committed & WLR_OUTPUT_STATE_MODE) {
+		// The new mode may accept buffers the previous one rejected
+		crtc->primary->mgpu_import_failed_format = DRM_FORMAT_INVALID;
+	}
+
+	if (conn->lfc_timer != NULL) {
+		wl_event_source_timer_update(conn->lfc_timer, 0);
+	}
 
 	if (state->base->committed & WLR_OUTPUT_STATE_MODE) {
 		conn->refresh = calculate_refresh_rate(&state->mode);
 	}
 
 	if (!state->active) {
+		drm_connector_discard_mailbox(conn);
 		drm_plane_finish_surface(crtc->primary);
 		drm_plane_finish_surface(crtc->cursor);
 		drm_fb_clear(&conn->cursor_pending_fb);
@@ -595,6 +632,19 @@ static void drm_connector_apply_commit(const struct wlr_drm_connector_state *sta
 	}
 }
 
+static void drm_connector_state_mgpu_import_failed(
+		const struct wlr_drm_connector_state *state) {
+	struct wlr_dmabuf_attributes dmabuf;
+	if (!state->primary_mgpu_import ||
+			!wlr_buffer_get_dmabuf(state->base->buffer, &dmabuf)) {
+		return;
+	}
+
+	// The FB could be created but the plane doesn't accept it, copy the
+	// next buffers of this format instead
+	state->connector->crtc->primary->mgpu_import_failed_format = dmabuf.format;
+}
+
 static void drm_connector_rollback_commit(const struct wlr_drm_connector_state *state) {
 	struct wlr_drm_crtc *crtc = state->connector->crtc;
 
@@ -617,6 +667,17 @@ static bool drm_commit(struct wlr_drm_backend *drm,
 	// Disallow atomic-only flags
 	assert((flags & ~DRM_MODE_PAGE_FLIP_FLAGS) == 0);
 
+	// Legacy tests don't perform any ioctl, no need to cache them
+	uint64_t test_key = 0;
+	bool cache_test = test_only && drm->iface != &legacy_iface &&
+		drm_test_cache_get_key(state, flags, &test_key);
+	if (cache_test && drm_test_cache_has_failed(&drm->test_cache, test_key)) {
+		for (size_t i = 0; i < state->connectors_len; i++) {
+			drm_connector_rollback_commit(&state->connectors[i]);
+		}
+		return false;
+	}
+
 	struct wlr_drm_page_flip *page_flip = NULL;
 	if (flags & DRM_MODE_PAGE_FLIP_EVENT) {
 		page_flip = drm_page_flip_create(drm, state);
@@ -627,7 +688,20 @@ static bool drm_commit(struct wlr_drm_backend *drm,
 	}
 
 	bool ok = drm->iface->commit(drm, state, page_flip, flags, test_only);
+	if (cache_test && !ok) {
+		drm_test_cache_add_failure(&drm->test_cache, test_key);
+	}
+	if (!ok) {
+		for (size_t i = 0; i < state->connectors_len; i++) {
+			drm_connector_state_mgpu_import_failed(&state->connectors[i]);
+		}
+	}
 	if (ok && !test_only) {
+		if (state->modeset) {
+			// Other CRTCs may have been reconfigured, which changes the
+			// outcome of tests
+			drm_test_cache_clear(&drm->test_cache);
+		}
 		for (size_t i = 0; i < state->connectors_len; i++) {
 			drm_connector_apply_commit(&state->connectors[i], page_flip);
 		}
@@ -649,6 +723,7 @@ static void drm_connector_state_init(struct wlr_drm_connector_state *state,
 		.active = output_pending_enabled(&conn->output, base),
 		.primary_in_fence_fd = -1,
 		.out_fence_fd = -1,
+		.writeback_out_fence_fd = -1,
 	};
 
 	struct wlr_output_mode *mode = conn->output.current_mode;
@@ -711,6 +786,27 @@ static void drm_connector_state_finish(struct wlr_drm_connector_state *state) {
 	wlr_drm_syncobj_timeline_unref(state->wait_timeline);
 }
 
+// Linear buffers allocated by the primary GPU can often be scanned out by
+// the secondary GPU directly, which is cheaper than copying them
+static bool drm_plane_import_mgpu_buffer(struct wlr_drm_plane *plane,
+		struct wlr_drm_backend *drm, struct wlr_buffer *buffer,
+		struct wlr_drm_fb **fb_ptr) {
+	struct wlr_dmabuf_attributes dmabuf;
+	if (!wlr_buffer_get_dmabuf(buffer, &dmabuf) ||
+			dmabuf.modifier != DRM_FORMAT_MOD_LINEAR ||
+			dmabuf.format == plane->mgpu_import_failed_format) {
+		return false;
+	}
+
+	if (!drm_fb_import(fb_ptr, drm, buffer, &plane->formats)) {
+		wlr_log(WLR_DEBUG, "Failed to import linear buffer on plane %"PRIu32
+			", falling back to multi-GPU copies", plane->id);
+		plane->mgpu_import_failed_format = dmabuf.format;
+		return false;
+	}
+	return true;
+}
+
 static bool drm_connector_state_update_primary_fb(struct wlr_drm_connector *conn,
 		struct wlr_drm_connector_state *state) {
 	struct wlr_drm_backend *drm = conn->backend;
@@ -731,8 +827,26 @@ static bool drm_connector_state_update_primary_fb(struct wlr_drm_connector *conn
 	}
 	assert(state->wait_timeline == NULL);
 
+	const pixman_region32_t *damage = NULL;
+	if (state->base->committed & WLR_OUTPUT_STATE_DAMAGE) {
+		damage = &state->base->damage;
+	}
+
 	struct wlr_buffer *local_buf;
-	if (drm->mgpu_renderer.wlr_rend) {
+	if (drm->mgpu_renderer.wlr_rend &&
+			drm_plane_import_mgpu_buffer(plane, drm, source_buf, &state->primary_fb)) {
+		drm_surface_add_damage(&plane->mgpu_surf, damage);
+		state->primary_mgpu_import = true;
+
+		if (wait_timeline != NULL) {
+			state->wait_timeline = wlr_drm_syncobj_timeline_ref(wait_timeline);
+			state->wait_point = wait_point;
+		}
+
+		output_state_get_buffer_src_box(state->base, &state->primary_viewport.src_box);
+		output_state_get_buffer_dst_box(state->base, &state->primary_viewport.dst_box);
+		return true;
+	} else if (drm->mgpu_renderer.wlr_rend) {
 		struct wlr_drm_format format = {0};
 		if (!drm_plane_pick_render_format(plane, &format, &drm->mgpu_renderer)) {
 			wlr_log(WLR_ERROR, "Failed to pick primary plane format");
@@ -747,7 +861,7 @@ static bool drm_connector_state_update_primary_fb(struct wlr_drm_connector *conn
 			return false;
 		}
 
-		local_buf = drm_surface_blit(&plane->mgpu_surf, source_buf,
+		local_buf = drm_surface_blit(&plane->mgpu_surf, source_buf, damage,
 			wait_timeline, wait_point);
 		if (local_buf == NULL) {
 			return false;
@@ -892,6 +1006,55 @@ static bool drm_connector_prepare(struct wlr_drm_connector_state *conn_state, bo
 	return true;
 }
 
+// Only tearing page-flips of a new buffer can be kept for later, other
+// changes need to be applied immediately
+static bool drm_connector_accepts_mailbox(const struct wlr_drm_connector_state *state) {
+	const uint32_t mailbox_fields = WLR_OUTPUT_STATE_BUFFER | WLR_OUTPUT_STATE_DAMAGE;
+	return state->active && state->base->tearing_page_flip &&
+		(state->base->committed & ~mailbox_fields) == 0;
+}
+
+static bool drm_connector_store_mailbox(struct wlr_drm_connector *conn,
+		const struct wlr_output_state *state) {
+	if (conn->mailbox.pending) {
+		conn->mailbox.replaced++;
+		drm_connector_discard_mailbox(conn);
+	} else {
+		conn->mailbox.flip_commit_seq = conn->output.commit_seq;
+	}
+
+	wlr_output_state_init(&conn->mailbox.state);
+	if (!wlr_output_state_copy(&conn->mailbox.state, state)) {
+		wlr_output_state_finish(&conn->mailbox.state);
+		return false;
+	}
+	// The wlr_output commit sequence is incremented once we return
+	conn->mailbox.commit_seq = conn->output.commit_seq + 1;
+	conn->mailbox.pending = true;
+	return true;
+}
+
+static bool drm_connector_commit_state(struct wlr_drm_connector *conn,
+		const struct wlr_output_state *state, bool test_only);
+
+static void drm_connector_flush_mailbox(struct wlr_drm_connector *conn) {
+	struct wlr_output_state state = conn->mailbox.state;
+	uint32_t commit_seq = conn->mailbox.commit_seq;
+	conn->mailbox.pending = false;
+
+	if (drm_connector_commit_state(conn, &state, false)) {
+		conn->mailbox.flipped++;
+	} else {
+		wlr_drm_conn_log(conn, WLR_DEBUG, "Failed to page-flip mailbox frame");
+		struct wlr_output_event_present present_event = {
+			.commit_seq = commit_seq,
+			.presented = false,
+		};
+		output_defer_present(&conn->output, present_event);
+	}
+	wlr_output_state_finish(&state);
+}
+
 static bool drm_connector_commit_state(struct wlr_drm_connector *conn,
 		const struct wlr_output_state *state, bool test_only) {
 	struct wlr_drm_backend *drm = conn->backend;
@@ -954,6 +1117,15 @@ static bool drm_connector_commit_state(struct wlr_drm_connector *conn,
 		}
 	}
 
+	if (!test_only && pending_dev.nonblock && conn->pending_page_flip != NULL &&
+			drm_connector_accepts_mailbox(&pending)) {
+		// Latest frame wins: check that the frame can be flipped, and keep
+		// it until the pending page-flip completes
+		ok = drm_commit(drm, &pending_dev, DRM_MODE_PAGE_FLIP_ASYNC, true) &&
+			drm_connector_store_mailbox(conn, state);
+		goto out;
+	}
+
 	// wlr_drm_interface.crtc_commit will perform either a non-blocking
 	// page-flip, either a blocking modeset. When performing a blocking modeset
 	// we'll wait for all queued page-flips to complete, so we don't need this
@@ -1142,7 +1314,7 @@ static bool drm_connector_set_cursor(struct wlr_output *output,
 				return false;
 			}
 
-			local_buf = drm_surface_blit(&plane->mgpu_surf, buffer, NULL, 0);
+			local_buf = drm_surface_blit(&plane->mgpu_surf, buffer, NULL, NULL, 0);
 			if (local_buf == NULL) {
 				return false;
 			}
@@ -1166,6 +1338,40 @@ static bool drm_connector_set_cursor(struct wlr_output *output,
 	return true;
 }
 
+// Move the cursor plane right away instead of waiting for the next frame, so
+// that the cursor keeps up with the pointer when the compositor renders
+// slowly. This uses the legacy cursor IOCTL, because atomic drivers implement
+// it as an asynchronous update which doesn't wait for vblank and doesn't
+// block the next page-flip.
+static bool drm_connector_move_cursor_now(struct wlr_drm_connector *conn) {
+	struct wlr_drm_backend *drm = conn->backend;
+	struct wlr_drm_plane *plane = conn->crtc->cursor;
+
+	// With libliftoff, the cursor plane may be used by another layer
+	if (drm->iface == &liftoff_iface || !drm->session->active) {
+		return false;
+	}
+	// Hotspot properties can only be updated with atomic commits
+	if (plane->props.hotspot_x != 0) {
+		return false;
+	}
+	// Only a position change can be applied, the cursor plane must already
+	// display the current cursor image. Pending commits may overwrite the
+	// new position.
+	if (conn->pending_page_flip != NULL || conn->cursor_pending_fb != NULL ||
+			plane->queued_fb != NULL || !conn->cursor_plane_visible ||
+			!drm_connector_is_cursor_visible(conn)) {
+		return false;
+	}
+
+	if (drmModeMoveCursor(drm->fd, conn->crtc->id,
+			conn->cursor_x, conn->cursor_y) != 0) {
+		wlr_drm_conn_log_errno(conn, WLR_DEBUG, "drmModeMoveCursor failed");
+		return false;
+	}
+	return true;
+}
+
 static bool drm_connector_move_cursor(struct wlr_output *output,
 		int x, int y) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
@@ -1192,6 +1398,10 @@ static bool drm_connector_move_cursor(struct wlr_output *output,
 	conn->cursor_x = box.x;
 	conn->cursor_y = box.y;
 
+	if (drm_connector_move_cursor_now(conn)) {
+		return true;
+	}
+
 	wlr_output_update_needs_frame(output);
 	return true;
 }
@@ -1215,6 +1425,26 @@ static void dealloc_crtc(struct wlr_drm_connector *conn);
 static void drm_connector_destroy_output(struct wlr_output *output) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
 
+	if (conn->lfc_timer != NULL) {
+		wl_event_source_remove(conn->lfc_timer);
+		conn->lfc_timer = NULL;
+	}
+
+	if (conn->mailbox.pending) {
+		wlr_output_state_finish(&conn->mailbox.state);
+	}
+	if (conn->mailbox.flipped > 0 || conn->mailbox.replaced > 0) {
+		wlr_drm_conn_log(conn, WLR_DEBUG, "Tearing mailbox: %zu frames "
+			"flipped, %zu replaced", conn->mailbox.flipped, conn->mailbox.replaced);
+	}
+	memset(&conn->mailbox, 0, sizeof(conn->mailbox));
+
+	drm_connector_fail_writebacks(conn);
+
+	free(conn->edid);
+	conn->edid = NULL;
+	conn->edid_len = 0;
+
 	wlr_output_finish(output);
 
 	dealloc_crtc(conn);
@@ -1300,6 +1530,17 @@ uint32_t wlr_drm_connector_get_id(struct wlr_output *output) {
 	return conn->id;
 }
 
+bool wlr_drm_connector_get_vrr_range(struct wlr_output *output,
+		int32_t *min_refresh, int32_t *max_refresh) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+	if (!output->adaptive_sync_supported || conn->vrr_min_refresh == 0) {
+		return false;
+	}
+	*min_refresh = conn->vrr_min_refresh;
+	*max_refresh = conn->vrr_max_refresh;
+	return true;
+}
+
 enum wl_output_transform wlr_drm_connector_get_panel_orientation(
 		struct wlr_output *output) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
@@ -1532,6 +1773,7 @@ static struct wlr_drm_connector *create_drm_connector(struct wlr_drm_backend *dr
 	wlr_conn->backend = drm;
 	wlr_conn->status = DRM_MODE_DISCONNECTED;
 	wlr_conn->id = drm_conn->connector_id;
+	wl_list_init(&wlr_conn->writebacks);
 
 	if (!get_drm_connector_props(drm->fd, wlr_conn->id, &wlr_conn->props)) {
 		free(wlr_conn);
@@ -1595,6 +1837,34 @@ static drmModeModeInfo *connector_get_current_mode(struct wlr_drm_connector *wlr
 	}
 }
 
+static int handle_lfc_timer(void *data) {
+	struct wlr_drm_connector *conn = data;
+	struct wlr_drm_backend *drm = conn->backend;
+
+	// Multi-GPU setups would need another blit, and output layers aren't
+	// part of the primary FB
+	if (!drm->session->active || conn->crtc == NULL ||
+			conn->pending_page_flip != NULL || drm->mgpu_renderer.wlr_rend ||
+			!wl_list_empty(&conn->crtc->layers) ||
+			conn->crtc->primary->current_fb == NULL) {
+		return 0;
+	}
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_buffer(&state, conn->crtc->primary->current_fb->wlr_buf);
+	if (drm_connector_commit_state(conn, &state, false)) {
+		// The compositor needs to wait for the frame event of the repeated
+		// frame before committing again
+		conn->output.frame_pending = true;
+	} else {
+		wlr_drm_conn_log(conn, WLR_DEBUG, "Failed to repeat frame");
+	}
+	wlr_output_state_finish(&state);
+
+	return 0;
+}
+
 static bool connect_drm_connector(struct wlr_drm_connector *wlr_conn,
 		const drmModeConnector *drm_conn) {
 	struct wlr_drm_backend *drm = wlr_conn->backend;
@@ -1642,6 +1912,9 @@ static bool connect_drm_connector(struct wlr_drm_connector *wlr_conn,
 			wlr_conn->crtc->own_mode_id = false;
 			wlr_conn->crtc->mode_id = mode_id;
 			wlr_conn->refresh = calculate_refresh_rate(current_modeinfo);
+
+			// After a hotplug the link may need to be re-trained
+			wlr_conn->inherited_mode = !drm->connectors_scanned;
 		}
 
 		wlr_log(WLR_INFO, "  %"PRId32"x%"PRId32" @ %.3f Hz %s",
@@ -1699,7 +1972,22 @@ static bool connect_drm_connector(struct wlr_drm_connector *wlr_conn,
 	uint8_t *edid = get_drm_prop_blob(drm->fd,
 		wlr_conn->id, wlr_conn->props.edid, &edid_len);
 	parse_edid(wlr_conn, edid_len, edid);
-	free(edid);
+	wlr_conn->edid = edid;
+	wlr_conn->edid_len = edid != NULL ? edid_len : 0;
+
+	if (output->adaptive_sync_supported && wlr_conn->vrr_min_refresh > 0) {
+		wlr_log(WLR_INFO, "VRR range: %.3f-%.3f Hz",
+			(float)wlr_conn->vrr_min_refresh / 1000,
+			(float)wlr_conn->vrr_max_refresh / 1000);
+		if (drm->vrr_lfc) {
+			wlr_conn->lfc_timer = wl_event_loop_add_timer(drm->session->event_loop,
+				handle_lfc_timer, wlr_conn);
+			if (wlr_conn->lfc_timer == NULL) {
+				wlr_drm_conn_log(wlr_conn, WLR_ERROR,
+					"Failed to create low framerate compensation timer");
+			}
+		}
+	}
 
 	char *subconnector = NULL;
 	if (wlr_conn->props.subconnector) {
@@ -1728,6 +2016,38 @@ static bool connect_drm_connector(struct wlr_drm_connector *wlr_conn,
 
 static void disconnect_drm_connector(struct wlr_drm_connector *conn);
 
+static drmModeConnector *get_drm_connector(struct wlr_drm_backend *drm,
+		uint32_t conn_id, bool probe) {
+	// Probing a connector reads its EDID over DDC, which takes a while and
+	// is serialized by the kernel. On startup, the kernel has usually
+	// already probed displays (e.g. for the boot console) and keeps track of
+	// hotplugs since then: re-use that state unless it's unknown or
+	// incomplete.
+	if (!probe) {
+		drmModeConnector *drm_conn = drmModeGetConnectorCurrent(drm->fd, conn_id);
+		if (drm_conn != NULL && (drm_conn->connection == DRM_MODE_DISCONNECTED ||
+				(drm_conn->connection == DRM_MODE_CONNECTED && drm_conn->count_modes > 0))) {
+			return drm_conn;
+		}
+		drmModeFreeConnector(drm_conn);
+	}
+
+	return drmModeGetConnector(drm->fd, conn_id);
+}
+
+static bool connector_edid_changed(struct wlr_drm_connector *conn) {
+	size_t edid_len = 0;
+	uint8_t *edid = get_drm_prop_blob(conn->backend->fd,
+		conn->id, conn->props.edid, &edid_len);
+	if (edid == NULL) {
+		edid_len = 0;
+	}
+	bool changed = edid_len != conn->edid_len ||
+		(edid_len > 0 && memcmp(edid, conn->edid, edid_len) != 0);
+	free(edid);
+	return changed;
+}
+
 void scan_drm_connectors(struct wlr_drm_backend *drm,
 		struct wlr_device_hotplug_event *event) {
 	if (event != NULL && event->connector_id != 0) {
@@ -1737,6 +2057,9 @@ void scan_drm_connectors(struct wlr_drm_backend *drm,
 		wlr_log(WLR_INFO, "Scanning DRM connectors on %s", drm->name);
 	}
 
+	// Connectors may have been connected, disconnected or leased
+	drm_test_cache_clear(&drm->test_cache);
+
 	drmModeRes *res = drmModeGetResources(drm->fd);
 	if (!res) {
 		wlr_log_errno(WLR_ERROR, "Failed to get DRM resources");
@@ -1751,6 +2074,10 @@ void scan_drm_connectors(struct wlr_drm_backend *drm,
 	size_t new_outputs_len = 0;
 	struct wlr_drm_connector *new_outputs[res->count_connectors + 1];
 
+	// Hotplug events may come with new displays. On session resume, the
+	// kernel has kept track of hotplugs while another DRM master was active.
+	bool probe = event != NULL;
+
 	for (int i = 0; i < res->count_connectors; ++i) {
 		uint32_t conn_id = res->connectors[i];
 
@@ -1768,6 +2095,11 @@ void scan_drm_connectors(struct wlr_drm_backend *drm,
 			continue;
 		}
 
+		// Writeback connectors aren't outputs
+		if (wlr_conn == NULL && drm_is_writeback_connector(drm, conn_id)) {
+			continue;
+		}
+
 		// If the hotplug event contains a connector ID, ignore any other
 		// connector.
 		if (event != NULL && event->connector_id != 0 &&
@@ -1778,7 +2110,7 @@ void scan_drm_connectors(struct wlr_drm_backend *drm,
 			continue;
 		}
 
-		drmModeConnector *drm_conn = drmModeGetConnector(drm->fd, conn_id);
+		drmModeConnector *drm_conn = get_drm_connector(drm, conn_id, probe);
 		if (!drm_conn) {
 			wlr_log_errno(WLR_ERROR, "Failed to get DRM connector");
 			continue;
@@ -1812,6 +2144,13 @@ void scan_drm_connectors(struct wlr_drm_backend *drm,
 			}
 		}
 
+		if (wlr_conn->status == DRM_MODE_CONNECTED &&
+				drm_conn->connection == DRM_MODE_CONNECTED &&
+				connector_edid_changed(wlr_conn)) {
+			wlr_log(WLR_INFO, "'%s' display changed", wlr_conn->name);
+			disconnect_drm_connector(wlr_conn);
+		}
+
 		if (wlr_conn->status == DRM_MODE_DISCONNECTED &&
 				drm_conn->connection == DRM_MODE_CONNECTED) {
 			wlr_log(WLR_INFO, "'%s' connected", wlr_conn->name);
@@ -1845,6 +2184,10 @@ void scan_drm_connectors(struct wlr_drm_backend *drm,
 		destroy_drm_connector(conn);
 	}
 
+	if (event == NULL) {
+		drm->connectors_scanned = true;
+	}
+
 	for (size_t i = 0; i < new_outputs_len; ++i) {
 		struct wlr_drm_connector *conn = new_outputs[i];
 
@@ -1884,9 +2227,9 @@ void scan_drm_leases(struct wlr_drm_backend *drm) {
 	drmFree(list);
 }
 
-bool commit_drm_device(struct wlr_drm_backend *drm,
+static bool commit_drm_device_state(struct wlr_drm_backend *drm,
 		const struct wlr_backend_output_state *output_states, size_t output_states_len,
-		bool test_only) {
+		bool test_only, bool reset) {
 	if (!drm->session->active) {
 		return false;
 	}
@@ -1944,7 +2287,8 @@ bool commit_drm_device(struct wlr_drm_backend *drm,
 		flags |= DRM_MODE_PAGE_FLIP_EVENT;
 	}
 	struct wlr_drm_device_state dev_state = {
-		.modeset = modeset,
+		.modeset = modeset || reset,
+		.reset = reset,
 		.connectors = conn_states,
 		.connectors_len = conn_states_len,
 	};
@@ -1958,13 +2302,67 @@ out:
 	return ok;
 }
 
+bool commit_drm_device(struct wlr_drm_backend *drm,
+		const struct wlr_backend_output_state *output_states, size_t output_states_len,
+		bool test_only) {
+	return commit_drm_device_state(drm, output_states, output_states_len,
+		test_only, false);
+}
+
+void restore_drm_device(struct wlr_drm_backend *drm) {
+	// The previous DRM master leaves KMS in an undefined state. Restore all
+	// enabled outputs with their last committed buffer in a single commit,
+	// which also turns off everything else.
+	size_t conns_len = wl_list_length(&drm->connectors);
+	struct wlr_backend_output_state *states = calloc(conns_len + 1, sizeof(states[0]));
+	if (states == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+
+	size_t states_len = 0;
+	struct wlr_drm_connector *conn;
+	wl_list_for_each(conn, &drm->connectors, link) {
+		struct wlr_output *output = &conn->output;
+		if (conn->status != DRM_MODE_CONNECTED || conn->lease != NULL ||
+				!output->enabled) {
+			continue;
+		}
+
+		struct wlr_backend_output_state *state = &states[states_len++];
+		state->output = output;
+		wlr_output_state_init(&state->base);
+		wlr_output_state_set_enabled(&state->base, true);
+		if (output->current_mode != NULL) {
+			wlr_output_state_set_mode(&state->base, output->current_mode);
+		} else {
+			wlr_output_state_set_custom_mode(&state->base,
+				output->width, output->height, output->refresh);
+		}
+	}
+
+	if (states_len > 0 && !commit_drm_device_state(drm, states, states_len, false, true)) {
+		// Let the compositor configure the outputs again: they'll be
+		// re-connected by the next scan
+		wlr_log(WLR_ERROR, "Failed to restore outputs after VT switch");
+		for (size_t i = 0; i < states_len; i++) {
+			conn = get_drm_connector_from_output(states[i].output);
+			disconnect_drm_connector(conn);
+		}
+	}
+
+	for (size_t i = 0; i < states_len; i++) {
+		wlr_output_state_finish(&states[i].base);
+	}
+	free(states);
+}
+
 static int mhz_to_nsec(int mhz) {
 	return 1000000000000LL / mhz;
 }
 
-static void handle_page_flip(int fd, unsigned seq,
-		unsigned tv_sec, unsigned tv_usec, unsigned crtc_id, void *data) {
-	struct wlr_drm_page_flip *page_flip = data;
+static void page_flip_handle_event(unsigned seq, unsigned tv_sec,
+		unsigned tv_usec, unsigned crtc_id, struct wlr_drm_page_flip *page_flip) {
 
 	struct wlr_drm_connector *conn = drm_page_flip_pop(page_flip, crtc_id);
 	if (conn != NULL) {
@@ -2017,7 +2415,8 @@ static void handle_page_flip(int fd, unsigned seq,
 	struct wlr_output_event_present present_event = {
 		/* The DRM backend guarantees that the presentation event will be for
 		 * the last submitted frame. */
-		.commit_seq = conn->output.commit_seq,
+		.commit_seq = conn->mailbox.pending ?
+			conn->mailbox.flip_commit_seq : conn->output.commit_seq,
 		.presented = drm->session->active,
 		.when = {
 			.tv_sec = tv_sec,
@@ -2029,11 +2428,37 @@ static void handle_page_flip(int fd, unsigned seq,
 	};
 	wlr_output_send_present(&conn->output, &present_event);
 
+	if (conn->lfc_timer != NULL && drm->session->active &&
+			(present_flags & WLR_OUTPUT_PRESENT_VSYNC) &&
+			conn->output.adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED) {
+		// Repeat the frame if nothing new is committed in time, leaving some
+		// margin for the page-flip to land before the panel misses its
+		// minimum refresh rate. Armed before the frame event, so that an
+		// immediate commit disarms it.
+		int delay_ms = 1000000 / conn->vrr_min_refresh - LFC_MARGIN_MS;
+		wl_event_source_timer_update(conn->lfc_timer, delay_ms > 0 ? delay_ms : 1);
+	}
+
+	if (conn->mailbox.pending) {
+		if (drm->session->active) {
+			drm_connector_flush_mailbox(conn);
+		} else {
+			drm_connector_discard_mailbox(conn);
+		}
+	}
+
 	if (drm->session->active) {
 		wlr_output_send_frame(&conn->output);
 	}
 }
 
+static void handle_page_flip(int fd, unsigned seq,
+		unsigned tv_sec, unsigned tv_usec, unsigned crtc_id, void *data) {
+	trace_begin("drm_page_flip");
+	page_flip_handle_event(seq, tv_sec, tv_usec, crtc_id, data);
+	trace_end();
+}
+
 int handle_drm_event(int fd, uint32_t mask, void *data) {
 	struct wlr_drm_backend *drm = data;
 
@@ -2087,6 +2512,31 @@ int wlr_drm_backend_get_non_master_fd(struct wlr_backend *backend) {
 	return fd;
 }
 
+// Finds a CRTC which isn't used by any connector nor leased, without touching
+// the CRTCs of other connectors
+static struct wlr_drm_crtc *find_free_crtc(struct wlr_drm_connector *conn) {
+	struct wlr_drm_backend *drm = conn->backend;
+	for (size_t i = 0; i < drm->num_crtcs; ++i) {
+		struct wlr_drm_crtc *crtc = &drm->crtcs[i];
+		if (!(conn->possible_crtcs & (1 << i)) || crtc->lease != NULL) {
+			continue;
+		}
+
+		bool used = false;
+		struct wlr_drm_connector *other;
+		wl_list_for_each(other, &drm->connectors, link) {
+			if (other->crtc == crtc) {
+				used = true;
+				break;
+			}
+		}
+		if (!used) {
+			return crtc;
+		}
+	}
+	return NULL;
+}
+
 struct wlr_drm_lease *wlr_drm_create_lease(struct wlr_output **outputs,
 		size_t n_outputs, int *lease_fd_ptr) {
 	assert(outputs);
@@ -2114,6 +2564,11 @@ struct wlr_drm_lease *wlr_drm_create_lease(struct wlr_output **outputs,
 		objects[n_objects++] = conn->id;
 		wlr_log(WLR_DEBUG, "Connector %d", conn->id);
 
+		// Only reallocate the CRTCs of all connectors if there is no free
+		// CRTC left, to avoid disturbing the other outputs
+		if (conn->crtc == NULL) {
+			conn->crtc = find_free_crtc(conn);
+		}
 		if (!drm_connector_alloc_crtc(conn)) {
 			wlr_log(WLR_ERROR, "Failled to allocate connector CRTC");
 			return NULL;
@@ -2179,10 +2634,17 @@ void drm_lease_destroy(struct wlr_drm_lease *lease) {
 
 	wl_signal_emit_mutable(&lease->events.destroy, NULL);
 
+	// The lessee may have left the leased CRTCs in any state
+	drm_test_cache_clear(&drm->test_cache);
+
+	size_t num_connectors = wl_list_length(&drm->connectors);
+	uint32_t leased_connectors[num_connectors + 1];
+	size_t leased_connectors_len = 0;
 	struct wlr_drm_connector *conn;
 	wl_list_for_each(conn, &drm->connectors, link) {
 		if (conn->lease == lease) {
 			conn->lease = NULL;
+			leased_connectors[leased_connectors_len++] = conn->id;
 		}
 	}
 
@@ -2193,5 +2655,13 @@ void drm_lease_destroy(struct wlr_drm_lease *lease) {
 	}
 
 	free(lease);
-	scan_drm_connectors(drm, NULL);
+
+	// Only the connectors which were leased need to be picked up again, the
+	// state of the other connectors didn't change
+	for (size_t i = 0; i < leased_connectors_len; ++i) {
+		struct wlr_device_hotplug_event event = {
+			.connector_id = leased_connectors[i],
+		};
+		scan_drm_connectors(drm, &event);
+	}
 }
@@ -1,5 +1,6 @@
 #include <drm_fourcc.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <wlr/render/drm_format_set.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/util/addon.h>
@@ -26,9 +27,87 @@ struct wlr_drm_fb *drm_fb_lock(struct wlr_drm_fb *fb) {
 	return fb;
 }
 
+static bool fb_key_init(struct wlr_drm_fb_key *key,
+		const struct wlr_dmabuf_attributes *attribs) {
+	*key = (struct wlr_drm_fb_key){
+		.format = attribs->format,
+		.modifier = attribs->modifier,
+		.width = attribs->width,
+		.height = attribs->height,
+		.n_planes = attribs->n_planes,
+	};
+	for (int i = 0; i < attribs->n_planes; i++) {
+		struct stat st;
+		if (fstat(attribs->fd[i], &st) != 0) {
+			wlr_log_errno(WLR_DEBUG, "fstat failed");
+			return false;
+		}
+		key->planes[i].dev = st.st_dev;
+		key->planes[i].ino = st.st_ino;
+		key->planes[i].offset = attribs->offset[i];
+		key->planes[i].stride = attribs->stride[i];
+	}
+	return true;
+}
+
+static bool fb_key_equal(const struct wlr_drm_fb_key *a,
+		const struct wlr_drm_fb_key *b) {
+	if (a->format != b->format || a->modifier != b->modifier ||
+			a->width != b->width || a->height != b->height ||
+			a->n_planes != b->n_planes) {
+		return false;
+	}
+	for (int i = 0; i < a->n_planes; i++) {
+		if (a->planes[i].dev != b->planes[i].dev ||
+				a->planes[i].ino != b->planes[i].ino ||
+				a->planes[i].offset != b->planes[i].offset ||
+				a->planes[i].stride != b->planes[i].stride) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void fb_cache_insert(struct wlr_drm_fb *fb) {
+	struct wlr_drm_fb_cache *cache = &fb->backend->fb_cache;
+
+	wlr_addon_finish(&fb->addon);
+	fb->wlr_buf = NULL;
+	wl_list_insert(&cache->fbs, &fb->cache_link);
+	cache->len++;
+
+	if (cache->len > DRM_FB_CACHE_SIZE) {
+		struct wlr_drm_fb *lru = wl_container_of(cache->fbs.prev, lru, cache_link);
+		cache->evictions++;
+		drm_fb_destroy(lru);
+	}
+}
+
+static struct wlr_drm_fb *fb_cache_take(struct wlr_drm_backend *drm,
+		const struct wlr_drm_fb_key *key) {
+	struct wlr_drm_fb_cache *cache = &drm->fb_cache;
+
+	struct wlr_drm_fb *fb;
+	wl_list_for_each(fb, &cache->fbs, cache_link) {
+		if (fb_key_equal(&fb->key, key)) {
+			wl_list_remove(&fb->cache_link);
+			cache->len--;
+			cache->hits++;
+			return fb;
+		}
+	}
+
+	cache->misses++;
+	return NULL;
+}
+
 static void drm_fb_handle_destroy(struct wlr_addon *addon) {
 	struct wlr_drm_fb *fb = wl_container_of(addon, fb, addon);
-	drm_fb_destroy(fb);
+	if (fb->has_key) {
+		fb_cache_insert(fb);
+	} else {
+		drm_fb_destroy(fb);
+	}
 }
 
 static const struct wlr_addon_interface fb_addon_impl = {
@@ -176,6 +255,18 @@ static struct wlr_drm_fb *drm_fb_create(struct wlr_drm_backend *drm,
 		}
 	}
 
+	struct wlr_drm_fb_key key;
+	bool has_key = fb_key_init(&key, &attribs);
+	if (has_key) {
+		struct wlr_drm_fb *cached = fb_cache_take(drm, &key);
+		if (cached != NULL) {
+			free(fb);
+			cached->wlr_buf = buf;
+			wlr_addon_init(&cached->addon, &buf->addons, drm, &fb_addon_impl);
+			return cached;
+		}
+	}
+
 	uint32_t handles[4] = {0};
 	for (int i = 0; i < attribs.n_planes; ++i) {
 		int ret = drmPrimeFDToHandle(drm->fd, attribs.fd[i], &handles[i]);
@@ -196,6 +287,8 @@ static struct wlr_drm_fb *drm_fb_create(struct wlr_drm_backend *drm,
 
 	fb->backend = drm;
 	fb->wlr_buf = buf;
+	fb->has_key = has_key;
+	fb->key = key;
 
 	wlr_addon_init(&fb->addon, &buf->addons, drm, &fb_addon_impl);
 	wl_list_insert(&drm->fbs, &fb->link);
@@ -213,7 +306,12 @@ void drm_fb_destroy(struct wlr_drm_fb *fb) {
 	struct wlr_drm_backend *drm = fb->backend;
 
 	wl_list_remove(&fb->link);
-	wlr_addon_finish(&fb->addon);
+	if (fb->wlr_buf != NULL) {
+		wlr_addon_finish(&fb->addon);
+	} else {
+		wl_list_remove(&fb->cache_link);
+		drm->fb_cache.len--;
+	}
 
 	int ret = drmModeCloseFB(drm->fd, fb->id);
 	if (ret == -EINVAL) {
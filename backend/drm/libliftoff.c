@@ -1,7 +1,9 @@
 #include <fcntl.h>
 #include <libliftoff.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <wlr/util/box.h>
@@ -12,6 +14,7 @@
 #include "backend/drm/iface.h"
 #include "config.h"
 #include "types/wlr_output.h"
+#include "util/trace.h"
 
 static void log_handler(enum liftoff_log_priority priority, const char *fmt, va_list args) {
 	enum wlr_log_importance importance = WLR_SILENT;
@@ -180,8 +183,8 @@ static uint64_t to_fp16(double v) {
 }
 
 static bool set_layer_props(struct wlr_drm_backend *drm,
-		const struct wlr_output_layer_state *state, uint64_t zpos,
-		struct wl_array *fb_damage_clips_arr) {
+		struct wlr_drm_crtc *crtc, const struct wlr_output_layer_state *state,
+		uint64_t zpos, struct wl_array *fb_damage_clips_arr) {
 	struct wlr_drm_layer *layer = get_drm_layer(drm, state->layer);
 
 	uint32_t width = 0, height = 0;
@@ -194,7 +197,7 @@ static bool set_layer_props(struct wlr_drm_backend *drm,
 	int ret = 0;
 	if (state->buffer == NULL) {
 		ret = liftoff_layer_set_property(layer->liftoff, "FB_ID", 0);
-	} else if (fb == NULL) {
+	} else if (fb == NULL || crtc->overlay.yield_frames > 0) {
 		liftoff_layer_set_fb_composited(layer->liftoff);
 	} else {
 		ret = liftoff_layer_set_property(layer->liftoff, "FB_ID", fb->id);
@@ -232,6 +235,17 @@ static bool set_layer_props(struct wlr_drm_backend *drm,
 		*ptr = fb_damage_clips;
 	}
 
+	// Only planes with an "alpha" property can display translucent layers,
+	// opaque layers don't restrict the plane choice
+	if (state->alpha != NULL && *state->alpha != 1) {
+		uint64_t alpha = (uint64_t)round(*state->alpha * 0xFFFF);
+		if (liftoff_layer_set_property(layer->liftoff, "alpha", alpha) != 0) {
+			return false;
+		}
+	} else {
+		liftoff_layer_unset_property(layer->liftoff, "alpha");
+	}
+
 	return
 		liftoff_layer_set_property(layer->liftoff, "zpos", zpos) == 0 &&
 		liftoff_layer_set_property(layer->liftoff, "CRTC_X", crtc_x) == 0 &&
@@ -361,7 +375,7 @@ static bool add_connector(drmModeAtomicReq *req,
 		if (state->base->committed & WLR_OUTPUT_STATE_LAYERS) {
 			for (size_t i = 0; i < state->base->layers_len; i++) {
 				const struct wlr_output_layer_state *layer_state = &state->base->layers[i];
-				ok = ok && set_layer_props(drm, layer_state, i + 1,
+				ok = ok && set_layer_props(drm, crtc, layer_state, i + 1,
 					fb_damage_clips_arr);
 			}
 		}
@@ -413,6 +427,95 @@ static void connector_update_layers_feedback(const struct wlr_drm_connector_stat
 	}
 }
 
+// Number of frames a CRTC needs to be starved before planes are moved to it
+#define OVERLAY_STARVED_FRAMES 60
+// Number of frames during which a CRTC gives up its overlay planes
+#define OVERLAY_YIELD_FRAMES 120
+
+static uint64_t update_average(uint64_t avg, uint64_t value) {
+	return avg - avg / 8 + value / 8;
+}
+
+static void connector_update_overlay_usage(const struct wlr_drm_connector_state *state) {
+	struct wlr_drm_crtc *crtc = state->connector->crtc;
+
+	if (!state->active) {
+		memset(&crtc->overlay, 0, sizeof(crtc->overlay));
+		return;
+	}
+
+	if (crtc->overlay.yield_frames > 0) {
+		crtc->overlay.yield_frames--;
+	}
+
+	// Layers left untouched keep their planes
+	if (!(state->base->committed & WLR_OUTPUT_STATE_LAYERS)) {
+		return;
+	}
+
+	uint64_t offloaded = 0, composited = 0;
+	for (size_t i = 0; i < state->base->layers_len; i++) {
+		const struct wlr_output_layer_state *layer_state = &state->base->layers[i];
+		if (layer_state->buffer == NULL) {
+			continue;
+		}
+		uint64_t area = (uint64_t)layer_state->dst_box.width *
+			(uint64_t)layer_state->dst_box.height;
+		if (layer_state->accepted) {
+			offloaded += area;
+		} else {
+			composited += area;
+		}
+	}
+
+	crtc->overlay.offloaded_area = update_average(crtc->overlay.offloaded_area, offloaded);
+	crtc->overlay.composited_area = update_average(crtc->overlay.composited_area, composited);
+}
+
+/**
+ * Overlay planes go to the first CRTC grabbing them, and stay there as long as
+ * it has layers. When another CRTC consistently composites much larger layers
+ * (e.g. a fullscreen video), make the CRTC with the least offloaded area
+ * composite for a while so that its planes can be picked up.
+ */
+static void balance_overlay_planes(struct wlr_drm_backend *drm,
+		struct wlr_drm_crtc *starved) {
+	if (starved->overlay.composited_area == 0) {
+		starved->overlay.starved_frames = 0;
+		return;
+	}
+
+	struct wlr_drm_crtc *donor = NULL;
+	for (size_t i = 0; i < drm->num_crtcs; i++) {
+		struct wlr_drm_crtc *crtc = &drm->crtcs[i];
+		if (crtc == starved || crtc->overlay.offloaded_area == 0 ||
+				crtc->overlay.yield_frames > 0) {
+			continue;
+		}
+		if (donor == NULL ||
+				crtc->overlay.offloaded_area < donor->overlay.offloaded_area) {
+			donor = crtc;
+		}
+	}
+
+	// Only move planes for a clear win, to avoid bouncing them between CRTCs
+	if (donor == NULL ||
+			starved->overlay.composited_area < 2 * donor->overlay.offloaded_area) {
+		starved->overlay.starved_frames = 0;
+		return;
+	}
+
+	starved->overlay.starved_frames++;
+	if (starved->overlay.starved_frames < OVERLAY_STARVED_FRAMES) {
+		return;
+	}
+
+	wlr_log(WLR_DEBUG, "Moving overlay planes from CRTC %"PRIu32" to CRTC %"PRIu32,
+		donor->id, starved->id);
+	donor->overlay.yield_frames = OVERLAY_YIELD_FRAMES;
+	starved->overlay.starved_frames = 0;
+}
+
 static bool commit(struct wlr_drm_backend *drm,
 		const struct wlr_drm_device_state *state,
 		struct wlr_drm_page_flip *page_flip, uint32_t flags, bool test_only) {
@@ -475,7 +578,9 @@ static bool commit(struct wlr_drm_backend *drm,
 		}
 	}
 
+	trace_begin("drm_atomic_commit");
 	ok = drmModeAtomicCommit(drm->fd, req, flags, page_flip) == 0;
+	trace_end();
 	if (!ok) {
 		wlr_log_errno(test_only ? WLR_DEBUG : WLR_ERROR,
 			"Atomic commit failed");
@@ -488,6 +593,8 @@ out:
 		if (ok && !test_only) {
 			drm_atomic_connector_apply_commit(conn_state);
 			connector_update_layers_feedback(conn_state);
+			connector_update_overlay_usage(conn_state);
+			balance_overlay_planes(drm, conn_state->connector->crtc);
 		} else {
 			drm_atomic_connector_rollback_commit(conn_state);
 		}
@@ -495,9 +602,7 @@ out:
 
 	uint32_t *fb_damage_clips_ptr;
 	wl_array_for_each(fb_damage_clips_ptr, &fb_damage_clips_arr) {
-		if (drmModeDestroyPropertyBlob(drm->fd, *fb_damage_clips_ptr) != 0) {
-			wlr_log_errno(WLR_ERROR, "Failed to destroy FB_DAMAGE_CLIPS property blob");
-		}
+		drm_blob_cache_release(drm, *fb_damage_clips_ptr);
 	}
 	wl_array_release(&fb_damage_clips_arr);
 
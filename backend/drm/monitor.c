@@ -1,10 +1,186 @@
-#include <wlr/util/log.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
 #include "backend/drm/monitor.h"
 #include "backend/multi.h"
 #include "backend/session/session.h"
 
+/**
+ * Probing the connectors of a new device reads the EDID of every connected
+ * display, which can take hundreds of milliseconds for a dock with several
+ * displays. Force the probe on a worker thread: the kernel keeps the
+ * results, which the DRM backend then picks up without probing again.
+ */
+struct drm_device_probe {
+	struct wlr_drm_backend_monitor *monitor;
+	struct wlr_device *dev;
+	char *path;
+	struct wl_list link; // wlr_drm_backend_monitor.probes
+
+	pthread_t thread;
+	int fd; // owned by the thread
+	int done_fds[2]; // written by the thread once done
+	struct wl_event_source *done_source;
+
+	// Whether the device has been removed during the probe
+	bool removed;
+
+	struct wl_listener dev_remove;
+};
+
+static void *probe_run(void *data) {
+	struct drm_device_probe *probe = data;
+
+	drmModeRes *res = drmModeGetResources(probe->fd);
+	if (res != NULL) {
+		for (int i = 0; i < res->count_connectors; i++) {
+			drmModeFreeConnector(drmModeGetConnector(probe->fd, res->connectors[i]));
+		}
+		drmModeFreeResources(res);
+	}
+	close(probe->fd);
+
+	char byte = 0;
+	while (write(probe->done_fds[1], &byte, 1) < 0 && errno == EINTR) {
+		// Retry
+	}
+	return NULL;
+}
+
+static void probe_destroy(struct drm_device_probe *probe) {
+	pthread_join(probe->thread, NULL);
+	wl_event_source_remove(probe->done_source);
+	close(probe->done_fds[0]);
+	close(probe->done_fds[1]);
+	wl_list_remove(&probe->dev_remove.link);
+	wl_list_remove(&probe->link);
+	free(probe->path);
+	free(probe);
+}
+
+static void create_child_backend(struct wlr_drm_backend_monitor *backend_monitor,
+		struct wlr_device *dev, const char *path) {
+	wlr_log(WLR_DEBUG, "Creating DRM backend for %s after hotplug", path);
+	struct wlr_backend *child_drm = wlr_drm_backend_create(backend_monitor->session,
+		dev, backend_monitor->primary_drm);
+	if (!child_drm) {
+		wlr_log(WLR_ERROR, "Failed to create DRM backend after hotplug");
+		return;
+	}
+
+	if (!wlr_multi_backend_add(backend_monitor->multi, child_drm)) {
+		wlr_log(WLR_ERROR, "Failed to add new drm backend to multi backend");
+		wlr_backend_destroy(child_drm);
+		return;
+	}
+
+	if (!wlr_backend_start(child_drm)) {
+		wlr_log(WLR_ERROR, "Failed to start new child DRM backend");
+		wlr_backend_destroy(child_drm);
+	}
+}
+
+static int probe_handle_done(int fd, uint32_t mask, void *data) {
+	struct drm_device_probe *probe = data;
+	struct wlr_drm_backend_monitor *backend_monitor = probe->monitor;
+	struct wlr_device *dev = probe->dev;
+	char *path = probe->path;
+	bool removed = probe->removed;
+
+	probe->path = NULL;
+	probe_destroy(probe);
+
+	if (removed) {
+		wlr_log(WLR_DEBUG, "DRM device %s removed while probing", path);
+		wlr_session_close_file(backend_monitor->session, dev);
+	} else {
+		create_child_backend(backend_monitor, dev, path);
+	}
+	free(path);
+	return 0;
+}
+
+static void probe_handle_dev_remove(struct wl_listener *listener, void *data) {
+	struct drm_device_probe *probe = wl_container_of(listener, probe, dev_remove);
+	probe->removed = true;
+}
+
+static bool probe_start(struct wlr_drm_backend_monitor *backend_monitor,
+		struct wlr_device *dev, const char *path) {
+	struct drm_device_probe *probe = calloc(1, sizeof(*probe));
+	if (probe == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+
+	probe->monitor = backend_monitor;
+	probe->dev = dev;
+	probe->path = strdup(path);
+	if (probe->path == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		goto error_probe;
+	}
+
+	if (pipe(probe->done_fds) != 0) {
+		wlr_log_errno(WLR_ERROR, "pipe failed");
+		goto error_probe;
+	}
+	for (size_t i = 0; i < 2; i++) {
+		if (fcntl(probe->done_fds[i], F_SETFD, FD_CLOEXEC) != 0) {
+			wlr_log_errno(WLR_ERROR, "fcntl(FD_CLOEXEC) failed");
+			goto error_pipe;
+		}
+	}
+
+	probe->done_source = wl_event_loop_add_fd(backend_monitor->session->event_loop,
+		probe->done_fds[0], WL_EVENT_READABLE, probe_handle_done, probe);
+	if (probe->done_source == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add probe event source");
+		goto error_pipe;
+	}
+
+	probe->fd = fcntl(dev->fd, F_DUPFD_CLOEXEC, 0);
+	if (probe->fd < 0) {
+		wlr_log_errno(WLR_ERROR, "fcntl(F_DUPFD_CLOEXEC) failed");
+		goto error_source;
+	}
+
+	if (pthread_create(&probe->thread, NULL, probe_run, probe) != 0) {
+		wlr_log(WLR_ERROR, "Failed to create probe thread");
+		close(probe->fd);
+		goto error_source;
+	}
+
+	probe->dev_remove.notify = probe_handle_dev_remove;
+	wl_signal_add(&dev->events.remove, &probe->dev_remove);
+	wl_list_insert(&backend_monitor->probes, &probe->link);
+	return true;
+
+error_source:
+	wl_event_source_remove(probe->done_source);
+error_pipe:
+	close(probe->done_fds[0]);
+	close(probe->done_fds[1]);
+error_probe:
+	free(probe->path);
+	free(probe);
+	return false;
+}
+
 static void drm_backend_monitor_destroy(struct wlr_drm_backend_monitor* monitor) {
+	struct drm_device_probe *probe, *probe_tmp;
+	wl_list_for_each_safe(probe, probe_tmp, &monitor->probes, link) {
+		struct wlr_device *dev = probe->dev;
+		probe_destroy(probe);
+		wlr_session_close_file(monitor->session, dev);
+	}
+
 	wl_list_remove(&monitor->session_add_drm_card.link);
 	wl_list_remove(&monitor->session_destroy.link);
 	wl_list_remove(&monitor->primary_drm_destroy.link);
@@ -24,23 +200,9 @@ static void handle_add_drm_card(struct wl_listener *listener, void *data) {
 		return;
 	}
 
-	wlr_log(WLR_DEBUG, "Creating DRM backend for %s after hotplug", event->path);
-	struct wlr_backend *child_drm = wlr_drm_backend_create(backend_monitor->session,
-		dev, backend_monitor->primary_drm);
-	if (!child_drm) {
-		wlr_log(WLR_ERROR, "Failed to create DRM backend after hotplug");
-		return;
-	}
-
-	if (!wlr_multi_backend_add(backend_monitor->multi, child_drm)) {
-		wlr_log(WLR_ERROR, "Failed to add new drm backend to multi backend");
-		wlr_backend_destroy(child_drm);
-		return;
-	}
-
-	if (!wlr_backend_start(child_drm)) {
-		wlr_log(WLR_ERROR, "Failed to start new child DRM backend");
-		wlr_backend_destroy(child_drm);
+	if (!probe_start(backend_monitor, dev, event->path)) {
+		// Probe the connectors on the main thread instead
+		create_child_backend(backend_monitor, dev, event->path);
 	}
 }
 
@@ -74,6 +236,7 @@ struct wlr_drm_backend_monitor *drm_backend_monitor_create(
 	monitor->multi = multi;
 	monitor->primary_drm = primary_drm;
 	monitor->session = session;
+	wl_list_init(&monitor->probes);
 
 	monitor->session_add_drm_card.notify = handle_add_drm_card;
 	wl_signal_add(&session->events.add_drm_card, &monitor->session_add_drm_card);
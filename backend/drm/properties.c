@@ -24,6 +24,9 @@ static const struct prop_info connector_info[] = {
 	{ "DPMS", INDEX(dpms) },
 	{ "EDID", INDEX(edid) },
 	{ "PATH", INDEX(path) },
+	{ "WRITEBACK_FB_ID", INDEX(writeback_fb_id) },
+	{ "WRITEBACK_OUT_FENCE_PTR", INDEX(writeback_out_fence_ptr) },
+	{ "WRITEBACK_PIXEL_FORMATS", INDEX(writeback_pixel_formats) },
 	{ "content type", INDEX(content_type) },
 	{ "link-status", INDEX(link_status) },
 	{ "max bpc", INDEX(max_bpc) },
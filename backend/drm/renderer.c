@@ -4,6 +4,7 @@
 #include <wlr/render/drm_syncobj.h>
 #include <wlr/render/swapchain.h>
 #include <wlr/render/wlr_renderer.h>
+#include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #include "backend/drm/drm.h"
 #include "backend/drm/fb.h"
@@ -51,6 +52,8 @@ void finish_drm_surface(struct wlr_drm_surface *surf) {
 
 	wlr_drm_syncobj_timeline_unref(surf->timeline);
 	wlr_swapchain_destroy(surf->swapchain);
+	wlr_damage_ring_finish(&surf->damage_ring);
+	pixman_region32_fini(&surf->uncommitted_damage);
 
 	*surf = (struct wlr_drm_surface){0};
 }
@@ -82,13 +85,44 @@ bool init_drm_surface(struct wlr_drm_surface *surf,
 		}
 	}
 
+	wlr_damage_ring_init(&surf->damage_ring);
+	pixman_region32_init(&surf->uncommitted_damage);
 	surf->renderer = renderer;
 
 	return true;
 }
 
+void drm_surface_add_damage(struct wlr_drm_surface *surf,
+		const pixman_region32_t *damage) {
+	if (surf->renderer == NULL) {
+		return;
+	}
+
+	if (damage != NULL) {
+		wlr_damage_ring_add(&surf->damage_ring, damage);
+		wlr_damage_ring_add(&surf->damage_ring, &surf->uncommitted_damage);
+		pixman_region32_union(&surf->uncommitted_damage,
+			&surf->uncommitted_damage, damage);
+	} else {
+		int width = surf->swapchain->width, height = surf->swapchain->height;
+		wlr_damage_ring_add_box(&surf->damage_ring, &(struct wlr_box){
+			.width = width,
+			.height = height,
+		});
+		pixman_region32_union_rect(&surf->uncommitted_damage,
+			&surf->uncommitted_damage, 0, 0, width, height);
+	}
+}
+
+void drm_surface_mark_committed(struct wlr_drm_surface *surf) {
+	if (surf->renderer == NULL) {
+		return;
+	}
+	pixman_region32_clear(&surf->uncommitted_damage);
+}
+
 struct wlr_buffer *drm_surface_blit(struct wlr_drm_surface *surf,
-		struct wlr_buffer *buffer,
+		struct wlr_buffer *buffer, const pixman_region32_t *damage,
 		struct wlr_drm_syncobj_timeline *wait_timeline, uint64_t wait_point) {
 	struct wlr_renderer *renderer = surf->renderer->wlr_rend;
 
@@ -110,6 +144,12 @@ struct wlr_buffer *drm_surface_blit(struct wlr_drm_surface *surf,
 		goto error_tex;
 	}
 
+	// Only copy the region which differs from the buffer's previous contents
+	drm_surface_add_damage(surf, damage);
+	pixman_region32_t clip;
+	pixman_region32_init(&clip);
+	wlr_damage_ring_rotate_buffer(&surf->damage_ring, dst, &clip);
+
 	surf->point++;
 	const struct wlr_buffer_pass_options pass_options = {
 		.signal_timeline = surf->timeline,
@@ -124,6 +164,7 @@ struct wlr_buffer *drm_surface_blit(struct wlr_drm_surface *surf,
 	wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
 		.texture = tex,
 		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+		.clip = &clip,
 		.wait_timeline = wait_timeline,
 		.wait_point = wait_point,
 	});
@@ -132,11 +173,18 @@ struct wlr_buffer *drm_surface_blit(struct wlr_drm_surface *surf,
 		goto error_dst;
 	}
 
+	pixman_region32_fini(&clip);
 	wlr_texture_destroy(tex);
 
 	return dst;
 
 error_dst:
+	// The buffer contents are now undefined
+	wlr_damage_ring_add_box(&surf->damage_ring, &(struct wlr_box){
+		.width = dst->width,
+		.height = dst->height,
+	});
+	pixman_region32_fini(&clip);
 	wlr_buffer_unlock(dst);
 error_tex:
 	wlr_texture_destroy(tex);
@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <wlr/interfaces/wlr_output.h>
+#include <wlr/render/dmabuf.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_output_layer.h>
+#include "backend/drm/drm.h"
+#include "backend/drm/fb.h"
+#include "util/cache.h"
+
+// Output state fields whose contents aren't part of the key
+static const uint32_t UNCACHEABLE_OUTPUT_STATE = WLR_OUTPUT_STATE_GAMMA_LUT;
+
+#define HASH_VALUE(hash, value) cache_hash(hash, &(value), sizeof(value))
+
+// The outcome of a test only depends on the buffer layout, not on its contents
+static uint64_t hash_buffer(uint64_t hash, struct wlr_buffer *buffer) {
+	struct wlr_dmabuf_attributes dmabuf;
+	if (buffer == NULL || !wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+		return HASH_VALUE(hash, buffer);
+	}
+
+	hash = HASH_VALUE(hash, dmabuf.format);
+	hash = HASH_VALUE(hash, dmabuf.modifier);
+	hash = HASH_VALUE(hash, dmabuf.width);
+	hash = HASH_VALUE(hash, dmabuf.height);
+	hash = HASH_VALUE(hash, dmabuf.n_planes);
+	for (int i = 0; i < dmabuf.n_planes; i++) {
+		hash = HASH_VALUE(hash, dmabuf.offset[i]);
+		hash = HASH_VALUE(hash, dmabuf.stride[i]);
+	}
+	return hash;
+}
+
+static uint64_t hash_fb(uint64_t hash, struct wlr_drm_fb *fb) {
+	return hash_buffer(hash, fb != NULL ? fb->wlr_buf : NULL);
+}
+
+static uint64_t hash_connector_state(uint64_t hash,
+		const struct wlr_drm_connector_state *state) {
+	struct wlr_drm_connector *conn = state->connector;
+	const struct wlr_output_state *base = state->base;
+
+	uint32_t crtc_id = conn->crtc != NULL ? conn->crtc->id : 0;
+	hash = HASH_VALUE(hash, conn->id);
+	hash = HASH_VALUE(hash, crtc_id);
+	hash = HASH_VALUE(hash, base->committed);
+	hash = HASH_VALUE(hash, state->active);
+	hash = HASH_VALUE(hash, state->vrr_enabled);
+	if (state->active) {
+		hash = HASH_VALUE(hash, state->mode);
+	}
+
+	hash = hash_fb(hash, state->primary_fb);
+	hash = HASH_VALUE(hash, state->primary_viewport.src_box);
+	hash = HASH_VALUE(hash, state->primary_viewport.dst_box);
+
+	hash = HASH_VALUE(hash, conn->cursor_enabled);
+	if (conn->cursor_enabled) {
+		hash = hash_fb(hash, state->cursor_fb);
+	}
+
+	if (base->committed & WLR_OUTPUT_STATE_LAYERS) {
+		hash = HASH_VALUE(hash, base->layers_len);
+		for (size_t i = 0; i < base->layers_len; i++) {
+			const struct wlr_output_layer_state *layer_state = &base->layers[i];
+			hash = HASH_VALUE(hash, layer_state->layer);
+			hash = hash_buffer(hash, layer_state->buffer);
+			hash = HASH_VALUE(hash, layer_state->src_box);
+			hash = HASH_VALUE(hash, layer_state->dst_box);
+			// Planes may not support translucency, keep it apart from
+			// the default opacity
+			bool has_alpha = layer_state->alpha != NULL;
+			hash = HASH_VALUE(hash, has_alpha);
+			if (has_alpha) {
+				hash = HASH_VALUE(hash, *layer_state->alpha);
+			}
+		}
+	}
+
+	return hash;
+}
+
+bool drm_test_cache_get_key(const struct wlr_drm_device_state *state,
+		uint32_t flags, uint64_t *key) {
+	uint64_t hash = CACHE_HASH_INIT;
+	hash = HASH_VALUE(hash, state->modeset);
+	hash = HASH_VALUE(hash, flags);
+	for (size_t i = 0; i < state->connectors_len; i++) {
+		const struct wlr_drm_connector_state *conn_state = &state->connectors[i];
+		if (conn_state->base->committed & UNCACHEABLE_OUTPUT_STATE) {
+			return false;
+		}
+		hash = hash_connector_state(hash, conn_state);
+	}
+	*key = hash;
+	return true;
+}
+
+bool drm_test_cache_has_failed(struct wlr_drm_test_cache *cache, uint64_t key) {
+	for (size_t i = 0; i < cache->len; i++) {
+		if (cache->failed[i] == key) {
+			cache->hits++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void drm_test_cache_add_failure(struct wlr_drm_test_cache *cache, uint64_t key) {
+	cache->failed[cache->next] = key;
+	cache->next = (cache->next + 1) % DRM_TEST_CACHE_SIZE;
+	if (cache->len < DRM_TEST_CACHE_SIZE) {
+		cache->len++;
+	}
+}
+
+void drm_test_cache_clear(struct wlr_drm_test_cache *cache) {
+	cache->len = 0;
+	cache->next = 0;
+}
@@ -5,6 +5,7 @@
 #include <libdisplay-info/cvt.h>
 #include <libdisplay-info/edid.h>
 #include <libdisplay-info/info.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -59,6 +60,8 @@ void parse_edid(struct wlr_drm_connector *conn, size_t len, const uint8_t *data)
 	output->make = NULL;
 	output->model = NULL;
 	output->serial = NULL;
+	conn->vrr_min_refresh = 0;
+	conn->vrr_max_refresh = 0;
 
 	struct di_info *info = di_info_parse_edid(data, len);
 	if (info == NULL) {
@@ -83,6 +86,22 @@ void parse_edid(struct wlr_drm_connector *conn, size_t len, const uint8_t *data)
 	output->model = di_info_get_model(info);
 	output->serial = di_info_get_serial(info);
 
+	const struct di_edid_display_descriptor *const *descs =
+		di_edid_get_display_descriptors(edid);
+	for (size_t i = 0; descs[i] != NULL; i++) {
+		if (di_edid_display_descriptor_get_tag(descs[i]) !=
+				DI_EDID_DISPLAY_DESCRIPTOR_RANGE_LIMITS) {
+			continue;
+		}
+		const struct di_edid_display_range_limits *limits =
+			di_edid_display_descriptor_get_range_limits(descs[i]);
+		if (limits->min_vert_rate_hz > 0 &&
+				limits->max_vert_rate_hz > limits->min_vert_rate_hz) {
+			conn->vrr_min_refresh = limits->min_vert_rate_hz * 1000;
+			conn->vrr_max_refresh = limits->max_vert_rate_hz * 1000;
+		}
+	}
+
 	di_info_destroy(info);
 }
 
@@ -98,143 +117,114 @@ const char *drm_connector_status_str(drmModeConnection status) {
 	return "<unsupported>";
 }
 
-static bool is_taken(size_t n, const uint32_t arr[static n], uint32_t key) {
-	for (size_t i = 0; i < n; ++i) {
-		if (arr[i] == key) {
-			return true;
-		}
+/*
+ * Weight of matching a CRTC with a connector: matching a connector which needs
+ * a CRTC always wins over keeping the previous assignment, which in turn wins
+ * over leaving the CRTC unmatched.
+ */
+static int64_t match_weight(size_t num_crtcs, const uint32_t *conns,
+		const uint32_t *prev_crtcs, size_t crtc_index, size_t conn_index) {
+	int64_t weight = 0;
+	if (conns[conn_index] & (1 << crtc_index)) {
+		weight += num_crtcs + 1;
+	}
+	if (prev_crtcs[crtc_index] == conn_index) {
+		weight += 1;
 	}
-	return false;
+	return weight;
 }
 
 /*
- * Store all of the non-recursive state in a struct, so we aren't literally
- * passing 12 arguments to a function.
- */
-struct match_state {
-	const size_t num_conns;
-	const uint32_t *restrict conns;
-	const size_t num_crtcs;
-	size_t score;
-	size_t replaced;
-	uint32_t *restrict res;
-	uint32_t *restrict best;
-	const uint32_t *restrict orig;
-	bool exit_early;
-};
-
-/**
- * Step to process a CRTC.
- *
- * This is a naive implementation of maximum bipartite matching.
- *
- * score: The number of connectors we've matched so far.
- * replaced: The number of changes from the original solution.
- * crtc_index: The index of the current CRTC.
- *
- * This tries to match a solution as close to st->orig as it can.
- *
- * Returns whether we've set a new best element with this solution.
+ * This is a maximum weight bipartite matching, solved with the Hungarian
+ * algorithm in O(n³) where n is the largest of the number of CRTCs and
+ * connectors. The matrix is padded to a square one with zero weights.
  */
-static bool match_connectors_with_crtcs_(struct match_state *st,
-		size_t score, size_t replaced, size_t crtc_index) {
-	// Finished
-	if (crtc_index >= st->num_crtcs) {
-		if (score > st->score ||
-				(score == st->score && replaced < st->replaced)) {
-			st->score = score;
-			st->replaced = replaced;
-			memcpy(st->best, st->res, sizeof(st->best[0]) * st->num_crtcs);
-
-			st->exit_early = (st->score == st->num_crtcs
-					|| st->score == st->num_conns)
-					&& st->replaced == 0;
-
-			return true;
-		} else {
-			return false;
-		}
+void match_connectors_with_crtcs(size_t num_conns,
+		const uint32_t conns[static restrict num_conns],
+		size_t num_crtcs, const uint32_t prev_crtcs[static restrict num_crtcs],
+		uint32_t new_crtcs[static restrict num_crtcs]) {
+	for (size_t i = 0; i < num_crtcs; ++i) {
+		new_crtcs[i] = UNMATCHED;
 	}
 
-	bool has_best = false;
-
-	/*
-	 * Attempt to use the current solution first, to try and avoid
-	 * recalculating everything
-	 */
-	if (st->orig[crtc_index] != UNMATCHED && !is_taken(crtc_index, st->res, st->orig[crtc_index])) {
-		st->res[crtc_index] = st->orig[crtc_index];
-		size_t crtc_score = st->conns[st->res[crtc_index]] != 0 ? 1 : 0;
-		if (match_connectors_with_crtcs_(st, score + crtc_score, replaced, crtc_index + 1)) {
-			has_best = true;
-		}
-	}
-	if (st->exit_early) {
-		return true;
+	size_t n = num_crtcs > num_conns ? num_crtcs : num_conns;
+	if (n == 0) {
+		return;
 	}
 
-	if (st->orig[crtc_index] != UNMATCHED) {
-		++replaced;
+	// Turn the weights into costs to minimize
+	const int64_t max_weight = num_crtcs + 2;
+	const int64_t inf = INT64_MAX / 4;
+
+	// Rows are CRTCs, columns are connectors, both 1-indexed
+	int64_t u[n + 1], v[n + 1], min_cost[n + 1];
+	size_t row_of_col[n + 1], way[n + 1];
+	bool used[n + 1];
+	for (size_t j = 0; j <= n; ++j) {
+		u[j] = v[j] = 0;
+		row_of_col[j] = way[j] = 0;
 	}
 
-	for (size_t candidate = 0; candidate < st->num_conns; ++candidate) {
-		// We tried this earlier
-		if (candidate == st->orig[crtc_index]) {
-			continue;
+	for (size_t row = 1; row <= n; ++row) {
+		row_of_col[0] = row;
+		size_t col0 = 0;
+		for (size_t j = 0; j <= n; ++j) {
+			min_cost[j] = inf;
+			used[j] = false;
 		}
 
-		// Not compatible
-		if (!(st->conns[candidate] & (1 << crtc_index))) {
-			continue;
-		}
+		do {
+			used[col0] = true;
+			size_t row0 = row_of_col[col0];
+			int64_t delta = inf;
+			size_t col1 = 0;
+			for (size_t j = 1; j <= n; ++j) {
+				if (used[j]) {
+					continue;
+				}
+				int64_t weight = 0;
+				if (row0 <= num_crtcs && j <= num_conns) {
+					weight = match_weight(num_crtcs, conns, prev_crtcs,
+						row0 - 1, j - 1);
+				}
+				int64_t cur = max_weight - weight - u[row0] - v[j];
+				if (cur < min_cost[j]) {
+					min_cost[j] = cur;
+					way[j] = col0;
+				}
+				if (min_cost[j] < delta) {
+					delta = min_cost[j];
+					col1 = j;
+				}
+			}
+			for (size_t j = 0; j <= n; ++j) {
+				if (used[j]) {
+					u[row_of_col[j]] += delta;
+					v[j] -= delta;
+				} else {
+					min_cost[j] -= delta;
+				}
+			}
+			col0 = col1;
+		} while (row_of_col[col0] != 0);
+
+		do {
+			size_t col1 = way[col0];
+			row_of_col[col0] = row_of_col[col1];
+			col0 = col1;
+		} while (col0 != 0);
+	}
 
-		// Already taken
-		if (is_taken(crtc_index, st->res, candidate)) {
+	for (size_t j = 1; j <= num_conns; ++j) {
+		size_t row = row_of_col[j];
+		if (row == 0 || row > num_crtcs) {
 			continue;
 		}
-
-		st->res[crtc_index] = candidate;
-		size_t crtc_score = st->conns[candidate] != 0 ? 1 : 0;
-		if (match_connectors_with_crtcs_(st, score + crtc_score, replaced, crtc_index + 1)) {
-			has_best = true;
+		// Zero-weight pairs are padding, the CRTC stays unmatched
+		if (match_weight(num_crtcs, conns, prev_crtcs, row - 1, j - 1) > 0) {
+			new_crtcs[row - 1] = j - 1;
 		}
-
-		if (st->exit_early) {
-			return true;
-		}
-	}
-
-	// Maybe this CRTC can't be matched
-	st->res[crtc_index] = UNMATCHED;
-	if (match_connectors_with_crtcs_(st, score, replaced, crtc_index + 1)) {
-		has_best = true;
-	}
-
-	return has_best;
-}
-
-void match_connectors_with_crtcs(size_t num_conns,
-		const uint32_t conns[static restrict num_conns],
-		size_t num_crtcs, const uint32_t prev_crtcs[static restrict num_crtcs],
-		uint32_t new_crtcs[static restrict num_crtcs]) {
-	uint32_t solution[num_crtcs];
-	for (size_t i = 0; i < num_crtcs; ++i) {
-		solution[i] = UNMATCHED;
 	}
-
-	struct match_state st = {
-		.num_conns = num_conns,
-		.num_crtcs = num_crtcs,
-		.score = 0,
-		.replaced = SIZE_MAX,
-		.conns = conns,
-		.res = solution,
-		.best = new_crtcs,
-		.orig = prev_crtcs,
-		.exit_early = false,
-	};
-
-	match_connectors_with_crtcs_(&st, 0, 0, 0);
 }
 
 void generate_cvt_mode(drmModeModeInfo *mode, int hdisplay, int vdisplay,
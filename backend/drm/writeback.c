@@ -0,0 +1,314 @@
+#include <drm_fourcc.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/util/log.h>
+#include <xf86drmMode.h>
+#include "backend/drm/drm.h"
+#include "backend/drm/fb.h"
+#include "backend/drm/iface.h"
+
+static void writeback_connector_destroy(struct wlr_drm_writeback_connector *wb_conn) {
+	wl_list_remove(&wb_conn->link);
+	free(wb_conn->formats);
+	free(wb_conn);
+}
+
+static struct wlr_drm_writeback_connector *writeback_connector_create(
+		struct wlr_drm_backend *drm, const drmModeConnector *drm_conn) {
+	struct wlr_drm_writeback_connector *wb_conn = calloc(1, sizeof(*wb_conn));
+	if (wb_conn == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	wb_conn->id = drm_conn->connector_id;
+	if (!get_drm_connector_props(drm->fd, wb_conn->id, &wb_conn->props)) {
+		free(wb_conn);
+		return NULL;
+	}
+	if (wb_conn->props.crtc_id == 0 || wb_conn->props.writeback_fb_id == 0 ||
+			wb_conn->props.writeback_out_fence_ptr == 0 ||
+			wb_conn->props.writeback_pixel_formats == 0) {
+		wlr_log(WLR_DEBUG, "Writeback connector %"PRIu32" is missing "
+			"properties", wb_conn->id);
+		free(wb_conn);
+		return NULL;
+	}
+
+	size_t formats_size = 0;
+	wb_conn->formats = get_drm_prop_blob(drm->fd, wb_conn->id,
+		wb_conn->props.writeback_pixel_formats, &formats_size);
+	if (wb_conn->formats == NULL) {
+		wlr_log(WLR_DEBUG, "Failed to read formats of writeback connector %"PRIu32,
+			wb_conn->id);
+		free(wb_conn);
+		return NULL;
+	}
+	wb_conn->formats_len = formats_size / sizeof(wb_conn->formats[0]);
+
+	wb_conn->possible_crtcs = drmModeConnectorGetPossibleCrtcs(drm->fd, drm_conn);
+
+	wl_list_insert(drm->writeback_connectors.prev, &wb_conn->link);
+	return wb_conn;
+}
+
+void init_drm_writeback_connectors(struct wlr_drm_backend *drm) {
+	// Submitting writeback jobs is only implemented for the atomic interface
+	if (drm->iface != &atomic_iface) {
+		return;
+	}
+
+	drmModeRes *res = drmModeGetResources(drm->fd);
+	if (res == NULL) {
+		wlr_log_errno(WLR_ERROR, "Failed to get DRM resources");
+		return;
+	}
+
+	for (int i = 0; i < res->count_connectors; i++) {
+		drmModeConnector *drm_conn =
+			drmModeGetConnectorCurrent(drm->fd, res->connectors[i]);
+		if (drm_conn == NULL) {
+			continue;
+		}
+		if (drm_conn->connector_type == DRM_MODE_CONNECTOR_WRITEBACK &&
+				writeback_connector_create(drm, drm_conn) != NULL) {
+			wlr_log(WLR_INFO, "Found writeback connector %"PRIu32,
+				drm_conn->connector_id);
+		}
+		drmModeFreeConnector(drm_conn);
+	}
+
+	drmModeFreeResources(res);
+}
+
+void finish_drm_writeback_connectors(struct wlr_drm_backend *drm) {
+	struct wlr_drm_writeback_connector *wb_conn, *tmp;
+	wl_list_for_each_safe(wb_conn, tmp, &drm->writeback_connectors, link) {
+		writeback_connector_destroy(wb_conn);
+	}
+}
+
+bool drm_is_writeback_connector(struct wlr_drm_backend *drm, uint32_t id) {
+	struct wlr_drm_writeback_connector *wb_conn;
+	wl_list_for_each(wb_conn, &drm->writeback_connectors, link) {
+		if (wb_conn->id == id) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool writeback_connector_supports_format(
+		const struct wlr_drm_writeback_connector *wb_conn, uint32_t format) {
+	for (size_t i = 0; i < wb_conn->formats_len; i++) {
+		if (wb_conn->formats[i] == format) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool writeback_connector_is_usable(
+		const struct wlr_drm_writeback_connector *wb_conn,
+		struct wlr_drm_backend *drm, struct wlr_drm_crtc *crtc, uint32_t format) {
+	size_t crtc_index = crtc - drm->crtcs;
+	return (wb_conn->possible_crtcs & (1 << crtc_index)) &&
+		writeback_connector_supports_format(wb_conn, format);
+}
+
+static uint32_t writeback_get_format(struct wlr_drm_writeback *writeback) {
+	struct wlr_dmabuf_attributes dmabuf = {0};
+	if (!wlr_buffer_get_dmabuf(writeback->buffer, &dmabuf)) {
+		return DRM_FORMAT_INVALID;
+	}
+	return dmabuf.format;
+}
+
+static void writeback_finish(struct wlr_drm_writeback *writeback, bool success) {
+	if (writeback->out_fence_source != NULL) {
+		wl_event_source_remove(writeback->out_fence_source);
+		writeback->out_fence_source = NULL;
+	}
+	if (writeback->out_fence_fd >= 0) {
+		close(writeback->out_fence_fd);
+		writeback->out_fence_fd = -1;
+	}
+	// The kernel holds its own reference to the FB until the job is over
+	drm_fb_clear(&writeback->fb);
+
+	wl_list_remove(&writeback->link);
+	wl_list_init(&writeback->link);
+	writeback->conn = NULL;
+
+	writeback->success = success;
+	wl_signal_emit_mutable(&writeback->events.done, writeback);
+}
+
+static int handle_out_fence(int fd, uint32_t mask, void *data) {
+	struct wlr_drm_writeback *writeback = data;
+	writeback_finish(writeback, !(mask & WL_EVENT_ERROR));
+	return 0;
+}
+
+bool drm_connector_prepare_writeback(struct wlr_drm_connector_state *state,
+		bool *needs_modeset) {
+	struct wlr_drm_connector *conn = state->connector;
+	struct wlr_drm_backend *drm = conn->backend;
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	*needs_modeset = false;
+	if (!state->active || crtc == NULL) {
+		return false;
+	}
+
+	struct wlr_drm_writeback *writeback = NULL, *iter;
+	wl_list_for_each(iter, &conn->writebacks, link) {
+		if (!iter->submitted) {
+			writeback = iter;
+			break;
+		}
+	}
+	if (writeback == NULL) {
+		return false;
+	}
+
+	uint32_t format = writeback_get_format(writeback);
+	struct wlr_drm_writeback_connector *wb_conn = crtc->writeback;
+	if (wb_conn == NULL) {
+		struct wlr_drm_writeback_connector *candidate;
+		wl_list_for_each(candidate, &drm->writeback_connectors, link) {
+			if (candidate->crtc == NULL &&
+					writeback_connector_is_usable(candidate, drm, crtc, format)) {
+				wb_conn = candidate;
+				break;
+			}
+		}
+		*needs_modeset = wb_conn != NULL;
+	} else if (!writeback_connector_supports_format(wb_conn, format)) {
+		wb_conn = NULL;
+	}
+
+	// Without a writeback connector the job fails once the commit is done
+	state->writeback = writeback;
+	state->writeback_conn = wb_conn;
+	return wb_conn != NULL;
+}
+
+void drm_connector_finish_writeback(struct wlr_drm_connector_state *state,
+		bool committed) {
+	struct wlr_drm_connector *conn = state->connector;
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	if (committed && !state->active && crtc != NULL && crtc->writeback != NULL) {
+		crtc->writeback->crtc = NULL;
+		crtc->writeback = NULL;
+	}
+
+	struct wlr_drm_writeback *writeback = state->writeback;
+	if (writeback == NULL) {
+		return;
+	}
+	state->writeback = NULL;
+
+	if (!committed || state->writeback_conn == NULL) {
+		writeback_finish(writeback, false);
+		return;
+	}
+
+	struct wlr_drm_writeback_connector *wb_conn = state->writeback_conn;
+	wb_conn->crtc = crtc;
+	crtc->writeback = wb_conn;
+
+	writeback->submitted = true;
+	writeback->out_fence_fd = state->writeback_out_fence_fd;
+	state->writeback_out_fence_fd = -1;
+	if (writeback->out_fence_fd < 0) {
+		writeback_finish(writeback, false);
+		return;
+	}
+
+	writeback->out_fence_source = wl_event_loop_add_fd(
+		conn->backend->session->event_loop, writeback->out_fence_fd,
+		WL_EVENT_READABLE, handle_out_fence, writeback);
+	if (writeback->out_fence_source == NULL) {
+		wlr_drm_conn_log(conn, WLR_ERROR, "Failed to add writeback fence to event loop");
+		writeback_finish(writeback, false);
+	}
+}
+
+void drm_connector_fail_writebacks(struct wlr_drm_connector *conn) {
+	struct wlr_drm_writeback *writeback, *tmp;
+	wl_list_for_each_safe(writeback, tmp, &conn->writebacks, link) {
+		writeback_finish(writeback, false);
+	}
+}
+
+struct wlr_drm_writeback *wlr_drm_writeback_create(struct wlr_output *output,
+		struct wlr_buffer *buffer) {
+	if (!wlr_output_is_drm(output)) {
+		return NULL;
+	}
+	struct wlr_drm_connector *conn = wl_container_of(output, conn, output);
+	struct wlr_drm_backend *drm = conn->backend;
+
+	if (buffer->width != output->width || buffer->height != output->height) {
+		return NULL;
+	}
+
+	struct wlr_dmabuf_attributes dmabuf = {0};
+	if (!wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+		return NULL;
+	}
+
+	bool supported = false;
+	struct wlr_drm_writeback_connector *wb_conn;
+	wl_list_for_each(wb_conn, &drm->writeback_connectors, link) {
+		if ((wb_conn->possible_crtcs & conn->possible_crtcs) &&
+				writeback_connector_supports_format(wb_conn, dmabuf.format)) {
+			supported = true;
+			break;
+		}
+	}
+	if (!supported) {
+		return NULL;
+	}
+
+	struct wlr_drm_writeback *writeback = calloc(1, sizeof(*writeback));
+	if (writeback == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	if (!drm_fb_import(&writeback->fb, drm, buffer, NULL)) {
+		wlr_drm_conn_log(conn, WLR_DEBUG, "Failed to import writeback buffer");
+		free(writeback);
+		return NULL;
+	}
+
+	writeback->output = output;
+	writeback->buffer = buffer;
+	writeback->conn = conn;
+	writeback->out_fence_fd = -1;
+	wl_signal_init(&writeback->events.done);
+	wl_list_insert(conn->writebacks.prev, &writeback->link);
+
+	return writeback;
+}
+
+void wlr_drm_writeback_destroy(struct wlr_drm_writeback *writeback) {
+	if (writeback == NULL) {
+		return;
+	}
+
+	if (writeback->out_fence_source != NULL) {
+		wl_event_source_remove(writeback->out_fence_source);
+	}
+	if (writeback->out_fence_fd >= 0) {
+		close(writeback->out_fence_fd);
+	}
+	drm_fb_clear(&writeback->fb);
+	wl_list_remove(&writeback->link);
+	free(writeback);
+}
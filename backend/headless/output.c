@@ -2,10 +2,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <wlr/interfaces/wlr_output.h>
+#include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_output_layer.h>
 #include <wlr/util/log.h>
 #include "backend/headless.h"
 #include "types/wlr_output.h"
+#include "util/time.h"
 
 static const uint32_t SUPPORTED_OUTPUT_STATE =
 	WLR_OUTPUT_STATE_BACKEND_OPTIONAL |
@@ -28,7 +30,54 @@ static void output_update_refresh(struct wlr_headless_output *output,
 		refresh = HEADLESS_DEFAULT_REFRESH;
 	}
 
-	output->frame_delay = 1000000 / refresh;
+	output->frame_period = 1000000000000ll / refresh;
+}
+
+static int signal_frame(void *data) {
+	struct wlr_headless_output *output = data;
+	wlr_output_send_frame(&output->wlr_output);
+	return 0;
+}
+
+static void handle_frame_idle(void *data) {
+	struct wlr_headless_output *output = data;
+	output->frame_idle = NULL;
+	signal_frame(output);
+}
+
+static void schedule_frame_idle(struct wlr_headless_output *output) {
+	if (output->frame_idle == NULL) {
+		output->frame_idle = wl_event_loop_add_idle(output->backend->event_loop,
+			handle_frame_idle, output);
+	}
+}
+
+// Schedules the next frame event, and returns the virtual vblank sequence
+// number and time of the current commit
+static void schedule_frame(struct wlr_headless_output *output,
+		unsigned *seq, struct timespec *when) {
+	clock_gettime(CLOCK_MONOTONIC, when);
+	if (output->unthrottled) {
+		*seq = 0;
+		schedule_frame_idle(output);
+		return;
+	}
+
+	struct timespec elapsed_ts;
+	timespec_sub(&elapsed_ts, when, &output->vblank_base);
+	int64_t elapsed = timespec_to_nsec(&elapsed_ts);
+	int64_t vblank = elapsed / output->frame_period + 1;
+	*seq = (unsigned)vblank;
+
+	// wl_event_loop timers have a millisecond granularity: fall back to an
+	// idle source for shorter delays, so that high refresh rates work
+	int64_t delay = vblank * output->frame_period - elapsed;
+	if (delay < 1000000) {
+		schedule_frame_idle(output);
+	} else {
+		wl_event_source_timer_update(output->frame_timer,
+			(delay + 999999) / 1000000);
+	}
 }
 
 static bool output_test(struct wlr_output *wlr_output,
@@ -53,6 +102,31 @@ static bool output_test(struct wlr_output *wlr_output,
 	return true;
 }
 
+static void output_export_frame(struct wlr_headless_output *output,
+		const struct wlr_output_state *state) {
+	struct wlr_buffer *buffer = state->buffer;
+	if (output->frame == NULL || buffer->width != output->frame->width ||
+			buffer->height != output->frame->height ||
+			!(state->committed & WLR_OUTPUT_STATE_DAMAGE)) {
+		pixman_region32_union_rect(&output->frame_damage, &output->frame_damage,
+			0, 0, buffer->width, buffer->height);
+	} else {
+		pixman_region32_union(&output->frame_damage, &output->frame_damage,
+			&state->damage);
+	}
+	pixman_region32_intersect_rect(&output->frame_damage, &output->frame_damage,
+		0, 0, buffer->width, buffer->height);
+
+	wlr_buffer_unlock(output->frame);
+	output->frame = wlr_buffer_lock(buffer);
+}
+
+static void output_clear_frame(struct wlr_headless_output *output) {
+	wlr_buffer_unlock(output->frame);
+	output->frame = NULL;
+	pixman_region32_clear(&output->frame_damage);
+}
+
 static bool output_commit(struct wlr_output *wlr_output,
 		const struct wlr_output_state *state) {
 	struct wlr_headless_output *output =
@@ -66,14 +140,22 @@ static bool output_commit(struct wlr_output *wlr_output,
 		output_update_refresh(output, state->custom_mode.refresh);
 	}
 
+	if (output->export_frames) {
+		if (!output_pending_enabled(wlr_output, state)) {
+			output_clear_frame(output);
+		} else if (state->committed & WLR_OUTPUT_STATE_BUFFER) {
+			output_export_frame(output, state);
+		}
+	}
+
 	if (output_pending_enabled(wlr_output, state)) {
 		struct wlr_output_event_present present_event = {
 			.commit_seq = wlr_output->commit_seq + 1,
 			.presented = true,
+			.refresh = output->unthrottled ? 0 : output->frame_period,
 		};
+		schedule_frame(output, &present_event.seq, &present_event.when);
 		output_defer_present(wlr_output, present_event);
-
-		wl_event_source_timer_update(output->frame_timer, output->frame_delay);
 	}
 
 	return true;
@@ -84,8 +166,13 @@ static void output_destroy(struct wlr_output *wlr_output) {
 
 	wlr_output_finish(wlr_output);
 
+	wlr_buffer_unlock(output->frame);
+	pixman_region32_fini(&output->frame_damage);
 	wl_list_remove(&output->link);
 	wl_event_source_remove(output->frame_timer);
+	if (output->frame_idle != NULL) {
+		wl_event_source_remove(output->frame_idle);
+	}
 	free(output);
 }
 
@@ -99,10 +186,36 @@ bool wlr_output_is_headless(struct wlr_output *wlr_output) {
 	return wlr_output->impl == &output_impl;
 }
 
-static int signal_frame(void *data) {
-	struct wlr_headless_output *output = data;
-	wlr_output_send_frame(&output->wlr_output);
-	return 0;
+void wlr_headless_output_set_unthrottled(struct wlr_output *wlr_output,
+		bool unthrottled) {
+	struct wlr_headless_output *output = headless_output_from_output(wlr_output);
+	output->unthrottled = unthrottled;
+}
+
+void wlr_headless_output_set_export_frames(struct wlr_output *wlr_output,
+		bool export_frames) {
+	struct wlr_headless_output *output = headless_output_from_output(wlr_output);
+	output->export_frames = export_frames;
+	if (!export_frames) {
+		output_clear_frame(output);
+	}
+}
+
+struct wlr_buffer *wlr_headless_output_lock_frame(struct wlr_output *wlr_output,
+		pixman_region32_t *damage) {
+	struct wlr_headless_output *output = headless_output_from_output(wlr_output);
+	if (output->frame == NULL) {
+		if (damage != NULL) {
+			pixman_region32_clear(damage);
+		}
+		return NULL;
+	}
+
+	if (damage != NULL) {
+		pixman_region32_copy(damage, &output->frame_damage);
+	}
+	pixman_region32_clear(&output->frame_damage);
+	return wlr_buffer_lock(output->frame);
 }
 
 struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
@@ -116,6 +229,7 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 		return NULL;
 	}
 	output->backend = backend;
+	pixman_region32_init(&output->frame_damage);
 	struct wlr_output *wlr_output = &output->wlr_output;
 
 	struct wlr_output_state state;
@@ -126,6 +240,7 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 	wlr_output_state_finish(&state);
 
 	output_update_refresh(output, 0);
+	clock_gettime(CLOCK_MONOTONIC, &output->vblank_base);
 
 	size_t output_num = ++last_output_num;
 
@@ -46,19 +46,37 @@ static const struct libinput_interface libinput_impl = {
 	.close_restricted = libinput_close_restricted
 };
 
+// Upper bound on the number of libinput dispatches per wakeup, so that a
+// flood of events can't starve the rest of the event loop
+#define MAX_DISPATCHES_PER_WAKEUP 4
+
+// libinput contexts aren't thread-safe, and compositors configure devices
+// through wlr_libinput_get_device_handle() from the main thread, so events are
+// read here rather than on a dedicated thread. The kernel timestamps evdev
+// events on arrival and buffers them until they are read.
 static int handle_libinput_readable(int fd, uint32_t mask, void *_backend) {
 	struct wlr_libinput_backend *backend = _backend;
-	int ret = libinput_dispatch(backend->libinput_context);
-	if (ret != 0) {
-		wlr_log(WLR_ERROR, "Failed to dispatch libinput: %s", strerror(-ret));
-		wlr_backend_destroy(&backend->backend);
-		return 0;
-	}
-	struct libinput_event *event;
-	while ((event = libinput_get_event(backend->libinput_context))) {
-		handle_libinput_event(backend, event);
-		libinput_event_destroy(event);
+	// Events which arrived while the previous batch was being handled are
+	// read right away instead of waiting for the next wakeup, and their
+	// relative motion is merged with the pending one
+	for (int i = 0; i < MAX_DISPATCHES_PER_WAKEUP; i++) {
+		int ret = libinput_dispatch(backend->libinput_context);
+		if (ret != 0) {
+			wlr_log(WLR_ERROR, "Failed to dispatch libinput: %s", strerror(-ret));
+			wlr_backend_destroy(&backend->backend);
+			return 0;
+		}
+
+		struct libinput_event *event = libinput_get_event(backend->libinput_context);
+		if (event == NULL) {
+			break;
+		}
+		do {
+			handle_libinput_event(backend, event);
+			libinput_event_destroy(event);
+		} while ((event = libinput_get_event(backend->libinput_context)));
 	}
+	flush_pointer_motion(backend);
 	return 0;
 }
 
@@ -116,7 +134,7 @@ static bool backend_start(struct wlr_backend *wlr_backend) {
 	if (backend->input_event) {
 		wl_event_source_remove(backend->input_event);
 	}
-	backend->input_event = wl_event_loop_add_fd(backend->session->event_loop, libinput_fd,
+	backend->input_event = wl_event_loop_add_fd(backend->session->priority_event_loop, libinput_fd,
 			WL_EVENT_READABLE, handle_libinput_readable, backend);
 	if (!backend->input_event) {
 		wlr_log(WLR_ERROR, "Failed to create input event on event loop");
@@ -147,6 +147,10 @@ void handle_libinput_event(struct wlr_libinput_backend *backend,
 		return;
 	}
 
+	if (event_type != LIBINPUT_EVENT_POINTER_MOTION) {
+		flush_pointer_motion(backend);
+	}
+
 	switch (event_type) {
 	case LIBINPUT_EVENT_DEVICE_ADDED:
 		handle_device_added(backend, libinput_dev);
@@ -158,7 +162,7 @@ void handle_libinput_event(struct wlr_libinput_backend *backend,
 		handle_keyboard_key(event, &dev->keyboard);
 		break;
 	case LIBINPUT_EVENT_POINTER_MOTION:
-		handle_pointer_motion(event, &dev->pointer);
+		handle_pointer_motion(backend, event, &dev->pointer);
 		break;
 	case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
 		handle_pointer_motion_abs(event, &dev->pointer);
@@ -22,22 +22,39 @@ struct wlr_libinput_input_device *device_from_pointer(
 	return dev;
 }
 
-void handle_pointer_motion(struct libinput_event *event,
-		struct wlr_pointer *pointer) {
-	struct libinput_event_pointer *pevent =
-		libinput_event_get_pointer_event(event);
-	struct wlr_pointer_motion_event wlr_event = {
-		.pointer = pointer,
-		.time_msec = usec_to_msec(libinput_event_pointer_get_time_usec(pevent)),
-		.delta_x = libinput_event_pointer_get_dx(pevent),
-		.delta_y = libinput_event_pointer_get_dy(pevent),
-		.unaccel_dx = libinput_event_pointer_get_dx_unaccelerated(pevent),
-		.unaccel_dy = libinput_event_pointer_get_dy_unaccelerated(pevent),
-	};
+void flush_pointer_motion(struct wlr_libinput_backend *backend) {
+	struct wlr_pointer *pointer = backend->pending_motion.pointer;
+	if (pointer == NULL) {
+		return;
+	}
+
+	struct wlr_pointer_motion_event wlr_event = backend->pending_motion;
+	backend->pending_motion.pointer = NULL;
+
 	wl_signal_emit_mutable(&pointer->events.motion, &wlr_event);
 	wl_signal_emit_mutable(&pointer->events.frame, pointer);
 }
 
+void handle_pointer_motion(struct wlr_libinput_backend *backend,
+		struct libinput_event *event, struct wlr_pointer *pointer) {
+	struct libinput_event_pointer *pevent =
+		libinput_event_get_pointer_event(event);
+
+	// Motion events read at once would be processed at once anyway: merge
+	// consecutive events of a device, it's flushed before any other event
+	struct wlr_pointer_motion_event *pending = &backend->pending_motion;
+	if (pending->pointer != pointer) {
+		flush_pointer_motion(backend);
+		*pending = (struct wlr_pointer_motion_event){ .pointer = pointer };
+	}
+
+	pending->time_msec = usec_to_msec(libinput_event_pointer_get_time_usec(pevent));
+	pending->delta_x += libinput_event_pointer_get_dx(pevent);
+	pending->delta_y += libinput_event_pointer_get_dy(pevent);
+	pending->unaccel_dx += libinput_event_pointer_get_dx_unaccelerated(pevent);
+	pending->unaccel_dy += libinput_event_pointer_get_dy_unaccelerated(pevent);
+}
+
 void handle_pointer_motion_abs(struct libinput_event *event,
 		struct wlr_pointer *pointer) {
 	struct libinput_event_pointer *pevent =
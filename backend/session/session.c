@@ -233,6 +233,18 @@ out:
 	return 1;
 }
 
+static int handle_priority_event(int fd, uint32_t mask, void *data) {
+	struct wlr_session *session = data;
+	wlr_session_dispatch_priority_events(session);
+	return 0;
+}
+
+void wlr_session_dispatch_priority_events(struct wlr_session *session) {
+	if (wl_event_loop_dispatch(session->priority_event_loop, 0) < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to dispatch priority events");
+	}
+}
+
 static void handle_event_loop_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_session *session =
 		wl_container_of(listener, session, event_loop_destroy);
@@ -252,9 +264,22 @@ struct wlr_session *wlr_session_create(struct wl_event_loop *event_loop) {
 	wl_signal_init(&session->events.destroy);
 	wl_list_init(&session->devices);
 
+	session->priority_event_loop = wl_event_loop_create();
+	if (session->priority_event_loop == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create priority event loop");
+		goto error_open;
+	}
+	session->priority_event = wl_event_loop_add_fd(event_loop,
+		wl_event_loop_get_fd(session->priority_event_loop), WL_EVENT_READABLE,
+		handle_priority_event, session);
+	if (session->priority_event == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create priority event source");
+		goto error_priority_loop;
+	}
+
 	if (libseat_session_init(session, event_loop) == -1) {
 		wlr_log(WLR_ERROR, "Failed to load session backend");
-		goto error_open;
+		goto error_priority_event;
 	}
 
 	session->udev = udev_new();
@@ -292,6 +317,10 @@ error_udev:
 	udev_unref(session->udev);
 error_session:
 	libseat_session_finish(session);
+error_priority_event:
+	wl_event_source_remove(session->priority_event);
+error_priority_loop:
+	wl_event_loop_destroy(session->priority_event_loop);
 error_open:
 	free(session);
 	return NULL;
@@ -315,6 +344,11 @@ void wlr_session_destroy(struct wlr_session *session) {
 	}
 
 	libseat_session_finish(session);
+
+	// Backends remove their sources when the session is destroyed
+	wl_event_source_remove(session->priority_event);
+	wl_event_loop_destroy(session->priority_event_loop);
+
 	free(session);
 }
 
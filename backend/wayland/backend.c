@@ -19,7 +19,9 @@
 #include "render/drm_format_set.h"
 #include "render/pixel_format.h"
 
+#include "commit-timing-v1-client-protocol.h"
 #include "drm-client-protocol.h"
+#include "fifo-v1-client-protocol.h"
 #include "linux-dmabuf-v1-client-protocol.h"
 #include "linux-drm-syncobj-v1-client-protocol.h"
 #include "pointer-gestures-unstable-v1-client-protocol.h"
@@ -381,6 +383,12 @@ static void registry_global(void *data, struct wl_registry *registry,
 			&wp_presentation_interface, 1);
 		wp_presentation_add_listener(wl->presentation,
 			&presentation_listener, wl);
+	} else if (strcmp(iface, wp_fifo_manager_v1_interface.name) == 0) {
+		wl->fifo_manager_v1 = wl_registry_bind(registry, name,
+			&wp_fifo_manager_v1_interface, 1);
+	} else if (strcmp(iface, wp_commit_timing_manager_v1_interface.name) == 0) {
+		wl->commit_timing_manager_v1 = wl_registry_bind(registry, name,
+			&wp_commit_timing_manager_v1_interface, 1);
 	} else if (strcmp(iface, zwp_tablet_manager_v2_interface.name) == 0) {
 		wl->tablet_manager = wl_registry_bind(registry, name,
 			&zwp_tablet_manager_v2_interface, 1);
@@ -524,6 +532,12 @@ static void backend_destroy(struct wlr_backend *backend) {
 	if (wl->presentation) {
 		wp_presentation_destroy(wl->presentation);
 	}
+	if (wl->fifo_manager_v1) {
+		wp_fifo_manager_v1_destroy(wl->fifo_manager_v1);
+	}
+	if (wl->commit_timing_manager_v1) {
+		wp_commit_timing_manager_v1_destroy(wl->commit_timing_manager_v1);
+	}
 	if (wl->zwp_linux_dmabuf_v1) {
 		zwp_linux_dmabuf_v1_destroy(wl->zwp_linux_dmabuf_v1);
 	}
@@ -19,7 +19,10 @@
 #include "backend/wayland.h"
 #include "render/pixel_format.h"
 #include "types/wlr_output.h"
+#include "util/time.h"
 
+#include "commit-timing-v1-client-protocol.h"
+#include "fifo-v1-client-protocol.h"
 #include "linux-dmabuf-v1-client-protocol.h"
 #include "linux-drm-syncobj-v1-client-protocol.h"
 #include "presentation-time-client-protocol.h"
@@ -61,6 +64,14 @@ struct wlr_wl_output *get_wl_output_from_surface(struct wlr_wl_backend *wl,
 	return output;
 }
 
+static void output_send_frame(struct wlr_wl_output *output) {
+	if (output->frame_sent) {
+		return;
+	}
+	output->frame_sent = true;
+	wlr_output_send_frame(&output->wlr_output);
+}
+
 static void surface_frame_callback(void *data, struct wl_callback *cb,
 		uint32_t time) {
 	struct wlr_wl_output *output = data;
@@ -73,7 +84,7 @@ static void surface_frame_callback(void *data, struct wl_callback *cb,
 	wl_callback_destroy(cb);
 	output->frame_callback = NULL;
 
-	wlr_output_send_frame(&output->wlr_output);
+	output_send_frame(output);
 }
 
 static const struct wl_callback_listener frame_listener = {
@@ -97,6 +108,7 @@ static void presentation_feedback_handle_presented(void *data,
 		uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh_ns,
 		uint32_t seq_hi, uint32_t seq_lo, uint32_t flags) {
 	struct wlr_wl_presentation_feedback *feedback = data;
+	struct wlr_wl_output *output = feedback->output;
 
 	struct wlr_output_event_present event = {
 		.commit_seq = feedback->commit_seq,
@@ -109,9 +121,21 @@ static void presentation_feedback_handle_presented(void *data,
 		.refresh = refresh_ns,
 		.flags = flags,
 	};
-	wlr_output_send_present(&feedback->output->wlr_output, &event);
 
+	output->last_present_ns = timespec_to_nsec(&event.when);
+	output->refresh_ns = refresh_ns;
+
+	bool latest = feedback->commit_seq == output->wlr_output.commit_seq;
+	wlr_output_send_present(&output->wlr_output, &event);
 	presentation_feedback_destroy(feedback);
+
+	// The parent compositor has just latched our latest frame: this is the
+	// start of its next refresh cycle, which some compositors only report
+	// with the frame callback much later (or never while the surface is
+	// occluded)
+	if (latest) {
+		output_send_frame(output);
+	}
 }
 
 static void presentation_feedback_handle_discarded(void *data,
@@ -499,6 +523,10 @@ static bool output_test(struct wlr_output *wlr_output,
 						layer_state->src_box.width != width ||
 						layer_state->src_box.height != height;
 				}
+				// Sub-surfaces can't be made translucent
+				if (layer_state->alpha != NULL && *layer_state->alpha != 1) {
+					supported = false;
+				}
 				if (x < 0 || y < 0 ||
 						x + width > wlr_output->width ||
 						y + height > wlr_output->height ||
@@ -518,6 +546,7 @@ static bool output_test(struct wlr_output *wlr_output,
 static void output_layer_handle_addon_destroy(struct wlr_addon *addon) {
 	struct wlr_wl_output_layer *layer = wl_container_of(addon, layer, addon);
 
+	layer->output->restack_layers = true;
 	wlr_addon_finish(&layer->addon);
 	if (layer->viewport != NULL) {
 		wp_viewport_destroy(layer->viewport);
@@ -551,6 +580,7 @@ static struct wlr_wl_output_layer *get_or_create_output_layer(
 
 	wlr_addon_init(&layer->addon, &wlr_layer->addons, output,
 		&output_layer_addon_impl);
+	layer->output = output;
 
 	layer->surface = wl_compositor_create_surface(output->backend->compositor);
 	layer->subsurface = wl_subcompositor_get_subsurface(
@@ -569,22 +599,24 @@ static struct wlr_wl_output_layer *get_or_create_output_layer(
 	return layer;
 }
 
-static bool has_layers_order_changed(struct wlr_wl_output *output,
-		struct wlr_output_layer_state *layers, size_t layers_len) {
-	// output_basic_check() ensures that layers_len equals the number of
-	// registered output layers
-	size_t i = 0;
-	struct wlr_output_layer *layer;
-	wl_list_for_each(layer, &output->wlr_output.layers, link) {
-		assert(i < layers_len);
-		const struct wlr_output_layer_state *layer_state = &layers[i];
-		if (layer_state->layer != layer) {
-			return true;
+static struct wlr_wl_buffer *output_layer_get_attached_buffer(
+		struct wlr_wl_output_layer *layer, struct wlr_buffer *wlr_buffer) {
+	if (!layer->mapped) {
+		return NULL;
+	}
+
+	struct wlr_wl_buffer *buffer;
+	wl_list_for_each(buffer, &layer->output->backend->buffers, link) {
+		if (buffer == layer->attached) {
+			// The parent compositor still holds the wl_buffer, it can be
+			// attached again without being imported a second time
+			if (buffer->buffer == wlr_buffer && !buffer->released) {
+				return buffer;
+			}
+			break;
 		}
-		i++;
 	}
-	assert(i == layers_len);
-	return false;
+	return NULL;
 }
 
 static void output_layer_unmap(struct wlr_wl_output_layer *layer) {
@@ -595,6 +627,7 @@ static void output_layer_unmap(struct wlr_wl_output_layer *layer) {
 	wl_surface_attach(layer->surface, NULL, 0, 0);
 	wl_surface_commit(layer->surface);
 	layer->mapped = false;
+	layer->attached = NULL;
 }
 
 static void damage_surface(struct wl_surface *surface,
@@ -627,18 +660,29 @@ static bool output_layer_commit(struct wlr_wl_output *output,
 		return true;
 	}
 
+	bool resized = state->layer->dst_box.width != state->dst_box.width ||
+		state->layer->dst_box.height != state->dst_box.height;
+	bool src_changed = !wlr_fbox_equal(&state->layer->src_box, &state->src_box);
+
 	struct wlr_wl_buffer *buffer =
-		get_or_create_wl_buffer(output->backend, state->buffer);
-	if (buffer == NULL) {
-		return false;
+		output_layer_get_attached_buffer(layer, state->buffer);
+	if (buffer != NULL) {
+		if (state->damage != NULL && !pixman_region32_not_empty(state->damage) &&
+				!resized && !src_changed) {
+			// Nothing to update, the position is part of the parent state
+			return true;
+		}
+	} else {
+		buffer = get_or_create_wl_buffer(output->backend, state->buffer);
+		if (buffer == NULL) {
+			return false;
+		}
 	}
 
-	if (layer->viewport != NULL &&
-			(state->layer->dst_box.width != state->dst_box.width ||
-			state->layer->dst_box.height != state->dst_box.height)) {
+	if (layer->viewport != NULL && resized) {
 		wp_viewport_set_destination(layer->viewport, state->dst_box.width, state->dst_box.height);
 	}
-	if (layer->viewport != NULL && !wlr_fbox_equal(&state->layer->src_box, &state->src_box)) {
+	if (layer->viewport != NULL && src_changed) {
 		struct wlr_fbox src_box = state->src_box;
 		if (wlr_fbox_empty(&src_box)) {
 			// -1 resets the box
@@ -660,6 +704,7 @@ static bool output_layer_commit(struct wlr_wl_output *output,
 	damage_surface(layer->surface, state->damage);
 	wl_surface_commit(layer->surface);
 	layer->mapped = true;
+	layer->attached = buffer;
 	return true;
 }
 
@@ -669,9 +714,11 @@ static bool commit_layers(struct wlr_wl_output *output,
 		return true;
 	}
 
-	bool reordered = has_layers_order_changed(output, layers, layers_len);
+	// Only restack the layers whose neighbour below has changed
+	bool restack = output->restack_layers;
+	output->restack_layers = false;
 
-	struct wlr_wl_output_layer *prev_layer = NULL;
+	struct wl_surface *prev_surface = output->surface;
 	for (size_t i = 0; i < layers_len; i++) {
 		struct wlr_wl_output_layer *layer =
 			get_or_create_output_layer(output, layers[i].layer);
@@ -684,16 +731,16 @@ static bool commit_layers(struct wlr_wl_output *output,
 			continue;
 		}
 
-		if (prev_layer != NULL && reordered) {
-			wl_subsurface_place_above(layer->subsurface,
-				prev_layer->surface);
+		if (restack || layer->placed_above != prev_surface) {
+			wl_subsurface_place_above(layer->subsurface, prev_surface);
+			layer->placed_above = prev_surface;
 		}
 
 		if (!output_layer_commit(output, layer, &layers[i])) {
 			return false;
 		}
 
-		prev_layer = layer;
+		prev_surface = layer->surface;
 	}
 
 	return true;
@@ -710,6 +757,49 @@ static const struct wl_callback_listener unmap_callback_listener = {
 	.done = unmap_callback_handle_done,
 };
 
+static void output_set_frame_timing(struct wlr_wl_output *output) {
+	struct wlr_wl_backend *wl = output->backend;
+	// The fifo and commit timer objects are per-surface, don't create them
+	// for surfaces owned by the user
+	if (!output->own_surface) {
+		return;
+	}
+
+	if (wl->fifo_manager_v1 != NULL && output->fifo_v1 == NULL) {
+		output->fifo_v1 = wp_fifo_manager_v1_get_fifo(wl->fifo_manager_v1,
+			output->surface);
+	}
+	if (output->fifo_v1 != NULL) {
+		// Don't let this frame replace the previous one before the parent
+		// compositor has latched it
+		wp_fifo_v1_wait_barrier(output->fifo_v1);
+		wp_fifo_v1_set_barrier(output->fifo_v1);
+	}
+
+	if (wl->commit_timing_manager_v1 == NULL || wl->presentation == NULL ||
+			output->last_present_ns == 0 || output->refresh_ns <= 0) {
+		return;
+	}
+	if (output->commit_timer_v1 == NULL) {
+		output->commit_timer_v1 = wp_commit_timing_manager_v1_get_timer(
+			wl->commit_timing_manager_v1, output->surface);
+	}
+
+	// Target the next refresh cycle of the parent compositor, so that frames
+	// stay in phase with it when they are submitted early
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t elapsed = timespec_to_nsec(&now) - output->last_present_ns;
+	if (elapsed < 0) {
+		elapsed = 0;
+	}
+	int64_t cycles = elapsed / output->refresh_ns + 1;
+	struct timespec target;
+	timespec_from_nsec(&target, output->last_present_ns + cycles * output->refresh_ns);
+	wp_commit_timer_v1_set_timestamp(output->commit_timer_v1,
+		(uint64_t)target.tv_sec >> 32, (uint32_t)target.tv_sec, target.tv_nsec);
+}
+
 static bool output_commit(struct wlr_output *wlr_output,
 		const struct wlr_output_state *state) {
 	struct wlr_wl_output *output =
@@ -852,7 +942,12 @@ static bool output_commit(struct wlr_output *wlr_output,
 			output->has_configure_serial = false;
 		}
 
+		if (state->committed & WLR_OUTPUT_STATE_BUFFER) {
+			output_set_frame_timing(output);
+		}
+
 		wl_surface_commit(output->surface);
+		output->frame_sent = false;
 
 		if (wp_feedback != NULL) {
 			struct wlr_wl_presentation_feedback *feedback =
@@ -958,6 +1053,12 @@ static void output_destroy(struct wlr_output *wlr_output) {
 	if (output->drm_syncobj_surface_v1) {
 		wp_linux_drm_syncobj_surface_v1_destroy(output->drm_syncobj_surface_v1);
 	}
+	if (output->fifo_v1) {
+		wp_fifo_v1_destroy(output->fifo_v1);
+	}
+	if (output->commit_timer_v1) {
+		wp_commit_timer_v1_destroy(output->commit_timer_v1);
+	}
 	if (output->zxdg_toplevel_decoration_v1) {
 		zxdg_toplevel_decoration_v1_destroy(output->zxdg_toplevel_decoration_v1);
 	}
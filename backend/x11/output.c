@@ -22,6 +22,10 @@
 #include "util/time.h"
 #include "types/wlr_output.h"
 
+// Pixmaps of buffers which haven't been presented for this long are freed,
+// even if the buffer is still alive
+static const int64_t BUFFER_IDLE_TIMEOUT_MSEC = 1000;
+
 static const uint32_t SUPPORTED_OUTPUT_STATE =
 	WLR_OUTPUT_STATE_BACKEND_OPTIONAL |
 	WLR_OUTPUT_STATE_BUFFER |
@@ -97,6 +101,9 @@ static void output_destroy(struct wlr_output *wlr_output) {
 	wlr_output_finish(wlr_output);
 
 	pixman_region32_fini(&output->exposed);
+	if (output->damage_region != XCB_NONE) {
+		xcb_xfixes_destroy_region(x11->xcb, output->damage_region);
+	}
 
 	wlr_pointer_finish(&output->pointer);
 	wlr_touch_finish(&output->touch);
@@ -334,6 +341,17 @@ static struct wlr_x11_buffer *get_or_create_x11_buffer(
 	return create_x11_buffer(output, wlr_buffer);
 }
 
+static void release_idle_x11_buffers(struct wlr_x11_output *output,
+		int64_t now_msec) {
+	struct wlr_x11_buffer *buffer, *tmp;
+	wl_list_for_each_safe(buffer, tmp, &output->buffers, link) {
+		if (buffer->n_busy == 0 &&
+				now_msec - buffer->last_used_msec > BUFFER_IDLE_TIMEOUT_MSEC) {
+			destroy_x11_buffer(buffer);
+		}
+	}
+}
+
 static bool output_commit_buffer(struct wlr_x11_output *output,
 		const struct wlr_output_state *state) {
 	struct wlr_x11_backend *x11 = output->x11;
@@ -345,6 +363,10 @@ static bool output_commit_buffer(struct wlr_x11_output *output,
 		goto error;
 	}
 
+	int64_t now_msec = get_current_time_msec();
+	x11_buffer->last_used_msec = now_msec;
+	release_idle_x11_buffers(output, now_msec);
+
 	xcb_xfixes_region_t region = XCB_NONE;
 	if (state->committed & WLR_OUTPUT_STATE_DAMAGE) {
 		pixman_region32_union(&output->exposed, &output->exposed, &state->damage);
@@ -367,8 +389,15 @@ static bool output_commit_buffer(struct wlr_x11_output *output,
 			};
 		}
 
-		region = xcb_generate_id(x11->xcb);
-		xcb_xfixes_create_region(x11->xcb, region, rects_len, xcb_rects);
+		if (output->damage_region == XCB_NONE) {
+			output->damage_region = xcb_generate_id(x11->xcb);
+			xcb_xfixes_create_region(x11->xcb, output->damage_region,
+				rects_len, xcb_rects);
+		} else {
+			xcb_xfixes_set_region(x11->xcb, output->damage_region,
+				rects_len, xcb_rects);
+		}
+		region = output->damage_region;
 
 		free(xcb_rects);
 	}
@@ -382,10 +411,6 @@ static bool output_commit_buffer(struct wlr_x11_output *output,
 		0, region, 0, 0, XCB_NONE, XCB_NONE, XCB_NONE, options, target_msc,
 		0, 0, 0, NULL);
 
-	if (region != XCB_NONE) {
-		xcb_xfixes_destroy_region(x11->xcb, region);
-	}
-
 	return true;
 
 error:
@@ -0,0 +1,359 @@
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include "loadgen.h"
+
+/**
+ * Sets the selection over and over again from a focused toplevel, with data
+ * sources offering many MIME types. The reported latency is the time between
+ * the set_selection request and the wl_data_device.selection event announcing
+ * the new offer back to the client.
+ *
+ * With -r, each selection is also read back through the compositor, with a
+ * payload of the requested size.
+ *
+ * The client needs keyboard focus: the compositor rejects selections set
+ * without a recent input serial.
+ */
+
+struct flood_state {
+	struct loadgen_globals globals;
+	struct loadgen_window window;
+	struct wl_keyboard *keyboard;
+	struct wl_data_device *data_device;
+
+	uint32_t serial;
+	bool focused;
+
+	struct wl_data_offer *offer;
+	bool selection_received;
+
+	char *payload;
+	size_t payload_size;
+	size_t cancelled;
+};
+
+static void keyboard_handle_keymap(void *data, struct wl_keyboard *keyboard,
+		uint32_t format, int32_t fd, uint32_t size) {
+	close(fd);
+}
+
+static void keyboard_handle_enter(void *data, struct wl_keyboard *keyboard,
+		uint32_t serial, struct wl_surface *surface, struct wl_array *keys) {
+	struct flood_state *state = data;
+	state->serial = serial;
+	state->focused = true;
+}
+
+static void keyboard_handle_leave(void *data, struct wl_keyboard *keyboard,
+		uint32_t serial, struct wl_surface *surface) {
+	struct flood_state *state = data;
+	state->focused = false;
+}
+
+static void keyboard_handle_key(void *data, struct wl_keyboard *keyboard,
+		uint32_t serial, uint32_t time, uint32_t key, uint32_t key_state) {
+	struct flood_state *state = data;
+	state->serial = serial;
+}
+
+static void keyboard_handle_modifiers(void *data, struct wl_keyboard *keyboard,
+		uint32_t serial, uint32_t mods_depressed, uint32_t mods_latched,
+		uint32_t mods_locked, uint32_t group) {
+	// Who cares?
+}
+
+static const struct wl_keyboard_listener keyboard_listener = {
+	.keymap = keyboard_handle_keymap,
+	.enter = keyboard_handle_enter,
+	.leave = keyboard_handle_leave,
+	.key = keyboard_handle_key,
+	.modifiers = keyboard_handle_modifiers,
+};
+
+static void data_source_handle_target(void *data,
+		struct wl_data_source *source, const char *mime_type) {
+	// Only used by drag and drop
+}
+
+static void data_source_handle_send(void *data, struct wl_data_source *source,
+		const char *mime_type, int32_t fd) {
+	struct flood_state *state = data;
+	size_t written = 0;
+	while (written < state->payload_size) {
+		ssize_t n = write(fd, state->payload + written,
+			state->payload_size - written);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		written += n;
+	}
+	close(fd);
+}
+
+static void data_source_handle_cancelled(void *data,
+		struct wl_data_source *source) {
+	struct flood_state *state = data;
+	state->cancelled++;
+	wl_data_source_destroy(source);
+}
+
+static const struct wl_data_source_listener data_source_listener = {
+	.target = data_source_handle_target,
+	.send = data_source_handle_send,
+	.cancelled = data_source_handle_cancelled,
+};
+
+static void data_offer_handle_offer(void *data, struct wl_data_offer *offer,
+		const char *mime_type) {
+	// All offers are expected to come from this client
+}
+
+static const struct wl_data_offer_listener data_offer_listener = {
+	.offer = data_offer_handle_offer,
+};
+
+static void data_device_handle_data_offer(void *data,
+		struct wl_data_device *data_device, struct wl_data_offer *offer) {
+	wl_data_offer_add_listener(offer, &data_offer_listener, data);
+}
+
+static void data_device_handle_enter(void *data,
+		struct wl_data_device *data_device, uint32_t serial,
+		struct wl_surface *surface, wl_fixed_t x, wl_fixed_t y,
+		struct wl_data_offer *offer) {
+	// Only used by drag and drop
+}
+
+static void data_device_handle_leave(void *data,
+		struct wl_data_device *data_device) {
+	// Only used by drag and drop
+}
+
+static void data_device_handle_motion(void *data,
+		struct wl_data_device *data_device, uint32_t time,
+		wl_fixed_t x, wl_fixed_t y) {
+	// Only used by drag and drop
+}
+
+static void data_device_handle_drop(void *data,
+		struct wl_data_device *data_device) {
+	// Only used by drag and drop
+}
+
+static void data_device_handle_selection(void *data,
+		struct wl_data_device *data_device, struct wl_data_offer *offer) {
+	struct flood_state *state = data;
+	if (state->offer != NULL) {
+		wl_data_offer_destroy(state->offer);
+	}
+	state->offer = offer;
+	if (offer != NULL) {
+		state->selection_received = true;
+	}
+}
+
+static const struct wl_data_device_listener data_device_listener = {
+	.data_offer = data_device_handle_data_offer,
+	.enter = data_device_handle_enter,
+	.leave = data_device_handle_leave,
+	.motion = data_device_handle_motion,
+	.drop = data_device_handle_drop,
+	.selection = data_device_handle_selection,
+};
+
+/**
+ * Read the current selection back. The compositor forwards the request to
+ * our own data source, so the event queue is dispatched while reading.
+ */
+static bool read_selection(struct flood_state *state, size_t *read_size) {
+	int fds[2];
+	if (pipe(fds) != 0) {
+		return false;
+	}
+	wl_data_offer_receive(state->offer, "text/plain", fds[1]);
+	close(fds[1]);
+	wl_display_flush(state->globals.display);
+
+	char buf[4096];
+	*read_size = 0;
+	while (true) {
+		struct pollfd pfds[] = {
+			{ .fd = fds[0], .events = POLLIN },
+			{ .fd = wl_display_get_fd(state->globals.display), .events = POLLIN },
+		};
+		if (poll(pfds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		if (pfds[1].revents & POLLIN) {
+			if (wl_display_dispatch(state->globals.display) < 0) {
+				break;
+			}
+		}
+		if (pfds[0].revents & (POLLIN | POLLHUP)) {
+			ssize_t n = read(fds[0], buf, sizeof(buf));
+			if (n <= 0) {
+				close(fds[0]);
+				return n == 0;
+			}
+			*read_size += n;
+		}
+		wl_display_flush(state->globals.display);
+	}
+	close(fds[0]);
+	return false;
+}
+
+static const char usage[] =
+	"usage: %s [options]\n"
+	"  -n <n>  number of selections (default: 1000)\n"
+	"  -m <n>  number of MIME types per data source (default: 16)\n"
+	"  -r <n>  read each selection back, with a payload of n bytes\n";
+
+int main(int argc, char *argv[]) {
+	struct flood_state state = {0};
+	int selections = 1000;
+	int mime_types = 16;
+	bool read_back = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:m:r:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			selections = atoi(optarg);
+			break;
+		case 'm':
+			mime_types = atoi(optarg);
+			break;
+		case 'r':
+			read_back = true;
+			state.payload_size = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			printf(usage, argv[0]);
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (selections <= 0 || mime_types <= 0) {
+		printf(usage, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (state.payload_size > 0) {
+		state.payload = malloc(state.payload_size);
+		if (state.payload == NULL) {
+			return EXIT_FAILURE;
+		}
+		memset(state.payload, 'x', state.payload_size);
+	}
+
+	if (!loadgen_connect(&state.globals)) {
+		return EXIT_FAILURE;
+	}
+	if (state.globals.seat == NULL || state.globals.data_device_manager == NULL) {
+		fprintf(stderr, "wl_seat or wl_data_device_manager not supported\n");
+		return EXIT_FAILURE;
+	}
+
+	state.keyboard = wl_seat_get_keyboard(state.globals.seat);
+	wl_keyboard_add_listener(state.keyboard, &keyboard_listener, &state);
+	state.data_device = wl_data_device_manager_get_data_device(
+		state.globals.data_device_manager, state.globals.seat);
+	wl_data_device_add_listener(state.data_device, &data_device_listener, &state);
+
+	if (!loadgen_window_init(&state.window, &state.globals, "clipboard-flood")) {
+		return EXIT_FAILURE;
+	}
+	struct loadgen_buffer buffer;
+	if (!loadgen_buffer_init_shm(&buffer, &state.globals, 64, 64, 0xFF404040)) {
+		return EXIT_FAILURE;
+	}
+	wl_surface_attach(state.window.surface, buffer.wl_buffer, 0, 0);
+	wl_surface_commit(state.window.surface);
+
+	while (!state.focused) {
+		if (wl_display_dispatch(state.globals.display) < 0) {
+			fprintf(stderr, "Lost connection to the compositor\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	struct loadgen_samples latencies = {0}, reads = {0};
+	size_t read_bytes = 0, read_failures = 0;
+
+	int64_t start = loadgen_now_ns();
+	for (int i = 0; i < selections && state.focused; i++) {
+		struct wl_data_source *source = wl_data_device_manager_create_data_source(
+			state.globals.data_device_manager);
+		wl_data_source_add_listener(source, &data_source_listener, &state);
+		wl_data_source_offer(source, "text/plain");
+		for (int j = 1; j < mime_types; j++) {
+			char mime_type[64];
+			snprintf(mime_type, sizeof(mime_type), "application/x-loadgen-%d", j);
+			wl_data_source_offer(source, mime_type);
+		}
+
+		int64_t set_ns = loadgen_now_ns();
+		state.selection_received = false;
+		wl_data_device_set_selection(state.data_device, source, state.serial);
+		while (!state.selection_received && state.focused) {
+			if (wl_display_dispatch(state.globals.display) < 0) {
+				fprintf(stderr, "Lost connection to the compositor\n");
+				return EXIT_FAILURE;
+			}
+		}
+		if (!state.selection_received) {
+			break;
+		}
+		loadgen_samples_add(&latencies, loadgen_now_ns() - set_ns);
+
+		if (read_back) {
+			int64_t read_ns = loadgen_now_ns();
+			size_t size;
+			if (read_selection(&state, &size)) {
+				loadgen_samples_add(&reads, loadgen_now_ns() - read_ns);
+				read_bytes += size;
+			} else {
+				read_failures++;
+			}
+		}
+	}
+	int64_t elapsed = loadgen_now_ns() - start;
+
+	printf("selections=%d mime_types=%d payload_size=%zu\n", selections,
+		mime_types, state.payload_size);
+	printf("completed=%zu\n", latencies.len);
+	printf("cancelled_sources=%zu\n", state.cancelled);
+	printf("selections_per_sec=%.2f\n",
+		(double)latencies.len * 1000000000 / elapsed);
+	loadgen_samples_print(&latencies, "selection_latency");
+	if (read_back) {
+		printf("read_bytes=%zu\n", read_bytes);
+		printf("read_failures=%zu\n", read_failures);
+		loadgen_samples_print(&reads, "read_latency");
+	}
+
+	loadgen_samples_finish(&latencies);
+	loadgen_samples_finish(&reads);
+	if (state.offer != NULL) {
+		wl_data_offer_destroy(state.offer);
+	}
+	wl_data_device_release(state.data_device);
+	wl_keyboard_destroy(state.keyboard);
+	loadgen_buffer_finish(&buffer);
+	loadgen_window_finish(&state.window);
+	loadgen_disconnect(&state.globals);
+	free(state.payload);
+	return EXIT_SUCCESS;
+}
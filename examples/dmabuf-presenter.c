@@ -0,0 +1,296 @@
+#include <drm_fourcc.h>
+#include <fcntl.h>
+#include <gbm.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include "linux-dmabuf-v1-client-protocol.h"
+#include "loadgen.h"
+#include "presentation-time-client-protocol.h"
+
+/**
+ * Presents linear DMA-BUFs allocated with GBM on a toplevel, either on every
+ * frame callback or as fast as buffers are released, and reports the
+ * presentation feedback statistics: the latency between each commit and its
+ * presentation, the interval between presentations and the number of
+ * discarded frames.
+ */
+
+#define BUFFERS_LEN 3
+
+struct presenter_buffer {
+	struct loadgen_buffer base;
+	struct gbm_bo *bo;
+};
+
+struct presenter_state {
+	struct loadgen_globals globals;
+	struct loadgen_window window;
+	struct presenter_buffer buffers[BUFFERS_LEN];
+	int width, height;
+
+	bool unthrottled;
+	bool frame_pending;
+
+	size_t commits, presented, discarded, zero_copy;
+	int64_t last_present_ns;
+	struct loadgen_samples latencies, intervals;
+};
+
+struct presenter_feedback {
+	struct presenter_state *state;
+	struct wp_presentation_feedback *feedback;
+	int64_t commit_ns;
+};
+
+static void feedback_destroy(struct presenter_feedback *feedback) {
+	wp_presentation_feedback_destroy(feedback->feedback);
+	free(feedback);
+}
+
+static void feedback_handle_sync_output(void *data,
+		struct wp_presentation_feedback *wp_feedback, struct wl_output *output) {
+	// Who cares?
+}
+
+static void feedback_handle_presented(void *data,
+		struct wp_presentation_feedback *wp_feedback, uint32_t tv_sec_hi,
+		uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh,
+		uint32_t seq_hi, uint32_t seq_lo, uint32_t flags) {
+	struct presenter_feedback *feedback = data;
+	struct presenter_state *state = feedback->state;
+
+	int64_t present_ns = (int64_t)(((uint64_t)tv_sec_hi << 32) | tv_sec_lo) *
+		1000000000 + tv_nsec;
+	loadgen_samples_add(&state->latencies, present_ns - feedback->commit_ns);
+	if (state->last_present_ns != 0) {
+		loadgen_samples_add(&state->intervals, present_ns - state->last_present_ns);
+	}
+	state->last_present_ns = present_ns;
+
+	state->presented++;
+	if (flags & WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY) {
+		state->zero_copy++;
+	}
+	feedback_destroy(feedback);
+}
+
+static void feedback_handle_discarded(void *data,
+		struct wp_presentation_feedback *wp_feedback) {
+	struct presenter_feedback *feedback = data;
+	feedback->state->discarded++;
+	feedback_destroy(feedback);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+	.sync_output = feedback_handle_sync_output,
+	.presented = feedback_handle_presented,
+	.discarded = feedback_handle_discarded,
+};
+
+static void frame_handle_done(void *data, struct wl_callback *callback,
+		uint32_t time) {
+	struct presenter_state *state = data;
+	wl_callback_destroy(callback);
+	state->frame_pending = false;
+}
+
+static const struct wl_callback_listener frame_listener = {
+	.done = frame_handle_done,
+};
+
+static bool buffer_init(struct presenter_buffer *buffer,
+		struct presenter_state *state, struct gbm_device *gbm) {
+	buffer->bo = gbm_bo_create(gbm, state->width, state->height,
+		GBM_FORMAT_ARGB8888, GBM_BO_USE_LINEAR | GBM_BO_USE_RENDERING);
+	if (buffer->bo == NULL) {
+		fprintf(stderr, "Failed to allocate GBM buffer\n");
+		return false;
+	}
+
+	int fd = gbm_bo_get_fd(buffer->bo);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to export GBM buffer\n");
+		return false;
+	}
+
+	uint64_t modifier = DRM_FORMAT_MOD_LINEAR;
+	struct zwp_linux_buffer_params_v1 *params =
+		zwp_linux_dmabuf_v1_create_params(state->globals.linux_dmabuf);
+	zwp_linux_buffer_params_v1_add(params, fd, 0, gbm_bo_get_offset(buffer->bo, 0),
+		gbm_bo_get_stride(buffer->bo), modifier >> 32, modifier & 0xFFFFFFFF);
+	struct wl_buffer *wl_buffer = zwp_linux_buffer_params_v1_create_immed(params,
+		state->width, state->height, DRM_FORMAT_ARGB8888, 0);
+	zwp_linux_buffer_params_v1_destroy(params);
+	close(fd);
+
+	loadgen_buffer_init(&buffer->base, wl_buffer);
+	return true;
+}
+
+static void buffer_fill(struct presenter_buffer *buffer, uint32_t argb) {
+	uint32_t stride;
+	void *map_data = NULL;
+	uint32_t *data = gbm_bo_map(buffer->bo, 0, 0, gbm_bo_get_width(buffer->bo),
+		gbm_bo_get_height(buffer->bo), GBM_BO_TRANSFER_WRITE, &stride, &map_data);
+	if (data == NULL) {
+		return;
+	}
+	for (uint32_t y = 0; y < gbm_bo_get_height(buffer->bo); y++) {
+		uint32_t *row = (uint32_t *)((uint8_t *)data + y * stride);
+		for (uint32_t x = 0; x < gbm_bo_get_width(buffer->bo); x++) {
+			row[x] = argb;
+		}
+	}
+	gbm_bo_unmap(buffer->bo, map_data);
+}
+
+static void present(struct presenter_state *state,
+		struct presenter_buffer *buffer) {
+	struct wl_surface *surface = state->window.surface;
+
+	buffer_fill(buffer, 0xFF000000 | (uint32_t)(state->commits * 0x030201));
+	buffer->base.busy = true;
+	wl_surface_attach(surface, buffer->base.wl_buffer, 0, 0);
+	wl_surface_damage_buffer(surface, 0, 0, state->width, state->height);
+
+	if (!state->unthrottled) {
+		struct wl_callback *callback = wl_surface_frame(surface);
+		wl_callback_add_listener(callback, &frame_listener, state);
+		state->frame_pending = true;
+	}
+
+	struct presenter_feedback *feedback = calloc(1, sizeof(*feedback));
+	if (feedback != NULL) {
+		feedback->state = state;
+		feedback->feedback = wp_presentation_feedback(state->globals.presentation,
+			surface);
+		wp_presentation_feedback_add_listener(feedback->feedback,
+			&feedback_listener, feedback);
+		feedback->commit_ns = loadgen_clock_ns(state->globals.presentation_clock);
+	}
+
+	wl_surface_commit(surface);
+	state->commits++;
+}
+
+static const char usage[] =
+	"usage: %s [options]\n"
+	"  -d <path>   DRM render node (default: /dev/dri/renderD128)\n"
+	"  -f <n>      number of frames (default: 1000)\n"
+	"  -r <w>x<h>  buffer size (default: 1920x1080)\n"
+	"  -u          don't wait for frame callbacks\n";
+
+int main(int argc, char *argv[]) {
+	const char *render_node = "/dev/dri/renderD128";
+	size_t frames = 1000;
+	struct presenter_state state = {
+		.width = 1920,
+		.height = 1080,
+	};
+
+	int opt;
+	while ((opt = getopt(argc, argv, "d:f:r:uh")) != -1) {
+		switch (opt) {
+		case 'd':
+			render_node = optarg;
+			break;
+		case 'f':
+			frames = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			if (sscanf(optarg, "%dx%d", &state.width, &state.height) != 2) {
+				printf(usage, argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'u':
+			state.unthrottled = true;
+			break;
+		default:
+			printf(usage, argv[0]);
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (frames == 0 || state.width <= 0 || state.height <= 0) {
+		printf(usage, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (!loadgen_connect(&state.globals)) {
+		return EXIT_FAILURE;
+	}
+	if (state.globals.linux_dmabuf == NULL || state.globals.presentation == NULL) {
+		fprintf(stderr, "linux-dmabuf-v1 or presentation-time not supported\n");
+		return EXIT_FAILURE;
+	}
+
+	int drm_fd = open(render_node, O_RDWR | O_CLOEXEC);
+	if (drm_fd < 0) {
+		fprintf(stderr, "Failed to open %s\n", render_node);
+		return EXIT_FAILURE;
+	}
+	struct gbm_device *gbm = gbm_create_device(drm_fd);
+	if (gbm == NULL) {
+		fprintf(stderr, "Failed to create GBM device\n");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < BUFFERS_LEN; i++) {
+		if (!buffer_init(&state.buffers[i], &state, gbm)) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!loadgen_window_init(&state.window, &state.globals, "dmabuf-presenter")) {
+		return EXIT_FAILURE;
+	}
+
+	int64_t start = loadgen_now_ns();
+	while (state.presented + state.discarded < frames) {
+		if (state.commits < frames && !state.frame_pending) {
+			struct presenter_buffer *buffer = NULL;
+			for (size_t i = 0; i < BUFFERS_LEN; i++) {
+				if (!state.buffers[i].base.busy) {
+					buffer = &state.buffers[i];
+					break;
+				}
+			}
+			if (buffer != NULL) {
+				present(&state, buffer);
+				continue;
+			}
+		}
+
+		if (wl_display_dispatch(state.globals.display) < 0) {
+			fprintf(stderr, "Lost connection to the compositor\n");
+			return EXIT_FAILURE;
+		}
+	}
+	int64_t elapsed = loadgen_now_ns() - start;
+
+	printf("size=%dx%d frames=%zu unthrottled=%d\n", state.width, state.height,
+		frames, state.unthrottled);
+	printf("presented=%zu\n", state.presented);
+	printf("discarded=%zu\n", state.discarded);
+	printf("zero_copy=%zu\n", state.zero_copy);
+	printf("frames_per_sec=%.2f\n",
+		(double)state.presented * 1000000000 / elapsed);
+	loadgen_samples_print(&state.latencies, "present_latency");
+	loadgen_samples_print(&state.intervals, "present_interval");
+
+	loadgen_samples_finish(&state.latencies);
+	loadgen_samples_finish(&state.intervals);
+	loadgen_window_finish(&state.window);
+	for (size_t i = 0; i < BUFFERS_LEN; i++) {
+		loadgen_buffer_finish(&state.buffers[i].base);
+		gbm_bo_destroy(state.buffers[i].bo);
+	}
+	gbm_device_destroy(gbm);
+	close(drm_fd);
+	loadgen_disconnect(&state.globals);
+	return EXIT_SUCCESS;
+}
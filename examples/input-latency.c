@@ -0,0 +1,489 @@
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/interfaces/wlr_pointer.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_pointer.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/types/wlr_subcompositor.h>
+#include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/util/log.h>
+
+/**
+ * A minimal compositor in the spirit of tinywl, running on a headless output,
+ * which measures the latency between synthetic pointer motion and the
+ * presentation of the resulting frame.
+ *
+ * Motion events are injected periodically through an in-process pointer
+ * device, the same way wlr_virtual_pointer_v1 feeds the seat. Each event
+ * moves a software cursor rectangle and is delivered to the client surface
+ * below it, if any. When a client received the event, the sample ends with the
+ * presentation of the first frame including a commit of that client made
+ * after the event, otherwise with the presentation of the cursor move.
+ *
+ * A client can be started with -s, e.g. one of the load generators. Results
+ * are printed as "key=value" pairs, like scene-bench.
+ */
+
+// Samples for which no frame shows up in time are counted as timeouts
+#define SAMPLE_TIMEOUT_NSEC (1000 * 1000 * 1000)
+
+enum sample_stage {
+	SAMPLE_IDLE,
+	SAMPLE_WAIT_CLIENT, // waiting for the client to commit
+	SAMPLE_WAIT_COMMIT, // waiting for an output commit
+	SAMPLE_WAIT_PRESENT, // waiting for the presentation of the commit
+};
+
+struct harness {
+	struct wl_display *display;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_allocator *allocator;
+	struct wlr_scene *scene;
+	struct wlr_scene_tree *windows; // below the cursor
+	struct wlr_scene_output *scene_output;
+	struct wlr_output *output;
+	struct wlr_seat *seat;
+	struct wlr_xdg_shell *xdg_shell;
+
+	struct wlr_pointer pointer;
+	struct wlr_scene_rect *cursor;
+	double cursor_x, cursor_y;
+
+	struct wl_event_source *input_timer;
+	int interval_ms;
+	int samples_len;
+
+	enum sample_stage stage;
+	int64_t input_nsec;
+	struct wl_client *focus_client;
+	uint32_t commit_seq;
+
+	int64_t *samples;
+	int samples_done;
+	int client_samples, timeouts;
+
+	struct wl_listener output_frame;
+	struct wl_listener output_commit;
+	struct wl_listener output_present;
+	struct wl_listener pointer_motion;
+	struct wl_listener new_surface;
+	struct wl_listener new_toplevel;
+};
+
+struct harness_surface {
+	struct harness *harness;
+	struct wlr_surface *surface;
+	struct wl_listener commit;
+	struct wl_listener destroy;
+};
+
+struct harness_toplevel {
+	struct wlr_xdg_toplevel *xdg_toplevel;
+	struct wl_listener commit;
+	struct wl_listener destroy;
+};
+
+static const struct wlr_pointer_impl pointer_impl = {
+	.name = "input-latency-pointer",
+};
+
+static int64_t timespec_to_nsec(const struct timespec *ts) {
+	return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static int64_t get_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now);
+}
+
+static void finish_sample(struct harness *harness, int64_t end_nsec) {
+	harness->samples[harness->samples_done++] = end_nsec - harness->input_nsec;
+	if (harness->focus_client != NULL) {
+		harness->client_samples++;
+	}
+	harness->stage = SAMPLE_IDLE;
+
+	if (harness->samples_done == harness->samples_len) {
+		wl_display_terminate(harness->display);
+	}
+}
+
+static void handle_pointer_motion(struct wl_listener *listener, void *data) {
+	struct harness *harness = wl_container_of(listener, harness, pointer_motion);
+	struct wlr_pointer_motion_event *event = data;
+
+	int width, height;
+	wlr_output_effective_resolution(harness->output, &width, &height);
+	harness->cursor_x += event->delta_x;
+	harness->cursor_y += event->delta_y;
+	if (harness->cursor_x < 0 || harness->cursor_x >= width) {
+		harness->cursor_x = 0;
+	}
+	if (harness->cursor_y < 0 || harness->cursor_y >= height) {
+		harness->cursor_y = 0;
+	}
+	wlr_scene_node_set_position(&harness->cursor->node,
+		(int)harness->cursor_x, (int)harness->cursor_y);
+
+	double sx, sy;
+	struct wlr_scene_node *node = wlr_scene_node_at(&harness->windows->node,
+		harness->cursor_x, harness->cursor_y, &sx, &sy);
+
+	struct wlr_surface *surface = NULL;
+	if (node != NULL && node->type == WLR_SCENE_NODE_BUFFER) {
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_try_from_buffer(wlr_scene_buffer_from_node(node));
+		if (scene_surface != NULL) {
+			surface = scene_surface->surface;
+		}
+	}
+
+	if (surface != NULL) {
+		wlr_seat_pointer_notify_enter(harness->seat, surface, sx, sy);
+		wlr_seat_pointer_notify_motion(harness->seat, event->time_msec, sx, sy);
+		wlr_seat_pointer_notify_frame(harness->seat);
+		harness->focus_client = wl_resource_get_client(surface->resource);
+		harness->stage = SAMPLE_WAIT_CLIENT;
+	} else {
+		wlr_seat_pointer_clear_focus(harness->seat);
+		harness->focus_client = NULL;
+		harness->stage = SAMPLE_WAIT_COMMIT;
+	}
+}
+
+static int handle_input_timer(void *data) {
+	struct harness *harness = data;
+	wl_event_source_timer_update(harness->input_timer, harness->interval_ms);
+
+	int64_t now = get_time_nsec();
+	if (harness->stage != SAMPLE_IDLE) {
+		if (now - harness->input_nsec < SAMPLE_TIMEOUT_NSEC) {
+			return 0;
+		}
+		harness->timeouts++;
+		harness->stage = SAMPLE_IDLE;
+	}
+
+	harness->input_nsec = now;
+	struct wlr_pointer_motion_event event = {
+		.pointer = &harness->pointer,
+		.time_msec = (uint32_t)(now / 1000000),
+		.delta_x = 7,
+		.delta_y = 3,
+		.unaccel_dx = 7,
+		.unaccel_dy = 3,
+	};
+	wl_signal_emit_mutable(&harness->pointer.events.motion, &event);
+	wl_signal_emit_mutable(&harness->pointer.events.frame, &harness->pointer);
+	return 0;
+}
+
+static void handle_output_frame(struct wl_listener *listener, void *data) {
+	struct harness *harness = wl_container_of(listener, harness, output_frame);
+	wlr_scene_output_commit(harness->scene_output, NULL);
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	wlr_scene_output_send_frame_done(harness->scene_output, &now);
+}
+
+static void handle_output_commit(struct wl_listener *listener, void *data) {
+	struct harness *harness = wl_container_of(listener, harness, output_commit);
+	struct wlr_output_event_commit *event = data;
+	if (harness->stage == SAMPLE_WAIT_COMMIT &&
+			(event->state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		harness->commit_seq = harness->output->commit_seq;
+		harness->stage = SAMPLE_WAIT_PRESENT;
+	}
+}
+
+static void handle_output_present(struct wl_listener *listener, void *data) {
+	struct harness *harness = wl_container_of(listener, harness, output_present);
+	struct wlr_output_event_present *event = data;
+	if (harness->stage != SAMPLE_WAIT_PRESENT ||
+			event->commit_seq != harness->commit_seq) {
+		return;
+	}
+	if (!event->presented) {
+		// The next frame will do
+		harness->stage = SAMPLE_WAIT_COMMIT;
+		return;
+	}
+	finish_sample(harness, timespec_to_nsec(&event->when));
+}
+
+static void surface_handle_commit(struct wl_listener *listener, void *data) {
+	struct harness_surface *surface = wl_container_of(listener, surface, commit);
+	struct harness *harness = surface->harness;
+	if (harness->stage == SAMPLE_WAIT_CLIENT &&
+			wl_resource_get_client(surface->surface->resource) ==
+			harness->focus_client) {
+		harness->stage = SAMPLE_WAIT_COMMIT;
+	}
+}
+
+static void surface_handle_destroy(struct wl_listener *listener, void *data) {
+	struct harness_surface *surface = wl_container_of(listener, surface, destroy);
+	wl_list_remove(&surface->commit.link);
+	wl_list_remove(&surface->destroy.link);
+	free(surface);
+}
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+	struct harness *harness = wl_container_of(listener, harness, new_surface);
+	struct wlr_surface *wlr_surface = data;
+
+	struct harness_surface *surface = calloc(1, sizeof(*surface));
+	if (surface == NULL) {
+		return;
+	}
+	surface->harness = harness;
+	surface->surface = wlr_surface;
+	surface->commit.notify = surface_handle_commit;
+	wl_signal_add(&wlr_surface->events.commit, &surface->commit);
+	surface->destroy.notify = surface_handle_destroy;
+	wl_signal_add(&wlr_surface->events.destroy, &surface->destroy);
+}
+
+static void toplevel_handle_commit(struct wl_listener *listener, void *data) {
+	struct harness_toplevel *toplevel = wl_container_of(listener, toplevel, commit);
+	if (toplevel->xdg_toplevel->base->initial_commit) {
+		// Let the client pick its size
+		wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, 0, 0);
+	}
+}
+
+static void toplevel_handle_destroy(struct wl_listener *listener, void *data) {
+	struct harness_toplevel *toplevel = wl_container_of(listener, toplevel, destroy);
+	wl_list_remove(&toplevel->commit.link);
+	wl_list_remove(&toplevel->destroy.link);
+	free(toplevel);
+}
+
+static void handle_new_toplevel(struct wl_listener *listener, void *data) {
+	struct harness *harness = wl_container_of(listener, harness, new_toplevel);
+	struct wlr_xdg_toplevel *xdg_toplevel = data;
+
+	struct harness_toplevel *toplevel = calloc(1, sizeof(*toplevel));
+	if (toplevel == NULL) {
+		return;
+	}
+	toplevel->xdg_toplevel = xdg_toplevel;
+	// All toplevels are stacked at the origin
+	wlr_scene_xdg_surface_create(harness->windows, xdg_toplevel->base);
+
+	toplevel->commit.notify = toplevel_handle_commit;
+	wl_signal_add(&xdg_toplevel->base->surface->events.commit, &toplevel->commit);
+	toplevel->destroy.notify = toplevel_handle_destroy;
+	wl_signal_add(&xdg_toplevel->events.destroy, &toplevel->destroy);
+}
+
+static int compare_int64(const void *a, const void *b) {
+	int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static void print_results(struct harness *harness) {
+	printf("renderer=%s samples=%d interval_ms=%d\n",
+		getenv("WLR_RENDERER") != NULL ? getenv("WLR_RENDERER") : "auto",
+		harness->samples_len, harness->interval_ms);
+	printf("completed=%d\n", harness->samples_done);
+	printf("client_samples=%d\n", harness->client_samples);
+	printf("timeouts=%d\n", harness->timeouts);
+
+	int len = harness->samples_done;
+	if (len == 0) {
+		return;
+	}
+
+	qsort(harness->samples, len, sizeof(harness->samples[0]), compare_int64);
+	int64_t sum = 0;
+	for (int i = 0; i < len; i++) {
+		sum += harness->samples[i];
+	}
+	printf("latency_mean_us=%.2f\n", (double)sum / len / 1000);
+	printf("latency_median_us=%.2f\n", (double)harness->samples[len / 2] / 1000);
+	printf("latency_p99_us=%.2f\n",
+		(double)harness->samples[len * 99 / 100] / 1000);
+	printf("latency_max_us=%.2f\n", (double)harness->samples[len - 1] / 1000);
+}
+
+static const char usage[] =
+	"usage: %s [options]\n"
+	"  -n <n>       number of samples (default: 1000)\n"
+	"  -i <ms>      interval between input events (default: 5)\n"
+	"  -r <w>x<h>   output resolution (default: 1920x1080)\n"
+	"  -s <cmd>     client to start\n";
+
+int main(int argc, char *argv[]) {
+	struct harness harness = {
+		.samples_len = 1000,
+		.interval_ms = 5,
+	};
+	int width = 1920, height = 1080;
+	const char *startup_cmd = NULL;
+
+	int c;
+	while ((c = getopt(argc, argv, "n:i:r:s:")) != -1) {
+		switch (c) {
+		case 'n':
+			harness.samples_len = atoi(optarg);
+			break;
+		case 'i':
+			harness.interval_ms = atoi(optarg);
+			break;
+		case 'r':
+			if (sscanf(optarg, "%dx%d", &width, &height) != 2) {
+				printf(usage, argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 's':
+			startup_cmd = optarg;
+			break;
+		default:
+			printf(usage, argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind < argc || harness.samples_len <= 0 || harness.interval_ms <= 0 ||
+			width <= 0 || height <= 0) {
+		printf(usage, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	wlr_log_init(WLR_ERROR, NULL);
+
+	harness.samples = calloc(harness.samples_len, sizeof(harness.samples[0]));
+	if (harness.samples == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	int ret = EXIT_FAILURE;
+	harness.display = wl_display_create();
+	struct wl_event_loop *loop = wl_display_get_event_loop(harness.display);
+	harness.backend = wlr_headless_backend_create(loop);
+	if (harness.backend == NULL) {
+		goto out_display;
+	}
+
+	harness.renderer = wlr_renderer_autocreate(harness.backend);
+	if (harness.renderer == NULL) {
+		goto out_backend;
+	}
+	wlr_renderer_init_wl_display(harness.renderer, harness.display);
+	harness.allocator = wlr_allocator_autocreate(harness.backend, harness.renderer);
+	if (harness.allocator == NULL) {
+		goto out_renderer;
+	}
+
+	struct wlr_compositor *compositor =
+		wlr_compositor_create(harness.display, 6, harness.renderer);
+	wlr_subcompositor_create(harness.display);
+	harness.new_surface.notify = handle_new_surface;
+	wl_signal_add(&compositor->events.new_surface, &harness.new_surface);
+
+	harness.xdg_shell = wlr_xdg_shell_create(harness.display, 3);
+	harness.new_toplevel.notify = handle_new_toplevel;
+	wl_signal_add(&harness.xdg_shell->events.new_toplevel, &harness.new_toplevel);
+
+	harness.seat = wlr_seat_create(harness.display, "seat0");
+	wlr_seat_set_capabilities(harness.seat, WL_SEAT_CAPABILITY_POINTER);
+
+	wlr_pointer_init(&harness.pointer, &pointer_impl, pointer_impl.name);
+	harness.pointer_motion.notify = handle_pointer_motion;
+	wl_signal_add(&harness.pointer.events.motion, &harness.pointer_motion);
+
+	harness.scene = wlr_scene_create();
+	harness.windows = wlr_scene_tree_create(&harness.scene->tree);
+	float cursor_color[4] = { 1, 1, 1, 1 };
+	harness.cursor = wlr_scene_rect_create(&harness.scene->tree, 16, 16,
+		cursor_color);
+
+	if (!wlr_backend_start(harness.backend)) {
+		goto out_scene;
+	}
+
+	harness.output = wlr_headless_add_output(harness.backend, width, height);
+	if (harness.output == NULL ||
+			!wlr_output_init_render(harness.output, harness.allocator,
+				harness.renderer)) {
+		goto out_scene;
+	}
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	bool ok = wlr_output_commit_state(harness.output, &state);
+	wlr_output_state_finish(&state);
+	if (!ok) {
+		goto out_scene;
+	}
+
+	harness.scene_output = wlr_scene_output_create(harness.scene, harness.output);
+	if (harness.scene_output == NULL) {
+		goto out_scene;
+	}
+
+	harness.output_frame.notify = handle_output_frame;
+	wl_signal_add(&harness.output->events.frame, &harness.output_frame);
+	harness.output_commit.notify = handle_output_commit;
+	wl_signal_add(&harness.output->events.commit, &harness.output_commit);
+	harness.output_present.notify = handle_output_present;
+	wl_signal_add(&harness.output->events.present, &harness.output_present);
+
+	const char *socket = wl_display_add_socket_auto(harness.display);
+	if (socket == NULL) {
+		goto out_output;
+	}
+	setenv("WAYLAND_DISPLAY", socket, true);
+	if (startup_cmd != NULL && fork() == 0) {
+		execl("/bin/sh", "/bin/sh", "-c", startup_cmd, (void *)NULL);
+		_exit(EXIT_FAILURE);
+	}
+
+	harness.input_timer = wl_event_loop_add_timer(loop, handle_input_timer,
+		&harness);
+	wl_event_source_timer_update(harness.input_timer, harness.interval_ms);
+
+	wl_display_run(harness.display);
+
+	print_results(&harness);
+	ret = EXIT_SUCCESS;
+
+	wl_event_source_remove(harness.input_timer);
+	wl_display_destroy_clients(harness.display);
+out_output:
+	wl_list_remove(&harness.output_frame.link);
+	wl_list_remove(&harness.output_commit.link);
+	wl_list_remove(&harness.output_present.link);
+	wlr_scene_output_destroy(harness.scene_output);
+out_scene:
+	wlr_scene_node_destroy(&harness.scene->tree.node);
+	wl_list_remove(&harness.pointer_motion.link);
+	wlr_pointer_finish(&harness.pointer);
+	wl_list_remove(&harness.new_toplevel.link);
+	wl_list_remove(&harness.new_surface.link);
+	wlr_allocator_destroy(harness.allocator);
+out_renderer:
+	wlr_renderer_destroy(harness.renderer);
+out_backend:
+	wlr_backend_destroy(harness.backend);
+out_display:
+	wl_display_destroy(harness.display);
+	free(harness.samples);
+	return ret;
+}
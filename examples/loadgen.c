@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include "linux-dmabuf-v1-client-protocol.h"
+#include "loadgen.h"
+#include "presentation-time-client-protocol.h"
+#include "util/shm.h"
+#include "xdg-shell-client-protocol.h"
+
+static void wm_base_handle_ping(void *data, struct xdg_wm_base *wm_base,
+		uint32_t serial) {
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = wm_base_handle_ping,
+};
+
+static void presentation_handle_clock_id(void *data,
+		struct wp_presentation *presentation, uint32_t clock) {
+	struct loadgen_globals *globals = data;
+	globals->presentation_clock = clock;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+	.clock_id = presentation_handle_clock_id,
+};
+
+static void handle_global(void *data, struct wl_registry *registry,
+		uint32_t name, const char *interface, uint32_t version) {
+	struct loadgen_globals *globals = data;
+	if (strcmp(interface, wl_compositor_interface.name) == 0) {
+		globals->compositor = wl_registry_bind(registry, name,
+			&wl_compositor_interface, 4);
+	} else if (strcmp(interface, wl_subcompositor_interface.name) == 0) {
+		globals->subcompositor = wl_registry_bind(registry, name,
+			&wl_subcompositor_interface, 1);
+	} else if (strcmp(interface, wl_shm_interface.name) == 0) {
+		globals->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, wl_seat_interface.name) == 0 &&
+			globals->seat == NULL) {
+		globals->seat = wl_registry_bind(registry, name, &wl_seat_interface, 1);
+	} else if (strcmp(interface, wl_data_device_manager_interface.name) == 0 &&
+			version >= 2) {
+		globals->data_device_manager = wl_registry_bind(registry, name,
+			&wl_data_device_manager_interface, version < 3 ? version : 3);
+	} else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+		globals->wm_base = wl_registry_bind(registry, name,
+			&xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(globals->wm_base, &wm_base_listener, NULL);
+	} else if (strcmp(interface, wp_presentation_interface.name) == 0) {
+		globals->presentation = wl_registry_bind(registry, name,
+			&wp_presentation_interface, 1);
+		wp_presentation_add_listener(globals->presentation,
+			&presentation_listener, globals);
+	} else if (strcmp(interface, zwp_linux_dmabuf_v1_interface.name) == 0 &&
+			version >= 3) {
+		globals->linux_dmabuf = wl_registry_bind(registry, name,
+			&zwp_linux_dmabuf_v1_interface, 3);
+	}
+}
+
+static void handle_global_remove(void *data, struct wl_registry *registry,
+		uint32_t name) {
+	// Who cares?
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = handle_global,
+	.global_remove = handle_global_remove,
+};
+
+bool loadgen_connect(struct loadgen_globals *globals) {
+	*globals = (struct loadgen_globals){
+		.presentation_clock = CLOCK_MONOTONIC,
+	};
+
+	globals->display = wl_display_connect(NULL);
+	if (globals->display == NULL) {
+		fprintf(stderr, "Failed to connect to the Wayland display\n");
+		return false;
+	}
+
+	globals->registry = wl_display_get_registry(globals->display);
+	wl_registry_add_listener(globals->registry, &registry_listener, globals);
+	// The second roundtrip collects the events sent by the bound globals
+	wl_display_roundtrip(globals->display);
+	wl_display_roundtrip(globals->display);
+
+	if (globals->compositor == NULL || globals->shm == NULL ||
+			globals->wm_base == NULL) {
+		fprintf(stderr, "wl_compositor, wl_shm or xdg_wm_base not supported\n");
+		loadgen_disconnect(globals);
+		return false;
+	}
+
+	return true;
+}
+
+void loadgen_disconnect(struct loadgen_globals *globals) {
+	if (globals->linux_dmabuf != NULL) {
+		zwp_linux_dmabuf_v1_destroy(globals->linux_dmabuf);
+	}
+	if (globals->presentation != NULL) {
+		wp_presentation_destroy(globals->presentation);
+	}
+	if (globals->wm_base != NULL) {
+		xdg_wm_base_destroy(globals->wm_base);
+	}
+	if (globals->data_device_manager != NULL) {
+		wl_data_device_manager_destroy(globals->data_device_manager);
+	}
+	if (globals->seat != NULL) {
+		wl_seat_destroy(globals->seat);
+	}
+	if (globals->shm != NULL) {
+		wl_shm_destroy(globals->shm);
+	}
+	if (globals->subcompositor != NULL) {
+		wl_subcompositor_destroy(globals->subcompositor);
+	}
+	if (globals->compositor != NULL) {
+		wl_compositor_destroy(globals->compositor);
+	}
+	wl_registry_destroy(globals->registry);
+	wl_display_disconnect(globals->display);
+}
+
+int64_t loadgen_clock_ns(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int64_t loadgen_now_ns(void) {
+	return loadgen_clock_ns(CLOCK_MONOTONIC);
+}
+
+static void buffer_handle_release(void *data, struct wl_buffer *wl_buffer) {
+	struct loadgen_buffer *buffer = data;
+	buffer->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	.release = buffer_handle_release,
+};
+
+void loadgen_buffer_init(struct loadgen_buffer *buffer,
+		struct wl_buffer *wl_buffer) {
+	*buffer = (struct loadgen_buffer){
+		.wl_buffer = wl_buffer,
+	};
+	wl_buffer_add_listener(wl_buffer, &buffer_listener, buffer);
+}
+
+bool loadgen_buffer_init_shm(struct loadgen_buffer *buffer,
+		struct loadgen_globals *globals, int width, int height, uint32_t argb) {
+	int stride = width * 4;
+	size_t size = (size_t)stride * height;
+
+	int fd = allocate_shm_file(size);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to allocate shared memory\n");
+		return false;
+	}
+
+	uint32_t *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+	for (size_t i = 0; i < size / 4; i++) {
+		data[i] = argb;
+	}
+	munmap(data, size);
+
+	struct wl_shm_pool *pool = wl_shm_create_pool(globals->shm, fd, size);
+	struct wl_buffer *wl_buffer = wl_shm_pool_create_buffer(pool, 0,
+		width, height, stride, WL_SHM_FORMAT_ARGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+
+	loadgen_buffer_init(buffer, wl_buffer);
+	return true;
+}
+
+void loadgen_buffer_finish(struct loadgen_buffer *buffer) {
+	if (buffer->wl_buffer != NULL) {
+		wl_buffer_destroy(buffer->wl_buffer);
+	}
+	buffer->wl_buffer = NULL;
+}
+
+static void xdg_surface_handle_configure(void *data,
+		struct xdg_surface *xdg_surface, uint32_t serial) {
+	struct loadgen_window *window = data;
+	xdg_surface_ack_configure(xdg_surface, serial);
+	window->configured = true;
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_handle_configure,
+};
+
+static void xdg_toplevel_handle_configure(void *data,
+		struct xdg_toplevel *xdg_toplevel, int32_t width, int32_t height,
+		struct wl_array *states) {
+	struct loadgen_window *window = data;
+	if (width > 0 && height > 0) {
+		window->width = width;
+		window->height = height;
+	}
+}
+
+static void xdg_toplevel_handle_close(void *data,
+		struct xdg_toplevel *xdg_toplevel) {
+	struct loadgen_window *window = data;
+	window->closed = true;
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+	.configure = xdg_toplevel_handle_configure,
+	.close = xdg_toplevel_handle_close,
+};
+
+bool loadgen_window_init(struct loadgen_window *window,
+		struct loadgen_globals *globals, const char *title) {
+	*window = (struct loadgen_window){0};
+
+	window->surface = wl_compositor_create_surface(globals->compositor);
+	window->xdg_surface = xdg_wm_base_get_xdg_surface(globals->wm_base,
+		window->surface);
+	xdg_surface_add_listener(window->xdg_surface, &xdg_surface_listener, window);
+	window->xdg_toplevel = xdg_surface_get_toplevel(window->xdg_surface);
+	xdg_toplevel_add_listener(window->xdg_toplevel, &xdg_toplevel_listener,
+		window);
+	xdg_toplevel_set_title(window->xdg_toplevel, title);
+	xdg_toplevel_set_app_id(window->xdg_toplevel, "wlroots-loadgen");
+	wl_surface_commit(window->surface);
+
+	while (!window->configured) {
+		if (wl_display_dispatch(globals->display) < 0) {
+			fprintf(stderr, "Failed to wait for the initial configure\n");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void loadgen_window_finish(struct loadgen_window *window) {
+	xdg_toplevel_destroy(window->xdg_toplevel);
+	xdg_surface_destroy(window->xdg_surface);
+	wl_surface_destroy(window->surface);
+}
+
+void loadgen_samples_add(struct loadgen_samples *samples, int64_t value) {
+	if (samples->len == samples->cap) {
+		size_t cap = samples->cap == 0 ? 256 : samples->cap * 2;
+		int64_t *values = realloc(samples->values, cap * sizeof(*values));
+		if (values == NULL) {
+			return;
+		}
+		samples->values = values;
+		samples->cap = cap;
+	}
+	samples->values[samples->len++] = value;
+}
+
+static int compare_samples(const void *a, const void *b) {
+	int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+	return (x > y) - (x < y);
+}
+
+void loadgen_samples_print(struct loadgen_samples *samples, const char *prefix) {
+	printf("%s_samples=%zu\n", prefix, samples->len);
+	if (samples->len == 0) {
+		return;
+	}
+
+	qsort(samples->values, samples->len, sizeof(samples->values[0]),
+		compare_samples);
+
+	int64_t sum = 0;
+	for (size_t i = 0; i < samples->len; i++) {
+		sum += samples->values[i];
+	}
+
+	printf("%s_mean_us=%.2f\n", prefix, (double)sum / samples->len / 1000);
+	printf("%s_median_us=%.2f\n", prefix,
+		(double)samples->values[samples->len / 2] / 1000);
+	printf("%s_p99_us=%.2f\n", prefix,
+		(double)samples->values[samples->len * 99 / 100] / 1000);
+	printf("%s_max_us=%.2f\n", prefix,
+		(double)samples->values[samples->len - 1] / 1000);
+}
+
+void loadgen_samples_finish(struct loadgen_samples *samples) {
+	free(samples->values);
+	*samples = (struct loadgen_samples){0};
+}
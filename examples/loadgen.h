@@ -0,0 +1,89 @@
+#ifndef EXAMPLES_LOADGEN_H
+#define EXAMPLES_LOADGEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <wayland-client.h>
+
+/**
+ * Helpers shared by the load generator clients. They connect to the
+ * compositor given by WAYLAND_DISPLAY, create a workload and print their
+ * results as "key=value" lines on stdout, like scene-bench.
+ */
+
+struct loadgen_globals {
+	struct wl_display *display;
+	struct wl_registry *registry;
+
+	struct wl_compositor *compositor;
+	struct wl_subcompositor *subcompositor;
+	struct wl_shm *shm;
+	struct wl_seat *seat;
+	struct wl_data_device_manager *data_device_manager;
+	struct xdg_wm_base *wm_base;
+	struct wp_presentation *presentation;
+	struct zwp_linux_dmabuf_v1 *linux_dmabuf;
+
+	clockid_t presentation_clock;
+};
+
+struct loadgen_buffer {
+	struct wl_buffer *wl_buffer;
+	bool busy;
+};
+
+struct loadgen_window {
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *xdg_toplevel;
+	int width, height;
+	bool configured, closed;
+};
+
+struct loadgen_samples {
+	int64_t *values;
+	size_t len, cap;
+};
+
+/**
+ * Connect to the compositor and bind the globals. Fails if wl_compositor,
+ * wl_shm or xdg_wm_base are missing, other globals are left NULL if the
+ * compositor doesn't advertise them.
+ */
+bool loadgen_connect(struct loadgen_globals *globals);
+void loadgen_disconnect(struct loadgen_globals *globals);
+
+int64_t loadgen_now_ns(void);
+int64_t loadgen_clock_ns(clockid_t clock);
+
+/**
+ * Create a wl_shm buffer filled with a solid color. The busy flag is set on
+ * attach by the caller and cleared when the compositor releases the buffer.
+ */
+bool loadgen_buffer_init_shm(struct loadgen_buffer *buffer,
+	struct loadgen_globals *globals, int width, int height, uint32_t argb);
+void loadgen_buffer_finish(struct loadgen_buffer *buffer);
+/**
+ * Listen to the release event of a wl_buffer created by the caller.
+ */
+void loadgen_buffer_init(struct loadgen_buffer *buffer,
+	struct wl_buffer *wl_buffer);
+
+/**
+ * Create a toplevel and wait for its initial configure event.
+ */
+bool loadgen_window_init(struct loadgen_window *window,
+	struct loadgen_globals *globals, const char *title);
+void loadgen_window_finish(struct loadgen_window *window);
+
+void loadgen_samples_add(struct loadgen_samples *samples, int64_t value);
+/**
+ * Print the mean, median, 99th percentile and maximum of the samples, which
+ * are expected to be in nanoseconds, as "<prefix>_<stat>_us=<value>" lines.
+ */
+void loadgen_samples_print(struct loadgen_samples *samples, const char *prefix);
+void loadgen_samples_finish(struct loadgen_samples *samples);
+
+#endif
@@ -0,0 +1,189 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wayland-client.h>
+#include "loadgen.h"
+#include "xdg-shell-client-protocol.h"
+
+/**
+ * Repeatedly opens chains of nested popups on a toplevel, maps them and
+ * closes them again. The reported latency is the time between the creation of
+ * a popup and its initial configure event.
+ */
+
+struct storm_popup {
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_popup *xdg_popup;
+	bool configured, done;
+};
+
+static void xdg_surface_handle_configure(void *data,
+		struct xdg_surface *xdg_surface, uint32_t serial) {
+	struct storm_popup *popup = data;
+	xdg_surface_ack_configure(xdg_surface, serial);
+	popup->configured = true;
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_handle_configure,
+};
+
+static void xdg_popup_handle_configure(void *data, struct xdg_popup *xdg_popup,
+		int32_t x, int32_t y, int32_t width, int32_t height) {
+	// The position is up to the compositor
+}
+
+static void xdg_popup_handle_popup_done(void *data,
+		struct xdg_popup *xdg_popup) {
+	struct storm_popup *popup = data;
+	popup->done = true;
+}
+
+static const struct xdg_popup_listener xdg_popup_listener = {
+	.configure = xdg_popup_handle_configure,
+	.popup_done = xdg_popup_handle_popup_done,
+};
+
+static void popup_finish(struct storm_popup *popup) {
+	xdg_popup_destroy(popup->xdg_popup);
+	xdg_surface_destroy(popup->xdg_surface);
+	wl_surface_destroy(popup->surface);
+}
+
+static const char usage[] =
+	"usage: %s [options]\n"
+	"  -n <n>  number of popup chains (default: 1000)\n"
+	"  -d <n>  number of nested popups per chain (default: 4)\n"
+	"  -s <n>  popup size in pixels (default: 64)\n";
+
+int main(int argc, char *argv[]) {
+	int chains = 1000;
+	int depth = 4;
+	int size = 64;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:d:s:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			chains = atoi(optarg);
+			break;
+		case 'd':
+			depth = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		default:
+			printf(usage, argv[0]);
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (chains <= 0 || depth <= 0 || size <= 0) {
+		printf(usage, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	struct loadgen_globals globals;
+	if (!loadgen_connect(&globals)) {
+		return EXIT_FAILURE;
+	}
+
+	struct loadgen_window window;
+	if (!loadgen_window_init(&window, &globals, "popup-storm")) {
+		return EXIT_FAILURE;
+	}
+
+	int parent_size = size * 2;
+	struct loadgen_buffer parent_buffer, popup_buffer;
+	if (!loadgen_buffer_init_shm(&parent_buffer, &globals, parent_size,
+			parent_size, 0xFF202020) ||
+			!loadgen_buffer_init_shm(&popup_buffer, &globals, size, size,
+				0xFFE0E0E0)) {
+		return EXIT_FAILURE;
+	}
+	wl_surface_attach(window.surface, parent_buffer.wl_buffer, 0, 0);
+	wl_surface_commit(window.surface);
+
+	struct storm_popup *popups = calloc(depth, sizeof(*popups));
+	if (popups == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	struct loadgen_samples latencies = {0};
+	size_t dismissed = 0;
+
+	int64_t start = loadgen_now_ns();
+	for (int i = 0; i < chains; i++) {
+		int opened = 0;
+		for (int j = 0; j < depth; j++) {
+			struct storm_popup *popup = &popups[j];
+			*popup = (struct storm_popup){0};
+
+			int anchor_size = j == 0 ? parent_size : size;
+			struct xdg_positioner *positioner =
+				xdg_wm_base_create_positioner(globals.wm_base);
+			xdg_positioner_set_size(positioner, size, size);
+			xdg_positioner_set_anchor_rect(positioner, 0, 0,
+				anchor_size, anchor_size);
+			xdg_positioner_set_anchor(positioner, XDG_POSITIONER_ANCHOR_BOTTOM_RIGHT);
+			xdg_positioner_set_gravity(positioner,
+				XDG_POSITIONER_GRAVITY_BOTTOM_RIGHT);
+
+			struct xdg_surface *parent = j == 0 ?
+				window.xdg_surface : popups[j - 1].xdg_surface;
+
+			int64_t create_ns = loadgen_now_ns();
+			popup->surface = wl_compositor_create_surface(globals.compositor);
+			popup->xdg_surface = xdg_wm_base_get_xdg_surface(globals.wm_base,
+				popup->surface);
+			xdg_surface_add_listener(popup->xdg_surface, &xdg_surface_listener,
+				popup);
+			popup->xdg_popup = xdg_surface_get_popup(popup->xdg_surface,
+				parent, positioner);
+			xdg_popup_add_listener(popup->xdg_popup, &xdg_popup_listener, popup);
+			xdg_positioner_destroy(positioner);
+			wl_surface_commit(popup->surface);
+			opened++;
+
+			while (!popup->configured && !popup->done) {
+				if (wl_display_dispatch(globals.display) < 0) {
+					fprintf(stderr, "Lost connection to the compositor\n");
+					return EXIT_FAILURE;
+				}
+			}
+			if (popup->done) {
+				dismissed++;
+				break;
+			}
+			loadgen_samples_add(&latencies, loadgen_now_ns() - create_ns);
+
+			wl_surface_attach(popup->surface, popup_buffer.wl_buffer, 0, 0);
+			wl_surface_commit(popup->surface);
+		}
+
+		// Popups must be destroyed from the topmost one
+		for (int j = opened - 1; j >= 0; j--) {
+			popup_finish(&popups[j]);
+		}
+		if (wl_display_roundtrip(globals.display) < 0) {
+			fprintf(stderr, "Lost connection to the compositor\n");
+			return EXIT_FAILURE;
+		}
+	}
+	int64_t elapsed = loadgen_now_ns() - start;
+
+	printf("chains=%d depth=%d size=%d\n", chains, depth, size);
+	printf("popups=%zu\n", latencies.len);
+	printf("dismissed=%zu\n", dismissed);
+	printf("popups_per_sec=%.2f\n", (double)latencies.len * 1000000000 / elapsed);
+	loadgen_samples_print(&latencies, "configure_latency");
+
+	loadgen_samples_finish(&latencies);
+	free(popups);
+	loadgen_buffer_finish(&popup_buffer);
+	loadgen_buffer_finish(&parent_buffer);
+	loadgen_window_finish(&window);
+	loadgen_disconnect(&globals);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,296 @@
+#include <getopt.h>
+#include <pixman.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wayland-server-protocol.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+#include <wlr/util/region.h>
+#include <wlr/util/transform.h>
+#include "util/rect_union.h"
+
+/**
+ * Micro-benchmarks for the region, rect_union, box and transform helpers used
+ * on every frame, fed with synthetic damage resembling real workloads.
+ *
+ * Each benchmark runs for at least the requested duration and reports the
+ * average time per operation as "name ns_per_op=<value>".
+ */
+
+#define OUTPUT_WIDTH 1920
+#define OUTPUT_HEIGHT 1080
+
+struct damage_set {
+	const char *name;
+	pixman_box32_t *boxes;
+	int boxes_len;
+	pixman_region32_t region;
+};
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng_next(void) {
+	// xorshift32, deterministic across runs
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static void damage_set_add(struct damage_set *set, int x, int y,
+		int width, int height) {
+	set->boxes[set->boxes_len++] = (pixman_box32_t){
+		.x1 = x,
+		.y1 = y,
+		.x2 = x + width,
+		.y2 = y + height,
+	};
+}
+
+// Glyph-sized damage, clustered on a few lines like a terminal printing text
+static void init_terminal_damage(struct damage_set *set) {
+	const int cell_width = 9, cell_height = 18;
+	const int cols = OUTPUT_WIDTH / cell_width;
+	const int rows = OUTPUT_HEIGHT / cell_height;
+	for (int line = 0; line < 8; line++) {
+		int row = rng_next() % rows;
+		int col = rng_next() % (cols / 2);
+		int len = 4 + rng_next() % 40;
+		for (int i = 0; i < len && col + i < cols; i++) {
+			damage_set_add(set, (col + i) * cell_width, row * cell_height,
+				cell_width, cell_height);
+		}
+	}
+	// The cursor
+	damage_set_add(set, (rng_next() % cols) * cell_width,
+		(rng_next() % rows) * cell_height, cell_width, cell_height);
+}
+
+// A large video frame plus a few small controls and a progress bar
+static void init_video_damage(struct damage_set *set) {
+	damage_set_add(set, 320, 180, 1280, 720);
+	damage_set_add(set, 320, 880, 1280, 6);
+	for (int i = 0; i < 4; i++) {
+		damage_set_add(set, 340 + i * 40, 900, 32, 32);
+	}
+	damage_set_add(set, 1500, 900, 80, 24);
+}
+
+// A scrolled view with a scrollbar and a few partially updated lines
+static void init_scrolling_damage(struct damage_set *set) {
+	damage_set_add(set, 200, 100, 1400, 880);
+	damage_set_add(set, 1600, 100, 12, 880);
+	for (int i = 0; i < 12; i++) {
+		int y = 80 + (rng_next() % 920);
+		damage_set_add(set, 180 + (rng_next() % 40), y, 200 + rng_next() % 1300, 20);
+	}
+}
+
+static bool damage_set_init(struct damage_set *set, const char *name,
+		void (*init)(struct damage_set *set)) {
+	*set = (struct damage_set){ .name = name };
+	set->boxes = calloc(1024, sizeof(set->boxes[0]));
+	if (set->boxes == NULL) {
+		return false;
+	}
+	init(set);
+
+	pixman_region32_init(&set->region);
+	for (int i = 0; i < set->boxes_len; i++) {
+		pixman_box32_t *b = &set->boxes[i];
+		pixman_region32_union_rect(&set->region, &set->region,
+			b->x1, b->y1, b->x2 - b->x1, b->y2 - b->y1);
+	}
+	return true;
+}
+
+static void damage_set_finish(struct damage_set *set) {
+	pixman_region32_fini(&set->region);
+	free(set->boxes);
+}
+
+static int64_t get_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+typedef void (*bench_func_t)(struct damage_set *set);
+
+static int64_t min_duration_ns = 200 * 1000000;
+
+// Keeps the compiler from optimizing the benchmarked code away
+static volatile int64_t sink;
+
+static void run_bench(const char *name, struct damage_set *set,
+		bench_func_t func) {
+	// Warm up the caches
+	func(set);
+
+	int64_t iterations = 0;
+	int64_t start = get_time_nsec(), elapsed;
+	do {
+		for (int i = 0; i < 64; i++) {
+			func(set);
+		}
+		iterations += 64;
+		elapsed = get_time_nsec() - start;
+	} while (elapsed < min_duration_ns);
+
+	printf("%s/%s rects=%d ns_per_op=%.1f\n", name, set->name,
+		pixman_region32_n_rects(&set->region), (double)elapsed / iterations);
+}
+
+static void bench_pixman_union(struct damage_set *set) {
+	pixman_region32_t region;
+	pixman_region32_init(&region);
+	for (int i = 0; i < set->boxes_len; i++) {
+		pixman_box32_t *b = &set->boxes[i];
+		pixman_region32_union_rect(&region, &region,
+			b->x1, b->y1, b->x2 - b->x1, b->y2 - b->y1);
+	}
+	sink += pixman_region32_n_rects(&region);
+	pixman_region32_fini(&region);
+}
+
+static void bench_rect_union(struct damage_set *set) {
+	struct rect_union r;
+	rect_union_init(&r);
+	for (int i = 0; i < set->boxes_len; i++) {
+		rect_union_add(&r, set->boxes[i]);
+	}
+	sink += pixman_region32_n_rects(rect_union_evaluate(&r));
+	rect_union_finish(&r);
+}
+
+static void bench_region_scale(struct damage_set *set) {
+	pixman_region32_t dst;
+	pixman_region32_init(&dst);
+	wlr_region_scale(&dst, &set->region, 1.5);
+	sink += pixman_region32_n_rects(&dst);
+	pixman_region32_fini(&dst);
+}
+
+static void bench_region_scale_int(struct damage_set *set) {
+	pixman_region32_t dst;
+	pixman_region32_init(&dst);
+	wlr_region_scale(&dst, &set->region, 2);
+	sink += pixman_region32_n_rects(&dst);
+	pixman_region32_fini(&dst);
+}
+
+static void bench_region_transform(struct damage_set *set) {
+	pixman_region32_t dst;
+	pixman_region32_init(&dst);
+	wlr_region_transform(&dst, &set->region, WL_OUTPUT_TRANSFORM_FLIPPED_90,
+		OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	sink += pixman_region32_n_rects(&dst);
+	pixman_region32_fini(&dst);
+}
+
+static void bench_region_expand(struct damage_set *set) {
+	pixman_region32_t dst;
+	pixman_region32_init(&dst);
+	wlr_region_expand(&dst, &set->region, 2);
+	sink += pixman_region32_n_rects(&dst);
+	pixman_region32_fini(&dst);
+}
+
+static void bench_region_rotated_bounds(struct damage_set *set) {
+	pixman_region32_t dst;
+	pixman_region32_init(&dst);
+	wlr_region_rotated_bounds(&dst, &set->region, 0.3,
+		OUTPUT_WIDTH / 2, OUTPUT_HEIGHT / 2);
+	sink += pixman_region32_n_rects(&dst);
+	pixman_region32_fini(&dst);
+}
+
+static void bench_box_transform_intersect(struct damage_set *set) {
+	struct wlr_box output_box = {
+		.width = OUTPUT_WIDTH,
+		.height = OUTPUT_HEIGHT,
+	};
+	for (int i = 0; i < set->boxes_len; i++) {
+		pixman_box32_t *b = &set->boxes[i];
+		struct wlr_box box = {
+			.x = b->x1,
+			.y = b->y1,
+			.width = b->x2 - b->x1,
+			.height = b->y2 - b->y1,
+		};
+		struct wlr_box transformed, intersection;
+		wlr_box_transform(&transformed, &box, WL_OUTPUT_TRANSFORM_90,
+			OUTPUT_WIDTH, OUTPUT_HEIGHT);
+		if (wlr_box_intersection(&intersection, &transformed, &output_box)) {
+			sink += intersection.width;
+		}
+	}
+}
+
+static void bench_output_transform(struct damage_set *set) {
+	for (int i = 0; i < set->boxes_len; i++) {
+		enum wl_output_transform a = i % 8, b = (i / 8) % 8;
+		enum wl_output_transform tr =
+			wlr_output_transform_compose(a, wlr_output_transform_invert(b));
+		int x = set->boxes[i].x1, y = set->boxes[i].y1;
+		wlr_output_transform_coords(tr, &x, &y);
+		sink += x + y;
+	}
+}
+
+static const struct {
+	const char *name;
+	bench_func_t func;
+} benches[] = {
+	{ "pixman_union", bench_pixman_union },
+	{ "rect_union", bench_rect_union },
+	{ "region_scale", bench_region_scale },
+	{ "region_scale_int", bench_region_scale_int },
+	{ "region_transform", bench_region_transform },
+	{ "region_expand", bench_region_expand },
+	{ "region_rotated_bounds", bench_region_rotated_bounds },
+	{ "box_transform_intersect", bench_box_transform_intersect },
+	{ "output_transform", bench_output_transform },
+};
+
+int main(int argc, char *argv[]) {
+	int c;
+	while ((c = getopt(argc, argv, "t:")) != -1) {
+		switch (c) {
+		case 't':
+			min_duration_ns = (int64_t)atoi(optarg) * 1000000;
+			break;
+		default:
+			printf("usage: %s [-t min-duration-ms]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind < argc || min_duration_ns <= 0) {
+		printf("usage: %s [-t min-duration-ms]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct damage_set sets[3];
+	if (!damage_set_init(&sets[0], "terminal", init_terminal_damage) ||
+			!damage_set_init(&sets[1], "video", init_video_damage) ||
+			!damage_set_init(&sets[2], "scrolling", init_scrolling_damage)) {
+		fprintf(stderr, "Allocation failed\n");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		for (size_t j = 0; j < sizeof(sets) / sizeof(sets[0]); j++) {
+			run_bench(benches[i].name, &sets[j], benches[i].func);
+		}
+	}
+
+	for (size_t i = 0; i < sizeof(sets) / sizeof(sets[0]); i++) {
+		damage_set_finish(&sets[i]);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,413 @@
+#include <drm_fourcc.h>
+#include <getopt.h>
+#include <pixman.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/log.h>
+
+/**
+ * Renders a synthetic scene on a headless output in a loop and reports the
+ * CPU time spent in wlr_scene_output_build_state(), along with the number of
+ * damage rectangles and visible buffers per frame.
+ *
+ * The renderer can be selected with WLR_RENDERER, e.g. WLR_RENDERER=pixman.
+ * Results are printed as "key=value" pairs to make comparing runs easy.
+ */
+
+enum damage_pattern {
+	DAMAGE_NONE,
+	DAMAGE_MOVE, // move one window per frame
+	DAMAGE_CONTENT, // damage a small area of one subsurface per frame
+	DAMAGE_FULL, // damage the whole output
+};
+
+struct bench_options {
+	int windows;
+	int subsurfaces;
+	int frames;
+	int overlap; // percentage
+	enum damage_pattern damage;
+	int width, height;
+};
+
+struct bench_window {
+	struct wlr_scene_tree *tree;
+	struct wlr_scene_buffer **subsurfaces;
+};
+
+struct bench_state {
+	struct bench_options options;
+	struct wlr_scene *scene;
+	struct wlr_scene_rect *background;
+	struct bench_window *windows;
+	struct wlr_buffer *buffer;
+};
+
+static const char usage[] =
+	"usage: %s [options]\n"
+	"  -w <n>     number of windows (default: 16)\n"
+	"  -s <n>     number of subsurfaces per window (default: 2)\n"
+	"  -f <n>     number of frames (default: 1000)\n"
+	"  -o <pct>   overlap between neighbouring windows in percent (default: 25)\n"
+	"  -d <mode>  damage pattern: none, move, content, full (default: move)\n"
+	"  -r <w>x<h> output resolution (default: 1920x1080)\n";
+
+static bool parse_damage_pattern(const char *str, enum damage_pattern *out) {
+	static const char *const names[] = {
+		[DAMAGE_NONE] = "none",
+		[DAMAGE_MOVE] = "move",
+		[DAMAGE_CONTENT] = "content",
+		[DAMAGE_FULL] = "full",
+	};
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (strcmp(str, names[i]) == 0) {
+			*out = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static int64_t timespec_to_nsec(const struct timespec *ts) {
+	return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static int64_t thread_cpu_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return timespec_to_nsec(&now);
+}
+
+static int compare_int64(const void *a, const void *b) {
+	int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static bool build_scene(struct bench_state *bench) {
+	const struct bench_options *options = &bench->options;
+
+	float background_color[4] = { 0.2, 0.2, 0.2, 1.0 };
+	bench->background = wlr_scene_rect_create(&bench->scene->tree,
+		options->width, options->height, background_color);
+	if (bench->background == NULL) {
+		return false;
+	}
+
+	bench->windows = calloc(options->windows, sizeof(bench->windows[0]));
+	if (bench->windows == NULL) {
+		return false;
+	}
+
+	// Lay windows out on a grid, shrinking the spacing to get the requested
+	// overlap
+	int cols = 1;
+	while (cols * cols < options->windows) {
+		cols++;
+	}
+	int win_width = options->width / cols;
+	int win_height = options->height / cols;
+	int step_x = win_width * (100 - options->overlap) / 100;
+	int step_y = win_height * (100 - options->overlap) / 100;
+
+	for (int i = 0; i < options->windows; i++) {
+		struct bench_window *window = &bench->windows[i];
+		window->tree = wlr_scene_tree_create(&bench->scene->tree);
+		if (window->tree == NULL) {
+			return false;
+		}
+		wlr_scene_node_set_position(&window->tree->node,
+			(i % cols) * step_x, (i / cols) * step_y);
+
+		struct wlr_scene_buffer *main_buffer =
+			wlr_scene_buffer_create(window->tree, bench->buffer);
+		if (main_buffer == NULL) {
+			return false;
+		}
+		wlr_scene_buffer_set_dest_size(main_buffer, win_width, win_height);
+
+		window->subsurfaces = calloc(options->subsurfaces,
+			sizeof(window->subsurfaces[0]));
+		if (window->subsurfaces == NULL && options->subsurfaces > 0) {
+			return false;
+		}
+		for (int j = 0; j < options->subsurfaces; j++) {
+			struct wlr_scene_buffer *subsurface =
+				wlr_scene_buffer_create(window->tree, bench->buffer);
+			if (subsurface == NULL) {
+				return false;
+			}
+			wlr_scene_buffer_set_dest_size(subsurface,
+				win_width / 4, win_height / 4);
+			wlr_scene_node_set_position(&subsurface->node,
+				(j * 17) % (win_width / 2), (j * 31) % (win_height / 2));
+			window->subsurfaces[j] = subsurface;
+		}
+	}
+
+	return true;
+}
+
+static void destroy_scene(struct bench_state *bench) {
+	if (bench->windows != NULL) {
+		for (int i = 0; i < bench->options.windows; i++) {
+			free(bench->windows[i].subsurfaces);
+		}
+		free(bench->windows);
+	}
+	wlr_scene_node_destroy(&bench->scene->tree.node);
+}
+
+static void apply_damage_pattern(struct bench_state *bench, int frame) {
+	const struct bench_options *options = &bench->options;
+	if (options->windows == 0) {
+		return;
+	}
+
+	struct bench_window *window = &bench->windows[frame % options->windows];
+	switch (options->damage) {
+	case DAMAGE_NONE:
+		break;
+	case DAMAGE_MOVE:;
+		// Move back and forth to keep the layout stable over time
+		int dx = (frame / options->windows) % 2 == 0 ? 1 : -1;
+		wlr_scene_node_set_position(&window->tree->node,
+			window->tree->node.x + dx, window->tree->node.y);
+		break;
+	case DAMAGE_CONTENT:
+		if (options->subsurfaces > 0) {
+			struct wlr_scene_buffer *subsurface =
+				window->subsurfaces[frame % options->subsurfaces];
+			pixman_region32_t damage;
+			pixman_region32_init_rect(&damage, 0, 0, 16, 16);
+			wlr_scene_buffer_set_buffer_with_damage(subsurface,
+				bench->buffer, &damage);
+			pixman_region32_fini(&damage);
+		}
+		break;
+	case DAMAGE_FULL:;
+		float color[4] = { 0.2, 0.2, (frame % 2) * 0.2, 1.0 };
+		wlr_scene_rect_set_color(bench->background, color);
+		break;
+	}
+}
+
+static void count_buffer_iterator(struct wlr_scene_buffer *buffer,
+		int sx, int sy, void *user_data) {
+	int *count = user_data;
+	(*count)++;
+}
+
+static bool run_bench(struct bench_state *bench, struct wlr_output *output) {
+	const struct bench_options *options = &bench->options;
+
+	struct wlr_scene_output *scene_output =
+		wlr_scene_output_create(bench->scene, output);
+	if (scene_output == NULL) {
+		return false;
+	}
+
+	int64_t *cpu_times = calloc(options->frames, sizeof(cpu_times[0]));
+	if (cpu_times == NULL) {
+		wlr_scene_output_destroy(scene_output);
+		return false;
+	}
+
+	int64_t total_cpu_time = 0;
+	uint64_t total_damage_rects = 0, total_buffers = 0;
+	int committed_frames = 0;
+	for (int i = 0; i < options->frames; i++) {
+		apply_damage_pattern(bench, i);
+
+		struct wlr_output_state state;
+		wlr_output_state_init(&state);
+
+		int64_t start = thread_cpu_time_nsec();
+		bool ok = wlr_scene_output_build_state(scene_output, &state, NULL);
+		cpu_times[i] = thread_cpu_time_nsec() - start;
+		total_cpu_time += cpu_times[i];
+
+		if (ok && (state.committed & WLR_OUTPUT_STATE_DAMAGE)) {
+			total_damage_rects += pixman_region32_n_rects(&state.damage);
+		}
+		if (ok && (state.committed & WLR_OUTPUT_STATE_BUFFER)) {
+			committed_frames++;
+		}
+		int buffers = 0;
+		wlr_scene_output_for_each_buffer(scene_output, count_buffer_iterator,
+			&buffers);
+		total_buffers += buffers;
+
+		if (ok && !wlr_output_commit_state(output, &state)) {
+			wlr_log(WLR_ERROR, "Failed to commit frame %d", i);
+		}
+		wlr_output_state_finish(&state);
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		wlr_scene_output_send_frame_done(scene_output, &now);
+	}
+
+	qsort(cpu_times, options->frames, sizeof(cpu_times[0]), compare_int64);
+	int p99_index = options->frames * 99 / 100;
+	if (p99_index >= options->frames) {
+		p99_index = options->frames - 1;
+	}
+
+	printf("renderer=%s windows=%d subsurfaces=%d overlap=%d frames=%d\n",
+		getenv("WLR_RENDERER") != NULL ? getenv("WLR_RENDERER") : "auto",
+		options->windows, options->subsurfaces, options->overlap,
+		options->frames);
+	printf("rendered_frames=%d\n", committed_frames);
+	printf("cpu_time_mean_us=%.2f\n",
+		(double)total_cpu_time / options->frames / 1000);
+	printf("cpu_time_median_us=%.2f\n",
+		(double)cpu_times[options->frames / 2] / 1000);
+	printf("cpu_time_p99_us=%.2f\n", (double)cpu_times[p99_index] / 1000);
+	printf("cpu_time_max_us=%.2f\n",
+		(double)cpu_times[options->frames - 1] / 1000);
+	printf("damage_rects_mean=%.2f\n",
+		(double)total_damage_rects / options->frames);
+	printf("visible_buffers_mean=%.2f\n",
+		(double)total_buffers / options->frames);
+
+	free(cpu_times);
+	wlr_scene_output_destroy(scene_output);
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	struct bench_options options = {
+		.windows = 16,
+		.subsurfaces = 2,
+		.frames = 1000,
+		.overlap = 25,
+		.damage = DAMAGE_MOVE,
+		.width = 1920,
+		.height = 1080,
+	};
+
+	int c;
+	while ((c = getopt(argc, argv, "w:s:f:o:d:r:")) != -1) {
+		switch (c) {
+		case 'w':
+			options.windows = atoi(optarg);
+			break;
+		case 's':
+			options.subsurfaces = atoi(optarg);
+			break;
+		case 'f':
+			options.frames = atoi(optarg);
+			break;
+		case 'o':
+			options.overlap = atoi(optarg);
+			break;
+		case 'd':
+			if (!parse_damage_pattern(optarg, &options.damage)) {
+				printf(usage, argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'r':
+			if (sscanf(optarg, "%dx%d", &options.width, &options.height) != 2) {
+				printf(usage, argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			printf(usage, argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind < argc || options.windows < 0 || options.subsurfaces < 0 ||
+			options.frames <= 0 || options.overlap < 0 || options.overlap >= 100 ||
+			options.width <= 0 || options.height <= 0) {
+		printf(usage, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	wlr_log_init(WLR_ERROR, NULL);
+
+	int ret = EXIT_FAILURE;
+	struct wl_display *display = wl_display_create();
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	struct wlr_backend *backend = wlr_headless_backend_create(loop);
+	if (backend == NULL) {
+		goto out_display;
+	}
+
+	struct wlr_renderer *renderer = wlr_renderer_autocreate(backend);
+	if (renderer == NULL) {
+		goto out_backend;
+	}
+	struct wlr_allocator *allocator = wlr_allocator_autocreate(backend, renderer);
+	if (allocator == NULL) {
+		goto out_renderer;
+	}
+
+	if (!wlr_backend_start(backend)) {
+		goto out_allocator;
+	}
+
+	struct wlr_output *output =
+		wlr_headless_add_output(backend, options.width, options.height);
+	if (output == NULL || !wlr_output_init_render(output, allocator, renderer)) {
+		goto out_allocator;
+	}
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	bool ok = wlr_output_commit_state(output, &state);
+	wlr_output_state_finish(&state);
+	if (!ok) {
+		goto out_allocator;
+	}
+
+	const struct wlr_drm_format_set *texture_formats =
+		wlr_renderer_get_texture_formats(renderer, allocator->buffer_caps);
+	const struct wlr_drm_format *format = texture_formats != NULL ?
+		wlr_drm_format_set_get(texture_formats, DRM_FORMAT_ARGB8888) : NULL;
+	if (format == NULL) {
+		wlr_log(WLR_ERROR, "Renderer doesn't support ARGB8888 textures");
+		goto out_allocator;
+	}
+
+	struct bench_state bench = {
+		.options = options,
+		.scene = wlr_scene_create(),
+	};
+	bench.buffer = wlr_allocator_create_buffer(allocator, 256, 256, format);
+	if (bench.scene == NULL || bench.buffer == NULL) {
+		goto out_bench;
+	}
+
+	if (build_scene(&bench) && run_bench(&bench, output)) {
+		ret = EXIT_SUCCESS;
+	}
+
+out_bench:
+	if (bench.scene != NULL) {
+		destroy_scene(&bench);
+	}
+	wlr_buffer_drop(bench.buffer);
+out_allocator:
+	wlr_allocator_destroy(allocator);
+out_renderer:
+	wlr_renderer_destroy(renderer);
+out_backend:
+	wlr_backend_destroy(backend);
+out_display:
+	wl_display_destroy(display);
+	return ret;
+}
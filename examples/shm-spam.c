@@ -0,0 +1,124 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wayland-client.h>
+#include "loadgen.h"
+
+/**
+ * Creates many small toplevels and commits a new wl_shm buffer on each of
+ * them every iteration, as fast as the compositor processes the requests.
+ *
+ * Each iteration ends with a roundtrip, the time it takes is the latency of
+ * the compositor for a batch of commits. Buffers still held by the compositor
+ * are not reused, these commits are counted as skipped.
+ */
+
+#define BUFFERS_PER_SURFACE 2
+
+struct spam_surface {
+	struct loadgen_window window;
+	struct loadgen_buffer buffers[BUFFERS_PER_SURFACE];
+};
+
+static const char usage[] =
+	"usage: %s [options]\n"
+	"  -n <n>  number of surfaces (default: 256)\n"
+	"  -s <n>  surface size in pixels (default: 16)\n"
+	"  -i <n>  number of iterations (default: 1000)\n";
+
+int main(int argc, char *argv[]) {
+	int surfaces_len = 256;
+	int size = 16;
+	int iterations = 1000;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:s:i:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			surfaces_len = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		default:
+			printf(usage, argv[0]);
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (surfaces_len <= 0 || size <= 0 || iterations <= 0) {
+		printf(usage, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	struct loadgen_globals globals;
+	if (!loadgen_connect(&globals)) {
+		return EXIT_FAILURE;
+	}
+
+	struct spam_surface *surfaces = calloc(surfaces_len, sizeof(*surfaces));
+	if (surfaces == NULL) {
+		return EXIT_FAILURE;
+	}
+	for (int i = 0; i < surfaces_len; i++) {
+		struct spam_surface *surface = &surfaces[i];
+		if (!loadgen_window_init(&surface->window, &globals, "shm-spam")) {
+			return EXIT_FAILURE;
+		}
+		for (int j = 0; j < BUFFERS_PER_SURFACE; j++) {
+			uint32_t color = 0xFF000000 | ((uint32_t)i * 0x10203 + (uint32_t)j * 0x808080);
+			if (!loadgen_buffer_init_shm(&surface->buffers[j], &globals,
+					size, size, color)) {
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	struct loadgen_samples roundtrips = {0};
+	size_t commits = 0, skipped = 0;
+
+	int64_t start = loadgen_now_ns();
+	for (int i = 0; i < iterations; i++) {
+		int64_t iteration_start = loadgen_now_ns();
+		for (int j = 0; j < surfaces_len; j++) {
+			struct spam_surface *surface = &surfaces[j];
+			struct loadgen_buffer *buffer = &surface->buffers[i % BUFFERS_PER_SURFACE];
+			if (buffer->busy) {
+				skipped++;
+				continue;
+			}
+
+			buffer->busy = true;
+			wl_surface_attach(surface->window.surface, buffer->wl_buffer, 0, 0);
+			wl_surface_damage_buffer(surface->window.surface, 0, 0, size, size);
+			wl_surface_commit(surface->window.surface);
+			commits++;
+		}
+
+		if (wl_display_roundtrip(globals.display) < 0) {
+			fprintf(stderr, "Lost connection to the compositor\n");
+			return EXIT_FAILURE;
+		}
+		loadgen_samples_add(&roundtrips, loadgen_now_ns() - iteration_start);
+	}
+	int64_t elapsed = loadgen_now_ns() - start;
+
+	printf("surfaces=%d size=%d iterations=%d\n", surfaces_len, size, iterations);
+	printf("commits=%zu\n", commits);
+	printf("skipped_commits=%zu\n", skipped);
+	printf("commits_per_sec=%.2f\n", (double)commits * 1000000000 / elapsed);
+	loadgen_samples_print(&roundtrips, "roundtrip");
+
+	loadgen_samples_finish(&roundtrips);
+	for (int i = 0; i < surfaces_len; i++) {
+		for (int j = 0; j < BUFFERS_PER_SURFACE; j++) {
+			loadgen_buffer_finish(&surfaces[i].buffers[j]);
+		}
+		loadgen_window_finish(&surfaces[i].window);
+	}
+	free(surfaces);
+	loadgen_disconnect(&globals);
+	return EXIT_SUCCESS;
+}
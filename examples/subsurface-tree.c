@@ -0,0 +1,189 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wayland-client.h>
+#include "loadgen.h"
+
+/**
+ * Builds a deep chain of subsurfaces below a toplevel, each one the child of
+ * the previous one, and commits new buffers on all of them on every frame
+ * callback of the toplevel.
+ *
+ * With synchronized subsurfaces (the default), the state of the whole chain is
+ * applied by the commit of the toplevel. The reported latency is the time
+ * between that commit and the next frame callback.
+ */
+
+#define BUFFERS_LEN 2
+
+struct tree_node {
+	struct wl_surface *surface;
+	struct wl_subsurface *subsurface;
+	struct loadgen_buffer buffers[BUFFERS_LEN];
+};
+
+struct tree_state {
+	struct loadgen_globals globals;
+	struct loadgen_window window;
+	struct tree_node *nodes; // nodes[0] is the toplevel
+	int depth, size;
+
+	bool frame_pending;
+	int64_t commit_ns;
+	size_t frames, skipped;
+	struct loadgen_samples latencies;
+};
+
+static void frame_handle_done(void *data, struct wl_callback *callback,
+		uint32_t time) {
+	struct tree_state *state = data;
+	wl_callback_destroy(callback);
+	state->frame_pending = false;
+	loadgen_samples_add(&state->latencies, loadgen_now_ns() - state->commit_ns);
+}
+
+static const struct wl_callback_listener frame_listener = {
+	.done = frame_handle_done,
+};
+
+static void node_attach(struct tree_state *state, struct tree_node *node) {
+	struct loadgen_buffer *buffer = &node->buffers[state->frames % BUFFERS_LEN];
+	if (buffer->busy) {
+		state->skipped++;
+		return;
+	}
+	buffer->busy = true;
+	wl_surface_attach(node->surface, buffer->wl_buffer, 0, 0);
+	wl_surface_damage_buffer(node->surface, 0, 0, state->size, state->size);
+}
+
+static void commit_frame(struct tree_state *state) {
+	// Children first, so that the commit of the toplevel applies the whole
+	// chain when subsurfaces are synchronized
+	for (int i = state->depth; i >= 0; i--) {
+		struct tree_node *node = &state->nodes[i];
+		node_attach(state, node);
+		if (i == 0) {
+			struct wl_callback *callback = wl_surface_frame(node->surface);
+			wl_callback_add_listener(callback, &frame_listener, state);
+			state->frame_pending = true;
+			state->commit_ns = loadgen_now_ns();
+		}
+		wl_surface_commit(node->surface);
+	}
+	state->frames++;
+}
+
+static const char usage[] =
+	"usage: %s [options]\n"
+	"  -d <n>  number of nested subsurfaces (default: 64)\n"
+	"  -s <n>  surface size in pixels (default: 64)\n"
+	"  -f <n>  number of frames (default: 1000)\n"
+	"  -D      use desynchronized subsurfaces\n";
+
+int main(int argc, char *argv[]) {
+	struct tree_state state = {
+		.depth = 64,
+		.size = 64,
+	};
+	size_t frames = 1000;
+	bool desync = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "d:s:f:Dh")) != -1) {
+		switch (opt) {
+		case 'd':
+			state.depth = atoi(optarg);
+			break;
+		case 's':
+			state.size = atoi(optarg);
+			break;
+		case 'f':
+			frames = strtoul(optarg, NULL, 10);
+			break;
+		case 'D':
+			desync = true;
+			break;
+		default:
+			printf(usage, argv[0]);
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (state.depth < 0 || state.size <= 0 || frames == 0) {
+		printf(usage, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (!loadgen_connect(&state.globals)) {
+		return EXIT_FAILURE;
+	}
+	if (state.globals.subcompositor == NULL) {
+		fprintf(stderr, "wl_subcompositor not supported\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!loadgen_window_init(&state.window, &state.globals, "subsurface-tree")) {
+		return EXIT_FAILURE;
+	}
+
+	state.nodes = calloc(state.depth + 1, sizeof(*state.nodes));
+	if (state.nodes == NULL) {
+		return EXIT_FAILURE;
+	}
+	state.nodes[0].surface = state.window.surface;
+	for (int i = 1; i <= state.depth; i++) {
+		struct tree_node *node = &state.nodes[i];
+		node->surface = wl_compositor_create_surface(state.globals.compositor);
+		node->subsurface = wl_subcompositor_get_subsurface(
+			state.globals.subcompositor, node->surface, state.nodes[i - 1].surface);
+		// Each level overlaps most of its parent
+		wl_subsurface_set_position(node->subsurface, 1, 1);
+		if (desync) {
+			wl_subsurface_set_desync(node->subsurface);
+		}
+	}
+	for (int i = 0; i <= state.depth; i++) {
+		for (int j = 0; j < BUFFERS_LEN; j++) {
+			uint32_t color = 0xFF000000 | (uint32_t)(i * 0x040404 + j * 0x7F0000);
+			if (!loadgen_buffer_init_shm(&state.nodes[i].buffers[j],
+					&state.globals, state.size, state.size, color)) {
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	int64_t start = loadgen_now_ns();
+	commit_frame(&state);
+	while (state.latencies.len < frames) {
+		if (wl_display_dispatch(state.globals.display) < 0) {
+			fprintf(stderr, "Lost connection to the compositor\n");
+			return EXIT_FAILURE;
+		}
+		if (!state.frame_pending && state.frames < frames) {
+			commit_frame(&state);
+		}
+	}
+	int64_t elapsed = loadgen_now_ns() - start;
+
+	printf("depth=%d size=%d frames=%zu desync=%d\n", state.depth, state.size,
+		frames, desync);
+	printf("skipped_attaches=%zu\n", state.skipped);
+	printf("frames_per_sec=%.2f\n", (double)state.frames * 1000000000 / elapsed);
+	loadgen_samples_print(&state.latencies, "frame_latency");
+
+	loadgen_samples_finish(&state.latencies);
+	for (int i = state.depth; i >= 0; i--) {
+		struct tree_node *node = &state.nodes[i];
+		for (int j = 0; j < BUFFERS_LEN; j++) {
+			loadgen_buffer_finish(&node->buffers[j]);
+		}
+		if (i > 0) {
+			wl_subsurface_destroy(node->subsurface);
+			wl_surface_destroy(node->surface);
+		}
+	}
+	free(state.nodes);
+	loadgen_window_finish(&state.window);
+	loadgen_disconnect(&state.globals);
+	return EXIT_SUCCESS;
+}
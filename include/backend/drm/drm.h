@@ -11,6 +11,7 @@
 #include <wlr/render/drm_format_set.h>
 #include <wlr/types/wlr_output_layer.h>
 #include <xf86drmMode.h>
+#include "backend/drm/fb.h"
 #include "backend/drm/iface.h"
 #include "backend/drm/properties.h"
 #include "backend/drm/renderer.h"
@@ -26,6 +27,9 @@ struct wlr_drm_plane {
 
 	/* Only initialized on multi-GPU setups */
 	struct wlr_drm_surface mgpu_surf;
+	/* Format of the linear buffers from the primary GPU which failed to be
+	 * scanned out, DRM_FORMAT_INVALID if none. Reset on modeset. */
+	uint32_t mgpu_import_failed_format;
 
 	/* Buffer submitted to the kernel, will be presented on next vblank */
 	struct wlr_drm_fb *queued_fb;
@@ -78,12 +82,83 @@ struct wlr_drm_crtc {
 	// Legacy only
 	int legacy_gamma_size;
 
+	// libliftoff only: overlay planes are shared by all CRTCs, these track
+	// how much each CRTC would benefit from them to move planes around
+	struct {
+		// Moving averages of the layer area per frame, in pixels
+		uint64_t offloaded_area, composited_area;
+		// Consecutive frames during which another CRTC held planes we'd
+		// benefit more from
+		uint32_t starved_frames;
+		// Frames left during which layers are composited to release planes
+		uint32_t yield_frames;
+	} overlay;
+
 	struct wlr_drm_plane *primary;
 	struct wlr_drm_plane *cursor;
 
+	// Writeback connector routed to this CRTC, atomic only. It stays attached
+	// until the CRTC is disabled, since attaching it requires a modeset.
+	struct wlr_drm_writeback_connector *writeback;
+
 	struct wlr_drm_crtc_props props;
 };
 
+struct wlr_drm_writeback_connector {
+	uint32_t id;
+	uint32_t possible_crtcs;
+	struct wlr_drm_connector_props props;
+
+	uint32_t *formats;
+	size_t formats_len;
+
+	struct wlr_drm_crtc *crtc; // NULL if not attached
+	struct wl_list link; // wlr_drm_backend.writeback_connectors
+};
+
+#define DRM_BLOB_CACHE_SIZE 16
+
+struct wlr_drm_blob {
+	uint32_t id;
+	void *data;
+	size_t size;
+	int refs;
+	struct wl_list link; // wlr_drm_blob_cache.blobs
+};
+
+/**
+ * Property blobs created by the backend, looked up by contents so that
+ * identical modes, gamma LUTs and damage clips are shared instead of being
+ * re-created on each commit.
+ *
+ * Blobs aren't destroyed as soon as they are released: up to
+ * DRM_BLOB_CACHE_SIZE unused blobs are kept, the least recently used ones
+ * being destroyed first.
+ */
+struct wlr_drm_blob_cache {
+	struct wl_list blobs; // wlr_drm_blob.link, most recently used first
+	size_t unused_len;
+
+	size_t hits, misses;
+};
+
+#define DRM_TEST_CACHE_SIZE 32
+
+/**
+ * Hashes of device states recently rejected by a test-only commit, so that
+ * compositors trying the same configuration every frame (e.g. direct scan-out
+ * of a buffer KMS can't display) don't pay for an atomic test every time.
+ *
+ * Results depend on the state of the other CRTCs and connectors, so the cache
+ * is cleared when these are reconfigured.
+ */
+struct wlr_drm_test_cache {
+	uint64_t failed[DRM_TEST_CACHE_SIZE];
+	size_t len, next;
+
+	size_t hits;
+};
+
 struct wlr_drm_backend {
 	struct wlr_backend backend;
 
@@ -103,6 +178,8 @@ struct wlr_drm_backend {
 	struct wlr_drm_plane *planes;
 
 	struct wl_event_source *drm_event;
+	// Whether all connectors have been scanned once
+	bool connectors_scanned;
 
 	struct wl_listener session_destroy;
 	struct wl_listener session_active;
@@ -111,7 +188,11 @@ struct wlr_drm_backend {
 	struct wl_listener dev_remove;
 
 	struct wl_list fbs; // wlr_drm_fb.link
+	struct wlr_drm_fb_cache fb_cache;
+	struct wlr_drm_test_cache test_cache;
+	struct wlr_drm_blob_cache blob_cache;
 	struct wl_list connectors; // wlr_drm_connector.link
+	struct wl_list writeback_connectors; // wlr_drm_writeback_connector.link
 
 	struct wl_list page_flips; // wlr_drm_page_flip.link
 
@@ -125,6 +206,8 @@ struct wlr_drm_backend {
 	struct wlr_drm_format_set mgpu_formats;
 
 	bool supports_tearing_page_flips;
+	// Whether to perform low framerate compensation for VRR outputs
+	bool vrr_lfc;
 };
 
 struct wlr_drm_mode {
@@ -135,6 +218,9 @@ struct wlr_drm_mode {
 struct wlr_drm_device_state {
 	bool modeset;
 	bool nonblock;
+	// Disable the KMS objects which aren't part of this commit, e.g. left
+	// enabled by another DRM master. Only supported by the atomic interface.
+	bool reset;
 
 	struct wlr_drm_connector_state *connectors;
 	size_t connectors_len;
@@ -147,6 +233,8 @@ struct wlr_drm_connector_state {
 	drmModeModeInfo mode;
 	struct wlr_drm_fb *primary_fb;
 	struct wlr_drm_viewport primary_viewport;
+	// Whether primary_fb is a buffer imported from the primary GPU as-is
+	bool primary_mgpu_import;
 	struct wlr_drm_fb *cursor_fb;
 
 	struct wlr_drm_syncobj_timeline *wait_timeline;
@@ -158,6 +246,11 @@ struct wlr_drm_connector_state {
 	uint32_t fb_damage_clips;
 	int primary_in_fence_fd, out_fence_fd;
 	bool vrr_enabled;
+
+	// Writeback job submitted along with this state, atomic only
+	struct wlr_drm_writeback *writeback; // may be NULL
+	struct wlr_drm_writeback_connector *writeback_conn;
+	int writeback_out_fence_fd;
 };
 
 /**
@@ -197,6 +290,9 @@ struct wlr_drm_connector {
 
 	struct wlr_drm_crtc *crtc;
 	uint32_t possible_crtcs;
+	// The current mode was set by the previous DRM master and nothing has
+	// been committed since: the first modeset can be skipped if it keeps it
+	bool inherited_mode;
 
 	struct wlr_drm_connector_props props;
 
@@ -204,25 +300,60 @@ struct wlr_drm_connector {
 	int cursor_x, cursor_y;
 	int cursor_width, cursor_height;
 	int cursor_hotspot_x, cursor_hotspot_y;
+	/* Whether the cursor plane has been enabled by the last commit */
+	bool cursor_plane_visible;
 	/* Buffer to be submitted to the kernel on the next page-flip */
 	struct wlr_drm_fb *cursor_pending_fb;
 
 	struct wl_list link; // wlr_drm_backend.connectors
 
+	struct wl_list writebacks; // wlr_drm_writeback.link
+
 	// Last committed page-flip
 	struct wlr_drm_page_flip *pending_page_flip;
 
 	int32_t refresh;
+
+	// Raw EDID, to notice when the display is replaced. NULL if unavailable.
+	uint8_t *edid;
+	size_t edid_len;
+
+	// Vertical refresh rate range in mHz from the EDID, zero if unknown
+	int32_t vrr_min_refresh, vrr_max_refresh;
+	// Repeats the current frame when adaptive sync is enabled and no new
+	// frame has been committed before the minimum refresh rate is reached,
+	// NULL if low framerate compensation is disabled
+	struct wl_event_source *lfc_timer;
+
+	// Latest tearing frame committed while a page-flip was pending, submitted
+	// as soon as the page-flip completes. Newer frames replace older ones.
+	struct {
+		bool pending;
+		struct wlr_output_state state;
+		uint32_t commit_seq; // of the frame in the mailbox
+		uint32_t flip_commit_seq; // of the frame being page-flipped
+
+		size_t flipped, replaced;
+	} mailbox;
 };
 
 struct wlr_drm_backend *get_drm_backend_from_backend(
 	struct wlr_backend *wlr_backend);
+/**
+ * Create a DRM backend for each device, the first one which succeeds being
+ * the primary device. KMS resources of all devices are queried in parallel.
+ * Backends which couldn't be created are set to NULL. Returns the primary
+ * backend, or NULL if none could be created.
+ */
+struct wlr_backend *create_drm_backends(struct wlr_session *session,
+	struct wlr_device **devs, size_t devs_len, struct wlr_backend **backends);
 bool check_drm_features(struct wlr_drm_backend *drm);
 bool init_drm_resources(struct wlr_drm_backend *drm);
 void finish_drm_resources(struct wlr_drm_backend *drm);
 void scan_drm_connectors(struct wlr_drm_backend *state,
 	struct wlr_device_hotplug_event *event);
 void scan_drm_leases(struct wlr_drm_backend *drm);
+void restore_drm_device(struct wlr_drm_backend *drm);
 bool commit_drm_device(struct wlr_drm_backend *drm,
 	const struct wlr_backend_output_state *states, size_t states_len, bool test_only);
 int handle_drm_event(int fd, uint32_t mask, void *data);
@@ -233,9 +364,46 @@ size_t drm_crtc_get_gamma_lut_size(struct wlr_drm_backend *drm,
 void drm_lease_destroy(struct wlr_drm_lease *lease);
 void drm_page_flip_destroy(struct wlr_drm_page_flip *page_flip);
 
+void init_drm_writeback_connectors(struct wlr_drm_backend *drm);
+void finish_drm_writeback_connectors(struct wlr_drm_backend *drm);
+bool drm_is_writeback_connector(struct wlr_drm_backend *drm, uint32_t id);
+/**
+ * Pick the oldest pending writeback job of the connector and a writeback
+ * connector for it. Returns false if there is nothing to submit. needs_modeset
+ * is set if the writeback connector has to be attached to the CRTC.
+ */
+bool drm_connector_prepare_writeback(struct wlr_drm_connector_state *state,
+	bool *needs_modeset);
+/**
+ * Submit or fail the writeback job picked for the state, once the commit is
+ * done.
+ */
+void drm_connector_finish_writeback(struct wlr_drm_connector_state *state,
+	bool committed);
+void drm_connector_fail_writebacks(struct wlr_drm_connector *conn);
+
 struct wlr_drm_layer *get_drm_layer(struct wlr_drm_backend *drm,
 	struct wlr_output_layer *layer);
 
+/**
+ * Compute the test cache key of a device state. Returns false if the state
+ * can't be cached.
+ */
+bool drm_test_cache_get_key(const struct wlr_drm_device_state *state,
+	uint32_t flags, uint64_t *key);
+bool drm_test_cache_has_failed(struct wlr_drm_test_cache *cache, uint64_t key);
+void drm_test_cache_add_failure(struct wlr_drm_test_cache *cache, uint64_t key);
+void drm_test_cache_clear(struct wlr_drm_test_cache *cache);
+
+/**
+ * Get a reference to a property blob with the specified contents, creating it
+ * if necessary.
+ */
+bool drm_blob_cache_acquire(struct wlr_drm_backend *drm, const void *data,
+	size_t size, uint32_t *blob_id);
+void drm_blob_cache_release(struct wlr_drm_backend *drm, uint32_t blob_id);
+void drm_blob_cache_finish(struct wlr_drm_backend *drm);
+
 #if __STDC_VERSION__ >= 202311L
 
 #define wlr_drm_conn_log(conn, verb, fmt, ...) \
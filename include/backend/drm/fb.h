@@ -2,14 +2,56 @@
 #define BACKEND_DRM_FB_H
 
 #include <stdbool.h>
+#include <sys/types.h>
+#include <wlr/render/dmabuf.h>
+#include <wlr/util/addon.h>
+
+/**
+ * Maximum number of FBs kept after their buffer has been destroyed. Cached FBs
+ * keep the client's memory alive, so keep this small.
+ */
+#define DRM_FB_CACHE_SIZE 8
+
+/**
+ * Identity of the DMA-BUF an FB has been imported from. DMA-BUF inode numbers
+ * are never re-used, so this identifies the same memory even after the
+ * client has re-created its wl_buffer.
+ */
+struct wlr_drm_fb_key {
+	uint32_t format;
+	uint64_t modifier;
+	int32_t width, height;
+	int n_planes;
+	struct {
+		dev_t dev;
+		ino_t ino;
+		uint32_t offset, stride;
+	} planes[WLR_DMABUF_MAX_PLANES];
+};
 
 struct wlr_drm_fb {
-	struct wlr_buffer *wlr_buf;
+	struct wlr_buffer *wlr_buf; // NULL if cached
 	struct wlr_addon addon;
 	struct wlr_drm_backend *backend;
 	struct wl_list link; // wlr_drm_backend.fbs
 
 	uint32_t id;
+
+	bool has_key;
+	struct wlr_drm_fb_key key;
+	struct wl_list cache_link; // wlr_drm_fb_cache.fbs, if cached
+};
+
+/**
+ * FBs whose buffer has been destroyed, re-used when a buffer for the same
+ * DMA-BUF is imported again. Video players and some games re-create their
+ * wl_buffers for the same set of DMA-BUFs, this saves the FB creation ioctls.
+ */
+struct wlr_drm_fb_cache {
+	struct wl_list fbs; // wlr_drm_fb.cache_link, most recently used first
+	size_t len;
+
+	size_t hits, misses, evictions;
 };
 
 bool drm_fb_import(struct wlr_drm_fb **fb, struct wlr_drm_backend *drm,
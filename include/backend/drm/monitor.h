@@ -11,6 +11,9 @@ struct wlr_drm_backend_monitor {
 	struct wlr_backend *primary_drm;
 	struct wlr_session *session;
 
+	// Hotplugged devices whose connectors are being probed
+	struct wl_list probes; // drm_device_probe.link
+
 	struct wl_listener multi_destroy;
 	struct wl_listener primary_drm_destroy;
 	struct wl_listener session_destroy;
@@ -26,6 +26,12 @@ struct wlr_drm_connector_props {
 	// atomic-modesetting only
 
 	uint32_t crtc_id;
+
+	// writeback connectors only
+
+	uint32_t writeback_fb_id;
+	uint32_t writeback_out_fence_ptr;
+	uint32_t writeback_pixel_formats;
 };
 
 struct wlr_drm_crtc_props {
@@ -4,7 +4,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <wlr/backend.h>
+#include <pixman.h>
 #include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_damage_ring.h>
 #include <wlr/util/addon.h>
 
 struct wlr_drm_backend;
@@ -23,6 +25,13 @@ struct wlr_drm_surface {
 
 	struct wlr_drm_syncobj_timeline *timeline;
 	uint64_t point;
+
+	// Tracks the contents of the swapchain buffers, so that only the damaged
+	// region needs to be copied
+	struct wlr_damage_ring damage_ring;
+	// Damage of the frames copied since the last successful commit: output
+	// damage is relative to the last committed frame, not the last copied one
+	pixman_region32_t uncommitted_damage;
 };
 
 bool init_drm_renderer(struct wlr_drm_backend *drm,
@@ -34,9 +43,23 @@ bool init_drm_surface(struct wlr_drm_surface *surf,
 	const struct wlr_drm_format *drm_format);
 void finish_drm_surface(struct wlr_drm_surface *surf);
 
+/**
+ * Copy a buffer into the surface's swapchain. The damage is relative to the
+ * last committed buffer, and may be NULL to copy the whole buffer.
+ */
 struct wlr_buffer *drm_surface_blit(struct wlr_drm_surface *surf,
-	struct wlr_buffer *buffer,
+	struct wlr_buffer *buffer, const pixman_region32_t *damage,
 	struct wlr_drm_syncobj_timeline *wait_timeline, uint64_t wait_point);
+/**
+ * Record the damage of a buffer which has been scanned out without being
+ * copied into the surface's swapchain.
+ */
+void drm_surface_add_damage(struct wlr_drm_surface *surf,
+	const pixman_region32_t *damage);
+/**
+ * Mark the buffers copied so far as committed.
+ */
+void drm_surface_mark_committed(struct wlr_drm_surface *surf);
 
 bool drm_plane_pick_render_format(struct wlr_drm_plane *plane,
 	struct wlr_drm_format *fmt, struct wlr_drm_renderer *renderer);
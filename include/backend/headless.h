@@ -21,7 +21,16 @@ struct wlr_headless_output {
 	struct wl_list link;
 
 	struct wl_event_source *frame_timer;
-	int frame_delay; // ms
+	struct wl_event_source *frame_idle; // used for sub-millisecond delays
+	int64_t frame_period; // nsec
+	struct timespec vblank_base; // time of virtual vblank zero
+	bool unthrottled;
+
+	// Last committed buffer and damage since the last retrieval, when frame
+	// export is enabled
+	bool export_frames;
+	struct wlr_buffer *frame;
+	pixman_region32_t frame_damage;
 };
 
 struct wlr_headless_backend *headless_backend_from_backend(
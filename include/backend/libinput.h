@@ -26,6 +26,9 @@ struct wlr_libinput_backend {
 	struct wl_listener session_signal;
 
 	struct wl_list devices; // wlr_libinput_device.link
+
+	// Relative motion read in the same batch, pointer is NULL if none
+	struct wlr_pointer_motion_event pending_motion;
 };
 
 struct wlr_libinput_input_device {
@@ -63,8 +66,9 @@ void handle_keyboard_key(struct libinput_event *event, struct wlr_keyboard *kb);
 
 void init_device_pointer(struct wlr_libinput_input_device *dev);
 struct wlr_libinput_input_device *device_from_pointer(struct wlr_pointer *kb);
-void handle_pointer_motion(struct libinput_event *event,
-	struct wlr_pointer *pointer);
+void handle_pointer_motion(struct wlr_libinput_backend *backend,
+	struct libinput_event *event, struct wlr_pointer *pointer);
+void flush_pointer_motion(struct wlr_libinput_backend *backend);
 void handle_pointer_motion_abs(struct libinput_event *event,
 	struct wlr_pointer *pointer);
 void handle_pointer_button(struct libinput_event *event,
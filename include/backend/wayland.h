@@ -39,6 +39,8 @@ struct wlr_wl_backend {
 	struct zxdg_decoration_manager_v1 *zxdg_decoration_manager_v1;
 	struct zwp_pointer_gestures_v1 *zwp_pointer_gestures_v1;
 	struct wp_presentation *presentation;
+	struct wp_fifo_manager_v1 *fifo_manager_v1;
+	struct wp_commit_timing_manager_v1 *commit_timing_manager_v1;
 	struct wl_shm *shm;
 	struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf_v1;
 	struct wp_linux_drm_syncobj_manager_v1 *drm_syncobj_manager_v1;
@@ -86,11 +88,18 @@ struct wlr_wl_presentation_feedback {
 
 struct wlr_wl_output_layer {
 	struct wlr_addon addon;
+	struct wlr_wl_output *output;
 
 	struct wl_surface *surface;
 	struct wl_subsurface *subsurface;
 	struct wp_viewport *viewport;
 	bool mapped;
+
+	// Last attached buffer, may have been destroyed: only compare against
+	// entries of wlr_wl_backend.buffers
+	struct wlr_wl_buffer *attached;
+	// Surface this layer was last placed above
+	struct wl_surface *placed_above;
 };
 
 struct wlr_wl_output {
@@ -107,6 +116,16 @@ struct wlr_wl_output {
 	struct zxdg_toplevel_decoration_v1 *zxdg_toplevel_decoration_v1;
 	struct wp_linux_drm_syncobj_surface_v1 *drm_syncobj_surface_v1;
 	struct wl_list presentation_feedbacks;
+	struct wp_fifo_v1 *fifo_v1;
+	struct wp_commit_timer_v1 *commit_timer_v1;
+
+	// Whether a frame event has been sent since the last commit, either
+	// from the frame callback or from the presentation feedback
+	bool frame_sent;
+	// Last presentation time and refresh period reported by the parent
+	// compositor, in nanoseconds. Zero if unknown.
+	int64_t last_present_ns;
+	int64_t refresh_ns;
 
 	char *title;
 	char *app_id;
@@ -126,6 +145,10 @@ struct wlr_wl_output {
 
 	uint32_t enter_serial;
 
+	// Set when a layer has been destroyed, the remaining ones need to be
+	// restacked
+	bool restack_layers;
+
 	struct {
 		struct wlr_wl_pointer *pointer;
 		struct wl_surface *surface;
@@ -45,6 +45,8 @@ struct wlr_x11_output {
 	struct wl_list buffers; // wlr_x11_buffer.link
 
 	pixman_region32_t exposed;
+	// Re-used for the update region of each presented pixmap
+	xcb_xfixes_region_t damage_region;
 
 	uint64_t last_msc;
 
@@ -118,6 +120,7 @@ struct wlr_x11_buffer {
 	struct wl_list link; // wlr_x11_output.buffers
 	struct wl_listener buffer_destroy;
 	size_t n_busy;
+	int64_t last_used_msec;
 };
 
 struct wlr_x11_format {
@@ -9,12 +9,28 @@
 struct wlr_gbm_buffer {
 	struct wlr_buffer base;
 
+	struct wlr_gbm_allocator *alloc; // NULL if the allocator has been destroyed
 	struct wl_list link; // wlr_gbm_allocator.buffers
 
 	struct gbm_bo *gbm_bo; // NULL if the gbm_device has been destroyed
 	struct wlr_dmabuf_attributes dmabuf;
 };
 
+// Upper bounds for the memory held by unused BOs
+#define GBM_POOL_MAX_LEN 8
+#define GBM_POOL_MAX_SIZE (128 * 1024 * 1024)
+
+/**
+ * A BO whose buffer has been destroyed, kept around to be handed out again
+ * for a buffer with the same size, format and modifier.
+ */
+struct wlr_gbm_pooled_bo {
+	struct gbm_bo *gbm_bo;
+	struct wlr_dmabuf_attributes dmabuf;
+	size_t size;
+	struct wl_list link; // wlr_gbm_allocator.pool
+};
+
 struct wlr_gbm_allocator {
 	struct wlr_allocator base;
 
@@ -22,6 +38,10 @@ struct wlr_gbm_allocator {
 	struct gbm_device *gbm_device;
 
 	struct wl_list buffers; // wlr_gbm_buffer.link
+
+	struct wl_list pool; // wlr_gbm_pooled_bo.link, most recently used first
+	size_t pool_len, pool_size;
+	size_t pool_hits, pool_misses;
 };
 
 /**
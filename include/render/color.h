@@ -1,6 +1,8 @@
 #ifndef RENDER_COLOR_H
 #define RENDER_COLOR_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <wlr/util/addon.h>
 
@@ -44,4 +46,44 @@ struct wlr_color_transform_lut3d {
 struct wlr_color_transform_lut3d *wlr_color_transform_lut3d_from_base(
 	struct wlr_color_transform *tr);
 
+/**
+ * Convert a color transform into per-channel gamma ramps applied to
+ * sRGB-encoded values, suitable for an output's gamma LUT. Fails if the
+ * transform mixes color channels, e.g. if the primaries of the target differ
+ * from sRGB ones.
+ */
+bool color_transform_get_gamma_lut(struct wlr_color_transform *tr,
+	size_t ramp_size, uint16_t *r, uint16_t *g, uint16_t *b);
+
+/**
+ * Create a 3D LUT color transform applying gamma ramps to sRGB-encoded
+ * values, the inverse of color_transform_get_gamma_lut(). Used to apply gamma
+ * LUTs in the renderer when the output can't.
+ */
+struct wlr_color_transform *color_transform_init_gamma_lut(size_t ramp_size,
+	const uint16_t *r, const uint16_t *g, const uint16_t *b);
+
+/**
+ * Evaluates a 3D LUT on the CPU for 8-bit sRGB-encoded pixels, using
+ * tetrahedral interpolation.
+ */
+struct wlr_color_lut3d_sampler {
+	const struct wlr_color_transform_lut3d *lut3d;
+
+	// Lattice cell and position within the cell of each 8-bit channel value,
+	// once decoded to linear light
+	uint32_t index[256];
+	float weight[256];
+};
+
+void color_lut3d_sampler_init(struct wlr_color_lut3d_sampler *sampler,
+	const struct wlr_color_transform_lut3d *lut3d);
+/**
+ * Transform 32-bit pixels in place. The shifts give the position of the 8-bit
+ * color channels in each pixel; the remaining bits are left untouched.
+ */
+void color_lut3d_sampler_apply(const struct wlr_color_lut3d_sampler *sampler,
+	uint32_t *pixels, size_t pixels_len,
+	int red_shift, int green_shift, int blue_shift);
+
 #endif
@@ -2,8 +2,11 @@
 #define RENDER_DMABUF_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+struct wlr_dmabuf_attributes;
+
 // Copied from <linux/dma-buf.h> to avoid #ifdef soup
 #define DMA_BUF_SYNC_READ      (1 << 0)
 #define DMA_BUF_SYNC_WRITE     (2 << 0)
@@ -32,4 +35,10 @@ bool dmabuf_import_sync_file(int dmabuf_fd, uint32_t flags, int sync_file_fd);
  */
 int dmabuf_export_sync_file(int dmabuf_fd, uint32_t flags);
 
+/**
+ * Get the size of the memory backing a DMA-BUF, in bytes. Planes sharing the
+ * same DMA-BUF are only counted once. Returns 0 on error.
+ */
+size_t dmabuf_get_size(const struct wlr_dmabuf_attributes *attribs);
+
 #endif
@@ -20,4 +20,10 @@ bool wlr_drm_format_intersect(struct wlr_drm_format *dst,
 
 bool wlr_drm_format_set_copy(struct wlr_drm_format_set *dst, const struct wlr_drm_format_set *src);
 
+/**
+ * Check whether a modifier enables framebuffer compression (e.g. ARM AFBC,
+ * Intel CCS or AMD DCC), which saves memory bandwidth.
+ */
+bool drm_modifier_is_compressed(uint64_t modifier);
+
 #endif
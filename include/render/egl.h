@@ -3,6 +3,13 @@
 
 #include <wlr/render/egl.h>
 
+struct wlr_egl_context {
+	EGLDisplay display;
+	EGLContext context;
+	EGLSurface draw_surface;
+	EGLSurface read_surface;
+};
+
 struct wlr_egl {
 	EGLDisplay display;
 	EGLContext context;
@@ -47,13 +54,12 @@ struct wlr_egl {
 	bool has_modifiers;
 	struct wlr_drm_format_set dmabuf_texture_formats;
 	struct wlr_drm_format_set dmabuf_render_formats;
-};
 
-struct wlr_egl_context {
-	EGLDisplay display;
-	EGLContext context;
-	EGLSurface draw_surface;
-	EGLSurface read_surface;
+	// See wlr_egl_begin_current()
+	struct {
+		int depth;
+		struct wlr_egl_context prev;
+	} current_scope;
 };
 
 /**
@@ -104,6 +110,9 @@ bool wlr_egl_restore_context(struct wlr_egl_context *context);
  *
  * The old EGL context is saved. Callers are expected to clear the current
  * context when they are done by calling wlr_egl_restore_context().
+ *
+ * Nothing is done if the context is already current, so that nested calls
+ * and operations inside wlr_egl_begin_current() are cheap.
  */
 bool wlr_egl_make_current(struct wlr_egl *egl, struct wlr_egl_context *save_context);
 
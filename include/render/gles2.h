@@ -6,7 +6,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
+#include <sys/types.h>
 #include <time.h>
+#include <wlr/render/dmabuf.h>
 #include <wlr/render/egl.h>
 #include <wlr/render/gles2.h>
 #include <wlr/render/interface.h>
@@ -22,6 +24,14 @@
 // https://gitlab.freedesktop.org/mesa/mesa/-/merge_requests/23144
 typedef void (GL_APIENTRYP PFNGLGETINTEGER64VEXTPROC) (GLenum pname, GLint64 *data);
 
+// Size of the ring buffer used to stream texture uploads
+#define GLES2_UPLOAD_BUFFER_SIZE (8 * 1024 * 1024)
+
+// GLES 3.0 buffer usage hint, missing from the GLES2 headers
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+
 struct wlr_gles2_pixel_format {
 	uint32_t drm_format;
 	// optional field, if empty then internalformat = format
@@ -32,10 +42,23 @@ struct wlr_gles2_pixel_format {
 struct wlr_gles2_tex_shader {
 	GLuint program;
 	GLint proj;
-	GLint tex_proj;
 	GLint tex;
 	GLint alpha;
 	GLint pos_attrib;
+	GLint texcoord_attrib;
+};
+
+struct wlr_gles2_blur_shader {
+	GLuint program;
+	GLint proj;
+	GLint tex;
+	GLint halfpixel;
+	GLint offset;
+	GLint tex_size; // upsampling only
+	GLint mask_box; // upsampling only
+	GLint mask_radius; // upsampling only
+	GLint pos_attrib;
+	GLint texcoord_attrib;
 };
 
 struct wlr_gles2_renderer {
@@ -56,6 +79,11 @@ struct wlr_gles2_renderer {
 		bool OES_texture_half_float_linear;
 		bool EXT_texture_norm16;
 		bool EXT_disjoint_timer_query;
+		bool OES_get_program_binary;
+		// GLES 3.0 pixel pack/unpack buffers and buffer mapping
+		bool pixel_unpack_buffer;
+		// Mipmaps for non-power-of-two textures (GLES 3.0 or GL_OES_texture_npot)
+		bool texture_npot_mipmap;
 	} exts;
 
 	struct {
@@ -72,6 +100,10 @@ struct wlr_gles2_renderer {
 		PFNGLGETQUERYOBJECTIVEXTPROC glGetQueryObjectivEXT;
 		PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64vEXT;
 		PFNGLGETINTEGER64VEXTPROC glGetInteger64vEXT;
+		PFNGLMAPBUFFERRANGEEXTPROC glMapBufferRange;
+		PFNGLUNMAPBUFFEROESPROC glUnmapBuffer;
+		PFNGLGETPROGRAMBINARYOESPROC glGetProgramBinaryOES;
+		PFNGLPROGRAMBINARYOESPROC glProgramBinaryOES;
 	} procs;
 
 	struct {
@@ -84,10 +116,49 @@ struct wlr_gles2_renderer {
 		struct wlr_gles2_tex_shader tex_rgba;
 		struct wlr_gles2_tex_shader tex_rgbx;
 		struct wlr_gles2_tex_shader tex_ext;
+		// Variants skipping the alpha multiplication, for draws with alpha 1
+		struct wlr_gles2_tex_shader tex_rgba_no_alpha;
+		struct wlr_gles2_tex_shader tex_rgbx_no_alpha;
+		struct wlr_gles2_tex_shader tex_ext_no_alpha;
+		// Effects, programs are 0 if they failed to build
+		struct wlr_gles2_blur_shader blur_down;
+		struct wlr_gles2_blur_shader blur_up;
+		struct {
+			GLuint program;
+			GLint proj;
+			GLint color;
+			GLint box;
+			GLint radius;
+			GLint sigma;
+			GLint pos_attrib;
+			GLint texcoord_attrib;
+		} shadow;
 	} shaders;
 
 	struct wl_list buffers; // wlr_gles2_buffer.link
 	struct wl_list textures; // wlr_gles2_texture.link
+	struct wl_list readbacks; // wlr_gles2_readback.link
+
+	// EGLImages of recently imported DMA-BUFs, most recently used first.
+	// Clients re-creating wl_buffers for the same DMA-BUF get the existing
+	// EGLImage instead of a new one.
+	struct {
+		struct wl_list images; // wlr_gles2_image.link
+		size_t unused_len;
+		uint64_t hits, misses;
+	} image_cache;
+
+	// Linked program binaries persisted in $XDG_CACHE_HOME/wlroots
+	struct {
+		bool enabled;
+		uint64_t driver_hash;
+	} program_cache;
+
+	// Pixel unpack buffer used as a ring to upload textures without stalling
+	struct {
+		GLuint pbo;
+		size_t offset;
+	} upload;
 };
 
 struct wlr_gles2_render_timer {
@@ -99,12 +170,37 @@ struct wlr_gles2_render_timer {
 	GLint64 gl_cpu_end;
 };
 
+// Identity of the DMA-BUF planes used to create an EGLImage
+struct wlr_gles2_image_key {
+	uint32_t format;
+	uint64_t modifier;
+	int32_t width, height;
+	int n_planes;
+	struct {
+		dev_t dev;
+		ino_t ino;
+		uint32_t offset;
+		uint32_t stride;
+	} planes[WLR_DMABUF_MAX_PLANES];
+};
+
+// An EGLImage shared by all buffers referring to the same DMA-BUF
+struct wlr_gles2_image {
+	struct wlr_gles2_image_key key;
+	bool cacheable;
+	EGLImageKHR image;
+	bool external_only;
+	size_t n_users; // number of wlr_gles2_buffer referencing this image
+	struct wl_list link; // wlr_gles2_renderer.image_cache.images
+};
+
 struct wlr_gles2_buffer {
 	struct wlr_buffer *buffer;
 	struct wlr_gles2_renderer *renderer;
 	struct wl_list link; // wlr_gles2_renderer.buffers
 	bool external_only;
 
+	struct wlr_gles2_image *cached_image;
 	EGLImageKHR image;
 	GLuint rbo;
 	GLuint fbo;
@@ -128,10 +224,44 @@ struct wlr_gles2_texture {
 
 	bool has_alpha;
 
+	// Mipmaps are generated lazily when the texture is drawn heavily
+	// downscaled, and invalidated when its contents change
+	bool mipmappable;
+	bool mipmaps_valid;
+	bool mipmaps_allocated;
+
 	uint32_t drm_format; // for mutable textures only, used to interpret upload data
 	struct wlr_gles2_buffer *buffer; // for DMA-BUF imports only
 };
 
+// Pixels read into a pixel pack buffer, ready once the fence is signalled
+struct wlr_gles2_readback {
+	struct wlr_texture_readback base;
+	struct wlr_gles2_renderer *renderer; // NULL once the renderer is destroyed
+	struct wl_list link; // wlr_gles2_renderer.readbacks
+
+	GLuint pbo;
+	uint32_t width, height;
+	uint32_t bytes_per_pixel;
+	uint32_t dst_x, dst_y;
+
+	int fence_fd;
+	struct wl_event_source *fence_source;
+};
+
+// Quads sharing the same draw state, submitted with a single draw call
+struct wlr_gles2_render_batch {
+	struct wlr_gles2_texture *texture; // NULL for solid color quads
+	const struct wlr_gles2_tex_shader *shader;
+	enum wlr_scale_filter_mode filter_mode;
+	bool mipmap;
+	enum wlr_render_blend_mode blend_mode;
+	float alpha;
+	struct wlr_render_color color;
+
+	struct wl_array vertices; // GLfloat x, y, u, v
+};
+
 struct wlr_gles2_render_pass {
 	struct wlr_render_pass base;
 	struct wlr_gles2_buffer *buffer;
@@ -140,6 +270,7 @@ struct wlr_gles2_render_pass {
 	struct wlr_gles2_render_timer *timer;
 	struct wlr_drm_syncobj_timeline *signal_timeline;
 	uint64_t signal_point;
+	struct wlr_gles2_render_batch batch;
 };
 
 bool is_gles2_pixel_format_supported(const struct wlr_gles2_renderer *renderer,
@@ -163,13 +294,29 @@ struct wlr_gles2_buffer *gles2_buffer_get_or_create(struct wlr_gles2_renderer *r
 
 struct wlr_texture *gles2_texture_from_buffer(struct wlr_renderer *wlr_renderer,
 	struct wlr_buffer *buffer);
+struct wlr_texture *gles2_texture_from_buffer_cropped(
+	struct wlr_renderer *wlr_renderer, struct wlr_buffer *buffer,
+	const struct wlr_box *box);
 void gles2_texture_destroy(struct wlr_gles2_texture *texture);
+// Generates the mipmaps of the texture if they are out of date. Returns false
+// if the texture cannot be mipmapped.
+bool gles2_texture_ensure_mipmaps(struct wlr_gles2_texture *texture);
+void gles2_readback_release(struct wlr_gles2_readback *readback);
 
 void push_gles2_debug_(struct wlr_gles2_renderer *renderer,
 	const char *file, const char *func);
 #define push_gles2_debug(renderer) push_gles2_debug_(renderer, _WLR_FILENAME, __func__)
 void pop_gles2_debug(struct wlr_gles2_renderer *renderer);
 
+// Enables the program binary cache if the driver supports it
+void gles2_program_cache_init(struct wlr_gles2_renderer *renderer);
+// Creates a program from a cached binary, returns 0 on cache miss
+GLuint gles2_program_cache_load(struct wlr_gles2_renderer *renderer,
+	const GLchar *vert_src, const GLchar *frag_src);
+// Saves the binary of a program linked from the given sources
+void gles2_program_cache_store(struct wlr_gles2_renderer *renderer, GLuint prog,
+	const GLchar *vert_src, const GLchar *frag_src);
+
 struct wlr_gles2_render_pass *begin_gles2_buffer_pass(struct wlr_gles2_buffer *buffer,
 	struct wlr_egl_context *prev_ctx, struct wlr_gles2_render_timer *timer,
 	struct wlr_drm_syncobj_timeline *signal_timeline, uint64_t signal_point);
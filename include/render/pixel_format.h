@@ -1,6 +1,9 @@
 #ifndef RENDER_PIXEL_FORMAT_H
 #define RENDER_PIXEL_FORMAT_H
 
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <wayland-server-protocol.h>
 
 /**
@@ -29,6 +32,36 @@ struct wlr_pixel_format_info {
 	uint32_t block_width, block_height;
 };
 
+#define PIXEL_FORMAT_INDEX_SIZE 256
+
+/**
+ * Hash table mapping DRM FourCCs to the entries of a static format table.
+ *
+ * Format tables are small and never change, so the table is sized to keep
+ * almost every lookup to a single probe. It is built on first use.
+ */
+struct pixel_format_index {
+	pthread_once_t once;
+	uint32_t keys[PIXEL_FORMAT_INDEX_SIZE];
+	// Index in the format table plus one, zero for empty slots
+	uint16_t values[PIXEL_FORMAT_INDEX_SIZE];
+};
+
+#define PIXEL_FORMAT_INDEX_INIT { .once = PTHREAD_ONCE_INIT }
+
+/**
+ * Fill an index for a table of len entries of the given stride, whose DRM
+ * FourCC is stored at key_offset in each entry.
+ */
+void pixel_format_index_build(struct pixel_format_index *index,
+	const void *table, size_t stride, size_t key_offset, size_t len);
+/**
+ * Look up a DRM FourCC in an index. Returns the position of its entry in the
+ * format table, or -1 if the format isn't in the table.
+ */
+ptrdiff_t pixel_format_index_find(const struct pixel_format_index *index,
+	uint32_t fmt);
+
 /**
  * Get pixel format information from a DRM FourCC.
  *
@@ -63,4 +96,16 @@ enum wl_shm_format convert_drm_format_to_wl_shm(uint32_t fmt);
  */
 bool pixel_format_has_alpha(uint32_t fmt);
 
+/**
+ * Copy pixels between two buffers, converting them from src_fmt to dst_fmt.
+ *
+ * Only conversions between the 32-bit RGB formats with 8 or 10 bits per
+ * channel are supported, e.g. XRGB8888 to ABGR8888 or XRGB2101010 to
+ * XBGR2101010. Returns false if the conversion isn't supported, in which case
+ * callers need to fall back to a generic path.
+ */
+bool pixel_format_copy(uint32_t dst_fmt, void *dst, uint32_t dst_stride,
+	uint32_t src_fmt, const void *src, uint32_t src_stride,
+	uint32_t width, uint32_t height);
+
 #endif
@@ -13,10 +13,14 @@ struct wlr_pixman_pixel_format {
 };
 
 struct wlr_pixman_buffer;
+struct thread_pool;
 
 struct wlr_pixman_renderer {
 	struct wlr_renderer wlr_renderer;
 
+	// NULL if composition only happens on the calling thread
+	struct thread_pool *thread_pool;
+
 	struct wl_list buffers; // wlr_pixman_buffer.link
 	struct wl_list textures; // wlr_pixman_texture.link
 
@@ -46,9 +50,40 @@ struct wlr_pixman_texture {
 	struct wlr_buffer *buffer; // if created via texture_from_buffer
 };
 
+// Composite operation recorded by a render pass, executed on submit
+struct wlr_pixman_render_op {
+	pixman_op_t op;
+	// Destination pixels written by the operation. Before execution, pixels
+	// covered by later opaque operations are removed.
+	pixman_region32_t region;
+	// Whether the result doesn't depend on the previous destination pixels
+	bool opaque;
+
+	// Source pixels: a texture buffer, locked until the pass is submitted, a
+	// texture image if the texture has no buffer, or else a solid color
+	struct wlr_buffer *src_buffer;
+	pixman_image_t *src_image;
+	struct pixman_color color;
+
+	bool has_transform;
+	struct pixman_transform transform;
+	pixman_filter_t filter;
+	float alpha;
+
+	// Arguments of pixman_image_composite32()
+	int src_x, src_y;
+	int dst_x, dst_y;
+	int width, height;
+};
+
 struct wlr_pixman_render_pass {
 	struct wlr_render_pass base;
 	struct wlr_pixman_buffer *buffer;
+	struct wl_array ops; // struct wlr_pixman_render_op
+
+	// Output color transform applied to the written pixels on submit, NULL
+	// if none
+	struct wlr_color_transform *color_transform;
 };
 
 pixman_format_code_t get_pixman_format_from_drm(uint32_t fmt);
@@ -59,6 +94,6 @@ bool begin_pixman_data_ptr_access(struct wlr_buffer *buffer, pixman_image_t **im
 	uint32_t flags);
 
 struct wlr_pixman_render_pass *begin_pixman_render_pass(
-	struct wlr_pixman_buffer *buffer);
+	struct wlr_pixman_buffer *buffer, struct wlr_color_transform *color_transform);
 
 #endif
@@ -0,0 +1,57 @@
+#ifndef RENDER_TEXTURE_ATLAS_H
+#define RENDER_TEXTURE_ATLAS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wlr/util/box.h>
+
+#define TEXTURE_ATLAS_PAGE_SIZE 1024
+#define TEXTURE_ATLAS_MAX_ENTRY_SIZE 256
+
+struct wlr_renderer;
+
+/**
+ * Packs small textures into shared ARGB8888 pages. Textures sharing a page
+ * can be drawn without re-binding it, and consecutive draws from the same
+ * page are merged by renderers batching draws.
+ *
+ * The atlas needs a renderer able to update textures from memory buffers.
+ */
+struct wlr_texture_atlas {
+	struct wlr_renderer *renderer;
+	struct wl_list pages; // wlr_texture_atlas_page.link
+
+	// Set when the renderer can't update pages, the atlas can't be used
+	bool broken;
+};
+
+struct wlr_texture_atlas_entry {
+	// Page containing the entry, NULL once the atlas has been destroyed
+	struct wlr_texture *texture;
+	// Area of the page covered by the entry
+	struct wlr_box box;
+
+	struct wlr_texture_atlas_page *page;
+	struct wl_list link; // wlr_texture_atlas_page.entries
+	int shelf_index;
+};
+
+struct wlr_texture_atlas *texture_atlas_create(struct wlr_renderer *renderer);
+/**
+ * Destroy the atlas. Entries are not destroyed, but their texture is reset to
+ * NULL: users still need to call texture_atlas_entry_destroy().
+ */
+void texture_atlas_destroy(struct wlr_texture_atlas *atlas);
+/**
+ * Upload pixels to the atlas. Only ARGB8888 and XRGB8888 are supported, larger
+ * than TEXTURE_ATLAS_MAX_ENTRY_SIZE images are rejected. Returns NULL if the
+ * pixels can't be stored in the atlas, in which case a regular texture should
+ * be used instead.
+ */
+struct wlr_texture_atlas_entry *texture_atlas_add(struct wlr_texture_atlas *atlas,
+	uint32_t format, uint32_t stride, uint32_t width, uint32_t height,
+	const void *data);
+void texture_atlas_entry_destroy(struct wlr_texture_atlas_entry *entry);
+
+#endif
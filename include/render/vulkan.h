@@ -1,8 +1,10 @@
 #ifndef RENDER_VULKAN_H
 #define RENDER_VULKAN_H
 
+#include <pthread.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <stdbool.h>
 #include <vulkan/vulkan.h>
 #include <wlr/render/wlr_renderer.h>
@@ -43,10 +45,23 @@ struct wlr_vk_device {
 	bool sync_file_import_export;
 	bool implicit_sync_interop;
 	bool sampler_ycbcr_conversion;
+	bool descriptor_indexing;
+	// Size of the bindless texture array, if descriptor_indexing is set
+	uint32_t max_bindless_textures;
 
 	// we only ever need one queue for rendering and transfer commands
 	uint32_t queue_family;
 	VkQueue queue;
+	// Zero if the queue doesn't support timestamp queries
+	uint32_t timestamp_valid_bits;
+	// Whether the queue supports compute shaders, needed for blurs
+	bool queue_compute;
+	float timestamp_period; // nanoseconds per timestamp tick
+
+	// Dedicated transfer queue used for uploads, VK_NULL_HANDLE if the
+	// device doesn't have one
+	uint32_t transfer_queue_family;
+	VkQueue transfer_queue;
 
 	struct {
 		PFN_vkGetMemoryFdPropertiesKHR vkGetMemoryFdPropertiesKHR;
@@ -88,17 +103,30 @@ struct wlr_vk_format {
 	bool is_ycbcr;
 };
 
-extern const VkImageUsageFlags vulkan_render_usage, vulkan_shm_tex_usage, vulkan_dma_tex_usage;
+extern const VkImageUsageFlags vulkan_render_usage, vulkan_render_sampled_usage,
+	vulkan_shm_tex_usage, vulkan_dma_tex_usage;
 
 // Returns all known format mappings.
 // Might not be supported for gpu/usecase.
 const struct wlr_vk_format *vulkan_get_format_list(size_t *len);
 const struct wlr_vk_format *vulkan_get_format_from_drm(uint32_t drm_format);
 
+// How the YCbCr conversion of a format and modifier pair can sample chroma
+struct wlr_vk_ycbcr_caps {
+	VkChromaLocation chroma_location;
+	bool linear_chroma_filter;
+	// Whether the chroma filter can differ from the sampler filter
+	bool separate_chroma_filter;
+};
+
 struct wlr_vk_format_modifier_props {
 	VkDrmFormatModifierPropertiesEXT props;
 	VkExtent2D max_extent;
 	bool has_mutable_srgb;
+	// Whether render buffers can also be sampled, to read back what has
+	// been rendered (for render formats only)
+	bool render_sampled;
+	struct wlr_vk_ycbcr_caps ycbcr; // for YCbCr formats only
 };
 
 struct wlr_vk_format_props {
@@ -127,9 +155,27 @@ void vulkan_format_props_finish(struct wlr_vk_format_props *props);
 
 struct wlr_vk_pipeline_layout_key {
 	const struct wlr_vk_format *ycbcr_format;
+	struct wlr_vk_ycbcr_caps ycbcr_caps; // if ycbcr_format is set
 	enum wlr_scale_filter_mode filter_mode;
 };
 
+// Bounds for the size of the bindless texture array. Devices supporting less
+// than the minimum use regular per-texture descriptor sets.
+#define VULKAN_MIN_BINDLESS_TEXTURES 1024
+#define VULKAN_MAX_BINDLESS_TEXTURES 16384
+
+// Descriptor set holding an array with the views of all textures drawn with a
+// pipeline layout. Textures select their slot with a push constant, so the
+// set only needs to be bound once per render pass.
+struct wlr_vk_bindless_set {
+	VkDescriptorPool pool;
+	VkDescriptorSet ds;
+	uint32_t capacity;
+	// Slots below next_index have been handed out at least once
+	uint32_t next_index;
+	struct wl_array free_indices; // uint32_t
+};
+
 struct wlr_vk_pipeline_layout {
 	struct wlr_vk_pipeline_layout_key key;
 
@@ -143,6 +189,10 @@ struct wlr_vk_pipeline_layout {
 		VkFormat format;
 	} ycbcr;
 
+	// NULL if descriptor indexing isn't used for this layout (not supported by
+	// the device, or YCbCr layout)
+	struct wlr_vk_bindless_set *bindless;
+
 	struct wl_list link; // struct wlr_vk_renderer.pipeline_layouts
 };
 
@@ -183,6 +233,13 @@ struct wlr_vk_pipeline {
 	struct wl_list link; // struct wlr_vk_render_format_setup
 };
 
+enum wlr_vk_effect_pipeline {
+	WLR_VK_EFFECT_PIPELINE_BLUR,
+	WLR_VK_EFFECT_PIPELINE_BLUR_MASKED, // with rounded corners, blended
+	WLR_VK_EFFECT_PIPELINE_SHADOW,
+	WLR_VK_EFFECT_PIPELINE_COUNT,
+};
+
 // For each format we want to render, we need a separate renderpass
 // and therefore also separate pipelines.
 struct wlr_vk_render_format_setup {
@@ -194,11 +251,88 @@ struct wlr_vk_render_format_setup {
 	VkPipeline output_pipe_srgb;
 	VkPipeline output_pipe_lut3d;
 
+	// Pipelines of the effects, created on first use
+	VkPipeline effect_pipes[WLR_VK_EFFECT_PIPELINE_COUNT];
+
 	struct wlr_vk_renderer *renderer;
 	struct wl_list pipelines; // struct wlr_vk_pipeline.link
 };
 
+// Render setup built on another thread ahead of its first use
+struct wlr_vk_render_setup_job {
+	struct wl_list link; // wlr_vk_renderer.render_setup_jobs
+	struct wlr_vk_render_format_setup *setup;
+	pthread_t thread;
+	bool ok; // written by the thread, read once joined
+};
+
 // Renderer-internal represenation of an wlr_buffer imported for rendering.
+// Intermediate 16F image used by the plain framebuffer of render buffers
+// for linear blending. Images of destroyed render buffers are kept around
+// to be reused by render buffers of the same size.
+struct wlr_vk_blend_image {
+	uint32_t width, height;
+	VkImage image;
+	VkImageView image_view;
+	VkDeviceMemory memory;
+	VkDescriptorSet descriptor_set;
+	struct wlr_vk_descriptor_pool *attachment_pool;
+	bool transitioned;
+
+	struct wl_list link; // wlr_vk_renderer.blend_images
+};
+
+#define VULKAN_BLEND_IMAGES_CAP 4
+
+#define VULKAN_BLUR_MAX_PASSES 8
+
+// Intermediate images of a blur. Mip level i holds the result of the
+// downsampling step i + 1, and is then overwritten by the upsampling steps.
+// Each image is used by a single blur of a command buffer, and is kept
+// around once it completes to be reused by blurs of the same size.
+struct wlr_vk_effect_image {
+	uint32_t width, height, levels;
+	VkImage image;
+	VkDeviceMemory memory;
+	VkImageView views[VULKAN_BLUR_MAX_PASSES]; // one per mip level
+	VkDescriptorPool ds_pool;
+	// Downsampling step i reads level i - 1 (the render target for the first
+	// step) and writes level i
+	VkDescriptorSet down_ds[VULKAN_BLUR_MAX_PASSES];
+	// Upsampling step i reads level i + 1 and writes level i
+	VkDescriptorSet up_ds[VULKAN_BLUR_MAX_PASSES - 1];
+	// Samples level 0, for the last upsampling step
+	VkDescriptorSet blur_ds;
+
+	struct wl_list link; // wlr_vk_effects.images, wlr_vk_command_buffer.effect_images
+};
+
+#define VULKAN_EFFECT_IMAGES_CAP 8
+
+// State shared by the blur and shadow effects of a renderer, created on
+// first use
+struct wlr_vk_effects {
+	bool ready, failed;
+	VkSampler sampler;
+
+	// Compute steps of the blur, reading a sampled image and writing a
+	// storage image
+	VkDescriptorSetLayout step_ds_layout;
+	VkPipelineLayout step_pipe_layout;
+	VkShaderModule blur_down_module, blur_up_module;
+	VkPipeline blur_down_pipe, blur_up_pipe;
+
+	// Last upsampling step of the blur and shadows, drawn in the render pass
+	VkDescriptorSetLayout blur_ds_layout;
+	VkPipelineLayout blur_pipe_layout;
+	VkShaderModule blur_frag_module;
+	VkPipelineLayout shadow_pipe_layout;
+	VkShaderModule shadow_frag_module;
+
+	// Unused images, most recently released first
+	struct wl_list images; // wlr_vk_effect_image.link
+};
+
 struct wlr_vk_render_buffer {
 	struct wlr_buffer *wlr_buffer;
 	struct wlr_addon addon;
@@ -208,6 +342,7 @@ struct wlr_vk_render_buffer {
 	VkDeviceMemory memories[WLR_DMABUF_MAX_PLANES];
 	uint32_t mem_count;
 	VkImage image;
+	bool sampled; // whether the image has been imported with sampled usage
 
 	// Framebuffer and image view for rendering directly onto the buffer image.
 	// This requires that the image support an _SRGB VkFormat, and does
@@ -229,12 +364,7 @@ struct wlr_vk_render_buffer {
 		VkFramebuffer framebuffer;
 		bool transitioned;
 
-		VkImage blend_image;
-		VkImageView blend_image_view;
-		VkDeviceMemory blend_memory;
-		VkDescriptorSet blend_descriptor_set;
-		struct wlr_vk_descriptor_pool *blend_attachment_pool;
-		bool blend_transitioned;
+		struct wlr_vk_blend_image *blend;
 	} plain;
 };
 
@@ -249,6 +379,8 @@ struct wlr_vk_command_buffer {
 	struct wl_list destroy_textures; // wlr_vk_texture.destroy_link
 	// Staging shared buffers to release after the command buffer completes
 	struct wl_list stage_buffers; // wlr_vk_shared_buffer.link
+	// Blur images to release after the command buffer completes
+	struct wl_list effect_images; // wlr_vk_effect_image.link
 	// Color transform to unref after the command buffer completes
 	struct wlr_color_transform *color_transform;
 
@@ -256,9 +388,17 @@ struct wlr_vk_command_buffer {
 	VkSemaphore binary_semaphore;
 
 	struct wl_array wait_semaphores; // VkSemaphore
+
+	struct wl_list link; // wlr_vk_renderer.command_buffers
+};
+
+struct wlr_vk_transfer_command_buffer {
+	VkCommandBuffer vk;
+	// Point of wlr_vk_renderer.transfer.timeline_semaphore
+	uint64_t timeline_point;
 };
 
-#define VULKAN_COMMAND_BUFFERS_CAP 64
+#define VULKAN_TRANSFER_COMMAND_BUFFERS_CAP 32
 
 // Vulkan wlr_renderer implementation on top of a wlr_vk_device.
 struct wlr_vk_renderer {
@@ -270,11 +410,19 @@ struct wlr_vk_renderer {
 
 	VkShaderModule vert_module;
 	VkShaderModule tex_frag_module;
+	VkShaderModule tex_bindless_frag_module; // if dev->descriptor_indexing
+	VkShaderModule tex_instanced_vert_module; // if dev->descriptor_indexing
 	VkShaderModule quad_frag_module;
 	VkShaderModule output_module;
 
 	struct wl_list pipeline_layouts; // struct wlr_vk_pipeline_layout.link
 
+	VkPipelineCache pipeline_cache;
+	char *pipeline_cache_path; // NULL if the cache isn't persisted
+	size_t pipeline_cache_saved_size;
+	// Create pipelines for all blend modes along with render setups
+	bool eager_pipelines;
+
 	// for blend->output subpass
 	VkPipelineLayout output_pipe_layout;
 	VkDescriptorSetLayout output_ds_srgb_layout;
@@ -299,23 +447,52 @@ struct wlr_vk_renderer {
 	size_t last_pool_size;
 	struct wl_list descriptor_pools; // wlr_vk_descriptor_pool.link
 	struct wl_list render_format_setups; // wlr_vk_render_format_setup.link
+	struct wl_list render_setup_jobs; // wlr_vk_render_setup_job.link
 
 
 	struct wl_list textures; // wlr_vk_texture.link
+	struct wl_list memory_pages; // wlr_vk_memory_page.link
 	// Textures to return to foreign queue
 	struct wl_list foreign_textures; // wlr_vk_texture.foreign_link
 
 	struct wl_list render_buffers; // wlr_vk_render_buffer.link
+	// Unused blending images, most recently released first
+	struct wl_list blend_images; // wlr_vk_blend_image.link
 
 	struct wl_list color_transforms; // wlr_vk_color_transform.link
 
-	// Pool of command buffers
-	struct wlr_vk_command_buffer command_buffers[VULKAN_COMMAND_BUFFERS_CAP];
+	struct wlr_vk_effects effects;
+
+	// Pool of command buffers, grown whenever all of them are busy. Textures
+	// keep pointers to the last command buffer which used them, so command
+	// buffers are only freed with the renderer.
+	struct wl_list command_buffers; // wlr_vk_command_buffer.link
+
+	// Uploads recorded for the dedicated transfer queue, if any. The stage
+	// cb waits for them and acquires the uploaded images.
+	struct {
+		VkCommandPool command_pool;
+		struct wlr_vk_transfer_command_buffer
+			command_buffers[VULKAN_TRANSFER_COMMAND_BUFFERS_CAP];
+		struct wlr_vk_transfer_command_buffer *cb; // recording, may be NULL
+		VkSemaphore timeline_semaphore;
+		uint64_t timeline_point;
+		// Point of renderer->timeline_semaphore the uploads must wait for
+		uint64_t wait_point;
+	} transfer;
 
 	struct {
 		struct wlr_vk_command_buffer *cb;
 		uint64_t last_timeline_point;
 		struct wl_list buffers; // wlr_vk_shared_buffer.link
+
+		// Persistently mapped ring buffer most staging spans are allocated
+		// from. Offsets grow monotonically and wrap around the buffer size.
+		struct {
+			struct wlr_vk_shared_buffer *buffer;
+			VkDeviceSize head, tail;
+			struct wl_array regions; // struct wlr_vk_stage_ring_region
+		} ring;
 	} stage;
 
 	struct {
@@ -339,13 +516,49 @@ struct wlr_vk_frag_output_pcr_data {
 	float lut_3d_scale;
 };
 
+// Push constants of the blur compute steps
+struct wlr_vk_blur_step_pcr_data {
+	float uv_off[2];
+	float uv_size[2];
+	float offset;
+};
+
+struct wlr_vk_frag_blur_pcr_data {
+	float mask_box[4];
+	float halfpixel[2];
+	float tex_size[2];
+	float offset;
+	float mask_radius;
+};
+
+struct wlr_vk_frag_shadow_pcr_data {
+	float color[4];
+	float box[4];
+	float radius;
+	float sigma;
+};
+
+// Per-instance vertex attributes of batched texture draws. Must match those
+// in shaders/texture_instanced.vert
+struct wlr_vk_texture_instance {
+	float proj[2][3]; // first two rows of the unit square to NDC matrix
+	// part of the unit square to draw, in place of a scissor
+	float pos_off[2];
+	float pos_size[2];
+	float uv_off[2];
+	float uv_size[2];
+	float alpha;
+	uint32_t tex_index; // slot in the pipeline layout's bindless set
+};
+
 struct wlr_vk_texture_view {
 	struct wl_list link; // struct wlr_vk_texture.views
 	const struct wlr_vk_pipeline_layout *layout;
 
 	VkDescriptorSet ds;
 	VkImageView image_view;
-	struct wlr_vk_descriptor_pool *ds_pool;
+	struct wlr_vk_descriptor_pool *ds_pool; // NULL for bindless views
+	uint32_t bindless_index; // slot in layout->bindless
 };
 
 struct wlr_vk_pipeline *setup_get_or_create_pipeline(
@@ -358,6 +571,12 @@ struct wlr_vk_texture_view *vulkan_texture_get_or_create_view(
 	struct wlr_vk_texture *texture,
 	const struct wlr_vk_pipeline_layout *layout);
 
+// Creates the pipeline cache, loading it from the XDG cache directory
+bool vulkan_pipeline_cache_init(struct wlr_vk_renderer *renderer);
+// Writes the pipeline cache to disk if it has grown since it was last saved
+void vulkan_pipeline_cache_save(struct wlr_vk_renderer *renderer);
+void vulkan_pipeline_cache_finish(struct wlr_vk_renderer *renderer);
+
 // Creates a vulkan renderer for the given device.
 struct wlr_renderer *vulkan_renderer_create_for_device(struct wlr_vk_device *dev);
 
@@ -370,6 +589,17 @@ VkCommandBuffer vulkan_record_stage_cb(struct wlr_vk_renderer *renderer);
 // finished execution.
 bool vulkan_submit_stage_wait(struct wlr_vk_renderer *renderer);
 
+// Gets a command buffer in recording state for the dedicated transfer queue,
+// or VK_NULL_HANDLE if there is none. It is submitted along with the stage
+// command buffer, which must acquire the images released by it.
+VkCommandBuffer vulkan_record_transfer_cb(struct wlr_vk_renderer *renderer);
+
+// Submits the current transfer command buffer, if any. The stage command
+// buffer must wait for the returned point of the transfer timeline semaphore,
+// or 0 if there was nothing to submit.
+bool vulkan_submit_transfer_cb(struct wlr_vk_renderer *renderer,
+	uint64_t *timeline_point);
+
 struct wlr_vk_render_pass_texture {
 	struct wlr_vk_texture *texture;
 
@@ -377,13 +607,33 @@ struct wlr_vk_render_pass_texture {
 	uint64_t wait_point;
 };
 
+struct wlr_vk_render_timer {
+	struct wlr_render_timer base;
+	struct wlr_vk_renderer *renderer;
+	struct timespec cpu_start;
+	struct timespec cpu_end;
+	// Timestamps written at the start and the end of the render command buffer
+	VkQueryPool query_pool;
+	bool submitted;
+};
+
+struct wlr_vk_render_timer *vulkan_get_render_timer(struct wlr_render_timer *timer);
+
 struct wlr_vk_render_pass {
 	struct wlr_render_pass base;
 	struct wlr_vk_renderer *renderer;
 	struct wlr_vk_render_buffer *render_buffer;
 	struct wlr_vk_command_buffer *command_buffer;
+	struct wlr_vk_render_timer *timer; // may be NULL
 	struct rect_union updated_region;
 	VkPipeline bound_pipeline;
+	VkDescriptorSet bound_tex_ds;
+	// Consecutive bindless texture draws using the same pipeline, recorded as
+	// a single instanced draw
+	struct {
+		struct wlr_vk_pipeline *pipeline;
+		struct wl_array instances; // struct wlr_vk_texture_instance
+	} batch;
 	float projection[9];
 	bool failed;
 	bool srgb_pathway; // if false, rendering via intermediate blending buffer
@@ -405,6 +655,17 @@ struct wlr_vk_render_pass *vulkan_begin_render_pass(struct wlr_vk_renderer *rend
 struct wlr_vk_buffer_span vulkan_get_stage_span(
 	struct wlr_vk_renderer *renderer, VkDeviceSize size,
 	VkDeviceSize alignment);
+// Same as vulkan_get_stage_span, but the span is only released once the
+// render command buffer of the current render pass has completed. Used for data
+// read during the render pass, such as vertex buffers.
+struct wlr_vk_buffer_span vulkan_get_render_span(
+	struct wlr_vk_renderer *renderer, VkDeviceSize size,
+	VkDeviceSize alignment);
+
+// Marks the stage spans allocated so far as in use until the given timeline
+// point is reached. Must be called when submitting the stage cb.
+void vulkan_stage_spans_submitted(struct wlr_vk_renderer *renderer,
+	uint64_t timeline_point);
 
 // Tries to allocate a texture descriptor set. Will additionally
 // return the pool it was allocated from when successful (for freeing it later).
@@ -418,9 +679,32 @@ struct wlr_vk_descriptor_pool *vulkan_alloc_texture_ds(
 struct wlr_vk_descriptor_pool *vulkan_alloc_blend_ds(
 	struct wlr_vk_renderer *renderer, VkDescriptorSet *ds);
 
+// Sets up the state shared by effects. Returns false if the device doesn't
+// support them.
+bool vulkan_init_effects(struct wlr_vk_renderer *renderer);
+void vulkan_finish_effects(struct wlr_vk_renderer *renderer);
+// Returns an effect pipeline of a render setup, creating it if needed.
+VkPipeline vulkan_setup_get_effect_pipeline(struct wlr_vk_render_format_setup *setup,
+	enum wlr_vk_effect_pipeline type);
+void vulkan_destroy_effect_pipelines(struct wlr_vk_render_format_setup *setup);
+// Gets an unused blur image with the given size of its first level. The first
+// downsampling step reads from the given image view.
+struct wlr_vk_effect_image *vulkan_acquire_effect_image(
+	struct wlr_vk_renderer *renderer, uint32_t width, uint32_t height,
+	uint32_t levels, VkImageView src_view, VkImageLayout src_layout);
+void vulkan_release_effect_image(struct wlr_vk_renderer *renderer,
+	struct wlr_vk_effect_image *image);
+
 // Frees the given descriptor set from the pool its pool.
 void vulkan_free_ds(struct wlr_vk_renderer *renderer,
 	struct wlr_vk_descriptor_pool *pool, VkDescriptorSet ds);
+// Reserves a slot in a bindless texture array. Returns false if all slots
+// are in use.
+bool vulkan_bindless_alloc_index(struct wlr_vk_bindless_set *set,
+	uint32_t *index);
+// Releases a slot. It must not be used by pending command buffers anymore.
+void vulkan_bindless_free_index(struct wlr_vk_bindless_set *set,
+	uint32_t index);
 struct wlr_vk_format_props *vulkan_format_props_from_drm(
 	struct wlr_vk_device *dev, uint32_t drm_format);
 struct wlr_vk_renderer *vulkan_get_renderer(struct wlr_renderer *r);
@@ -445,12 +729,38 @@ bool vulkan_read_pixels(struct wlr_vk_renderer *vk_renderer,
 	uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
 	uint32_t dst_x, uint32_t dst_y, void *data);
 
+// Block of device memory images are suballocated from
+struct wlr_vk_memory_page {
+	struct wl_list link; // wlr_vk_renderer.memory_pages
+	VkDeviceMemory memory;
+	uint32_t mem_type;
+	VkDeviceSize size;
+	struct wl_array allocs; // struct wlr_vk_allocation, sorted by start
+};
+
+// Memory bound to an image, either suballocated from a page or dedicated
+struct wlr_vk_memory {
+	VkDeviceMemory memory;
+	VkDeviceSize offset, size;
+	struct wlr_vk_memory_page *page; // NULL if dedicated
+};
+
+// Allocates memory with the given properties for a non-exported image and
+// binds it. Small images share pages of device memory, which avoids hitting
+// the driver's allocation count limit.
+bool vulkan_bind_image_memory(struct wlr_vk_renderer *renderer, VkImage image,
+	VkMemoryPropertyFlags flags, struct wlr_vk_memory *mem);
+void vulkan_free_memory(struct wlr_vk_renderer *renderer,
+	struct wlr_vk_memory *mem);
+void vulkan_finish_memory_pages(struct wlr_vk_renderer *renderer);
+
 // State (e.g. image texture) associated with a surface.
 struct wlr_vk_texture {
 	struct wlr_texture wlr_texture;
 	struct wlr_vk_renderer *renderer;
 	uint32_t mem_count;
-	VkDeviceMemory memories[WLR_DMABUF_MAX_PLANES];
+	VkDeviceMemory memories[WLR_DMABUF_MAX_PLANES]; // if dmabuf_imported
+	struct wlr_vk_memory memory; // if !dmabuf_imported
 	VkImage image;
 	const struct wlr_vk_format *format;
 	enum wlr_vk_texture_transform transform;
@@ -459,6 +769,7 @@ struct wlr_vk_texture {
 	bool owned; // if dmabuf_imported: whether we have ownership of the image
 	bool transitioned; // if dma_imported: whether we transitioned it away from preinit
 	bool has_alpha; // whether the image is has alpha channel
+	struct wlr_vk_ycbcr_caps ycbcr_caps; // for YCbCr formats only
 	bool using_mutable_srgb; // is this accessed through _SRGB format view
 	struct wl_list foreign_link; // wlr_vk_renderer.foreign_textures
 	struct wl_list destroy_link; // wlr_vk_command_buffer.destroy_textures
@@ -503,6 +814,13 @@ struct wlr_vk_shared_buffer {
 	int64_t last_used_ms;
 };
 
+// Part of the stage ring buffer in use by submitted stage command buffers,
+// free again once the timeline semaphore reaches timeline_point.
+struct wlr_vk_stage_ring_region {
+	VkDeviceSize end;
+	uint64_t timeline_point;
+};
+
 // Suballocated range on a buffer.
 struct wlr_vk_buffer_span {
 	struct wlr_vk_shared_buffer *buffer;
@@ -530,6 +848,12 @@ const char *vulkan_strerror(VkResult err);
 void vulkan_change_layout(VkCommandBuffer cb, VkImage img,
 	VkImageLayout ol, VkPipelineStageFlags srcs, VkAccessFlags srca,
 	VkImageLayout nl, VkPipelineStageFlags dsts, VkAccessFlags dsta);
+// Records one half of a queue family ownership transfer: both the release
+// and the acquire barrier need to be recorded, on the respective queues.
+void vulkan_transfer_image_ownership(VkCommandBuffer cb, VkImage img,
+	uint32_t src_family, uint32_t dst_family,
+	VkImageLayout ol, VkPipelineStageFlags srcs, VkAccessFlags srca,
+	VkImageLayout nl, VkPipelineStageFlags dsts, VkAccessFlags dsta);
 
 #if __STDC_VERSION__ >= 202311L
 
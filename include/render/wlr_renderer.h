@@ -13,5 +13,39 @@ struct wlr_renderer *renderer_autocreate_with_drm_fd(int drm_fd);
  */
 const struct wlr_drm_format_set *wlr_renderer_get_render_formats(
 	struct wlr_renderer *renderer);
+/**
+ * Wrap a render pass to record operations until submitted, then replay them
+ * on the wrapped render pass without the parts covered by later opaque
+ * operations. The wrapped render pass is submitted along with the new one.
+ */
+struct wlr_render_pass *deferred_render_pass_create(struct wlr_render_pass *parent,
+	struct wlr_buffer *buffer);
+/**
+ * Set the memory accounted for a texture in its renderer's memory usage.
+ * Renderers must reset it to zero before destroying the texture.
+ */
+void texture_set_memory_usage(struct wlr_texture *texture, size_t size,
+	bool imported);
+/**
+ * Create a texture from a buffer, only allocating and uploading the part of
+ * the buffer inside the box if the renderer supports it. The texture keeps the
+ * size of the buffer, but only the box can be sampled. Renderers without
+ * support upload the whole buffer.
+ */
+struct wlr_texture *renderer_texture_from_buffer_cropped(
+	struct wlr_renderer *renderer, struct wlr_buffer *buffer,
+	const struct wlr_box *box);
+/**
+ * Check whether the part of a texture inside the box is backed by texture
+ * memory.
+ */
+bool texture_contains_box(const struct wlr_texture *texture,
+	const struct wlr_fbox *box);
+/**
+ * Hint that buffers of the DRM format will be rendered to soon, so that the
+ * renderer can prepare for it ahead of time. This never blocks.
+ */
+void renderer_prepare_render_format(struct wlr_renderer *renderer,
+	uint32_t format);
 
 #endif
@@ -65,6 +65,16 @@ bool buffer_is_opaque(struct wlr_buffer *buffer);
  */
 struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
 	struct wlr_renderer *renderer);
+/**
+ * Same as wlr_client_buffer_create(), but only uploads the part of the buffer
+ * inside the crop, if the renderer supports it. An empty crop uploads the
+ * whole buffer.
+ *
+ * The buffer is kept locked while the texture is cropped, so that another
+ * part can be uploaded if the crop changes.
+ */
+struct wlr_client_buffer *client_buffer_create_cropped(struct wlr_buffer *buffer,
+	struct wlr_renderer *renderer, const struct wlr_box *crop);
 /**
  * Try to update the buffer's content.
  *
@@ -73,5 +83,17 @@ struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
  */
 bool wlr_client_buffer_apply_damage(struct wlr_client_buffer *client_buffer,
 	struct wlr_buffer *next, const pixman_region32_t *damage);
+/**
+ * Release the buffer's texture to save memory. The source buffer is kept
+ * locked until the texture is needed again.
+ *
+ * Fails if the source buffer has been released, since its contents may have
+ * changed.
+ */
+bool client_buffer_evict_texture(struct wlr_client_buffer *client_buffer);
+/**
+ * Get the buffer's texture, uploading it again if it has been evicted.
+ */
+struct wlr_texture *client_buffer_get_texture(struct wlr_client_buffer *client_buffer);
 
 #endif
@@ -29,6 +29,10 @@ struct wlr_client_data_source *client_data_source_from_resource(
 	struct wl_resource *resource);
 void data_source_notify_finish(struct wlr_data_source *source);
 
+void data_source_cache_send(struct wlr_data_source *source,
+	const char *mime_type, int32_t fd);
+void data_source_cache_finish(struct wlr_data_source *source);
+
 struct wlr_seat_client *seat_client_from_data_device_resource(
 	struct wl_resource *resource);
 /**
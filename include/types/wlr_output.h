@@ -12,6 +12,29 @@ bool output_pending_enabled(struct wlr_output *output,
 bool output_pick_format(struct wlr_output *output,
 	const struct wlr_drm_format_set *display_formats,
 	struct wlr_drm_format *format, uint32_t fmt);
+
+/**
+ * Sets of modifiers tried in turn for primary buffers, in order of expected
+ * memory bandwidth usage.
+ */
+enum output_modifier_tier {
+	// All common modifiers, including compressed ones
+	OUTPUT_MODIFIER_TIER_ALL,
+	// Explicit modifiers without framebuffer compression
+	OUTPUT_MODIFIER_TIER_UNCOMPRESSED,
+	// The implicit modifier, or linear
+	OUTPUT_MODIFIER_TIER_IMPLICIT,
+};
+
+#define OUTPUT_MODIFIER_TIER_COUNT (OUTPUT_MODIFIER_TIER_IMPLICIT + 1)
+
+/**
+ * Restrict the modifiers of a format picked by output_pick_format() to a
+ * tier. changed is set if the format now differs from the ALL tier. Returns
+ * false if no modifier is left.
+ */
+bool output_format_restrict_modifiers(struct wlr_drm_format *format,
+	enum output_modifier_tier tier, bool *changed);
 bool output_ensure_buffer(struct wlr_output *output,
 	struct wlr_output_state *state, bool *new_back_buffer);
 
@@ -20,6 +43,36 @@ bool output_cursor_set_texture(struct wlr_output_cursor *cursor,
 	int dst_width, int dst_height, enum wl_output_transform transform,
 	int32_t hotspot_x, int32_t hotspot_y, struct wlr_drm_syncobj_timeline *wait_timeline,
 	uint64_t wait_point);
+/**
+ * Same as wlr_output_cursor_set_buffer(), but the buffer contents must never
+ * change: its texture and rendered hardware cursor are cached by the output,
+ * until the buffer is destroyed.
+ */
+bool output_cursor_set_cached_buffer(struct wlr_output_cursor *cursor,
+	struct wlr_buffer *buffer, int32_t hotspot_x, int32_t hotspot_y);
+/**
+ * Import a buffer into the output's cursor cache and, if the cursor is on the
+ * cursor plane, render its hardware cursor buffer, without displaying it. Used
+ * to prepare all frames of an animated cursor up-front.
+ */
+void output_cursor_prepare_cached_buffer(struct wlr_output_cursor *cursor,
+	struct wlr_buffer *buffer);
+void output_clear_cursor_cache(struct wlr_output *output);
+/**
+ * Set an image displayed below the cursor image and moving along with it,
+ * such as a drag-and-drop icon, so that both fit on the cursor plane. The
+ * position is relative to the cursor position, in layout-local units. The
+ * texture isn't owned by the cursor and must be unset before it's destroyed.
+ */
+void output_cursor_set_attachment(struct wlr_output_cursor *cursor,
+	struct wlr_texture *texture, const struct wlr_fbox *src_box,
+	int dst_width, int dst_height, enum wl_output_transform transform,
+	int32_t x, int32_t y);
+
+void output_frame_stats_add_commit(struct wlr_output *output,
+	const struct wlr_output_state *state, const struct timespec *when);
+void output_frame_stats_add_present(struct wlr_output *output,
+	const struct wlr_output_event_present *event);
 
 void output_defer_present(struct wlr_output *output, struct wlr_output_event_present event);
 
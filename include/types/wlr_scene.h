@@ -7,4 +7,14 @@ struct wlr_scene *scene_node_get_root(struct wlr_scene_node *node);
 
 void scene_surface_set_clip(struct wlr_scene_surface *surface, struct wlr_box *clip);
 
+/**
+ * Get a box around the node-local point (x, y) where all points accept input,
+ * relative to the node. Returns false if the buffer doesn't display a surface
+ * or if the point doesn't accept input.
+ */
+bool scene_buffer_get_input_box(struct wlr_scene_buffer *scene_buffer,
+	int x, int y, struct wlr_box *box);
+
+void scene_invalidate_node_at_cache(struct wlr_scene *scene);
+
 #endif
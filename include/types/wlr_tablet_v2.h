@@ -62,6 +62,15 @@ struct wlr_tablet_pad_client_v2 {
 	struct wl_resource **strips;
 };
 
+enum tablet_tool_axis {
+	TABLET_TOOL_AXIS_MOTION = 1 << 0,
+	TABLET_TOOL_AXIS_PRESSURE = 1 << 1,
+	TABLET_TOOL_AXIS_DISTANCE = 1 << 2,
+	TABLET_TOOL_AXIS_TILT = 1 << 3,
+	TABLET_TOOL_AXIS_ROTATION = 1 << 4,
+	TABLET_TOOL_AXIS_SLIDER = 1 << 5,
+};
+
 struct wlr_tablet_tool_client_v2 {
 	struct wl_list seat_link;
 	struct wl_list tool_link;
@@ -71,6 +80,15 @@ struct wlr_tablet_tool_client_v2 {
 	struct wlr_tablet_seat_client_v2 *seat;
 
 	struct wl_event_source *frame_source;
+
+	// Axis values accumulated until the next frame
+	uint32_t pending_axes; // enum tablet_tool_axis
+	double x, y;
+	double pressure;
+	double distance;
+	double tilt_x, tilt_y;
+	double rotation;
+	double slider;
 };
 
 struct wlr_tablet_client_v2 *tablet_client_from_resource(struct wl_resource *resource);
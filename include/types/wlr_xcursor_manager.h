@@ -0,0 +1,16 @@
+#ifndef TYPES_WLR_XCURSOR_MANAGER_H
+#define TYPES_WLR_XCURSOR_MANAGER_H
+
+#include <wlr/types/wlr_xcursor_manager.h>
+
+/**
+ * Get a buffer wrapping an image of one of the manager's themes. The buffer is
+ * owned by the theme, which may be shared with other managers: it is kept
+ * around until the last manager using the theme is destroyed, and its contents
+ * never change. Outputs cache their cursor textures per buffer, so the
+ * textures are shared as well.
+ */
+struct wlr_buffer *xcursor_manager_get_image_buffer(
+	struct wlr_xcursor_manager *manager, struct wlr_xcursor_image *image);
+
+#endif
@@ -35,5 +35,6 @@ struct wlr_xdg_toplevel_configure *send_xdg_toplevel_configure(
 	struct wlr_xdg_toplevel *toplevel);
 void handle_xdg_toplevel_ack_configure(struct wlr_xdg_toplevel *toplevel,
 	struct wlr_xdg_toplevel_configure *configure);
+bool xdg_toplevel_should_throttle_configure(struct wlr_xdg_toplevel *toplevel);
 
 #endif
@@ -0,0 +1,43 @@
+#ifndef UTIL_CACHE_H
+#define UTIL_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Get the path of the file with the given name in $XDG_CACHE_HOME/wlroots,
+ * creating the parent directories if needed.
+ *
+ * Returns a newly allocated string, or NULL if there is no cache directory.
+ */
+char *cache_file_get_path(const char *name);
+
+/**
+ * Read the whole contents of a cache file.
+ *
+ * Returns a newly allocated buffer, or NULL if the file doesn't exist or
+ * couldn't be read.
+ */
+void *cache_file_read(const char *path, size_t *size);
+
+/**
+ * Replace the contents of a cache file. The file is written to a temporary
+ * file first, so that concurrent readers never see partial contents.
+ */
+bool cache_file_write(const char *path, const void *data, size_t size);
+
+#define CACHE_HASH_INIT 0xcbf29ce484222325
+
+/**
+ * Update a FNV-1a hash with the given data, to build cache keys.
+ */
+uint64_t cache_hash(uint64_t hash, const void *data, size_t size);
+
+/**
+ * Update a hash with a string, including its NUL terminator so that
+ * concatenations of different strings produce different hashes.
+ */
+uint64_t cache_hash_str(uint64_t hash, const char *str);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef UTIL_LIST_MAP_H
+#define UTIL_LIST_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-util.h>
+
+/**
+ * Hash map of elements chained with a struct wl_list link, keyed by a 64-bit
+ * integer. The key of an element is retrieved from its link with get_key().
+ * The map grows as elements are inserted, there is no limit on their number.
+ *
+ * Elements are looked up by walking the bucket of their key:
+ *
+ *     wl_list_for_each(elem, list_map_get_bucket(&map, key), link) {
+ *         if (elem->key == key) { ... }
+ *     }
+ */
+struct list_map {
+	struct wl_list *buckets;
+	size_t buckets_len; // power of two
+	size_t len;
+	uint64_t (*get_key)(struct wl_list *link);
+};
+
+bool list_map_init(struct list_map *map,
+	uint64_t (*get_key)(struct wl_list *link));
+/**
+ * Release the buckets. The map must be empty, or its elements must not be
+ * removed afterwards.
+ */
+void list_map_finish(struct list_map *map);
+struct wl_list *list_map_get_bucket(struct list_map *map, uint64_t key);
+void list_map_insert(struct list_map *map, struct wl_list *link);
+/**
+ * Remove an element from the map. The link is re-initialized, removing an
+ * element which isn't in the map is a no-op.
+ */
+void list_map_remove(struct list_map *map, struct wl_list *link);
+
+#endif
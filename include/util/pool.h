@@ -0,0 +1,33 @@
+#ifndef UTIL_POOL_H
+#define UTIL_POOL_H
+
+#include <stddef.h>
+#include <wayland-util.h>
+
+/**
+ * Allocator for objects of a single size. Objects are carved out of larger
+ * chunks, so that objects allocated together end up close to each other in
+ * memory, and freed objects are re-used before new chunks are allocated.
+ */
+struct object_pool {
+	size_t object_size;
+	size_t chunk_len; // objects per chunk
+
+	struct wl_list chunks; // object_pool_chunk.link
+	void *free_list;
+	size_t len; // number of allocated objects
+};
+
+void object_pool_init(struct object_pool *pool, size_t object_size);
+/**
+ * Release the memory of the pool. All objects must have been freed.
+ */
+void object_pool_finish(struct object_pool *pool);
+
+/**
+ * Allocate a zero-initialized object.
+ */
+void *object_pool_alloc(struct object_pool *pool);
+void object_pool_free(struct object_pool *pool, void *object);
+
+#endif
@@ -60,6 +60,25 @@ void rect_union_finish(struct rect_union *r);
  */
 void rect_union_add(struct rect_union *r, pixman_box32_t box);
 
+/**
+ * Add all rectangles of a region to the union.
+ *
+ * Amortized time: O(n), where n is the number of rectangles in the region
+ */
+void rect_union_add_region(struct rect_union *r, const pixman_region32_t *region);
+
+/**
+ * Remove a region from the union. Pending rectangles are evaluated first, so
+ * callers should batch their additions before calling this.
+ */
+void rect_union_subtract(struct rect_union *r, const pixman_region32_t *region);
+
+/**
+ * Restrict the union to a region. Pending rectangles are evaluated first, so
+ * callers should batch their additions before calling this.
+ */
+void rect_union_intersect(struct rect_union *r, const pixman_region32_t *region);
+
 /**
  * Compute an exact cover of the rectangles added so far, and return
  * a pointer to a pixman_region32_t giving that cover. The pointer will
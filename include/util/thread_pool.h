@@ -0,0 +1,22 @@
+#ifndef UTIL_THREAD_POOL_H
+#define UTIL_THREAD_POOL_H
+
+struct thread_pool;
+
+typedef void (*thread_pool_func_t)(void *data, int index);
+
+/**
+ * Create a pool of threads_len threads, the calling thread included. Returns
+ * NULL if no thread could be spawned.
+ */
+struct thread_pool *thread_pool_create(int threads_len);
+void thread_pool_destroy(struct thread_pool *pool);
+int thread_pool_get_size(struct thread_pool *pool);
+/**
+ * Call func for each index in [0, tasks_len) using all threads of the pool,
+ * and wait for all calls to return.
+ */
+void thread_pool_run(struct thread_pool *pool,
+	thread_pool_func_t func, void *data, int tasks_len);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef UTIL_TRACE_H
+#define UTIL_TRACE_H
+
+#include "config.h"
+
+/**
+ * Lightweight tracing of per-frame work.
+ *
+ * Spans are written to the ftrace marker file in the format used by atrace,
+ * which Perfetto turns into slices on the thread which emitted them. Tracing
+ * is compiled in with the "trace" build option and enabled at runtime with
+ * WLR_TRACE=1. When the build option is disabled, these functions compile
+ * down to nothing.
+ *
+ * Spans must be properly nested on each thread.
+ */
+
+#if HAVE_TRACE
+
+/**
+ * Begin a span. The name should be a string literal.
+ */
+void trace_begin(const char *name);
+/**
+ * End the last span begun on the calling thread.
+ */
+void trace_end(void);
+
+#else
+
+static inline void trace_begin(const char *name) {
+}
+
+static inline void trace_end(void) {
+}
+
+#endif
+
+#endif
@@ -15,6 +15,8 @@
 #include <wlr/types/wlr_output.h>
 
 struct wlr_drm_backend;
+struct wlr_drm_connector;
+struct wlr_drm_fb;
 typedef struct _drmModeModeInfo drmModeModeInfo;
 
 struct wlr_drm_lease {
@@ -52,6 +54,16 @@ struct wlr_backend *wlr_drm_backend_get_parent(struct wlr_backend *backend);
  */
 uint32_t wlr_drm_connector_get_id(struct wlr_output *output);
 
+/**
+ * Get the range of vertical refresh rates supported by the connector when
+ * adaptive sync is enabled, in mHz. The range is read from the EDID.
+ *
+ * Returns false if the connector doesn't support adaptive sync or the range is
+ * unknown.
+ */
+bool wlr_drm_connector_get_vrr_range(struct wlr_output *output,
+	int32_t *min_refresh, int32_t *max_refresh);
+
 /**
  * Tries to open non-master DRM FD. The compositor must not call drmSetMaster()
  * on the returned FD.
@@ -100,4 +112,48 @@ const drmModeModeInfo *wlr_drm_mode_get_info(struct wlr_output_mode *mode);
 enum wl_output_transform wlr_drm_connector_get_panel_orientation(
 	struct wlr_output *output);
 
+/**
+ * A capture of the output contents by a KMS writeback connector.
+ *
+ * The display engine writes the CRTC contents (all planes, including the
+ * cursor) into the buffer while scanning out the next frame committed on the
+ * output, without any GPU work. The done event is emitted once the capture is
+ * over, or has failed.
+ */
+struct wlr_drm_writeback {
+	struct wlr_output *output;
+	struct wlr_buffer *buffer;
+	// Whether the buffer contains the output contents, valid after done
+	bool success;
+
+	struct {
+		struct wl_signal done;
+	} events;
+
+	struct {
+		struct wlr_drm_connector *conn; // NULL once done
+		struct wlr_drm_fb *fb;
+		bool submitted;
+		int out_fence_fd;
+		struct wl_event_source *out_fence_source;
+		struct wl_list link; // wlr_drm_connector.writebacks
+	} WLR_PRIVATE;
+};
+
+/**
+ * Request a capture of the next frame committed on the output into a DMA-BUF.
+ * The buffer must have the same size as the current mode.
+ *
+ * Returns NULL if the output has no writeback connector available or if the
+ * buffer can't be written by one, in which case the compositor needs to fall
+ * back to a copy with the renderer.
+ */
+struct wlr_drm_writeback *wlr_drm_writeback_create(struct wlr_output *output,
+	struct wlr_buffer *buffer);
+
+/**
+ * Destroy a writeback, cancelling it if it's still pending.
+ */
+void wlr_drm_writeback_destroy(struct wlr_drm_writeback *writeback);
+
 #endif
@@ -9,6 +9,7 @@
 #ifndef WLR_BACKEND_HEADLESS_H
 #define WLR_BACKEND_HEADLESS_H
 
+#include <pixman.h>
 #include <wlr/backend.h>
 #include <wlr/types/wlr_output.h>
 
@@ -25,6 +26,45 @@ struct wlr_backend *wlr_headless_backend_create(struct wl_event_loop *loop);
 struct wlr_output *wlr_headless_add_output(struct wlr_backend *backend,
 	unsigned int width, unsigned int height);
 
+/**
+ * Send frame events as soon as a commit completes instead of at the output
+ * refresh rate.
+ *
+ * This allows measuring the throughput of the compositor and its clients
+ * without being capped by the refresh rate. Throttled outputs follow a
+ * virtual vblank clock at the mode refresh rate, which can be arbitrarily
+ * high.
+ */
+void wlr_headless_output_set_unthrottled(struct wlr_output *output,
+	bool unthrottled);
+
+/**
+ * Keep a reference to the last buffer committed on the output, along with the
+ * damage accumulated since the last wlr_headless_output_lock_frame() call.
+ *
+ * This allows an in-process consumer (e.g. a VNC or RDP server) to read
+ * frames without copying them. When the output renders with the shared memory
+ * allocator (e.g. with the pixman renderer), the buffers are memfd-backed and
+ * can be accessed with wlr_buffer_get_shm() or
+ * wlr_buffer_begin_data_ptr_access().
+ */
+void wlr_headless_output_set_export_frames(struct wlr_output *output,
+	bool export_frames);
+
+/**
+ * Lock the last buffer committed on a headless output with frame export
+ * enabled, or return NULL if there is none. The caller must release the buffer
+ * with wlr_buffer_unlock().
+ *
+ * If damage is not NULL, it's set to the damage accumulated since the previous
+ * call, in buffer-local coordinates. The accumulated damage is then reset.
+ *
+ * The buffer must not be written to. It's typically retrieved from a listener
+ * of the wlr_output commit event.
+ */
+struct wlr_buffer *wlr_headless_output_lock_frame(struct wlr_output *output,
+	pixman_region32_t *damage);
+
 bool wlr_backend_is_headless(struct wlr_backend *backend);
 bool wlr_output_is_headless(struct wlr_output *output);
 
@@ -69,6 +69,11 @@ struct wlr_session {
 
 	struct {
 		struct wl_listener event_loop_destroy;
+
+		// Nested event loop for latency-sensitive fds (DRM, libinput),
+		// registered as a single source in event_loop
+		struct wl_event_loop *priority_event_loop;
+		struct wl_event_source *priority_event;
 	} WLR_PRIVATE;
 };
 
@@ -102,6 +107,16 @@ struct wlr_device_change_event {
  */
 struct wlr_session *wlr_session_create(struct wl_event_loop *loop);
 
+/**
+ * Dispatch pending DRM and libinput events without blocking.
+ *
+ * These events are normally dispatched along with the other sources of the
+ * event loop passed to wlr_session_create(). Compositors running their own
+ * loop can call this first on each iteration, so that page-flips and input
+ * are never delayed by a flood of client requests.
+ */
+void wlr_session_dispatch_priority_events(struct wlr_session *session);
+
 /*
  * Closes a previously opened session and restores the virtual terminal.
  * You should call wlr_session_close_file() on each files you opened
@@ -0,0 +1,76 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_INTERFACES_WLR_EXT_IMAGE_CAPTURE_SOURCE_V1_H
+#define WLR_INTERFACES_WLR_EXT_IMAGE_CAPTURE_SOURCE_V1_H
+
+#include <wlr/types/wlr_ext_image_capture_source_v1.h>
+
+struct wlr_ext_image_copy_capture_frame_v1;
+struct wlr_renderer;
+struct wlr_seat;
+struct wlr_swapchain;
+
+struct wlr_ext_image_capture_source_v1_interface {
+	/**
+	 * Start producing frames, called once per capture session. If
+	 * with_cursors is true, cursors need to be painted in the frames.
+	 */
+	void (*start)(struct wlr_ext_image_capture_source_v1 *source, bool with_cursors);
+	/**
+	 * Stop producing frames, called once per stopped capture session with
+	 * the same with_cursors value as start().
+	 */
+	void (*stop)(struct wlr_ext_image_capture_source_v1 *source, bool with_cursors);
+	/**
+	 * Request a new frame. The events.frame signal should be emitted soon.
+	 */
+	void (*schedule_frame)(struct wlr_ext_image_capture_source_v1 *source);
+	/**
+	 * Copy the frame being emitted to dst_frame. Only called from an
+	 * events.frame handler. Implementations must call
+	 * wlr_ext_image_copy_capture_frame_v1_ready() or
+	 * wlr_ext_image_copy_capture_frame_v1_fail().
+	 */
+	void (*copy_frame)(struct wlr_ext_image_capture_source_v1 *source,
+		struct wlr_ext_image_copy_capture_frame_v1 *dst_frame,
+		struct wlr_ext_image_capture_source_v1_frame_event *frame_event);
+	/**
+	 * Get the cursor of a seat on this source. Optional, cursor sessions
+	 * are never entered if unset or if NULL is returned.
+	 */
+	struct wlr_ext_image_capture_source_v1_cursor *(*get_pointer_cursor)(
+		struct wlr_ext_image_capture_source_v1 *source, struct wlr_seat *seat);
+};
+
+void wlr_ext_image_capture_source_v1_init(struct wlr_ext_image_capture_source_v1 *source,
+	const struct wlr_ext_image_capture_source_v1_interface *impl);
+/**
+ * Emit the destroy signal, make resources inert and release the constraints.
+ */
+void wlr_ext_image_capture_source_v1_finish(struct wlr_ext_image_capture_source_v1 *source);
+/**
+ * Create a new ext_image_capture_source_v1 resource for the source.
+ */
+bool wlr_ext_image_capture_source_v1_create_resource(struct wlr_ext_image_capture_source_v1 *source,
+	struct wl_client *client, uint32_t new_id);
+/**
+ * Set the buffer constraints of a source from a swapchain: the swapchain's
+ * size, its format and modifiers for DMA-BUFs, and the preferred read format
+ * of the renderer for shared memory buffers. Emits
+ * events.constraints_update.
+ */
+bool wlr_ext_image_capture_source_v1_set_constraints_from_swapchain(
+	struct wlr_ext_image_capture_source_v1 *source,
+	struct wlr_swapchain *swapchain, struct wlr_renderer *renderer);
+
+void wlr_ext_image_capture_source_v1_cursor_init(struct wlr_ext_image_capture_source_v1_cursor *cursor,
+	const struct wlr_ext_image_capture_source_v1_interface *impl);
+void wlr_ext_image_capture_source_v1_cursor_finish(struct wlr_ext_image_capture_source_v1_cursor *cursor);
+
+#endif
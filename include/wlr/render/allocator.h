@@ -44,6 +44,10 @@ struct wlr_allocator {
 	struct {
 		struct wl_signal destroy;
 	} events;
+
+	struct {
+		size_t memory_usage;
+	} WLR_PRIVATE;
 };
 
 /**
@@ -77,4 +81,10 @@ void wlr_allocator_destroy(struct wlr_allocator *alloc);
 struct wlr_buffer *wlr_allocator_create_buffer(struct wlr_allocator *alloc,
 	int width, int height, const struct wlr_drm_format *format);
 
+/**
+ * Get the memory used by the buffers allocated with this allocator which
+ * haven't been destroyed yet, in bytes. This includes swapchain buffers.
+ */
+size_t wlr_allocator_get_memory_usage(struct wlr_allocator *alloc);
+
 #endif
@@ -53,4 +53,18 @@ EGLDisplay wlr_egl_get_display(struct wlr_egl *egl);
  */
 EGLContext wlr_egl_get_context(struct wlr_egl *egl);
 
+/**
+ * Make the EGL context current until wlr_egl_end_current() is called.
+ *
+ * Renderer operations make the context current and restore the previous one
+ * each time. Compositors performing custom OpenGL operations or running
+ * several renderer operations in a row can wrap them in this scope: the
+ * context stays current and no context switch happens in between.
+ *
+ * Calls can be nested. The context which was current before the outermost
+ * call is restored by the matching wlr_egl_end_current() call.
+ */
+bool wlr_egl_begin_current(struct wlr_egl *egl);
+void wlr_egl_end_current(struct wlr_egl *egl);
+
 #endif
@@ -28,9 +28,15 @@ struct wlr_renderer_impl {
 	int (*get_drm_fd)(struct wlr_renderer *renderer);
 	struct wlr_texture *(*texture_from_buffer)(struct wlr_renderer *renderer,
 		struct wlr_buffer *buffer);
+	// Optional, only uploads the part of the buffer inside the box
+	struct wlr_texture *(*texture_from_buffer_cropped)(struct wlr_renderer *renderer,
+		struct wlr_buffer *buffer, const struct wlr_box *box);
 	struct wlr_render_pass *(*begin_buffer_pass)(struct wlr_renderer *renderer,
 		struct wlr_buffer *buffer, const struct wlr_buffer_pass_options *options);
 	struct wlr_render_timer *(*render_timer_create)(struct wlr_renderer *renderer);
+	// Optional, starts building the state needed to render to a format
+	void (*prepare_render_format)(struct wlr_renderer *renderer,
+		uint32_t format);
 };
 
 void wlr_renderer_init(struct wlr_renderer *renderer,
@@ -42,12 +48,26 @@ struct wlr_texture_impl {
 	bool (*read_pixels)(struct wlr_texture *texture,
 		const struct wlr_texture_read_pixels_options *options);
 	uint32_t (*preferred_read_format)(struct wlr_texture *texture);
+	// Optional, returns true if the texture has no alpha channel
+	bool (*is_opaque)(struct wlr_texture *texture);
 	void (*destroy)(struct wlr_texture *texture);
+	struct wlr_texture_readback *(*read_pixels_async)(struct wlr_texture *texture,
+		const struct wlr_texture_read_pixels_options *options,
+		struct wl_event_loop *loop);
 };
 
 void wlr_texture_init(struct wlr_texture *texture, struct wlr_renderer *rendener,
 	const struct wlr_texture_impl *impl, uint32_t width, uint32_t height);
 
+struct wlr_texture_readback_impl {
+	bool (*copy)(struct wlr_texture_readback *readback,
+		void *data, uint32_t stride);
+	void (*destroy)(struct wlr_texture_readback *readback);
+};
+
+void wlr_texture_readback_init(struct wlr_texture_readback *readback,
+	const struct wlr_texture_readback_impl *impl);
+
 struct wlr_render_pass {
 	const struct wlr_render_pass_impl *impl;
 };
@@ -62,6 +82,11 @@ struct wlr_render_pass_impl {
 	/* Implementers are also guaranteed that options->box is nonempty */
 	void (*add_rect)(struct wlr_render_pass *pass,
 		const struct wlr_render_rect_options *options);
+	/* Optional effects, options->box is nonempty */
+	bool (*add_blur)(struct wlr_render_pass *pass,
+		const struct wlr_render_blur_options *options);
+	bool (*add_shadow)(struct wlr_render_pass *pass,
+		const struct wlr_render_shadow_options *options);
 };
 
 struct wlr_render_timer {
@@ -44,6 +44,14 @@ struct wlr_buffer_pass_options {
 	 */
 	struct wlr_drm_syncobj_timeline *signal_timeline;
 	uint64_t signal_point;
+
+	/* Record the operations and only send them to the renderer on submit,
+	 * skipping the parts covered by later opaque operations.
+	 *
+	 * Clip regions are copied, but textures must not be destroyed before
+	 * the render pass is submitted.
+	 */
+	bool cull_occluded;
 };
 
 /**
@@ -114,6 +122,10 @@ struct wlr_render_texture_options {
 
 /**
  * Render a texture.
+ *
+ * Renderers may defer drawing until wlr_render_pass_submit() is called: the
+ * texture must not be destroyed nor updated before the render pass has been
+ * submitted.
  */
 void wlr_render_pass_add_texture(struct wlr_render_pass *render_pass,
 	const struct wlr_render_texture_options *options);
@@ -145,4 +157,53 @@ struct wlr_render_rect_options {
 void wlr_render_pass_add_rect(struct wlr_render_pass *render_pass,
 	const struct wlr_render_rect_options *options);
 
+struct wlr_render_blur_options {
+	/* Area to blur */
+	struct wlr_box box;
+	/* Radius of the rounded corners of the area, 0 for square corners */
+	int corner_radius;
+	/* Clip region, leave NULL to disable clipping. Only the pixels in the
+	 * area and the clip region, plus a margin for the blur, are processed. */
+	const pixman_region32_t *clip;
+	/* Number of downsampling steps, between 1 and 8. Each step doubles the
+	 * strength of the blur. */
+	int passes;
+	/* Distance between samples in pixels, 1 if zero */
+	float offset;
+};
+
+/**
+ * Blur what has been rendered so far in an area, with the dual Kawase
+ * algorithm.
+ *
+ * This is an optional feature: false is returned if the renderer doesn't
+ * support it, in which case nothing is drawn.
+ */
+bool wlr_render_pass_add_blur(struct wlr_render_pass *render_pass,
+	const struct wlr_render_blur_options *options);
+
+struct wlr_render_shadow_options {
+	/* Rectangle casting the shadow */
+	struct wlr_box box;
+	/* Radius of the rounded corners of the rectangle */
+	int corner_radius;
+	/* Standard deviation of the gaussian blur in pixels. The shadow extends
+	 * 3 times as far beyond the rectangle. */
+	float blur_sigma;
+	/* Shadow color */
+	struct wlr_render_color color;
+	/* Clip region, leave NULL to disable clipping */
+	const pixman_region32_t *clip;
+};
+
+/**
+ * Render the blurred shadow of a rounded rectangle, blended over what has
+ * been rendered so far.
+ *
+ * This is an optional feature: false is returned if the renderer doesn't
+ * support it, in which case nothing is drawn.
+ */
+bool wlr_render_pass_add_shadow(struct wlr_render_pass *render_pass,
+	const struct wlr_render_shadow_options *options);
+
 #endif
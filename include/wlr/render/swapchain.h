@@ -13,6 +13,7 @@ struct wlr_swapchain_slot {
 
 	struct {
 		struct wl_listener release;
+		size_t acquire_seq;
 	} WLR_PRIVATE;
 };
 
@@ -24,8 +25,12 @@ struct wlr_swapchain {
 
 	struct wlr_swapchain_slot slots[WLR_SWAPCHAIN_CAP];
 
+	// Number of buffers allocated and freed over the swapchain's lifetime
+	size_t allocated, freed;
+
 	struct {
 		struct wl_listener allocator_destroy;
+		size_t acquire_seq;
 	} WLR_PRIVATE;
 };
 
@@ -40,6 +45,13 @@ void wlr_swapchain_destroy(struct wlr_swapchain *swapchain);
  * unlock it by calling wlr_buffer_unlock.
  */
 struct wlr_buffer *wlr_swapchain_acquire(struct wlr_swapchain *swapchain);
+/**
+ * Get the number of buffers currently allocated by the swapchain.
+ *
+ * Buffers are allocated when all existing ones are in use, up to
+ * WLR_SWAPCHAIN_CAP, and freed once they've been left unused for a while.
+ */
+int wlr_swapchain_get_depth(struct wlr_swapchain *swapchain);
 /**
  * Returns true if this buffer has been created by this swapchain, and false
  * otherwise.
@@ -25,6 +25,19 @@ struct wlr_fbox;
 /**
  * A renderer for basic 2D operations.
  */
+/**
+ * Memory allocated by a renderer, in bytes.
+ */
+struct wlr_renderer_memory_usage {
+	// Textures holding pixels uploaded by the renderer
+	size_t textures;
+	// Textures reading from the memory of the buffer they were created from,
+	// e.g. imported DMA-BUFs
+	size_t imported_textures;
+	// Buffers used to transfer pixels between the CPU and the GPU
+	size_t staging_buffers;
+};
+
 struct wlr_renderer {
 	// Capabilities required for the buffer used as a render target (bitmask of
 	// enum wlr_buffer_cap)
@@ -55,6 +68,7 @@ struct wlr_renderer {
 
 	struct {
 		const struct wlr_renderer_impl *impl;
+		struct wlr_renderer_memory_usage memory_usage;
 	} WLR_PRIVATE;
 };
 
@@ -98,6 +112,13 @@ bool wlr_renderer_init_wl_shm(struct wlr_renderer *r,
  */
 int wlr_renderer_get_drm_fd(struct wlr_renderer *r);
 
+/**
+ * Get the memory currently allocated by the renderer. Sizes are estimates:
+ * drivers may allocate more for alignment, compression metadata and so on.
+ */
+void wlr_renderer_get_memory_usage(struct wlr_renderer *r,
+	struct wlr_renderer_memory_usage *usage);
+
 /**
  * Destroys the renderer.
  *
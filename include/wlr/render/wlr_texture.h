@@ -18,12 +18,20 @@
 struct wlr_buffer;
 struct wlr_renderer;
 struct wlr_texture_impl;
+struct wlr_texture_readback_impl;
 
 struct wlr_texture {
 	const struct wlr_texture_impl *impl;
 	uint32_t width, height;
 
 	struct wlr_renderer *renderer;
+
+	struct {
+		size_t memory_usage;
+		bool memory_imported;
+		// Part of the texture backed by texture memory, empty if all of it is
+		struct wlr_box crop;
+	} WLR_PRIVATE;
 };
 
 struct wlr_texture_read_pixels_options {
@@ -44,6 +52,56 @@ bool wlr_texture_read_pixels(struct wlr_texture *texture,
 
 uint32_t wlr_texture_preferred_read_format(struct wlr_texture *texture);
 
+/**
+ * Get an estimate of the memory backing the texture, in bytes. For textures
+ * reading from the memory of a buffer, such as imported DMA-BUFs, this is the
+ * size of the buffer.
+ */
+size_t wlr_texture_get_memory_usage(struct wlr_texture *texture);
+
+/**
+ * A pending asynchronous read of texture pixels.
+ *
+ * The ready event is emitted by the event loop once the pixels are available,
+ * at which point they can be copied without stalling with
+ * wlr_texture_readback_copy(). Copying fails once the renderer has been
+ * destroyed.
+ */
+struct wlr_texture_readback {
+	const struct wlr_texture_readback_impl *impl;
+
+	struct {
+		struct wl_signal ready;
+	} events;
+};
+
+/**
+ * Start reading pixels from a texture without waiting for the GPU.
+ *
+ * The data and stride fields of the options are ignored: the destination is
+ * passed to wlr_texture_readback_copy() instead. The texture can be destroyed
+ * right after this function returns.
+ *
+ * Returns NULL if the renderer doesn't support asynchronous reads, in which
+ * case wlr_texture_read_pixels() should be used instead.
+ */
+struct wlr_texture_readback *wlr_texture_read_pixels_async(
+	struct wlr_texture *texture,
+	const struct wlr_texture_read_pixels_options *options,
+	struct wl_event_loop *loop);
+
+/**
+ * Copy the pixels of a readback to memory. Blocks if called before the ready
+ * event has been emitted.
+ */
+bool wlr_texture_readback_copy(struct wlr_texture_readback *readback,
+	void *data, uint32_t stride);
+
+/**
+ * Destroy a readback, cancelling it if it's still pending.
+ */
+void wlr_texture_readback_destroy(struct wlr_texture_readback *readback);
+
 /**
  * Create a new texture from raw pixel data. `stride` is in bytes. The returned
  * texture is mutable.
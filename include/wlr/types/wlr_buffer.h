@@ -163,6 +163,14 @@ struct wlr_client_buffer {
 		struct wl_listener renderer_destroy;
 
 		size_t n_ignore_locks;
+
+		struct wlr_renderer *renderer;
+		// The texture has been released, the source is locked to upload it
+		// again
+		bool texture_evicted;
+		// Part of the source uploaded to the texture, empty for all of it.
+		// The source is kept locked while cropped to upload another part.
+		struct wlr_box crop;
 	} WLR_PRIVATE;
 };
 
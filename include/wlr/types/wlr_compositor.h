@@ -29,6 +29,8 @@ enum wlr_surface_state_field {
 	WLR_SURFACE_STATE_FRAME_CALLBACK_LIST = 1 << 7,
 	WLR_SURFACE_STATE_VIEWPORT = 1 << 8,
 	WLR_SURFACE_STATE_OFFSET = 1 << 9,
+	// The position or stacking order of sub-surfaces may have changed
+	WLR_SURFACE_STATE_SUBSURFACES = 1 << 10,
 };
 
 struct wlr_surface_state {
@@ -72,6 +74,13 @@ struct wlr_surface_state {
 
 	// Sync'ed object states, one per struct wlr_surface_synced
 	struct wl_array synced; // void *
+
+	struct {
+		// For cached states, contiguous storage for the sync'ed object
+		// states which existed when the state was created
+		void *synced_block;
+		size_t synced_block_size;
+	} WLR_PRIVATE;
 };
 
 struct wlr_surface_role {
@@ -263,8 +272,22 @@ struct wlr_surface {
 		struct wl_list synced; // wlr_surface_synced.link
 		size_t synced_len;
 
+		// Cached states which have been applied, kept with their synced
+		// states to be re-used by the next locked commits
+		struct wl_list cached_pool; // wlr_surface_state.cached_state_link
+		size_t cached_pool_len;
+
 		struct wl_resource *pending_buffer_resource;
 		struct wl_listener pending_buffer_resource_destroy;
+
+		// Cached result of wlr_surface_get_effective_damage(), reset on
+		// commit
+		pixman_region32_t effective_damage;
+		bool effective_damage_valid;
+
+		// Commits held back because the client exceeded its budget
+		struct wl_list deferred_link; // wlr_compositor.deferred_surfaces
+		uint32_t deferred_seq;
 	} WLR_PRIVATE;
 };
 
@@ -282,9 +305,27 @@ struct wlr_compositor {
 	struct {
 		struct wl_listener display_destroy;
 		struct wl_listener renderer_destroy;
+
+		struct wl_event_loop *event_loop;
+		struct wl_protocol_logger *protocol_logger;
+		struct wl_list clients; // compositor_client.link
+
+		uint32_t client_commit_budget; // 0 if unlimited
+		struct wl_list deferred_surfaces; // wlr_surface.deferred_link
+		// Resets the budgets at the end of the event loop iteration
+		struct wl_event_source *budget_idle;
 	} WLR_PRIVATE;
 };
 
+/**
+ * Request counters of a client.
+ */
+struct wlr_compositor_client_stats {
+	uint64_t requests;
+	uint64_t commits; // wl_surface.commit requests
+	uint64_t deferred_commits; // commits held back by the budget
+};
+
 typedef void (*wlr_surface_iterator_func_t)(struct wlr_surface *surface,
 	int sx, int sy, void *data);
 
@@ -568,4 +609,29 @@ struct wlr_compositor *wlr_compositor_create(struct wl_display *display,
 void wlr_compositor_set_renderer(struct wlr_compositor *compositor,
 	struct wlr_renderer *renderer);
 
+/**
+ * Get the memory used by the textures of the buffers currently attached to
+ * the client's surfaces, in bytes. See wlr_texture_get_memory_usage().
+ */
+size_t wlr_compositor_get_client_memory_usage(struct wlr_compositor *compositor,
+	struct wl_client *client);
+
+/**
+ * Limit the number of wl_surface.commit requests of a single client applied
+ * in one event loop iteration. Once a client exceeds its budget, its surfaces
+ * keep their commits cached until the other sources dispatched in the same
+ * iteration (other clients, page-flips, input) have been processed.
+ *
+ * A budget of 0 (the default) means unlimited.
+ */
+void wlr_compositor_set_client_commit_budget(struct wlr_compositor *compositor,
+	uint32_t max_commits);
+
+/**
+ * Get the request counters of a client bound to the compositor global.
+ * Returns false if the client never bound it.
+ */
+bool wlr_compositor_get_client_stats(struct wlr_compositor *compositor,
+	struct wl_client *client, struct wlr_compositor_client_stats *stats);
+
 #endif
@@ -13,6 +13,7 @@
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_output.h>
 
+struct wlr_drag_icon;
 struct wlr_input_device;
 struct wlr_xcursor_manager;
 
@@ -166,6 +167,18 @@ void wlr_cursor_set_xcursor(struct wlr_cursor *cur,
 void wlr_cursor_set_surface(struct wlr_cursor *cur, struct wlr_surface *surface,
 	int32_t hotspot_x, int32_t hotspot_y);
 
+/**
+ * Draw a drag-and-drop icon along with the cursor image. When possible, the
+ * icon is composited into the hardware cursor buffer so that it moves with
+ * the cursor without re-rendering the output. Compositors using this should
+ * not draw the icon themselves. Only the main surface of the icon is drawn,
+ * not its subsurfaces.
+ *
+ * Pass NULL to stop drawing the icon. The icon is unset automatically when
+ * destroyed.
+ */
+void wlr_cursor_set_drag_icon(struct wlr_cursor *cur, struct wlr_drag_icon *icon);
+
 /**
  * Attaches this input device to this cursor. The input device must be one of:
  *
@@ -215,4 +228,35 @@ void wlr_cursor_map_to_region(struct wlr_cursor *cur, const struct wlr_box *box)
 void wlr_cursor_map_input_to_region(struct wlr_cursor *cur,
 	struct wlr_input_device *dev, const struct wlr_box *box);
 
+/**
+ * Coalesce relative pointer motion. When enabled, the motion events of a
+ * pointer are accumulated (including the unaccelerated deltas) and the motion
+ * event is emitted at most once per output frame, along with a single frame
+ * event. Any other input event emits the pending motion first.
+ *
+ * The pending motion is emitted when one of the outputs emits a frame event.
+ * Compositors can call wlr_cursor_flush_motion() before rendering to make sure
+ * the latest motion is taken into account.
+ */
+void wlr_cursor_set_motion_coalescing(struct wlr_cursor *cur, bool enabled);
+
+/**
+ * Resample touch motion to the output refresh cycle. When enabled, touch
+ * motion events are held back until the next output frame event, and a single
+ * motion event is emitted per touch point, followed by a single frame event.
+ * The position is estimated at the predicted presentation time of the output
+ * (as reported by the output present events) from the velocity of the last two
+ * samples: it's interpolated when the samples are more recent, and
+ * extrapolated by a few milliseconds at most otherwise.
+ *
+ * Touch down, up and cancel events emit the pending motion first.
+ */
+void wlr_cursor_set_touch_resampling(struct wlr_cursor *cur, bool enabled);
+
+/**
+ * Emit the pending coalesced pointer motion and touch motion, if any. Touch
+ * motion is emitted without resampling.
+ */
+void wlr_cursor_flush_motion(struct wlr_cursor *cur);
+
 #endif
@@ -33,6 +33,19 @@ struct wlr_damage_ring {
 	// Difference between the current buffer and the previous one
 	pixman_region32_t current;
 
+	// Accumulated damage made of more than max_rects rectangles is
+	// simplified into fewer, larger rectangles. If merging it into its
+	// bounding box paints at most max_waste times the bounding box area in
+	// excess, the bounding box is used. Defaults are set by
+	// wlr_damage_ring_init().
+	int max_rects;
+	float max_waste;
+
+	// Total number of undamaged pixels included in the damage returned by
+	// wlr_damage_ring_rotate_buffer() because of simplification. Users may
+	// reset it at will.
+	uint64_t overpainted_pixels;
+
 	struct {
 		struct wl_list buffers; // wlr_damage_ring_buffer.link
 	} WLR_PRIVATE;
@@ -81,6 +81,12 @@ struct wlr_data_source {
 	struct {
 		struct wl_signal destroy;
 	} events;
+
+	struct {
+		struct wl_event_loop *cache_event_loop; // NULL if the cache is disabled
+		size_t cache_max_size;
+		struct wl_list cache_entries;
+	} WLR_PRIVATE;
 };
 
 struct wlr_drag;
@@ -223,6 +229,17 @@ void wlr_data_source_init(struct wlr_data_source *source,
 void wlr_data_source_send(struct wlr_data_source *source, const char *mime_type,
 	int32_t fd);
 
+/**
+ * Cache the data sent by the source in memory, so that the source is only
+ * asked once per MIME type no matter how many clients read it, e.g. clipboard
+ * managers through data-control. Data larger than max_size bytes isn't cached
+ * and each reader is served by the source directly.
+ *
+ * Transfers still in progress are aborted when the source is destroyed.
+ */
+void wlr_data_source_enable_cache(struct wlr_data_source *source,
+	struct wl_event_loop *event_loop, size_t max_size);
+
 /**
  * Notifies the data source that a target accepts one of the offered MIME types.
  * If a target doesn't accept any of the offered types, `mime_type` is NULL.
@@ -23,6 +23,8 @@ struct wlr_export_dmabuf_manager_v1 {
 
 	struct {
 		struct wl_listener display_destroy;
+
+		size_t max_held_buffers;
 	} WLR_PRIVATE;
 };
 
@@ -36,6 +38,11 @@ struct wlr_export_dmabuf_frame_v1 {
 	bool cursor_locked;
 
 	struct {
+		// Whether the frame waits for an output commit
+		bool capturing;
+		// Exported buffer kept alive until the frame is destroyed, if any
+		struct wlr_buffer *held_buffer;
+
 		struct wl_listener output_commit;
 		struct wl_listener output_destroy;
 	} WLR_PRIVATE;
@@ -44,4 +51,22 @@ struct wlr_export_dmabuf_frame_v1 {
 struct wlr_export_dmabuf_manager_v1 *wlr_export_dmabuf_manager_v1_create(
 	struct wl_display *display);
 
+/**
+ * Set the maximum number of exported buffers held per output.
+ *
+ * By default, exported buffers are transient: the compositor may render into
+ * them again as soon as the frame is ready, so clients need to copy them
+ * before the next output commit. Held buffers are instead kept out of the
+ * output's swapchain until the client destroys the frame, allowing e.g.
+ * hardware encoders to consume them asynchronously without a copy. The
+ * rendering fence of the output commit, if any, is attached to held buffers
+ * so that importers implicitly wait for rendering to finish.
+ *
+ * Each held buffer stays allocated on top of the output's swapchain, so this
+ * should be kept small. Once the limit is reached, buffers are exported as
+ * transient again. Defaults to 0.
+ */
+void wlr_export_dmabuf_manager_v1_set_max_held_buffers(
+	struct wlr_export_dmabuf_manager_v1 *manager, size_t max);
+
 #endif
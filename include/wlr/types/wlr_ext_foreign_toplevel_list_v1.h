@@ -9,6 +9,8 @@
 #ifndef WLR_TYPES_WLR_FOREIGN_TOPLEVEL_LIST_V1_H
 #define WLR_TYPES_WLR_FOREIGN_TOPLEVEL_LIST_V1_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <wayland-server-core.h>
 
 struct wlr_ext_foreign_toplevel_list_v1 {
@@ -24,6 +26,8 @@ struct wlr_ext_foreign_toplevel_list_v1 {
 
 	struct {
 		struct wl_listener display_destroy;
+
+		struct wl_event_loop *event_loop;
 	} WLR_PRIVATE;
 };
 
@@ -41,6 +45,14 @@ struct wlr_ext_foreign_toplevel_handle_v1 {
 	} events;
 
 	void *data;
+
+	struct {
+		uint32_t title_max_rate;
+		int64_t title_sent_msec;
+		struct wl_event_source *title_timer;
+		// Whether the title has changed but hasn't been sent yet
+		bool title_pending;
+	} WLR_PRIVATE;
 };
 
 struct wlr_ext_foreign_toplevel_handle_v1_state {
@@ -66,6 +78,14 @@ void wlr_ext_foreign_toplevel_handle_v1_update_state(
 	struct wlr_ext_foreign_toplevel_handle_v1 *toplevel,
 	const struct wlr_ext_foreign_toplevel_handle_v1_state *state);
 
+/**
+ * Send at most max_rate title updates per second to clients. Titles set in
+ * between are coalesced and only the latest one is sent. Zero disables the
+ * limit, which is the default.
+ */
+void wlr_ext_foreign_toplevel_handle_v1_set_title_rate_limit(
+	struct wlr_ext_foreign_toplevel_handle_v1 *toplevel, uint32_t max_rate);
+
 struct wlr_ext_foreign_toplevel_handle_v1 *wlr_ext_foreign_toplevel_handle_v1_from_resource(
 	struct wl_resource *resource);
 
@@ -0,0 +1,96 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_EXT_IMAGE_CAPTURE_SOURCE_V1_H
+#define WLR_TYPES_WLR_EXT_IMAGE_CAPTURE_SOURCE_V1_H
+
+#include <pixman.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <wayland-server-core.h>
+#include <wlr/render/drm_format_set.h>
+
+struct wlr_ext_image_capture_source_v1_interface;
+
+/**
+ * A source of images which can be captured by clients, for instance an
+ * output.
+ *
+ * Sources are implemented by compositors or by wlroots helpers. Capture
+ * sessions read the buffer constraints (size and formats) set by the
+ * implementation and emit the events.frame signal whenever new content is
+ * available.
+ */
+struct wlr_ext_image_capture_source_v1 {
+	const struct wlr_ext_image_capture_source_v1_interface *impl;
+	struct wl_list resources; // wl_resource_get_link()
+
+	uint32_t width, height;
+
+	uint32_t *shm_formats;
+	size_t shm_formats_len;
+
+	dev_t dmabuf_device;
+	struct wlr_drm_format_set dmabuf_formats;
+
+	struct {
+		struct wl_signal constraints_update;
+		struct wl_signal frame; // struct wlr_ext_image_capture_source_v1_frame_event
+		struct wl_signal destroy;
+	} events;
+};
+
+/**
+ * Event emitted when a source has new content.
+ */
+struct wlr_ext_image_capture_source_v1_frame_event {
+	const pixman_region32_t *damage; // buffer-local coordinates
+};
+
+/**
+ * The cursor of a seat on a source. The cursor image is a source of its own,
+ * sized after the current cursor image.
+ */
+struct wlr_ext_image_capture_source_v1_cursor {
+	struct wlr_ext_image_capture_source_v1 base;
+
+	// Whether the cursor is displayed on the source
+	bool entered;
+	// Position of the hotspot in the source, buffer-local coordinates
+	int32_t x, y;
+	struct {
+		int32_t x, y;
+	} hotspot;
+
+	struct {
+		struct wl_signal update;
+	} events;
+};
+
+/**
+ * Interface exposing one image capture source per output.
+ */
+struct wlr_ext_output_image_capture_source_manager_v1 {
+	struct wl_global *global;
+
+	struct {
+		struct wl_listener display_destroy;
+	} WLR_PRIVATE;
+};
+
+/**
+ * Get the source of an ext_image_capture_source_v1 resource. Returns NULL if
+ * the source has been destroyed.
+ */
+struct wlr_ext_image_capture_source_v1 *wlr_ext_image_capture_source_v1_from_resource(
+	struct wl_resource *resource);
+
+struct wlr_ext_output_image_capture_source_manager_v1 *wlr_ext_output_image_capture_source_manager_v1_create(
+	struct wl_display *display, uint32_t version);
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_EXT_IMAGE_COPY_CAPTURE_V1_H
+#define WLR_TYPES_WLR_EXT_IMAGE_COPY_CAPTURE_V1_H
+
+#include <pixman.h>
+#include <stdbool.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+#include "ext-image-copy-capture-v1-protocol.h"
+
+struct wlr_buffer;
+struct wlr_renderer;
+struct wlr_texture;
+
+/**
+ * Implementation of the ext-image-copy-capture-v1 protocol.
+ *
+ * Capture sessions are long-lived: the buffer constraints are only sent again
+ * when the source changes, and buffers reused by clients are validated once
+ * per session. Frames only copy the regions damaged since the buffer was last
+ * captured.
+ */
+struct wlr_ext_image_copy_capture_manager_v1 {
+	struct wl_global *global;
+
+	struct {
+		struct wl_listener display_destroy;
+	} WLR_PRIVATE;
+};
+
+struct wlr_ext_image_copy_capture_frame_v1 {
+	struct wl_resource *resource;
+	bool capturing;
+	struct wlr_buffer *buffer;
+	// Damage requested by the client, buffer-local coordinates
+	pixman_region32_t buffer_damage;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	struct {
+		struct wlr_ext_image_copy_capture_session_v1 *session;
+	} WLR_PRIVATE;
+};
+
+struct wlr_ext_image_copy_capture_manager_v1 *wlr_ext_image_copy_capture_manager_v1_create(
+	struct wl_display *display, uint32_t version);
+
+/**
+ * Notify the client that the frame is ready. This destroys the frame.
+ */
+void wlr_ext_image_copy_capture_frame_v1_ready(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+	enum wl_output_transform transform, const struct timespec *presentation_time);
+/**
+ * Notify the client that the frame has failed. This destroys the frame.
+ */
+void wlr_ext_image_copy_capture_frame_v1_fail(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+	enum ext_image_copy_capture_frame_v1_failure_reason reason);
+/**
+ * Copy a buffer to the frame's buffer. Only the region damaged since the
+ * frame's buffer was last captured is copied.
+ */
+bool wlr_ext_image_copy_capture_frame_v1_copy_buffer(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+	struct wlr_buffer *src, struct wlr_renderer *renderer);
+
+#endif
@@ -26,6 +26,9 @@ struct wlr_foreign_toplevel_manager_v1 {
 
 	struct {
 		struct wl_listener display_destroy;
+
+		struct wl_event_source *idle_source;
+		struct wl_list dirty_toplevels; // wlr_foreign_toplevel_handle_v1.dirty_link
 	} WLR_PRIVATE;
 };
 
@@ -51,7 +54,6 @@ struct wlr_foreign_toplevel_handle_v1 {
 	struct wlr_foreign_toplevel_manager_v1 *manager;
 	struct wl_list resources;
 	struct wl_list link;
-	struct wl_event_source *idle_source;
 
 	char *title;
 	char *app_id;
@@ -76,6 +78,22 @@ struct wlr_foreign_toplevel_handle_v1 {
 	} events;
 
 	void *data;
+
+	struct {
+		struct wl_list dirty_link; // wlr_foreign_toplevel_manager_v1.dirty_toplevels
+
+		// Last values sent to the clients
+		char *sent_title;
+		char *sent_app_id;
+		uint32_t sent_state;
+
+		// Whether events not tracked above have been sent since the last done
+		bool needs_done;
+
+		uint32_t title_max_rate;
+		int64_t title_sent_msec;
+		struct wl_event_source *title_timer;
+	} WLR_PRIVATE;
 };
 
 struct wlr_foreign_toplevel_handle_v1_maximized_event {
@@ -125,6 +143,13 @@ void wlr_foreign_toplevel_handle_v1_set_title(
 	struct wlr_foreign_toplevel_handle_v1 *toplevel, const char *title);
 void wlr_foreign_toplevel_handle_v1_set_app_id(
 	struct wlr_foreign_toplevel_handle_v1 *toplevel, const char *app_id);
+/**
+ * Send at most max_rate title updates per second to clients. Titles set in
+ * between are coalesced and only the latest one is sent. Zero disables the
+ * limit, which is the default.
+ */
+void wlr_foreign_toplevel_handle_v1_set_title_rate_limit(
+	struct wlr_foreign_toplevel_handle_v1 *toplevel, uint32_t max_rate);
 
 void wlr_foreign_toplevel_handle_v1_output_enter(
 	struct wlr_foreign_toplevel_handle_v1 *toplevel, struct wlr_output *output);
@@ -21,7 +21,8 @@ struct wlr_idle_notifier_v1 {
 
 	struct {
 		bool inhibited;
-		struct wl_list notifications; // wlr_idle_notification_v1.link
+		struct wl_list seats; // wlr_idle_notifier_v1_seat.link
+		struct wl_event_loop *event_loop;
 
 		struct wl_listener display_destroy;
 	} WLR_PRIVATE;
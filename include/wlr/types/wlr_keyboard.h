@@ -40,6 +40,7 @@ enum wlr_keyboard_modifier {
 #define WLR_KEYBOARD_KEYS_CAP 32
 
 struct wlr_keyboard_impl;
+struct wlr_keyboard_keymap_file;
 
 struct wlr_keyboard_modifiers {
 	xkb_mod_mask_t depressed;
@@ -93,6 +94,11 @@ struct wlr_keyboard {
 	} events;
 
 	void *data;
+
+	struct {
+		// Shared with other keyboards using the same keymap
+		struct wlr_keyboard_keymap_file *keymap_file;
+	} WLR_PRIVATE;
 };
 
 struct wlr_keyboard_key_event {
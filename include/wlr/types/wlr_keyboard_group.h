@@ -15,7 +15,7 @@
 struct wlr_keyboard_group {
 	struct wlr_keyboard keyboard;
 	struct wl_list devices; // keyboard_group_device.link
-	struct wl_list keys; // keyboard_group_key.link
+	struct wl_list keys; // keyboard_group_key.link, for keycodes >= KEY_CNT
 
 	struct {
 		/**
@@ -41,6 +41,11 @@ struct wlr_keyboard_group {
 	} events;
 
 	void *data;
+
+	struct {
+		// Number of devices pressing each keycode, KEY_CNT entries
+		uint16_t *key_counts;
+	} WLR_PRIVATE;
 };
 
 struct wlr_keyboard_group *wlr_keyboard_group_create(void);
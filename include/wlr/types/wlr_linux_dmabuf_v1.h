@@ -26,6 +26,9 @@ struct wlr_dmabuf_v1_buffer {
 
 	struct {
 		struct wl_listener release;
+
+		// DMA-BUFs already checked by the default check callback
+		struct wlr_linux_dmabuf_v1_checked_dmabuf *checked[WLR_DMABUF_MAX_PLANES];
 	} WLR_PRIVATE;
 };
 
@@ -59,8 +62,12 @@ struct wlr_linux_dmabuf_v1 {
 		struct wlr_linux_dmabuf_feedback_v1_compiled *default_feedback;
 		struct wlr_drm_format_set default_formats; // for legacy clients
 		struct wl_list surfaces; // wlr_linux_dmabuf_v1_surface.link
+		// Compiled feedbacks, shared by all surfaces with the same feedback
+		struct wl_list compiled_feedbacks; // wlr_linux_dmabuf_feedback_v1_compiled.link
 
 		int main_device_fd; // to sanity check FDs sent by clients, -1 if unavailable
+		// DMA-BUFs imported into main_device_fd and referenced by a buffer
+		struct wl_list checked_dmabufs; // wlr_linux_dmabuf_v1_checked_dmabuf.link
 
 		struct wl_listener display_destroy;
 
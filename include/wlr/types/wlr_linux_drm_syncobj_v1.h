@@ -28,6 +28,7 @@ struct wlr_linux_drm_syncobj_manager_v1 {
 
 	struct {
 		int drm_fd;
+		bool latch_signaled;
 
 		struct wl_listener display_destroy;
 	} WLR_PRIVATE;
@@ -43,6 +44,20 @@ struct wlr_linux_drm_syncobj_manager_v1 {
 struct wlr_linux_drm_syncobj_manager_v1 *wlr_linux_drm_syncobj_manager_v1_create(
 	struct wl_display *display, uint32_t version, int drm_fd);
 
+/**
+ * Only apply surface commits once their acquire point is signaled.
+ *
+ * By default, a commit is applied as soon as its acquire fence is available,
+ * and the renderer or the backend waits for the fence before using the
+ * buffer. A client whose GPU work runs late can then delay the whole output
+ * frame. With this option, the commit stays pending until the fence is
+ * signaled and the previous buffer is kept on screen in the meantime.
+ *
+ * This only affects surfaces created after the call.
+ */
+void wlr_linux_drm_syncobj_manager_v1_set_latch_signaled(
+	struct wlr_linux_drm_syncobj_manager_v1 *manager, bool latch_signaled);
+
 struct wlr_linux_drm_syncobj_surface_v1_state *wlr_linux_drm_syncobj_v1_get_surface_state(
 	struct wlr_surface *surface);
 
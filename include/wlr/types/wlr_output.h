@@ -52,6 +52,18 @@ struct wlr_output_cursor {
 
 	struct {
 		struct wl_listener renderer_destroy;
+		// Incremented each time the cursor image is set
+		uint32_t image_seq;
+
+		// Image drawn below the cursor image, e.g. a drag-and-drop icon
+		struct {
+			struct wlr_texture *texture; // NULL if unset, not owned
+			struct wlr_fbox src_box;
+			enum wl_output_transform transform;
+			// Relative to the cursor position, in output buffer pixels
+			int x, y;
+			int width, height;
+		} attachment;
 	} WLR_PRIVATE;
 };
 
@@ -112,7 +124,11 @@ struct wlr_output_state {
 	 * display a part of the previous buffer and a part of the current buffer at
 	 * the same time. The backend may reject the commit if a tearing page-flip
 	 * cannot be performed, in which case the caller should fall back to a
-	 * regular page-flip at the next wlr_output.frame event. */
+	 * regular page-flip at the next wlr_output.frame event.
+	 *
+	 * The DRM backend accepts tearing commits which only change the buffer
+	 * while a page-flip is pending: the buffer is flipped as soon as the
+	 * pending page-flip completes, unless it's replaced by a newer one. */
 	bool tearing_page_flip;
 
 	enum wlr_output_state_mode_type mode_type;
@@ -137,6 +153,39 @@ struct wlr_output_state {
 struct wlr_output_impl;
 struct wlr_render_pass;
 
+#define WLR_OUTPUT_FRAME_HISTOGRAM_BUCKETS 64
+#define WLR_OUTPUT_FRAME_HISTOGRAM_BUCKET_NS 500000
+
+/**
+ * A histogram of frame durations. Bucket i counts the samples between
+ * i * WLR_OUTPUT_FRAME_HISTOGRAM_BUCKET_NS (inclusive) and
+ * (i + 1) * WLR_OUTPUT_FRAME_HISTOGRAM_BUCKET_NS (exclusive). The last bucket
+ * also counts all longer samples.
+ */
+struct wlr_output_frame_histogram {
+	uint64_t buckets[WLR_OUTPUT_FRAME_HISTOGRAM_BUCKETS];
+	uint64_t count;
+	int64_t sum_ns, max_ns;
+};
+
+/**
+ * Frame pacing statistics of an output, accumulated since the output was
+ * created or since the last wlr_output_reset_frame_stats() call.
+ */
+struct wlr_output_frame_stats {
+	// Time between a buffer commit and its presentation
+	struct wlr_output_frame_histogram commit_to_present;
+	// Rendering time reported with wlr_output_add_render_duration()
+	struct wlr_output_frame_histogram render;
+
+	uint64_t presented, discarded;
+	// Refresh cycles elapsed between a commit and its presentation, beyond
+	// the first one. Only counted for vsynced presentations.
+	uint64_t missed_vblanks;
+	// Presented frames scanned out directly from a client buffer
+	uint64_t zero_copy;
+};
+
 /**
  * A compositor output region. This typically corresponds to a monitor that
  * displays part of the compositor space.
@@ -235,6 +284,29 @@ struct wlr_output {
 
 	struct {
 		struct wl_listener display_destroy;
+
+		// Cursor images known not to change, most recently used first
+		struct wl_list cursor_cache; // output_cursor_cache_entry.link
+		struct wl_listener cursor_cache_renderer_destroy;
+
+		struct wlr_output_frame_stats frame_stats;
+		// Buffer commits waiting for their present event
+		struct {
+			uint32_t seq;
+			int64_t when_ns;
+		} frame_stats_commits[4];
+		size_t frame_stats_next_commit;
+
+		struct wlr_output *frame_leader;
+		// Whether the backend is ready for a new frame, which is held back
+		// until the frame leader is presented
+		bool frame_follower_waiting;
+		struct wl_listener frame_leader_present;
+		struct wl_listener frame_leader_destroy;
+
+		// Emitted when a cursor's image, position or visibility changes, or
+		// when a cursor is destroyed
+		struct wl_signal cursor_update;
 	} WLR_PRIVATE;
 };
 
@@ -370,6 +442,18 @@ bool wlr_output_commit_state(struct wlr_output *output,
  * it is a no-op.
  */
 void wlr_output_schedule_frame(struct wlr_output *output);
+/**
+ * Drive the frame events of an output with the presentations of another
+ * output, e.g. to mirror a DRM output onto a headless output at the same
+ * cadence. Pass NULL to restore the output's own frame clock.
+ *
+ * While the leader has a frame in flight, frame events of the output are held
+ * back until the leader's frame is presented. The output still waits for its
+ * own backend to be ready, so it never runs faster than its own refresh rate.
+ * Outputs following a leader can't be a leader themselves.
+ */
+void wlr_output_set_frame_leader(struct wlr_output *output,
+	struct wlr_output *leader);
 /**
  * Returns the maximum length of each gamma ramp, or 0 if unsupported.
  */
@@ -419,6 +503,31 @@ const struct wlr_drm_format_set *wlr_output_get_primary_formats(
  * during screen capture.
  */
 bool wlr_output_is_direct_scanout_allowed(struct wlr_output *output);
+/**
+ * Get the frame pacing statistics of the output.
+ *
+ * Compositors exporting the statistics periodically can call
+ * wlr_output_reset_frame_stats() after each read, so that each sample only
+ * covers the frames since the previous one.
+ */
+const struct wlr_output_frame_stats *wlr_output_get_frame_stats(
+	struct wlr_output *output);
+void wlr_output_reset_frame_stats(struct wlr_output *output);
+/**
+ * Record the rendering time of a frame, including GPU work, e.g. measured
+ * with a struct wlr_render_timer. The scene-graph API does this automatically
+ * when rendering with a struct wlr_scene_timer.
+ */
+void wlr_output_add_render_duration(struct wlr_output *output,
+	int64_t duration_ns);
+/**
+ * Get an estimate of the duration below which the given fraction of samples
+ * of the histogram fall, e.g. 0.99 for the 99th percentile. The estimate is
+ * the upper bound of the matching bucket. Returns -1 if the histogram is
+ * empty.
+ */
+int64_t wlr_output_frame_histogram_get_percentile(
+	const struct wlr_output_frame_histogram *histogram, double fraction);
 
 
 struct wlr_output_cursor *wlr_output_cursor_create(struct wlr_output *output);
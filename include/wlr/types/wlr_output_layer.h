@@ -71,6 +71,9 @@ struct wlr_output_layer_state {
 	// Damaged region since last commit in buffer-local coordinates. Leave NULL
 	// to damage the whole buffer.
 	const pixman_region32_t *damage;
+	// Opacity between 0 and 1 the premultiplied buffer is blended with.
+	// Leave NULL for a fully opaque layer.
+	const float *alpha;
 
 	// Populated by the backend after wlr_output_test_state() and
 	// wlr_output_commit_state(), indicates whether the backend has acknowledged
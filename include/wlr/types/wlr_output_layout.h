@@ -38,6 +38,14 @@ struct wlr_output_layout {
 
 	struct {
 		struct wl_listener display_destroy;
+
+		// Spatial index of the outputs, rebuilt when the layout changes. The
+		// layout is split into a grid along the output edges, each cell
+		// pointing to the first output covering it.
+		bool index_valid;
+		int *index_x, *index_y; // sorted edges
+		size_t index_x_len, index_y_len;
+		struct wlr_output_layout_output **index_cells;
 	} WLR_PRIVATE;
 };
 
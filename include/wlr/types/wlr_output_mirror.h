@@ -0,0 +1,61 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_OUTPUT_MIRROR_H
+#define WLR_TYPES_WLR_OUTPUT_MIRROR_H
+
+#include <stdbool.h>
+#include <wayland-server-core.h>
+
+struct wlr_buffer;
+struct wlr_output;
+
+/**
+ * Displays the frames committed on a source output on a destination output,
+ * without rendering the scene a second time.
+ *
+ * Each buffer committed on the source output is scanned out directly on the
+ * destination output if the backend accepts it (same size and a compatible
+ * format). Otherwise it is copied with a single scaled blit, keeping its
+ * aspect ratio. The destination output's frame events are driven by the
+ * source output (see wlr_output_set_frame_leader()).
+ *
+ * While the mirror exists, the mirror commits the destination output:
+ * compositors must not render or commit buffers on it themselves. Hardware
+ * cursors and output layers of the source output are not mirrored.
+ *
+ * The mirror is destroyed with either output.
+ */
+struct wlr_output_mirror {
+	struct wlr_output *src, *dst;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	struct {
+		// Last buffer committed on the source output, not displayed yet
+		struct wlr_buffer *pending_buffer;
+
+		struct wl_listener src_commit;
+		struct wl_listener src_destroy;
+		struct wl_listener dst_frame;
+		struct wl_listener dst_destroy;
+	} WLR_PRIVATE;
+};
+
+/**
+ * Start mirroring the source output onto the destination output. The
+ * destination output must have been set up for rendering with
+ * wlr_output_init_render().
+ */
+struct wlr_output_mirror *wlr_output_mirror_create(struct wlr_output *src,
+	struct wlr_output *dst);
+void wlr_output_mirror_destroy(struct wlr_output_mirror *mirror);
+
+#endif
@@ -57,6 +57,10 @@ void wlr_output_swapchain_manager_init(struct wlr_output_swapchain_manager *mana
  * find a working configuration, even if an output state is unchanged by the
  * compositor. This function might re-create swapchains for already-enabled
  * outputs.
+ *
+ * Test results are remembered for each combination of output, mode and render
+ * format: configurations rejected by the backend are rejected again without
+ * any test commit, and the modifiers which worked are tried first.
  */
 bool wlr_output_swapchain_manager_prepare(struct wlr_output_swapchain_manager *manager,
 	const struct wlr_backend_output_state *states, size_t states_len);
@@ -15,6 +15,7 @@
 #include <wayland-server-core.h>
 
 struct wlr_surface;
+struct wlr_presentation_surface;
 
 struct wlr_output;
 struct wlr_output_event_present;
@@ -42,9 +43,11 @@ struct wlr_presentation_feedback {
 	bool zero_copy;
 
 	struct {
-		struct wl_listener output_commit;
-		struct wl_listener output_present;
-		struct wl_listener output_destroy;
+		struct wl_list output_link; // presentation_output.feedbacks
+
+		// Surface to give the feedback back to for re-use, may be NULL
+		struct wlr_presentation_surface *surface;
+		struct wl_list surface_link; // wlr_presentation_surface.feedbacks
 	} WLR_PRIVATE;
 };
 
@@ -28,22 +28,33 @@
 #include <wlr/util/addon.h>
 #include <wlr/util/box.h>
 
+struct wlr_backend;
 struct wlr_output;
 struct wlr_output_layout;
 struct wlr_output_layout_output;
 struct wlr_xdg_surface;
 struct wlr_layer_surface_v1;
 struct wlr_drag_icon;
+struct wlr_session_lock_v1;
 struct wlr_surface;
 
 struct wlr_scene_node;
 struct wlr_scene_buffer;
 struct wlr_scene_output_layout;
+struct wlr_scene_tree_cache;
+struct wlr_scene_tree_capture;
+struct wlr_texture_atlas;
+struct wlr_texture_atlas_entry;
 
 struct wlr_presentation;
 struct wlr_linux_dmabuf_v1;
 struct wlr_gamma_control_manager_v1;
+struct wlr_content_type_manager_v1;
+struct wlr_color_transform;
 struct wlr_output_state;
+struct wlr_swapchain;
+struct rect_union;
+struct thread_pool;
 
 typedef bool (*wlr_scene_buffer_point_accepts_input_func_t)(
 	struct wlr_scene_buffer *buffer, double *sx, double *sy);
@@ -77,13 +88,24 @@ struct wlr_scene_node {
 
 	struct {
 		pixman_region32_t visible;
+
+		// Cached opaque region, relative to the node
+		pixman_region32_t opaque;
+		bool opaque_valid;
+
+		// Part of the parent's bounds accounted for this node, relative to
+		// the parent, empty if disabled
+		struct wlr_box parent_bounds;
+
+		bool pooled; // allocated from the scene's node pools
 	} WLR_PRIVATE;
 };
 
 enum wlr_scene_debug_damage_option {
 	WLR_SCENE_DEBUG_DAMAGE_NONE,
 	WLR_SCENE_DEBUG_DAMAGE_RERENDER,
-	WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT
+	WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT,
+	WLR_SCENE_DEBUG_DAMAGE_OVERDRAW,
 };
 
 /** A sub-tree in the scene-graph. */
@@ -91,6 +113,14 @@ struct wlr_scene_tree {
 	struct wlr_scene_node node;
 
 	struct wl_list children; // wlr_scene_node.link
+
+	struct {
+		// Bounding box of all enabled descendants, relative to the tree
+		struct wlr_box bounds;
+		// Offscreen copy of the rendered sub-tree, may be NULL
+		struct wlr_scene_tree_cache *cache;
+		struct wl_list captures; // wlr_scene_tree_capture.link
+	} WLR_PRIVATE;
 };
 
 /** The root scene-graph node. */
@@ -102,16 +132,52 @@ struct wlr_scene {
 	// May be NULL
 	struct wlr_linux_dmabuf_v1 *linux_dmabuf_v1;
 	struct wlr_gamma_control_manager_v1 *gamma_control_manager_v1;
+	struct wlr_content_type_manager_v1 *content_type_manager_v1;
 
 	struct {
 		struct wl_listener linux_dmabuf_v1_destroy;
 		struct wl_listener gamma_control_manager_v1_destroy;
 		struct wl_listener gamma_control_manager_v1_set_gamma;
+		struct wl_listener content_type_manager_v1_destroy;
 
 		enum wlr_scene_debug_damage_option debug_damage_option;
 		bool direct_scanout;
 		bool calculate_visibility;
 		bool highlight_transparent_region;
+		bool output_layers;
+		bool texture_atlas;
+		int hidden_frame_interval_ms;
+		bool render_cost_tracking;
+
+		size_t texture_budget;
+		struct timespec texture_eviction_time;
+
+		// Allocators for nodes, NULL unless node pooling has been enabled
+		struct wlr_scene_node_pools *node_pools;
+		bool node_pooling;
+
+		// Buffers with output changes not signalled yet
+		struct wl_list outputs_update_queue; // wlr_scene_buffer.outputs_update_link
+
+		// Workers for wlr_scene_prepare_render_lists(), created on first use
+		struct thread_pool *render_list_pool;
+		bool render_list_pool_failed;
+
+		// Shared texture for small buffers, may be NULL
+		struct wlr_texture_atlas *atlas;
+		struct wl_listener atlas_renderer_destroy;
+
+		// Result of the last wlr_scene_node_at() call, along with a box in
+		// layout coordinates where it holds
+		struct {
+			bool valid;
+			struct wlr_scene_node *root, *node;
+			// point_accepts_input of the node when it was cached
+			wlr_scene_buffer_point_accepts_input_func_t point_accepts_input;
+			struct wlr_box box;
+			// Subtracted from the point to get the node-local coordinates
+			double offset_x, offset_y;
+		} node_at_cache;
 	} WLR_PRIVATE;
 };
 
@@ -123,6 +189,9 @@ struct wlr_scene_surface {
 	struct {
 		struct wlr_box clip;
 
+		// Buffer size when the geometry was last computed, zero if unmapped
+		int buffer_width, buffer_height;
+
 		struct wlr_addon addon;
 
 		struct wl_listener outputs_update;
@@ -152,6 +221,17 @@ struct wlr_scene_output_sample_event {
 	bool direct_scanout;
 };
 
+/**
+ * Accumulated rendering cost of a buffer node, see
+ * wlr_scene_set_render_cost_tracking().
+ */
+struct wlr_scene_buffer_render_cost {
+	uint64_t draws; // times the buffer was composited
+	uint64_t dst_pixels; // render buffer pixels written
+	uint64_t src_texels; // buffer texels sampled
+	uint64_t scaled_pixels; // pixels written with the buffer scaled
+};
+
 /** A scene-graph node displaying a buffer */
 struct wlr_scene_buffer {
 	struct wlr_scene_node node;
@@ -159,6 +239,7 @@ struct wlr_scene_buffer {
 	// May be NULL
 	struct wlr_buffer *buffer;
 
+	// Output changes are coalesced and signalled before the next output frame
 	struct {
 		struct wl_signal outputs_update; // struct wlr_scene_outputs_update_event
 		struct wl_signal output_enter; // struct wlr_scene_output
@@ -167,7 +248,11 @@ struct wlr_scene_buffer {
 		struct wl_signal frame_done; // struct timespec
 	} events;
 
-	// May be NULL
+	/**
+	 * May be NULL. wlr_scene_node_at() results are only cached for buffers
+	 * without a callback and for surfaces using the default one: custom
+	 * callbacks are called on every lookup.
+	 */
 	wlr_scene_buffer_point_accepts_input_func_t point_accepts_input;
 
 	/**
@@ -187,6 +272,12 @@ struct wlr_scene_buffer {
 
 	struct {
 		uint64_t active_outputs;
+		// Outputs last signalled via output_enter, output_leave and
+		// outputs_update
+		uint64_t sent_active_outputs;
+		struct wlr_scene_output *sent_primary_output;
+		struct wl_list outputs_update_link; // wlr_scene.outputs_update_queue
+
 		struct wlr_texture *texture;
 		struct wlr_linux_dmabuf_feedback_v1_init_options prev_feedback_options;
 
@@ -199,6 +290,21 @@ struct wlr_scene_buffer {
 
 		struct wl_listener buffer_release;
 		struct wl_listener renderer_destroy;
+
+		// Set instead of texture when the buffer is stored in the atlas
+		struct wlr_texture_atlas_entry *atlas_entry;
+
+		// Last time a frame_done event was sent while the buffer was hidden
+		struct timespec last_hidden_frame_done;
+		// Last time the buffer was displayed on an output, only updated while
+		// a texture budget is set
+		struct timespec last_visible_time;
+
+		// Single-pixel buffers are rendered as rects, premultiplied color
+		bool is_single_pixel_buffer;
+		float single_pixel_buffer_color[4];
+
+		struct wlr_scene_buffer_render_cost render_cost;
 	} WLR_PRIVATE;
 };
 
@@ -219,23 +325,57 @@ struct wlr_scene_output {
 
 	struct {
 		pixman_region32_t pending_commit_damage;
+		// Damage not yet added to damage_ring and pending_commit_damage
+		struct rect_union *pending_damage;
 
 		uint8_t index;
 		bool prev_scanout;
 
 		bool gamma_lut_changed;
 		struct wlr_gamma_control_v1 *gamma_lut;
+		// Color transform applied by the output's gamma LUT during direct
+		// scan-out, NULL if none
+		struct wlr_color_transform *gamma_color_transform;
+		// Gamma LUT rejected by the output, applied while rendering instead
+		struct wlr_color_transform *gamma_fallback;
 
 		struct wl_listener output_commit;
 		struct wl_listener output_damage;
 		struct wl_listener output_needs_frame;
 
 		struct wl_list damage_highlight_regions;
+		// Last time the overdraw debug summary was logged
+		struct timespec overdraw_summary_time;
 
 		struct wl_array render_list;
+		// Set when the structure of the scene changed since the render list
+		// was built (stacking, enabled state, position, size, visibility)
+		bool render_list_dirty;
+		struct wlr_box render_list_box;
+		bool render_list_fractional_scale;
+
+		struct wl_array layers; // struct wlr_output_layer_state
+		struct wl_array layer_nodes; // struct wlr_scene_node *
+		// Set when the backend rejected all layers for the current render list
+		bool layers_rejected;
 
 		struct wlr_drm_syncobj_timeline *in_timeline;
 		uint64_t in_point;
+
+		// Last composited frame, submitted again while the scene doesn't
+		// change. NULL once another buffer is committed.
+		struct wlr_buffer *last_frame;
+		struct wlr_swapchain *last_frame_swapchain;
+		struct wlr_color_transform *last_frame_color_transform;
+
+		// Content type of the surface covering most of the output,
+		// enum wp_content_type_v1_type
+		uint32_t content_type;
+		// Adaptive sync was enabled because of the content type
+		bool content_type_adaptive_sync;
+		// The output rejected the policy for the current content type
+		bool content_type_adaptive_sync_rejected;
+		bool content_type_tearing_rejected;
 	} WLR_PRIVATE;
 };
 
@@ -244,6 +384,70 @@ struct wlr_scene_timer {
 	struct wlr_render_timer *render_timer;
 };
 
+#define WLR_SCENE_FRAME_SCHEDULER_SAMPLES 8
+
+/**
+ * A group of scene outputs committed together.
+ *
+ * Instead of committing each output as soon as its frame event fires, the
+ * frame events of all outputs of the group received during the same event
+ * loop iteration are coalesced, and the outputs are rendered and committed
+ * with a single wlr_backend_commit() call. The DRM backend applies outputs of
+ * the same device in a single atomic commit, which only needs one ioctl per
+ * refresh cycle and keeps outputs with the same timings in phase.
+ */
+struct wlr_scene_commit_group {
+	struct wlr_backend *backend;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	struct {
+		struct wl_list outputs; // wlr_scene_commit_group_output.link
+		struct wl_event_source *idle;
+	} WLR_PRIVATE;
+};
+
+/**
+ * A frame scheduler which delays the composition of a scene output until
+ * shortly before the predicted deadline of the next output refresh.
+ *
+ * The render time is predicted from wlr_scene_timer measurements of the
+ * previous frames, and the refresh cycle is tracked with output presentation
+ * events. This reduces the input-to-photon latency at the cost of a tighter
+ * rendering deadline.
+ */
+struct wlr_scene_frame_scheduler {
+	struct wlr_scene_output *scene_output;
+
+	// Time kept between the predicted end of rendering and the next refresh,
+	// in nanoseconds
+	int64_t margin_ns;
+
+	struct {
+		struct wl_signal frame; // struct wlr_scene_timer
+		struct wl_signal destroy;
+	} events;
+
+	struct {
+		struct wlr_scene_timer timer;
+
+		int64_t samples[WLR_SCENE_FRAME_SCHEDULER_SAMPLES];
+		size_t samples_len, next_sample;
+
+		int64_t last_present_ns;
+		int64_t refresh_ns;
+		bool vsync;
+
+		struct wl_event_source *delay_timer;
+
+		struct wl_listener output_frame;
+		struct wl_listener output_present;
+		struct wl_listener scene_output_destroy;
+	} WLR_PRIVATE;
+};
+
 /** A layer shell scene helper */
 struct wlr_scene_layer_surface_v1 {
 	struct wlr_scene_tree *tree;
@@ -254,6 +458,18 @@ struct wlr_scene_layer_surface_v1 {
 		struct wl_listener layer_surface_destroy;
 		struct wl_listener layer_surface_map;
 		struct wl_listener layer_surface_unmap;
+
+		// Inputs and results of the last wlr_scene_layer_surface_v1_configure()
+		struct {
+			bool valid;
+			bool mapped;
+			uint32_t anchor;
+			int32_t exclusive_zone;
+			int32_t margin_top, margin_right, margin_bottom, margin_left;
+			uint32_t desired_width, desired_height;
+			struct wlr_box full_area, usable_area;
+			struct wlr_box box, result_usable_area;
+		} arrange_cache;
 	} WLR_PRIVATE;
 };
 
@@ -342,11 +558,118 @@ void wlr_scene_set_linux_dmabuf_v1(struct wlr_scene *scene,
 void wlr_scene_set_gamma_control_manager_v1(struct wlr_scene *scene,
 	struct wlr_gamma_control_manager_v1 *gamma_control);
 
+/**
+ * Adapts the presentation of outputs to the content type of the surface
+ * covering most of them: games get adaptive sync and tearing page-flips
+ * during direct scan-out, videos get adaptive sync. Only applies the
+ * options which the output accepts and the compositor didn't set itself.
+ *
+ * Asserts that a struct wlr_content_type_manager_v1 hasn't already been set
+ * for the scene.
+ */
+void wlr_scene_set_content_type_manager_v1(struct wlr_scene *scene,
+	struct wlr_content_type_manager_v1 *content_type);
+
+/**
+ * Set the minimum interval between frame_done events of hidden buffers, in
+ * milliseconds.
+ *
+ * Buffers which are fully occluded or outside of all outputs don't get any
+ * frame_done events by default, which stops hidden clients from rendering.
+ * Some clients misbehave when they never get frame callbacks: with a
+ * positive interval, hidden buffers get a frame_done event at most once per
+ * interval from wlr_scene_output_send_frame_done(). Zero restores the
+ * default.
+ */
+void wlr_scene_set_hidden_frame_interval(struct wlr_scene *scene,
+	int interval_ms);
+
+/**
+ * Enable or disable accounting of the rendering cost of buffer nodes.
+ *
+ * When enabled, each composited buffer accumulates the number of pixels
+ * written, texels sampled and pixels written while scaling, which
+ * approximate its share of the GPU work of a frame. The counters can be
+ * read with wlr_scene_buffer_get_render_cost() and summed up per client via
+ * wlr_scene_surface_try_from_buffer().
+ */
+void wlr_scene_set_render_cost_tracking(struct wlr_scene *scene, bool enabled);
+
+/**
+ * Set a budget for the memory used by the textures of buffer nodes, in bytes.
+ *
+ * While the textures use more memory than the budget, the textures of
+ * buffers which haven't been displayed on any output for a few seconds are
+ * released, least recently displayed first, and uploaded again once the
+ * buffers are displayed. Only textures of buffers which are still available
+ * are released: such buffers are kept locked in the meantime. Zero disables
+ * the budget, which is the default.
+ */
+void wlr_scene_set_texture_budget(struct wlr_scene *scene, size_t budget);
+
+/**
+ * Allocate the nodes created from now on from pools owned by the scene,
+ * instead of allocating each node separately. Nodes created around the same
+ * time end up close to each other in memory, which speeds up traversals of
+ * large scenes. Disabled by default.
+ */
+void wlr_scene_set_node_pooling(struct wlr_scene *scene, bool enabled);
+
+/**
+ * Get an estimate of the memory used by the textures of buffer nodes, in
+ * bytes.
+ */
+size_t wlr_scene_get_texture_memory_usage(struct wlr_scene *scene);
+
 /**
  * Add a node displaying nothing but its children.
  */
 struct wlr_scene_tree *wlr_scene_tree_create(struct wlr_scene_tree *parent);
 
+/**
+ * Render the tree's sub-tree into an offscreen buffer and composite it as a
+ * single texture. The cached contents are only re-rendered where nodes inside
+ * the sub-tree are damaged, which is useful for groups of nodes which rarely
+ * change, such as decorations.
+ *
+ * The cache is rendered at the scale of the output being rendered: having
+ * the tree displayed on outputs with different scales will re-render it
+ * every frame.
+ */
+void wlr_scene_tree_set_cached(struct wlr_scene_tree *tree, bool cached);
+
+/**
+ * Create a capture of the tree's sub-tree, which renders it on demand into
+ * caller-supplied buffers, e.g. to share a single toplevel.
+ *
+ * The sub-tree is rendered on its own, regardless of the nodes above or
+ * below it and of whether the tree itself is enabled. Damage inside the
+ * sub-tree is tracked per capture buffer, so that repeated renders only
+ * re-render what changed since the buffer was last rendered.
+ *
+ * The capture is inert once the tree is destroyed.
+ */
+struct wlr_scene_tree_capture *wlr_scene_tree_capture_create(
+	struct wlr_scene_tree *tree);
+void wlr_scene_tree_capture_destroy(struct wlr_scene_tree_capture *capture);
+/**
+ * Get the buffer size needed to capture the whole sub-tree at the given
+ * scale. Returns false if the sub-tree is empty or the tree was destroyed.
+ */
+bool wlr_scene_tree_capture_get_size(struct wlr_scene_tree_capture *capture,
+	float scale, int *width, int *height);
+/**
+ * Render the sub-tree into a buffer at the given scale, with the top-left
+ * corner of the sub-tree's bounding box at the origin of the buffer. The
+ * renderer of the scene output is used.
+ *
+ * If damage is not NULL, it is set to the buffer-local region which has
+ * been re-rendered.
+ */
+bool wlr_scene_tree_capture_render(struct wlr_scene_tree_capture *capture,
+	struct wlr_scene_output *scene_output, struct wlr_buffer *buffer,
+	float scale, pixman_region32_t *damage);
+
 /**
  * Add a node displaying a single surface to the scene-graph.
  *
@@ -513,6 +836,14 @@ void wlr_scene_buffer_set_opacity(struct wlr_scene_buffer *scene_buffer,
 void wlr_scene_buffer_set_filter_mode(struct wlr_scene_buffer *scene_buffer,
 	enum wlr_scale_filter_mode filter_mode);
 
+/**
+ * Get the rendering cost accumulated since the buffer was created or since
+ * the last call to wlr_scene_buffer_reset_render_cost().
+ */
+void wlr_scene_buffer_get_render_cost(struct wlr_scene_buffer *scene_buffer,
+	struct wlr_scene_buffer_render_cost *cost);
+void wlr_scene_buffer_reset_render_cost(struct wlr_scene_buffer *scene_buffer);
+
 /**
  * Calls the buffer's frame_done signal.
  */
@@ -554,6 +885,18 @@ struct wlr_scene_output_state_options {
  */
 bool wlr_scene_output_needs_frame(struct wlr_scene_output *scene_output);
 
+/**
+ * Build the render lists of all enabled scene outputs from the current output
+ * state, in parallel on worker threads kept by the scene. Subsequent calls to
+ * wlr_scene_output_commit() and wlr_scene_output_build_state() re-use these
+ * lists if the scene and the output geometry haven't changed in the meantime.
+ *
+ * Compositors driving many outputs from the same scene can call this once
+ * before committing them. The function blocks until all lists are built;
+ * rendering itself is still performed by the commit functions.
+ */
+void wlr_scene_prepare_render_lists(struct wlr_scene *scene);
+
 /**
  * Render and commit an output.
  */
@@ -575,6 +918,56 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 int64_t wlr_scene_timer_get_duration_ns(struct wlr_scene_timer *timer);
 void wlr_scene_timer_finish(struct wlr_scene_timer *timer);
 
+/**
+ * Create a frame scheduler for a scene output.
+ *
+ * Compositors using the scheduler must listen to its frame event instead of
+ * wlr_output.events.frame. The frame event data is a struct wlr_scene_timer
+ * which must be passed as wlr_scene_output_state_options.timer when rendering
+ * the frame, e.g. with wlr_scene_output_commit(). Frame done events are sent
+ * by the scheduler right after the frame event, so that clients are throttled
+ * against the delayed composition: compositors must not call
+ * wlr_scene_output_send_frame_done() themselves.
+ *
+ * The scheduler is destroyed with the scene output.
+ */
+struct wlr_scene_frame_scheduler *wlr_scene_frame_scheduler_create(
+	struct wlr_scene_output *scene_output);
+/**
+ * Destroy a frame scheduler.
+ */
+void wlr_scene_frame_scheduler_destroy(struct wlr_scene_frame_scheduler *scheduler);
+
+/**
+ * Create a commit group. The backend is the one passed to wlr_backend_commit(),
+ * usually the compositor's root backend.
+ */
+struct wlr_scene_commit_group *wlr_scene_commit_group_create(
+	struct wlr_backend *backend);
+/**
+ * Destroy a commit group. Its outputs go back to not being rendered
+ * automatically.
+ */
+void wlr_scene_commit_group_destroy(struct wlr_scene_commit_group *group);
+/**
+ * Add a scene output to a commit group.
+ *
+ * The group renders the output with wlr_scene_output_build_state() and sends
+ * frame done events when the output frame event fires: compositors must stop
+ * rendering the output from their own frame listener. Outputs with different
+ * refresh timings gain nothing from sharing a group, since their frame events
+ * rarely fire during the same event loop iteration.
+ *
+ * The output is removed from the group when the scene output is destroyed.
+ */
+bool wlr_scene_commit_group_add_output(struct wlr_scene_commit_group *group,
+	struct wlr_scene_output *scene_output);
+/**
+ * Remove a scene output from a commit group.
+ */
+void wlr_scene_commit_group_remove_output(struct wlr_scene_commit_group *group,
+	struct wlr_scene_output *scene_output);
+
 /**
  * Call wlr_surface_send_frame_done() on all surfaces in the scene rendered by
  * wlr_scene_output_commit() for which wlr_scene_surface.primary_output
@@ -663,6 +1056,11 @@ struct wlr_scene_layer_surface_v1 *wlr_scene_layer_surface_v1_create(
  * usable_area represents what remains of full_area that can be used if
  * exclusive_zone is >= 0. usable_area is updated if the surface has a positive
  * exclusive_zone, so that it can be used for the next layer surface.
+ *
+ * If the surface's anchor, desired size, margin, exclusive zone, mapped state
+ * and the areas are unchanged since the last call, the previous result is
+ * reused and no configure event is sent, so this can be called for all layer
+ * surfaces of an output on every commit.
  */
 void wlr_scene_layer_surface_v1_configure(
 	struct wlr_scene_layer_surface_v1 *scene_layer_surface,
@@ -675,4 +1073,21 @@ void wlr_scene_layer_surface_v1_configure(
 struct wlr_scene_tree *wlr_scene_drag_icon_create(
 	struct wlr_scene_tree *parent, struct wlr_drag_icon *drag_icon);
 
+/**
+ * Add a node displaying the lock surfaces of a session lock, and hide all
+ * other content of the scene-graph while the session is locked.
+ *
+ * Each lock surface is placed at the position of its output's scene output.
+ * Every node which isn't an ancestor of the returned tree is disabled, so
+ * only lock surfaces are rendered (allowing direct scan-out) and other
+ * surfaces stop receiving frame events. Nodes created outside of the
+ * disabled trees after this call are not hidden.
+ *
+ * The tree is destroyed and the hidden nodes are re-enabled when the session
+ * is unlocked. If the lock is destroyed without unlocking, the content stays
+ * hidden until the compositor destroys the returned tree.
+ */
+struct wlr_scene_tree *wlr_scene_session_lock_v1_create(
+	struct wlr_scene_tree *parent, struct wlr_session_lock_v1 *lock);
+
 #endif
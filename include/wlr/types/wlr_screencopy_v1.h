@@ -10,10 +10,14 @@
 #define WLR_TYPES_WLR_SCREENCOPY_V1_H
 
 #include <stdbool.h>
+#include <time.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/util/box.h>
 
+struct wlr_screencopy_v1_readback;
+struct wlr_drm_writeback;
+
 struct wlr_screencopy_manager_v1 {
 	struct wl_global *global;
 	struct wl_list frames; // wlr_screencopy_frame_v1.link
@@ -25,6 +29,9 @@ struct wlr_screencopy_manager_v1 {
 	void *data;
 
 	struct {
+		// Output commits being captured, shared by all frames
+		struct wl_list captures; // screencopy_capture.link
+
 		struct wl_listener display_destroy;
 	} WLR_PRIVATE;
 };
@@ -59,6 +66,15 @@ struct wlr_screencopy_frame_v1 {
 		struct wl_listener output_commit;
 		struct wl_listener output_destroy;
 		struct wl_listener output_enable;
+
+		// Pending asynchronous shm copy, possibly shared with other frames
+		struct wlr_screencopy_v1_readback *readback;
+		struct wl_listener readback_ready;
+		struct timespec readback_when;
+
+		// Pending capture by a KMS writeback connector
+		struct wlr_drm_writeback *writeback;
+		struct wl_listener writeback_done;
 	} WLR_PRIVATE;
 };
 
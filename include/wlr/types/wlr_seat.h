@@ -54,6 +54,8 @@ struct wlr_seat_client {
 	// for use by wlr_seat_client_{next_serial,validate_event_serial}
 	struct wlr_serial_ringset serials;
 	bool needs_touch_frame;
+	// Whether events were sent since the last wl_pointer.frame
+	bool needs_pointer_frame;
 
 	// When the client doesn't support high-resolution scroll, accumulate deltas
 	// until we can notify a discrete event.
@@ -196,6 +198,8 @@ struct wlr_seat_pointer_state {
 	uint32_t grab_serial;
 	uint32_t grab_time;
 
+	// Number of events sent to wl_pointer resources, for profiling
+	uint64_t sent_events;
 
 	struct {
 		struct wl_signal focus_change; // struct wlr_seat_pointer_focus_change_event
@@ -238,6 +242,9 @@ struct wlr_seat_touch_state {
 
 	struct wlr_seat_touch_grab *grab;
 	struct wlr_seat_touch_grab *default_grab;
+
+	// Number of events sent to wl_touch resources, for profiling
+	uint64_t sent_events;
 };
 
 struct wlr_primary_selection_source;
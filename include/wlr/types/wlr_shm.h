@@ -10,6 +10,7 @@
 #define WLR_TYPES_WLR_SHM_H
 
 #include <wayland-server-core.h>
+#include <wlr/render/drm_format_set.h>
 
 struct wlr_renderer;
 
@@ -29,6 +30,10 @@ struct wlr_shm {
 		uint32_t *formats;
 		size_t formats_len;
 
+		// Used to wrap memfd-backed pools into DMA-BUFs, -1 if disabled
+		int udmabuf_fd;
+		struct wlr_drm_format_set udmabuf_formats;
+
 		struct wl_listener display_destroy;
 	} WLR_PRIVATE;
 };
@@ -9,7 +9,9 @@
 #ifndef WLR_TYPES_WLR_SINGLE_PIXEL_BUFFER_V1_H
 #define WLR_TYPES_WLR_SINGLE_PIXEL_BUFFER_V1_H
 
+#include <stdint.h>
 #include <wayland-server-core.h>
+#include <wlr/types/wlr_buffer.h>
 
 struct wlr_single_pixel_buffer_manager_v1 {
 	struct wl_global *global;
@@ -19,8 +21,28 @@ struct wlr_single_pixel_buffer_manager_v1 {
 	} WLR_PRIVATE;
 };
 
+struct wlr_single_pixel_buffer_v1 {
+	struct wlr_buffer base;
+
+	// Premultiplied color, full-scale for each component is UINT32_MAX
+	uint32_t r, g, b, a;
+
+	struct {
+		struct wl_resource *resource;
+		uint8_t argb8888[4]; // packed little-endian DRM_FORMAT_ARGB8888
+
+		struct wl_listener release;
+	} WLR_PRIVATE;
+};
 
 struct wlr_single_pixel_buffer_manager_v1 *wlr_single_pixel_buffer_manager_v1_create(
 	struct wl_display *display);
 
+/**
+ * Get the single-pixel buffer from a struct wlr_buffer. Returns NULL if the
+ * buffer hasn't been created via the single-pixel buffer protocol.
+ */
+struct wlr_single_pixel_buffer_v1 *wlr_single_pixel_buffer_v1_try_from_buffer(
+	struct wlr_buffer *buffer);
+
 #endif
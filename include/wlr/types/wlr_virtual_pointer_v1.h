@@ -37,6 +37,19 @@ struct wlr_virtual_pointer_v1 {
 	bool axis_valid[2];
 
 	struct wl_list link; // wlr_virtual_pointer_manager_v1.virtual_pointers
+
+	struct {
+		bool batching;
+		struct wl_event_source *idle_frame;
+
+		// Motion not delivered yet, at most one of them is pending
+		struct wlr_pointer_motion_event pending_motion;
+		bool motion_pending;
+		struct wlr_pointer_motion_absolute_event pending_motion_absolute;
+		bool motion_absolute_pending;
+		// Buttons were delivered since the last frame
+		bool needs_frame;
+	} WLR_PRIVATE;
 };
 
 struct wlr_virtual_pointer_v1_new_pointer_event {
@@ -49,4 +62,16 @@ struct wlr_virtual_pointer_v1_new_pointer_event {
 struct wlr_virtual_pointer_manager_v1* wlr_virtual_pointer_manager_v1_create(
 	struct wl_display *display);
 
+/**
+ * Enable or disable batching of the virtual pointer's events.
+ *
+ * When enabled, frames containing only motion are not delivered right away:
+ * relative motion is summed up, absolute motion replaces the previous
+ * position, and a single frame is delivered once the event loop goes idle,
+ * i.e. after all requests of the current client dispatch are processed.
+ * Frames with buttons or axis events flush the pending motion immediately.
+ */
+void wlr_virtual_pointer_v1_set_batching(struct wlr_virtual_pointer_v1 *pointer,
+	bool batching);
+
 #endif
@@ -14,11 +14,18 @@
 
 /**
  * An XCursor theme at a particular scale factor of the base size.
+ *
+ * Themes are shared by all managers using the same theme name at the same
+ * size: the theme must not be modified.
  */
 struct wlr_xcursor_manager_theme {
 	float scale;
 	struct wlr_xcursor_theme *theme;
 	struct wl_list link;
+
+	struct {
+		struct xcursor_shared_theme *shared;
+	} WLR_PRIVATE;
 };
 
 /**
@@ -114,6 +114,13 @@ struct wlr_xdg_popup {
 
 	struct {
 		struct wlr_surface_synced synced;
+
+		// Inputs and result of the last wlr_xdg_popup_unconstrain_from_box()
+		struct {
+			bool valid;
+			struct wlr_xdg_positioner_rules rules;
+			struct wlr_box constraint, box, result;
+		} unconstrain_cache;
 	} WLR_PRIVATE;
 };
 
@@ -316,6 +323,10 @@ struct wlr_xdg_surface {
 	struct {
 		struct wlr_surface_synced synced;
 
+		// Whether a scheduled configure is held back until the client
+		// catches up with the previous one
+		bool configure_throttled;
+
 		struct wl_listener role_resource_destroy;
 	} WLR_PRIVATE;
 };
@@ -392,6 +403,9 @@ uint32_t wlr_xdg_toplevel_configure(struct wlr_xdg_toplevel *toplevel,
 /**
  * Request that this toplevel surface be the given size. Returns the associated
  * configure serial.
+ *
+ * While the toplevel is resizing, new sizes are held back until the client has
+ * acked and committed the previous configure, and only the latest one is sent.
  */
 uint32_t wlr_xdg_toplevel_set_size(struct wlr_xdg_toplevel *toplevel,
 		int32_t width, int32_t height);
@@ -11,9 +11,14 @@
 
 #include <wayland-server-core.h>
 
+#define WLR_ADDON_SET_CACHE_LEN 8
+
 struct wlr_addon_set {
 	struct {
 		struct wl_list addons;
+		// Direct-mapped cache of recently found addons, indexed by a hash of
+		// their owner and interface
+		struct wlr_addon *cache[WLR_ADDON_SET_CACHE_LEN];
 	} WLR_PRIVATE;
 };
 
@@ -30,6 +35,7 @@ struct wlr_addon {
 
 	struct {
 		const void *owner;
+		struct wlr_addon_set *set;
 		struct wl_list link;
 	} WLR_PRIVATE;
 };
@@ -18,6 +18,8 @@
 
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 
@@ -43,6 +45,39 @@ typedef void (*wlr_log_func_t)(enum wlr_log_importance importance,
  */
 void wlr_log_init(enum wlr_log_importance verbosity, wlr_log_func_t callback);
 
+/**
+ * Set the log verbosity and use the default logger asynchronously.
+ *
+ * Messages are formatted by the calling thread into a bounded lock-free
+ * queue, and written to stderr by a background thread, so that a slow stderr
+ * doesn't stall the compositor. Logging never blocks: messages are dropped
+ * when the queue is full, and a message reporting the number of dropped
+ * messages is written once the queue drains.
+ *
+ * If history_len is non-zero, the last history_len messages written are kept
+ * in memory, see wlr_log_dump_history(). It is ignored if asynchronous
+ * logging was already enabled.
+ *
+ * Calling wlr_log_init() with a callback afterwards replaces the
+ * asynchronous logger. Remaining messages are written on exit.
+ *
+ * Returns false if the background thread couldn't be started, in which case
+ * the default synchronous logger is used.
+ */
+bool wlr_log_init_async(enum wlr_log_importance verbosity, size_t history_len);
+
+/**
+ * Get the total number of messages dropped by the asynchronous logger.
+ */
+uint64_t wlr_log_get_dropped_count(void);
+
+/**
+ * Write the messages kept by the asynchronous logger to a file descriptor,
+ * oldest first, e.g. from a crash handler. This doesn't take any lock, so
+ * messages being written concurrently may be garbled.
+ */
+void wlr_log_dump_history(int fd);
+
 /**
  * Get the current log verbosity configured by wlr_log_init().
  */
@@ -57,6 +92,23 @@ enum wlr_log_importance wlr_log_get_verbosity(void);
 void _wlr_log(enum wlr_log_importance verbosity, const char *format, ...) _WLR_ATTRIB_PRINTF(2, 3);
 void _wlr_vlog(enum wlr_log_importance verbosity, const char *format, va_list args) _WLR_ATTRIB_PRINTF(2, 0);
 
+// Verbosity configured by wlr_log_init(), for use by the macros below
+extern enum wlr_log_importance _wlr_log_importance;
+
+// Debug messages can be compiled out by defining WLR_LOG_DISABLE_DEBUG
+#ifdef WLR_LOG_DISABLE_DEBUG
+#define _WLR_LOG_MAX_IMPORTANCE WLR_INFO
+#else
+#define _WLR_LOG_MAX_IMPORTANCE WLR_DEBUG
+#endif
+
+/**
+ * Check whether messages of the given importance are logged. This is cheap,
+ * and constant-folded for messages compiled out.
+ */
+#define wlr_log_enabled(verb) \
+	((verb) <= _WLR_LOG_MAX_IMPORTANCE && (verb) <= _wlr_log_importance)
+
 #ifdef _WLR_REL_SRC_DIR
 // strip prefix from __FILE__, leaving the path relative to the project root
 #define _WLR_FILENAME ((const char *)__FILE__ + sizeof(_WLR_REL_SRC_DIR) - 1)
@@ -64,20 +116,34 @@ void _wlr_vlog(enum wlr_log_importance verbosity, const char *format, va_list ar
 #define _WLR_FILENAME __FILE__
 #endif
 
+// The logging macros only evaluate their arguments if the message is logged
+
 #define wlr_vlog(verb, fmt, args) \
-	_wlr_vlog(verb, "[%s:%d] " fmt, _WLR_FILENAME, __LINE__, args)
+	do { \
+		if (wlr_log_enabled(verb)) { \
+			_wlr_vlog(verb, "[%s:%d] " fmt, _WLR_FILENAME, __LINE__, args); \
+		} \
+	} while (0)
 
 #if __STDC_VERSION__ >= 202311L
 
 #define wlr_log(verb, fmt, ...) \
-	_wlr_log(verb, "[%s:%d] " fmt, _WLR_FILENAME, __LINE__ __VA_OPT__(,) __VA_ARGS__)
+	do { \
+		if (wlr_log_enabled(verb)) { \
+			_wlr_log(verb, "[%s:%d] " fmt, _WLR_FILENAME, __LINE__ __VA_OPT__(,) __VA_ARGS__); \
+		} \
+	} while (0)
 #define wlr_log_errno(verb, fmt, ...) \
 	wlr_log(verb, fmt ": %s" __VA_OPT__(,) __VA_ARGS__, strerror(errno))
 
 #else
 
 #define wlr_log(verb, fmt, ...) \
-	_wlr_log(verb, "[%s:%d] " fmt, _WLR_FILENAME, __LINE__, ##__VA_ARGS__)
+	do { \
+		if (wlr_log_enabled(verb)) { \
+			_wlr_log(verb, "[%s:%d] " fmt, _WLR_FILENAME, __LINE__, ##__VA_ARGS__); \
+		} \
+	} while (0)
 #define wlr_log_errno(verb, fmt, ...) \
 	wlr_log(verb, fmt ": %s", ##__VA_ARGS__, strerror(errno))
 
@@ -70,14 +70,26 @@ struct wlr_xcursor {
 	uint32_t total_delay; /* total duration of the animation in ms */
 };
 
+struct wlr_xcursor_theme_entry;
+
 /**
  * Container for an Xcursor theme.
+ *
+ * Cursor files are indexed when the theme is loaded, but only decoded the
+ * first time they are requested with wlr_xcursor_theme_get_cursor(): the
+ * cursors array only contains the cursors loaded so far.
  */
 struct wlr_xcursor_theme {
 	unsigned int cursor_count;
 	struct wlr_xcursor **cursors;
 	char *name;
 	int size;
+
+	struct {
+		// Sorted by name
+		struct wlr_xcursor_theme_entry *entries;
+		size_t entries_len, entries_cap;
+	} WLR_PRIVATE;
 };
 
 /**
@@ -20,6 +20,10 @@ struct wlr_xwayland_server_options {
 	bool no_touch_pointer_emulation;
 	bool force_xrandr_emulation;
 	int terminate_delay; // in seconds, 0 to terminate immediately
+	// In lazy mode, also start Xwayland in the background this many
+	// milliseconds after creation, and start it again as soon as it exits, so
+	// that X11 clients don't have to wait for it. 0 to disable.
+	int prewarm_delay;
 };
 
 struct wlr_xwayland_server {
@@ -53,6 +57,8 @@ struct wlr_xwayland_server {
 	struct {
 		struct wl_listener client_destroy;
 		struct wl_listener display_destroy;
+
+		struct wl_event_source *prewarm_timer;
 	} WLR_PRIVATE;
 };
 
@@ -12,6 +12,8 @@
 #include <stdbool.h>
 #include <wayland-server-core.h>
 
+struct list_map;
+
 /**
  * The Xwayland shell.
  *
@@ -29,6 +31,9 @@ struct wlr_xwayland_shell_v1 {
 		struct wl_client *client;
 		struct wl_list surfaces; // wlr_xwayland_surface_v1.link
 
+		// Surfaces with a serial
+		struct list_map *serial_map; // wlr_xwayland_surface_v1.serial_link
+
 		struct wl_listener display_destroy;
 		struct wl_listener client_destroy;
 	} WLR_PRIVATE;
@@ -44,6 +49,7 @@ struct wlr_xwayland_surface_v1 {
 	struct {
 		struct wl_resource *resource;
 		struct wl_list link;
+		struct wl_list serial_link; // wlr_xwayland_shell_v1.serial_map
 		struct wlr_xwayland_shell_v1 *shell;
 		bool added;
 	} WLR_PRIVATE;
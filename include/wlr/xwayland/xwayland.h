@@ -233,6 +233,17 @@ struct wlr_xwayland_surface {
 		struct wl_listener surface_commit;
 		struct wl_listener surface_map;
 		struct wl_listener surface_unmap;
+
+		struct wl_list window_link; // wlr_xwm.surfaces_by_window
+		struct wl_list surface_id_link; // wlr_xwm.unpaired_by_surface_id
+		struct wl_list serial_link; // wlr_xwm.unpaired_by_serial
+
+		// The associate event is emitted once the properties have been read
+		bool associate_pending;
+
+		// Changes collected by a configure batch, not sent yet
+		bool batch_configure, batch_restack;
+		int batch_old_width, batch_old_height;
 	} WLR_PRIVATE;
 };
 
@@ -330,6 +341,20 @@ void wlr_xwayland_surface_set_demands_attention(
 void wlr_xwayland_set_seat(struct wlr_xwayland *xwayland,
 	struct wlr_seat *seat);
 
+/**
+ * Start collecting calls to wlr_xwayland_surface_configure() and
+ * wlr_xwayland_surface_restack(). Surface state is updated right away, but the
+ * X11 requests are only sent by wlr_xwayland_commit_configure_batch(), with a
+ * single ConfigureWindow request per window. Useful when restacking or tiling
+ * many windows at once.
+ */
+void wlr_xwayland_begin_configure_batch(struct wlr_xwayland *xwayland);
+
+/**
+ * Send the requests collected since wlr_xwayland_begin_configure_batch().
+ */
+void wlr_xwayland_commit_configure_batch(struct wlr_xwayland *xwayland);
+
 /**
  * Get a struct wlr_xwayland_surface from a struct wlr_surface.
  *
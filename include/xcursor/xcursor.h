@@ -52,7 +52,10 @@ void
 xcursor_images_destroy(struct xcursor_images *images);
 
 void
-xcursor_load_theme(const char *theme, int size,
-		   void (*load_callback)(struct xcursor_images *, void *),
-		   void *user_data);
+xcursor_index_theme(const char *theme,
+		    void (*index_callback)(const char *, const char *, void *),
+		    void *user_data);
+
+struct xcursor_images *
+xcursor_load_file(const char *path, int size);
 #endif
@@ -32,6 +32,7 @@ struct wlr_xwm_selection_transfer {
 
 	// when receiving from x11
 	int property_start;
+	uint32_t property_offset; // in 32-bit units, for non-INCR transfers
 	xcb_get_property_reply_t *property_reply;
 	xcb_window_t incoming_window;
 };
@@ -6,6 +6,7 @@
 #include <wlr/xwayland.h>
 #include <xcb/render.h>
 #include "config.h"
+#include "util/list_map.h"
 #include "xwayland/selection.h"
 
 #if HAVE_XCB_ERRORS
@@ -112,6 +113,7 @@ struct wlr_xwm {
 
 	xcb_atom_t atoms[ATOM_LAST];
 	xcb_connection_t *xcb_conn;
+	size_t flush_stalls; // number of flushes which blocked for a while
 	xcb_screen_t *screen;
 	xcb_window_t window;
 	xcb_visualid_t visual_id;
@@ -131,7 +133,20 @@ struct wlr_xwm {
 	// Surfaces in bottom-to-top stacking order, for _NET_CLIENT_LIST_STACKING
 	struct wl_list surfaces_in_stack_order; // wlr_xwayland_surface.stack_link
 	struct wl_list unpaired_surfaces; // wlr_xwayland_surface.unpaired_link
+	// Lookup tables, X events referencing windows are frequent
+	struct list_map surfaces_by_window;
+	struct list_map unpaired_by_surface_id;
+	struct list_map unpaired_by_serial;
 	struct wl_list pending_startup_ids; // pending_startup_id
+	// Property requests waiting for a reply, in request order
+	struct wl_list property_requests; // xwm_property_request.link
+
+	// _NET_CLIENT_LIST and _NET_CLIENT_LIST_STACKING are sent on idle
+	struct wl_event_source *client_list_idle;
+	bool client_list_dirty, client_list_stacking_dirty;
+
+	// Configures and restacks are collected until the batch is committed
+	bool configure_batch;
 
 	struct wlr_drag *drag;
 	struct wlr_xwayland_surface *drag_focus;
@@ -175,6 +190,9 @@ void xwm_seat_unlink_drag_handlers(struct wlr_xwm *xwm);
 
 void xwm_set_seat(struct wlr_xwm *xwm, struct wlr_seat *seat);
 
+void xwm_begin_configure_batch(struct wlr_xwm *xwm);
+void xwm_commit_configure_batch(struct wlr_xwm *xwm);
+
 char *xwm_get_atom_name(struct wlr_xwm *xwm, xcb_atom_t atom);
 bool xwm_atoms_contains(struct wlr_xwm *xwm, xcb_atom_t *atoms,
 	size_t num_atoms, enum atom_name needle);
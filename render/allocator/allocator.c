@@ -11,6 +11,8 @@
 #include <xf86drmMode.h>
 #include "render/allocator/drm_dumb.h"
 #include "render/allocator/shm.h"
+#include "render/dmabuf.h"
+#include "render/pixel_format.h"
 #include "render/wlr_renderer.h"
 
 #if WLR_HAS_GBM_ALLOCATOR
@@ -21,6 +23,15 @@
 #include "render/allocator/udmabuf.h"
 #endif
 
+// Memory of an allocated buffer accounted in its allocator
+struct allocator_buffer {
+	struct wlr_allocator *alloc; // NULL if destroyed
+	size_t size;
+
+	struct wlr_addon addon;
+	struct wl_listener allocator_destroy;
+};
+
 void wlr_allocator_init(struct wlr_allocator *alloc,
 		const struct wlr_allocator_interface *impl, uint32_t buffer_caps) {
 	assert(impl && impl->destroy && impl->create_buffer);
@@ -176,6 +187,81 @@ void wlr_allocator_destroy(struct wlr_allocator *alloc) {
 	alloc->impl->destroy(alloc);
 }
 
+static void allocator_buffer_destroy(struct allocator_buffer *alloc_buffer) {
+	if (alloc_buffer->alloc != NULL) {
+		alloc_buffer->alloc->memory_usage -= alloc_buffer->size;
+	}
+	wl_list_remove(&alloc_buffer->allocator_destroy.link);
+	free(alloc_buffer);
+}
+
+static void allocator_buffer_handle_addon_destroy(struct wlr_addon *addon) {
+	struct allocator_buffer *alloc_buffer =
+		wl_container_of(addon, alloc_buffer, addon);
+	wlr_addon_finish(&alloc_buffer->addon);
+	allocator_buffer_destroy(alloc_buffer);
+}
+
+static const struct wlr_addon_interface allocator_buffer_addon_impl = {
+	.name = "wlr_allocator_buffer",
+	.destroy = allocator_buffer_handle_addon_destroy,
+};
+
+static void allocator_buffer_handle_allocator_destroy(struct wl_listener *listener,
+		void *data) {
+	struct allocator_buffer *alloc_buffer =
+		wl_container_of(listener, alloc_buffer, allocator_destroy);
+	wl_list_remove(&alloc_buffer->allocator_destroy.link);
+	wl_list_init(&alloc_buffer->allocator_destroy.link);
+	alloc_buffer->alloc = NULL;
+}
+
+static size_t buffer_get_memory_size(struct wlr_buffer *buffer) {
+	struct wlr_dmabuf_attributes dmabuf;
+	if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+		return dmabuf_get_size(&dmabuf);
+	}
+
+	struct wlr_shm_attributes shm;
+	if (wlr_buffer_get_shm(buffer, &shm)) {
+		return (size_t)shm.stride * shm.height;
+	}
+
+	void *data;
+	uint32_t format;
+	size_t stride;
+	if (wlr_buffer_begin_data_ptr_access(buffer,
+			WLR_BUFFER_DATA_PTR_ACCESS_READ, &data, &format, &stride)) {
+		wlr_buffer_end_data_ptr_access(buffer);
+		return stride * buffer->height;
+	}
+
+	return 0;
+}
+
+static void allocator_track_buffer(struct wlr_allocator *alloc,
+		struct wlr_buffer *buffer) {
+	struct allocator_buffer *alloc_buffer = calloc(1, sizeof(*alloc_buffer));
+	if (alloc_buffer == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+
+	alloc_buffer->alloc = alloc;
+	alloc_buffer->size = buffer_get_memory_size(buffer);
+	alloc->memory_usage += alloc_buffer->size;
+
+	// The allocator is only used as a key, buffers may outlive it
+	wlr_addon_init(&alloc_buffer->addon, &buffer->addons, alloc,
+		&allocator_buffer_addon_impl);
+	alloc_buffer->allocator_destroy.notify = allocator_buffer_handle_allocator_destroy;
+	wl_signal_add(&alloc->events.destroy, &alloc_buffer->allocator_destroy);
+}
+
+size_t wlr_allocator_get_memory_usage(struct wlr_allocator *alloc) {
+	return alloc->memory_usage;
+}
+
 struct wlr_buffer *wlr_allocator_create_buffer(struct wlr_allocator *alloc,
 		int width, int height, const struct wlr_drm_format *format) {
 	struct wlr_buffer *buffer =
@@ -193,5 +279,6 @@ struct wlr_buffer *wlr_allocator_create_buffer(struct wlr_allocator *alloc,
 	if (alloc->buffer_caps & WLR_BUFFER_CAP_SHM) {
 		assert(buffer->impl->get_shm);
 	}
+	allocator_track_buffer(alloc, buffer);
 	return buffer;
 }
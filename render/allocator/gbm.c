@@ -88,12 +88,115 @@ error_fd:
 	return false;
 }
 
+static void pooled_bo_destroy(struct wlr_gbm_allocator *alloc,
+		struct wlr_gbm_pooled_bo *pooled) {
+	alloc->pool_len--;
+	alloc->pool_size -= pooled->size;
+	wl_list_remove(&pooled->link);
+	wlr_dmabuf_attributes_finish(&pooled->dmabuf);
+	gbm_bo_destroy(pooled->gbm_bo);
+	free(pooled);
+}
+
+static size_t get_dmabuf_size(const struct wlr_dmabuf_attributes *dmabuf) {
+	// Over-estimates the size of sub-sampled planes, this is only used to
+	// bound the pool size
+	size_t size = 0;
+	for (int i = 0; i < dmabuf->n_planes; i++) {
+		size += (size_t)dmabuf->stride[i] * dmabuf->height;
+	}
+	return size;
+}
+
+static void pool_insert(struct wlr_gbm_allocator *alloc, struct gbm_bo *bo,
+		struct wlr_dmabuf_attributes *dmabuf) {
+	struct wlr_gbm_pooled_bo *pooled = NULL;
+	size_t size = get_dmabuf_size(dmabuf);
+	if (size <= GBM_POOL_MAX_SIZE) {
+		pooled = calloc(1, sizeof(*pooled));
+	}
+	if (pooled == NULL) {
+		wlr_dmabuf_attributes_finish(dmabuf);
+		gbm_bo_destroy(bo);
+		return;
+	}
+
+	pooled->gbm_bo = bo;
+	pooled->dmabuf = *dmabuf;
+	pooled->size = size;
+	wl_list_insert(&alloc->pool, &pooled->link);
+	alloc->pool_len++;
+	alloc->pool_size += size;
+
+	struct wlr_gbm_pooled_bo *tmp;
+	wl_list_for_each_reverse_safe(pooled, tmp, &alloc->pool, link) {
+		if (alloc->pool_len <= GBM_POOL_MAX_LEN &&
+				alloc->pool_size <= GBM_POOL_MAX_SIZE) {
+			break;
+		}
+		pooled_bo_destroy(alloc, pooled);
+	}
+}
+
+static struct wlr_gbm_pooled_bo *pool_take(struct wlr_gbm_allocator *alloc,
+		int width, int height, const struct wlr_drm_format *format) {
+	struct wlr_gbm_pooled_bo *pooled;
+	wl_list_for_each(pooled, &alloc->pool, link) {
+		const struct wlr_dmabuf_attributes *dmabuf = &pooled->dmabuf;
+		if (dmabuf->width == width && dmabuf->height == height &&
+				dmabuf->format == format->format &&
+				wlr_drm_format_has(format, dmabuf->modifier)) {
+			wl_list_remove(&pooled->link);
+			alloc->pool_len--;
+			alloc->pool_size -= pooled->size;
+			alloc->pool_hits++;
+			return pooled;
+		}
+	}
+	alloc->pool_misses++;
+	return NULL;
+}
+
+static struct wlr_gbm_buffer *create_buffer_from_pool(
+		struct wlr_gbm_allocator *alloc, int width, int height,
+		const struct wlr_drm_format *format) {
+	struct wlr_gbm_pooled_bo *pooled = pool_take(alloc, width, height, format);
+	if (pooled == NULL) {
+		return NULL;
+	}
+
+	struct wlr_gbm_buffer *buffer = calloc(1, sizeof(*buffer));
+	if (buffer == NULL) {
+		wlr_dmabuf_attributes_finish(&pooled->dmabuf);
+		gbm_bo_destroy(pooled->gbm_bo);
+		free(pooled);
+		return NULL;
+	}
+	wlr_buffer_init(&buffer->base, &buffer_impl, width, height);
+	buffer->alloc = alloc;
+	buffer->gbm_bo = pooled->gbm_bo;
+	buffer->dmabuf = pooled->dmabuf;
+	wl_list_insert(&alloc->buffers, &buffer->link);
+	free(pooled);
+
+	return buffer;
+}
+
 static struct wlr_gbm_buffer *create_buffer(struct wlr_gbm_allocator *alloc,
 		int width, int height, const struct wlr_drm_format *format) {
 	struct gbm_device *gbm_device = alloc->gbm_device;
 
 	assert(format->len > 0);
 
+	// Re-use the BO of a destroyed buffer if possible: allocating is
+	// expensive, and transient buffers (e.g. for screen capture) keep asking
+	// for the same kind of buffer
+	struct wlr_gbm_buffer *pooled_buffer =
+		create_buffer_from_pool(alloc, width, height, format);
+	if (pooled_buffer != NULL) {
+		return pooled_buffer;
+	}
+
 	bool has_modifier = true;
 	uint64_t fallback_modifier = DRM_FORMAT_MOD_INVALID;
 	errno = 0;
@@ -125,6 +228,7 @@ static struct wlr_gbm_buffer *create_buffer(struct wlr_gbm_allocator *alloc,
 		return NULL;
 	}
 	wlr_buffer_init(&buffer->base, &buffer_impl, width, height);
+	buffer->alloc = alloc;
 	buffer->gbm_bo = bo;
 	wl_list_insert(&alloc->buffers, &buffer->link);
 
@@ -159,9 +263,10 @@ static void buffer_destroy(struct wlr_buffer *wlr_buffer) {
 
 	wlr_buffer_finish(wlr_buffer);
 
-	wlr_dmabuf_attributes_finish(&buffer->dmabuf);
-	if (buffer->gbm_bo != NULL) {
-		gbm_bo_destroy(buffer->gbm_bo);
+	if (buffer->alloc != NULL) {
+		pool_insert(buffer->alloc, buffer->gbm_bo, &buffer->dmabuf);
+	} else {
+		wlr_dmabuf_attributes_finish(&buffer->dmabuf);
 	}
 	wl_list_remove(&buffer->link);
 	free(buffer);
@@ -205,6 +310,7 @@ struct wlr_allocator *wlr_gbm_allocator_create(int fd) {
 
 	alloc->fd = fd;
 	wl_list_init(&alloc->buffers);
+	wl_list_init(&alloc->pool);
 
 	alloc->gbm_device = gbm_create_device(fd);
 	if (alloc->gbm_device == NULL) {
@@ -225,15 +331,24 @@ struct wlr_allocator *wlr_gbm_allocator_create(int fd) {
 static void allocator_destroy(struct wlr_allocator *wlr_alloc) {
 	struct wlr_gbm_allocator *alloc = get_gbm_alloc_from_alloc(wlr_alloc);
 
+	wlr_log(WLR_DEBUG, "GBM buffer pool: %zu hits, %zu misses",
+		alloc->pool_hits, alloc->pool_misses);
+
 	// The gbm_bo objects need to be destroyed before the gbm_device
 	struct wlr_gbm_buffer *buf, *buf_tmp;
 	wl_list_for_each_safe(buf, buf_tmp, &alloc->buffers, link) {
 		gbm_bo_destroy(buf->gbm_bo);
 		buf->gbm_bo = NULL;
+		buf->alloc = NULL;
 		wl_list_remove(&buf->link);
 		wl_list_init(&buf->link);
 	}
 
+	struct wlr_gbm_pooled_bo *pooled, *pooled_tmp;
+	wl_list_for_each_safe(pooled, pooled_tmp, &alloc->pool, link) {
+		pooled_bo_destroy(alloc, pooled);
+	}
+
 	gbm_device_destroy(alloc->gbm_device);
 	close(alloc->fd);
 	free(alloc);
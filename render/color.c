@@ -1,8 +1,16 @@
 #include <assert.h>
+#include <math.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <wlr/render/color.h>
 #include "render/color.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 struct wlr_color_transform *wlr_color_transform_init_srgb(void) {
 	struct wlr_color_transform *tx = calloc(1, sizeof(struct wlr_color_transform));
 	if (!tx) {
@@ -50,3 +58,288 @@ struct wlr_color_transform_lut3d *wlr_color_transform_lut3d_from_base(
 	struct wlr_color_transform_lut3d *lut3d = wl_container_of(tr, lut3d, base);
 	return lut3d;
 }
+
+static float srgb_eotf(float x) {
+	if (x <= 0.04045f) {
+		return x / 12.92f;
+	}
+	return powf((x + 0.055f) / 1.055f, 2.4f);
+}
+
+static float srgb_inverse_eotf(float x) {
+	if (x <= 0.0031308f) {
+		return x * 12.92f;
+	}
+	return 1.055f * powf(x, 1 / 2.4f) - 0.055f;
+}
+
+static float sample_ramp(const uint16_t *ramp, size_t ramp_size, float x) {
+	float pos = x * (ramp_size - 1);
+	size_t index = (size_t)pos;
+	if (index >= ramp_size - 1) {
+		return (float)ramp[ramp_size - 1] / UINT16_MAX;
+	}
+	float weight = pos - index;
+	return (ramp[index] + weight * (ramp[index + 1] - ramp[index])) / UINT16_MAX;
+}
+
+// Gamma ramps are smooth, they don't need a finer lattice than ICC profiles
+#define GAMMA_LUT_3D_DIM_LEN 33
+
+struct wlr_color_transform *color_transform_init_gamma_lut(size_t ramp_size,
+		const uint16_t *r, const uint16_t *g, const uint16_t *b) {
+	assert(ramp_size >= 2);
+
+	size_t dim_len = GAMMA_LUT_3D_DIM_LEN;
+	float *lut_3d = calloc(3 * dim_len * dim_len * dim_len, sizeof(float));
+	if (lut_3d == NULL) {
+		return NULL;
+	}
+
+	// The ramps apply to sRGB-encoded values while the LUT is indexed with
+	// linear ones
+	float curves[3][GAMMA_LUT_3D_DIM_LEN];
+	const uint16_t *ramps[3] = { r, g, b };
+	for (size_t i = 0; i < dim_len; i++) {
+		float x = srgb_inverse_eotf((float)i / (dim_len - 1));
+		for (size_t c = 0; c < 3; c++) {
+			curves[c][i] = sample_ramp(ramps[c], ramp_size, x);
+		}
+	}
+
+	for (size_t b_index = 0; b_index < dim_len; b_index++) {
+		for (size_t g_index = 0; g_index < dim_len; g_index++) {
+			for (size_t r_index = 0; r_index < dim_len; r_index++) {
+				size_t offset = 3 * (r_index + dim_len * g_index + dim_len * dim_len * b_index);
+				lut_3d[offset] = curves[0][r_index];
+				lut_3d[offset + 1] = curves[1][g_index];
+				lut_3d[offset + 2] = curves[2][b_index];
+			}
+		}
+	}
+
+	struct wlr_color_transform_lut3d *tx = calloc(1, sizeof(*tx));
+	if (tx == NULL) {
+		free(lut_3d);
+		return NULL;
+	}
+	tx->base.type = COLOR_TRANSFORM_LUT_3D;
+	tx->base.ref_count = 1;
+	wlr_addon_set_init(&tx->base.addons);
+	tx->dim_len = dim_len;
+	tx->lut_3d = lut_3d;
+	return &tx->base;
+}
+
+void color_lut3d_sampler_init(struct wlr_color_lut3d_sampler *sampler,
+		const struct wlr_color_transform_lut3d *lut3d) {
+	assert(lut3d->dim_len >= 2);
+	sampler->lut3d = lut3d;
+
+	size_t max_index = lut3d->dim_len - 1;
+	for (size_t i = 0; i < 256; i++) {
+		float x = srgb_eotf(i / 255.0f) * max_index;
+		size_t index = (size_t)x;
+		if (index >= max_index) {
+			index = max_index - 1;
+		}
+		sampler->index[i] = index;
+		sampler->weight[i] = x - index;
+	}
+}
+
+// Maximum difference with a separable LUT, in normalized channel units
+#define SEPARABLE_LUT_TOLERANCE (0.5f / 255)
+
+static bool lut3d_is_separable(const struct wlr_color_transform_lut3d *lut3d) {
+	size_t dim_len = lut3d->dim_len;
+	size_t strides[3] = { 3, 3 * dim_len, 3 * dim_len * dim_len };
+	for (size_t b_index = 0; b_index < dim_len; b_index++) {
+		for (size_t g_index = 0; g_index < dim_len; g_index++) {
+			for (size_t r_index = 0; r_index < dim_len; r_index++) {
+				size_t index[3] = { r_index, g_index, b_index };
+				const float *rgb = &lut3d->lut_3d[r_index * strides[0] +
+					g_index * strides[1] + b_index * strides[2]];
+				// Each channel must only depend on the matching input channel
+				for (size_t c = 0; c < 3; c++) {
+					float ref = lut3d->lut_3d[index[c] * strides[c] + c];
+					if (fabsf(rgb[c] - ref) > SEPARABLE_LUT_TOLERANCE) {
+						return false;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+static uint16_t encode_ramp_value(float x) {
+	if (x <= 0) {
+		return 0;
+	} else if (x >= 1) {
+		return UINT16_MAX;
+	}
+	return (uint16_t)(x * UINT16_MAX + 0.5f);
+}
+
+bool color_transform_get_gamma_lut(struct wlr_color_transform *tr,
+		size_t ramp_size, uint16_t *r, uint16_t *g, uint16_t *b) {
+	if (ramp_size < 2) {
+		return false;
+	}
+
+	switch (tr->type) {
+	case COLOR_TRANSFORM_SRGB:
+		for (size_t i = 0; i < ramp_size; i++) {
+			r[i] = g[i] = b[i] = (uint32_t)UINT16_MAX * i / (ramp_size - 1);
+		}
+		return true;
+	case COLOR_TRANSFORM_LUT_3D:
+		break;
+	}
+
+	const struct wlr_color_transform_lut3d *lut3d =
+		wlr_color_transform_lut3d_from_base(tr);
+	if (!lut3d_is_separable(lut3d)) {
+		return false;
+	}
+
+	size_t dim_len = lut3d->dim_len;
+	size_t strides[3] = { 3, 3 * dim_len, 3 * dim_len * dim_len };
+	uint16_t *ramps[3] = { r, g, b };
+	for (size_t i = 0; i < ramp_size; i++) {
+		float x = srgb_eotf((float)i / (ramp_size - 1)) * (dim_len - 1);
+		size_t index = (size_t)x;
+		if (index >= dim_len - 1) {
+			index = dim_len - 2;
+		}
+		float weight = x - index;
+
+		// Sample each curve along its own axis
+		for (size_t c = 0; c < 3; c++) {
+			float v0 = lut3d->lut_3d[index * strides[c] + c];
+			float v1 = lut3d->lut_3d[(index + 1) * strides[c] + c];
+			ramps[c][i] = encode_ramp_value(v0 + weight * (v1 - v0));
+		}
+	}
+	return true;
+}
+
+#if !defined(__SSE2__) && !defined(__ARM_NEON)
+static uint32_t encode_channel(float x) {
+	if (x <= 0) {
+		return 0;
+	} else if (x >= 1) {
+		return 255;
+	}
+	return (uint32_t)(x * 255.0f + 0.5f);
+}
+#endif
+
+// Blend the RGB triplets at the vertices of a tetrahedron and encode the
+// result. c3 may be the last element of the LUT, in which case reading past
+// its blue channel would overflow.
+static uint32_t interpolate_tetrahedron(const float *c0, const float *c1,
+		const float *c2, const float *c3, bool c3_last,
+		float w0, float w1, float w2, const int shifts[static 3]) {
+#if defined(__SSE2__)
+	__m128 v0 = _mm_loadu_ps(c0);
+	__m128 v1 = _mm_loadu_ps(c1);
+	__m128 v2 = _mm_loadu_ps(c2);
+	__m128 v3 = c3_last ? _mm_setr_ps(c3[0], c3[1], c3[2], 0) : _mm_loadu_ps(c3);
+	__m128 x = _mm_add_ps(v0, _mm_mul_ps(_mm_set1_ps(w0), _mm_sub_ps(v1, v0)));
+	x = _mm_add_ps(x, _mm_mul_ps(_mm_set1_ps(w1), _mm_sub_ps(v2, v1)));
+	x = _mm_add_ps(x, _mm_mul_ps(_mm_set1_ps(w2), _mm_sub_ps(v3, v2)));
+	x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	__m128i e = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(255.0f)),
+		_mm_set1_ps(0.5f)));
+	return ((uint32_t)_mm_cvtsi128_si32(e) << shifts[0]) |
+		((uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(e, 4)) << shifts[1]) |
+		((uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(e, 8)) << shifts[2]);
+#elif defined(__ARM_NEON)
+	float32x4_t v0 = vld1q_f32(c0);
+	float32x4_t v1 = vld1q_f32(c1);
+	float32x4_t v2 = vld1q_f32(c2);
+	float32x4_t v3 = c3_last ?
+		vcombine_f32(vld1_f32(c3), vset_lane_f32(c3[2], vdup_n_f32(0), 0)) :
+		vld1q_f32(c3);
+	float32x4_t x = vaddq_f32(v0, vmulq_n_f32(vsubq_f32(v1, v0), w0));
+	x = vaddq_f32(x, vmulq_n_f32(vsubq_f32(v2, v1), w1));
+	x = vaddq_f32(x, vmulq_n_f32(vsubq_f32(v3, v2), w2));
+	x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(0)), vdupq_n_f32(1.0f));
+	uint32x4_t e = vcvtq_u32_f32(vaddq_f32(vmulq_n_f32(x, 255.0f),
+		vdupq_n_f32(0.5f)));
+	return (vgetq_lane_u32(e, 0) << shifts[0]) |
+		(vgetq_lane_u32(e, 1) << shifts[1]) |
+		(vgetq_lane_u32(e, 2) << shifts[2]);
+#else
+	(void)c3_last;
+	uint32_t out = 0;
+	for (size_t c = 0; c < 3; c++) {
+		float x = c0[c] + w0 * (c1[c] - c0[c]) +
+			w1 * (c2[c] - c1[c]) + w2 * (c3[c] - c2[c]);
+		out |= encode_channel(x) << shifts[c];
+	}
+	return out;
+#endif
+}
+
+void color_lut3d_sampler_apply(const struct wlr_color_lut3d_sampler *sampler,
+		uint32_t *pixels, size_t pixels_len,
+		int red_shift, int green_shift, int blue_shift) {
+	const float *lut = sampler->lut3d->lut_3d;
+	size_t dim_len = sampler->lut3d->dim_len;
+	uint32_t channels_mask = ((uint32_t)0xFF << red_shift) |
+		((uint32_t)0xFF << green_shift) | ((uint32_t)0xFF << blue_shift);
+
+	size_t strides[3] = { 3, 3 * dim_len, 3 * dim_len * dim_len };
+	const float *lut_last = &lut[3 * (dim_len * dim_len * dim_len - 1)];
+	int shifts[3] = { red_shift, green_shift, blue_shift };
+	uint32_t prev_in = 0, prev_out = 0;
+	bool has_prev = false;
+	for (size_t i = 0; i < pixels_len; i++) {
+		uint32_t in = pixels[i] & channels_mask;
+		// Large areas of the same color are common
+		if (has_prev && in == prev_in) {
+			pixels[i] = (pixels[i] & ~channels_mask) | prev_out;
+			continue;
+		}
+
+		uint8_t rgb[3] = {
+			(in >> red_shift) & 0xFF,
+			(in >> green_shift) & 0xFF,
+			(in >> blue_shift) & 0xFF,
+		};
+		float w[3];
+		size_t base = 0;
+		for (size_t c = 0; c < 3; c++) {
+			base += sampler->index[rgb[c]] * strides[c];
+			w[c] = sampler->weight[rgb[c]];
+		}
+
+		// Tetrahedral interpolation: walk from the cell's origin to its
+		// opposite corner, along the axes sorted by decreasing weight
+		size_t order[3] = { 0, 1, 2 };
+		for (size_t a = 0; a < 2; a++) {
+			for (size_t b = a + 1; b < 3; b++) {
+				if (w[order[b]] > w[order[a]]) {
+					size_t tmp = order[a];
+					order[a] = order[b];
+					order[b] = tmp;
+				}
+			}
+		}
+
+		const float *c0 = &lut[base];
+		const float *c1 = c0 + strides[order[0]];
+		const float *c2 = c1 + strides[order[1]];
+		const float *c3 = c2 + strides[order[2]];
+		uint32_t out = interpolate_tetrahedron(c0, c1, c2, c3, c3 == lut_last,
+			w[order[0]], w[order[1]], w[order[2]], shifts);
+
+		pixels[i] = (pixels[i] & ~channels_mask) | out;
+		prev_in = in;
+		prev_out = out;
+		has_prev = true;
+	}
+}
@@ -1,5 +1,8 @@
 #include <lcms2.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <wlr/util/log.h>
 #include <wlr/render/color.h>
 #include "render/color.h"
@@ -16,6 +19,109 @@ static void handle_lcms_error(cmsContext ctx, cmsUInt32Number code, const char *
 	wlr_log(WLR_ERROR, "[lcms] %s", text);
 }
 
+// Upper bound on the number of threads evaluating a LUT
+#define LUT_MAX_THREADS 8
+// Minimum number of LUT entries per thread: spawning a thread costs about as
+// much as transforming a few thousand colors, small LUTs are computed without
+// any extra thread
+#define LUT_THREAD_MIN_ENTRIES 8192
+
+struct lut_job {
+	cmsHTRANSFORM lcms_tr;
+	float *lut_3d;
+	size_t dim_len;
+	// Range of blue slices computed by the job
+	size_t b_start, b_end;
+	bool ok;
+
+	pthread_t thread;
+	bool threaded;
+};
+
+static void *lut_job_run(void *data) {
+	struct lut_job *job = data;
+	size_t dim_len = job->dim_len;
+	size_t slice_len = dim_len * dim_len;
+
+	// The LUT layout matches TYPE_RGB_FLT: each blue slice is computed with a
+	// single call, which lets LCMS use its optimized pipelines
+	float *rgb_in = malloc(3 * slice_len * sizeof(float));
+	if (rgb_in == NULL) {
+		return NULL;
+	}
+
+	float factor = 1.0f / (dim_len - 1);
+	for (size_t g_index = 0; g_index < dim_len; g_index++) {
+		for (size_t r_index = 0; r_index < dim_len; r_index++) {
+			size_t offset = 3 * (r_index + dim_len * g_index);
+			rgb_in[offset] = r_index * factor;
+			rgb_in[offset + 1] = g_index * factor;
+		}
+	}
+
+	for (size_t b_index = job->b_start; b_index < job->b_end; b_index++) {
+		for (size_t i = 0; i < slice_len; i++) {
+			rgb_in[3 * i + 2] = b_index * factor;
+		}
+		// TODO: maybe clamp values to [0.0, 1.0] here?
+		cmsDoTransform(job->lcms_tr, rgb_in,
+			&job->lut_3d[3 * slice_len * b_index], slice_len);
+	}
+
+	free(rgb_in);
+	job->ok = true;
+	return NULL;
+}
+
+static bool compute_lut_3d(cmsHTRANSFORM lcms_tr, float *lut_3d,
+		size_t dim_len) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t jobs_len = cpus > 0 ? (size_t)cpus : 1;
+	if (jobs_len > LUT_MAX_THREADS) {
+		jobs_len = LUT_MAX_THREADS;
+	}
+	if (jobs_len > dim_len) {
+		jobs_len = dim_len;
+	}
+	size_t max_jobs_len = dim_len * dim_len * dim_len / LUT_THREAD_MIN_ENTRIES;
+	if (jobs_len > max_jobs_len) {
+		jobs_len = max_jobs_len > 0 ? max_jobs_len : 1;
+	}
+
+	struct lut_job jobs[LUT_MAX_THREADS] = {0};
+	for (size_t i = 0; i < jobs_len; i++) {
+		jobs[i] = (struct lut_job){
+			.lcms_tr = lcms_tr,
+			.lut_3d = lut_3d,
+			.dim_len = dim_len,
+			.b_start = dim_len * i / jobs_len,
+			.b_end = dim_len * (i + 1) / jobs_len,
+		};
+	}
+
+	// The calling thread takes care of the first job. If a thread can't be
+	// spawned, its job is run synchronously as well.
+	for (size_t i = 1; i < jobs_len; i++) {
+		struct lut_job *job = &jobs[i];
+		job->threaded = pthread_create(&job->thread, NULL,
+			lut_job_run, job) == 0;
+		if (!job->threaded) {
+			lut_job_run(job);
+		}
+	}
+
+	lut_job_run(&jobs[0]);
+
+	bool ok = true;
+	for (size_t i = 0; i < jobs_len; i++) {
+		if (jobs[i].threaded) {
+			pthread_join(jobs[i].thread, NULL);
+		}
+		ok = ok && jobs[i].ok;
+	}
+	return ok;
+}
+
 struct wlr_color_transform *wlr_color_transform_init_linear_to_icc(
 		const void *data, size_t size) {
 	struct wlr_color_transform_lut3d *tx = NULL;
@@ -57,9 +163,10 @@ struct wlr_color_transform *wlr_color_transform_init_linear_to_icc(
 		goto out_linear_tone_curve;
 	}
 
+	// Without a cache, the transform can be used concurrently by the LUT jobs
 	cmsHTRANSFORM lcms_tr = cmsCreateTransformTHR(ctx,
 		srgb_profile, TYPE_RGB_FLT, icc_profile, TYPE_RGB_FLT,
-		INTENT_RELATIVE_COLORIMETRIC, 0);
+		INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOCACHE);
 	if (lcms_tr == NULL) {
 		wlr_log(WLR_ERROR, "cmsCreateTransformTHR failed");
 		goto out_srgb_profile;
@@ -72,31 +179,15 @@ struct wlr_color_transform *wlr_color_transform_init_linear_to_icc(
 		goto out_lcms_tr;
 	}
 
-	float factor = 1.0f / (dim_len - 1);
-	for (size_t b_index = 0; b_index < dim_len; b_index++) {
-		for (size_t g_index = 0; g_index < dim_len; g_index++) {
-			for (size_t r_index = 0; r_index < dim_len; r_index++) {
-				float rgb_in[3] = {
-					r_index * factor,
-					g_index * factor,
-					b_index * factor,
-				};
-				float rgb_out[3];
-				// TODO: use a single call to cmsDoTransform for the entire calculation?
-				// this does require allocating an extra temp buffer
-				cmsDoTransform(lcms_tr, rgb_in, rgb_out, 1);
-
-				size_t offset = 3 * (r_index + dim_len * g_index + dim_len * dim_len * b_index);
-				// TODO: maybe clamp values to [0.0, 1.0] here?
-				lut_3d[offset] = rgb_out[0];
-				lut_3d[offset + 1] = rgb_out[1];
-				lut_3d[offset + 2] = rgb_out[2];
-			}
-		}
+	if (!compute_lut_3d(lcms_tr, lut_3d, dim_len)) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(lut_3d);
+		goto out_lcms_tr;
 	}
 
 	tx = calloc(1, sizeof(struct wlr_color_transform_lut3d));
 	if (!tx) {
+		free(lut_3d);
 		goto out_lcms_tr;
 	}
 	tx->base.type = COLOR_TRANSFORM_LUT_3D;
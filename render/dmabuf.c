@@ -1,4 +1,5 @@
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <wlr/render/dmabuf.h>
 #include <wlr/util/log.h>
@@ -35,3 +36,33 @@ error:
 	dst->n_planes = 0;
 	return false;
 }
+
+size_t dmabuf_get_size(const struct wlr_dmabuf_attributes *attribs) {
+	ino_t inodes[WLR_DMABUF_MAX_PLANES];
+	size_t size = 0;
+	for (int i = 0; i < attribs->n_planes; i++) {
+		struct stat st;
+		if (fstat(attribs->fd[i], &st) != 0) {
+			wlr_log_errno(WLR_DEBUG, "fstat failed");
+			return 0;
+		}
+		inodes[i] = st.st_ino;
+
+		bool shared = false;
+		for (int j = 0; j < i; j++) {
+			shared = shared || inodes[j] == inodes[i];
+		}
+		if (shared) {
+			continue;
+		}
+
+		// The size of a DMA-BUF can be queried by seeking to its end
+		off_t end = lseek(attribs->fd[i], 0, SEEK_END);
+		if (end < 0) {
+			wlr_log_errno(WLR_DEBUG, "lseek failed");
+			return 0;
+		}
+		size += end;
+	}
+	return size;
+}
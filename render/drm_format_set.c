@@ -27,15 +27,49 @@ void wlr_drm_format_set_finish(struct wlr_drm_format_set *set) {
 	set->formats = NULL;
 }
 
+/**
+ * Look up a format in a set, sorted by format code. Returns true if the format
+ * was found, with its index. Otherwise, the index is where the format would be
+ * inserted.
+ */
+static bool format_set_find(const struct wlr_drm_format_set *set,
+		uint32_t format, size_t *index) {
+	size_t lo = 0, hi = set->len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (set->formats[mid].format < format) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	*index = lo;
+	return lo < set->len && set->formats[lo].format == format;
+}
+
 static struct wlr_drm_format *format_set_get(const struct wlr_drm_format_set *set,
 		uint32_t format) {
-	for (size_t i = 0; i < set->len; ++i) {
-		if (set->formats[i].format == format) {
-			return &set->formats[i];
-		}
+	size_t index;
+	if (!format_set_find(set, format, &index)) {
+		return NULL;
 	}
+	return &set->formats[index];
+}
 
-	return NULL;
+// Same as format_set_find(), for the sorted modifiers of a format
+static bool format_find_modifier(const struct wlr_drm_format *fmt,
+		uint64_t modifier, size_t *index) {
+	size_t lo = 0, hi = fmt->len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (fmt->modifiers[mid] < modifier) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	*index = lo;
+	return lo < fmt->len && fmt->modifiers[lo] == modifier;
 }
 
 const struct wlr_drm_format *wlr_drm_format_set_get(
@@ -56,9 +90,9 @@ bool wlr_drm_format_set_add(struct wlr_drm_format_set *set, uint32_t format,
 		uint64_t modifier) {
 	assert(format != DRM_FORMAT_INVALID);
 
-	struct wlr_drm_format *existing = format_set_get(set, format);
-	if (existing) {
-		return wlr_drm_format_add(existing, modifier);
+	size_t index;
+	if (format_set_find(set, format, &index)) {
+		return wlr_drm_format_add(&set->formats[index], modifier);
 	}
 
 	struct wlr_drm_format fmt;
@@ -82,7 +116,10 @@ bool wlr_drm_format_set_add(struct wlr_drm_format_set *set, uint32_t format,
 		set->formats = fmts;
 	}
 
-	set->formats[set->len++] = fmt;
+	memmove(&set->formats[index + 1], &set->formats[index],
+		(set->len - index) * sizeof(set->formats[0]));
+	set->formats[index] = fmt;
+	set->len++;
 	return true;
 }
 
@@ -93,14 +130,13 @@ bool wlr_drm_format_set_remove(struct wlr_drm_format_set *set, uint32_t format,
 		return false;
 	}
 
-	for (size_t idx = 0; idx < fmt->len; idx++) {
-		if (fmt->modifiers[idx] == modifier) {
-			memmove(&fmt->modifiers[idx], &fmt->modifiers[idx+1], (fmt->len - idx - 1) * sizeof(fmt->modifiers[0]));
-			fmt->len--;
-			return true;
-		}
+	size_t idx;
+	if (!format_find_modifier(fmt, modifier, &idx)) {
+		return false;
 	}
-	return false;
+	memmove(&fmt->modifiers[idx], &fmt->modifiers[idx+1], (fmt->len - idx - 1) * sizeof(fmt->modifiers[0]));
+	fmt->len--;
+	return true;
 }
 
 void wlr_drm_format_init(struct wlr_drm_format *fmt, uint32_t format) {
@@ -110,16 +146,13 @@ void wlr_drm_format_init(struct wlr_drm_format *fmt, uint32_t format) {
 }
 
 bool wlr_drm_format_has(const struct wlr_drm_format *fmt, uint64_t modifier) {
-	for (size_t i = 0; i < fmt->len; ++i) {
-		if (fmt->modifiers[i] == modifier) {
-			return true;
-		}
-	}
-	return false;
+	size_t index;
+	return format_find_modifier(fmt, modifier, &index);
 }
 
 bool wlr_drm_format_add(struct wlr_drm_format *fmt, uint64_t modifier) {
-	if (wlr_drm_format_has(fmt, modifier)) {
+	size_t index;
+	if (format_find_modifier(fmt, modifier, &index)) {
 		return true;
 	}
 
@@ -136,7 +169,10 @@ bool wlr_drm_format_add(struct wlr_drm_format *fmt, uint64_t modifier) {
 		fmt->modifiers = new_modifiers;
 	}
 
-	fmt->modifiers[fmt->len++] = modifier;
+	memmove(&fmt->modifiers[index + 1], &fmt->modifiers[index],
+		(fmt->len - index) * sizeof(fmt->modifiers[0]));
+	fmt->modifiers[index] = modifier;
+	fmt->len++;
 	return true;
 }
 
@@ -203,13 +239,18 @@ bool wlr_drm_format_intersect(struct wlr_drm_format *dst,
 		.format = a->format,
 	};
 
-	for (size_t i = 0; i < a->len; i++) {
-		for (size_t j = 0; j < b->len; j++) {
-			if (a->modifiers[i] == b->modifiers[j]) {
-				assert(fmt.len < fmt.capacity);
-				fmt.modifiers[fmt.len++] = a->modifiers[i];
-				break;
-			}
+	// Both modifier lists are sorted
+	size_t i = 0, j = 0;
+	while (i < a->len && j < b->len) {
+		if (a->modifiers[i] < b->modifiers[j]) {
+			i++;
+		} else if (a->modifiers[i] > b->modifiers[j]) {
+			j++;
+		} else {
+			assert(fmt.len < fmt.capacity);
+			fmt.modifiers[fmt.len++] = a->modifiers[i];
+			i++;
+			j++;
 		}
 	}
 
@@ -228,28 +269,34 @@ bool wlr_drm_format_set_intersect(struct wlr_drm_format_set *dst,
 		return false;
 	}
 
-	for (size_t i = 0; i < a->len; i++) {
-		for (size_t j = 0; j < b->len; j++) {
-			if (a->formats[i].format == b->formats[j].format) {
-				// When the two formats have no common modifier, keep
-				// intersecting the rest of the formats: they may be compatible
-				// with each other
-				out.formats[out.len] = (struct wlr_drm_format){0};
-				if (!wlr_drm_format_intersect(&out.formats[out.len],
-						&a->formats[i], &b->formats[j])) {
-					wlr_drm_format_set_finish(&out);
-					return false;
-				}
-
-				if (out.formats[out.len].len == 0) {
-					wlr_drm_format_finish(&out.formats[out.len]);
-				} else {
-					out.len++;
-				}
-
-				break;
-			}
+	// Both sets are sorted by format
+	size_t i = 0, j = 0;
+	while (i < a->len && j < b->len) {
+		if (a->formats[i].format < b->formats[j].format) {
+			i++;
+			continue;
+		} else if (a->formats[i].format > b->formats[j].format) {
+			j++;
+			continue;
+		}
+
+		// When the two formats have no common modifier, keep
+		// intersecting the rest of the formats: they may be compatible
+		// with each other
+		out.formats[out.len] = (struct wlr_drm_format){0};
+		if (!wlr_drm_format_intersect(&out.formats[out.len],
+				&a->formats[i], &b->formats[j])) {
+			wlr_drm_format_set_finish(&out);
+			return false;
+		}
+
+		if (out.formats[out.len].len == 0) {
+			wlr_drm_format_finish(&out.formats[out.len]);
+		} else {
+			out.len++;
 		}
+		i++;
+		j++;
 	}
 
 	if (out.len == 0) {
@@ -262,18 +309,39 @@ bool wlr_drm_format_set_intersect(struct wlr_drm_format_set *dst,
 	return true;
 }
 
-static bool drm_format_set_extend(struct wlr_drm_format_set *dst,
-		const struct wlr_drm_format_set *src) {
-	for (size_t i = 0; i < src->len; i++) {
-		struct wlr_drm_format *format = &src->formats[i];
-		for (size_t j = 0; j < format->len; j++) {
-			if (!wlr_drm_format_set_add(dst, format->format, format->modifiers[j])) {
-				wlr_log_errno(WLR_ERROR, "Adding format/modifier to set failed");
-				return false;
-			}
+static bool drm_format_union(struct wlr_drm_format *dst,
+		const struct wlr_drm_format *a, const struct wlr_drm_format *b) {
+	assert(a->format == b->format);
+
+	size_t capacity = a->len + b->len;
+	uint64_t *modifiers = malloc(sizeof(*modifiers) * capacity);
+	if (!modifiers) {
+		return false;
+	}
+
+	struct wlr_drm_format fmt = {
+		.capacity = capacity,
+		.len = 0,
+		.modifiers = modifiers,
+		.format = a->format,
+	};
+
+	size_t i = 0, j = 0;
+	while (i < a->len || j < b->len) {
+		uint64_t modifier;
+		if (j == b->len || (i < a->len && a->modifiers[i] < b->modifiers[j])) {
+			modifier = a->modifiers[i++];
+		} else if (i == a->len || a->modifiers[i] > b->modifiers[j]) {
+			modifier = b->modifiers[j++];
+		} else {
+			modifier = a->modifiers[i];
+			i++;
+			j++;
 		}
+		fmt.modifiers[fmt.len++] = modifier;
 	}
 
+	*dst = fmt;
 	return true;
 }
 
@@ -287,11 +355,29 @@ bool wlr_drm_format_set_union(struct wlr_drm_format_set *dst,
 		return false;
 	}
 
-	// Add both a and b sets into out
-	if (!drm_format_set_extend(&out, a) ||
-		!drm_format_set_extend(&out, b)) {
-		wlr_drm_format_set_finish(&out);
-		return false;
+	// Both sets are sorted by format, merge them
+	size_t i = 0, j = 0;
+	while (i < a->len || j < b->len) {
+		struct wlr_drm_format *fmt = &out.formats[out.len];
+		*fmt = (struct wlr_drm_format){0};
+
+		bool ok;
+		if (j == b->len || (i < a->len &&
+				a->formats[i].format < b->formats[j].format)) {
+			ok = wlr_drm_format_copy(fmt, &a->formats[i++]);
+		} else if (i == a->len || a->formats[i].format > b->formats[j].format) {
+			ok = wlr_drm_format_copy(fmt, &b->formats[j++]);
+		} else {
+			ok = drm_format_union(fmt, &a->formats[i], &b->formats[j]);
+			i++;
+			j++;
+		}
+		if (!ok) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			wlr_drm_format_set_finish(&out);
+			return false;
+		}
+		out.len++;
 	}
 
 	wlr_drm_format_set_finish(dst);
@@ -299,3 +385,38 @@ bool wlr_drm_format_set_union(struct wlr_drm_format_set *dst,
 
 	return true;
 }
+
+bool drm_modifier_is_compressed(uint64_t modifier) {
+	if (modifier == DRM_FORMAT_MOD_INVALID) {
+		return false;
+	}
+
+	switch (fourcc_mod_get_vendor(modifier)) {
+	case DRM_FORMAT_MOD_VENDOR_ARM:;
+		uint64_t type = (modifier >> __fourcc_mod_arm_type_shift) &
+			__fourcc_mod_arm_type_mask;
+		return type == DRM_FORMAT_MOD_ARM_TYPE_AFBC ||
+			type == DRM_FORMAT_MOD_ARM_TYPE_AFRC;
+	case DRM_FORMAT_MOD_VENDOR_AMD:
+		return AMD_FMT_MOD_GET(DCC, modifier);
+	case DRM_FORMAT_MOD_VENDOR_INTEL:
+		switch (modifier) {
+		case I915_FORMAT_MOD_Y_TILED_CCS:
+		case I915_FORMAT_MOD_Yf_TILED_CCS:
+		case I915_FORMAT_MOD_Y_TILED_GEN12_RC_CCS:
+		case I915_FORMAT_MOD_Y_TILED_GEN12_MC_CCS:
+		case I915_FORMAT_MOD_Y_TILED_GEN12_RC_CCS_CC:
+		case I915_FORMAT_MOD_4_TILED_DG2_RC_CCS:
+		case I915_FORMAT_MOD_4_TILED_DG2_MC_CCS:
+		case I915_FORMAT_MOD_4_TILED_DG2_RC_CCS_CC:
+		case I915_FORMAT_MOD_4_TILED_MTL_RC_CCS:
+		case I915_FORMAT_MOD_4_TILED_MTL_MC_CCS:
+		case I915_FORMAT_MOD_4_TILED_MTL_RC_CCS_CC:
+			return true;
+		default:
+			return false;
+		}
+	default:
+		return false;
+	}
+}
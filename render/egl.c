@@ -1,8 +1,10 @@
 #include <assert.h>
 #include <drm_fourcc.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <gbm.h>
 #include <wlr/render/egl.h>
@@ -10,6 +12,7 @@
 #include <wlr/util/region.h>
 #include <xf86drm.h>
 #include "render/egl.h"
+#include "util/cache.h"
 #include "util/env.h"
 
 static enum wlr_log_importance egl_log_importance_to_wlr(EGLint type) {
@@ -105,7 +108,211 @@ static void log_modifier(uint64_t modifier, bool external_only) {
 	free(mod_name);
 }
 
-static void init_dmabuf_formats(struct wlr_egl *egl) {
+#define FORMAT_CACHE_MAGIC 0x57454631 // "WEF1"
+
+// Header of the DMA-BUF format cache files, followed by the entries
+struct format_cache_header {
+	uint32_t magic;
+	uint32_t entries_len;
+	uint64_t key;
+};
+
+struct format_cache_entry {
+	uint32_t format;
+	uint32_t external_only;
+	uint64_t modifier;
+};
+
+// Results of the DMA-BUF modifier queries, which take hundreds of driver
+// round-trips on some systems. Only the format list is queried on startup,
+// the modifiers are loaded from the cache if the driver didn't change.
+// There is one file per device, overwritten when the driver changes.
+struct format_cache {
+	char *path;
+	uint64_t key;
+	bool loaded;
+	bool incomplete;
+	struct wl_array entries; // struct format_cache_entry
+};
+
+static void format_cache_init(struct format_cache *cache, struct wlr_egl *egl,
+		const char *driver_name, const EGLint *formats, int formats_len) {
+	*cache = (struct format_cache){0};
+	wl_array_init(&cache->entries);
+
+	if (env_parse_bool("WLR_EGL_NO_FORMAT_CACHE")) {
+		return;
+	}
+
+	const char *device_name = NULL;
+	if (egl->exts.EXT_device_drm) {
+		device_name = egl->procs.eglQueryDeviceStringEXT(egl->device,
+			EGL_DRM_DEVICE_FILE_EXT);
+	}
+	const char *strs[] = {
+		eglQueryString(egl->display, EGL_VENDOR),
+		eglQueryString(egl->display, EGL_VERSION),
+		eglQueryString(egl->display, EGL_EXTENSIONS),
+		driver_name != NULL ? driver_name : "",
+		device_name != NULL ? device_name : "",
+	};
+	uint64_t key = CACHE_HASH_INIT;
+	for (size_t i = 0; i < sizeof(strs) / sizeof(strs[0]); i++) {
+		if (strs[i] == NULL) {
+			return;
+		}
+		key = cache_hash_str(key, strs[i]);
+	}
+	// Driver updates which change the supported modifiers usually change
+	// the format list too
+	key = cache_hash(key, formats, formats_len * sizeof(formats[0]));
+
+	// The kernel driver can restrict the modifiers as well
+	int drm_fd = wlr_egl_dup_drm_fd(egl);
+	if (drm_fd >= 0) {
+		drmVersion *version = drmGetVersion(drm_fd);
+		close(drm_fd);
+		if (version == NULL) {
+			return;
+		}
+		int numbers[] = {
+			version->version_major,
+			version->version_minor,
+			version->version_patchlevel,
+		};
+		key = cache_hash_str(key, version->name != NULL ? version->name : "");
+		key = cache_hash_str(key, version->date != NULL ? version->date : "");
+		key = cache_hash(key, numbers, sizeof(numbers));
+		drmFreeVersion(version);
+	}
+
+	// Name the file after the device only, the key is checked on load
+	uint64_t device_key = CACHE_HASH_INIT;
+	device_key = cache_hash_str(device_key, strs[0]);
+	device_key = cache_hash_str(device_key, strs[3]);
+	device_key = cache_hash_str(device_key, strs[4]);
+
+	char name[64];
+	snprintf(name, sizeof(name), "egl-dmabuf-formats-%016" PRIx64, device_key);
+	cache->path = cache_file_get_path(name);
+	cache->key = key;
+	if (cache->path == NULL) {
+		return;
+	}
+
+	size_t size = 0;
+	struct format_cache_header *header = cache_file_read(cache->path, &size);
+	if (header == NULL) {
+		return;
+	}
+
+	size_t entries_size = size - sizeof(*header);
+	if (size < sizeof(*header) || header->magic != FORMAT_CACHE_MAGIC ||
+			header->key != key ||
+			entries_size != header->entries_len * sizeof(struct format_cache_entry)) {
+		wlr_log(WLR_DEBUG, "Ignoring outdated format cache file %s", cache->path);
+		free(header);
+		return;
+	}
+
+	void *entries = wl_array_add(&cache->entries, entries_size);
+	if (entries_size > 0 && entries == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(header);
+		return;
+	}
+	memcpy(entries, header + 1, entries_size);
+	free(header);
+
+	wlr_log(WLR_DEBUG, "Loaded DMA-BUF modifiers from %s", cache->path);
+	cache->loaded = true;
+}
+
+static int format_cache_get_modifiers(struct format_cache *cache, EGLint format,
+		uint64_t **modifiers, EGLBoolean **external_only) {
+	*modifiers = NULL;
+	*external_only = NULL;
+
+	int num = 0;
+	const struct format_cache_entry *entry;
+	wl_array_for_each(entry, &cache->entries) {
+		if (entry->format == (uint32_t)format) {
+			num++;
+		}
+	}
+	if (num == 0) {
+		return 0;
+	}
+
+	*modifiers = calloc(num, sizeof(**modifiers));
+	*external_only = calloc(num, sizeof(**external_only));
+	if (*modifiers == NULL || *external_only == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(*modifiers);
+		free(*external_only);
+		*modifiers = NULL;
+		*external_only = NULL;
+		return -1;
+	}
+
+	int i = 0;
+	wl_array_for_each(entry, &cache->entries) {
+		if (entry->format == (uint32_t)format) {
+			(*modifiers)[i] = entry->modifier;
+			(*external_only)[i] = entry->external_only;
+			i++;
+		}
+	}
+	return num;
+}
+
+static void format_cache_add(struct format_cache *cache, EGLint format,
+		const uint64_t *modifiers, const EGLBoolean *external_only,
+		int modifiers_len) {
+	if (modifiers_len < 0) {
+		// Don't store results which would be different next time
+		cache->incomplete = true;
+		return;
+	}
+
+	struct format_cache_entry *entries = wl_array_add(&cache->entries,
+		modifiers_len * sizeof(*entries));
+	if (modifiers_len > 0 && entries == NULL) {
+		cache->incomplete = true;
+		return;
+	}
+	for (int i = 0; i < modifiers_len; i++) {
+		entries[i] = (struct format_cache_entry){
+			.format = format,
+			.external_only = external_only[i],
+			.modifier = modifiers[i],
+		};
+	}
+}
+
+static void format_cache_finish(struct format_cache *cache) {
+	if (cache->path != NULL && !cache->loaded && !cache->incomplete) {
+		size_t size = sizeof(struct format_cache_header) + cache->entries.size;
+		struct format_cache_header *header = malloc(size);
+		if (header != NULL) {
+			*header = (struct format_cache_header){
+				.magic = FORMAT_CACHE_MAGIC,
+				.entries_len = cache->entries.size / sizeof(struct format_cache_entry),
+				.key = cache->key,
+			};
+			memcpy(header + 1, cache->entries.data, cache->entries.size);
+			cache_file_write(cache->path, header, size);
+			free(header);
+		} else {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+		}
+	}
+
+	wl_array_release(&cache->entries);
+	free(cache->path);
+}
+
+static void init_dmabuf_formats(struct wlr_egl *egl, const char *driver_name) {
 	bool no_modifiers = env_parse_bool("WLR_EGL_NO_MODIFIERS");
 	if (no_modifiers) {
 		wlr_log(WLR_INFO, "WLR_EGL_NO_MODIFIERS set, disabling modifiers for EGL");
@@ -117,6 +324,12 @@ static void init_dmabuf_formats(struct wlr_egl *egl) {
 		return;
 	}
 
+	struct format_cache cache = {0};
+	bool use_cache = !no_modifiers && egl->exts.EXT_image_dma_buf_import_modifiers;
+	if (use_cache) {
+		format_cache_init(&cache, egl, driver_name, formats, formats_len);
+	}
+
 	wlr_log(WLR_DEBUG, "Supported DMA-BUF formats:");
 
 	bool has_modifiers = false;
@@ -126,8 +339,15 @@ static void init_dmabuf_formats(struct wlr_egl *egl) {
 		uint64_t *modifiers = NULL;
 		EGLBoolean *external_only = NULL;
 		int modifiers_len = 0;
-		if (!no_modifiers) {
+		if (cache.loaded) {
+			modifiers_len = format_cache_get_modifiers(&cache, fmt,
+				&modifiers, &external_only);
+		} else if (!no_modifiers) {
 			modifiers_len = get_egl_dmabuf_modifiers(egl, fmt, &modifiers, &external_only);
+			if (use_cache) {
+				format_cache_add(&cache, fmt, modifiers, external_only,
+					modifiers_len);
+			}
 		}
 		if (modifiers_len < 0) {
 			continue;
@@ -164,7 +384,7 @@ static void init_dmabuf_formats(struct wlr_egl *egl) {
 				DRM_FORMAT_MOD_LINEAR);
 		}
 
-		if (wlr_log_get_verbosity() >= WLR_DEBUG) {
+		if (wlr_log_enabled(WLR_DEBUG)) {
 			char *fmt_name = drmGetFormatName(fmt);
 			wlr_log(WLR_DEBUG, "  %s (0x%08"PRIX32")",
 				fmt_name ? fmt_name : "<unknown>", fmt);
@@ -183,6 +403,9 @@ static void init_dmabuf_formats(struct wlr_egl *egl) {
 		free(external_only);
 	}
 	free(formats);
+	if (use_cache) {
+		format_cache_finish(&cache);
+	}
 
 	egl->has_modifiers = has_modifiers;
 	if (!no_modifiers) {
@@ -376,7 +599,7 @@ static bool egl_init_display(struct wlr_egl *egl, EGLDisplay display) {
 		wlr_log(WLR_INFO, "EGL driver name: %s", driver_name);
 	}
 
-	init_dmabuf_formats(egl);
+	init_dmabuf_formats(egl, driver_name);
 
 	return true;
 }
@@ -689,12 +912,25 @@ bool wlr_egl_destroy_image(struct wlr_egl *egl, EGLImage image) {
 
 bool wlr_egl_make_current(struct wlr_egl *egl,
 		struct wlr_egl_context *save_context) {
+	struct wlr_egl_context current = {
+		.display = eglGetCurrentDisplay(),
+		.context = eglGetCurrentContext(),
+		.draw_surface = eglGetCurrentSurface(EGL_DRAW),
+		.read_surface = eglGetCurrentSurface(EGL_READ),
+	};
 	if (save_context != NULL) {
-		save_context->display = eglGetCurrentDisplay();
-		save_context->context = eglGetCurrentContext();
-		save_context->draw_surface = eglGetCurrentSurface(EGL_DRAW);
-		save_context->read_surface = eglGetCurrentSurface(EGL_READ);
+		*save_context = current;
 	}
+
+	// The current context is per-thread EGL state, querying it is much
+	// cheaper than a redundant eglMakeCurrent() call: drivers flush and
+	// re-validate state on each call
+	if (current.display == egl->display && current.context == egl->context &&
+			current.draw_surface == EGL_NO_SURFACE &&
+			current.read_surface == EGL_NO_SURFACE) {
+		return true;
+	}
+
 	if (!eglMakeCurrent(egl->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
 			egl->context)) {
 		wlr_log(WLR_ERROR, "eglMakeCurrent failed");
@@ -726,10 +962,38 @@ bool wlr_egl_restore_context(struct wlr_egl_context *context) {
 		return true;
 	}
 
+	if (display == eglGetCurrentDisplay() &&
+			context->context == eglGetCurrentContext() &&
+			context->draw_surface == eglGetCurrentSurface(EGL_DRAW) &&
+			context->read_surface == eglGetCurrentSurface(EGL_READ)) {
+		return true;
+	}
+
 	return eglMakeCurrent(display, context->draw_surface,
 			context->read_surface, context->context);
 }
 
+bool wlr_egl_begin_current(struct wlr_egl *egl) {
+	if (egl->current_scope.depth > 0) {
+		egl->current_scope.depth++;
+		return true;
+	}
+
+	if (!wlr_egl_make_current(egl, &egl->current_scope.prev)) {
+		return false;
+	}
+	egl->current_scope.depth = 1;
+	return true;
+}
+
+void wlr_egl_end_current(struct wlr_egl *egl) {
+	assert(egl->current_scope.depth > 0);
+	egl->current_scope.depth--;
+	if (egl->current_scope.depth == 0) {
+		wlr_egl_restore_context(&egl->current_scope.prev);
+	}
+}
+
 EGLImageKHR wlr_egl_create_image_from_dmabuf(struct wlr_egl *egl,
 		struct wlr_dmabuf_attributes *attributes, bool *external_only) {
 	if (!egl->exts.KHR_image_base || !egl->exts.EXT_image_dma_buf_import) {
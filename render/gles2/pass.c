@@ -1,5 +1,7 @@
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <math.h>
 #include <pixman.h>
 #include <time.h>
 #include <unistd.h>
@@ -10,10 +12,10 @@
 #include "render/gles2.h"
 #include "types/wlr_matrix.h"
 
-#define MAX_QUADS 86 // 4kb
-
 static const struct wlr_render_pass_impl render_pass_impl;
 
+static void flush_batch(struct wlr_gles2_render_pass *pass);
+
 static struct wlr_gles2_render_pass *get_render_pass(struct wlr_render_pass *wlr_pass) {
 	assert(wlr_pass->impl == &render_pass_impl);
 	struct wlr_gles2_render_pass *pass = wl_container_of(wlr_pass, pass, base);
@@ -26,6 +28,9 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 	struct wlr_gles2_render_timer *timer = pass->timer;
 	bool ok = false;
 
+	flush_batch(pass);
+	wl_array_release(&pass->batch.vertices);
+
 	push_gles2_debug(renderer);
 
 	if (timer) {
@@ -76,7 +81,108 @@ out:
 	return ok;
 }
 
-static void render(const struct wlr_box *box, const pixman_region32_t *clip, GLint attrib) {
+static void setup_blending(enum wlr_render_blend_mode mode) {
+	switch (mode) {
+	case WLR_RENDER_BLEND_MODE_PREMULTIPLIED:
+		glEnable(GL_BLEND);
+		break;
+	case WLR_RENDER_BLEND_MODE_NONE:
+		glDisable(GL_BLEND);
+		break;
+	}
+}
+
+static void flush_batch(struct wlr_gles2_render_pass *pass) {
+	struct wlr_gles2_renderer *renderer = pass->buffer->renderer;
+	struct wlr_gles2_render_batch *batch = &pass->batch;
+
+	const size_t vert_size = 4 * sizeof(GLfloat);
+	size_t verts_len = batch->vertices.size / vert_size;
+	if (verts_len == 0) {
+		return;
+	}
+
+	push_gles2_debug(renderer);
+	setup_blending(batch->blend_mode);
+
+	struct wlr_gles2_texture *texture = batch->texture;
+	GLint pos_attrib, texcoord_attrib = -1;
+	if (texture != NULL) {
+		const struct wlr_gles2_tex_shader *shader = batch->shader;
+		glUseProgram(shader->program);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(texture->target, texture->tex);
+
+		switch (batch->filter_mode) {
+		case WLR_SCALE_FILTER_BILINEAR:
+			glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER,
+				batch->mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+			glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			break;
+		case WLR_SCALE_FILTER_NEAREST:
+			glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			break;
+		}
+
+		glUniform1i(shader->tex, 0);
+		glUniform1f(shader->alpha, batch->alpha);
+		glUniformMatrix3fv(shader->proj, 1, GL_FALSE, pass->projection_matrix);
+		pos_attrib = shader->pos_attrib;
+		texcoord_attrib = shader->texcoord_attrib;
+	} else {
+		const struct wlr_render_color *color = &batch->color;
+		glUseProgram(renderer->shaders.quad.program);
+		glUniformMatrix3fv(renderer->shaders.quad.proj, 1, GL_FALSE,
+			pass->projection_matrix);
+		glUniform4f(renderer->shaders.quad.color, color->r, color->g, color->b, color->a);
+		pos_attrib = renderer->shaders.quad.pos_attrib;
+	}
+
+	const GLfloat *verts = batch->vertices.data;
+	glEnableVertexAttribArray(pos_attrib);
+	glVertexAttribPointer(pos_attrib, 2, GL_FLOAT, GL_FALSE, vert_size, verts);
+	if (texcoord_attrib >= 0) {
+		glEnableVertexAttribArray(texcoord_attrib);
+		glVertexAttribPointer(texcoord_attrib, 2, GL_FLOAT, GL_FALSE,
+			vert_size, verts + 2);
+	}
+
+	glDrawArrays(GL_TRIANGLES, 0, verts_len);
+
+	glDisableVertexAttribArray(pos_attrib);
+	if (texcoord_attrib >= 0) {
+		glDisableVertexAttribArray(texcoord_attrib);
+	}
+	if (texture != NULL) {
+		glBindTexture(texture->target, 0);
+	}
+
+	batch->vertices.size = 0;
+	pop_gles2_debug(renderer);
+}
+
+static void push_vertex(GLfloat **verts, int x, int y,
+		const struct wlr_box *box, const float tex_matrix[static 9]) {
+	GLfloat *v = *verts;
+	GLfloat u = (GLfloat)(x - box->x) / box->width;
+	GLfloat t = (GLfloat)(y - box->y) / box->height;
+	v[0] = x;
+	v[1] = y;
+	v[2] = tex_matrix[0] * u + tex_matrix[1] * t + tex_matrix[2];
+	v[3] = tex_matrix[3] * u + tex_matrix[4] * t + tex_matrix[5];
+	*verts = v + 4;
+}
+
+/**
+ * Append the quads covering the box, clipped, to the current batch. Vertices
+ * are in buffer coordinates, texture coordinates are computed by applying
+ * the texture matrix to the position relative to the box.
+ */
+static void batch_add_quads(struct wlr_gles2_render_batch *batch,
+		const struct wlr_box *box, const pixman_region32_t *clip,
+		const float tex_matrix[static 9]) {
 	pixman_region32_t region;
 	pixman_region32_init_rect(&region, box->x, box->y, box->width, box->height);
 
@@ -91,52 +197,30 @@ static void render(const struct wlr_box *box, const pixman_region32_t *clip, GLi
 		return;
 	}
 
-	glEnableVertexAttribArray(attrib);
-
-	for (int i = 0; i < rects_len;) {
-		int batch = rects_len - i < MAX_QUADS ? rects_len - i : MAX_QUADS;
-		int batch_end = batch + i;
-
-		size_t vert_index = 0;
-		GLfloat verts[MAX_QUADS * 6 * 2];
-		for (; i < batch_end; i++) {
-			const pixman_box32_t *rect = &rects[i];
-
-			verts[vert_index++] = (GLfloat)(rect->x1 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y1 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x2 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y1 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x1 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y2 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x2 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y1 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x2 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y2 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x1 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y2 - box->y) / box->height;
-		}
-
-		glVertexAttribPointer(attrib, 2, GL_FLOAT, GL_FALSE, 0, verts);
-		glDrawArrays(GL_TRIANGLES, 0, batch * 6);
+	GLfloat *verts = wl_array_add(&batch->vertices,
+		rects_len * 6 * 4 * sizeof(GLfloat));
+	if (verts == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		pixman_region32_fini(&region);
+		return;
 	}
 
-	glDisableVertexAttribArray(attrib);
+	for (int i = 0; i < rects_len; i++) {
+		const pixman_box32_t *rect = &rects[i];
 
-	pixman_region32_fini(&region);
-}
+		push_vertex(&verts, rect->x1, rect->y1, box, tex_matrix);
+		push_vertex(&verts, rect->x2, rect->y1, box, tex_matrix);
+		push_vertex(&verts, rect->x1, rect->y2, box, tex_matrix);
+		push_vertex(&verts, rect->x2, rect->y1, box, tex_matrix);
+		push_vertex(&verts, rect->x2, rect->y2, box, tex_matrix);
+		push_vertex(&verts, rect->x1, rect->y2, box, tex_matrix);
+	}
 
-static void set_proj_matrix(GLint loc, float proj[9], const struct wlr_box *box) {
-	float gl_matrix[9];
-	wlr_matrix_identity(gl_matrix);
-	wlr_matrix_translate(gl_matrix, box->x, box->y);
-	wlr_matrix_scale(gl_matrix, box->width, box->height);
-	wlr_matrix_multiply(gl_matrix, proj, gl_matrix);
-	glUniformMatrix3fv(loc, 1, GL_FALSE, gl_matrix);
+	pixman_region32_fini(&region);
 }
 
-static void set_tex_matrix(GLint loc, enum wl_output_transform trans,
+static void get_tex_matrix(float tex_matrix[static 9], enum wl_output_transform trans,
 		const struct wlr_fbox *box) {
-	float tex_matrix[9];
 	wlr_matrix_identity(tex_matrix);
 	wlr_matrix_translate(tex_matrix, box->x, box->y);
 	wlr_matrix_scale(tex_matrix, box->width, box->height);
@@ -150,19 +234,39 @@ static void set_tex_matrix(GLint loc, enum wl_output_transform trans,
 		wlr_matrix_transform(tex_matrix, trans);
 	}
 	wlr_matrix_translate(tex_matrix, -.5, -.5);
+}
 
-	glUniformMatrix3fv(loc, 1, GL_FALSE, tex_matrix);
+static bool is_integer(double v) {
+	return v == (double)(int64_t)v;
 }
 
-static void setup_blending(enum wlr_render_blend_mode mode) {
-	switch (mode) {
-	case WLR_RENDER_BLEND_MODE_PREMULTIPLIED:
-		glEnable(GL_BLEND);
-		break;
-	case WLR_RENDER_BLEND_MODE_NONE:
-		glDisable(GL_BLEND);
-		break;
+static bool is_texel_aligned(const struct wlr_fbox *src_box,
+		const struct wlr_box *dst_box, enum wl_output_transform transform) {
+	if (!is_integer(src_box->x) || !is_integer(src_box->y) ||
+			!is_integer(src_box->width) || !is_integer(src_box->height)) {
+		return false;
+	}
+
+	int dst_width = dst_box->width, dst_height = dst_box->height;
+	if (transform & WL_OUTPUT_TRANSFORM_90) {
+		dst_width = dst_box->height;
+		dst_height = dst_box->width;
 	}
+	return src_box->width == dst_width && src_box->height == dst_height;
+}
+
+// Downscaling by at least this factor samples from mipmaps
+#define MIPMAP_MIN_SCALE_FACTOR 2
+
+static bool is_heavily_downscaled(const struct wlr_fbox *src_box,
+		const struct wlr_box *dst_box, enum wl_output_transform transform) {
+	int dst_width = dst_box->width, dst_height = dst_box->height;
+	if (transform & WL_OUTPUT_TRANSFORM_90) {
+		dst_width = dst_box->height;
+		dst_height = dst_box->width;
+	}
+	return src_box->width >= MIPMAP_MIN_SCALE_FACTOR * dst_width ||
+		src_box->height >= MIPMAP_MIN_SCALE_FACTOR * dst_height;
 }
 
 static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
@@ -171,115 +275,406 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 	struct wlr_gles2_renderer *renderer = pass->buffer->renderer;
 	struct wlr_gles2_texture *texture = gles2_get_texture(options->texture);
 
-	struct wlr_gles2_tex_shader *shader = NULL;
+	struct wlr_box dst_box;
+	struct wlr_fbox src_fbox;
+	wlr_render_texture_options_get_src_box(options, &src_fbox);
+	wlr_render_texture_options_get_dst_box(options, &dst_box);
+	float alpha = wlr_render_texture_options_get_alpha(options);
 
+	// Skip the alpha multiplication for fully opaque draws
+	bool no_alpha = alpha == 1.0;
+	struct wlr_gles2_tex_shader *shader = NULL;
 	switch (texture->target) {
 	case GL_TEXTURE_2D:
 		if (texture->has_alpha) {
-			shader = &renderer->shaders.tex_rgba;
+			shader = no_alpha ? &renderer->shaders.tex_rgba_no_alpha :
+				&renderer->shaders.tex_rgba;
 		} else {
-			shader = &renderer->shaders.tex_rgbx;
+			shader = no_alpha ? &renderer->shaders.tex_rgbx_no_alpha :
+				&renderer->shaders.tex_rgbx;
 		}
 		break;
 	case GL_TEXTURE_EXTERNAL_OES:
 		// EGL_EXT_image_dma_buf_import_modifiers requires
 		// GL_OES_EGL_image_external
 		assert(renderer->exts.OES_egl_image_external);
-		shader = &renderer->shaders.tex_ext;
+		shader = no_alpha ? &renderer->shaders.tex_ext_no_alpha :
+			&renderer->shaders.tex_ext;
 		break;
 	default:
 		abort();
 	}
 
-	struct wlr_box dst_box;
-	struct wlr_fbox src_fbox;
-	wlr_render_texture_options_get_src_box(options, &src_fbox);
-	wlr_render_texture_options_get_dst_box(options, &dst_box);
-	float alpha = wlr_render_texture_options_get_alpha(options);
+	// When texels map one-to-one to pixels, every fragment samples a texel
+	// center and bilinear filtering gives the same result as nearest
+	// sampling, which is cheaper
+	enum wlr_scale_filter_mode filter_mode = options->filter_mode;
+	if (filter_mode == WLR_SCALE_FILTER_BILINEAR &&
+			is_texel_aligned(&src_fbox, &dst_box, options->transform)) {
+		filter_mode = WLR_SCALE_FILTER_NEAREST;
+	}
 
-	src_fbox.x /= options->texture->width;
-	src_fbox.y /= options->texture->height;
-	src_fbox.width /= options->texture->width;
-	src_fbox.height /= options->texture->height;
+	// Plain bilinear sampling of a heavily minified texture skips texels,
+	// which aliases and thrashes the texture cache
+	bool mipmap = filter_mode == WLR_SCALE_FILTER_BILINEAR &&
+		is_heavily_downscaled(&src_fbox, &dst_box, options->transform) &&
+		gles2_texture_ensure_mipmaps(texture);
+
+	// Cropped textures only store the crop
+	const struct wlr_box *crop = &options->texture->crop;
+	double tex_width = options->texture->width;
+	double tex_height = options->texture->height;
+	if (!wlr_box_empty(crop)) {
+		src_fbox.x -= crop->x;
+		src_fbox.y -= crop->y;
+		tex_width = crop->width;
+		tex_height = crop->height;
+	}
 
-	push_gles2_debug(renderer);
+	src_fbox.x /= tex_width;
+	src_fbox.y /= tex_height;
+	src_fbox.width /= tex_width;
+	src_fbox.height /= tex_height;
+
+	enum wlr_render_blend_mode blend_mode = !texture->has_alpha && no_alpha ?
+		WLR_RENDER_BLEND_MODE_NONE : options->blend_mode;
+
+	// Consecutive draws of the same texture with the same state are merged
+	// into a single draw call
+	struct wlr_gles2_render_batch *batch = &pass->batch;
+	if (batch->texture != texture || batch->shader != shader ||
+			batch->filter_mode != filter_mode || batch->mipmap != mipmap ||
+			batch->blend_mode != blend_mode || batch->alpha != alpha) {
+		flush_batch(pass);
+		batch->texture = texture;
+		batch->shader = shader;
+		batch->filter_mode = filter_mode;
+		batch->mipmap = mipmap;
+		batch->blend_mode = blend_mode;
+		batch->alpha = alpha;
+	}
 
 	if (options->wait_timeline != NULL) {
+		push_gles2_debug(renderer);
+
 		int sync_file_fd =
 			wlr_drm_syncobj_timeline_export_sync_file(options->wait_timeline, options->wait_point);
 		if (sync_file_fd < 0) {
+			pop_gles2_debug(renderer);
 			return;
 		}
 
 		EGLSyncKHR sync = wlr_egl_create_sync(renderer->egl, sync_file_fd);
 		close(sync_file_fd);
 		if (sync == EGL_NO_SYNC_KHR) {
+			pop_gles2_debug(renderer);
 			return;
 		}
 
 		bool ok = wlr_egl_wait_sync(renderer->egl, sync);
 		wlr_egl_destroy_sync(renderer->egl, sync);
+		pop_gles2_debug(renderer);
 		if (!ok) {
 			return;
 		}
 	}
 
-	setup_blending(!texture->has_alpha && alpha == 1.0 ?
-		WLR_RENDER_BLEND_MODE_NONE : options->blend_mode);
+	float tex_matrix[9];
+	get_tex_matrix(tex_matrix, options->transform, &src_fbox);
+	batch_add_quads(batch, &dst_box, options->clip, tex_matrix);
+}
 
-	glUseProgram(shader->program);
+static void render_pass_add_rect(struct wlr_render_pass *wlr_pass,
+		const struct wlr_render_rect_options *options) {
+	struct wlr_gles2_render_pass *pass = get_render_pass(wlr_pass);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(texture->target, texture->tex);
+	const struct wlr_render_color *color = &options->color;
+	struct wlr_box box;
+	wlr_render_rect_options_get_box(options, pass->buffer->buffer, &box);
 
-	switch (options->filter_mode) {
-	case WLR_SCALE_FILTER_BILINEAR:
-		glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		break;
-	case WLR_SCALE_FILTER_NEAREST:
-		glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		break;
+	enum wlr_render_blend_mode blend_mode = color->a == 1.0 ?
+		WLR_RENDER_BLEND_MODE_NONE : options->blend_mode;
+
+	struct wlr_gles2_render_batch *batch = &pass->batch;
+	if (batch->texture != NULL || batch->blend_mode != blend_mode ||
+			memcmp(&batch->color, color, sizeof(*color)) != 0) {
+		flush_batch(pass);
+		batch->texture = NULL;
+		batch->shader = NULL;
+		batch->blend_mode = blend_mode;
+		batch->color = *color;
 	}
 
+	float tex_matrix[9] = {0};
+	batch_add_quads(batch, &box, options->clip, tex_matrix);
+}
+
+static void draw_triangles(GLint pos_attrib, GLint texcoord_attrib,
+		const GLfloat *verts, size_t verts_len) {
+	const size_t vert_size = 4 * sizeof(GLfloat);
+	glEnableVertexAttribArray(pos_attrib);
+	glVertexAttribPointer(pos_attrib, 2, GL_FLOAT, GL_FALSE, vert_size, verts);
+	glEnableVertexAttribArray(texcoord_attrib);
+	glVertexAttribPointer(texcoord_attrib, 2, GL_FLOAT, GL_FALSE,
+		vert_size, verts + 2);
+
+	glDrawArrays(GL_TRIANGLES, 0, verts_len);
+
+	glDisableVertexAttribArray(pos_attrib);
+	glDisableVertexAttribArray(texcoord_attrib);
+}
+
+static void use_blur_shader(const struct wlr_gles2_blur_shader *shader,
+		const float proj[static 9], GLuint tex, int width, int height,
+		float offset, float mask_radius) {
+	glUseProgram(shader->program);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, tex);
+
 	glUniform1i(shader->tex, 0);
-	glUniform1f(shader->alpha, alpha);
-	set_proj_matrix(shader->proj, pass->projection_matrix, &dst_box);
-	set_tex_matrix(shader->tex_proj, options->transform, &src_fbox);
+	glUniformMatrix3fv(shader->proj, 1, GL_FALSE, proj);
+	glUniform2f(shader->halfpixel, 0.5 / width, 0.5 / height);
+	glUniform1f(shader->offset, offset);
+	if (shader->mask_radius >= 0) {
+		glUniform1f(shader->mask_radius, mask_radius);
+	}
+}
 
-	render(&dst_box, options->clip, shader->pos_attrib);
+// Render a step of the blur, covering a whole intermediate framebuffer
+static void render_blur_step(const struct wlr_gles2_blur_shader *shader,
+		GLuint fbo, int width, int height, GLuint tex, float offset) {
+	const GLfloat verts[] = {
+		0, 0, 0, 0,
+		width, 0, 1, 0,
+		0, height, 0, 1,
+		width, 0, 1, 0,
+		width, height, 1, 1,
+		0, height, 0, 1,
+	};
+
+	float proj[9];
+	matrix_projection(proj, width, height, WL_OUTPUT_TRANSFORM_FLIPPED_180);
 
-	glBindTexture(texture->target, 0);
-	pop_gles2_debug(renderer);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, width, height);
+	use_blur_shader(shader, proj, tex, width, height, offset, 0);
+	draw_triangles(shader->pos_attrib, shader->texcoord_attrib, verts, 6);
 }
 
-static void render_pass_add_rect(struct wlr_render_pass *wlr_pass,
-		const struct wlr_render_rect_options *options) {
+#define BLUR_MAX_PASSES 8
+
+static bool render_pass_add_blur(struct wlr_render_pass *wlr_pass,
+		const struct wlr_render_blur_options *options) {
 	struct wlr_gles2_render_pass *pass = get_render_pass(wlr_pass);
 	struct wlr_gles2_renderer *renderer = pass->buffer->renderer;
+	struct wlr_buffer *buffer = pass->buffer->buffer;
+	const struct wlr_gles2_blur_shader *down = &renderer->shaders.blur_down;
+	const struct wlr_gles2_blur_shader *up = &renderer->shaders.blur_up;
+	if (down->program == 0 || up->program == 0) {
+		return false;
+	}
 
-	const struct wlr_render_color *color = &options->color;
-	struct wlr_box box;
-	wlr_render_rect_options_get_box(options, pass->buffer->buffer, &box);
+	flush_batch(pass);
+
+	pixman_region32_t region;
+	pixman_region32_init_rect(&region, options->box.x, options->box.y,
+		options->box.width, options->box.height);
+	pixman_region32_intersect_rect(&region, &region,
+		0, 0, buffer->width, buffer->height);
+	if (options->clip) {
+		pixman_region32_intersect(&region, &region, options->clip);
+	}
+	if (!pixman_region32_not_empty(&region)) {
+		pixman_region32_fini(&region);
+		return true;
+	}
+
+	float offset = options->offset > 0 ? options->offset : 1;
+
+	// Pixels this far away from the blurred area contribute to the result,
+	// the sample distance doubles at each step
+	int margin = ceilf(offset * (2 << options->passes));
+	const pixman_box32_t *extents = pixman_region32_extents(&region);
+	struct wlr_box src = {
+		.x = extents->x1 - margin,
+		.y = extents->y1 - margin,
+		.width = extents->x2 - extents->x1 + 2 * margin,
+		.height = extents->y2 - extents->y1 + 2 * margin,
+	};
+	wlr_box_intersection(&src, &src, &(struct wlr_box){
+		.width = buffer->width,
+		.height = buffer->height,
+	});
+
+	// Level 0 holds a copy of the source pixels, each following level is
+	// half the size of the previous one
+	int widths[BLUR_MAX_PASSES + 1], heights[BLUR_MAX_PASSES + 1];
+	widths[0] = src.width;
+	heights[0] = src.height;
+	int passes = 0;
+	while (passes < options->passes &&
+			(widths[passes] > 1 || heights[passes] > 1)) {
+		passes++;
+		widths[passes] = widths[passes - 1] > 1 ? widths[passes - 1] / 2 : 1;
+		heights[passes] = heights[passes - 1] > 1 ? heights[passes - 1] / 2 : 1;
+	}
 
 	push_gles2_debug(renderer);
-	setup_blending(color->a == 1.0 ? WLR_RENDER_BLEND_MODE_NONE : options->blend_mode);
 
-	glUseProgram(renderer->shaders.quad.program);
+	GLint alpha_bits = 0;
+	glGetIntegerv(GL_ALPHA_BITS, &alpha_bits);
+	GLenum format = alpha_bits > 0 ? GL_RGBA : GL_RGB;
+
+	bool ok = false;
+	GLuint textures[BLUR_MAX_PASSES + 1] = {0};
+	GLuint fbos[BLUR_MAX_PASSES + 1] = {0};
+	glGenTextures(passes + 1, textures);
+	glGenFramebuffers(passes + 1, fbos);
+	for (int i = 0; i <= passes; i++) {
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		if (i == 0) {
+			// The render pass framebuffer is still bound. Its rows are
+			// stored top to bottom, like buffer coordinates.
+			glCopyTexImage2D(GL_TEXTURE_2D, 0, format, src.x, src.y,
+				src.width, src.height, 0);
+			continue;
+		}
 
-	set_proj_matrix(renderer->shaders.quad.proj, pass->projection_matrix, &box);
-	glUniform4f(renderer->shaders.quad.color, color->r, color->g, color->b, color->a);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, widths[i], heights[i], 0,
+			format, GL_UNSIGNED_BYTE, NULL);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_2D, textures[i], 0);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			wlr_log(WLR_ERROR, "Failed to create blur FBO: 0x%X", status);
+			goto out;
+		}
+	}
+
+	glDisable(GL_BLEND);
+	for (int i = 1; i <= passes; i++) {
+		render_blur_step(down, fbos[i], widths[i], heights[i],
+			textures[i - 1], offset);
+	}
+	for (int i = passes - 1; i >= 1; i--) {
+		render_blur_step(up, fbos[i], widths[i], heights[i],
+			textures[i + 1], offset);
+	}
+
+	// The last upsampling step writes the blurred area into the render pass
+	// framebuffer, masked with the rounded corners
+	glBindFramebuffer(GL_FRAMEBUFFER, gles2_buffer_get_fbo(pass->buffer));
+	glViewport(0, 0, buffer->width, buffer->height);
+
+	int tex_level = passes > 0 ? 1 : 0;
+	use_blur_shader(up, pass->projection_matrix, textures[tex_level],
+		widths[tex_level] * 2, heights[tex_level] * 2, offset,
+		options->corner_radius);
+	if (options->corner_radius > 0) {
+		glUniform2f(up->tex_size, src.width, src.height);
+		glUniform4f(up->mask_box, options->box.x - src.x,
+			options->box.y - src.y, options->box.width, options->box.height);
+		glEnable(GL_BLEND);
+	}
+
+	struct wlr_gles2_render_batch *batch = &pass->batch;
+	const float tex_matrix[9] = {
+		1, 0, 0,
+		0, 1, 0,
+		0, 0, 1,
+	};
+	batch_add_quads(batch, &src, &region, tex_matrix);
+	draw_triangles(up->pos_attrib, up->texcoord_attrib, batch->vertices.data,
+		batch->vertices.size / (4 * sizeof(GLfloat)));
+	batch->vertices.size = 0;
+
+	ok = true;
 
-	render(&box, options->clip, renderer->shaders.quad.pos_attrib);
+out:
+	if (!ok) {
+		glBindFramebuffer(GL_FRAMEBUFFER, gles2_buffer_get_fbo(pass->buffer));
+		glViewport(0, 0, buffer->width, buffer->height);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDeleteFramebuffers(passes + 1, fbos);
+	glDeleteTextures(passes + 1, textures);
+	pop_gles2_debug(renderer);
+	pixman_region32_fini(&region);
+	return ok;
+}
+
+static bool render_pass_add_shadow(struct wlr_render_pass *wlr_pass,
+		const struct wlr_render_shadow_options *options) {
+	struct wlr_gles2_render_pass *pass = get_render_pass(wlr_pass);
+	struct wlr_gles2_renderer *renderer = pass->buffer->renderer;
+	const struct wlr_box *box = &options->box;
+	if (renderer->shaders.shadow.program == 0) {
+		return false;
+	}
+
+	flush_batch(pass);
+
+	float sigma = fmaxf(options->blur_sigma, 0.5);
+	int extent = ceilf(3 * sigma);
+	struct wlr_box area = {
+		.x = box->x - extent,
+		.y = box->y - extent,
+		.width = box->width + 2 * extent,
+		.height = box->height + 2 * extent,
+	};
+
+	// Texture coordinates are positions in buffer coordinates
+	const float tex_matrix[9] = {
+		area.width, 0, area.x,
+		0, area.height, area.y,
+		0, 0, 1,
+	};
+	struct wlr_gles2_render_batch *batch = &pass->batch;
+	batch_add_quads(batch, &area, options->clip, tex_matrix);
+	size_t verts_len = batch->vertices.size / (4 * sizeof(GLfloat));
+	if (verts_len == 0) {
+		return true;
+	}
+
+	int radius = options->corner_radius;
+	int max_radius = (box->width < box->height ? box->width : box->height) / 2;
+	if (radius > max_radius) {
+		radius = max_radius;
+	}
+
+	push_gles2_debug(renderer);
+	glEnable(GL_BLEND);
+
+	const struct wlr_render_color *color = &options->color;
+	glUseProgram(renderer->shaders.shadow.program);
+	glUniformMatrix3fv(renderer->shaders.shadow.proj, 1, GL_FALSE,
+		pass->projection_matrix);
+	glUniform4f(renderer->shaders.shadow.color, color->r, color->g, color->b, color->a);
+	glUniform4f(renderer->shaders.shadow.box, box->x, box->y, box->width, box->height);
+	glUniform1f(renderer->shaders.shadow.radius, radius);
+	glUniform1f(renderer->shaders.shadow.sigma, sigma);
+
+	draw_triangles(renderer->shaders.shadow.pos_attrib,
+		renderer->shaders.shadow.texcoord_attrib, batch->vertices.data, verts_len);
+	batch->vertices.size = 0;
 
 	pop_gles2_debug(renderer);
+	return true;
 }
 
 static const struct wlr_render_pass_impl render_pass_impl = {
 	.submit = render_pass_submit,
 	.add_texture = render_pass_add_texture,
 	.add_rect = render_pass_add_rect,
+	.add_blur = render_pass_add_blur,
+	.add_shadow = render_pass_add_shadow,
 };
 
 static const char *reset_status_str(GLenum status) {
@@ -321,6 +716,7 @@ struct wlr_gles2_render_pass *begin_gles2_buffer_pass(struct wlr_gles2_buffer *b
 	}
 
 	wlr_render_pass_init(&pass->base, &render_pass_impl);
+	wl_array_init(&pass->batch.vertices);
 	wlr_buffer_lock(wlr_buffer);
 	pass->buffer = buffer;
 	pass->timer = timer;
@@ -124,13 +124,18 @@ bool is_gles2_pixel_format_supported(const struct wlr_gles2_renderer *renderer,
 	return true;
 }
 
+static struct pixel_format_index formats_index = PIXEL_FORMAT_INDEX_INIT;
+
+static void build_formats_index(void) {
+	pixel_format_index_build(&formats_index, formats, sizeof(formats[0]),
+		offsetof(struct wlr_gles2_pixel_format, drm_format),
+		sizeof(formats) / sizeof(formats[0]));
+}
+
 const struct wlr_gles2_pixel_format *get_gles2_format_from_drm(uint32_t fmt) {
-	for (size_t i = 0; i < sizeof(formats) / sizeof(*formats); ++i) {
-		if (formats[i].drm_format == fmt) {
-			return &formats[i];
-		}
-	}
-	return NULL;
+	pthread_once(&formats_index.once, build_formats_index);
+	ptrdiff_t i = pixel_format_index_find(&formats_index, fmt);
+	return i >= 0 ? &formats[i] : NULL;
 }
 
 const struct wlr_gles2_pixel_format *get_gles2_format_from_gl(
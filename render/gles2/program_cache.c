@@ -0,0 +1,149 @@
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include "render/gles2.h"
+#include "util/cache.h"
+#include "util/env.h"
+
+#define PROGRAM_CACHE_MAGIC 0x57504731 // "WPG1"
+
+// Header of the program cache files, followed by the program binary
+struct program_cache_header {
+	uint32_t magic;
+	uint32_t format;
+	uint64_t key;
+};
+
+static uint64_t program_key(struct wlr_gles2_renderer *renderer,
+		const GLchar *vert_src, const GLchar *frag_src) {
+	uint64_t key = renderer->program_cache.driver_hash;
+	key = cache_hash_str(key, vert_src);
+	key = cache_hash_str(key, frag_src);
+	return key;
+}
+
+static char *program_path(uint64_t key) {
+	char name[64];
+	snprintf(name, sizeof(name), "gles2-program-%016" PRIx64, key);
+	return cache_file_get_path(name);
+}
+
+void gles2_program_cache_init(struct wlr_gles2_renderer *renderer) {
+	if (!renderer->exts.OES_get_program_binary ||
+			env_parse_bool("WLR_GLES2_NO_PROGRAM_CACHE")) {
+		return;
+	}
+
+	GLint n_formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &n_formats);
+	if (n_formats <= 0) {
+		wlr_log(WLR_DEBUG, "Driver doesn't support any program binary format");
+		return;
+	}
+
+	// Program binaries are only valid for the driver build which produced
+	// them: tie the cache files to the driver identification strings, so
+	// that updates and other GPUs use separate files
+	const char *strs[] = {
+		(const char *)glGetString(GL_VENDOR),
+		(const char *)glGetString(GL_RENDERER),
+		(const char *)glGetString(GL_VERSION),
+	};
+	uint64_t hash = CACHE_HASH_INIT;
+	for (size_t i = 0; i < sizeof(strs) / sizeof(strs[0]); i++) {
+		if (strs[i] == NULL) {
+			return;
+		}
+		hash = cache_hash_str(hash, strs[i]);
+	}
+
+	renderer->program_cache.enabled = true;
+	renderer->program_cache.driver_hash = hash;
+}
+
+GLuint gles2_program_cache_load(struct wlr_gles2_renderer *renderer,
+		const GLchar *vert_src, const GLchar *frag_src) {
+	if (!renderer->program_cache.enabled) {
+		return 0;
+	}
+
+	uint64_t key = program_key(renderer, vert_src, frag_src);
+	char *path = program_path(key);
+	if (path == NULL) {
+		return 0;
+	}
+
+	size_t size = 0;
+	struct program_cache_header *header = cache_file_read(path, &size);
+	if (header == NULL) {
+		free(path);
+		return 0;
+	}
+
+	GLuint prog = 0;
+	if (size <= sizeof(*header) || header->magic != PROGRAM_CACHE_MAGIC ||
+			header->key != key) {
+		wlr_log(WLR_DEBUG, "Ignoring invalid program cache file %s", path);
+		goto out;
+	}
+
+	prog = glCreateProgram();
+	renderer->procs.glProgramBinaryOES(prog, header->format, header + 1,
+		size - sizeof(*header));
+
+	// The driver rejects binaries it can't use (e.g. after an update which
+	// didn't change the version string): compile from source in that case
+	GLint ok;
+	glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+	if (ok == GL_FALSE) {
+		wlr_log(WLR_DEBUG, "Driver rejected program binary %s", path);
+		glDeleteProgram(prog);
+		prog = 0;
+	}
+
+out:
+	free(header);
+	free(path);
+	return prog;
+}
+
+void gles2_program_cache_store(struct wlr_gles2_renderer *renderer, GLuint prog,
+		const GLchar *vert_src, const GLchar *frag_src) {
+	if (!renderer->program_cache.enabled) {
+		return;
+	}
+
+	GLint len = 0;
+	glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH_OES, &len);
+	if (len <= 0) {
+		return;
+	}
+
+	uint64_t key = program_key(renderer, vert_src, frag_src);
+	struct program_cache_header *header = malloc(sizeof(*header) + len);
+	if (header == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+
+	GLenum format = 0;
+	GLsizei written = 0;
+	renderer->procs.glGetProgramBinaryOES(prog, len, &written, &format, header + 1);
+	if (written <= 0) {
+		free(header);
+		return;
+	}
+	header->magic = PROGRAM_CACHE_MAGIC;
+	header->format = format;
+	header->key = key;
+
+	char *path = program_path(key);
+	if (path != NULL) {
+		cache_file_write(path, header, sizeof(*header) + written);
+	}
+	free(path);
+	free(header);
+}
@@ -2,9 +2,12 @@
 #include <drm_fourcc.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 #include <wayland-server-protocol.h>
@@ -27,6 +30,9 @@
 #include "tex_rgba_frag_src.h"
 #include "tex_rgbx_frag_src.h"
 #include "tex_external_frag_src.h"
+#include "blur_down_frag_src.h"
+#include "blur_up_frag_src.h"
+#include "shadow_frag_src.h"
 
 static const struct wlr_renderer_impl renderer_impl;
 static const struct wlr_render_timer_impl render_timer_impl;
@@ -52,6 +58,111 @@ struct wlr_gles2_render_timer *gles2_get_render_timer(struct wlr_render_timer *w
 	return timer;
 }
 
+// Maximum number of EGLImages kept around without any buffer using them
+#define GLES2_IMAGE_CACHE_UNUSED_MAX 16
+
+static bool image_key_init(struct wlr_gles2_image_key *key,
+		const struct wlr_dmabuf_attributes *dmabuf) {
+	// Keys are compared with memcmp(), make sure the padding is zeroed
+	memset(key, 0, sizeof(*key));
+	key->format = dmabuf->format;
+	key->modifier = dmabuf->modifier;
+	key->width = dmabuf->width;
+	key->height = dmabuf->height;
+	key->n_planes = dmabuf->n_planes;
+	for (int i = 0; i < dmabuf->n_planes; i++) {
+		struct stat st;
+		if (fstat(dmabuf->fd[i], &st) != 0) {
+			return false;
+		}
+		key->planes[i].dev = st.st_dev;
+		key->planes[i].ino = st.st_ino;
+		key->planes[i].offset = dmabuf->offset[i];
+		key->planes[i].stride = dmabuf->stride[i];
+	}
+	return true;
+}
+
+static void image_destroy(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_image *image) {
+	wl_list_remove(&image->link);
+	wlr_egl_destroy_image(renderer->egl, image->image);
+	free(image);
+}
+
+static struct wlr_gles2_image *image_import(struct wlr_gles2_renderer *renderer,
+		struct wlr_dmabuf_attributes *dmabuf) {
+	struct wlr_gles2_image_key key;
+	bool cacheable = image_key_init(&key, dmabuf);
+
+	// Holding the EGLImage keeps the DMA-BUF alive, so its inode can't be
+	// re-used for another DMA-BUF while the image is in the cache
+	struct wlr_gles2_image *image;
+	if (cacheable) {
+		wl_list_for_each(image, &renderer->image_cache.images, link) {
+			if (!image->cacheable || memcmp(&image->key, &key, sizeof(key)) != 0) {
+				continue;
+			}
+			if (image->n_users == 0) {
+				renderer->image_cache.unused_len--;
+			}
+			image->n_users++;
+			wl_list_remove(&image->link);
+			wl_list_insert(&renderer->image_cache.images, &image->link);
+			renderer->image_cache.hits++;
+			return image;
+		}
+	}
+
+	image = calloc(1, sizeof(*image));
+	if (image == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	image->image = wlr_egl_create_image_from_dmabuf(renderer->egl,
+		dmabuf, &image->external_only);
+	if (image->image == EGL_NO_IMAGE_KHR) {
+		free(image);
+		return NULL;
+	}
+
+	image->key = key;
+	image->cacheable = cacheable;
+	image->n_users = 1;
+	wl_list_insert(&renderer->image_cache.images, &image->link);
+	renderer->image_cache.misses++;
+	return image;
+}
+
+static void image_release(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_image *image) {
+	assert(image->n_users > 0);
+	image->n_users--;
+	if (image->n_users > 0) {
+		return;
+	}
+	if (!image->cacheable) {
+		image_destroy(renderer, image);
+		return;
+	}
+
+	renderer->image_cache.unused_len++;
+	if (renderer->image_cache.unused_len <= GLES2_IMAGE_CACHE_UNUSED_MAX) {
+		return;
+	}
+
+	// Evict the least recently used image
+	struct wlr_gles2_image *tmp;
+	wl_list_for_each_reverse_safe(image, tmp, &renderer->image_cache.images, link) {
+		if (image->n_users == 0) {
+			image_destroy(renderer, image);
+			renderer->image_cache.unused_len--;
+			break;
+		}
+	}
+}
+
 static void destroy_buffer(struct wlr_gles2_buffer *buffer) {
 	wl_list_remove(&buffer->link);
 	wlr_addon_finish(&buffer->addon);
@@ -67,7 +178,7 @@ static void destroy_buffer(struct wlr_gles2_buffer *buffer) {
 
 	pop_gles2_debug(buffer->renderer);
 
-	wlr_egl_destroy_image(buffer->renderer->egl, buffer->image);
+	image_release(buffer->renderer, buffer->cached_image);
 
 	wlr_egl_restore_context(&prev_ctx);
 
@@ -145,11 +256,12 @@ struct wlr_gles2_buffer *gles2_buffer_get_or_create(struct wlr_gles2_renderer *r
 		goto error_buffer;
 	}
 
-	buffer->image = wlr_egl_create_image_from_dmabuf(renderer->egl,
-		&dmabuf, &buffer->external_only);
-	if (buffer->image == EGL_NO_IMAGE_KHR) {
+	buffer->cached_image = image_import(renderer, &dmabuf);
+	if (buffer->cached_image == NULL) {
 		goto error_buffer;
 	}
+	buffer->image = buffer->cached_image->image;
+	buffer->external_only = buffer->cached_image->external_only;
 
 	wlr_addon_init(&buffer->addon, &wlr_buffer->addons, renderer,
 		&buffer_addon_impl);
@@ -211,16 +323,36 @@ static void gles2_destroy(struct wlr_renderer *wlr_renderer) {
 		gles2_texture_destroy(tex);
 	}
 
+	struct wlr_gles2_readback *readback, *readback_tmp;
+	wl_list_for_each_safe(readback, readback_tmp, &renderer->readbacks, link) {
+		gles2_readback_release(readback);
+	}
+
 	struct wlr_gles2_buffer *buffer, *buffer_tmp;
 	wl_list_for_each_safe(buffer, buffer_tmp, &renderer->buffers, link) {
 		destroy_buffer(buffer);
 	}
 
+	wlr_log(WLR_DEBUG, "EGLImage cache: %"PRIu64" hits, %"PRIu64" misses",
+		renderer->image_cache.hits, renderer->image_cache.misses);
+	struct wlr_gles2_image *image, *image_tmp;
+	wl_list_for_each_safe(image, image_tmp, &renderer->image_cache.images, link) {
+		assert(image->n_users == 0);
+		image_destroy(renderer, image);
+	}
+
 	push_gles2_debug(renderer);
 	glDeleteProgram(renderer->shaders.quad.program);
 	glDeleteProgram(renderer->shaders.tex_rgba.program);
 	glDeleteProgram(renderer->shaders.tex_rgbx.program);
 	glDeleteProgram(renderer->shaders.tex_ext.program);
+	glDeleteProgram(renderer->shaders.tex_rgba_no_alpha.program);
+	glDeleteProgram(renderer->shaders.tex_rgbx_no_alpha.program);
+	glDeleteProgram(renderer->shaders.tex_ext_no_alpha.program);
+	glDeleteProgram(renderer->shaders.blur_down.program);
+	glDeleteProgram(renderer->shaders.blur_up.program);
+	glDeleteProgram(renderer->shaders.shadow.program);
+	glDeleteBuffers(1, &renderer->upload.pbo);
 	pop_gles2_debug(renderer);
 
 	if (renderer->exts.KHR_debug) {
@@ -360,6 +492,7 @@ static const struct wlr_renderer_impl renderer_impl = {
 	.get_render_formats = gles2_get_render_formats,
 	.get_drm_fd = gles2_get_drm_fd,
 	.texture_from_buffer = gles2_texture_from_buffer,
+	.texture_from_buffer_cropped = gles2_texture_from_buffer_cropped,
 	.begin_buffer_pass = gles2_begin_buffer_pass,
 	.render_timer_create = gles2_render_timer_create,
 };
@@ -431,6 +564,12 @@ static GLuint link_program(struct wlr_gles2_renderer *renderer,
 		const GLchar *vert_src, const GLchar *frag_src) {
 	push_gles2_debug(renderer);
 
+	GLuint prog = gles2_program_cache_load(renderer, vert_src, frag_src);
+	if (prog) {
+		pop_gles2_debug(renderer);
+		return prog;
+	}
+
 	GLuint vert = compile_shader(renderer, GL_VERTEX_SHADER, vert_src);
 	if (!vert) {
 		goto error;
@@ -442,7 +581,7 @@ static GLuint link_program(struct wlr_gles2_renderer *renderer,
 		goto error;
 	}
 
-	GLuint prog = glCreateProgram();
+	prog = glCreateProgram();
 	glAttachShader(prog, vert);
 	glAttachShader(prog, frag);
 	glLinkProgram(prog);
@@ -460,6 +599,8 @@ static GLuint link_program(struct wlr_gles2_renderer *renderer,
 		goto error;
 	}
 
+	gles2_program_cache_store(renderer, prog, vert_src, frag_src);
+
 	pop_gles2_debug(renderer);
 	return prog;
 
@@ -468,6 +609,53 @@ error:
 	return 0;
 }
 
+static bool init_tex_shader(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_tex_shader *shader, const GLchar *frag_src,
+		bool no_alpha) {
+	const char *defines = no_alpha ? "#define NO_ALPHA\n" : "";
+	size_t src_len = strlen(defines) + strlen(frag_src) + 1;
+	GLchar *src = malloc(src_len);
+	if (src == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	snprintf(src, src_len, "%s%s", defines, frag_src);
+
+	GLuint prog = link_program(renderer, common_vert_src, src);
+	free(src);
+	if (!prog) {
+		return false;
+	}
+
+	shader->program = prog;
+	shader->proj = glGetUniformLocation(prog, "proj");
+	shader->tex = glGetUniformLocation(prog, "tex");
+	shader->alpha = glGetUniformLocation(prog, "alpha");
+	shader->pos_attrib = glGetAttribLocation(prog, "pos");
+	shader->texcoord_attrib = glGetAttribLocation(prog, "texcoord");
+	return true;
+}
+
+static void init_blur_shader(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_blur_shader *shader, const GLchar *frag_src) {
+	GLuint prog = link_program(renderer, common_vert_src, frag_src);
+	if (!prog) {
+		wlr_log(WLR_INFO, "Blur disabled, failed to build the shaders");
+		return;
+	}
+
+	shader->program = prog;
+	shader->proj = glGetUniformLocation(prog, "proj");
+	shader->tex = glGetUniformLocation(prog, "tex");
+	shader->halfpixel = glGetUniformLocation(prog, "halfpixel");
+	shader->offset = glGetUniformLocation(prog, "offset");
+	shader->tex_size = glGetUniformLocation(prog, "tex_size");
+	shader->mask_box = glGetUniformLocation(prog, "mask_box");
+	shader->mask_radius = glGetUniformLocation(prog, "mask_radius");
+	shader->pos_attrib = glGetAttribLocation(prog, "pos");
+	shader->texcoord_attrib = glGetAttribLocation(prog, "texcoord");
+}
+
 static bool check_gl_ext(const char *exts, const char *ext) {
 	size_t extlen = strlen(ext);
 	const char *end = exts + strlen(exts);
@@ -532,6 +720,8 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 
 	wl_list_init(&renderer->buffers);
 	wl_list_init(&renderer->textures);
+	wl_list_init(&renderer->readbacks);
+	wl_list_init(&renderer->image_cache.images);
 
 	renderer->egl = egl;
 	renderer->exts_str = exts_str;
@@ -620,6 +810,24 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 		}
 	}
 
+	if (check_gl_ext(exts_str, "GL_OES_get_program_binary")) {
+		renderer->exts.OES_get_program_binary = true;
+		load_gl_proc(&renderer->procs.glGetProgramBinaryOES, "glGetProgramBinaryOES");
+		load_gl_proc(&renderer->procs.glProgramBinaryOES, "glProgramBinaryOES");
+	}
+
+	int gl_major = 0;
+	const char *gl_version = (const char *)glGetString(GL_VERSION);
+	if (gl_version != NULL && sscanf(gl_version, "OpenGL ES %d", &gl_major) == 1 &&
+			gl_major >= 3) {
+		renderer->exts.pixel_unpack_buffer = true;
+		load_gl_proc(&renderer->procs.glMapBufferRange, "glMapBufferRange");
+		load_gl_proc(&renderer->procs.glUnmapBuffer, "glUnmapBuffer");
+	}
+
+	renderer->exts.texture_npot_mipmap = gl_major >= 3 ||
+		check_gl_ext(exts_str, "GL_OES_texture_npot");
+
 	if (renderer->exts.KHR_debug) {
 		glEnable(GL_DEBUG_OUTPUT_KHR);
 		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
@@ -632,6 +840,8 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 			GL_DEBUG_TYPE_PUSH_GROUP_KHR, GL_DONT_CARE, 0, NULL, GL_FALSE);
 	}
 
+	gles2_program_cache_init(renderer);
+
 	push_gles2_debug(renderer);
 
 	GLuint prog;
@@ -644,39 +854,42 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 	renderer->shaders.quad.color = glGetUniformLocation(prog, "color");
 	renderer->shaders.quad.pos_attrib = glGetAttribLocation(prog, "pos");
 
-	renderer->shaders.tex_rgba.program = prog =
-		link_program(renderer, common_vert_src, tex_rgba_frag_src);
-	if (!renderer->shaders.tex_rgba.program) {
-		goto error;
-	}
-	renderer->shaders.tex_rgba.proj = glGetUniformLocation(prog, "proj");
-	renderer->shaders.tex_rgba.tex_proj = glGetUniformLocation(prog, "tex_proj");
-	renderer->shaders.tex_rgba.tex = glGetUniformLocation(prog, "tex");
-	renderer->shaders.tex_rgba.alpha = glGetUniformLocation(prog, "alpha");
-	renderer->shaders.tex_rgba.pos_attrib = glGetAttribLocation(prog, "pos");
-
-	renderer->shaders.tex_rgbx.program = prog =
-		link_program(renderer, common_vert_src, tex_rgbx_frag_src);
-	if (!renderer->shaders.tex_rgbx.program) {
+	if (!init_tex_shader(renderer, &renderer->shaders.tex_rgba,
+			tex_rgba_frag_src, false) ||
+			!init_tex_shader(renderer, &renderer->shaders.tex_rgbx,
+			tex_rgbx_frag_src, false) ||
+			!init_tex_shader(renderer, &renderer->shaders.tex_rgba_no_alpha,
+			tex_rgba_frag_src, true) ||
+			!init_tex_shader(renderer, &renderer->shaders.tex_rgbx_no_alpha,
+			tex_rgbx_frag_src, true)) {
 		goto error;
 	}
-	renderer->shaders.tex_rgbx.proj = glGetUniformLocation(prog, "proj");
-	renderer->shaders.tex_rgbx.tex_proj = glGetUniformLocation(prog, "tex_proj");
-	renderer->shaders.tex_rgbx.tex = glGetUniformLocation(prog, "tex");
-	renderer->shaders.tex_rgbx.alpha = glGetUniformLocation(prog, "alpha");
-	renderer->shaders.tex_rgbx.pos_attrib = glGetAttribLocation(prog, "pos");
 
 	if (renderer->exts.OES_egl_image_external) {
-		renderer->shaders.tex_ext.program = prog =
-			link_program(renderer, common_vert_src, tex_external_frag_src);
-		if (!renderer->shaders.tex_ext.program) {
+		if (!init_tex_shader(renderer, &renderer->shaders.tex_ext,
+				tex_external_frag_src, false) ||
+				!init_tex_shader(renderer, &renderer->shaders.tex_ext_no_alpha,
+				tex_external_frag_src, true)) {
 			goto error;
 		}
-		renderer->shaders.tex_ext.proj = glGetUniformLocation(prog, "proj");
-		renderer->shaders.tex_ext.tex_proj = glGetUniformLocation(prog, "tex_proj");
-		renderer->shaders.tex_ext.tex = glGetUniformLocation(prog, "tex");
-		renderer->shaders.tex_ext.alpha = glGetUniformLocation(prog, "alpha");
-		renderer->shaders.tex_ext.pos_attrib = glGetAttribLocation(prog, "pos");
+	}
+
+	// Effects are optional, don't fail if the driver can't build them
+	init_blur_shader(renderer, &renderer->shaders.blur_down, blur_down_frag_src);
+	init_blur_shader(renderer, &renderer->shaders.blur_up, blur_up_frag_src);
+
+	renderer->shaders.shadow.program = prog =
+		link_program(renderer, common_vert_src, shadow_frag_src);
+	if (prog) {
+		renderer->shaders.shadow.proj = glGetUniformLocation(prog, "proj");
+		renderer->shaders.shadow.color = glGetUniformLocation(prog, "color");
+		renderer->shaders.shadow.box = glGetUniformLocation(prog, "box");
+		renderer->shaders.shadow.radius = glGetUniformLocation(prog, "radius");
+		renderer->shaders.shadow.sigma = glGetUniformLocation(prog, "sigma");
+		renderer->shaders.shadow.pos_attrib = glGetAttribLocation(prog, "pos");
+		renderer->shaders.shadow.texcoord_attrib = glGetAttribLocation(prog, "texcoord");
+	} else {
+		wlr_log(WLR_INFO, "Shadows disabled, failed to build the shader");
 	}
 
 	pop_gles2_debug(renderer);
@@ -699,6 +912,12 @@ error:
 	glDeleteProgram(renderer->shaders.tex_rgba.program);
 	glDeleteProgram(renderer->shaders.tex_rgbx.program);
 	glDeleteProgram(renderer->shaders.tex_ext.program);
+	glDeleteProgram(renderer->shaders.tex_rgba_no_alpha.program);
+	glDeleteProgram(renderer->shaders.tex_rgbx_no_alpha.program);
+	glDeleteProgram(renderer->shaders.tex_ext_no_alpha.program);
+	glDeleteProgram(renderer->shaders.blur_down.program);
+	glDeleteProgram(renderer->shaders.blur_up.program);
+	glDeleteProgram(renderer->shaders.shadow.program);
 
 	pop_gles2_debug(renderer);
 
@@ -0,0 +1,21 @@
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+
+// Dual Kawase blur, downsampling step
+varying vec2 v_texcoord;
+uniform sampler2D tex;
+uniform vec2 halfpixel;
+uniform float offset;
+
+void main() {
+	vec2 uv = v_texcoord;
+	vec4 sum = texture2D(tex, uv) * 4.0;
+	sum += texture2D(tex, uv - halfpixel * offset);
+	sum += texture2D(tex, uv + halfpixel * offset);
+	sum += texture2D(tex, uv + vec2(halfpixel.x, -halfpixel.y) * offset);
+	sum += texture2D(tex, uv - vec2(halfpixel.x, -halfpixel.y) * offset);
+	gl_FragColor = sum / 8.0;
+}
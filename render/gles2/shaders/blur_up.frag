@@ -0,0 +1,42 @@
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+
+// Dual Kawase blur, upsampling step
+varying vec2 v_texcoord;
+uniform sampler2D tex;
+uniform vec2 halfpixel;
+uniform float offset;
+
+// Rounded rectangle the result is masked with, in pixels relative to the
+// blurred area of size tex_size. Disabled if mask_radius is 0.
+uniform vec2 tex_size;
+uniform vec4 mask_box;
+uniform float mask_radius;
+
+float rounded_rect_mask(vec2 p) {
+	vec2 half_size = mask_box.zw * 0.5;
+	vec2 q = abs(p - mask_box.xy - half_size) - half_size + mask_radius;
+	float dist = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - mask_radius;
+	return clamp(0.5 - dist, 0.0, 1.0);
+}
+
+void main() {
+	vec2 uv = v_texcoord;
+	vec4 sum = texture2D(tex, uv + vec2(-halfpixel.x * 2.0, 0.0) * offset);
+	sum += texture2D(tex, uv + vec2(-halfpixel.x, halfpixel.y) * offset) * 2.0;
+	sum += texture2D(tex, uv + vec2(0.0, halfpixel.y * 2.0) * offset);
+	sum += texture2D(tex, uv + vec2(halfpixel.x, halfpixel.y) * offset) * 2.0;
+	sum += texture2D(tex, uv + vec2(halfpixel.x * 2.0, 0.0) * offset);
+	sum += texture2D(tex, uv + vec2(halfpixel.x, -halfpixel.y) * offset) * 2.0;
+	sum += texture2D(tex, uv + vec2(0.0, -halfpixel.y * 2.0) * offset);
+	sum += texture2D(tex, uv + vec2(-halfpixel.x, -halfpixel.y) * offset) * 2.0;
+	sum /= 12.0;
+
+	if (mask_radius > 0.0) {
+		sum *= rounded_rect_mask(uv * tex_size);
+	}
+	gl_FragColor = sum;
+}
@@ -0,0 +1,55 @@
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+
+// Shadow of a rounded rectangle blurred with a gaussian, see
+// https://madebyevan.com/shaders/fast-rounded-rectangle-shadows/
+varying vec2 v_texcoord; // position in buffer coordinates
+uniform vec4 color;
+uniform vec4 box; // x, y, width, height
+uniform float radius;
+uniform float sigma;
+
+float gaussian(float x) {
+	const float pi = 3.141592653589793;
+	return exp(-(x * x) / (2.0 * sigma * sigma)) / (sqrt(2.0 * pi) * sigma);
+}
+
+vec2 erf(vec2 x) {
+	vec2 s = sign(x);
+	vec2 a = abs(x);
+	x = 1.0 + (0.278393 + (0.230389 + 0.078108 * (a * a)) * a) * a;
+	x *= x;
+	return s - s / (x * x);
+}
+
+// Integral of the shadow along x at height y
+float shadow_x(float x, float y, vec2 half_size) {
+	float delta = min(half_size.y - radius - abs(y), 0.0);
+	float curved = half_size.x - radius + sqrt(max(0.0, radius * radius - delta * delta));
+	vec2 integral = 0.5 + 0.5 * erf((x + vec2(-curved, curved)) * (sqrt(0.5) / sigma));
+	return integral.y - integral.x;
+}
+
+void main() {
+	vec2 half_size = box.zw * 0.5;
+	vec2 p = v_texcoord - box.xy - half_size;
+
+	// Sample the gaussian along y, the shadow is separable enough for the
+	// result to be indistinguishable from the exact blur
+	float low = p.y - half_size.y;
+	float high = p.y + half_size.y;
+	float start = clamp(-3.0 * sigma, low, high);
+	float end = clamp(3.0 * sigma, low, high);
+	float step = (end - start) / 4.0;
+	float y = start + step * 0.5;
+	float value = 0.0;
+	for (int i = 0; i < 4; i++) {
+		value += shadow_x(p.x, p.y - y, half_size) * gaussian(y) * step;
+		y += step;
+	}
+
+	gl_FragColor = color * value;
+}
@@ -8,8 +8,14 @@ precision mediump float;
 
 varying vec2 v_texcoord;
 uniform samplerExternalOES texture0;
+#ifndef NO_ALPHA
 uniform float alpha;
+#endif
 
 void main() {
+#ifdef NO_ALPHA
+	gl_FragColor = texture2D(texture0, v_texcoord);
+#else
 	gl_FragColor = texture2D(texture0, v_texcoord) * alpha;
+#endif
 }
@@ -6,8 +6,14 @@ precision mediump float;
 
 varying vec2 v_texcoord;
 uniform sampler2D tex;
+#ifndef NO_ALPHA
 uniform float alpha;
+#endif
 
 void main() {
+#ifdef NO_ALPHA
+	gl_FragColor = texture2D(tex, v_texcoord);
+#else
 	gl_FragColor = texture2D(tex, v_texcoord) * alpha;
+#endif
 }
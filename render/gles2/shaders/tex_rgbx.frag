@@ -6,8 +6,14 @@ precision mediump float;
 
 varying vec2 v_texcoord;
 uniform sampler2D tex;
+#ifndef NO_ALPHA
 uniform float alpha;
+#endif
 
 void main() {
+#ifdef NO_ALPHA
+	gl_FragColor = vec4(texture2D(tex, v_texcoord).rgb, 1.0);
+#else
 	gl_FragColor = vec4(texture2D(tex, v_texcoord).rgb, 1.0) * alpha;
+#endif
 }
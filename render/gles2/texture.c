@@ -4,15 +4,19 @@
 #include <GLES2/gl2ext.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <wayland-server-protocol.h>
 #include <wayland-util.h>
 #include <wlr/render/egl.h>
 #include <wlr/render/interface.h>
 #include <wlr/render/wlr_texture.h>
 #include <wlr/util/log.h>
+#include "render/dmabuf.h"
 #include "render/egl.h"
 #include "render/gles2.h"
 #include "render/pixel_format.h"
+#include "render/wlr_renderer.h"
 #include "types/wlr_buffer.h"
 
 static const struct wlr_texture_impl texture_impl;
@@ -28,6 +32,85 @@ struct wlr_gles2_texture *gles2_get_texture(
 	return texture;
 }
 
+/**
+ * Stream the damaged rectangles through the upload ring buffer. The copy into
+ * the mapped buffer doesn't synchronize with the GPU, and the driver can
+ * perform the transfer to the texture asynchronously.
+ */
+static bool gles2_texture_upload_pbo(struct wlr_gles2_texture *texture,
+		const struct wlr_gles2_pixel_format *fmt, uint32_t bytes_per_pixel,
+		const void *data, size_t stride, const pixman_box32_t *rects, int rects_len) {
+	struct wlr_gles2_renderer *renderer = texture->renderer;
+	if (!renderer->exts.pixel_unpack_buffer) {
+		return false;
+	}
+
+	// Each rectangle is tightly packed, starting on a 16-byte boundary
+	size_t size = 0;
+	for (int i = 0; i < rects_len; i++) {
+		size_t width = rects[i].x2 - rects[i].x1;
+		size_t height = rects[i].y2 - rects[i].y1;
+		size += (width * height * bytes_per_pixel + 15) & ~(size_t)15;
+	}
+	if (size == 0 || size > GLES2_UPLOAD_BUFFER_SIZE) {
+		return false;
+	}
+
+	if (renderer->upload.pbo == 0) {
+		glGenBuffers(1, &renderer->upload.pbo);
+		renderer->upload.offset = GLES2_UPLOAD_BUFFER_SIZE;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER_NV, renderer->upload.pbo);
+
+	if (renderer->upload.offset + size > GLES2_UPLOAD_BUFFER_SIZE) {
+		// Orphan the old storage, the driver will release it once the
+		// pending uploads are complete
+		glBufferData(GL_PIXEL_UNPACK_BUFFER_NV, GLES2_UPLOAD_BUFFER_SIZE,
+			NULL, GL_STREAM_DRAW);
+		renderer->upload.offset = 0;
+	}
+
+	size_t offset = renderer->upload.offset;
+	uint8_t *map = renderer->procs.glMapBufferRange(GL_PIXEL_UNPACK_BUFFER_NV,
+		offset, size, GL_MAP_WRITE_BIT_EXT | GL_MAP_INVALIDATE_RANGE_BIT_EXT |
+		GL_MAP_UNSYNCHRONIZED_BIT_EXT);
+	if (map == NULL) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER_NV, 0);
+		return false;
+	}
+
+	size_t rect_offset = 0;
+	for (int i = 0; i < rects_len; i++) {
+		const pixman_box32_t *rect = &rects[i];
+		size_t row_size = (rect->x2 - rect->x1) * bytes_per_pixel;
+		int height = rect->y2 - rect->y1;
+		const uint8_t *src = (const uint8_t *)data +
+			rect->y1 * stride + rect->x1 * bytes_per_pixel;
+		for (int y = 0; y < height; y++) {
+			memcpy(map + rect_offset + y * row_size, src + y * stride, row_size);
+		}
+		rect_offset += (row_size * height + 15) & ~(size_t)15;
+	}
+
+	renderer->procs.glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER_NV);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	rect_offset = offset;
+	for (int i = 0; i < rects_len; i++) {
+		const pixman_box32_t *rect = &rects[i];
+		int width = rect->x2 - rect->x1;
+		int height = rect->y2 - rect->y1;
+		glTexSubImage2D(GL_TEXTURE_2D, 0, rect->x1, rect->y1, width, height,
+			fmt->gl_format, fmt->gl_type, (const void *)(uintptr_t)rect_offset);
+		rect_offset += ((size_t)width * height * bytes_per_pixel + 15) & ~(size_t)15;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER_NV, 0);
+	renderer->upload.offset = offset + size;
+	return true;
+}
+
 static bool gles2_texture_update_from_buffer(struct wlr_texture *wlr_texture,
 		struct wlr_buffer *buffer, const pixman_region32_t *damage) {
 	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
@@ -67,6 +150,19 @@ static bool gles2_texture_update_from_buffer(struct wlr_texture *wlr_texture,
 		return false;
 	}
 
+	// Cropped textures only store the damage inside the crop, at the origin
+	pixman_region32_t cropped_damage;
+	pixman_region32_init(&cropped_damage);
+	const struct wlr_box *crop = &wlr_texture->crop;
+	if (!wlr_box_empty(crop)) {
+		pixman_region32_intersect_rect(&cropped_damage, damage,
+			crop->x, crop->y, crop->width, crop->height);
+		pixman_region32_translate(&cropped_damage, -crop->x, -crop->y);
+		data = (uint8_t *)data + (size_t)crop->y * stride +
+			(size_t)crop->x * drm_fmt->bytes_per_block;
+		damage = &cropped_damage;
+	}
+
 	struct wlr_egl_context prev_ctx;
 	wlr_egl_make_current(texture->renderer->egl, &prev_ctx);
 
@@ -77,6 +173,11 @@ static bool gles2_texture_update_from_buffer(struct wlr_texture *wlr_texture,
 	int rects_len = 0;
 	const pixman_box32_t *rects = pixman_region32_rectangles(damage, &rects_len);
 
+	if (gles2_texture_upload_pbo(texture, fmt, drm_fmt->bytes_per_block,
+			data, stride, rects, rects_len)) {
+		rects_len = 0;
+	}
+
 	for (int i = 0; i < rects_len; i++) {
 		pixman_box32_t rect = rects[i];
 
@@ -100,12 +201,41 @@ static bool gles2_texture_update_from_buffer(struct wlr_texture *wlr_texture,
 
 	wlr_egl_restore_context(&prev_ctx);
 
+	pixman_region32_fini(&cropped_damage);
 	wlr_buffer_end_data_ptr_access(buffer);
 
+	texture->mipmaps_valid = false;
+
+	return true;
+}
+
+bool gles2_texture_ensure_mipmaps(struct wlr_gles2_texture *texture) {
+	if (!texture->mipmappable) {
+		return false;
+	}
+	if (texture->mipmaps_valid) {
+		return true;
+	}
+
+	push_gles2_debug(texture->renderer);
+	glBindTexture(GL_TEXTURE_2D, texture->tex);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	pop_gles2_debug(texture->renderer);
+
+	if (!texture->mipmaps_allocated) {
+		// The whole mipmap chain adds up to a third of the base level
+		size_t size = wlr_texture_get_memory_usage(&texture->wlr_texture);
+		texture_set_memory_usage(&texture->wlr_texture, size + size / 3, false);
+		texture->mipmaps_allocated = true;
+	}
+
+	texture->mipmaps_valid = true;
 	return true;
 }
 
 void gles2_texture_destroy(struct wlr_gles2_texture *texture) {
+	texture_set_memory_usage(&texture->wlr_texture, 0, false);
 	wl_list_remove(&texture->link);
 	if (texture->buffer != NULL) {
 		wlr_buffer_unlock(texture->buffer->buffer);
@@ -164,24 +294,19 @@ static bool gles2_texture_bind(struct wlr_gles2_texture *texture) {
 	return true;
 }
 
-static bool gles2_texture_read_pixels(struct wlr_texture *wlr_texture,
-		const struct wlr_texture_read_pixels_options *options) {
-	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
-
-	struct wlr_box src;
-	wlr_texture_read_pixels_options_get_src_box(options, wlr_texture, &src);
-
-	const struct wlr_gles2_pixel_format *fmt =
-		get_gles2_format_from_drm(options->format);
-	if (fmt == NULL || !is_gles2_pixel_format_supported(texture->renderer, fmt)) {
-		wlr_log(WLR_ERROR, "Cannot read pixels: unsupported pixel format 0x%"PRIX32, options->format);
-		return false;
+static const struct wlr_gles2_pixel_format *get_read_format(
+		struct wlr_gles2_renderer *renderer, uint32_t format,
+		const struct wlr_pixel_format_info **drm_fmt_out) {
+	const struct wlr_gles2_pixel_format *fmt = get_gles2_format_from_drm(format);
+	if (fmt == NULL || !is_gles2_pixel_format_supported(renderer, fmt)) {
+		wlr_log(WLR_ERROR, "Cannot read pixels: unsupported pixel format 0x%"PRIX32, format);
+		return NULL;
 	}
 
-	if (fmt->gl_format == GL_BGRA_EXT && !texture->renderer->exts.EXT_read_format_bgra) {
+	if (fmt->gl_format == GL_BGRA_EXT && !renderer->exts.EXT_read_format_bgra) {
 		wlr_log(WLR_ERROR,
 			"Cannot read pixels: missing GL_EXT_read_format_bgra extension");
-		return false;
+		return NULL;
 	}
 
 	const struct wlr_pixel_format_info *drm_fmt =
@@ -189,6 +314,54 @@ static bool gles2_texture_read_pixels(struct wlr_texture *wlr_texture,
 	assert(drm_fmt);
 	if (pixel_format_info_pixels_per_block(drm_fmt) != 1) {
 		wlr_log(WLR_ERROR, "Cannot read pixels: block formats are not supported");
+		return NULL;
+	}
+
+	*drm_fmt_out = drm_fmt;
+	return fmt;
+}
+
+/**
+ * Get the box to read from the texture storage, which only holds the crop of
+ * cropped textures.
+ */
+static bool get_read_box(struct wlr_texture *texture,
+		const struct wlr_texture_read_pixels_options *options, struct wlr_box *box) {
+	wlr_texture_read_pixels_options_get_src_box(options, texture, box);
+
+	const struct wlr_box *crop = &texture->crop;
+	if (wlr_box_empty(crop)) {
+		return true;
+	}
+
+	struct wlr_fbox fbox = {
+		.x = box->x,
+		.y = box->y,
+		.width = box->width,
+		.height = box->height,
+	};
+	if (!texture_contains_box(texture, &fbox)) {
+		wlr_log(WLR_ERROR, "Cannot read pixels outside of the texture crop");
+		return false;
+	}
+	box->x -= crop->x;
+	box->y -= crop->y;
+	return true;
+}
+
+static bool gles2_texture_read_pixels(struct wlr_texture *wlr_texture,
+		const struct wlr_texture_read_pixels_options *options) {
+	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
+
+	struct wlr_box src;
+	if (!get_read_box(wlr_texture, options, &src)) {
+		return false;
+	}
+
+	const struct wlr_pixel_format_info *drm_fmt;
+	const struct wlr_gles2_pixel_format *fmt =
+		get_read_format(texture->renderer, options->format, &drm_fmt);
+	if (fmt == NULL) {
 		return false;
 	}
 
@@ -232,6 +405,210 @@ static bool gles2_texture_read_pixels(struct wlr_texture *wlr_texture,
 	return glGetError() == GL_NO_ERROR;
 }
 
+static const struct wlr_texture_readback_impl readback_impl;
+
+static struct wlr_gles2_readback *gles2_get_readback(
+		struct wlr_texture_readback *wlr_readback) {
+	assert(wlr_readback->impl == &readback_impl);
+	struct wlr_gles2_readback *readback = wl_container_of(wlr_readback, readback, base);
+	return readback;
+}
+
+static void readback_finish_fence(struct wlr_gles2_readback *readback) {
+	if (readback->fence_source != NULL) {
+		wl_event_source_remove(readback->fence_source);
+		readback->fence_source = NULL;
+	}
+	if (readback->fence_fd >= 0) {
+		close(readback->fence_fd);
+		readback->fence_fd = -1;
+	}
+}
+
+void gles2_readback_release(struct wlr_gles2_readback *readback) {
+	struct wlr_gles2_renderer *renderer = readback->renderer;
+	if (renderer == NULL) {
+		return;
+	}
+
+	readback_finish_fence(readback);
+
+	struct wlr_egl_context prev_ctx;
+	if (wlr_egl_make_current(renderer->egl, &prev_ctx)) {
+		push_gles2_debug(renderer);
+		glDeleteBuffers(1, &readback->pbo);
+		pop_gles2_debug(renderer);
+		wlr_egl_restore_context(&prev_ctx);
+	}
+
+	wl_list_remove(&readback->link);
+	wl_list_init(&readback->link);
+	readback->renderer = NULL;
+}
+
+static int readback_handle_fence(int fd, uint32_t mask, void *data) {
+	struct wlr_gles2_readback *readback = data;
+
+	// On error, let copy() block on the buffer mapping instead
+	readback_finish_fence(readback);
+
+	wl_signal_emit_mutable(&readback->base.events.ready, NULL);
+	return 0;
+}
+
+static bool gles2_readback_copy(struct wlr_texture_readback *wlr_readback,
+		void *data, uint32_t stride) {
+	struct wlr_gles2_readback *readback = gles2_get_readback(wlr_readback);
+	struct wlr_gles2_renderer *renderer = readback->renderer;
+	if (renderer == NULL) {
+		return false;
+	}
+
+	struct wlr_egl_context prev_ctx;
+	if (!wlr_egl_make_current(renderer->egl, &prev_ctx)) {
+		return false;
+	}
+	push_gles2_debug(renderer);
+
+	size_t row_size = (size_t)readback->width * readback->bytes_per_pixel;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, readback->pbo);
+	const uint8_t *map = renderer->procs.glMapBufferRange(GL_PIXEL_PACK_BUFFER_NV,
+		0, row_size * readback->height, GL_MAP_READ_BIT_EXT);
+	if (map != NULL) {
+		uint8_t *dst = (uint8_t *)data + (size_t)readback->dst_y * stride +
+			(size_t)readback->dst_x * readback->bytes_per_pixel;
+		if (row_size == stride) {
+			memcpy(dst, map, row_size * readback->height);
+		} else {
+			for (uint32_t y = 0; y < readback->height; y++) {
+				memcpy(dst + y * stride, map + y * row_size, row_size);
+			}
+		}
+		renderer->procs.glUnmapBuffer(GL_PIXEL_PACK_BUFFER_NV);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+
+	pop_gles2_debug(renderer);
+	wlr_egl_restore_context(&prev_ctx);
+
+	return map != NULL;
+}
+
+static void gles2_readback_destroy(struct wlr_texture_readback *wlr_readback) {
+	struct wlr_gles2_readback *readback = gles2_get_readback(wlr_readback);
+	gles2_readback_release(readback);
+	free(readback);
+}
+
+static const struct wlr_texture_readback_impl readback_impl = {
+	.copy = gles2_readback_copy,
+	.destroy = gles2_readback_destroy,
+};
+
+static struct wlr_texture_readback *gles2_texture_read_pixels_async(
+		struct wlr_texture *wlr_texture,
+		const struct wlr_texture_read_pixels_options *options,
+		struct wl_event_loop *loop) {
+	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
+	struct wlr_gles2_renderer *renderer = texture->renderer;
+
+	// The fence FD lets the event loop tell when the pack buffer is filled
+	if (!renderer->exts.pixel_unpack_buffer ||
+			renderer->egl->procs.eglDupNativeFenceFDANDROID == NULL) {
+		return NULL;
+	}
+
+	struct wlr_box src;
+	if (!get_read_box(wlr_texture, options, &src)) {
+		return NULL;
+	}
+
+	const struct wlr_pixel_format_info *drm_fmt;
+	const struct wlr_gles2_pixel_format *fmt =
+		get_read_format(renderer, options->format, &drm_fmt);
+	if (fmt == NULL) {
+		return NULL;
+	}
+
+	struct wlr_gles2_readback *readback = calloc(1, sizeof(*readback));
+	if (readback == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	wlr_texture_readback_init(&readback->base, &readback_impl);
+	readback->width = src.width;
+	readback->height = src.height;
+	readback->bytes_per_pixel = drm_fmt->bytes_per_block;
+	readback->dst_x = options->dst_x;
+	readback->dst_y = options->dst_y;
+	readback->fence_fd = -1;
+
+	struct wlr_egl_context prev_ctx;
+	if (!wlr_egl_make_current(renderer->egl, &prev_ctx)) {
+		free(readback);
+		return NULL;
+	}
+	push_gles2_debug(renderer);
+
+	if (!gles2_texture_bind(texture)) {
+		goto error_ctx;
+	}
+
+	glGetError(); // Clear the error flag
+
+	glGenBuffers(1, &readback->pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, readback->pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER_NV,
+		(GLsizeiptr)pixel_format_info_min_stride(drm_fmt, src.width) * src.height,
+		NULL, GL_STREAM_READ);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	// No need to wait for pending drawing: reads into a pack buffer are
+	// queued like any other command
+	glReadPixels(src.x, src.y, src.width, src.height,
+		fmt->gl_format, fmt->gl_type, NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+
+	if (glGetError() != GL_NO_ERROR) {
+		goto error_pbo;
+	}
+
+	EGLSyncKHR sync = wlr_egl_create_sync(renderer->egl, -1);
+	if (sync == EGL_NO_SYNC_KHR) {
+		goto error_pbo;
+	}
+	// The native fence FD is only available once the commands are flushed
+	glFlush();
+	readback->fence_fd = wlr_egl_dup_fence_fd(renderer->egl, sync);
+	wlr_egl_destroy_sync(renderer->egl, sync);
+	if (readback->fence_fd < 0) {
+		goto error_pbo;
+	}
+
+	readback->fence_source = wl_event_loop_add_fd(loop, readback->fence_fd,
+		WL_EVENT_READABLE, readback_handle_fence, readback);
+	if (readback->fence_source == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add readback fence to event loop");
+		goto error_fence;
+	}
+
+	pop_gles2_debug(renderer);
+	wlr_egl_restore_context(&prev_ctx);
+
+	readback->renderer = renderer;
+	wl_list_insert(&renderer->readbacks, &readback->link);
+	return &readback->base;
+
+error_fence:
+	close(readback->fence_fd);
+error_pbo:
+	glDeleteBuffers(1, &readback->pbo);
+error_ctx:
+	pop_gles2_debug(renderer);
+	wlr_egl_restore_context(&prev_ctx);
+	free(readback);
+	return NULL;
+}
+
 static uint32_t gles2_texture_preferred_read_format(struct wlr_texture *wlr_texture) {
 	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
 
@@ -273,11 +650,18 @@ out:
 	return fmt;
 }
 
+static bool gles2_texture_is_opaque(struct wlr_texture *wlr_texture) {
+	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
+	return !texture->has_alpha;
+}
+
 static const struct wlr_texture_impl texture_impl = {
 	.update_from_buffer = gles2_texture_update_from_buffer,
 	.read_pixels = gles2_texture_read_pixels,
 	.preferred_read_format = gles2_texture_preferred_read_format,
+	.is_opaque = gles2_texture_is_opaque,
 	.destroy = handle_gles2_texture_destroy,
+	.read_pixels_async = gles2_texture_read_pixels_async,
 };
 
 static struct wlr_gles2_texture *gles2_texture_create(
@@ -294,10 +678,14 @@ static struct wlr_gles2_texture *gles2_texture_create(
 	return texture;
 }
 
+/**
+ * Upload pixel data to a new texture. If crop is non-NULL, only the part of
+ * the data inside it is stored.
+ */
 static struct wlr_texture *gles2_texture_from_pixels(
 		struct wlr_renderer *wlr_renderer,
 		uint32_t drm_format, uint32_t stride, uint32_t width,
-		uint32_t height, const void *data) {
+		uint32_t height, const void *data, const struct wlr_box *crop) {
 	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
 
 	const struct wlr_gles2_pixel_format *fmt =
@@ -324,9 +712,23 @@ static struct wlr_texture *gles2_texture_from_pixels(
 	if (texture == NULL) {
 		return NULL;
 	}
+
+	uint32_t storage_width = width, storage_height = height;
+	if (crop != NULL && (crop->width != (int)width || crop->height != (int)height)) {
+		texture->wlr_texture.crop = *crop;
+		storage_width = crop->width;
+		storage_height = crop->height;
+		data = (const uint8_t *)data + (size_t)crop->y * stride +
+			(size_t)crop->x * drm_fmt->bytes_per_block;
+	}
+
 	texture->target = GL_TEXTURE_2D;
 	texture->has_alpha = pixel_format_has_alpha(fmt->drm_format);
 	texture->drm_format = fmt->drm_format;
+	// Only generate mipmaps for formats which are always color-renderable
+	// and filterable
+	texture->mipmappable = renderer->exts.texture_npot_mipmap &&
+		fmt->gl_type == GL_UNSIGNED_BYTE;
 
 	GLint internal_format = fmt->gl_internalformat;
 	if (!internal_format) {
@@ -344,8 +746,8 @@ static struct wlr_texture *gles2_texture_from_pixels(
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, stride / drm_fmt->bytes_per_block);
-	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0,
-		fmt->gl_format, fmt->gl_type, data);
+	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, storage_width,
+		storage_height, 0, fmt->gl_format, fmt->gl_type, data);
 	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
 
 	glBindTexture(GL_TEXTURE_2D, 0);
@@ -354,6 +756,10 @@ static struct wlr_texture *gles2_texture_from_pixels(
 
 	wlr_egl_restore_context(&prev_ctx);
 
+	texture_set_memory_usage(&texture->wlr_texture,
+		(size_t)pixel_format_info_min_stride(drm_fmt, storage_width) *
+		storage_height, false);
+
 	return &texture->wlr_texture;
 }
 
@@ -406,11 +812,12 @@ static struct wlr_texture *gles2_texture_from_dmabuf(
 
 	texture->tex = buffer->tex;
 	wlr_buffer_lock(texture->buffer->buffer);
+	texture_set_memory_usage(&texture->wlr_texture, dmabuf_get_size(attribs), true);
 	return &texture->wlr_texture;
 }
 
-struct wlr_texture *gles2_texture_from_buffer(struct wlr_renderer *wlr_renderer,
-		struct wlr_buffer *buffer) {
+static struct wlr_texture *texture_from_buffer(struct wlr_renderer *wlr_renderer,
+		struct wlr_buffer *buffer, const struct wlr_box *crop) {
 	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
 
 	void *data;
@@ -418,11 +825,18 @@ struct wlr_texture *gles2_texture_from_buffer(struct wlr_renderer *wlr_renderer,
 	size_t stride;
 	struct wlr_dmabuf_attributes dmabuf;
 	if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
-		return gles2_texture_from_dmabuf(renderer, buffer, &dmabuf);
-	} else if (wlr_buffer_begin_data_ptr_access(buffer,
+		struct wlr_texture *tex = gles2_texture_from_dmabuf(renderer, buffer, &dmabuf);
+		if (tex != NULL) {
+			return tex;
+		}
+		// Buffers which can also be accessed from the CPU (e.g. shm buffers
+		// wrapped in a udmabuf) can still be uploaded
+	}
+
+	if (wlr_buffer_begin_data_ptr_access(buffer,
 			WLR_BUFFER_DATA_PTR_ACCESS_READ, &data, &format, &stride)) {
 		struct wlr_texture *tex = gles2_texture_from_pixels(wlr_renderer,
-			format, stride, buffer->width, buffer->height, data);
+			format, stride, buffer->width, buffer->height, data, crop);
 		wlr_buffer_end_data_ptr_access(buffer);
 		return tex;
 	} else {
@@ -430,6 +844,18 @@ struct wlr_texture *gles2_texture_from_buffer(struct wlr_renderer *wlr_renderer,
 	}
 }
 
+struct wlr_texture *gles2_texture_from_buffer(struct wlr_renderer *wlr_renderer,
+		struct wlr_buffer *buffer) {
+	return texture_from_buffer(wlr_renderer, buffer, NULL);
+}
+
+struct wlr_texture *gles2_texture_from_buffer_cropped(
+		struct wlr_renderer *wlr_renderer, struct wlr_buffer *buffer,
+		const struct wlr_box *box) {
+	// DMA-BUFs are imported without a copy, only uploads are cropped
+	return texture_from_buffer(wlr_renderer, buffer, box);
+}
+
 void wlr_gles2_texture_get_attribs(struct wlr_texture *wlr_texture,
 		struct wlr_gles2_texture_attribs *attribs) {
 	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
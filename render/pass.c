@@ -1,6 +1,12 @@
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
+#include <wlr/render/drm_syncobj.h>
 #include <wlr/render/interface.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/util/log.h>
+#include "render/wlr_renderer.h"
+#include "util/trace.h"
 
 void wlr_render_pass_init(struct wlr_render_pass *render_pass,
 		const struct wlr_render_pass_impl *impl) {
@@ -11,7 +17,10 @@ void wlr_render_pass_init(struct wlr_render_pass *render_pass,
 }
 
 bool wlr_render_pass_submit(struct wlr_render_pass *render_pass) {
-	return render_pass->impl->submit(render_pass);
+	trace_begin("render_pass_submit");
+	bool ok = render_pass->impl->submit(render_pass);
+	trace_end();
+	return ok;
 }
 
 void wlr_render_pass_add_texture(struct wlr_render_pass *render_pass,
@@ -34,6 +43,28 @@ void wlr_render_pass_add_rect(struct wlr_render_pass *render_pass,
 	render_pass->impl->add_rect(render_pass, options);
 }
 
+bool wlr_render_pass_add_blur(struct wlr_render_pass *render_pass,
+		const struct wlr_render_blur_options *options) {
+	assert(options->box.width >= 0 && options->box.height >= 0);
+	assert(options->passes >= 1 && options->passes <= 8);
+	if (render_pass->impl->add_blur == NULL) {
+		return false;
+	}
+	if (wlr_box_empty(&options->box)) {
+		return true;
+	}
+	return render_pass->impl->add_blur(render_pass, options);
+}
+
+bool wlr_render_pass_add_shadow(struct wlr_render_pass *render_pass,
+		const struct wlr_render_shadow_options *options) {
+	assert(options->box.width >= 0 && options->box.height >= 0);
+	if (render_pass->impl->add_shadow == NULL) {
+		return false;
+	}
+	return render_pass->impl->add_shadow(render_pass, options);
+}
+
 void wlr_render_texture_options_get_src_box(const struct wlr_render_texture_options *options,
 		struct wlr_fbox *box) {
 	*box = options->src_box;
@@ -74,3 +105,202 @@ void wlr_render_rect_options_get_box(const struct wlr_render_rect_options *optio
 
 	*box = options->box;
 }
+
+struct deferred_render_command {
+	bool is_texture;
+	union {
+		struct wlr_render_texture_options texture;
+		struct wlr_render_rect_options rect;
+	};
+	float alpha;
+	// Area painted by the command, culled on submit
+	pixman_region32_t clip;
+	// Whether the command completely replaces the pixels it paints
+	bool opaque;
+};
+
+struct deferred_render_pass {
+	struct wlr_render_pass base;
+	struct wlr_render_pass *parent;
+	struct wlr_buffer *buffer;
+
+	struct wl_array commands; // struct deferred_render_command
+};
+
+static const struct wlr_render_pass_impl deferred_render_pass_impl;
+
+static struct deferred_render_pass *deferred_render_pass_from_pass(
+		struct wlr_render_pass *wlr_pass) {
+	assert(wlr_pass->impl == &deferred_render_pass_impl);
+	struct deferred_render_pass *pass = wl_container_of(wlr_pass, pass, base);
+	return pass;
+}
+
+static void deferred_command_finish(struct deferred_render_command *cmd) {
+	if (cmd->is_texture) {
+		wlr_drm_syncobj_timeline_unref(cmd->texture.wait_timeline);
+	}
+	pixman_region32_fini(&cmd->clip);
+}
+
+/**
+ * Send the recorded commands to the wrapped render pass, skipping the parts
+ * of each command covered by the opaque commands recorded after it.
+ */
+static void deferred_render_pass_flush(struct deferred_render_pass *pass) {
+	struct deferred_render_command *cmds = pass->commands.data;
+	size_t cmds_len = pass->commands.size / sizeof(cmds[0]);
+
+	pixman_region32_t occluded;
+	pixman_region32_init(&occluded);
+	for (size_t i = cmds_len; i-- > 0;) {
+		struct deferred_render_command *cmd = &cmds[i];
+		pixman_region32_subtract(&cmd->clip, &cmd->clip, &occluded);
+		if (cmd->opaque) {
+			pixman_region32_union(&occluded, &occluded, &cmd->clip);
+		}
+	}
+	pixman_region32_fini(&occluded);
+
+	for (size_t i = 0; i < cmds_len; i++) {
+		struct deferred_render_command *cmd = &cmds[i];
+		if (pixman_region32_empty(&cmd->clip)) {
+			deferred_command_finish(cmd);
+			continue;
+		}
+
+		if (cmd->is_texture) {
+			cmd->texture.clip = &cmd->clip;
+			cmd->texture.alpha = &cmd->alpha;
+			wlr_render_pass_add_texture(pass->parent, &cmd->texture);
+		} else {
+			cmd->rect.clip = &cmd->clip;
+			wlr_render_pass_add_rect(pass->parent, &cmd->rect);
+		}
+		deferred_command_finish(cmd);
+	}
+
+	pass->commands.size = 0;
+}
+
+static bool deferred_render_pass_submit(struct wlr_render_pass *wlr_pass) {
+	struct deferred_render_pass *pass = deferred_render_pass_from_pass(wlr_pass);
+	deferred_render_pass_flush(pass);
+	bool ok = wlr_render_pass_submit(pass->parent);
+	wl_array_release(&pass->commands);
+	free(pass);
+	return ok;
+}
+
+static struct deferred_render_command *deferred_render_pass_add_command(
+		struct deferred_render_pass *pass, const struct wlr_box *box,
+		const pixman_region32_t *clip) {
+	struct deferred_render_command *cmd =
+		wl_array_add(&pass->commands, sizeof(*cmd));
+	if (cmd == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	*cmd = (struct deferred_render_command){0};
+	pixman_region32_init_rect(&cmd->clip, box->x, box->y, box->width, box->height);
+	pixman_region32_intersect_rect(&cmd->clip, &cmd->clip, 0, 0,
+		pass->buffer->width, pass->buffer->height);
+	if (clip != NULL) {
+		pixman_region32_intersect(&cmd->clip, &cmd->clip, clip);
+	}
+	return cmd;
+}
+
+static void deferred_render_pass_add_texture(struct wlr_render_pass *wlr_pass,
+		const struct wlr_render_texture_options *options) {
+	struct deferred_render_pass *pass = deferred_render_pass_from_pass(wlr_pass);
+
+	struct wlr_box dst_box;
+	wlr_render_texture_options_get_dst_box(options, &dst_box);
+	struct deferred_render_command *cmd =
+		deferred_render_pass_add_command(pass, &dst_box, options->clip);
+	if (cmd == NULL) {
+		// Keep the operations in order, without culling
+		deferred_render_pass_flush(pass);
+		wlr_render_pass_add_texture(pass->parent, options);
+		return;
+	}
+
+	struct wlr_texture *texture = options->texture;
+	cmd->is_texture = true;
+	cmd->texture = *options;
+	cmd->texture.dst_box = dst_box;
+	cmd->alpha = wlr_render_texture_options_get_alpha(options);
+	if (options->wait_timeline != NULL) {
+		cmd->texture.wait_timeline = wlr_drm_syncobj_timeline_ref(options->wait_timeline);
+	}
+	cmd->opaque = options->blend_mode == WLR_RENDER_BLEND_MODE_NONE ||
+		(cmd->alpha == 1 && texture->impl->is_opaque != NULL &&
+		texture->impl->is_opaque(texture));
+}
+
+static void deferred_render_pass_add_rect(struct wlr_render_pass *wlr_pass,
+		const struct wlr_render_rect_options *options) {
+	struct deferred_render_pass *pass = deferred_render_pass_from_pass(wlr_pass);
+
+	struct wlr_box box;
+	wlr_render_rect_options_get_box(options, pass->buffer, &box);
+	struct deferred_render_command *cmd =
+		deferred_render_pass_add_command(pass, &box, options->clip);
+	if (cmd == NULL) {
+		deferred_render_pass_flush(pass);
+		wlr_render_pass_add_rect(pass->parent, options);
+		return;
+	}
+
+	cmd->rect = *options;
+	cmd->rect.box = box;
+	cmd->opaque = options->blend_mode == WLR_RENDER_BLEND_MODE_NONE ||
+		options->color.a == 1;
+}
+
+// Effects aren't recorded: they read what has been rendered before them, so
+// the recorded operations are flushed first.
+static bool deferred_render_pass_add_blur(struct wlr_render_pass *wlr_pass,
+		const struct wlr_render_blur_options *options) {
+	struct deferred_render_pass *pass = deferred_render_pass_from_pass(wlr_pass);
+	if (pass->parent->impl->add_blur == NULL) {
+		return false;
+	}
+	deferred_render_pass_flush(pass);
+	return wlr_render_pass_add_blur(pass->parent, options);
+}
+
+static bool deferred_render_pass_add_shadow(struct wlr_render_pass *wlr_pass,
+		const struct wlr_render_shadow_options *options) {
+	struct deferred_render_pass *pass = deferred_render_pass_from_pass(wlr_pass);
+	if (pass->parent->impl->add_shadow == NULL) {
+		return false;
+	}
+	deferred_render_pass_flush(pass);
+	return wlr_render_pass_add_shadow(pass->parent, options);
+}
+
+static const struct wlr_render_pass_impl deferred_render_pass_impl = {
+	.submit = deferred_render_pass_submit,
+	.add_texture = deferred_render_pass_add_texture,
+	.add_rect = deferred_render_pass_add_rect,
+	.add_blur = deferred_render_pass_add_blur,
+	.add_shadow = deferred_render_pass_add_shadow,
+};
+
+struct wlr_render_pass *deferred_render_pass_create(struct wlr_render_pass *parent,
+		struct wlr_buffer *buffer) {
+	struct deferred_render_pass *pass = calloc(1, sizeof(*pass));
+	if (pass == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	wlr_render_pass_init(&pass->base, &deferred_render_pass_impl);
+	pass->parent = parent;
+	pass->buffer = buffer;
+	wl_array_init(&pass->commands);
+	return &pass->base;
+}
@@ -1,8 +1,15 @@
 #include <assert.h>
 #include <drm_fourcc.h>
+#include <string.h>
 #include <wlr/util/log.h>
 #include "render/pixel_format.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 static const struct wlr_pixel_format_info pixel_format_info[] = {
 	{
 		.drm_format = DRM_FORMAT_XRGB8888,
@@ -191,14 +198,64 @@ static const size_t pixel_format_info_size =
 static const size_t opaque_pixel_formats_size =
 	sizeof(opaque_pixel_formats) / sizeof(opaque_pixel_formats[0]);
 
-const struct wlr_pixel_format_info *drm_get_pixel_format_info(uint32_t fmt) {
-	for (size_t i = 0; i < pixel_format_info_size; ++i) {
-		if (pixel_format_info[i].drm_format == fmt) {
-			return &pixel_format_info[i];
+static uint32_t pixel_format_index_hash(uint32_t fmt) {
+	// Fibonacci hashing: FourCCs are ASCII, the multiplication spreads the
+	// differing characters into the top bits
+	return (fmt * 0x9E3779B1u) >> 24;
+}
+
+void pixel_format_index_build(struct pixel_format_index *index,
+		const void *table, size_t stride, size_t key_offset, size_t len) {
+	static_assert(PIXEL_FORMAT_INDEX_SIZE == 256,
+		"pixel_format_index_hash() returns 8 bits");
+	assert(len < PIXEL_FORMAT_INDEX_SIZE / 2);
+
+	memset(index->values, 0, sizeof(index->values));
+	for (size_t i = 0; i < len; i++) {
+		uint32_t fmt;
+		memcpy(&fmt, (const char *)table + i * stride + key_offset, sizeof(fmt));
+
+		uint32_t slot = pixel_format_index_hash(fmt);
+		while (index->values[slot] != 0) {
+			assert(index->keys[slot] != fmt);
+			slot = (slot + 1) % PIXEL_FORMAT_INDEX_SIZE;
 		}
+		index->keys[slot] = fmt;
+		index->values[slot] = i + 1;
 	}
+}
 
-	return NULL;
+ptrdiff_t pixel_format_index_find(const struct pixel_format_index *index,
+		uint32_t fmt) {
+	uint32_t slot = pixel_format_index_hash(fmt);
+	while (index->values[slot] != 0) {
+		if (index->keys[slot] == fmt) {
+			return index->values[slot] - 1;
+		}
+		slot = (slot + 1) % PIXEL_FORMAT_INDEX_SIZE;
+	}
+	return -1;
+}
+
+static struct pixel_format_index pixel_format_info_index = PIXEL_FORMAT_INDEX_INIT;
+static struct pixel_format_index opaque_pixel_formats_index = PIXEL_FORMAT_INDEX_INIT;
+
+static void build_pixel_format_info_index(void) {
+	pixel_format_index_build(&pixel_format_info_index, pixel_format_info,
+		sizeof(pixel_format_info[0]),
+		offsetof(struct wlr_pixel_format_info, drm_format),
+		pixel_format_info_size);
+}
+
+static void build_opaque_pixel_formats_index(void) {
+	pixel_format_index_build(&opaque_pixel_formats_index, opaque_pixel_formats,
+		sizeof(opaque_pixel_formats[0]), 0, opaque_pixel_formats_size);
+}
+
+const struct wlr_pixel_format_info *drm_get_pixel_format_info(uint32_t fmt) {
+	pthread_once(&pixel_format_info_index.once, build_pixel_format_info_index);
+	ptrdiff_t i = pixel_format_index_find(&pixel_format_info_index, fmt);
+	return i >= 0 ? &pixel_format_info[i] : NULL;
 }
 
 uint32_t convert_wl_shm_format_to_drm(enum wl_shm_format fmt) {
@@ -268,10 +325,190 @@ bool pixel_format_info_check_stride(const struct wlr_pixel_format_info *fmt,
 }
 
 bool pixel_format_has_alpha(uint32_t fmt) {
-	for (size_t i = 0; i < opaque_pixel_formats_size; i++) {
-		if (fmt == opaque_pixel_formats[i]) {
-			return false;
+	pthread_once(&opaque_pixel_formats_index.once, build_opaque_pixel_formats_index);
+	return pixel_format_index_find(&opaque_pixel_formats_index, fmt) < 0;
+}
+
+/**
+ * Packed 32-bit RGB formats pixel_format_copy() can convert between. Formats
+ * with the same depth only differ in the order of the red and blue channels
+ * and in whether the top bits hold alpha or padding.
+ */
+struct copy_format {
+	uint32_t drm_format;
+	int depth; // bits per color channel
+	bool bgr; // red in the low bits
+	bool alpha;
+};
+
+static const struct copy_format copy_formats[] = {
+	{ DRM_FORMAT_XRGB8888, 8, false, false },
+	{ DRM_FORMAT_ARGB8888, 8, false, true },
+	{ DRM_FORMAT_XBGR8888, 8, true, false },
+	{ DRM_FORMAT_ABGR8888, 8, true, true },
+	{ DRM_FORMAT_XRGB2101010, 10, false, false },
+	{ DRM_FORMAT_ARGB2101010, 10, false, true },
+	{ DRM_FORMAT_XBGR2101010, 10, true, false },
+	{ DRM_FORMAT_ABGR2101010, 10, true, true },
+};
+
+static const struct copy_format *get_copy_format(uint32_t fmt) {
+	for (size_t i = 0; i < sizeof(copy_formats) / sizeof(copy_formats[0]); i++) {
+		if (copy_formats[i].drm_format == fmt) {
+			return &copy_formats[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Per-pixel conversion: the bits in keep are copied as is, the channels
+ * selected by low and (low << shift) are exchanged, and the bits in set are
+ * forced to one.
+ */
+struct swizzle {
+	uint32_t keep, low, set;
+	int shift;
+};
+
+static void swizzle_row_scalar(uint32_t *dst, const uint32_t *src, size_t len,
+		const struct swizzle *sw) {
+	for (size_t i = 0; i < len; i++) {
+		uint32_t p = src[i];
+		dst[i] = (p & sw->keep) | ((p & sw->low) << sw->shift) |
+			((p >> sw->shift) & sw->low) | sw->set;
+	}
+}
+
+#if defined(__SSE2__)
+static size_t swizzle_row_sse2(uint32_t *dst, const uint32_t *src, size_t len,
+		const struct swizzle *sw) {
+	const __m128i keep = _mm_set1_epi32((int)sw->keep);
+	const __m128i low = _mm_set1_epi32((int)sw->low);
+	const __m128i set = _mm_set1_epi32((int)sw->set);
+	const __m128i shift = _mm_cvtsi32_si128(sw->shift);
+
+	size_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i *)&src[i]);
+		__m128i r = _mm_or_si128(_mm_and_si128(p, keep), set);
+		r = _mm_or_si128(r, _mm_sll_epi32(_mm_and_si128(p, low), shift));
+		r = _mm_or_si128(r, _mm_and_si128(_mm_srl_epi32(p, shift), low));
+		_mm_storeu_si128((__m128i *)&dst[i], r);
+	}
+	return i;
+}
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_SWIZZLE_AVX2 1
+
+__attribute__((target("avx2")))
+static size_t swizzle_row_avx2(uint32_t *dst, const uint32_t *src, size_t len,
+		const struct swizzle *sw) {
+	const __m256i keep = _mm256_set1_epi32((int)sw->keep);
+	const __m256i low = _mm256_set1_epi32((int)sw->low);
+	const __m256i set = _mm256_set1_epi32((int)sw->set);
+	const __m128i shift = _mm_cvtsi32_si128(sw->shift);
+
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		__m256i p = _mm256_loadu_si256((const __m256i *)&src[i]);
+		__m256i r = _mm256_or_si256(_mm256_and_si256(p, keep), set);
+		r = _mm256_or_si256(r, _mm256_sll_epi32(_mm256_and_si256(p, low), shift));
+		r = _mm256_or_si256(r, _mm256_and_si256(_mm256_srl_epi32(p, shift), low));
+		_mm256_storeu_si256((__m256i *)&dst[i], r);
+	}
+	return i;
+}
+#endif
+
+#if defined(__ARM_NEON)
+static size_t swizzle_row_neon(uint32_t *dst, const uint32_t *src, size_t len,
+		const struct swizzle *sw) {
+	const uint32x4_t keep = vdupq_n_u32(sw->keep);
+	const uint32x4_t low = vdupq_n_u32(sw->low);
+	const uint32x4_t set = vdupq_n_u32(sw->set);
+	const int32x4_t shl = vdupq_n_s32(sw->shift);
+	const int32x4_t shr = vdupq_n_s32(-sw->shift);
+
+	size_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		uint32x4_t p = vld1q_u32(&src[i]);
+		uint32x4_t r = vorrq_u32(vandq_u32(p, keep), set);
+		r = vorrq_u32(r, vshlq_u32(vandq_u32(p, low), shl));
+		r = vorrq_u32(r, vandq_u32(vshlq_u32(p, shr), low));
+		vst1q_u32(&dst[i], r);
+	}
+	return i;
+}
+#endif
+
+typedef size_t (*swizzle_row_func_t)(uint32_t *dst, const uint32_t *src,
+	size_t len, const struct swizzle *sw);
+
+static swizzle_row_func_t get_swizzle_row_func(void) {
+#if HAVE_SWIZZLE_AVX2
+	if (__builtin_cpu_supports("avx2")) {
+		return swizzle_row_avx2;
+	}
+#endif
+#if defined(__SSE2__)
+	return swizzle_row_sse2;
+#elif defined(__ARM_NEON)
+	return swizzle_row_neon;
+#else
+	return NULL;
+#endif
+}
+
+bool pixel_format_copy(uint32_t dst_fmt, void *dst, uint32_t dst_stride,
+		uint32_t src_fmt, const void *src, uint32_t src_stride,
+		uint32_t width, uint32_t height) {
+	const struct copy_format *dst_info = get_copy_format(dst_fmt);
+	const struct copy_format *src_info = get_copy_format(src_fmt);
+	if (dst_info == NULL || src_info == NULL ||
+			dst_info->depth != src_info->depth) {
+		return false;
+	}
+
+	size_t row_size = (size_t)width * 4;
+	bool swap = dst_info->bgr != src_info->bgr;
+	bool set_alpha = dst_info->alpha && !src_info->alpha;
+	if (!swap && !set_alpha) {
+		if (dst_stride == src_stride && row_size == dst_stride) {
+			memcpy(dst, src, row_size * height);
+			return true;
 		}
+		for (uint32_t y = 0; y < height; y++) {
+			memcpy((char *)dst + (size_t)y * dst_stride,
+				(const char *)src + (size_t)y * src_stride, row_size);
+		}
+		return true;
 	}
+
+	int depth = dst_info->depth;
+	uint32_t channel = (1u << depth) - 1;
+	uint32_t padding = ~((1u << (3 * depth)) - 1);
+	struct swizzle sw = {
+		.keep = swap ? ~(channel | (channel << (2 * depth))) : 0xFFFFFFFF,
+		.low = swap ? channel : 0,
+		.shift = 2 * depth,
+		.set = set_alpha ? padding : 0,
+	};
+
+	swizzle_row_func_t swizzle_row = get_swizzle_row_func();
+	for (uint32_t y = 0; y < height; y++) {
+		uint32_t *dst_row = (uint32_t *)((char *)dst + (size_t)y * dst_stride);
+		const uint32_t *src_row =
+			(const uint32_t *)((const char *)src + (size_t)y * src_stride);
+
+		size_t done = 0;
+		if (swizzle_row != NULL) {
+			done = swizzle_row(dst_row, src_row, width, &sw);
+		}
+		swizzle_row_scalar(dst_row + done, src_row + done, width - done, &sw);
+	}
+
 	return true;
 }
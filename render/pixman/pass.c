@@ -1,6 +1,15 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <wlr/render/color.h>
+#include <wlr/util/log.h>
+#include "render/color.h"
 #include "render/pixman.h"
+#include "util/thread_pool.h"
+
+// Operations covering less than this area are not worth splitting across
+// threads
+#define THREADED_MIN_AREA (256 * 256)
+#define THREADED_MIN_TILE_HEIGHT 16
 
 static const struct wlr_render_pass_impl render_pass_impl;
 
@@ -16,9 +25,303 @@ static struct wlr_pixman_texture *get_texture(struct wlr_texture *wlr_texture) {
 	return texture;
 }
 
+struct render_op_source {
+	void *data;
+	pixman_format_code_t format;
+	int width, height;
+	int stride;
+};
+
+static void composite_op(const struct wlr_pixman_render_op *op,
+		const struct render_op_source *src, pixman_image_t *dst,
+		pixman_region32_t *clip) {
+	pixman_image_t *src_image;
+	if (src != NULL) {
+		src_image = pixman_image_create_bits_no_clear(src->format,
+			src->width, src->height, src->data, src->stride);
+	} else {
+		src_image = pixman_image_create_solid_fill(&op->color);
+	}
+	if (src_image == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create pixman image");
+		return;
+	}
+	if (op->has_transform) {
+		pixman_image_set_transform(src_image, &op->transform);
+	}
+	pixman_image_set_filter(src_image, op->filter, NULL, 0);
+
+	pixman_image_t *mask = NULL;
+	if (op->alpha != 1) {
+		mask = pixman_image_create_solid_fill(&(struct pixman_color){
+			.alpha = 0xFFFF * op->alpha,
+		});
+	}
+
+	pixman_image_set_clip_region32(dst, clip);
+	pixman_image_composite32(op->op, src_image, mask, dst,
+		op->src_x, op->src_y, 0, 0, op->dst_x, op->dst_y,
+		op->width, op->height);
+	pixman_image_set_clip_region32(dst, NULL);
+
+	if (mask != NULL) {
+		pixman_image_unref(mask);
+	}
+	pixman_image_unref(src_image);
+}
+
+struct render_op_tiles {
+	const struct wlr_pixman_render_op *op;
+	const struct render_op_source *src;
+	pixman_image_t *dst;
+	pixman_box32_t extents;
+	int tile_height;
+};
+
+static void composite_op_tile(void *data, int index) {
+	struct render_op_tiles *tiles = data;
+	const struct wlr_pixman_render_op *op = tiles->op;
+
+	const pixman_box32_t *extents = &tiles->extents;
+	pixman_region32_t clip;
+	pixman_region32_init(&clip);
+	pixman_region32_intersect_rect(&clip, &op->region,
+		extents->x1, extents->y1 + index * tiles->tile_height,
+		extents->x2 - extents->x1, tiles->tile_height);
+
+	// Pixman images aren't thread-safe: each tile gets its own views of the
+	// destination and source buffers
+	pixman_image_t *dst = tiles->dst;
+	pixman_image_t *tile_dst = pixman_image_create_bits_no_clear(
+		pixman_image_get_format(dst), pixman_image_get_width(dst),
+		pixman_image_get_height(dst), pixman_image_get_data(dst),
+		pixman_image_get_stride(dst));
+	if (tile_dst != NULL) {
+		composite_op(op, tiles->src, tile_dst, &clip);
+		pixman_image_unref(tile_dst);
+	} else {
+		wlr_log(WLR_ERROR, "Failed to create pixman image");
+	}
+
+	pixman_region32_fini(&clip);
+}
+
+static int get_region_area(const pixman_region32_t *region) {
+	int rects_len;
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+	int area = 0;
+	for (int i = 0; i < rects_len; i++) {
+		area += (rects[i].x2 - rects[i].x1) * (rects[i].y2 - rects[i].y1);
+	}
+	return area;
+}
+
+static void execute_op(struct wlr_pixman_render_pass *pass,
+		struct wlr_pixman_render_op *op) {
+	if (!pixman_region32_not_empty(&op->region)) {
+		return;
+	}
+
+	struct render_op_source src_storage, *src = NULL;
+	if (op->src_buffer != NULL) {
+		void *data;
+		uint32_t drm_format;
+		size_t stride;
+		if (!wlr_buffer_begin_data_ptr_access(op->src_buffer,
+				WLR_BUFFER_DATA_PTR_ACCESS_READ, &data, &drm_format, &stride)) {
+			return;
+		}
+		src_storage = (struct render_op_source){
+			.data = data,
+			.format = get_pixman_format_from_drm(drm_format),
+			.width = op->src_buffer->width,
+			.height = op->src_buffer->height,
+			.stride = stride,
+		};
+		src = &src_storage;
+	} else if (op->src_image != NULL) {
+		src_storage = (struct render_op_source){
+			.data = pixman_image_get_data(op->src_image),
+			.format = pixman_image_get_format(op->src_image),
+			.width = pixman_image_get_width(op->src_image),
+			.height = pixman_image_get_height(op->src_image),
+			.stride = pixman_image_get_stride(op->src_image),
+		};
+		src = &src_storage;
+	}
+
+	struct thread_pool *pool = pass->buffer->renderer->thread_pool;
+	const pixman_box32_t *extents = pixman_region32_extents(&op->region);
+	int height = extents->y2 - extents->y1;
+	int tiles_len = 1;
+	if (pool != NULL && get_region_area(&op->region) >= THREADED_MIN_AREA) {
+		tiles_len = thread_pool_get_size(pool);
+		if (tiles_len > height / THREADED_MIN_TILE_HEIGHT) {
+			tiles_len = height / THREADED_MIN_TILE_HEIGHT;
+		}
+	}
+
+	if (tiles_len > 1) {
+		struct render_op_tiles tiles = {
+			.op = op,
+			.src = src,
+			.dst = pass->buffer->image,
+			.extents = *extents,
+			.tile_height = (height + tiles_len - 1) / tiles_len,
+		};
+		thread_pool_run(pool, composite_op_tile, &tiles, tiles_len);
+	} else {
+		composite_op(op, src, pass->buffer->image, &op->region);
+	}
+
+	if (op->src_buffer != NULL) {
+		wlr_buffer_end_data_ptr_access(op->src_buffer);
+	}
+}
+
+static void render_op_finish(struct wlr_pixman_render_op *op) {
+	pixman_region32_fini(&op->region);
+	wlr_buffer_unlock(op->src_buffer);
+	if (op->src_image != NULL) {
+		pixman_image_unref(op->src_image);
+	}
+}
+
+// Removes from each operation the pixels overwritten by later opaque
+// operations, so that each pixel is only composited once
+static void eliminate_overdraw(struct wlr_pixman_render_pass *pass) {
+	struct wlr_pixman_render_op *ops = pass->ops.data;
+	size_t ops_len = pass->ops.size / sizeof(ops[0]);
+
+	pixman_region32_t covered;
+	pixman_region32_init(&covered);
+	for (size_t i = ops_len; i-- > 0;) {
+		struct wlr_pixman_render_op *op = &ops[i];
+		pixman_region32_subtract(&op->region, &op->region, &covered);
+		if (op->opaque) {
+			pixman_region32_union(&covered, &covered, &op->region);
+		}
+	}
+	pixman_region32_fini(&covered);
+}
+
+struct color_transform_tiles {
+	const struct wlr_color_lut3d_sampler *sampler;
+	pixman_image_t *dst;
+	const pixman_region32_t *region;
+	int red_shift, green_shift, blue_shift;
+	int y1, tile_height;
+};
+
+static void color_transform_tile(void *data, int index) {
+	struct color_transform_tiles *tiles = data;
+	uint32_t *pixels = pixman_image_get_data(tiles->dst);
+	int stride = pixman_image_get_stride(tiles->dst) / sizeof(uint32_t);
+	int tile_y1 = tiles->y1 + index * tiles->tile_height;
+	int tile_y2 = tile_y1 + tiles->tile_height;
+
+	int rects_len;
+	const pixman_box32_t *rects =
+		pixman_region32_rectangles(tiles->region, &rects_len);
+	for (int i = 0; i < rects_len; i++) {
+		const pixman_box32_t *rect = &rects[i];
+		int y1 = rect->y1 > tile_y1 ? rect->y1 : tile_y1;
+		int y2 = rect->y2 < tile_y2 ? rect->y2 : tile_y2;
+		for (int y = y1; y < y2; y++) {
+			color_lut3d_sampler_apply(tiles->sampler,
+				&pixels[y * stride + rect->x1], rect->x2 - rect->x1,
+				tiles->red_shift, tiles->green_shift, tiles->blue_shift);
+		}
+	}
+}
+
+static void apply_color_transform(struct wlr_pixman_render_pass *pass,
+		const pixman_region32_t *region) {
+	if (pass->color_transform->type != COLOR_TRANSFORM_LUT_3D ||
+			!pixman_region32_not_empty(region)) {
+		// Buffers are sRGB-encoded already
+		return;
+	}
+
+	struct color_transform_tiles tiles = {
+		.dst = pass->buffer->image,
+		.region = region,
+	};
+	switch (pixman_image_get_format(tiles.dst)) {
+	case PIXMAN_a8r8g8b8:
+	case PIXMAN_x8r8g8b8:
+		tiles.red_shift = 16;
+		tiles.green_shift = 8;
+		tiles.blue_shift = 0;
+		break;
+	case PIXMAN_a8b8g8r8:
+	case PIXMAN_x8b8g8r8:
+		tiles.red_shift = 0;
+		tiles.green_shift = 8;
+		tiles.blue_shift = 16;
+		break;
+	default:
+		// Rejected when the pass is created
+		abort();
+	}
+
+	struct wlr_color_lut3d_sampler sampler;
+	color_lut3d_sampler_init(&sampler,
+		wlr_color_transform_lut3d_from_base(pass->color_transform));
+	tiles.sampler = &sampler;
+
+	struct thread_pool *pool = pass->buffer->renderer->thread_pool;
+	const pixman_box32_t *extents = pixman_region32_extents(region);
+	int height = extents->y2 - extents->y1;
+	int tiles_len = 1;
+	if (pool != NULL && get_region_area(region) >= THREADED_MIN_AREA) {
+		tiles_len = thread_pool_get_size(pool);
+		if (tiles_len > height / THREADED_MIN_TILE_HEIGHT) {
+			tiles_len = height / THREADED_MIN_TILE_HEIGHT;
+		}
+	}
+	if (tiles_len < 1) {
+		tiles_len = 1;
+	}
+	tiles.y1 = extents->y1;
+	tiles.tile_height = (height + tiles_len - 1) / tiles_len;
+
+	if (tiles_len > 1) {
+		thread_pool_run(pool, color_transform_tile, &tiles, tiles_len);
+	} else {
+		color_transform_tile(&tiles, 0);
+	}
+}
+
 static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 	struct wlr_pixman_render_pass *pass = get_render_pass(wlr_pass);
 
+	// Pixels written by the pass, which the color transform is applied to.
+	// Pixels outside of it have been transformed by a previous pass already.
+	pixman_region32_t written;
+	pixman_region32_init(&written);
+
+	struct wlr_pixman_render_op *op;
+	if (pass->color_transform != NULL) {
+		wl_array_for_each(op, &pass->ops) {
+			pixman_region32_union(&written, &written, &op->region);
+		}
+	}
+
+	eliminate_overdraw(pass);
+
+	wl_array_for_each(op, &pass->ops) {
+		execute_op(pass, op);
+		render_op_finish(op);
+	}
+	wl_array_release(&pass->ops);
+
+	if (pass->color_transform != NULL) {
+		apply_color_transform(pass, &written);
+		wlr_color_transform_unref(pass->color_transform);
+	}
+	pixman_region32_fini(&written);
+
 	wlr_buffer_end_data_ptr_access(pass->buffer->buffer);
 	wlr_buffer_unlock(pass->buffer->buffer);
 	free(pass);
@@ -36,19 +339,38 @@ static pixman_op_t get_pixman_blending(enum wlr_render_blend_mode mode) {
 	abort();
 }
 
+// Records an operation, its region is set to the intersection of the clip
+// and the composited area
+static struct wlr_pixman_render_op *add_op(struct wlr_pixman_render_pass *pass,
+		const struct wlr_pixman_render_op *init, const pixman_region32_t *clip) {
+	struct wlr_pixman_render_op *op = wl_array_add(&pass->ops, sizeof(*op));
+	if (op == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	*op = *init;
+
+	struct wlr_buffer *buffer = pass->buffer->buffer;
+	pixman_region32_init_rect(&op->region, 0, 0, buffer->width, buffer->height);
+	if (clip != NULL) {
+		pixman_region32_intersect(&op->region, &op->region, clip);
+	}
+	pixman_region32_intersect_rect(&op->region, &op->region,
+		op->dst_x, op->dst_y, op->width, op->height);
+	return op;
+}
+
 static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 		const struct wlr_render_texture_options *options) {
 	struct wlr_pixman_render_pass *pass = get_render_pass(wlr_pass);
 	struct wlr_pixman_texture *texture = get_texture(options->texture);
 	struct wlr_pixman_buffer *buffer = pass->buffer;
 
-	if (texture->buffer != NULL && !begin_pixman_data_ptr_access(texture->buffer,
-			&texture->image, WLR_BUFFER_DATA_PTR_ACCESS_READ)) {
-		return;
-	}
-
-	pixman_op_t op = get_pixman_blending(options->blend_mode);
-	pixman_image_set_clip_region32(buffer->image, (pixman_region32_t *)options->clip);
+	struct wlr_pixman_render_op op = {
+		.op = get_pixman_blending(options->blend_mode),
+		.filter = PIXMAN_FILTER_NEAREST,
+		.alpha = wlr_render_texture_options_get_alpha(options),
+	};
 
 	struct wlr_fbox src_fbox;
 	wlr_render_texture_options_get_src_box(options, &src_fbox);
@@ -62,14 +384,6 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 	struct wlr_box dst_box;
 	wlr_render_texture_options_get_dst_box(options, &dst_box);
 
-	pixman_image_t *mask = NULL;
-	float alpha = wlr_render_texture_options_get_alpha(options);
-	if (alpha != 1) {
-		mask = pixman_image_create_solid_fill(&(struct pixman_color){
-			.alpha = 0xFFFF * alpha,
-		});
-	}
-
 	// Rotate the source size into destination coordinates
 	struct wlr_box src_box_transformed;
 	wlr_box_transform(&src_box_transformed, &src_box, options->transform,
@@ -107,9 +421,8 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 
 		// Pixman transforms are generally the opposite of what you expect because they
 		// apply to the coordinate system rather than the image.  The comments here
-		// refer to what happens to the image, so all the code between
-		// pixman_transform_init_identity() and pixman_image_set_transform() is probably
-		// best read backwards.  Also this means translations are in the opposite
+		// refer to what happens to the image, so all the pixman_transform_*() calls below
+		// are probably best read backwards.  Also this means translations are in the opposite
 		// direction, imagine them as moving the origin around rather than moving the
 		// image.
 		//
@@ -118,51 +431,50 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 		// coordinates.  But this only applies to internal wlroots code - the viewporter
 		// extension code makes sure that to clients everything works as it should.
 
-		struct pixman_transform transform;
-		pixman_transform_init_identity(&transform);
+		struct pixman_transform *transform = &op.transform;
+		pixman_transform_init_identity(transform);
+		op.has_transform = true;
 
 		// Apply scaling to get to the dst_box size.  Because the scaling is applied last
 		// it depends on the whether the rotation swapped width and height, which is why
 		// we use src_box_transformed instead of src_box.
-		pixman_transform_scale(&transform, NULL,
+		pixman_transform_scale(transform, NULL,
 			pixman_double_to_fixed(src_box_transformed.width / (double)dst_box.width),
 			pixman_double_to_fixed(src_box_transformed.height / (double)dst_box.height));
 
 		// pixman rotates about the origin which again leaves everything outside of the
 		// viewport.  Translate the result so that its new top-left corner is back at the
 		// origin.
-		pixman_transform_translate(&transform, NULL,
+		pixman_transform_translate(transform, NULL,
 			-pixman_int_to_fixed(tr_x), -pixman_int_to_fixed(tr_y));
 
 		// Apply the rotation
-		pixman_transform_rotate(&transform, NULL,
+		pixman_transform_rotate(transform, NULL,
 			pixman_int_to_fixed(tr_cos), pixman_int_to_fixed(tr_sin));
 
 		// Apply flip before rotation
 		if (options->transform >= WL_OUTPUT_TRANSFORM_FLIPPED) {
 			// The flip leaves everything left of the Y axis which is outside the
 			// viewport. So translate everything back into the viewport.
-			pixman_transform_translate(&transform, NULL,
+			pixman_transform_translate(transform, NULL,
 				-pixman_int_to_fixed(src_box.width), pixman_int_to_fixed(0));
 			// Flip by applying a scale of -1 to the X axis
-			pixman_transform_scale(&transform, NULL,
+			pixman_transform_scale(transform, NULL,
 				pixman_int_to_fixed(-1), pixman_int_to_fixed(1));
 		}
 
 		// Apply the translation for source crop so the origin is now at the top-left of
 		// the region we're actually using.  Do this last so all the other transforms
 		// apply on top of this.
-		pixman_transform_translate(&transform, NULL,
+		pixman_transform_translate(transform, NULL,
 			pixman_int_to_fixed(src_box.x), pixman_int_to_fixed(src_box.y));
 
-		pixman_image_set_transform(texture->image, &transform);
-
 		switch (options->filter_mode) {
 		case WLR_SCALE_FILTER_BILINEAR:
-			pixman_image_set_filter(texture->image, PIXMAN_FILTER_BILINEAR, NULL, 0);
+			op.filter = PIXMAN_FILTER_BILINEAR;
 			break;
 		case WLR_SCALE_FILTER_NEAREST:
-			pixman_image_set_filter(texture->image, PIXMAN_FILTER_NEAREST, NULL, 0);
+			op.filter = PIXMAN_FILTER_NEAREST;
 			break;
 		}
 
@@ -171,58 +483,65 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 		// width,height part of source crop is done here by the width and height we pass:
 		// because of the scaling, cropping at the end by dst_box.{width,height} is
 		// equivalent to if we cropped at the start by src_box.{width,height}.
-		pixman_image_composite32(op, texture->image, mask, buffer->image,
-			0, 0, // source x,y
-			0, 0, // mask x,y
-			dst_box.x, dst_box.y, // dest x,y
-			dst_box.width, dst_box.height // composite width,height
-		);
-
-		pixman_image_set_transform(texture->image, NULL);
+		op.dst_x = dst_box.x;
+		op.dst_y = dst_box.y;
+		op.width = dst_box.width;
+		op.height = dst_box.height;
 	} else {
 		// No transforms or crop needed, just a straight blit from the source
-		pixman_image_set_transform(texture->image, NULL);
-		pixman_image_composite32(op, texture->image, mask, buffer->image,
-			src_box.x, src_box.y, 0, 0, dst_box.x, dst_box.y,
-			src_box.width, src_box.height);
+		op.src_x = src_box.x;
+		op.src_y = src_box.y;
+		op.dst_x = dst_box.x;
+		op.dst_y = dst_box.y;
+		op.width = src_box.width;
+		op.height = src_box.height;
 	}
 
-	pixman_image_set_clip_region32(buffer->image, NULL);
+	// PIXMAN_OP_SRC ignores the destination. Bilinear filtering blends the
+	// edges of scaled textures with transparent pixels outside of them.
+	bool opaque_src = !pixel_format_has_alpha(texture->format_info->drm_format);
+	op.opaque = op.op == PIXMAN_OP_SRC || (opaque_src && op.alpha == 1 &&
+		(!op.has_transform || op.filter != PIXMAN_FILTER_BILINEAR));
 
+	// The texture may be destroyed before the pass is submitted, keep its
+	// pixels around until then
 	if (texture->buffer != NULL) {
-		wlr_buffer_end_data_ptr_access(texture->buffer);
+		op.src_buffer = wlr_buffer_lock(texture->buffer);
+	} else {
+		op.src_image = pixman_image_ref(texture->image);
 	}
 
-	if (mask != NULL) {
-		pixman_image_unref(mask);
+	if (add_op(pass, &op, options->clip) == NULL) {
+		render_op_finish(&op);
 	}
 }
 
 static void render_pass_add_rect(struct wlr_render_pass *wlr_pass,
 		const struct wlr_render_rect_options *options) {
 	struct wlr_pixman_render_pass *pass = get_render_pass(wlr_pass);
-	struct wlr_pixman_buffer *buffer = pass->buffer;
 	struct wlr_box box;
 	wlr_render_rect_options_get_box(options, pass->buffer->buffer, &box);
 
-	pixman_op_t op = get_pixman_blending(options->color.a == 1 ?
-		WLR_RENDER_BLEND_MODE_NONE : options->blend_mode);
-
-	struct pixman_color color = {
-		.red = options->color.r * 0xFFFF,
-		.green = options->color.g * 0xFFFF,
-		.blue = options->color.b * 0xFFFF,
-		.alpha = options->color.a * 0xFFFF,
+	struct wlr_pixman_render_op op = {
+		.op = get_pixman_blending(options->color.a == 1 ?
+			WLR_RENDER_BLEND_MODE_NONE : options->blend_mode),
+		.color = {
+			.red = options->color.r * 0xFFFF,
+			.green = options->color.g * 0xFFFF,
+			.blue = options->color.b * 0xFFFF,
+			.alpha = options->color.a * 0xFFFF,
+		},
+		.opaque = options->color.a == 1 ||
+			options->blend_mode == WLR_RENDER_BLEND_MODE_NONE,
+		.filter = PIXMAN_FILTER_NEAREST,
+		.alpha = 1,
+		.dst_x = box.x,
+		.dst_y = box.y,
+		.width = box.width,
+		.height = box.height,
 	};
 
-	pixman_image_t *fill = pixman_image_create_solid_fill(&color);
-
-	pixman_image_set_clip_region32(buffer->image, (pixman_region32_t *)options->clip);
-	pixman_image_composite32(op, fill, NULL, buffer->image,
-		0, 0, 0, 0, box.x, box.y, box.width, box.height);
-	pixman_image_set_clip_region32(buffer->image, NULL);
-
-	pixman_image_unref(fill);
+	add_op(pass, &op, options->clip);
 }
 
 static const struct wlr_render_pass_impl render_pass_impl = {
@@ -232,7 +551,21 @@ static const struct wlr_render_pass_impl render_pass_impl = {
 };
 
 struct wlr_pixman_render_pass *begin_pixman_render_pass(
-		struct wlr_pixman_buffer *buffer) {
+		struct wlr_pixman_buffer *buffer, struct wlr_color_transform *color_transform) {
+	if (color_transform != NULL && color_transform->type == COLOR_TRANSFORM_LUT_3D) {
+		switch (pixman_image_get_format(buffer->image)) {
+		case PIXMAN_a8r8g8b8:
+		case PIXMAN_x8r8g8b8:
+		case PIXMAN_a8b8g8r8:
+		case PIXMAN_x8b8g8r8:
+			break;
+		default:
+			wlr_log(WLR_ERROR, "Color transforms are only supported on "
+				"8-bit RGB buffers");
+			return NULL;
+		}
+	}
+
 	struct wlr_pixman_render_pass *pass = calloc(1, sizeof(*pass));
 	if (pass == NULL) {
 		return NULL;
@@ -248,6 +581,9 @@ struct wlr_pixman_render_pass *begin_pixman_render_pass(
 
 	wlr_buffer_lock(buffer->buffer);
 	pass->buffer = buffer;
+	if (color_transform != NULL) {
+		pass->color_transform = wlr_color_transform_ref(color_transform);
+	}
 
 	return pass;
 }
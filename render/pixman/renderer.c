@@ -8,7 +8,9 @@
 #include <wlr/util/log.h>
 
 #include "render/pixman.h"
+#include "render/wlr_renderer.h"
 #include "types/wlr_buffer.h"
+#include "util/thread_pool.h"
 
 static const struct wlr_renderer_impl renderer_impl;
 
@@ -82,6 +84,7 @@ static struct wlr_pixman_texture *get_texture(
 
 static void texture_destroy(struct wlr_texture *wlr_texture) {
 	struct wlr_pixman_texture *texture = get_texture(wlr_texture);
+	texture_set_memory_usage(wlr_texture, 0, false);
 	wl_list_remove(&texture->link);
 	pixman_image_unref(texture->image);
 	wlr_buffer_unlock(texture->buffer);
@@ -104,6 +107,18 @@ static bool texture_read_pixels(struct wlr_texture *wlr_texture,
 
 	void *p = wlr_texture_read_pixel_options_get_data(options);
 
+	// Plain copies and channel swizzles are much faster without going
+	// through pixman's generic fetch/store path
+	uint32_t src_stride = pixman_image_get_stride(texture->image);
+	const char *src_data = (const char *)pixman_image_get_data(texture->image) +
+		(size_t)src.y * src_stride +
+		(size_t)src.x * texture->format_info->bytes_per_block;
+	if (pixel_format_copy(options->format, p, options->stride,
+			texture->format_info->drm_format, src_data, src_stride,
+			src.width, src.height)) {
+		return true;
+	}
+
 	pixman_image_t *dst = pixman_image_create_bits_no_clear(fmt,
 			src.width, src.height, p, options->stride);
 
@@ -122,9 +137,15 @@ static uint32_t pixman_texture_preferred_read_format(struct wlr_texture *wlr_tex
 	return get_drm_format_from_pixman(pixman_format);
 }
 
+static bool pixman_texture_is_opaque(struct wlr_texture *wlr_texture) {
+	struct wlr_pixman_texture *texture = get_texture(wlr_texture);
+	return PIXMAN_FORMAT_A(pixman_image_get_format(texture->image)) == 0;
+}
+
 static const struct wlr_texture_impl texture_impl = {
 	.read_pixels = texture_read_pixels,
 	.preferred_read_format = pixman_texture_preferred_read_format,
+	.is_opaque = pixman_texture_is_opaque,
 	.destroy = texture_destroy,
 };
 
@@ -270,6 +291,9 @@ static struct wlr_texture *pixman_texture_from_buffer(
 	}
 
 	texture->buffer = wlr_buffer_lock(buffer);
+	// The texture reads from the buffer's memory directly
+	texture_set_memory_usage(&texture->wlr_texture,
+		stride * buffer->height, true);
 
 	return &texture->wlr_texture;
 }
@@ -288,6 +312,7 @@ static void pixman_destroy(struct wlr_renderer *wlr_renderer) {
 	}
 
 	wlr_drm_format_set_finish(&renderer->drm_formats);
+	thread_pool_destroy(renderer->thread_pool);
 
 	free(renderer);
 }
@@ -304,7 +329,8 @@ static struct wlr_render_pass *pixman_begin_buffer_pass(struct wlr_renderer *wlr
 		return NULL;
 	}
 
-	struct wlr_pixman_render_pass *pass = begin_pixman_render_pass(buffer);
+	struct wlr_pixman_render_pass *pass =
+		begin_pixman_render_pass(buffer, options->color_transform);
 	if (pass == NULL) {
 		return NULL;
 	}
@@ -319,6 +345,22 @@ static const struct wlr_renderer_impl renderer_impl = {
 	.begin_buffer_pass = pixman_begin_buffer_pass,
 };
 
+static int parse_threads_env(const char *name) {
+	const char *threads_str = getenv(name);
+	if (threads_str == NULL) {
+		return 1;
+	}
+
+	char *end;
+	int threads = (int)strtol(threads_str, &end, 10);
+	if (*end || threads < 1) {
+		wlr_log(WLR_ERROR, "%s specified with invalid integer, ignoring", name);
+		return 1;
+	}
+
+	return threads;
+}
+
 struct wlr_renderer *wlr_pixman_renderer_create(void) {
 	struct wlr_pixman_renderer *renderer = calloc(1, sizeof(*renderer));
 	if (renderer == NULL) {
@@ -327,10 +369,19 @@ struct wlr_renderer *wlr_pixman_renderer_create(void) {
 
 	wlr_log(WLR_INFO, "Creating pixman renderer");
 	wlr_renderer_init(&renderer->wlr_renderer, &renderer_impl, WLR_BUFFER_CAP_DATA_PTR);
-	renderer->wlr_renderer.features.output_color_transform = false;
+	renderer->wlr_renderer.features.output_color_transform = true;
 	wl_list_init(&renderer->buffers);
 	wl_list_init(&renderer->textures);
 
+	int threads = parse_threads_env("WLR_PIXMAN_THREADS");
+	if (threads > 1) {
+		renderer->thread_pool = thread_pool_create(threads);
+		if (renderer->thread_pool != NULL) {
+			wlr_log(WLR_DEBUG, "Compositing with %d pixman threads",
+				thread_pool_get_size(renderer->thread_pool));
+		}
+	}
+
 	size_t len = 0;
 	const uint32_t *formats = get_pixman_drm_formats(&len);
 
@@ -6,6 +6,11 @@
 #include <wlr/types/wlr_buffer.h>
 #include "render/drm_format_set.h"
 
+// Number of acquisitions after which an unused buffer is freed. Extra buffers
+// are only needed when the GPU or display falls behind, and hold a lot of
+// memory.
+#define SLOT_MAX_IDLE_ACQUIRES 120
+
 static void swapchain_handle_allocator_destroy(struct wl_listener *listener,
 		void *data) {
 	struct wlr_swapchain *swapchain =
@@ -70,6 +75,7 @@ static struct wlr_buffer *slot_acquire(struct wlr_swapchain *swapchain,
 	assert(slot->buffer != NULL);
 
 	slot->acquired = true;
+	slot->acquire_seq = swapchain->acquire_seq;
 
 	slot->release.notify = slot_handle_release;
 	wl_signal_add(&slot->buffer->events.release, &slot->release);
@@ -77,7 +83,22 @@ static struct wlr_buffer *slot_acquire(struct wlr_swapchain *swapchain,
 	return wlr_buffer_lock(slot->buffer);
 }
 
-struct wlr_buffer *wlr_swapchain_acquire(struct wlr_swapchain *swapchain) {
+static void swapchain_trim(struct wlr_swapchain *swapchain) {
+	for (size_t i = 0; i < WLR_SWAPCHAIN_CAP; i++) {
+		struct wlr_swapchain_slot *slot = &swapchain->slots[i];
+		if (slot->buffer == NULL || slot->acquired ||
+				swapchain->acquire_seq - slot->acquire_seq < SLOT_MAX_IDLE_ACQUIRES) {
+			continue;
+		}
+		wlr_log(WLR_DEBUG, "Freeing idle swapchain buffer");
+		slot_reset(slot);
+		swapchain->freed++;
+	}
+}
+
+static struct wlr_buffer *swapchain_acquire(struct wlr_swapchain *swapchain) {
+	// Slots are always picked in the same order, so that the last ones are
+	// left unused when fewer buffers are in flight
 	struct wlr_swapchain_slot *free_slot = NULL;
 	for (size_t i = 0; i < WLR_SWAPCHAIN_CAP; i++) {
 		struct wlr_swapchain_slot *slot = &swapchain->slots[i];
@@ -87,7 +108,9 @@ struct wlr_buffer *wlr_swapchain_acquire(struct wlr_swapchain *swapchain) {
 		if (slot->buffer != NULL) {
 			return slot_acquire(swapchain, slot);
 		}
-		free_slot = slot;
+		if (free_slot == NULL) {
+			free_slot = slot;
+		}
 	}
 	if (free_slot == NULL) {
 		wlr_log(WLR_ERROR, "No free output buffer slot");
@@ -105,9 +128,27 @@ struct wlr_buffer *wlr_swapchain_acquire(struct wlr_swapchain *swapchain) {
 		wlr_log(WLR_ERROR, "Failed to allocate buffer");
 		return NULL;
 	}
+	swapchain->allocated++;
 	return slot_acquire(swapchain, free_slot);
 }
 
+struct wlr_buffer *wlr_swapchain_acquire(struct wlr_swapchain *swapchain) {
+	swapchain->acquire_seq++;
+	struct wlr_buffer *buffer = swapchain_acquire(swapchain);
+	swapchain_trim(swapchain);
+	return buffer;
+}
+
+int wlr_swapchain_get_depth(struct wlr_swapchain *swapchain) {
+	int depth = 0;
+	for (size_t i = 0; i < WLR_SWAPCHAIN_CAP; i++) {
+		if (swapchain->slots[i].buffer != NULL) {
+			depth++;
+		}
+	}
+	return depth;
+}
+
 bool wlr_swapchain_has_buffer(struct wlr_swapchain *swapchain,
 		struct wlr_buffer *buffer) {
 	for (size_t i = 0; i < WLR_SWAPCHAIN_CAP; i++) {
@@ -0,0 +1,380 @@
+#include <drm_fourcc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/render/wlr_texture.h>
+#include <wlr/util/log.h>
+#include "render/texture_atlas.h"
+#include "types/wlr_buffer.h"
+
+// Shelf heights are rounded up to this to limit the number of shelf classes
+#define SHELF_HEIGHT_ALIGN 16
+
+/**
+ * Pages are split horizontally into shelves, each holding entries of a
+ * similar height side by side. Every entry is surrounded by a 1px border
+ * replicating its edges, so that filtering doesn't sample its neighbours.
+ */
+struct wlr_texture_atlas_page {
+	struct wlr_texture_atlas *atlas;
+	struct wl_list link; // wlr_texture_atlas.pages
+
+	struct wlr_texture *texture;
+	uint32_t *data; // CPU copy of the page, uploaded on change
+
+	struct wl_array shelves; // struct atlas_shelf
+	int used_height;
+
+	struct wl_list entries; // wlr_texture_atlas_entry.link
+};
+
+struct atlas_span {
+	int x, width;
+};
+
+struct atlas_shelf {
+	int y, height;
+	struct wl_array free_spans; // struct atlas_span, sorted by x
+};
+
+struct wlr_texture_atlas *texture_atlas_create(struct wlr_renderer *renderer) {
+	struct wlr_texture_atlas *atlas = calloc(1, sizeof(*atlas));
+	if (atlas == NULL) {
+		return NULL;
+	}
+
+	atlas->renderer = renderer;
+	wl_list_init(&atlas->pages);
+	return atlas;
+}
+
+static struct wlr_texture_atlas_page *page_create(struct wlr_texture_atlas *atlas) {
+	struct wlr_texture_atlas_page *page = calloc(1, sizeof(*page));
+	if (page == NULL) {
+		return NULL;
+	}
+
+	const size_t stride = TEXTURE_ATLAS_PAGE_SIZE * sizeof(uint32_t);
+	page->data = calloc(TEXTURE_ATLAS_PAGE_SIZE, stride);
+	if (page->data == NULL) {
+		free(page);
+		return NULL;
+	}
+
+	page->texture = wlr_texture_from_pixels(atlas->renderer, DRM_FORMAT_ARGB8888,
+		stride, TEXTURE_ATLAS_PAGE_SIZE, TEXTURE_ATLAS_PAGE_SIZE, page->data);
+	if (page->texture == NULL) {
+		free(page->data);
+		free(page);
+		return NULL;
+	}
+
+	page->atlas = atlas;
+	wl_array_init(&page->shelves);
+	wl_list_init(&page->entries);
+	wl_list_insert(&atlas->pages, &page->link);
+	return page;
+}
+
+static void page_destroy(struct wlr_texture_atlas_page *page) {
+	struct wlr_texture_atlas_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &page->entries, link) {
+		entry->texture = NULL;
+		entry->page = NULL;
+		wl_list_remove(&entry->link);
+		wl_list_init(&entry->link);
+	}
+
+	struct atlas_shelf *shelf;
+	wl_array_for_each(shelf, &page->shelves) {
+		wl_array_release(&shelf->free_spans);
+	}
+	wl_array_release(&page->shelves);
+
+	wlr_texture_destroy(page->texture);
+	wl_list_remove(&page->link);
+	free(page->data);
+	free(page);
+}
+
+void texture_atlas_destroy(struct wlr_texture_atlas *atlas) {
+	if (atlas == NULL) {
+		return;
+	}
+
+	struct wlr_texture_atlas_page *page, *tmp;
+	wl_list_for_each_safe(page, tmp, &atlas->pages, link) {
+		page_destroy(page);
+	}
+	free(atlas);
+}
+
+static bool shelf_alloc(struct atlas_shelf *shelf, int width, int *x) {
+	struct atlas_span *span;
+	wl_array_for_each(span, &shelf->free_spans) {
+		if (span->width < width) {
+			continue;
+		}
+
+		*x = span->x;
+		span->x += width;
+		span->width -= width;
+		if (span->width == 0) {
+			size_t index = span - (struct atlas_span *)shelf->free_spans.data;
+			size_t len = shelf->free_spans.size / sizeof(*span);
+			memmove(span, span + 1, (len - index - 1) * sizeof(*span));
+			shelf->free_spans.size -= sizeof(*span);
+		}
+		return true;
+	}
+
+	return false;
+}
+
+static void shelf_free(struct atlas_shelf *shelf, int x, int width) {
+	struct atlas_span *spans = shelf->free_spans.data;
+	size_t len = shelf->free_spans.size / sizeof(*spans);
+
+	size_t index = 0;
+	while (index < len && spans[index].x < x) {
+		index++;
+	}
+
+	bool merge_prev = index > 0 && spans[index - 1].x + spans[index - 1].width == x;
+	bool merge_next = index < len && x + width == spans[index].x;
+	if (merge_prev && merge_next) {
+		spans[index - 1].width += width + spans[index].width;
+		memmove(&spans[index], &spans[index + 1], (len - index - 1) * sizeof(*spans));
+		shelf->free_spans.size -= sizeof(*spans);
+	} else if (merge_prev) {
+		spans[index - 1].width += width;
+	} else if (merge_next) {
+		spans[index].x = x;
+		spans[index].width += width;
+	} else {
+		if (wl_array_add(&shelf->free_spans, sizeof(*spans)) == NULL) {
+			// Leak the area, it's only unusable until the page is destroyed
+			return;
+		}
+		spans = shelf->free_spans.data;
+		memmove(&spans[index + 1], &spans[index], (len - index) * sizeof(*spans));
+		spans[index] = (struct atlas_span){ .x = x, .width = width };
+	}
+}
+
+static bool shelf_can_fit(const struct atlas_shelf *shelf, int width) {
+	const struct atlas_span *span;
+	wl_array_for_each(span, &shelf->free_spans) {
+		if (span->width >= width) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool shelf_is_empty(const struct atlas_shelf *shelf) {
+	const struct atlas_span *spans = shelf->free_spans.data;
+	return shelf->free_spans.size == sizeof(*spans) &&
+		spans[0].width == TEXTURE_ATLAS_PAGE_SIZE;
+}
+
+static bool page_alloc(struct wlr_texture_atlas_page *page, int width, int height,
+		int *x, int *y, int *shelf_index) {
+	int shelf_height = (height + SHELF_HEIGHT_ALIGN - 1) /
+		SHELF_HEIGHT_ALIGN * SHELF_HEIGHT_ALIGN;
+
+	// Pick the tightest fitting shelf, without wasting more than half of it
+	struct atlas_shelf *shelves = page->shelves.data;
+	size_t shelves_len = page->shelves.size / sizeof(*shelves);
+	int best = -1;
+	for (size_t i = 0; i < shelves_len; i++) {
+		struct atlas_shelf *shelf = &shelves[i];
+		if (shelf->height < shelf_height || shelf->height >= 2 * shelf_height) {
+			continue;
+		}
+		if (best >= 0 && shelves[best].height <= shelf->height) {
+			continue;
+		}
+		if (shelf_can_fit(shelf, width)) {
+			best = i;
+		}
+	}
+
+	if (best >= 0) {
+		shelf_alloc(&shelves[best], width, x);
+	} else {
+		if (page->used_height + shelf_height > TEXTURE_ATLAS_PAGE_SIZE) {
+			return false;
+		}
+
+		struct atlas_shelf *shelf = wl_array_add(&page->shelves, sizeof(*shelf));
+		if (shelf == NULL) {
+			return false;
+		}
+		*shelf = (struct atlas_shelf){
+			.y = page->used_height,
+			.height = shelf_height,
+		};
+		wl_array_init(&shelf->free_spans);
+		struct atlas_span *span = wl_array_add(&shelf->free_spans, sizeof(*span));
+		if (span == NULL) {
+			page->shelves.size -= sizeof(*shelf);
+			return false;
+		}
+		*span = (struct atlas_span){ .x = 0, .width = TEXTURE_ATLAS_PAGE_SIZE };
+		page->used_height += shelf_height;
+
+		best = shelves_len;
+		shelf_alloc(shelf, width, x);
+	}
+
+	shelves = page->shelves.data;
+	*y = shelves[best].y;
+	*shelf_index = best;
+	return true;
+}
+
+static void page_free(struct wlr_texture_atlas_page *page, int shelf_index,
+		int x, int width) {
+	struct atlas_shelf *shelves = page->shelves.data;
+	shelf_free(&shelves[shelf_index], x, width);
+
+	// Give the space of empty top-most shelves back to the page
+	size_t shelves_len = page->shelves.size / sizeof(*shelves);
+	while (shelves_len > 0 && shelf_is_empty(&shelves[shelves_len - 1])) {
+		struct atlas_shelf *shelf = &shelves[shelves_len - 1];
+		page->used_height = shelf->y;
+		wl_array_release(&shelf->free_spans);
+		page->shelves.size -= sizeof(*shelf);
+		shelves_len--;
+	}
+}
+
+static void copy_pixels(uint32_t *dst, size_t dst_stride, const uint8_t *src,
+		size_t src_stride, int width, int height, uint32_t alpha_mask) {
+	for (int y = 0; y < height; y++) {
+		const uint32_t *src_row = (const uint32_t *)(src + y * src_stride);
+		uint32_t *dst_row = dst + y * dst_stride;
+		for (int x = 0; x < width; x++) {
+			dst_row[x] = src_row[x] | alpha_mask;
+		}
+	}
+}
+
+static void page_write(struct wlr_texture_atlas_page *page, int x, int y,
+		int width, int height, uint32_t stride, const void *data, uint32_t alpha_mask) {
+	const size_t page_stride = TEXTURE_ATLAS_PAGE_SIZE;
+	uint32_t *origin = page->data + (y + 1) * page_stride + x + 1;
+	copy_pixels(origin, page_stride, data, stride, width, height, alpha_mask);
+
+	// Replicate the edges into the border
+	for (int row = 0; row < height; row++) {
+		uint32_t *line = origin + row * page_stride;
+		line[-1] = line[0];
+		line[width] = line[width - 1];
+	}
+	memcpy(origin - page_stride - 1, origin - 1, (width + 2) * sizeof(uint32_t));
+	memcpy(origin + height * page_stride - 1,
+		origin + (height - 1) * page_stride - 1, (width + 2) * sizeof(uint32_t));
+}
+
+static bool page_upload(struct wlr_texture_atlas_page *page, const struct wlr_box *box) {
+	struct wlr_readonly_data_buffer *buffer = readonly_data_buffer_create(
+		DRM_FORMAT_ARGB8888, TEXTURE_ATLAS_PAGE_SIZE * sizeof(uint32_t),
+		TEXTURE_ATLAS_PAGE_SIZE, TEXTURE_ATLAS_PAGE_SIZE, page->data);
+	if (buffer == NULL) {
+		return false;
+	}
+
+	pixman_region32_t damage;
+	pixman_region32_init_rect(&damage, box->x, box->y, box->width, box->height);
+	bool ok = wlr_texture_update_from_buffer(page->texture, &buffer->base, &damage);
+	pixman_region32_fini(&damage);
+
+	readonly_data_buffer_drop(buffer);
+	return ok;
+}
+
+struct wlr_texture_atlas_entry *texture_atlas_add(struct wlr_texture_atlas *atlas,
+		uint32_t format, uint32_t stride, uint32_t width, uint32_t height,
+		const void *data) {
+	if (atlas->broken || width == 0 || height == 0 ||
+			width > TEXTURE_ATLAS_MAX_ENTRY_SIZE ||
+			height > TEXTURE_ATLAS_MAX_ENTRY_SIZE) {
+		return NULL;
+	}
+
+	uint32_t alpha_mask;
+	switch (format) {
+	case DRM_FORMAT_ARGB8888:
+		alpha_mask = 0;
+		break;
+	case DRM_FORMAT_XRGB8888:
+		alpha_mask = 0xFF000000;
+		break;
+	default:
+		return NULL;
+	}
+
+	int slot_width = width + 2, slot_height = height + 2;
+
+	struct wlr_texture_atlas_page *page;
+	int x, y, shelf_index;
+	bool found = false;
+	wl_list_for_each(page, &atlas->pages, link) {
+		if (page_alloc(page, slot_width, slot_height, &x, &y, &shelf_index)) {
+			found = true;
+			break;
+		}
+	}
+	if (!found) {
+		page = page_create(atlas);
+		if (page == NULL || !page_alloc(page, slot_width, slot_height,
+				&x, &y, &shelf_index)) {
+			return NULL;
+		}
+	}
+
+	struct wlr_texture_atlas_entry *entry = calloc(1, sizeof(*entry));
+	if (entry == NULL) {
+		page_free(page, shelf_index, x, slot_width);
+		return NULL;
+	}
+
+	page_write(page, x, y, width, height, stride, data, alpha_mask);
+
+	struct wlr_box slot = { x, y, slot_width, slot_height };
+	if (!page_upload(page, &slot)) {
+		wlr_log(WLR_DEBUG, "Renderer can't update atlas pages, disabling atlas");
+		atlas->broken = true;
+		page_free(page, shelf_index, x, slot_width);
+		free(entry);
+		return NULL;
+	}
+
+	entry->texture = page->texture;
+	entry->box = (struct wlr_box){ x + 1, y + 1, width, height };
+	entry->page = page;
+	entry->shelf_index = shelf_index;
+	wl_list_insert(&page->entries, &entry->link);
+	return entry;
+}
+
+void texture_atlas_entry_destroy(struct wlr_texture_atlas_entry *entry) {
+	if (entry == NULL) {
+		return;
+	}
+
+	struct wlr_texture_atlas_page *page = entry->page;
+	wl_list_remove(&entry->link);
+	if (page != NULL) {
+		page_free(page, entry->shelf_index, entry->box.x - 1, entry->box.width + 2);
+
+		// Keep a single empty page around to avoid churn
+		struct wlr_texture_atlas *atlas = page->atlas;
+		if (wl_list_empty(&page->entries) && wl_list_length(&atlas->pages) > 1) {
+			page_destroy(page);
+		}
+	}
+	free(entry);
+}
@@ -0,0 +1,635 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+#include <wlr/util/log.h>
+
+#include "render/vulkan.h"
+#include "render/vulkan/shaders/blur_down.comp.h"
+#include "render/vulkan/shaders/blur_up.comp.h"
+#include "render/vulkan/shaders/blur.frag.h"
+#include "render/vulkan/shaders/shadow.frag.h"
+
+static bool create_shader_module(VkDevice dev, const uint32_t *code,
+		size_t size, VkShaderModule *module) {
+	VkShaderModuleCreateInfo sinfo = {
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.codeSize = size,
+		.pCode = code,
+	};
+	VkResult res = vkCreateShaderModule(dev, &sinfo, NULL, module);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateShaderModule", res);
+		return false;
+	}
+	return true;
+}
+
+static bool create_compute_pipeline(struct wlr_vk_renderer *renderer,
+		VkShaderModule module, VkPipeline *pipe) {
+	VkComputePipelineCreateInfo pinfo = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = module,
+			.pName = "main",
+		},
+		.layout = renderer->effects.step_pipe_layout,
+	};
+	VkResult res = vkCreateComputePipelines(renderer->dev->dev,
+		renderer->pipeline_cache, 1, &pinfo, NULL, pipe);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateComputePipelines", res);
+		return false;
+	}
+	return true;
+}
+
+static bool init_effects(struct wlr_vk_renderer *renderer) {
+	struct wlr_vk_effects *effects = &renderer->effects;
+	VkDevice dev = renderer->dev->dev;
+	VkResult res;
+
+	if (!renderer->dev->queue_compute) {
+		wlr_log(WLR_DEBUG, "Vulkan queue doesn't support compute, "
+			"effects are unavailable");
+		return false;
+	}
+
+	VkSamplerCreateInfo sampler_info = {
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_LINEAR,
+		.minFilter = VK_FILTER_LINEAR,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.maxAnisotropy = 1.f,
+		.minLod = 0.f,
+		.maxLod = 0.25f,
+		.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+	};
+	res = vkCreateSampler(dev, &sampler_info, NULL, &effects->sampler);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateSampler", res);
+		return false;
+	}
+
+	VkDescriptorSetLayoutBinding step_bindings[2] = {
+		{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.pImmutableSamplers = &effects->sampler,
+		},
+		{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		},
+	};
+	VkDescriptorSetLayoutCreateInfo ds_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = 2,
+		.pBindings = step_bindings,
+	};
+	res = vkCreateDescriptorSetLayout(dev, &ds_info, NULL, &effects->step_ds_layout);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateDescriptorSetLayout", res);
+		return false;
+	}
+
+	VkPushConstantRange step_pc_range = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(struct wlr_vk_blur_step_pcr_data),
+	};
+	VkPipelineLayoutCreateInfo pl_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &effects->step_ds_layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &step_pc_range,
+	};
+	res = vkCreatePipelineLayout(dev, &pl_info, NULL, &effects->step_pipe_layout);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreatePipelineLayout", res);
+		return false;
+	}
+
+	VkDescriptorSetLayoutBinding blur_binding = {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.pImmutableSamplers = &effects->sampler,
+	};
+	ds_info = (VkDescriptorSetLayoutCreateInfo){
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = 1,
+		.pBindings = &blur_binding,
+	};
+	res = vkCreateDescriptorSetLayout(dev, &ds_info, NULL, &effects->blur_ds_layout);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateDescriptorSetLayout", res);
+		return false;
+	}
+
+	VkPushConstantRange blur_pc_ranges[2] = {
+		{
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+			.offset = 0,
+			.size = sizeof(struct wlr_vk_vert_pcr_data),
+		},
+		{
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.offset = sizeof(struct wlr_vk_vert_pcr_data),
+			.size = sizeof(struct wlr_vk_frag_blur_pcr_data),
+		},
+	};
+	pl_info = (VkPipelineLayoutCreateInfo){
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &effects->blur_ds_layout,
+		.pushConstantRangeCount = 2,
+		.pPushConstantRanges = blur_pc_ranges,
+	};
+	res = vkCreatePipelineLayout(dev, &pl_info, NULL, &effects->blur_pipe_layout);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreatePipelineLayout", res);
+		return false;
+	}
+
+	VkPushConstantRange shadow_pc_ranges[2] = {
+		{
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+			.offset = 0,
+			.size = sizeof(struct wlr_vk_vert_pcr_data),
+		},
+		{
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.offset = sizeof(struct wlr_vk_vert_pcr_data),
+			.size = sizeof(struct wlr_vk_frag_shadow_pcr_data),
+		},
+	};
+	pl_info = (VkPipelineLayoutCreateInfo){
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pushConstantRangeCount = 2,
+		.pPushConstantRanges = shadow_pc_ranges,
+	};
+	res = vkCreatePipelineLayout(dev, &pl_info, NULL, &effects->shadow_pipe_layout);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreatePipelineLayout", res);
+		return false;
+	}
+
+	if (!create_shader_module(dev, blur_down_comp_data,
+			sizeof(blur_down_comp_data), &effects->blur_down_module) ||
+			!create_shader_module(dev, blur_up_comp_data,
+			sizeof(blur_up_comp_data), &effects->blur_up_module) ||
+			!create_shader_module(dev, blur_frag_data,
+			sizeof(blur_frag_data), &effects->blur_frag_module) ||
+			!create_shader_module(dev, shadow_frag_data,
+			sizeof(shadow_frag_data), &effects->shadow_frag_module)) {
+		return false;
+	}
+
+	if (!create_compute_pipeline(renderer, effects->blur_down_module,
+			&effects->blur_down_pipe) ||
+			!create_compute_pipeline(renderer, effects->blur_up_module,
+			&effects->blur_up_pipe)) {
+		return false;
+	}
+
+	return true;
+}
+
+bool vulkan_init_effects(struct wlr_vk_renderer *renderer) {
+	struct wlr_vk_effects *effects = &renderer->effects;
+	if (effects->ready || effects->failed) {
+		return effects->ready;
+	}
+
+	if (!init_effects(renderer)) {
+		vulkan_finish_effects(renderer);
+		effects->failed = true;
+		return false;
+	}
+
+	effects->ready = true;
+	return true;
+}
+
+static void destroy_effect_image(struct wlr_vk_renderer *renderer,
+		struct wlr_vk_effect_image *image) {
+	VkDevice dev = renderer->dev->dev;
+	// descriptor sets automatically freed with their pool
+	vkDestroyDescriptorPool(dev, image->ds_pool, NULL);
+	for (uint32_t i = 0; i < image->levels; i++) {
+		vkDestroyImageView(dev, image->views[i], NULL);
+	}
+	vkDestroyImage(dev, image->image, NULL);
+	vkFreeMemory(dev, image->memory, NULL);
+	free(image);
+}
+
+void vulkan_finish_effects(struct wlr_vk_renderer *renderer) {
+	struct wlr_vk_effects *effects = &renderer->effects;
+	VkDevice dev = renderer->dev->dev;
+
+	struct wlr_vk_effect_image *image, *tmp_image;
+	wl_list_for_each_safe(image, tmp_image, &effects->images, link) {
+		wl_list_remove(&image->link);
+		destroy_effect_image(renderer, image);
+	}
+
+	vkDestroyPipeline(dev, effects->blur_down_pipe, NULL);
+	vkDestroyPipeline(dev, effects->blur_up_pipe, NULL);
+	vkDestroyShaderModule(dev, effects->blur_down_module, NULL);
+	vkDestroyShaderModule(dev, effects->blur_up_module, NULL);
+	vkDestroyShaderModule(dev, effects->blur_frag_module, NULL);
+	vkDestroyShaderModule(dev, effects->shadow_frag_module, NULL);
+	vkDestroyPipelineLayout(dev, effects->step_pipe_layout, NULL);
+	vkDestroyPipelineLayout(dev, effects->blur_pipe_layout, NULL);
+	vkDestroyPipelineLayout(dev, effects->shadow_pipe_layout, NULL);
+	vkDestroyDescriptorSetLayout(dev, effects->step_ds_layout, NULL);
+	vkDestroyDescriptorSetLayout(dev, effects->blur_ds_layout, NULL);
+	vkDestroySampler(dev, effects->sampler, NULL);
+
+	*effects = (struct wlr_vk_effects){ .failed = effects->failed };
+	wl_list_init(&effects->images);
+}
+
+static VkPipeline create_effect_pipeline(struct wlr_vk_render_format_setup *setup,
+		enum wlr_vk_effect_pipeline type) {
+	struct wlr_vk_renderer *renderer = setup->renderer;
+	struct wlr_vk_effects *effects = &renderer->effects;
+
+	VkShaderModule frag_module;
+	VkPipelineLayout layout;
+	bool blend_enable;
+	switch (type) {
+	case WLR_VK_EFFECT_PIPELINE_BLUR:
+		frag_module = effects->blur_frag_module;
+		layout = effects->blur_pipe_layout;
+		blend_enable = false;
+		break;
+	case WLR_VK_EFFECT_PIPELINE_BLUR_MASKED:
+		frag_module = effects->blur_frag_module;
+		layout = effects->blur_pipe_layout;
+		blend_enable = true;
+		break;
+	case WLR_VK_EFFECT_PIPELINE_SHADOW:
+		frag_module = effects->shadow_frag_module;
+		layout = effects->shadow_pipe_layout;
+		blend_enable = true;
+		break;
+	default:
+		abort(); // unreachable
+	}
+
+	VkPipelineShaderStageCreateInfo stages[2] = {
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_VERTEX_BIT,
+			.module = renderer->vert_module,
+			.pName = "main",
+		},
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.module = frag_module,
+			.pName = "main",
+		},
+	};
+
+	VkPipelineInputAssemblyStateCreateInfo assembly = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN,
+	};
+
+	VkPipelineRasterizationStateCreateInfo rasterization = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+		.polygonMode = VK_POLYGON_MODE_FILL,
+		.cullMode = VK_CULL_MODE_NONE,
+		.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+		.lineWidth = 1.f,
+	};
+
+	VkPipelineColorBlendAttachmentState blend_attachment = {
+		.blendEnable = blend_enable,
+		// we generally work with pre-multiplied alpha
+		.srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+		.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+		.colorBlendOp = VK_BLEND_OP_ADD,
+		.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+		.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+		.alphaBlendOp = VK_BLEND_OP_ADD,
+		.colorWriteMask =
+			VK_COLOR_COMPONENT_R_BIT |
+			VK_COLOR_COMPONENT_G_BIT |
+			VK_COLOR_COMPONENT_B_BIT |
+			VK_COLOR_COMPONENT_A_BIT,
+	};
+
+	VkPipelineColorBlendStateCreateInfo blend = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+		.attachmentCount = 1,
+		.pAttachments = &blend_attachment,
+	};
+
+	VkPipelineMultisampleStateCreateInfo multisample = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+	};
+
+	VkPipelineViewportStateCreateInfo viewport = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+		.viewportCount = 1,
+		.scissorCount = 1,
+	};
+
+	VkDynamicState dynStates[2] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR,
+	};
+	VkPipelineDynamicStateCreateInfo dynamic = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		.pDynamicStates = dynStates,
+		.dynamicStateCount = 2,
+	};
+
+	VkPipelineVertexInputStateCreateInfo vertex = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+	};
+
+	VkGraphicsPipelineCreateInfo pinfo = {
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.layout = layout,
+		.renderPass = setup->render_pass,
+		.subpass = 0,
+		.stageCount = 2,
+		.pStages = stages,
+		.pInputAssemblyState = &assembly,
+		.pRasterizationState = &rasterization,
+		.pColorBlendState = &blend,
+		.pMultisampleState = &multisample,
+		.pViewportState = &viewport,
+		.pDynamicState = &dynamic,
+		.pVertexInputState = &vertex,
+	};
+
+	VkPipeline pipe;
+	VkResult res = vkCreateGraphicsPipelines(renderer->dev->dev,
+		renderer->pipeline_cache, 1, &pinfo, NULL, &pipe);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("failed to create vulkan pipelines:", res);
+		return VK_NULL_HANDLE;
+	}
+
+	return pipe;
+}
+
+VkPipeline vulkan_setup_get_effect_pipeline(struct wlr_vk_render_format_setup *setup,
+		enum wlr_vk_effect_pipeline type) {
+	assert(setup->renderer->effects.ready);
+	if (setup->effect_pipes[type] == VK_NULL_HANDLE) {
+		setup->effect_pipes[type] = create_effect_pipeline(setup, type);
+	}
+	return setup->effect_pipes[type];
+}
+
+void vulkan_destroy_effect_pipelines(struct wlr_vk_render_format_setup *setup) {
+	VkDevice dev = setup->renderer->dev->dev;
+	for (size_t i = 0; i < WLR_VK_EFFECT_PIPELINE_COUNT; i++) {
+		vkDestroyPipeline(dev, setup->effect_pipes[i], NULL);
+	}
+}
+
+static void write_step_ds(VkDevice dev, VkDescriptorSet ds, int binding,
+		VkDescriptorType type, VkImageView view, VkImageLayout layout) {
+	VkDescriptorImageInfo image_info = {
+		.imageView = view,
+		.imageLayout = layout,
+	};
+	VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = ds,
+		.dstBinding = binding,
+		.descriptorCount = 1,
+		.descriptorType = type,
+		.pImageInfo = &image_info,
+	};
+	vkUpdateDescriptorSets(dev, 1, &write, 0, NULL);
+}
+
+static struct wlr_vk_effect_image *create_effect_image(
+		struct wlr_vk_renderer *renderer, uint32_t width, uint32_t height,
+		uint32_t levels) {
+	struct wlr_vk_effects *effects = &renderer->effects;
+	VkDevice dev = renderer->dev->dev;
+	VkResult res;
+
+	assert(levels > 0 && levels <= VULKAN_BLUR_MAX_PASSES);
+
+	struct wlr_vk_effect_image *image = calloc(1, sizeof(*image));
+	if (image == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	image->width = width;
+	image->height = height;
+
+	VkImageCreateInfo img_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = VK_FORMAT_R16G16B16A16_SFLOAT,
+		.mipLevels = levels,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.extent = (VkExtent3D) { width, height, 1 },
+		.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+	};
+	res = vkCreateImage(dev, &img_info, NULL, &image->image);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateImage failed", res);
+		goto error;
+	}
+
+	VkMemoryRequirements mem_reqs;
+	vkGetImageMemoryRequirements(dev, image->image, &mem_reqs);
+
+	int mem_type_index = vulkan_find_mem_type(renderer->dev,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mem_reqs.memoryTypeBits);
+	if (mem_type_index == -1) {
+		wlr_log(WLR_ERROR, "failed to find suitable vulkan memory type");
+		goto error;
+	}
+
+	VkMemoryAllocateInfo mem_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = mem_reqs.size,
+		.memoryTypeIndex = mem_type_index,
+	};
+	res = vkAllocateMemory(dev, &mem_info, NULL, &image->memory);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkAllocatorMemory failed", res);
+		goto error;
+	}
+
+	res = vkBindImageMemory(dev, image->image, image->memory, 0);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkBindMemory failed", res);
+		goto error;
+	}
+
+	for (uint32_t i = 0; i < levels; i++) {
+		VkImageViewCreateInfo view_info = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = image->image,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = img_info.format,
+			.components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+			.components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+			.components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+			.components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
+			.subresourceRange = (VkImageSubresourceRange) {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = i,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+		};
+		res = vkCreateImageView(dev, &view_info, NULL, &image->views[i]);
+		if (res != VK_SUCCESS) {
+			wlr_vk_error("vkCreateImageView failed", res);
+			goto error;
+		}
+		image->levels = i + 1;
+	}
+
+	// The sets of an image are never used by two blurs at once, so they
+	// come from a pool of their own
+	uint32_t step_count = 2 * levels - 1;
+	VkDescriptorPoolSize pool_sizes[2] = {
+		{
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = step_count + 1,
+		},
+		{
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = step_count,
+		},
+	};
+	VkDescriptorPoolCreateInfo dpool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = step_count + 1,
+		.poolSizeCount = 2,
+		.pPoolSizes = pool_sizes,
+	};
+	res = vkCreateDescriptorPool(dev, &dpool_info, NULL, &image->ds_pool);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateDescriptorPool", res);
+		goto error;
+	}
+
+	VkDescriptorSetLayout step_layouts[2 * VULKAN_BLUR_MAX_PASSES - 1];
+	for (uint32_t i = 0; i < step_count; i++) {
+		step_layouts[i] = effects->step_ds_layout;
+	}
+	VkDescriptorSet step_ds[2 * VULKAN_BLUR_MAX_PASSES - 1];
+	VkDescriptorSetAllocateInfo ds_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = image->ds_pool,
+		.descriptorSetCount = step_count,
+		.pSetLayouts = step_layouts,
+	};
+	res = vkAllocateDescriptorSets(dev, &ds_info, step_ds);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkAllocateDescriptorSets", res);
+		goto error;
+	}
+
+	ds_info.descriptorSetCount = 1;
+	ds_info.pSetLayouts = &effects->blur_ds_layout;
+	res = vkAllocateDescriptorSets(dev, &ds_info, &image->blur_ds);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkAllocateDescriptorSets", res);
+		goto error;
+	}
+
+	for (uint32_t i = 0; i < levels; i++) {
+		image->down_ds[i] = step_ds[i];
+		if (i > 0) {
+			write_step_ds(dev, image->down_ds[i], 0,
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				image->views[i - 1], VK_IMAGE_LAYOUT_GENERAL);
+		}
+		write_step_ds(dev, image->down_ds[i], 1,
+			VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			image->views[i], VK_IMAGE_LAYOUT_GENERAL);
+	}
+	for (uint32_t i = 0; i + 1 < levels; i++) {
+		image->up_ds[i] = step_ds[levels + i];
+		write_step_ds(dev, image->up_ds[i], 0,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			image->views[i + 1], VK_IMAGE_LAYOUT_GENERAL);
+		write_step_ds(dev, image->up_ds[i], 1,
+			VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			image->views[i], VK_IMAGE_LAYOUT_GENERAL);
+	}
+	write_step_ds(dev, image->blur_ds, 0,
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		image->views[0], VK_IMAGE_LAYOUT_GENERAL);
+
+	return image;
+
+error:
+	destroy_effect_image(renderer, image);
+	return NULL;
+}
+
+struct wlr_vk_effect_image *vulkan_acquire_effect_image(
+		struct wlr_vk_renderer *renderer, uint32_t width, uint32_t height,
+		uint32_t levels, VkImageView src_view, VkImageLayout src_layout) {
+	struct wlr_vk_effect_image *image = NULL, *iter;
+	wl_list_for_each(iter, &renderer->effects.images, link) {
+		if (iter->width == width && iter->height == height &&
+				iter->levels == levels) {
+			wl_list_remove(&iter->link);
+			image = iter;
+			break;
+		}
+	}
+	if (image == NULL) {
+		image = create_effect_image(renderer, width, height, levels);
+		if (image == NULL) {
+			return NULL;
+		}
+	}
+
+	// Unused images aren't referenced by pending command buffers, so the
+	// set can be updated
+	write_step_ds(renderer->dev->dev, image->down_ds[0], 0,
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, src_view, src_layout);
+	wl_list_init(&image->link);
+	return image;
+}
+
+void vulkan_release_effect_image(struct wlr_vk_renderer *renderer,
+		struct wlr_vk_effect_image *image) {
+	struct wl_list *images = &renderer->effects.images;
+	wl_list_insert(images, &image->link);
+	if (wl_list_length(images) > VULKAN_EFFECT_IMAGES_CAP) {
+		struct wlr_vk_effect_image *oldest =
+			wl_container_of(images->prev, oldest, link);
+		wl_list_remove(&oldest->link);
+		destroy_effect_image(renderer, oldest);
+	}
+}
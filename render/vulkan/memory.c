@@ -0,0 +1,209 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+#include <wlr/util/log.h>
+#include "render/vulkan.h"
+
+// Size of the device memory blocks images are suballocated from
+static const VkDeviceSize memory_page_size = 16 * 1024 * 1024; // 16MB
+// Larger images get a dedicated allocation
+static const VkDeviceSize max_suballocation_size = 4 * 1024 * 1024; // 4MB
+
+// Pages only hold optimally tiled images, so there is no need to care about
+// bufferImageGranularity between neighbouring allocations.
+
+static bool memory_page_alloc(struct wlr_vk_memory_page *page,
+		VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset) {
+	struct wlr_vk_allocation *allocs = page->allocs.data;
+	size_t allocs_len = page->allocs.size / sizeof(allocs[0]);
+
+	// First fit in the gaps between allocations
+	VkDeviceSize start = 0;
+	size_t i = 0;
+	while (true) {
+		start += alignment - 1 - ((start + alignment - 1) % alignment);
+		VkDeviceSize end = i < allocs_len ? allocs[i].start : page->size;
+		if (start <= end && end - start >= size) {
+			break;
+		}
+		if (i == allocs_len) {
+			return false;
+		}
+		start = allocs[i].start + allocs[i].size;
+		i++;
+	}
+
+	if (wl_array_add(&page->allocs, sizeof(*allocs)) == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	allocs = page->allocs.data;
+	memmove(&allocs[i + 1], &allocs[i], (allocs_len - i) * sizeof(*allocs));
+	allocs[i] = (struct wlr_vk_allocation){
+		.start = start,
+		.size = size,
+	};
+
+	*offset = start;
+	return true;
+}
+
+static void memory_page_destroy(struct wlr_vk_renderer *renderer,
+		struct wlr_vk_memory_page *page) {
+	vkFreeMemory(renderer->dev->dev, page->memory, NULL);
+	wl_array_release(&page->allocs);
+	wl_list_remove(&page->link);
+	free(page);
+}
+
+static struct wlr_vk_memory_page *memory_page_create(
+		struct wlr_vk_renderer *renderer, uint32_t mem_type) {
+	struct wlr_vk_memory_page *page = calloc(1, sizeof(*page));
+	if (page == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	VkMemoryAllocateInfo mem_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = memory_page_size,
+		.memoryTypeIndex = mem_type,
+	};
+	VkResult res = vkAllocateMemory(renderer->dev->dev, &mem_info, NULL,
+		&page->memory);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkAllocateMemory", res);
+		free(page);
+		return NULL;
+	}
+
+	page->mem_type = mem_type;
+	page->size = memory_page_size;
+	wl_array_init(&page->allocs);
+	wl_list_insert(&renderer->memory_pages, &page->link);
+	return page;
+}
+
+static bool alloc_suballocated_memory(struct wlr_vk_renderer *renderer,
+		const VkMemoryRequirements *reqs, uint32_t mem_type,
+		struct wlr_vk_memory *mem) {
+	VkDeviceSize offset;
+	struct wlr_vk_memory_page *page;
+	wl_list_for_each(page, &renderer->memory_pages, link) {
+		if (page->mem_type == mem_type &&
+				memory_page_alloc(page, reqs->size, reqs->alignment, &offset)) {
+			goto found;
+		}
+	}
+
+	page = memory_page_create(renderer, mem_type);
+	if (page == NULL) {
+		return false;
+	}
+	if (!memory_page_alloc(page, reqs->size, reqs->alignment, &offset)) {
+		memory_page_destroy(renderer, page);
+		return false;
+	}
+
+found:
+	*mem = (struct wlr_vk_memory){
+		.memory = page->memory,
+		.offset = offset,
+		.size = reqs->size,
+		.page = page,
+	};
+	return true;
+}
+
+static bool alloc_dedicated_memory(struct wlr_vk_renderer *renderer,
+		const VkMemoryRequirements *reqs, uint32_t mem_type,
+		struct wlr_vk_memory *mem) {
+	VkMemoryAllocateInfo mem_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = reqs->size,
+		.memoryTypeIndex = mem_type,
+	};
+	VkDeviceMemory memory;
+	VkResult res = vkAllocateMemory(renderer->dev->dev, &mem_info, NULL, &memory);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkAllocateMemory", res);
+		return false;
+	}
+
+	*mem = (struct wlr_vk_memory){
+		.memory = memory,
+		.size = reqs->size,
+	};
+	return true;
+}
+
+bool vulkan_bind_image_memory(struct wlr_vk_renderer *renderer, VkImage image,
+		VkMemoryPropertyFlags flags, struct wlr_vk_memory *mem) {
+	VkDevice dev = renderer->dev->dev;
+
+	VkMemoryRequirements reqs;
+	vkGetImageMemoryRequirements(dev, image, &reqs);
+
+	int mem_type = vulkan_find_mem_type(renderer->dev, flags, reqs.memoryTypeBits);
+	if (mem_type < 0) {
+		wlr_log(WLR_ERROR, "Failed to find suitable vulkan memory type");
+		return false;
+	}
+
+	bool ok;
+	if (reqs.size <= max_suballocation_size) {
+		ok = alloc_suballocated_memory(renderer, &reqs, mem_type, mem);
+	} else {
+		ok = alloc_dedicated_memory(renderer, &reqs, mem_type, mem);
+	}
+	if (!ok) {
+		return false;
+	}
+
+	VkResult res = vkBindImageMemory(dev, image, mem->memory, mem->offset);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkBindImageMemory", res);
+		vulkan_free_memory(renderer, mem);
+		return false;
+	}
+
+	return true;
+}
+
+void vulkan_free_memory(struct wlr_vk_renderer *renderer,
+		struct wlr_vk_memory *mem) {
+	if (mem->memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	struct wlr_vk_memory_page *page = mem->page;
+	if (page == NULL) {
+		vkFreeMemory(renderer->dev->dev, mem->memory, NULL);
+		*mem = (struct wlr_vk_memory){0};
+		return;
+	}
+
+	struct wlr_vk_allocation *allocs = page->allocs.data;
+	size_t allocs_len = page->allocs.size / sizeof(allocs[0]);
+	size_t i = 0;
+	while (i < allocs_len && allocs[i].start != mem->offset) {
+		i++;
+	}
+	assert(i < allocs_len);
+	memmove(&allocs[i], &allocs[i + 1], (allocs_len - i - 1) * sizeof(*allocs));
+	page->allocs.size -= sizeof(*allocs);
+
+	if (page->allocs.size == 0) {
+		memory_page_destroy(renderer, page);
+	}
+
+	*mem = (struct wlr_vk_memory){0};
+}
+
+void vulkan_finish_memory_pages(struct wlr_vk_renderer *renderer) {
+	struct wlr_vk_memory_page *page, *tmp;
+	wl_list_for_each_safe(page, tmp, &renderer->memory_pages, link) {
+		memory_page_destroy(renderer, page);
+	}
+}
@@ -1,6 +1,8 @@
 #include <assert.h>
 #include <drm_fourcc.h>
+#include <math.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <wlr/util/log.h>
 #include <wlr/render/color.h>
@@ -38,6 +40,49 @@ static void bind_pipeline(struct wlr_vk_render_pass *pass, VkPipeline pipeline)
 	pass->bound_pipeline = pipeline;
 }
 
+// Records the pending batch of bindless texture draws
+static void flush_texture_batch(struct wlr_vk_render_pass *pass) {
+	struct wlr_vk_pipeline *pipe = pass->batch.pipeline;
+	size_t size = pass->batch.instances.size;
+	if (size == 0) {
+		return;
+	}
+
+	struct wlr_vk_buffer_span span =
+		vulkan_get_render_span(pass->renderer, size, 16);
+	if (span.buffer == NULL) {
+		pass->failed = true;
+		goto out;
+	}
+	memcpy((char *)span.buffer->cpu_mapping + span.alloc.start,
+		pass->batch.instances.data, size);
+
+	VkCommandBuffer cb = pass->command_buffer->vk;
+	bind_pipeline(pass, pipe->vk);
+	if (pipe->layout->bindless->ds != pass->bound_tex_ds) {
+		vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipe->layout->vk, 0, 1, &pipe->layout->bindless->ds, 0, NULL);
+		pass->bound_tex_ds = pipe->layout->bindless->ds;
+	}
+
+	VkDeviceSize offset = span.alloc.start;
+	vkCmdBindVertexBuffers(cb, 0, 1, &span.buffer->buffer, &offset);
+
+	// Instances are clipped in the vertex shader
+	struct wlr_buffer *buffer = pass->render_buffer->wlr_buffer;
+	VkRect2D rect = {
+		.extent = { .width = buffer->width, .height = buffer->height },
+	};
+	vkCmdSetScissor(cb, 0, 1, &rect);
+
+	uint32_t instances_len = size / sizeof(struct wlr_vk_texture_instance);
+	vkCmdDraw(cb, 4, instances_len, 0, 0);
+
+out:
+	pass->batch.pipeline = NULL;
+	pass->batch.instances.size = 0;
+}
+
 static void get_clip_region(struct wlr_vk_render_pass *pass,
 		const pixman_region32_t *in, pixman_region32_t *out) {
 	if (in != NULL) {
@@ -81,6 +126,40 @@ static void mat3_to_mat4(const float mat3[9], float mat4[4][4]) {
 	mat4[3][3] = 1.f;
 }
 
+// Records the start of the render pass. Both attachments are loaded, so this
+// is also used to resume rendering after a blur.
+static void begin_render_pass(struct wlr_vk_render_pass *pass) {
+	struct wlr_vk_render_buffer *buffer = pass->render_buffer;
+	VkCommandBuffer cb = pass->command_buffer->vk;
+
+	int width = buffer->wlr_buffer->width;
+	int height = buffer->wlr_buffer->height;
+	VkRect2D rect = { .extent = { width, height } };
+
+	VkRenderPassBeginInfo rp_info = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+		.renderArea = rect,
+		.clearValueCount = 0,
+	};
+	if (pass->srgb_pathway) {
+		rp_info.renderPass = buffer->srgb.render_setup->render_pass;
+		rp_info.framebuffer = buffer->srgb.framebuffer;
+	} else {
+		rp_info.renderPass = buffer->plain.render_setup->render_pass;
+		rp_info.framebuffer = buffer->plain.framebuffer;
+	}
+	vkCmdBeginRenderPass(cb, &rp_info, VK_SUBPASS_CONTENTS_INLINE);
+
+	vkCmdSetViewport(cb, 0, 1, &(VkViewport){
+		.width = width,
+		.height = height,
+		.maxDepth = 1,
+	});
+
+	pass->bound_pipeline = VK_NULL_HANDLE;
+	pass->bound_tex_ds = VK_NULL_HANDLE;
+}
+
 static void render_pass_destroy(struct wlr_vk_render_pass *pass) {
 	struct wlr_vk_render_pass_texture *pass_texture;
 	wl_array_for_each(pass_texture, &pass->textures) {
@@ -91,6 +170,7 @@ static void render_pass_destroy(struct wlr_vk_render_pass *pass) {
 	wlr_drm_syncobj_timeline_unref(pass->signal_timeline);
 	rect_union_finish(&pass->updated_region);
 	wl_array_release(&pass->textures);
+	wl_array_release(&pass->batch.instances);
 	free(pass);
 }
 
@@ -150,6 +230,8 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 	VkSemaphoreSubmitInfoKHR *render_wait = NULL;
 	bool device_lost = false;
 
+	flush_texture_batch(pass);
+
 	if (pass->failed) {
 		goto error;
 	}
@@ -213,7 +295,7 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 			lut_ds = renderer->output_ds_lut3d_dummy;
 		}
 		VkDescriptorSet ds[] = {
-			render_buffer->plain.blend_descriptor_set, // set 0
+			render_buffer->plain.blend->descriptor_set, // set 0
 			lut_ds, // set 1
 		};
 		size_t ds_len = sizeof(ds) / sizeof(ds[0]);
@@ -357,16 +439,16 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 		// color attachment to read only, so on each frame, before
 		// the render pass starts, we change it back
 		VkImageLayout blend_src_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		if (!render_buffer->plain.blend_transitioned) {
+		if (!render_buffer->plain.blend->transitioned) {
 			blend_src_layout = VK_IMAGE_LAYOUT_UNDEFINED;
-			render_buffer->plain.blend_transitioned = true;
+			render_buffer->plain.blend->transitioned = true;
 		}
 
 		VkImageMemoryBarrier blend_acq_barrier = {
 			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
 			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
 			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.image = render_buffer->plain.blend_image,
+			.image = render_buffer->plain.blend->image,
 			.oldLayout = blend_src_layout,
 			.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
 			.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
@@ -453,21 +535,41 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 		.pSignalSemaphoreInfos = &stage_signal,
 	};
 
-	VkSemaphoreSubmitInfoKHR stage_wait;
+	// Uploads on the transfer queue need to complete before the stage cb
+	// acquires the images
+	uint64_t transfer_timeline_point;
+	if (!vulkan_submit_transfer_cb(renderer, &transfer_timeline_point)) {
+		goto error;
+	}
+
+	uint32_t stage_wait_len = 0;
+	VkSemaphoreSubmitInfoKHR stage_wait[2];
 	if (renderer->stage.last_timeline_point > 0) {
-		stage_wait = (VkSemaphoreSubmitInfoKHR){
+		stage_wait[stage_wait_len++] = (VkSemaphoreSubmitInfoKHR){
 			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR,
 			.semaphore = renderer->timeline_semaphore,
 			.value = renderer->stage.last_timeline_point,
 			.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR,
 		};
-
-		stage_submit.waitSemaphoreInfoCount = 1;
-		stage_submit.pWaitSemaphoreInfos = &stage_wait;
 	}
+	if (transfer_timeline_point > 0) {
+		stage_wait[stage_wait_len++] = (VkSemaphoreSubmitInfoKHR){
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR,
+			.semaphore = renderer->transfer.timeline_semaphore,
+			.value = transfer_timeline_point,
+			.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR,
+		};
+	}
+	stage_submit.waitSemaphoreInfoCount = stage_wait_len;
+	stage_submit.pWaitSemaphoreInfos = stage_wait;
 
 	renderer->stage.last_timeline_point = stage_timeline_point;
 
+	if (pass->timer != NULL) {
+		vkCmdWriteTimestamp(render_cb->vk, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			pass->timer->query_pool, 1);
+	}
+
 	uint64_t render_timeline_point = vulkan_end_command_buffer(render_cb, renderer);
 	if (render_timeline_point == 0) {
 		goto error;
@@ -529,13 +631,22 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 
 	free(render_wait);
 
+	if (pass->timer != NULL) {
+		clock_gettime(CLOCK_MONOTONIC, &pass->timer->cpu_end);
+		pass->timer->submitted = true;
+	}
+
+	vulkan_stage_spans_submitted(renderer, stage_timeline_point);
+
 	struct wlr_vk_shared_buffer *stage_buf, *stage_buf_tmp;
 	wl_list_for_each_safe(stage_buf, stage_buf_tmp, &renderer->stage.buffers, link) {
 		if (stage_buf->allocs.size == 0) {
 			continue;
 		}
+		// Also holds render spans, only release them once the render cb
+		// has completed
 		wl_list_remove(&stage_buf->link);
-		wl_list_insert(&stage_cb->stage_buffers, &stage_buf->link);
+		wl_list_insert(&render_cb->stage_buffers, &stage_buf->link);
 	}
 
 	if (!vulkan_sync_render_buffer(renderer, render_buffer, render_cb,
@@ -581,6 +692,8 @@ static void render_pass_add_rect(struct wlr_render_pass *wlr_pass,
 	struct wlr_vk_render_pass *pass = get_render_pass(wlr_pass);
 	VkCommandBuffer cb = pass->command_buffer->vk;
 
+	flush_texture_batch(pass);
+
 	// Input color values are given in sRGB space, shader expects
 	// them in linear space. The shader does all computation in linear
 	// space and expects in inputs in linear space since it outputs
@@ -681,6 +794,42 @@ static void render_pass_add_rect(struct wlr_render_pass *wlr_pass,
 	pixman_region32_fini(&clip);
 }
 
+// Computes the part of the unit square covered by a box, once the square is
+// mapped to pixels with the given matrix. This relies on the matrix mapping
+// the square to an axis-aligned rectangle, which holds for all
+// wl_output_transform values.
+static bool get_unit_clip_box(const float matrix[static 9],
+		const pixman_box32_t *box, struct wlr_fbox *out) {
+	float det = matrix[0] * matrix[4] - matrix[1] * matrix[3];
+	if (det == 0) {
+		return false;
+	}
+
+	// Map two opposite corners of the box back to the unit square
+	float u[2], v[2];
+	const float xs[2] = { box->x1, box->x2 }, ys[2] = { box->y1, box->y2 };
+	for (size_t i = 0; i < 2; i++) {
+		float x = xs[i] - matrix[2];
+		float y = ys[i] - matrix[5];
+		u[i] = (matrix[4] * x - matrix[1] * y) / det;
+		v[i] = (matrix[0] * y - matrix[3] * x) / det;
+	}
+
+	float u1 = fmaxf(fminf(u[0], u[1]), 0), u2 = fminf(fmaxf(u[0], u[1]), 1);
+	float v1 = fmaxf(fminf(v[0], v[1]), 0), v2 = fminf(fmaxf(v[0], v[1]), 1);
+	if (u1 >= u2 || v1 >= v2) {
+		return false;
+	}
+
+	*out = (struct wlr_fbox){
+		.x = u1,
+		.y = v1,
+		.width = u2 - u1,
+		.height = v2 - v1,
+	};
+	return true;
+}
+
 static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 		const struct wlr_render_texture_options *options) {
 	struct wlr_vk_render_pass *pass = get_render_pass(wlr_pass);
@@ -709,10 +858,10 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 	wlr_render_texture_options_get_dst_box(options, &dst_box);
 	float alpha = wlr_render_texture_options_get_alpha(options);
 
-	float proj[9], matrix[9];
+	float proj[9], box_matrix[9], matrix[9];
 	wlr_matrix_identity(proj);
-	wlr_matrix_project_box(matrix, &dst_box, options->transform, 0, proj);
-	wlr_matrix_multiply(matrix, pass->projection, matrix);
+	wlr_matrix_project_box(box_matrix, &dst_box, options->transform, 0, proj);
+	wlr_matrix_multiply(matrix, pass->projection, box_matrix);
 
 	struct wlr_vk_vert_pcr_data vert_pcr_data = {
 		.uv_off = {
@@ -735,6 +884,7 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 			.source = WLR_VK_SHADER_SOURCE_TEXTURE,
 			.layout = {
 				.ycbcr_format = texture->format->is_ycbcr ? texture->format : NULL,
+				.ycbcr_caps = texture->ycbcr_caps,
 				.filter_mode = options->filter_mode,
 			},
 			.texture_transform = texture->transform,
@@ -753,16 +903,26 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 		return;
 	}
 
-	bind_pipeline(pass, pipe->vk);
+	bool batched = pipe->layout->bindless != NULL;
+	if (batched && pass->batch.pipeline != pipe) {
+		flush_texture_batch(pass);
+		pass->batch.pipeline = pipe;
+	} else if (!batched) {
+		flush_texture_batch(pass);
 
-	vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS,
-		pipe->layout->vk, 0, 1, &view->ds, 0, NULL);
+		bind_pipeline(pass, pipe->vk);
+		if (view->ds != pass->bound_tex_ds) {
+			vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipe->layout->vk, 0, 1, &view->ds, 0, NULL);
+			pass->bound_tex_ds = view->ds;
+		}
 
-	vkCmdPushConstants(cb, pipe->layout->vk,
-		VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(vert_pcr_data), &vert_pcr_data);
-	vkCmdPushConstants(cb, pipe->layout->vk,
-		VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(vert_pcr_data), sizeof(float),
-		&alpha);
+		vkCmdPushConstants(cb, pipe->layout->vk,
+			VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(vert_pcr_data), &vert_pcr_data);
+		vkCmdPushConstants(cb, pipe->layout->vk,
+			VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(vert_pcr_data), sizeof(float),
+			&alpha);
+	}
 
 	pixman_region32_t clip;
 	get_clip_region(pass, options->clip, &clip);
@@ -770,10 +930,37 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 	int clip_rects_len;
 	const pixman_box32_t *clip_rects = pixman_region32_rectangles(&clip, &clip_rects_len);
 	for (int i = 0; i < clip_rects_len; i++) {
-		VkRect2D rect;
-		convert_pixman_box_to_vk_rect(&clip_rects[i], &rect);
-		vkCmdSetScissor(cb, 0, 1, &rect);
-		vkCmdDraw(cb, 4, 1, 0, 0);
+		if (batched) {
+			struct wlr_fbox pos;
+			if (!get_unit_clip_box(box_matrix, &clip_rects[i], &pos)) {
+				continue;
+			}
+
+			struct wlr_vk_texture_instance *instance =
+				wl_array_add(&pass->batch.instances, sizeof(*instance));
+			if (instance == NULL) {
+				wlr_log_errno(WLR_ERROR, "Allocation failed");
+				pass->failed = true;
+				break;
+			}
+			*instance = (struct wlr_vk_texture_instance){
+				.proj = {
+					{ matrix[0], matrix[1], matrix[2] },
+					{ matrix[3], matrix[4], matrix[5] },
+				},
+				.pos_off = { pos.x, pos.y },
+				.pos_size = { pos.width, pos.height },
+				.uv_off = { vert_pcr_data.uv_off[0], vert_pcr_data.uv_off[1] },
+				.uv_size = { vert_pcr_data.uv_size[0], vert_pcr_data.uv_size[1] },
+				.alpha = alpha,
+				.tex_index = view->bindless_index,
+			};
+		} else {
+			VkRect2D rect;
+			convert_pixman_box_to_vk_rect(&clip_rects[i], &rect);
+			vkCmdSetScissor(cb, 0, 1, &rect);
+			vkCmdDraw(cb, 4, 1, 0, 0);
+		}
 
 		struct wlr_box clip_box = {
 			.x = clip_rects[i].x1,
@@ -815,10 +1002,392 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 	}
 }
 
+static void render_pass_mark_region_updated(struct wlr_vk_render_pass *pass,
+		const pixman_box32_t *rects, int rects_len) {
+	for (int i = 0; i < rects_len; i++) {
+		struct wlr_box box = {
+			.x = rects[i].x1,
+			.y = rects[i].y1,
+			.width = rects[i].x2 - rects[i].x1,
+			.height = rects[i].y2 - rects[i].y1,
+		};
+		render_pass_mark_box_updated(pass, &box);
+	}
+}
+
+// Records a step of the blur, covering a whole level of the blur image
+static void record_blur_step(struct wlr_vk_render_pass *pass,
+		VkDescriptorSet ds, const struct wlr_vk_blur_step_pcr_data *pcr_data,
+		int width, int height) {
+	struct wlr_vk_effects *effects = &pass->renderer->effects;
+	VkCommandBuffer cb = pass->command_buffer->vk;
+
+	vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE,
+		effects->step_pipe_layout, 0, 1, &ds, 0, NULL);
+	vkCmdPushConstants(cb, effects->step_pipe_layout,
+		VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(*pcr_data), pcr_data);
+	vkCmdDispatch(cb, (width + 7) / 8, (height + 7) / 8, 1);
+}
+
+static void record_blur_step_barrier(VkCommandBuffer cb) {
+	VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+	};
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+static bool render_pass_add_blur(struct wlr_render_pass *wlr_pass,
+		const struct wlr_render_blur_options *options) {
+	struct wlr_vk_render_pass *pass = get_render_pass(wlr_pass);
+	struct wlr_vk_renderer *renderer = pass->renderer;
+	struct wlr_vk_render_buffer *render_buffer = pass->render_buffer;
+	struct wlr_buffer *buffer = render_buffer->wlr_buffer;
+	struct wlr_vk_effects *effects = &renderer->effects;
+
+	// The first downsampling step reads what has been rendered so far
+	VkImage src_image;
+	VkImageView src_view;
+	VkImageLayout src_layout, attachment_layout;
+	struct wlr_vk_render_format_setup *setup;
+	if (pass->srgb_pathway) {
+		if (!render_buffer->sampled) {
+			return false;
+		}
+		src_image = render_buffer->image;
+		src_view = render_buffer->srgb.image_view;
+		src_layout = VK_IMAGE_LAYOUT_GENERAL;
+		attachment_layout = VK_IMAGE_LAYOUT_GENERAL;
+		setup = render_buffer->srgb.render_setup;
+	} else {
+		// The render pass leaves the blending image read only
+		src_image = render_buffer->plain.blend->image;
+		src_view = render_buffer->plain.blend->image_view;
+		src_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		attachment_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		setup = render_buffer->plain.render_setup;
+	}
+
+	if (!vulkan_init_effects(renderer)) {
+		return false;
+	}
+	VkPipeline pipe = vulkan_setup_get_effect_pipeline(setup,
+		options->corner_radius > 0 ? WLR_VK_EFFECT_PIPELINE_BLUR_MASKED :
+		WLR_VK_EFFECT_PIPELINE_BLUR);
+	if (pipe == VK_NULL_HANDLE) {
+		return false;
+	}
+
+	pixman_region32_t region;
+	pixman_region32_init_rect(&region, options->box.x, options->box.y,
+		options->box.width, options->box.height);
+	pixman_region32_intersect_rect(&region, &region,
+		0, 0, buffer->width, buffer->height);
+	if (options->clip) {
+		pixman_region32_intersect(&region, &region, options->clip);
+	}
+	if (!pixman_region32_not_empty(&region)) {
+		pixman_region32_fini(&region);
+		return true;
+	}
+
+	float offset = options->offset > 0 ? options->offset : 1;
+
+	// Pixels this far away from the blurred area contribute to the result,
+	// the sample distance doubles at each step
+	int margin = ceilf(offset * (2 << options->passes));
+	const pixman_box32_t *extents = pixman_region32_extents(&region);
+	struct wlr_box src = {
+		.x = extents->x1 - margin,
+		.y = extents->y1 - margin,
+		.width = extents->x2 - extents->x1 + 2 * margin,
+		.height = extents->y2 - extents->y1 + 2 * margin,
+	};
+	wlr_box_intersection(&src, &src, &(struct wlr_box){
+		.width = buffer->width,
+		.height = buffer->height,
+	});
+
+	// Level 0 is the source area, each following level is half the size
+	// of the previous one. Levels from 1 on are mip levels of the blur image.
+	int widths[VULKAN_BLUR_MAX_PASSES + 1], heights[VULKAN_BLUR_MAX_PASSES + 1];
+	widths[0] = src.width;
+	heights[0] = src.height;
+	int passes = 0;
+	while (passes < options->passes && passes < VULKAN_BLUR_MAX_PASSES &&
+			(widths[passes] > 1 || heights[passes] > 1)) {
+		passes++;
+		widths[passes] = widths[passes - 1] > 1 ? widths[passes - 1] / 2 : 1;
+		heights[passes] = heights[passes - 1] > 1 ? heights[passes - 1] / 2 : 1;
+	}
+	if (passes == 0) {
+		pixman_region32_fini(&region);
+		return true;
+	}
+
+	struct wlr_vk_effect_image *image = vulkan_acquire_effect_image(renderer,
+		widths[1], heights[1], passes, src_view, src_layout);
+	if (image == NULL) {
+		pixman_region32_fini(&region);
+		return false;
+	}
+	wl_list_insert(&pass->command_buffer->effect_images, &image->link);
+
+	flush_texture_batch(pass);
+
+	// Reading back the render target requires ending the render pass. The
+	// output subpass doesn't draw anything here, it runs on submit.
+	VkCommandBuffer cb = pass->command_buffer->vk;
+	if (!pass->srgb_pathway) {
+		vkCmdNextSubpass(cb, VK_SUBPASS_CONTENTS_INLINE);
+	}
+	vkCmdEndRenderPass(cb);
+
+	VkImageMemoryBarrier acquire_barriers[2] = {
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = src_image,
+			.oldLayout = src_layout,
+			.newLayout = src_layout,
+			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+			.subresourceRange = {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.levelCount = 1,
+				.layerCount = 1,
+			},
+		},
+		{
+			// Previous contents are overwritten
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = image->image,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.srcAccessMask = 0,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			.subresourceRange = {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.levelCount = image->levels,
+				.layerCount = 1,
+			},
+		},
+	};
+	// The final layout transition of the render pass is part of its
+	// external dependency, which ends at the bottom of the pipe
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL,
+		2, acquire_barriers);
+
+	struct wlr_vk_blur_step_pcr_data pcr_data = {
+		.uv_off = {
+			(float)src.x / buffer->width,
+			(float)src.y / buffer->height,
+		},
+		.uv_size = {
+			(float)src.width / buffer->width,
+			(float)src.height / buffer->height,
+		},
+		.offset = offset,
+	};
+	vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, effects->blur_down_pipe);
+	for (int i = 1; i <= passes; i++) {
+		if (i > 1) {
+			record_blur_step_barrier(cb);
+		}
+		record_blur_step(pass, image->down_ds[i - 1], &pcr_data,
+			widths[i], heights[i]);
+
+		// Following steps read whole levels of the blur image
+		pcr_data.uv_off[0] = pcr_data.uv_off[1] = 0;
+		pcr_data.uv_size[0] = pcr_data.uv_size[1] = 1;
+	}
+	if (passes > 1) {
+		vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, effects->blur_up_pipe);
+		for (int i = passes - 1; i >= 1; i--) {
+			record_blur_step_barrier(cb);
+			record_blur_step(pass, image->up_ds[i - 1], &pcr_data,
+				widths[i], heights[i]);
+		}
+	}
+
+	VkMemoryBarrier result_barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+	};
+	VkImageMemoryBarrier release_barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = src_image,
+		.oldLayout = src_layout,
+		.newLayout = attachment_layout,
+		.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
+		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		.subresourceRange = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.levelCount = 1,
+			.layerCount = 1,
+		},
+	};
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		0, 1, &result_barrier, 0, NULL, 1, &release_barrier);
+
+	begin_render_pass(pass);
+
+	// The last upsampling step writes the blurred area into the render
+	// target, masked with the rounded corners
+	float proj[9], matrix[9];
+	wlr_matrix_identity(proj);
+	wlr_matrix_project_box(matrix, &src, WL_OUTPUT_TRANSFORM_NORMAL, 0, proj);
+	wlr_matrix_multiply(matrix, pass->projection, matrix);
+
+	struct wlr_vk_vert_pcr_data vert_pcr_data = {
+		.uv_off = { 0, 0 },
+		.uv_size = { 1, 1 },
+	};
+	mat3_to_mat4(matrix, vert_pcr_data.mat4);
+
+	struct wlr_vk_frag_blur_pcr_data frag_pcr_data = {
+		.mask_box = {
+			options->box.x - src.x,
+			options->box.y - src.y,
+			options->box.width,
+			options->box.height,
+		},
+		.halfpixel = { 0.5f / (widths[1] * 2), 0.5f / (heights[1] * 2) },
+		.tex_size = { src.width, src.height },
+		.offset = offset,
+		.mask_radius = options->corner_radius,
+	};
+
+	bind_pipeline(pass, pipe);
+	vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS,
+		effects->blur_pipe_layout, 0, 1, &image->blur_ds, 0, NULL);
+	pass->bound_tex_ds = image->blur_ds;
+	vkCmdPushConstants(cb, effects->blur_pipe_layout,
+		VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(vert_pcr_data), &vert_pcr_data);
+	vkCmdPushConstants(cb, effects->blur_pipe_layout,
+		VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(vert_pcr_data),
+		sizeof(frag_pcr_data), &frag_pcr_data);
+
+	int rects_len;
+	const pixman_box32_t *rects = pixman_region32_rectangles(&region, &rects_len);
+	for (int i = 0; i < rects_len; i++) {
+		VkRect2D rect;
+		convert_pixman_box_to_vk_rect(&rects[i], &rect);
+		vkCmdSetScissor(cb, 0, 1, &rect);
+		vkCmdDraw(cb, 4, 1, 0, 0);
+	}
+	render_pass_mark_region_updated(pass, rects, rects_len);
+
+	pixman_region32_fini(&region);
+	return true;
+}
+
+static bool render_pass_add_shadow(struct wlr_render_pass *wlr_pass,
+		const struct wlr_render_shadow_options *options) {
+	struct wlr_vk_render_pass *pass = get_render_pass(wlr_pass);
+	struct wlr_vk_renderer *renderer = pass->renderer;
+	const struct wlr_box *box = &options->box;
+	VkCommandBuffer cb = pass->command_buffer->vk;
+
+	if (!vulkan_init_effects(renderer)) {
+		return false;
+	}
+	struct wlr_vk_render_format_setup *setup = pass->srgb_pathway ?
+		pass->render_buffer->srgb.render_setup :
+		pass->render_buffer->plain.render_setup;
+	VkPipeline pipe = vulkan_setup_get_effect_pipeline(setup,
+		WLR_VK_EFFECT_PIPELINE_SHADOW);
+	if (pipe == VK_NULL_HANDLE) {
+		return false;
+	}
+
+	flush_texture_batch(pass);
+
+	float sigma = fmaxf(options->blur_sigma, 0.5);
+	int extent = ceilf(3 * sigma);
+	struct wlr_box area = {
+		.x = box->x - extent,
+		.y = box->y - extent,
+		.width = box->width + 2 * extent,
+		.height = box->height + 2 * extent,
+	};
+
+	pixman_region32_t clip;
+	get_clip_region(pass, options->clip, &clip);
+	pixman_region32_intersect_rect(&clip, &clip,
+		area.x, area.y, area.width, area.height);
+
+	int radius = options->corner_radius;
+	int max_radius = (box->width < box->height ? box->width : box->height) / 2;
+	if (radius > max_radius) {
+		radius = max_radius;
+	}
+
+	float proj[9], matrix[9];
+	wlr_matrix_identity(proj);
+	wlr_matrix_project_box(matrix, &area, WL_OUTPUT_TRANSFORM_NORMAL, 0, proj);
+	wlr_matrix_multiply(matrix, pass->projection, matrix);
+
+	// Texture coordinates are positions in buffer coordinates
+	struct wlr_vk_vert_pcr_data vert_pcr_data = {
+		.uv_off = { area.x, area.y },
+		.uv_size = { area.width, area.height },
+	};
+	mat3_to_mat4(matrix, vert_pcr_data.mat4);
+
+	const struct wlr_render_color *color = &options->color;
+	struct wlr_vk_frag_shadow_pcr_data frag_pcr_data = {
+		.color = {
+			color_to_linear_premult(color->r, color->a),
+			color_to_linear_premult(color->g, color->a),
+			color_to_linear_premult(color->b, color->a),
+			color->a, // no conversion for alpha
+		},
+		.box = { box->x, box->y, box->width, box->height },
+		.radius = radius,
+		.sigma = sigma,
+	};
+
+	struct wlr_vk_effects *effects = &renderer->effects;
+	bind_pipeline(pass, pipe);
+	vkCmdPushConstants(cb, effects->shadow_pipe_layout,
+		VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(vert_pcr_data), &vert_pcr_data);
+	vkCmdPushConstants(cb, effects->shadow_pipe_layout,
+		VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(vert_pcr_data),
+		sizeof(frag_pcr_data), &frag_pcr_data);
+
+	int rects_len;
+	const pixman_box32_t *rects = pixman_region32_rectangles(&clip, &rects_len);
+	for (int i = 0; i < rects_len; i++) {
+		VkRect2D rect;
+		convert_pixman_box_to_vk_rect(&rects[i], &rect);
+		vkCmdSetScissor(cb, 0, 1, &rect);
+		vkCmdDraw(cb, 4, 1, 0, 0);
+	}
+	render_pass_mark_region_updated(pass, rects, rects_len);
+
+	pixman_region32_fini(&clip);
+	return true;
+}
+
 static const struct wlr_render_pass_impl render_pass_impl = {
 	.submit = render_pass_submit,
 	.add_rect = render_pass_add_rect,
 	.add_texture = render_pass_add_texture,
+	.add_blur = render_pass_add_blur,
+	.add_shadow = render_pass_add_shadow,
 };
 
 
@@ -1040,13 +1609,25 @@ static const struct wlr_addon_interface vk_color_transform_impl = {
 
 struct wlr_vk_render_pass *vulkan_begin_render_pass(struct wlr_vk_renderer *renderer,
 		struct wlr_vk_render_buffer *buffer, const struct wlr_buffer_pass_options *options) {
+	struct timespec cpu_start;
+	clock_gettime(CLOCK_MONOTONIC, &cpu_start);
+
+	struct wlr_color_transform *color_transform =
+		options != NULL ? options->color_transform : NULL;
+	if (color_transform != NULL && color_transform->type == COLOR_TRANSFORM_SRGB &&
+			buffer->srgb.framebuffer != VK_NULL_HANDLE) {
+		// The sRGB image view applies the same encoding when writing, so
+		// skip the intermediate blending image and the output subpass
+		color_transform = NULL;
+	}
+
 	bool using_srgb_pathway;
-	if (options != NULL && options->color_transform != NULL) {
+	if (color_transform != NULL) {
 		using_srgb_pathway = false;
 
-		if (!get_color_transform(options->color_transform, renderer)) {
+		if (!get_color_transform(color_transform, renderer)) {
 			/* Try to create a new color transform */
-			if (!vk_color_transform_create(renderer, options->color_transform)) {
+			if (!vk_color_transform_create(renderer, color_transform)) {
 				wlr_log(WLR_ERROR, "Failed to create color transform");
 				return NULL;
 			}
@@ -1073,8 +1654,8 @@ struct wlr_vk_render_pass *vulkan_begin_render_pass(struct wlr_vk_renderer *rend
 	wlr_render_pass_init(&pass->base, &render_pass_impl);
 	pass->renderer = renderer;
 	pass->srgb_pathway = using_srgb_pathway;
-	if (options != NULL && options->color_transform != NULL) {
-		pass->color_transform = wlr_color_transform_ref(options->color_transform);
+	if (color_transform != NULL) {
+		pass->color_transform = wlr_color_transform_ref(color_transform);
 	}
 	if (options != NULL && options->signal_timeline != NULL) {
 		pass->signal_timeline = wlr_drm_syncobj_timeline_ref(options->signal_timeline);
@@ -1100,6 +1681,15 @@ struct wlr_vk_render_pass *vulkan_begin_render_pass(struct wlr_vk_renderer *rend
 		return NULL;
 	}
 
+	if (options != NULL && options->timer != NULL) {
+		pass->timer = vulkan_get_render_timer(options->timer);
+		pass->timer->cpu_start = cpu_start;
+		pass->timer->submitted = false;
+		vkCmdResetQueryPool(cb->vk, pass->timer->query_pool, 0, 2);
+		vkCmdWriteTimestamp(cb->vk, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			pass->timer->query_pool, 0);
+	}
+
 	if (!renderer->dummy3d_image_transitioned) {
 		renderer->dummy3d_image_transitioned = true;
 		vulkan_change_layout(cb->vk, renderer->dummy3d_image,
@@ -1108,36 +1698,15 @@ struct wlr_vk_render_pass *vulkan_begin_render_pass(struct wlr_vk_renderer *rend
 			VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, VK_ACCESS_SHADER_READ_BIT);
 	}
 
-	int width = buffer->wlr_buffer->width;
-	int height = buffer->wlr_buffer->height;
-	VkRect2D rect = { .extent = { width, height } };
-
-	VkRenderPassBeginInfo rp_info = {
-		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-		.renderArea = rect,
-		.clearValueCount = 0,
-	};
-	if (pass->srgb_pathway) {
-		rp_info.renderPass = buffer->srgb.render_setup->render_pass;
-		rp_info.framebuffer = buffer->srgb.framebuffer;
-	} else {
-		rp_info.renderPass = buffer->plain.render_setup->render_pass;
-		rp_info.framebuffer = buffer->plain.framebuffer;
-	}
-	vkCmdBeginRenderPass(cb->vk, &rp_info, VK_SUBPASS_CONTENTS_INLINE);
-
-	vkCmdSetViewport(cb->vk, 0, 1, &(VkViewport){
-		.width = width,
-		.height = height,
-		.maxDepth = 1,
-	});
+	pass->render_buffer = buffer;
+	pass->command_buffer = cb;
+	begin_render_pass(pass);
 
 	// matrix_projection() assumes a GL coordinate system so we need
 	// to pass WL_OUTPUT_TRANSFORM_FLIPPED_180 to adjust it for vulkan.
-	matrix_projection(pass->projection, width, height, WL_OUTPUT_TRANSFORM_FLIPPED_180);
+	matrix_projection(pass->projection, buffer->wlr_buffer->width,
+		buffer->wlr_buffer->height, WL_OUTPUT_TRANSFORM_FLIPPED_180);
 
 	wlr_buffer_lock(buffer->wlr_buffer);
-	pass->render_buffer = buffer;
-	pass->command_buffer = cb;
 	return pass;
 }
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+#include <wlr/util/log.h>
+#include "render/vulkan.h"
+#include "util/cache.h"
+#include "util/env.h"
+
+// Returns $XDG_CACHE_HOME/wlroots/vulkan-pipeline-cache-<uuid>. The pipeline
+// cache UUID identifies the driver build, so that switching GPUs or updating
+// drivers doesn't discard the data of other drivers.
+static char *get_cache_path(struct wlr_vk_device *dev) {
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(dev->phdev, &props);
+	char uuid[2 * VK_UUID_SIZE + 1];
+	for (size_t i = 0; i < VK_UUID_SIZE; i++) {
+		snprintf(&uuid[2 * i], 3, "%02x", props.pipelineCacheUUID[i]);
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "vulkan-pipeline-cache-%s", uuid);
+	return cache_file_get_path(name);
+}
+
+bool vulkan_pipeline_cache_init(struct wlr_vk_renderer *renderer) {
+	VkDevice dev = renderer->dev->dev;
+
+	if (!env_parse_bool("WLR_VK_NO_PIPELINE_CACHE")) {
+		renderer->pipeline_cache_path = get_cache_path(renderer->dev);
+	}
+
+	size_t initial_size = 0;
+	void *initial_data = NULL;
+	if (renderer->pipeline_cache_path != NULL) {
+		initial_data = cache_file_read(renderer->pipeline_cache_path, &initial_size);
+	}
+
+	VkPipelineCacheCreateInfo cache_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = initial_data != NULL ? initial_size : 0,
+		.pInitialData = initial_data,
+	};
+	VkResult res = vkCreatePipelineCache(dev, &cache_info, NULL,
+		&renderer->pipeline_cache);
+	if (res != VK_SUCCESS && initial_data != NULL) {
+		// Drivers should ignore incompatible data, but don't let a broken
+		// file prevent the renderer from starting
+		wlr_log(WLR_DEBUG, "Discarding pipeline cache %s",
+			renderer->pipeline_cache_path);
+		cache_info.initialDataSize = 0;
+		cache_info.pInitialData = NULL;
+		res = vkCreatePipelineCache(dev, &cache_info, NULL,
+			&renderer->pipeline_cache);
+	}
+	free(initial_data);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreatePipelineCache", res);
+		return false;
+	}
+
+	renderer->pipeline_cache_saved_size = initial_size;
+	return true;
+}
+
+void vulkan_pipeline_cache_save(struct wlr_vk_renderer *renderer) {
+	if (renderer->pipeline_cache == VK_NULL_HANDLE ||
+			renderer->pipeline_cache_path == NULL) {
+		return;
+	}
+
+	VkDevice dev = renderer->dev->dev;
+	size_t size = 0;
+	VkResult res = vkGetPipelineCacheData(dev, renderer->pipeline_cache,
+		&size, NULL);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkGetPipelineCacheData", res);
+		return;
+	}
+	// The cache only ever grows: if the size didn't change, neither did the
+	// contents
+	if (size == 0 || size == renderer->pipeline_cache_saved_size) {
+		return;
+	}
+
+	void *data = malloc(size);
+	if (data == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+	res = vkGetPipelineCacheData(dev, renderer->pipeline_cache, &size, data);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkGetPipelineCacheData", res);
+		free(data);
+		return;
+	}
+
+	bool ok = cache_file_write(renderer->pipeline_cache_path, data, size);
+	free(data);
+	if (!ok) {
+		return;
+	}
+
+	renderer->pipeline_cache_saved_size = size;
+}
+
+void vulkan_pipeline_cache_finish(struct wlr_vk_renderer *renderer) {
+	vulkan_pipeline_cache_save(renderer);
+	vkDestroyPipelineCache(renderer->dev->dev, renderer->pipeline_cache, NULL);
+	free(renderer->pipeline_cache_path);
+}
@@ -220,17 +220,25 @@ const struct wlr_vk_format *vulkan_get_format_list(size_t *len) {
 	return formats;
 }
 
+static struct pixel_format_index formats_index = PIXEL_FORMAT_INDEX_INIT;
+
+static void build_formats_index(void) {
+	pixel_format_index_build(&formats_index, formats, sizeof(formats[0]),
+		offsetof(struct wlr_vk_format, drm),
+		sizeof(formats) / sizeof(formats[0]));
+}
+
 const struct wlr_vk_format *vulkan_get_format_from_drm(uint32_t drm_format) {
-	for (unsigned i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
-		if (formats[i].drm == drm_format) {
-			return &formats[i];
-		}
-	}
-	return NULL;
+	pthread_once(&formats_index.once, build_formats_index);
+	ptrdiff_t i = pixel_format_index_find(&formats_index, drm_format);
+	return i >= 0 ? &formats[i] : NULL;
 }
 
 const VkImageUsageFlags vulkan_render_usage =
 	VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+const VkImageUsageFlags vulkan_render_sampled_usage =
+	VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+	VK_IMAGE_USAGE_SAMPLED_BIT;
 const VkImageUsageFlags vulkan_shm_tex_usage =
 	VK_IMAGE_USAGE_SAMPLED_BIT |
 	VK_IMAGE_USAGE_TRANSFER_DST_BIT |
@@ -242,6 +250,11 @@ const VkImageUsageFlags vulkan_dma_tex_usage =
 static const VkFormatFeatureFlags render_features =
 	VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
 	VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT;
+static const VkFormatFeatureFlags render_sampled_features =
+	VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+	VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT |
+	VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+	VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
 static const VkFormatFeatureFlags shm_tex_features =
 	VK_FORMAT_FEATURE_TRANSFER_SRC_BIT |
 	VK_FORMAT_FEATURE_TRANSFER_DST_BIT |
@@ -254,9 +267,21 @@ static const VkFormatFeatureFlags dma_tex_features =
 	// NOTE: we don't strictly require this, we could create a NEAREST
 	// sampler for formats that need it, in case this ever makes problems.
 	VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
-static const VkFormatFeatureFlags ycbcr_tex_features =
-	VK_FORMAT_FEATURE_SAMPLED_IMAGE_YCBCR_CONVERSION_LINEAR_FILTER_BIT |
-	VK_FORMAT_FEATURE_MIDPOINT_CHROMA_SAMPLES_BIT;
+// At least one of these is required for YCbCr formats
+static const VkFormatFeatureFlags ycbcr_chroma_location_features =
+	VK_FORMAT_FEATURE_MIDPOINT_CHROMA_SAMPLES_BIT |
+	VK_FORMAT_FEATURE_COSITED_CHROMA_SAMPLES_BIT;
+
+static struct wlr_vk_ycbcr_caps get_ycbcr_caps(VkFormatFeatureFlags features) {
+	return (struct wlr_vk_ycbcr_caps){
+		.chroma_location = (features & VK_FORMAT_FEATURE_MIDPOINT_CHROMA_SAMPLES_BIT) ?
+			VK_CHROMA_LOCATION_MIDPOINT : VK_CHROMA_LOCATION_COSITED_EVEN,
+		.linear_chroma_filter = features &
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_YCBCR_CONVERSION_LINEAR_FILTER_BIT,
+		.separate_chroma_filter = features &
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_YCBCR_CONVERSION_SEPARATE_RECONSTRUCTION_FILTER_BIT,
+	};
+}
 
 // vk_format_variant should be set to 0=VK_FORMAT_UNDEFINED when not used
 static bool query_modifier_usage_support(struct wlr_vk_device *dev, VkFormat vk_format,
@@ -372,6 +397,12 @@ static bool query_shm_support(struct wlr_vk_device *dev, VkFormat vk_format,
 	return true;
 }
 
+static int modifier_props_cmp(const void *a, const void *b) {
+	const struct wlr_vk_format_modifier_props *mod_a = a, *mod_b = b;
+	uint64_t x = mod_a->props.drmFormatModifier, y = mod_b->props.drmFormatModifier;
+	return (x > y) - (x < y);
+}
+
 static bool query_modifier_support(struct wlr_vk_device *dev,
 		struct wlr_vk_format_props *props, size_t modifier_count) {
 	VkDrmFormatModifierPropertiesListEXT modp = {
@@ -415,16 +446,27 @@ static bool query_modifier_support(struct wlr_vk_device *dev,
 		const char *errmsg = "unknown error";
 		if ((m.drmFormatModifierTilingFeatures & render_features) == render_features &&
 				!props->format.is_ycbcr) {
+			// Effects reading back what has been rendered need to sample
+			// render buffers, but don't give up on a modifier without it
+			VkImageUsageFlags usages[2] = {
+				vulkan_render_sampled_usage,
+				vulkan_render_usage,
+			};
+			size_t first_usage = (m.drmFormatModifierTilingFeatures &
+				render_sampled_features) == render_sampled_features ? 0 : 1;
 			struct wlr_vk_format_modifier_props p = {0};
 			bool supported = false;
-			if (query_modifier_usage_support(dev, props->format.vk,
-					props->format.vk_srgb, vulkan_render_usage, &m, &p, &errmsg)) {
-				supported = true;
-				p.has_mutable_srgb = props->format.vk_srgb != 0;
-			}
-			if (!supported && props->format.vk_srgb) {
-				supported = query_modifier_usage_support(dev, props->format.vk,
-					0, vulkan_render_usage, &m, &p, &errmsg);
+			for (size_t j = first_usage; j < 2 && !supported; j++) {
+				if (query_modifier_usage_support(dev, props->format.vk,
+						props->format.vk_srgb, usages[j], &m, &p, &errmsg)) {
+					supported = true;
+					p.has_mutable_srgb = props->format.vk_srgb != 0;
+				}
+				if (!supported && props->format.vk_srgb) {
+					supported = query_modifier_usage_support(dev, props->format.vk,
+						0, usages[j], &m, &p, &errmsg);
+				}
+				p.render_sampled = supported && usages[j] == vulkan_render_sampled_usage;
 			}
 
 			if (supported) {
@@ -445,11 +487,14 @@ static bool query_modifier_support(struct wlr_vk_device *dev,
 		// check that specific modifier for texture usage
 		errmsg = "unknown error";
 		VkFormatFeatureFlags features = dma_tex_features;
-		if (props->format.is_ycbcr) {
-			features |= ycbcr_tex_features;
-		}
-		if ((m.drmFormatModifierTilingFeatures & features) == features) {
+		VkFormatFeatureFlags tiling_features = m.drmFormatModifierTilingFeatures;
+		if ((tiling_features & features) == features &&
+				(!props->format.is_ycbcr ||
+				(tiling_features & ycbcr_chroma_location_features) != 0)) {
 			struct wlr_vk_format_modifier_props p = {0};
+			if (props->format.is_ycbcr) {
+				p.ycbcr = get_ycbcr_caps(tiling_features);
+			}
 			bool supported = false;
 			if (query_modifier_usage_support(dev, props->format.vk,
 					props->format.vk_srgb, vulkan_dma_tex_usage, &m, &p, &errmsg)) {
@@ -485,6 +530,13 @@ static bool query_modifier_support(struct wlr_vk_device *dev,
 	}
 
 	free(modp.pDrmFormatModifierProperties);
+
+	// Sorted for vulkan_format_props_find_modifier()
+	qsort(props->dmabuf.render_mods, props->dmabuf.render_mod_count,
+		sizeof(props->dmabuf.render_mods[0]), modifier_props_cmp);
+	qsort(props->dmabuf.texture_mods, props->dmabuf.texture_mod_count,
+		sizeof(props->dmabuf.texture_mods[0]), modifier_props_cmp);
+
 	return found;
 }
 
@@ -558,7 +610,13 @@ void vulkan_format_props_query(struct wlr_vk_device *dev,
 	}
 
 	if (add_fmt_props) {
-		dev->format_props[dev->format_prop_count] = props;
+		// Keep the list sorted by DRM format for vulkan_format_props_from_drm()
+		size_t i = dev->format_prop_count;
+		while (i > 0 && dev->format_props[i - 1].format.drm > props.format.drm) {
+			dev->format_props[i] = dev->format_props[i - 1];
+			i--;
+		}
+		dev->format_props[i] = props;
 		++dev->format_prop_count;
 	} else {
 		vulkan_format_props_finish(&props);
@@ -582,9 +640,17 @@ const struct wlr_vk_format_modifier_props *vulkan_format_props_find_modifier(
 		mods = props->dmabuf.texture_mods;
 	}
 
-	for (uint32_t i = 0; i < len; ++i) {
-		if (mods[i].props.drmFormatModifier == mod) {
-			return &mods[i];
+	// Binary search, the modifiers are sorted by query_modifier_support()
+	uint32_t lo = 0, hi = len;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		uint64_t mid_mod = mods[mid].props.drmFormatModifier;
+		if (mid_mod == mod) {
+			return &mods[mid];
+		} else if (mid_mod < mod) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
 		}
 	}
 	return NULL;
@@ -2,8 +2,11 @@
 #include <fcntl.h>
 #include <math.h>
 #include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <drm_fourcc.h>
@@ -24,16 +27,16 @@
 #include "render/vulkan.h"
 #include "render/vulkan/shaders/common.vert.h"
 #include "render/vulkan/shaders/texture.frag.h"
+#include "render/vulkan/shaders/texture_bindless.frag.h"
+#include "render/vulkan/shaders/texture_instanced.vert.h"
 #include "render/vulkan/shaders/quad.frag.h"
 #include "render/vulkan/shaders/output.frag.h"
 #include "types/wlr_buffer.h"
 #include "types/wlr_matrix.h"
+#include "util/env.h"
 #include "util/time.h"
 
 // TODO:
-// - simplify stage allocation, don't track allocations but use ringbuffer-like
-// - use a pipeline cache (not sure when to save though, after every pipeline
-//   creation?)
 // - create pipelines as derivatives of each other
 // - evaluate if creating VkDeviceMemory pools is a good idea.
 //   We can expect wayland client images to be fairly large (and shouldn't
@@ -42,6 +45,7 @@
 
 static const VkDeviceSize min_stage_size = 1024 * 1024; // 1MB
 static const VkDeviceSize max_stage_size = 256 * min_stage_size; // 256MB
+static const VkDeviceSize stage_ring_size = 32 * min_stage_size; // 32MB
 static const size_t start_descriptor_pool_size = 256u;
 static bool default_debug = true;
 
@@ -60,6 +64,10 @@ struct wlr_vk_renderer *vulkan_get_renderer(struct wlr_renderer *wlr_renderer) {
 static struct wlr_vk_render_format_setup *find_or_create_render_setup(
 		struct wlr_vk_renderer *renderer, const struct wlr_vk_format *format,
 		bool has_blending_buffer);
+static struct wlr_vk_render_format_setup *render_setup_job_finish(
+		struct wlr_vk_render_setup_job *job);
+static void vulkan_prepare_render_format(struct wlr_renderer *wlr_renderer,
+		uint32_t drm_format);
 
 static struct wlr_vk_descriptor_pool *alloc_ds(
 		struct wlr_vk_renderer *renderer, VkDescriptorSet *ds,
@@ -151,6 +159,31 @@ void vulkan_free_ds(struct wlr_vk_renderer *renderer,
 	++pool->free;
 }
 
+bool vulkan_bindless_alloc_index(struct wlr_vk_bindless_set *set,
+		uint32_t *index) {
+	if (set->free_indices.size > 0) {
+		set->free_indices.size -= sizeof(uint32_t);
+		*index = *(uint32_t *)((char *)set->free_indices.data + set->free_indices.size);
+		return true;
+	}
+	if (set->next_index >= set->capacity) {
+		return false;
+	}
+	*index = set->next_index++;
+	return true;
+}
+
+void vulkan_bindless_free_index(struct wlr_vk_bindless_set *set,
+		uint32_t index) {
+	uint32_t *slot = wl_array_add(&set->free_indices, sizeof(*slot));
+	if (slot == NULL) {
+		// Leak the slot, it will be reclaimed with the renderer
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+	*slot = index;
+}
+
 static void destroy_render_format_setup(struct wlr_vk_renderer *renderer,
 		struct wlr_vk_render_format_setup *setup) {
 	if (!setup) {
@@ -161,6 +194,7 @@ static void destroy_render_format_setup(struct wlr_vk_renderer *renderer,
 	vkDestroyRenderPass(dev, setup->render_pass, NULL);
 	vkDestroyPipeline(dev, setup->output_pipe_srgb, NULL);
 	vkDestroyPipeline(dev, setup->output_pipe_lut3d, NULL);
+	vulkan_destroy_effect_pipelines(setup);
 
 	struct wlr_vk_pipeline *pipeline, *tmp_pipeline;
 	wl_list_for_each_safe(pipeline, tmp_pipeline, &setup->pipelines, link) {
@@ -193,15 +227,173 @@ static void shared_buffer_destroy(struct wlr_vk_renderer *r,
 	if (buffer->memory) {
 		vkFreeMemory(r->dev->dev, buffer->memory, NULL);
 	}
+	r->wlr_renderer.memory_usage.staging_buffers -= buffer->buf_size;
 
 	wl_list_remove(&buffer->link);
 	free(buffer);
 }
 
-struct wlr_vk_buffer_span vulkan_get_stage_span(struct wlr_vk_renderer *r,
-		VkDeviceSize size, VkDeviceSize alignment) {
-	// try to find free span
-	// simple greedy allocation algorithm - should be enough for this usecase
+static struct wlr_vk_shared_buffer *shared_buffer_create(
+		struct wlr_vk_renderer *r, VkDeviceSize bsize) {
+	struct wlr_vk_shared_buffer *buf = calloc(1, sizeof(*buf));
+	if (!buf) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	wl_list_init(&buf->link);
+
+	VkResult res;
+	VkBufferCreateInfo buf_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = bsize,
+		.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+	};
+	res = vkCreateBuffer(r->dev->dev, &buf_info, NULL, &buf->buffer);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateBuffer", res);
+		goto error;
+	}
+
+	VkMemoryRequirements mem_reqs;
+	vkGetBufferMemoryRequirements(r->dev->dev, buf->buffer, &mem_reqs);
+
+	int mem_type_index = vulkan_find_mem_type(r->dev,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mem_reqs.memoryTypeBits);
+	if (mem_type_index < 0) {
+		wlr_log(WLR_ERROR, "Failed to find memory type");
+		goto error;
+	}
+
+	VkMemoryAllocateInfo mem_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = mem_reqs.size,
+		.memoryTypeIndex = (uint32_t)mem_type_index,
+	};
+	res = vkAllocateMemory(r->dev->dev, &mem_info, NULL, &buf->memory);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkAllocatorMemory", res);
+		goto error;
+	}
+
+	res = vkBindBufferMemory(r->dev->dev, buf->buffer, buf->memory, 0);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkBindBufferMemory", res);
+		goto error;
+	}
+
+	res = vkMapMemory(r->dev->dev, buf->memory, 0, VK_WHOLE_SIZE, 0, &buf->cpu_mapping);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkMapMemory", res);
+		goto error;
+	}
+
+	buf->buf_size = bsize;
+	r->wlr_renderer.memory_usage.staging_buffers += bsize;
+	return buf;
+
+error:
+	shared_buffer_destroy(r, buf);
+	return NULL;
+}
+
+static void stage_ring_reclaim(struct wlr_vk_renderer *r) {
+	uint64_t current_point;
+	VkResult res = r->dev->api.vkGetSemaphoreCounterValueKHR(r->dev->dev,
+		r->timeline_semaphore, &current_point);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkGetSemaphoreCounterValueKHR", res);
+		return;
+	}
+
+	const struct wlr_vk_stage_ring_region *regions = r->stage.ring.regions.data;
+	size_t regions_len = r->stage.ring.regions.size / sizeof(regions[0]);
+	size_t done = 0;
+	while (done < regions_len && regions[done].timeline_point <= current_point) {
+		r->stage.ring.tail = regions[done].end;
+		done++;
+	}
+	if (done == 0) {
+		return;
+	}
+
+	size_t remaining = (regions_len - done) * sizeof(regions[0]);
+	memmove(r->stage.ring.regions.data, &regions[done], remaining);
+	r->stage.ring.regions.size = remaining;
+}
+
+static bool stage_ring_alloc(struct wlr_vk_renderer *r, VkDeviceSize size,
+		VkDeviceSize alignment, struct wlr_vk_buffer_span *span) {
+	if (size > stage_ring_size) {
+		return false;
+	}
+
+	if (r->stage.ring.buffer == NULL) {
+		r->stage.ring.buffer = shared_buffer_create(r, stage_ring_size);
+		if (r->stage.ring.buffer == NULL) {
+			return false;
+		}
+	}
+
+	VkDeviceSize head = r->stage.ring.head;
+	VkDeviceSize start = head % stage_ring_size;
+	VkDeviceSize padding = (alignment - start % alignment) % alignment;
+	head += padding;
+	start += padding;
+	if (start + size > stage_ring_size) {
+		// Skip the end of the buffer, spans need to be contiguous
+		head += stage_ring_size - start;
+		start = 0;
+	}
+
+	if (head + size - r->stage.ring.tail > stage_ring_size) {
+		stage_ring_reclaim(r);
+		if (head + size - r->stage.ring.tail > stage_ring_size) {
+			return false;
+		}
+	}
+
+	r->stage.ring.head = head + size;
+	*span = (struct wlr_vk_buffer_span){
+		.buffer = r->stage.ring.buffer,
+		.alloc = {
+			.start = start,
+			.size = size,
+		},
+	};
+	return true;
+}
+
+void vulkan_stage_spans_submitted(struct wlr_vk_renderer *r,
+		uint64_t timeline_point) {
+	const struct wlr_vk_stage_ring_region *regions = r->stage.ring.regions.data;
+	size_t regions_len = r->stage.ring.regions.size / sizeof(regions[0]);
+	VkDeviceSize last_end = regions_len > 0 ?
+		regions[regions_len - 1].end : r->stage.ring.tail;
+	if (r->stage.ring.head == last_end) {
+		return;
+	}
+
+	struct wlr_vk_stage_ring_region *region =
+		wl_array_add(&r->stage.ring.regions, sizeof(*region));
+	if (region == NULL) {
+		// Leak the span until the next submission, which will cover it
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+	*region = (struct wlr_vk_stage_ring_region){
+		.end = r->stage.ring.head,
+		.timeline_point = timeline_point,
+	};
+}
+
+static struct wlr_vk_buffer_span get_shared_buffer_span(
+		struct wlr_vk_renderer *r, VkDeviceSize size, VkDeviceSize alignment) {
+	// Simple greedy allocation algorithm - should be enough for this usecase
 	// since all allocations are freed together after the frame
 	struct wlr_vk_shared_buffer *buf;
 	wl_list_for_each_reverse(buf, &r->stage.buffers, link) {
@@ -262,70 +454,18 @@ struct wlr_vk_buffer_span vulkan_get_stage_span(struct wlr_vk_renderer *r,
 		bsize = max_stage_size;
 	}
 
-	// create buffer
-	buf = calloc(1, sizeof(*buf));
+	buf = shared_buffer_create(r, bsize);
 	if (!buf) {
-		wlr_log_errno(WLR_ERROR, "Allocation failed");
 		goto error_alloc;
 	}
 
-	wl_list_init(&buf->link);
-
-	VkResult res;
-	VkBufferCreateInfo buf_info = {
-		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-		.size = bsize,
-		.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-	};
-	res = vkCreateBuffer(r->dev->dev, &buf_info, NULL, &buf->buffer);
-	if (res != VK_SUCCESS) {
-		wlr_vk_error("vkCreateBuffer", res);
-		goto error;
-	}
-
-	VkMemoryRequirements mem_reqs;
-	vkGetBufferMemoryRequirements(r->dev->dev, buf->buffer, &mem_reqs);
-
-	int mem_type_index = vulkan_find_mem_type(r->dev,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mem_reqs.memoryTypeBits);
-	if (mem_type_index < 0) {
-		wlr_log(WLR_ERROR, "Failed to find memory type");
-		goto error;
-	}
-
-	VkMemoryAllocateInfo mem_info = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = mem_reqs.size,
-		.memoryTypeIndex = (uint32_t)mem_type_index,
-	};
-	res = vkAllocateMemory(r->dev->dev, &mem_info, NULL, &buf->memory);
-	if (res != VK_SUCCESS) {
-		wlr_vk_error("vkAllocatorMemory", res);
-		goto error;
-	}
-
-	res = vkBindBufferMemory(r->dev->dev, buf->buffer, buf->memory, 0);
-	if (res != VK_SUCCESS) {
-		wlr_vk_error("vkBindBufferMemory", res);
-		goto error;
-	}
-
-	res = vkMapMemory(r->dev->dev, buf->memory, 0, VK_WHOLE_SIZE, 0, &buf->cpu_mapping);
-	if (res != VK_SUCCESS) {
-		wlr_vk_error("vkMapMemory", res);
-		goto error;
-	}
-
 	struct wlr_vk_allocation *a = wl_array_add(&buf->allocs, sizeof(*a));
 	if (a == NULL) {
 		wlr_log_errno(WLR_ERROR, "Allocation failed");
-		goto error;
+		shared_buffer_destroy(r, buf);
+		goto error_alloc;
 	}
 
-	buf->buf_size = bsize;
 	wl_list_insert(&r->stage.buffers, &buf->link);
 
 	*a = (struct wlr_vk_allocation){
@@ -337,9 +477,6 @@ struct wlr_vk_buffer_span vulkan_get_stage_span(struct wlr_vk_renderer *r,
 		.alloc = *a,
 	};
 
-error:
-	shared_buffer_destroy(r, buf);
-
 error_alloc:
 	return (struct wlr_vk_buffer_span) {
 		.buffer = NULL,
@@ -347,6 +484,24 @@ error_alloc:
 	};
 }
 
+struct wlr_vk_buffer_span vulkan_get_stage_span(struct wlr_vk_renderer *r,
+		VkDeviceSize size, VkDeviceSize alignment) {
+	struct wlr_vk_buffer_span span;
+	if (stage_ring_alloc(r, size, alignment, &span)) {
+		return span;
+	}
+
+	// The ring is too small or still busy: fall back to dedicated buffers
+	return get_shared_buffer_span(r, size, alignment);
+}
+
+struct wlr_vk_buffer_span vulkan_get_render_span(struct wlr_vk_renderer *r,
+		VkDeviceSize size, VkDeviceSize alignment) {
+	// Ring regions are reclaimed when the stage cb completes, which may be
+	// before the render cb reading the span has executed
+	return get_shared_buffer_span(r, size, alignment);
+}
+
 VkCommandBuffer vulkan_record_stage_cb(struct wlr_vk_renderer *renderer) {
 	if (renderer->stage.cb == NULL) {
 		renderer->stage.cb = vulkan_acquire_command_buffer(renderer);
@@ -371,19 +526,31 @@ bool vulkan_submit_stage_wait(struct wlr_vk_renderer *renderer) {
 	struct wlr_vk_command_buffer *cb = renderer->stage.cb;
 	renderer->stage.cb = NULL;
 
+	uint64_t transfer_point;
+	if (!vulkan_submit_transfer_cb(renderer, &transfer_point)) {
+		vulkan_reset_command_buffer(cb);
+		return false;
+	}
+
 	uint64_t timeline_point = vulkan_end_command_buffer(cb, renderer);
 	if (timeline_point == 0) {
 		return false;
 	}
 
+	VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
 	VkTimelineSemaphoreSubmitInfoKHR timeline_submit_info = {
 		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+		.waitSemaphoreValueCount = transfer_point > 0 ? 1 : 0,
+		.pWaitSemaphoreValues = &transfer_point,
 		.signalSemaphoreValueCount = 1,
 		.pSignalSemaphoreValues = &timeline_point,
 	};
 	VkSubmitInfo submit_info = {
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
 		.pNext = &timeline_submit_info,
+		.waitSemaphoreCount = transfer_point > 0 ? 1 : 0,
+		.pWaitSemaphores = &renderer->transfer.timeline_semaphore,
+		.pWaitDstStageMask = &wait_stage,
 		.commandBufferCount = 1,
 		.pCommandBuffers = &cb->vk,
 		.signalSemaphoreCount = 1,
@@ -395,17 +562,200 @@ bool vulkan_submit_stage_wait(struct wlr_vk_renderer *renderer) {
 		return false;
 	}
 
+	vulkan_stage_spans_submitted(renderer, timeline_point);
+
 	// NOTE: don't release stage allocations here since they may still be
 	// used for reading. Will be done next frame.
 
 	return vulkan_wait_command_buffer(cb, renderer);
 }
 
+static struct wlr_vk_transfer_command_buffer *acquire_transfer_cb(
+		struct wlr_vk_renderer *renderer) {
+	VkDevice dev = renderer->dev->dev;
+
+	uint64_t current_point;
+	VkResult res = renderer->dev->api.vkGetSemaphoreCounterValueKHR(dev,
+		renderer->transfer.timeline_semaphore, &current_point);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkGetSemaphoreCounterValueKHR", res);
+		return NULL;
+	}
+
+	struct wlr_vk_transfer_command_buffer *oldest = NULL;
+	for (size_t i = 0; i < VULKAN_TRANSFER_COMMAND_BUFFERS_CAP; i++) {
+		struct wlr_vk_transfer_command_buffer *cb =
+			&renderer->transfer.command_buffers[i];
+		if (cb->vk == VK_NULL_HANDLE) {
+			VkCommandBufferAllocateInfo cmd_buf_info = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				.commandPool = renderer->transfer.command_pool,
+				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				.commandBufferCount = 1,
+			};
+			res = vkAllocateCommandBuffers(dev, &cmd_buf_info, &cb->vk);
+			if (res != VK_SUCCESS) {
+				wlr_vk_error("vkAllocateCommandBuffers", res);
+				cb->vk = VK_NULL_HANDLE;
+				return NULL;
+			}
+			return cb;
+		}
+		if (cb->timeline_point <= current_point) {
+			return cb;
+		}
+		if (oldest == NULL || cb->timeline_point < oldest->timeline_point) {
+			oldest = cb;
+		}
+	}
+
+	// All transfer command buffers are busy, wait for the oldest one
+	VkSemaphoreWaitInfoKHR wait_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+		.semaphoreCount = 1,
+		.pSemaphores = &renderer->transfer.timeline_semaphore,
+		.pValues = &oldest->timeline_point,
+	};
+	res = renderer->dev->api.vkWaitSemaphoresKHR(dev, &wait_info, UINT64_MAX);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkWaitSemaphoresKHR", res);
+		return NULL;
+	}
+	return oldest;
+}
+
+VkCommandBuffer vulkan_record_transfer_cb(struct wlr_vk_renderer *renderer) {
+	if (renderer->transfer.command_pool == VK_NULL_HANDLE) {
+		return VK_NULL_HANDLE;
+	}
+
+	if (renderer->transfer.cb == NULL) {
+		struct wlr_vk_transfer_command_buffer *cb = acquire_transfer_cb(renderer);
+		if (cb == NULL) {
+			return VK_NULL_HANDLE;
+		}
+
+		VkCommandBufferBeginInfo begin_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		};
+		VkResult res = vkBeginCommandBuffer(cb->vk, &begin_info);
+		if (res != VK_SUCCESS) {
+			wlr_vk_error("vkBeginCommandBuffer", res);
+			return VK_NULL_HANDLE;
+		}
+
+		renderer->transfer.cb = cb;
+		renderer->transfer.wait_point = 0;
+	}
+
+	return renderer->transfer.cb->vk;
+}
+
+bool vulkan_submit_transfer_cb(struct wlr_vk_renderer *renderer,
+		uint64_t *timeline_point) {
+	*timeline_point = 0;
+
+	struct wlr_vk_transfer_command_buffer *cb = renderer->transfer.cb;
+	if (cb == NULL) {
+		return true;
+	}
+	renderer->transfer.cb = NULL;
+
+	VkResult res = vkEndCommandBuffer(cb->vk);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkEndCommandBuffer", res);
+		return false;
+	}
+
+	uint64_t signal_point = renderer->transfer.timeline_point + 1;
+	VkCommandBufferSubmitInfoKHR cb_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR,
+		.commandBuffer = cb->vk,
+	};
+	VkSemaphoreSubmitInfoKHR wait = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR,
+		.semaphore = renderer->timeline_semaphore,
+		.value = renderer->transfer.wait_point,
+		.stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+	};
+	VkSemaphoreSubmitInfoKHR signal = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR,
+		.semaphore = renderer->transfer.timeline_semaphore,
+		.value = signal_point,
+	};
+	VkSubmitInfo2KHR submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR,
+		.waitSemaphoreInfoCount = renderer->transfer.wait_point > 0 ? 1 : 0,
+		.pWaitSemaphoreInfos = &wait,
+		.commandBufferInfoCount = 1,
+		.pCommandBufferInfos = &cb_info,
+		.signalSemaphoreInfoCount = 1,
+		.pSignalSemaphoreInfos = &signal,
+	};
+	res = renderer->dev->api.vkQueueSubmit2KHR(renderer->dev->transfer_queue,
+		1, &submit_info, VK_NULL_HANDLE);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkQueueSubmit2KHR", res);
+		return false;
+	}
+
+	renderer->transfer.timeline_point = signal_point;
+	cb->timeline_point = signal_point;
+	*timeline_point = signal_point;
+	return true;
+}
+
+static bool init_transfer_queue(struct wlr_vk_renderer *renderer) {
+	struct wlr_vk_device *dev = renderer->dev;
+	if (dev->transfer_queue == VK_NULL_HANDLE) {
+		return true;
+	}
+
+	VkSemaphoreTypeCreateInfoKHR semaphore_type_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+		.initialValue = 0,
+	};
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &semaphore_type_info,
+	};
+	VkResult res = vkCreateSemaphore(dev->dev, &semaphore_info, NULL,
+		&renderer->transfer.timeline_semaphore);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateSemaphore", res);
+		return false;
+	}
+
+	VkCommandPoolCreateInfo cpool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = dev->transfer_queue_family,
+	};
+	res = vkCreateCommandPool(dev->dev, &cpool_info, NULL,
+		&renderer->transfer.command_pool);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateCommandPool", res);
+		return false;
+	}
+
+	return true;
+}
+
 struct wlr_vk_format_props *vulkan_format_props_from_drm(
 		struct wlr_vk_device *dev, uint32_t drm_fmt) {
-	for (size_t i = 0u; i < dev->format_prop_count; ++i) {
-		if (dev->format_props[i].format.drm == drm_fmt) {
-			return &dev->format_props[i];
+	// Binary search, the list is sorted by vulkan_format_props_query()
+	size_t lo = 0, hi = dev->format_prop_count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		uint32_t mid_fmt = dev->format_props[mid].format.drm;
+		if (mid_fmt == drm_fmt) {
+			return &dev->format_props[mid];
+		} else if (mid_fmt < drm_fmt) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
 		}
 	}
 	return NULL;
@@ -433,6 +783,8 @@ static bool init_command_buffer(struct wlr_vk_command_buffer *cb,
 	};
 	wl_list_init(&cb->destroy_textures);
 	wl_list_init(&cb->stage_buffers);
+	wl_list_init(&cb->effect_images);
+	wl_list_insert(&renderer->command_buffers, &cb->link);
 	return true;
 }
 
@@ -475,6 +827,12 @@ static void release_command_buffer_resources(struct wlr_vk_command_buffer *cb,
 		wl_list_insert(&renderer->stage.buffers, &buf->link);
 	}
 
+	struct wlr_vk_effect_image *effect_image, *effect_image_tmp;
+	wl_list_for_each_safe(effect_image, effect_image_tmp, &cb->effect_images, link) {
+		wl_list_remove(&effect_image->link);
+		vulkan_release_effect_image(renderer, effect_image);
+	}
+
 	if (cb->color_transform) {
 		wlr_color_transform_unref(cb->color_transform);
 		cb->color_transform = NULL;
@@ -501,51 +859,35 @@ static struct wlr_vk_command_buffer *get_command_buffer(
 		if (buf->allocs.size == 0 && buf->last_used_ms + 10000 < now) {
 			shared_buffer_destroy(renderer, buf);
 		}
-	}
-
-	// Destroy textures for completed command buffers
-	for (size_t i = 0; i < VULKAN_COMMAND_BUFFERS_CAP; i++) {
-		struct wlr_vk_command_buffer *cb = &renderer->command_buffers[i];
-		if (cb->vk != VK_NULL_HANDLE && !cb->recording &&
-				cb->timeline_point <= current_point) {
-			release_command_buffer_resources(cb, renderer, now);
-		}
-	}
-
-	// First try to find an existing command buffer which isn't busy
-	struct wlr_vk_command_buffer *unused = NULL;
-	struct wlr_vk_command_buffer *wait = NULL;
-	for (size_t i = 0; i < VULKAN_COMMAND_BUFFERS_CAP; i++) {
-		struct wlr_vk_command_buffer *cb = &renderer->command_buffers[i];
-		if (cb->vk == VK_NULL_HANDLE) {
-			unused = cb;
-			break;
-		}
-		if (cb->recording) {
-			continue;
-		}
+	}
 
-		if (cb->timeline_point <= current_point) {
-			return cb;
+	// Destroy textures for completed command buffers, and pick one of them
+	struct wlr_vk_command_buffer *cb, *found = NULL;
+	wl_list_for_each(cb, &renderer->command_buffers, link) {
+		if (cb->recording || cb->timeline_point > current_point) {
+			continue;
 		}
-		if (wait == NULL || cb->timeline_point < wait->timeline_point) {
-			wait = cb;
+		release_command_buffer_resources(cb, renderer, now);
+		if (found == NULL) {
+			found = cb;
 		}
 	}
-
-	// If there is an unused slot, initialize it
-	if (unused != NULL) {
-		if (!init_command_buffer(unused, renderer)) {
-			return NULL;
-		}
-		return unused;
+	if (found != NULL) {
+		return found;
 	}
 
-	// Block until a busy command buffer becomes available
-	if (!vulkan_wait_command_buffer(wait, renderer)) {
+	// All command buffers are busy: grow the pool instead of blocking until
+	// the GPU is done with one of them
+	cb = calloc(1, sizeof(*cb));
+	if (cb == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	if (!init_command_buffer(cb, renderer)) {
+		free(cb);
 		return NULL;
 	}
-	return wait;
+	return cb;
 }
 
 struct wlr_vk_command_buffer *vulkan_acquire_command_buffer(
@@ -590,92 +932,42 @@ void vulkan_reset_command_buffer(struct wlr_vk_command_buffer *cb) {
 	}
 }
 
-static void destroy_render_buffer(struct wlr_vk_render_buffer *buffer) {
-	wl_list_remove(&buffer->link);
-	wlr_addon_finish(&buffer->addon);
-
-	VkDevice dev = buffer->renderer->dev->dev;
-
-	// TODO: asynchronously wait for the command buffers using this render
-	// buffer to complete (just like we do for textures)
-	VkResult res = vkQueueWaitIdle(buffer->renderer->dev->queue);
-	if (res != VK_SUCCESS) {
-		wlr_vk_error("vkQueueWaitIdle", res);
-	}
-
-	vkDestroyFramebuffer(dev, buffer->srgb.framebuffer, NULL);
-	vkDestroyImageView(dev, buffer->srgb.image_view, NULL);
-
-	vkDestroyFramebuffer(dev, buffer->plain.framebuffer, NULL);
-	vkDestroyImageView(dev, buffer->plain.image_view, NULL);
-	vkDestroyImage(dev, buffer->plain.blend_image, NULL);
-	vkFreeMemory(dev, buffer->plain.blend_memory, NULL);
-	vkDestroyImageView(dev, buffer->plain.blend_image_view, NULL);
-	if (buffer->plain.blend_attachment_pool) {
-		vulkan_free_ds(buffer->renderer, buffer->plain.blend_attachment_pool,
-			buffer->plain.blend_descriptor_set);
-	}
-
-	vkDestroyImage(dev, buffer->image, NULL);
-	for (size_t i = 0u; i < buffer->mem_count; ++i) {
-		vkFreeMemory(dev, buffer->memories[i], NULL);
+static void destroy_blend_image(struct wlr_vk_renderer *renderer,
+		struct wlr_vk_blend_image *blend) {
+	VkDevice dev = renderer->dev->dev;
+	vkDestroyImageView(dev, blend->image_view, NULL);
+	vkDestroyImage(dev, blend->image, NULL);
+	vkFreeMemory(dev, blend->memory, NULL);
+	if (blend->attachment_pool) {
+		vulkan_free_ds(renderer, blend->attachment_pool, blend->descriptor_set);
 	}
-
-	free(buffer);
+	free(blend);
 }
 
-static void handle_render_buffer_destroy(struct wlr_addon *addon) {
-	struct wlr_vk_render_buffer *buffer = wl_container_of(addon, buffer, addon);
-	destroy_render_buffer(buffer);
+static void release_blend_image(struct wlr_vk_renderer *renderer,
+		struct wlr_vk_blend_image *blend) {
+	wl_list_insert(&renderer->blend_images, &blend->link);
+	if (wl_list_length(&renderer->blend_images) > VULKAN_BLEND_IMAGES_CAP) {
+		struct wlr_vk_blend_image *oldest =
+			wl_container_of(renderer->blend_images.prev, oldest, link);
+		wl_list_remove(&oldest->link);
+		destroy_blend_image(renderer, oldest);
+	}
 }
 
-static struct wlr_addon_interface render_buffer_addon_impl = {
-	.name = "wlr_vk_render_buffer",
-	.destroy = handle_render_buffer_destroy,
-};
-
-bool vulkan_setup_plain_framebuffer(struct wlr_vk_render_buffer *buffer,
-		const struct wlr_dmabuf_attributes *dmabuf) {
-	struct wlr_vk_renderer *renderer = buffer->renderer;
+static struct wlr_vk_blend_image *create_blend_image(
+		struct wlr_vk_renderer *renderer, uint32_t width, uint32_t height) {
 	VkResult res;
 	VkDevice dev = renderer->dev->dev;
 
-	const struct wlr_vk_format_props *fmt = vulkan_format_props_from_drm(
-		renderer->dev, dmabuf->format);
-	assert(fmt);
-
-	VkImageViewCreateInfo view_info = {
-		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-		.image = buffer->image,
-		.viewType = VK_IMAGE_VIEW_TYPE_2D,
-		.format = fmt->format.vk,
-		.components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
-		.components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
-		.components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
-		.components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
-		.subresourceRange = (VkImageSubresourceRange) {
-			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-			.baseMipLevel = 0,
-			.levelCount = 1,
-			.baseArrayLayer = 0,
-			.layerCount = 1,
-		},
-	};
-
-	res = vkCreateImageView(dev, &view_info, NULL, &buffer->plain.image_view);
-	if (res != VK_SUCCESS) {
-		wlr_vk_error("vkCreateImageView failed", res);
-		goto error;
-	}
-
-	buffer->plain.render_setup = find_or_create_render_setup(
-		renderer, &fmt->format, true);
-	if (!buffer->plain.render_setup) {
-		goto error;
+	struct wlr_vk_blend_image *blend = calloc(1, sizeof(*blend));
+	if (blend == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
 	}
+	blend->width = width;
+	blend->height = height;
 
-	// Set up an extra 16F buffer on which to do linear blending,
-	// and afterwards to render onto the target
 	VkImageCreateInfo img_info = {
 		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
 		.imageType = VK_IMAGE_TYPE_2D,
@@ -686,18 +978,20 @@ bool vulkan_setup_plain_framebuffer(struct wlr_vk_render_buffer *buffer,
 		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
 		.tiling = VK_IMAGE_TILING_OPTIMAL,
 		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.extent = (VkExtent3D) { dmabuf->width, dmabuf->height, 1 },
-		.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+		.extent = (VkExtent3D) { width, height, 1 },
+		// Sampled by blurs
+		.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+			VK_IMAGE_USAGE_SAMPLED_BIT,
 	};
 
-	res = vkCreateImage(dev, &img_info, NULL, &buffer->plain.blend_image);
+	res = vkCreateImage(dev, &img_info, NULL, &blend->image);
 	if (res != VK_SUCCESS) {
 		wlr_vk_error("vkCreateImage failed", res);
 		goto error;
 	}
 
 	VkMemoryRequirements mem_reqs;
-	vkGetImageMemoryRequirements(dev, buffer->plain.blend_image, &mem_reqs);
+	vkGetImageMemoryRequirements(dev, blend->image, &mem_reqs);
 
 	int mem_type_index = vulkan_find_mem_type(renderer->dev,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mem_reqs.memoryTypeBits);
@@ -712,21 +1006,21 @@ bool vulkan_setup_plain_framebuffer(struct wlr_vk_render_buffer *buffer,
 		.memoryTypeIndex = mem_type_index,
 	};
 
-	res = vkAllocateMemory(dev, &mem_info, NULL, &buffer->plain.blend_memory);
+	res = vkAllocateMemory(dev, &mem_info, NULL, &blend->memory);
 	if (res != VK_SUCCESS) {
 		wlr_vk_error("vkAllocatorMemory failed", res);
 		goto error;
 	}
 
-	res = vkBindImageMemory(dev, buffer->plain.blend_image, buffer->plain.blend_memory, 0);
+	res = vkBindImageMemory(dev, blend->image, blend->memory, 0);
 	if (res != VK_SUCCESS) {
 		wlr_vk_error("vkBindMemory failed", res);
 		goto error;
 	}
 
-	VkImageViewCreateInfo blend_view_info = {
+	VkImageViewCreateInfo view_info = {
 		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-		.image = buffer->plain.blend_image,
+		.image = blend->image,
 		.viewType = VK_IMAGE_VIEW_TYPE_2D,
 		.format = img_info.format,
 		.components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -742,36 +1036,149 @@ bool vulkan_setup_plain_framebuffer(struct wlr_vk_render_buffer *buffer,
 		},
 	};
 
-	res = vkCreateImageView(dev, &blend_view_info, NULL, &buffer->plain.blend_image_view);
+	res = vkCreateImageView(dev, &view_info, NULL, &blend->image_view);
 	if (res != VK_SUCCESS) {
 		wlr_vk_error("vkCreateImageView failed", res);
 		goto error;
 	}
 
-	buffer->plain.blend_attachment_pool = vulkan_alloc_blend_ds(renderer,
-		&buffer->plain.blend_descriptor_set);
-	if (!buffer->plain.blend_attachment_pool) {
+	blend->attachment_pool = vulkan_alloc_blend_ds(renderer,
+		&blend->descriptor_set);
+	if (!blend->attachment_pool) {
 		wlr_log(WLR_ERROR, "failed to allocate descriptor");
 		goto error;
 	}
 
 	VkDescriptorImageInfo ds_attach_info = {
 		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-		.imageView = buffer->plain.blend_image_view,
+		.imageView = blend->image_view,
 		.sampler = VK_NULL_HANDLE,
 	};
 	VkWriteDescriptorSet ds_write = {
 		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 		.descriptorCount = 1,
 		.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
-		.dstSet = buffer->plain.blend_descriptor_set,
+		.dstSet = blend->descriptor_set,
 		.dstBinding = 0,
 		.pImageInfo = &ds_attach_info,
 	};
 	vkUpdateDescriptorSets(dev, 1, &ds_write, 0, NULL);
 
+	return blend;
+
+error:
+	destroy_blend_image(renderer, blend);
+	return NULL;
+}
+
+// Get a blending image, re-using the one of a previously destroyed render
+// buffer of the same size if possible. Swapchains are re-created with the
+// same size on format or modifier changes, and usually with one of a few
+// sizes on mode changes.
+static struct wlr_vk_blend_image *acquire_blend_image(
+		struct wlr_vk_renderer *renderer, uint32_t width, uint32_t height) {
+	struct wlr_vk_blend_image *blend;
+	wl_list_for_each(blend, &renderer->blend_images, link) {
+		if (blend->width == width && blend->height == height) {
+			wl_list_remove(&blend->link);
+			return blend;
+		}
+	}
+
+	return create_blend_image(renderer, width, height);
+}
+
+static void destroy_render_buffer(struct wlr_vk_render_buffer *buffer) {
+	wl_list_remove(&buffer->link);
+	wlr_addon_finish(&buffer->addon);
+
+	VkDevice dev = buffer->renderer->dev->dev;
+
+	// TODO: asynchronously wait for the command buffers using this render
+	// buffer to complete (just like we do for textures)
+	VkResult res = vkQueueWaitIdle(buffer->renderer->dev->queue);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkQueueWaitIdle", res);
+	}
+
+	vkDestroyFramebuffer(dev, buffer->srgb.framebuffer, NULL);
+	vkDestroyImageView(dev, buffer->srgb.image_view, NULL);
+
+	vkDestroyFramebuffer(dev, buffer->plain.framebuffer, NULL);
+	vkDestroyImageView(dev, buffer->plain.image_view, NULL);
+	if (buffer->plain.blend != NULL) {
+		// The queue is idle, the image can be handed to another buffer
+		release_blend_image(buffer->renderer, buffer->plain.blend);
+	}
+
+	vkDestroyImage(dev, buffer->image, NULL);
+	for (size_t i = 0u; i < buffer->mem_count; ++i) {
+		vkFreeMemory(dev, buffer->memories[i], NULL);
+	}
+
+	free(buffer);
+}
+
+static void handle_render_buffer_destroy(struct wlr_addon *addon) {
+	struct wlr_vk_render_buffer *buffer = wl_container_of(addon, buffer, addon);
+	destroy_render_buffer(buffer);
+}
+
+static struct wlr_addon_interface render_buffer_addon_impl = {
+	.name = "wlr_vk_render_buffer",
+	.destroy = handle_render_buffer_destroy,
+};
+
+bool vulkan_setup_plain_framebuffer(struct wlr_vk_render_buffer *buffer,
+		const struct wlr_dmabuf_attributes *dmabuf) {
+	struct wlr_vk_renderer *renderer = buffer->renderer;
+	VkResult res;
+	VkDevice dev = renderer->dev->dev;
+
+	const struct wlr_vk_format_props *fmt = vulkan_format_props_from_drm(
+		renderer->dev, dmabuf->format);
+	assert(fmt);
+
+	VkImageViewCreateInfo view_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.image = buffer->image,
+		.viewType = VK_IMAGE_VIEW_TYPE_2D,
+		.format = fmt->format.vk,
+		.components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+		.components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+		.components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+		.components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
+		.subresourceRange = (VkImageSubresourceRange) {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = 0,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+	};
+
+	res = vkCreateImageView(dev, &view_info, NULL, &buffer->plain.image_view);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateImageView failed", res);
+		goto error;
+	}
+
+	buffer->plain.render_setup = find_or_create_render_setup(
+		renderer, &fmt->format, true);
+	if (!buffer->plain.render_setup) {
+		goto error;
+	}
+
+	// Set up an extra 16F buffer on which to do linear blending,
+	// and afterwards to render onto the target
+	buffer->plain.blend = acquire_blend_image(renderer,
+		dmabuf->width, dmabuf->height);
+	if (!buffer->plain.blend) {
+		goto error;
+	}
+
 	VkImageView attachments[2] = {
-		buffer->plain.blend_image_view,
+		buffer->plain.blend->image_view,
 		buffer->plain.image_view
 	};
 	VkFramebufferCreateInfo fb_info = {
@@ -900,6 +1307,8 @@ static struct wlr_vk_render_buffer *create_render_buffer(
 			dmabuf.format, (const char*) &dmabuf.format);
 		goto error;
 	}
+	buffer->sampled = vulkan_format_props_find_modifier(fmt,
+		dmabuf.modifier, true)->render_sampled;
 
 	if (using_mutable_srgb) {
 		if (!vulkan_setup_srgb_framebuffer(buffer, &dmabuf)) {
@@ -1063,11 +1472,8 @@ static void vulkan_destroy(struct wlr_renderer *wlr_renderer) {
 		wlr_vk_error("vkDeviceWaitIdle", res);
 	}
 
-	for (size_t i = 0; i < VULKAN_COMMAND_BUFFERS_CAP; i++) {
-		struct wlr_vk_command_buffer *cb = &renderer->command_buffers[i];
-		if (cb->vk == VK_NULL_HANDLE) {
-			continue;
-		}
+	struct wlr_vk_command_buffer *cb, *cb_tmp;
+	wl_list_for_each(cb, &renderer->command_buffers, link) {
 		release_command_buffer_resources(cb, renderer, 0);
 		if (cb->binary_semaphore != VK_NULL_HANDLE) {
 			vkDestroySemaphore(renderer->dev->dev, cb->binary_semaphore, NULL);
@@ -1084,6 +1490,8 @@ static void vulkan_destroy(struct wlr_renderer *wlr_renderer) {
 	wl_list_for_each_safe(buf, tmp_buf, &renderer->stage.buffers, link) {
 		shared_buffer_destroy(renderer, buf);
 	}
+	shared_buffer_destroy(renderer, renderer->stage.ring.buffer);
+	wl_array_release(&renderer->stage.ring.regions);
 
 	struct wlr_vk_texture *tex, *tex_tmp;
 	wl_list_for_each_safe(tex, tex_tmp, &renderer->textures, link) {
@@ -1096,12 +1504,24 @@ static void vulkan_destroy(struct wlr_renderer *wlr_renderer) {
 		destroy_render_buffer(render_buffer);
 	}
 
+	struct wlr_vk_blend_image *blend, *blend_tmp;
+	wl_list_for_each_safe(blend, blend_tmp, &renderer->blend_images, link) {
+		destroy_blend_image(renderer, blend);
+	}
+
+	vulkan_finish_effects(renderer);
+
 	struct wlr_vk_color_transform *color_transform, *color_transform_tmp;
 	wl_list_for_each_safe(color_transform, color_transform_tmp,
 			&renderer->color_transforms, link) {
 		vk_color_transform_destroy(&color_transform->addon);
 	}
 
+	struct wlr_vk_render_setup_job *job, *tmp_job;
+	wl_list_for_each_safe(job, tmp_job, &renderer->render_setup_jobs, link) {
+		render_setup_job_finish(job);
+	}
+
 	struct wlr_vk_render_format_setup *setup, *tmp_setup;
 	wl_list_for_each_safe(setup, tmp_setup,
 			&renderer->render_format_setups, link) {
@@ -1120,12 +1540,20 @@ static void vulkan_destroy(struct wlr_renderer *wlr_renderer) {
 
 	vkDestroyShaderModule(dev->dev, renderer->vert_module, NULL);
 	vkDestroyShaderModule(dev->dev, renderer->tex_frag_module, NULL);
+	vkDestroyShaderModule(dev->dev, renderer->tex_bindless_frag_module, NULL);
+	vkDestroyShaderModule(dev->dev, renderer->tex_instanced_vert_module, NULL);
 	vkDestroyShaderModule(dev->dev, renderer->quad_frag_module, NULL);
 	vkDestroyShaderModule(dev->dev, renderer->output_module, NULL);
 
 	struct wlr_vk_pipeline_layout *pipeline_layout, *pipeline_layout_tmp;
 	wl_list_for_each_safe(pipeline_layout, pipeline_layout_tmp,
 			&renderer->pipeline_layouts, link) {
+		if (pipeline_layout->bindless != NULL) {
+			// descriptor set automatically freed with its pool
+			vkDestroyDescriptorPool(dev->dev, pipeline_layout->bindless->pool, NULL);
+			wl_array_release(&pipeline_layout->bindless->free_indices);
+			free(pipeline_layout->bindless);
+		}
 		vkDestroyPipelineLayout(dev->dev, pipeline_layout->vk, NULL);
 		vkDestroyDescriptorSetLayout(dev->dev, pipeline_layout->ds, NULL);
 		vkDestroySampler(dev->dev, pipeline_layout->sampler, NULL);
@@ -1137,11 +1565,21 @@ static void vulkan_destroy(struct wlr_renderer *wlr_renderer) {
 	vkDestroyImage(dev->dev, renderer->dummy3d_image, NULL);
 	vkFreeMemory(dev->dev, renderer->dummy3d_mem, NULL);
 
+	vulkan_finish_memory_pages(renderer);
+
 	vkDestroySemaphore(dev->dev, renderer->timeline_semaphore, NULL);
+	vkDestroySemaphore(dev->dev, renderer->transfer.timeline_semaphore, NULL);
+	// transfer command buffers automatically freed with their command pool
+	vkDestroyCommandPool(dev->dev, renderer->transfer.command_pool, NULL);
 	vkDestroyPipelineLayout(dev->dev, renderer->output_pipe_layout, NULL);
 	vkDestroyDescriptorSetLayout(dev->dev, renderer->output_ds_srgb_layout, NULL);
 	vkDestroyDescriptorSetLayout(dev->dev, renderer->output_ds_lut3d_layout, NULL);
+	// command buffers automatically freed with their command pool
 	vkDestroyCommandPool(dev->dev, renderer->command_pool, NULL);
+	wl_list_for_each_safe(cb, cb_tmp, &renderer->command_buffers, link) {
+		wl_list_remove(&cb->link);
+		free(cb);
+	}
 	vkDestroySampler(dev->dev, renderer->output_sampler_lut3d, NULL);
 
 	if (renderer->read_pixels_cache.initialized) {
@@ -1149,6 +1587,8 @@ static void vulkan_destroy(struct wlr_renderer *wlr_renderer) {
 		vkDestroyImage(dev->dev, renderer->read_pixels_cache.dst_image, NULL);
 	}
 
+	vulkan_pipeline_cache_finish(renderer);
+
 	struct wlr_vk_instance *ini = dev->instance;
 	vulkan_device_destroy(dev);
 	vulkan_instance_destroy(ini);
@@ -1426,14 +1866,140 @@ static struct wlr_render_pass *vulkan_begin_buffer_pass(struct wlr_renderer *wlr
 	return &render_pass->base;
 }
 
-static const struct wlr_renderer_impl renderer_impl = {
-	.get_texture_formats = vulkan_get_texture_formats,
-	.get_render_formats = vulkan_get_render_formats,
-	.destroy = vulkan_destroy,
-	.get_drm_fd = vulkan_get_drm_fd,
-	.texture_from_buffer = vulkan_texture_from_buffer,
-	.begin_buffer_pass = vulkan_begin_buffer_pass,
-};
+static const struct wlr_render_timer_impl render_timer_impl;
+
+struct wlr_vk_render_timer *vulkan_get_render_timer(struct wlr_render_timer *wlr_timer) {
+	assert(wlr_timer->impl == &render_timer_impl);
+	struct wlr_vk_render_timer *timer = wl_container_of(wlr_timer, timer, base);
+	return timer;
+}
+
+static struct wlr_render_timer *vulkan_render_timer_create(struct wlr_renderer *wlr_renderer) {
+	struct wlr_vk_renderer *renderer = vulkan_get_renderer(wlr_renderer);
+	if (renderer->dev->timestamp_valid_bits == 0) {
+		wlr_log(WLR_ERROR, "can't create timer, queue doesn't support timestamps");
+		return NULL;
+	}
+
+	struct wlr_vk_render_timer *timer = calloc(1, sizeof(*timer));
+	if (!timer) {
+		return NULL;
+	}
+	timer->base.impl = &render_timer_impl;
+	timer->renderer = renderer;
+
+	VkQueryPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = 2,
+	};
+	VkResult res = vkCreateQueryPool(renderer->dev->dev, &pool_info, NULL,
+		&timer->query_pool);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateQueryPool", res);
+		free(timer);
+		return NULL;
+	}
+
+	return &timer->base;
+}
+
+static int vulkan_get_render_time(struct wlr_render_timer *wlr_timer) {
+	struct wlr_vk_render_timer *timer = vulkan_get_render_timer(wlr_timer);
+	struct wlr_vk_device *dev = timer->renderer->dev;
+
+	if (!timer->submitted) {
+		wlr_log(WLR_ERROR, "timer wasn't used by a submitted render pass");
+		return -1;
+	}
+
+	// Doesn't wait: the results are read back once the GPU is done
+	uint64_t timestamps[2];
+	VkResult res = vkGetQueryPoolResults(dev->dev, timer->query_pool, 0, 2,
+		sizeof(timestamps), timestamps, sizeof(timestamps[0]),
+		VK_QUERY_RESULT_64_BIT);
+	if (res == VK_NOT_READY) {
+		wlr_log(WLR_ERROR, "timer was read too early, gpu isn't done!");
+		return -1;
+	} else if (res != VK_SUCCESS) {
+		wlr_vk_error("vkGetQueryPoolResults", res);
+		return -1;
+	}
+
+	uint64_t mask = dev->timestamp_valid_bits >= 64 ?
+		UINT64_MAX : (UINT64_C(1) << dev->timestamp_valid_bits) - 1;
+	uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+	int64_t gpu_nsec_total = (int64_t)((double)ticks * dev->timestamp_period);
+
+	int64_t cpu_nsec_total = timespec_to_nsec(&timer->cpu_end) - timespec_to_nsec(&timer->cpu_start);
+
+	return gpu_nsec_total + cpu_nsec_total;
+}
+
+static void vulkan_render_timer_destroy(struct wlr_render_timer *wlr_timer) {
+	struct wlr_vk_render_timer *timer = vulkan_get_render_timer(wlr_timer);
+	VkDevice dev = timer->renderer->dev->dev;
+	if (timer->submitted) {
+		// The query pool must not be in use by a pending command buffer
+		uint64_t timestamps[2];
+		vkGetQueryPoolResults(dev, timer->query_pool, 0, 2, sizeof(timestamps),
+			timestamps, sizeof(timestamps[0]),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+	}
+	vkDestroyQueryPool(dev, timer->query_pool, NULL);
+	free(timer);
+}
+
+static const struct wlr_render_timer_impl render_timer_impl = {
+	.get_duration_ns = vulkan_get_render_time,
+	.destroy = vulkan_render_timer_destroy,
+};
+
+static const struct wlr_renderer_impl renderer_impl = {
+	.get_texture_formats = vulkan_get_texture_formats,
+	.get_render_formats = vulkan_get_render_formats,
+	.destroy = vulkan_destroy,
+	.get_drm_fd = vulkan_get_drm_fd,
+	.texture_from_buffer = vulkan_texture_from_buffer,
+	.begin_buffer_pass = vulkan_begin_buffer_pass,
+	.render_timer_create = vulkan_render_timer_create,
+	.prepare_render_format = vulkan_prepare_render_format,
+};
+
+// Initializes the VkPipelineLayout of texture rendering pipelines for the
+// given VkDescriptorSetLayout.
+static bool init_tex_pipeline_layout(struct wlr_vk_renderer *renderer,
+		VkDescriptorSetLayout ds_layout, VkPipelineLayout *out_pipe_layout) {
+	VkDevice dev = renderer->dev->dev;
+
+	VkPushConstantRange pc_ranges[2] = {
+		{
+			.size = sizeof(struct wlr_vk_vert_pcr_data),
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		},
+		{
+			.offset = pc_ranges[0].size,
+			.size = sizeof(float) * 4, // alpha or color
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		},
+	};
+
+	VkPipelineLayoutCreateInfo pl_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &ds_layout,
+		.pushConstantRangeCount = 2,
+		.pPushConstantRanges = pc_ranges,
+	};
+
+	VkResult res = vkCreatePipelineLayout(dev, &pl_info, NULL, out_pipe_layout);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreatePipelineLayout", res);
+		return false;
+	}
+
+	return true;
+}
 
 // Initializes the VkDescriptorSetLayout and VkPipelineLayout needed
 // for the texture rendering pipeline using the given VkSampler.
@@ -1463,32 +2029,112 @@ static bool init_tex_layouts(struct wlr_vk_renderer *renderer,
 		return false;
 	}
 
-	VkPushConstantRange pc_ranges[2] = {
+	return init_tex_pipeline_layout(renderer, *out_ds_layout, out_pipe_layout);
+}
+
+// Initializes the VkDescriptorSetLayout, VkPipelineLayout and descriptor set
+// for the bindless texture rendering pipeline using the given VkSampler.
+// Binding 0 holds the sampler, binding 1 the views of all textures.
+static bool init_bindless_tex_layouts(struct wlr_vk_renderer *renderer,
+		VkSampler tex_sampler, struct wlr_vk_pipeline_layout *pipeline_layout) {
+	VkResult res;
+	VkDevice dev = renderer->dev->dev;
+	uint32_t capacity = renderer->dev->max_bindless_textures;
+
+	VkDescriptorSetLayoutBinding ds_bindings[2] = {
 		{
-			.size = sizeof(struct wlr_vk_vert_pcr_data),
-			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.pImmutableSamplers = &tex_sampler,
 		},
 		{
-			.offset = pc_ranges[0].size,
-			.size = sizeof(float) * 4, // alpha or color
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+			.descriptorCount = capacity,
 			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
 		},
 	};
 
-	VkPipelineLayoutCreateInfo pl_info = {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-		.setLayoutCount = 1,
-		.pSetLayouts = out_ds_layout,
-		.pushConstantRangeCount = 2,
-		.pPushConstantRanges = pc_ranges,
+	// Slots are written while command buffers using other slots are pending
+	VkDescriptorBindingFlagsEXT binding_flags[2] = {
+		0,
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT,
+	};
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+		.bindingCount = 2,
+		.pBindingFlags = binding_flags,
+	};
+	VkDescriptorSetLayoutCreateInfo ds_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = &binding_flags_info,
+		.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+		.bindingCount = 2,
+		.pBindings = ds_bindings,
 	};
 
-	res = vkCreatePipelineLayout(dev, &pl_info, NULL, out_pipe_layout);
+	res = vkCreateDescriptorSetLayout(dev, &ds_info, NULL, &pipeline_layout->ds);
 	if (res != VK_SUCCESS) {
-		wlr_vk_error("vkCreatePipelineLayout", res);
+		wlr_vk_error("vkCreateDescriptorSetLayout", res);
+		return false;
+	}
+
+	if (!init_tex_pipeline_layout(renderer, pipeline_layout->ds,
+			&pipeline_layout->vk)) {
+		return false;
+	}
+
+	struct wlr_vk_bindless_set *set = calloc(1, sizeof(*set));
+	if (set == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	set->capacity = capacity;
+	wl_array_init(&set->free_indices);
+
+	VkDescriptorPoolSize pool_sizes[2] = {
+		{
+			.type = VK_DESCRIPTOR_TYPE_SAMPLER,
+			.descriptorCount = 1,
+		},
+		{
+			.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+			.descriptorCount = capacity,
+		},
+	};
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+		.maxSets = 1,
+		.poolSizeCount = 2,
+		.pPoolSizes = pool_sizes,
+	};
+	res = vkCreateDescriptorPool(dev, &pool_info, NULL, &set->pool);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateDescriptorPool", res);
+		free(set);
+		return false;
+	}
+
+	VkDescriptorSetAllocateInfo ds_alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = set->pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &pipeline_layout->ds,
+	};
+	res = vkAllocateDescriptorSets(dev, &ds_alloc_info, &set->ds);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkAllocateDescriptorSets", res);
+		vkDestroyDescriptorPool(dev, set->pool, NULL);
+		free(set);
 		return false;
 	}
 
+	pipeline_layout->bindless = set;
 	return true;
 }
 
@@ -1606,6 +2252,13 @@ static bool pipeline_layout_key_equals(
 		return false;
 	}
 
+	if (a->ycbcr_format != NULL &&
+			(a->ycbcr_caps.chroma_location != b->ycbcr_caps.chroma_location ||
+			a->ycbcr_caps.linear_chroma_filter != b->ycbcr_caps.linear_chroma_filter ||
+			a->ycbcr_caps.separate_chroma_filter != b->ycbcr_caps.separate_chroma_filter)) {
+		return false;
+	}
+
 	return true;
 }
 
@@ -1633,25 +2286,19 @@ static bool pipeline_key_equals(const struct wlr_vk_pipeline_key *a,
 
 // Initializes the pipeline for rendering textures and using the given
 // VkRenderPass and VkPipelineLayout.
-struct wlr_vk_pipeline *setup_get_or_create_pipeline(
+/**
+ * Allocate a pipeline of the setup, without compiling it yet.
+ */
+static struct wlr_vk_pipeline *setup_add_pipeline(
 		struct wlr_vk_render_format_setup *setup,
 		const struct wlr_vk_pipeline_key *key) {
-	struct wlr_vk_pipeline *pipeline;
-	wl_list_for_each(pipeline, &setup->pipelines, link) {
-		if (pipeline_key_equals(&pipeline->key, key)) {
-			return pipeline;
-		}
-	}
-
-	struct wlr_vk_renderer *renderer = setup->renderer;
-
 	struct wlr_vk_pipeline_layout *pipeline_layout = get_or_create_pipeline_layout(
-		renderer, &key->layout);
+		setup->renderer, &key->layout);
 	if (!pipeline_layout) {
 		return NULL;
 	}
 
-	pipeline = calloc(1, sizeof(*pipeline));
+	struct wlr_vk_pipeline *pipeline = calloc(1, sizeof(*pipeline));
 	if (!pipeline) {
 		return NULL;
 	}
@@ -1659,6 +2306,19 @@ struct wlr_vk_pipeline *setup_get_or_create_pipeline(
 	pipeline->setup = setup;
 	pipeline->key = *key;
 	pipeline->layout = pipeline_layout;
+	wl_list_insert(&setup->pipelines, &pipeline->link);
+	return pipeline;
+}
+
+/**
+ * Compile a pipeline once its setup's render pass is created. Only reads
+ * immutable renderer state, so this may run on another thread.
+ */
+static bool pipeline_compile(struct wlr_vk_pipeline *pipeline) {
+	const struct wlr_vk_render_format_setup *setup = pipeline->setup;
+	const struct wlr_vk_pipeline_key *key = &pipeline->key;
+	const struct wlr_vk_pipeline_layout *pipeline_layout = pipeline->layout;
+	struct wlr_vk_renderer *renderer = setup->renderer;
 
 	VkResult res;
 	VkDevice dev = renderer->dev->dev;
@@ -1678,11 +2338,16 @@ struct wlr_vk_pipeline *setup_get_or_create_pipeline(
 		.pData = &color_transform_type,
 	};
 
+	// Bindless texture pipelines draw batches of quads, with per-instance
+	// vertex attributes instead of push constants
+	bool instanced = key->source == WLR_VK_SHADER_SOURCE_TEXTURE &&
+		pipeline_layout->bindless != NULL;
+
 	VkPipelineShaderStageCreateInfo stages[2];
 	stages[0] = (VkPipelineShaderStageCreateInfo) {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
 		.stage = VK_SHADER_STAGE_VERTEX_BIT,
-		.module = renderer->vert_module,
+		.module = instanced ? renderer->tex_instanced_vert_module : renderer->vert_module,
 		.pName = "main",
 	};
 
@@ -1699,7 +2364,8 @@ struct wlr_vk_pipeline *setup_get_or_create_pipeline(
 		stages[1] = (VkPipelineShaderStageCreateInfo) {
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
 			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-			.module = renderer->tex_frag_module,
+			.module = instanced ?
+				renderer->tex_bindless_frag_module : renderer->tex_frag_module,
 			.pName = "main",
 			.pSpecializationInfo = &specialization,
 		};
@@ -1766,6 +2432,51 @@ struct wlr_vk_pipeline *setup_get_or_create_pipeline(
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
 	};
 
+	VkVertexInputBindingDescription instance_binding = {
+		.binding = 0,
+		.stride = sizeof(struct wlr_vk_texture_instance),
+		.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+	};
+	VkVertexInputAttributeDescription instance_attribs[] = {
+		{
+			.location = 0,
+			.format = VK_FORMAT_R32G32B32_SFLOAT,
+			.offset = offsetof(struct wlr_vk_texture_instance, proj[0]),
+		},
+		{
+			.location = 1,
+			.format = VK_FORMAT_R32G32B32_SFLOAT,
+			.offset = offsetof(struct wlr_vk_texture_instance, proj[1]),
+		},
+		{
+			.location = 2,
+			.format = VK_FORMAT_R32G32B32A32_SFLOAT,
+			.offset = offsetof(struct wlr_vk_texture_instance, pos_off),
+		},
+		{
+			.location = 3,
+			.format = VK_FORMAT_R32G32B32A32_SFLOAT,
+			.offset = offsetof(struct wlr_vk_texture_instance, uv_off),
+		},
+		{
+			.location = 4,
+			.format = VK_FORMAT_R32_SFLOAT,
+			.offset = offsetof(struct wlr_vk_texture_instance, alpha),
+		},
+		{
+			.location = 5,
+			.format = VK_FORMAT_R32_UINT,
+			.offset = offsetof(struct wlr_vk_texture_instance, tex_index),
+		},
+	};
+	if (instanced) {
+		vertex.vertexBindingDescriptionCount = 1;
+		vertex.pVertexBindingDescriptions = &instance_binding;
+		vertex.vertexAttributeDescriptionCount =
+			sizeof(instance_attribs) / sizeof(instance_attribs[0]);
+		vertex.pVertexAttributeDescriptions = instance_attribs;
+	}
+
 	VkGraphicsPipelineCreateInfo pinfo = {
 		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
 		.layout = pipeline_layout->vk,
@@ -1783,15 +2494,34 @@ struct wlr_vk_pipeline *setup_get_or_create_pipeline(
 		.pVertexInputState = &vertex,
 	};
 
-	VkPipelineCache cache = VK_NULL_HANDLE;
-	res = vkCreateGraphicsPipelines(dev, cache, 1, &pinfo, NULL, &pipeline->vk);
+	res = vkCreateGraphicsPipelines(dev, renderer->pipeline_cache, 1, &pinfo, NULL, &pipeline->vk);
 	if (res != VK_SUCCESS) {
 		wlr_vk_error("failed to create vulkan pipelines:", res);
+		return false;
+	}
+
+	return true;
+}
+
+struct wlr_vk_pipeline *setup_get_or_create_pipeline(
+		struct wlr_vk_render_format_setup *setup,
+		const struct wlr_vk_pipeline_key *key) {
+	struct wlr_vk_pipeline *pipeline;
+	wl_list_for_each(pipeline, &setup->pipelines, link) {
+		if (pipeline_key_equals(&pipeline->key, key)) {
+			return pipeline;
+		}
+	}
+
+	pipeline = setup_add_pipeline(setup, key);
+	if (!pipeline) {
+		return NULL;
+	}
+	if (!pipeline_compile(pipeline)) {
+		wl_list_remove(&pipeline->link);
 		free(pipeline);
 		return NULL;
 	}
-
-	wl_list_insert(&setup->pipelines, &pipeline->link);
 	return pipeline;
 }
 
@@ -1900,8 +2630,7 @@ static bool init_blend_to_output_pipeline(struct wlr_vk_renderer *renderer,
 		.pVertexInputState = &vertex,
 	};
 
-	VkPipelineCache cache = VK_NULL_HANDLE;
-	res = vkCreateGraphicsPipelines(dev, cache, 1, &pinfo, NULL, pipe);
+	res = vkCreateGraphicsPipelines(dev, renderer->pipeline_cache, 1, &pinfo, NULL, pipe);
 	if (res != VK_SUCCESS) {
 		wlr_vk_error("failed to create vulkan pipelines:", res);
 		return false;
@@ -1938,6 +2667,22 @@ struct wlr_vk_pipeline_layout *get_or_create_pipeline_layout(
 		break;
 	}
 
+	// Without separate reconstruction filters, the sampler filter must match
+	// the chroma filter, which may only be linear if supported
+	VkFilter chroma_filter = VK_FILTER_NEAREST;
+	if (key->ycbcr_format) {
+		const struct wlr_vk_ycbcr_caps *caps = &key->ycbcr_caps;
+		if (caps->separate_chroma_filter) {
+			chroma_filter = caps->linear_chroma_filter ?
+				VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+		} else {
+			if (!caps->linear_chroma_filter) {
+				filter = VK_FILTER_NEAREST;
+			}
+			chroma_filter = filter;
+		}
+	}
+
 	VkSamplerYcbcrConversionInfo conversion_info;
 	VkSamplerCreateInfo sampler_create_info = {
 		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
@@ -1957,9 +2702,9 @@ struct wlr_vk_pipeline_layout *get_or_create_pipeline_layout(
 			.format = key->ycbcr_format->vk,
 			.ycbcrModel = VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_601,
 			.ycbcrRange = VK_SAMPLER_YCBCR_RANGE_ITU_NARROW,
-			.xChromaOffset = VK_CHROMA_LOCATION_MIDPOINT,
-			.yChromaOffset = VK_CHROMA_LOCATION_MIDPOINT,
-			.chromaFilter = VK_FILTER_LINEAR,
+			.xChromaOffset = key->ycbcr_caps.chroma_location,
+			.yChromaOffset = key->ycbcr_caps.chroma_location,
+			.chromaFilter = chroma_filter,
 		};
 		res = vkCreateSamplerYcbcrConversion(renderer->dev->dev,
 			&conversion_create_info, NULL, &pipeline_layout->ycbcr.conversion);
@@ -1983,7 +2728,14 @@ struct wlr_vk_pipeline_layout *get_or_create_pipeline_layout(
 		return NULL;
 	}
 
-	if (!init_tex_layouts(renderer, pipeline_layout->sampler, &pipeline_layout->ds, &pipeline_layout->vk)) {
+	// YCbCr conversions need a combined image sampler with an immutable
+	// sampler per conversion, those layouts can't use the bindless array
+	if (renderer->dev->descriptor_indexing && key->ycbcr_format == NULL) {
+		if (!init_bindless_tex_layouts(renderer, pipeline_layout->sampler, pipeline_layout)) {
+			free(pipeline_layout);
+			return NULL;
+		}
+	} else if (!init_tex_layouts(renderer, pipeline_layout->sampler, &pipeline_layout->ds, &pipeline_layout->vk)) {
 		free(pipeline_layout);
 		return NULL;
 	}
@@ -2131,6 +2883,32 @@ static bool init_static_render_data(struct wlr_vk_renderer *renderer) {
 		return false;
 	}
 
+	if (renderer->dev->descriptor_indexing) {
+		sinfo = (VkShaderModuleCreateInfo){
+			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			.codeSize = sizeof(texture_bindless_frag_data),
+			.pCode = texture_bindless_frag_data,
+		};
+		res = vkCreateShaderModule(dev, &sinfo, NULL,
+			&renderer->tex_bindless_frag_module);
+		if (res != VK_SUCCESS) {
+			wlr_vk_error("Failed to create bindless tex fragment shader module", res);
+			return false;
+		}
+
+		sinfo = (VkShaderModuleCreateInfo){
+			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			.codeSize = sizeof(texture_instanced_vert_data),
+			.pCode = texture_instanced_vert_data,
+		};
+		res = vkCreateShaderModule(dev, &sinfo, NULL,
+			&renderer->tex_instanced_vert_module);
+		if (res != VK_SUCCESS) {
+			wlr_vk_error("Failed to create instanced tex vertex shader module", res);
+			return false;
+		}
+	}
+
 	sinfo = (VkShaderModuleCreateInfo){
 		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
 		.codeSize = sizeof(quad_frag_data),
@@ -2156,18 +2934,13 @@ static bool init_static_render_data(struct wlr_vk_renderer *renderer) {
 	return true;
 }
 
-static struct wlr_vk_render_format_setup *find_or_create_render_setup(
+/**
+ * Allocate a render setup along with the pipelines compiled with it.
+ */
+static struct wlr_vk_render_format_setup *render_setup_create(
 		struct wlr_vk_renderer *renderer, const struct wlr_vk_format *format,
 		bool use_blending_buffer) {
-	struct wlr_vk_render_format_setup *setup;
-	wl_list_for_each(setup, &renderer->render_format_setups, link) {
-		if (setup->render_format == format &&
-				setup->use_blending_buffer == use_blending_buffer) {
-			return setup;
-		}
-	}
-
-	setup = calloc(1u, sizeof(*setup));
+	struct wlr_vk_render_format_setup *setup = calloc(1u, sizeof(*setup));
 	if (!setup) {
 		wlr_log(WLR_ERROR, "Allocation failed");
 		return NULL;
@@ -2178,10 +2951,81 @@ static struct wlr_vk_render_format_setup *find_or_create_render_setup(
 	setup->renderer = renderer;
 	wl_list_init(&setup->pipelines);
 
+	// Pipelines without blending are used for opaque content. Compositors
+	// may ask for them to be created upfront to avoid hitches on first use.
+	const enum wlr_render_blend_mode blend_modes[] = {
+		WLR_RENDER_BLEND_MODE_PREMULTIPLIED,
+		WLR_RENDER_BLEND_MODE_NONE,
+	};
+	size_t blend_modes_len = renderer->eager_pipelines ?
+		sizeof(blend_modes) / sizeof(blend_modes[0]) : 1;
+	for (size_t i = 0; i < blend_modes_len; i++) {
+		enum wlr_render_blend_mode blend_mode = blend_modes[i];
+
+		if (!setup_add_pipeline(setup, &(struct wlr_vk_pipeline_key){
+			.source = WLR_VK_SHADER_SOURCE_SINGLE_COLOR,
+			.blend_mode = blend_mode,
+			.layout = { .ycbcr_format = NULL },
+		})) {
+			goto error;
+		}
+
+		if (!setup_add_pipeline(setup, &(struct wlr_vk_pipeline_key){
+			.source = WLR_VK_SHADER_SOURCE_TEXTURE,
+			.blend_mode = blend_mode,
+			.texture_transform = WLR_VK_TEXTURE_TRANSFORM_IDENTITY,
+			.layout = {.ycbcr_format = NULL },
+		})) {
+			goto error;
+		}
+
+		if (!setup_add_pipeline(setup, &(struct wlr_vk_pipeline_key){
+			.source = WLR_VK_SHADER_SOURCE_TEXTURE,
+			.blend_mode = blend_mode,
+			.texture_transform = WLR_VK_TEXTURE_TRANSFORM_SRGB,
+			.layout = {.ycbcr_format = NULL },
+		})) {
+			goto error;
+		}
+
+		for (size_t j = 0; j < renderer->dev->format_prop_count; j++) {
+			const struct wlr_vk_format_props *props = &renderer->dev->format_props[j];
+			const struct wlr_vk_format *format = &props->format;
+			if (format->is_ycbcr && props->dmabuf.texture_mod_count > 0) {
+				// Most buffers of a format use modifiers with the same caps
+				const struct wlr_vk_pipeline_layout_key layout = {
+					.ycbcr_format = format,
+					.ycbcr_caps = props->dmabuf.texture_mods[0].ycbcr,
+				};
+				if (!setup_add_pipeline(setup, &(struct wlr_vk_pipeline_key){
+					.blend_mode = blend_mode,
+					.texture_transform = WLR_VK_TEXTURE_TRANSFORM_SRGB,
+					.layout = layout
+				})) {
+					goto error;
+				}
+			}
+		}
+	}
+
+	return setup;
+
+error:
+	destroy_render_format_setup(renderer, setup);
+	return NULL;
+}
+
+/**
+ * Create the render pass and compile the pipelines of a render setup. Only
+ * reads immutable renderer state, so this may run on another thread.
+ */
+static bool render_setup_compile(struct wlr_vk_render_format_setup *setup) {
+	struct wlr_vk_renderer *renderer = setup->renderer;
+	const struct wlr_vk_format *format = setup->render_format;
 	VkDevice dev = renderer->dev->dev;
 	VkResult res;
 
-	if (use_blending_buffer) {
+	if (setup->use_blending_buffer) {
 		VkAttachmentDescription attachments[2] = {
 			{
 				.format = VK_FORMAT_R16G16B16A16_SFLOAT,
@@ -2288,19 +3132,19 @@ static struct wlr_vk_render_format_setup *find_or_create_render_setup(
 		res = vkCreateRenderPass(dev, &rp_info, NULL, &setup->render_pass);
 		if (res != VK_SUCCESS) {
 			wlr_vk_error("Failed to create 2-step render pass", res);
-			goto error;
+			return false;
 		}
 
 		// this is only well defined if render pass has a 2nd subpass
 		if (!init_blend_to_output_pipeline(
 				renderer, setup->render_pass, renderer->output_pipe_layout,
 				&setup->output_pipe_lut3d, WLR_VK_OUTPUT_TRANSFORM_LUT3D)) {
-			goto error;
+			return false;
 		}
 		if (!init_blend_to_output_pipeline(
 			renderer, setup->render_pass, renderer->output_pipe_layout,
 			&setup->output_pipe_srgb, WLR_VK_OUTPUT_TRANSFORM_INVERSE_SRGB)) {
-			goto error;
+			return false;
 		}
 	} else {
 		assert(format->vk_srgb);
@@ -2368,55 +3212,149 @@ static struct wlr_vk_render_format_setup *find_or_create_render_setup(
 		res = vkCreateRenderPass(dev, &rp_info, NULL, &setup->render_pass);
 		if (res != VK_SUCCESS) {
 			wlr_vk_error("Failed to create render pass", res);
-			goto error;
+			return false;
 		}
 	}
 
-	if (!setup_get_or_create_pipeline(setup, &(struct wlr_vk_pipeline_key){
-		.source = WLR_VK_SHADER_SOURCE_SINGLE_COLOR,
-		.layout = { .ycbcr_format = NULL },
-	})) {
-		goto error;
+	struct wlr_vk_pipeline *pipeline;
+	wl_list_for_each(pipeline, &setup->pipelines, link) {
+		if (!pipeline_compile(pipeline)) {
+			return false;
+		}
 	}
 
-	if (!setup_get_or_create_pipeline(setup, &(struct wlr_vk_pipeline_key){
-		.source = WLR_VK_SHADER_SOURCE_TEXTURE,
-		.texture_transform = WLR_VK_TEXTURE_TRANSFORM_IDENTITY,
-		.layout = {.ycbcr_format = NULL },
-	})) {
-		goto error;
+	return true;
+}
+
+static void *render_setup_job_run(void *data) {
+	struct wlr_vk_render_setup_job *job = data;
+	job->ok = render_setup_compile(job->setup);
+	return NULL;
+}
+
+/**
+ * Wait for a render setup job, and add its setup to the renderer on success.
+ */
+static struct wlr_vk_render_format_setup *render_setup_job_finish(
+		struct wlr_vk_render_setup_job *job) {
+	struct wlr_vk_renderer *renderer = job->setup->renderer;
+	pthread_join(job->thread, NULL);
+	wl_list_remove(&job->link);
+
+	struct wlr_vk_render_format_setup *setup = job->setup;
+	bool ok = job->ok;
+	free(job);
+
+	if (!ok) {
+		destroy_render_format_setup(renderer, setup);
+		return NULL;
 	}
 
-	if (!setup_get_or_create_pipeline(setup, &(struct wlr_vk_pipeline_key){
-		.source = WLR_VK_SHADER_SOURCE_TEXTURE,
-		.texture_transform = WLR_VK_TEXTURE_TRANSFORM_SRGB,
-		.layout = {.ycbcr_format = NULL },
-	})) {
-		goto error;
+	vulkan_pipeline_cache_save(renderer);
+	wl_list_insert(&renderer->render_format_setups, &setup->link);
+	return setup;
+}
+
+/**
+ * Start building a render setup on another thread, so that the first frame
+ * rendered with it doesn't have to wait for its pipelines to be compiled.
+ */
+static void render_setup_job_start(struct wlr_vk_renderer *renderer,
+		const struct wlr_vk_format *format, bool use_blending_buffer) {
+	struct wlr_vk_render_format_setup *setup;
+	wl_list_for_each(setup, &renderer->render_format_setups, link) {
+		if (setup->render_format == format &&
+				setup->use_blending_buffer == use_blending_buffer) {
+			return;
+		}
+	}
+	struct wlr_vk_render_setup_job *job;
+	wl_list_for_each(job, &renderer->render_setup_jobs, link) {
+		if (job->setup->render_format == format &&
+				job->setup->use_blending_buffer == use_blending_buffer) {
+			return;
+		}
 	}
 
-	for (size_t i = 0; i < renderer->dev->format_prop_count; i++) {
-		const struct wlr_vk_format *format = &renderer->dev->format_props[i].format;
-		const struct wlr_vk_pipeline_layout_key layout = {
-			.ycbcr_format = format,
-		};
+	// Pipeline layouts are shared with the renderer, create them here
+	setup = render_setup_create(renderer, format, use_blending_buffer);
+	if (!setup) {
+		return;
+	}
+
+	job = calloc(1, sizeof(*job));
+	if (!job) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		destroy_render_format_setup(renderer, setup);
+		return;
+	}
+	job->setup = setup;
+
+	if (pthread_create(&job->thread, NULL, render_setup_job_run, job) != 0) {
+		wlr_log(WLR_ERROR, "Failed to spawn render setup thread");
+		destroy_render_format_setup(renderer, setup);
+		free(job);
+		return;
+	}
+
+	wl_list_insert(&renderer->render_setup_jobs, &job->link);
+}
+
+static struct wlr_vk_render_format_setup *find_or_create_render_setup(
+		struct wlr_vk_renderer *renderer, const struct wlr_vk_format *format,
+		bool use_blending_buffer) {
+	struct wlr_vk_render_format_setup *setup;
+	wl_list_for_each(setup, &renderer->render_format_setups, link) {
+		if (setup->render_format == format &&
+				setup->use_blending_buffer == use_blending_buffer) {
+			return setup;
+		}
+	}
 
-		if (format->is_ycbcr) {
-			if (!setup_get_or_create_pipeline(setup, &(struct wlr_vk_pipeline_key){
-				.texture_transform = WLR_VK_TEXTURE_TRANSFORM_SRGB,
-				.layout = layout
-			})) {
-				goto error;
+	struct wlr_vk_render_setup_job *job;
+	wl_list_for_each(job, &renderer->render_setup_jobs, link) {
+		if (job->setup->render_format == format &&
+				job->setup->use_blending_buffer == use_blending_buffer) {
+			setup = render_setup_job_finish(job);
+			if (setup) {
+				return setup;
 			}
+			break;
 		}
 	}
 
+	setup = render_setup_create(renderer, format, use_blending_buffer);
+	if (!setup) {
+		return NULL;
+	}
+	if (!render_setup_compile(setup)) {
+		destroy_render_format_setup(renderer, setup);
+		return NULL;
+	}
+
+	// Most pipelines are compiled along with the setup, persist them now
+	// rather than on exit in case the compositor doesn't shut down cleanly
+	vulkan_pipeline_cache_save(renderer);
+
 	wl_list_insert(&renderer->render_format_setups, &setup->link);
 	return setup;
+}
 
-error:
-	destroy_render_format_setup(renderer, setup);
-	return NULL;
+static void vulkan_prepare_render_format(struct wlr_renderer *wlr_renderer,
+		uint32_t drm_format) {
+	struct wlr_vk_renderer *renderer = vulkan_get_renderer(wlr_renderer);
+	const struct wlr_vk_format_props *props =
+		vulkan_format_props_from_drm(renderer->dev, drm_format);
+	if (props == NULL || props->dmabuf.render_mod_count == 0) {
+		return;
+	}
+
+	// Render buffers use either setup depending on the modifier, and the
+	// plain one is also needed for color transforms
+	render_setup_job_start(renderer, &props->format, true);
+	if (props->format.vk_srgb) {
+		render_setup_job_start(renderer, &props->format, false);
+	}
 }
 
 struct wlr_renderer *vulkan_renderer_create_for_device(struct wlr_vk_device *dev) {
@@ -2431,12 +3369,18 @@ struct wlr_renderer *vulkan_renderer_create_for_device(struct wlr_vk_device *dev
 	wlr_renderer_init(&renderer->wlr_renderer, &renderer_impl, WLR_BUFFER_CAP_DMABUF);
 	renderer->wlr_renderer.features.output_color_transform = true;
 	wl_list_init(&renderer->stage.buffers);
+	wl_array_init(&renderer->stage.ring.regions);
 	wl_list_init(&renderer->foreign_textures);
 	wl_list_init(&renderer->textures);
+	wl_list_init(&renderer->memory_pages);
+	wl_list_init(&renderer->command_buffers);
 	wl_list_init(&renderer->descriptor_pools);
 	wl_list_init(&renderer->output_descriptor_pools);
 	wl_list_init(&renderer->render_format_setups);
+	wl_list_init(&renderer->render_setup_jobs);
 	wl_list_init(&renderer->render_buffers);
+	wl_list_init(&renderer->blend_images);
+	wl_list_init(&renderer->effects.images);
 	wl_list_init(&renderer->color_transforms);
 	wl_list_init(&renderer->pipeline_layouts);
 
@@ -2445,6 +3389,11 @@ struct wlr_renderer *vulkan_renderer_create_for_device(struct wlr_vk_device *dev
 		renderer->wlr_renderer.features.timeline = dev->sync_file_import_export && cap_syncobj_timeline != 0;
 	}
 
+	renderer->eager_pipelines = env_parse_bool("WLR_VK_EAGER_PIPELINES");
+	if (!vulkan_pipeline_cache_init(renderer)) {
+		goto error;
+	}
+
 	if (!init_static_render_data(renderer)) {
 		goto error;
 	}
@@ -2477,6 +3426,10 @@ struct wlr_renderer *vulkan_renderer_create_for_device(struct wlr_vk_device *dev
 		goto error;
 	}
 
+	if (!init_transfer_queue(renderer)) {
+		goto error;
+	}
+
 	return &renderer->wlr_renderer;
 
 error:
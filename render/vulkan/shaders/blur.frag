@@ -0,0 +1,42 @@
+#version 450
+
+// Dual Kawase blur, last upsampling step drawn into the render pass
+layout(set = 0, binding = 0) uniform sampler2D tex;
+
+layout(location = 0) in vec2 uv;
+layout(location = 0) out vec4 out_color;
+
+// Rounded rectangle the result is masked with, in pixels relative to the
+// blurred area of size tex_size. Disabled if mask_radius is 0.
+layout(push_constant) uniform UBO {
+	layout(offset = 80) vec4 mask_box;
+	vec2 halfpixel;
+	vec2 tex_size;
+	float offset;
+	float mask_radius;
+} data;
+
+float rounded_rect_mask(vec2 p) {
+	vec2 half_size = data.mask_box.zw * 0.5;
+	vec2 q = abs(p - data.mask_box.xy - half_size) - half_size + data.mask_radius;
+	float dist = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - data.mask_radius;
+	return clamp(0.5 - dist, 0.0, 1.0);
+}
+
+void main() {
+	vec2 halfpixel = data.halfpixel * data.offset;
+	vec4 sum = texture(tex, uv + vec2(-halfpixel.x * 2.0, 0.0));
+	sum += texture(tex, uv + vec2(-halfpixel.x, halfpixel.y)) * 2.0;
+	sum += texture(tex, uv + vec2(0.0, halfpixel.y * 2.0));
+	sum += texture(tex, uv + vec2(halfpixel.x, halfpixel.y)) * 2.0;
+	sum += texture(tex, uv + vec2(halfpixel.x * 2.0, 0.0));
+	sum += texture(tex, uv + vec2(halfpixel.x, -halfpixel.y)) * 2.0;
+	sum += texture(tex, uv + vec2(0.0, -halfpixel.y * 2.0));
+	sum += texture(tex, uv + vec2(-halfpixel.x, -halfpixel.y)) * 2.0;
+	sum /= 12.0;
+
+	if (data.mask_radius > 0.0) {
+		sum *= rounded_rect_mask(uv * data.tex_size);
+	}
+	out_color = sum;
+}
@@ -0,0 +1,57 @@
+#version 450
+
+// Shadow of a rounded rectangle blurred with a gaussian, see
+// https://madebyevan.com/shaders/fast-rounded-rectangle-shadows/
+layout(location = 0) in vec2 uv; // position in buffer coordinates
+layout(location = 0) out vec4 out_color;
+
+layout(push_constant) uniform UBO {
+	layout(offset = 80) vec4 color;
+	vec4 box; // x, y, width, height
+	float radius;
+	float sigma;
+} data;
+
+float gaussian(float x) {
+	const float pi = 3.141592653589793;
+	return exp(-(x * x) / (2.0 * data.sigma * data.sigma)) /
+		(sqrt(2.0 * pi) * data.sigma);
+}
+
+vec2 erf(vec2 x) {
+	vec2 s = sign(x);
+	vec2 a = abs(x);
+	x = 1.0 + (0.278393 + (0.230389 + 0.078108 * (a * a)) * a) * a;
+	x *= x;
+	return s - s / (x * x);
+}
+
+// Integral of the shadow along x at height y
+float shadow_x(float x, float y, vec2 half_size) {
+	float radius = data.radius;
+	float delta = min(half_size.y - radius - abs(y), 0.0);
+	float curved = half_size.x - radius + sqrt(max(0.0, radius * radius - delta * delta));
+	vec2 integral = 0.5 + 0.5 * erf((x + vec2(-curved, curved)) * (sqrt(0.5) / data.sigma));
+	return integral.y - integral.x;
+}
+
+void main() {
+	vec2 half_size = data.box.zw * 0.5;
+	vec2 p = uv - data.box.xy - half_size;
+
+	// Sample the gaussian along y, the shadow is separable enough for the
+	// result to be indistinguishable from the exact blur
+	float low = p.y - half_size.y;
+	float high = p.y + half_size.y;
+	float start = clamp(-3.0 * data.sigma, low, high);
+	float end = clamp(3.0 * data.sigma, low, high);
+	float dy = (end - start) / 4.0;
+	float y = start + dy * 0.5;
+	float value = 0.0;
+	for (int i = 0; i < 4; i++) {
+		value += shadow_x(p.x, p.y - y, half_size) * gaussian(y) * dy;
+		y += dy;
+	}
+
+	out_color = data.color * value;
+}
@@ -1,13 +1,27 @@
 #version 450
 
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+
+// All textures share a single descriptor set. Quads are drawn instanced, the
+// texture and alpha are given per instance by texture_instanced.vert
+layout(set = 0, binding = 0) uniform sampler tex_sampler;
+layout(set = 0, binding = 1) uniform texture2D textures[];
+
+layout(location = 1) flat in float alpha;
+layout(location = 2) flat in uint tex_index;
+#else
 layout(set = 0, binding = 0) uniform sampler2D tex;
+#endif
 
 layout(location = 0) in vec2 uv;
 layout(location = 0) out vec4 out_color;
 
+#ifndef BINDLESS
 layout(push_constant) uniform UBO {
 	layout(offset = 80) float alpha;
 } data;
+#endif
 
 layout (constant_id = 0) const int TEXTURE_TRANSFORM = 0;
 
@@ -36,12 +50,20 @@ vec4 srgb_color_to_linear(vec4 color) {
 }
 
 void main() {
+#ifdef BINDLESS
+	vec4 val = textureLod(sampler2D(textures[nonuniformEXT(tex_index)], tex_sampler), uv, 0);
+#else
 	vec4 val = textureLod(tex, uv, 0);
+#endif
 	if (TEXTURE_TRANSFORM == TEXTURE_TRANSFORM_SRGB) {
 		out_color = srgb_color_to_linear(val);
 	} else { // TEXTURE_TRANSFORM_IDENTITY
 		out_color = val;
 	}
 
+#ifdef BINDLESS
+	out_color *= alpha;
+#else
 	out_color *= data.alpha;
+#endif
 }
@@ -0,0 +1,23 @@
+#version 450
+
+// Per-instance attributes, must match struct wlr_vk_texture_instance
+layout(location = 0) in vec3 proj_row0;
+layout(location = 1) in vec3 proj_row1;
+layout(location = 2) in vec4 pos_rect; // offset, size
+layout(location = 3) in vec4 uv_rect; // offset, size
+layout(location = 4) in float in_alpha;
+layout(location = 5) in uint in_tex_index;
+
+layout(location = 0) out vec2 uv;
+layout(location = 1) flat out float alpha;
+layout(location = 2) flat out uint tex_index;
+
+void main() {
+	vec2 corner = vec2(float((gl_VertexIndex + 1) & 2) * 0.5f,
+		float(gl_VertexIndex & 2) * 0.5f);
+	vec3 pos = vec3(pos_rect.xy + corner * pos_rect.zw, 1.0);
+	uv = uv_rect.xy + pos.xy * uv_rect.zw;
+	gl_Position = vec4(dot(proj_row0, pos), dot(proj_row1, pos), 0.0, 1.0);
+	alpha = in_alpha;
+	tex_index = in_tex_index;
+}
@@ -10,7 +10,9 @@
 #include <wlr/render/vulkan.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
+#include "render/dmabuf.h"
 #include "render/pixel_format.h"
+#include "render/wlr_renderer.h"
 #include "render/vulkan.h"
 
 static const struct wlr_texture_impl texture_impl;
@@ -134,6 +136,57 @@ static bool write_pixels(struct wlr_vk_texture *texture,
 		return false;
 	}
 
+	// The transfer queue can only be used if the previous contents can be
+	// discarded, and if the image isn't already written to by the stage cb
+	pixman_box32_t full_box = {
+		.x2 = texture->wlr_texture.width,
+		.y2 = texture->wlr_texture.height,
+	};
+	bool discard = old_layout == VK_IMAGE_LAYOUT_UNDEFINED ||
+		pixman_region32_contains_rectangle(region, &full_box) == PIXMAN_REGION_IN;
+	VkCommandBuffer transfer_cb = VK_NULL_HANDLE;
+	if (discard && texture->last_used_cb != renderer->stage.cb) {
+		transfer_cb = vulkan_record_transfer_cb(renderer);
+	}
+
+	if (transfer_cb != VK_NULL_HANDLE) {
+		uint32_t transfer_family = renderer->dev->transfer_queue_family;
+		uint32_t graphics_family = renderer->dev->queue_family;
+
+		// Don't overwrite the image while a previous frame still reads it
+		if (texture->last_used_cb != NULL &&
+				texture->last_used_cb->timeline_point > renderer->transfer.wait_point) {
+			renderer->transfer.wait_point = texture->last_used_cb->timeline_point;
+		}
+
+		// No need to acquire the image from the graphics queue, since its
+		// contents are discarded
+		vulkan_change_layout(transfer_cb, texture->image,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT);
+		vkCmdCopyBufferToImage(transfer_cb, span.buffer->buffer, texture->image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)rects_len, copies);
+		// Release to the graphics queue, the destination scope is ignored
+		vulkan_transfer_image_ownership(transfer_cb, texture->image,
+			transfer_family, graphics_family,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+		// Matching acquire, the source scope is ignored
+		vulkan_transfer_image_ownership(cb, texture->image,
+			transfer_family, graphics_family,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, VK_ACCESS_SHADER_READ_BIT);
+		texture->last_used_cb = renderer->stage.cb;
+
+		free(copies);
+		return true;
+	}
+
 	vulkan_change_layout(cb, texture->image,
 		old_layout, src_stage, src_access,
 		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -197,13 +250,19 @@ void vulkan_texture_destroy(struct wlr_vk_texture *texture) {
 		return;
 	}
 
+	texture_set_memory_usage(&texture->wlr_texture, 0, false);
 	wl_list_remove(&texture->link);
 
 	VkDevice dev = texture->renderer->dev->dev;
 
 	struct wlr_vk_texture_view *view, *tmp_view;
 	wl_list_for_each_safe(view, tmp_view, &texture->views, link) {
-		vulkan_free_ds(texture->renderer, view->ds_pool, view->ds);
+		if (view->layout->bindless != NULL) {
+			vulkan_bindless_free_index(view->layout->bindless,
+				view->bindless_index);
+		} else {
+			vulkan_free_ds(texture->renderer, view->ds_pool, view->ds);
+		}
 		vkDestroyImageView(dev, view->image_view, NULL);
 		free(view);
 	}
@@ -213,6 +272,7 @@ void vulkan_texture_destroy(struct wlr_vk_texture *texture) {
 	for (unsigned i = 0u; i < texture->mem_count; ++i) {
 		vkFreeMemory(dev, texture->memories[i], NULL);
 	}
+	vulkan_free_memory(texture->renderer, &texture->memory);
 
 	free(texture);
 }
@@ -246,10 +306,16 @@ static uint32_t vulkan_texture_preferred_read_format(struct wlr_texture *wlr_tex
 	return texture->format->drm;
 }
 
+static bool vulkan_texture_is_opaque(struct wlr_texture *wlr_texture) {
+	struct wlr_vk_texture *texture = vulkan_get_texture(wlr_texture);
+	return !texture->has_alpha;
+}
+
 static const struct wlr_texture_impl texture_impl = {
 	.update_from_buffer = vulkan_texture_update_from_buffer,
 	.read_pixels = vulkan_texture_read_pixels,
 	.preferred_read_format = vulkan_texture_preferred_read_format,
+	.is_opaque = vulkan_texture_is_opaque,
 	.destroy = vulkan_texture_unref,
 };
 
@@ -325,13 +391,6 @@ struct wlr_vk_texture_view *vulkan_texture_get_or_create_view(struct wlr_vk_text
 		return NULL;
 	}
 
-	view->ds_pool = vulkan_alloc_texture_ds(texture->renderer, pipeline_layout->ds, &view->ds);
-	if (!view->ds_pool) {
-		free(view);
-		wlr_log(WLR_ERROR, "failed to allocate descriptor");
-		return NULL;
-	}
-
 	VkDescriptorImageInfo ds_img_info = {
 		.imageView = view->image_view,
 		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
@@ -341,10 +400,32 @@ struct wlr_vk_texture_view *vulkan_texture_get_or_create_view(struct wlr_vk_text
 		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 		.descriptorCount = 1,
 		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-		.dstSet = view->ds,
 		.pImageInfo = &ds_img_info,
 	};
 
+	struct wlr_vk_bindless_set *bindless = pipeline_layout->bindless;
+	if (bindless != NULL) {
+		if (!vulkan_bindless_alloc_index(bindless, &view->bindless_index)) {
+			vkDestroyImageView(dev, view->image_view, NULL);
+			free(view);
+			wlr_log(WLR_ERROR, "bindless texture array is full");
+			return NULL;
+		}
+		view->ds = bindless->ds;
+		ds_write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		ds_write.dstBinding = 1;
+		ds_write.dstArrayElement = view->bindless_index;
+	} else {
+		view->ds_pool = vulkan_alloc_texture_ds(texture->renderer, pipeline_layout->ds, &view->ds);
+		if (!view->ds_pool) {
+			vkDestroyImageView(dev, view->image_view, NULL);
+			free(view);
+			wlr_log(WLR_ERROR, "failed to allocate descriptor");
+			return NULL;
+		}
+	}
+	ds_write.dstSet = view->ds;
+
 	vkUpdateDescriptorSets(dev, 1, &ds_write, 0, NULL);
 
 	wl_list_insert(&texture->views, &view->link);
@@ -430,34 +511,11 @@ static struct wlr_texture *vulkan_texture_from_pixels(
 		goto error;
 	}
 
-	VkMemoryRequirements mem_reqs;
-	vkGetImageMemoryRequirements(dev, texture->image, &mem_reqs);
-
-	int mem_type_index = vulkan_find_mem_type(renderer->dev,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mem_reqs.memoryTypeBits);
-	if (mem_type_index == -1) {
-		wlr_log(WLR_ERROR, "failed to find suitable vulkan memory type");
-		goto error;
-	}
-
-	VkMemoryAllocateInfo mem_info = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = mem_reqs.size,
-		.memoryTypeIndex = mem_type_index,
-	};
-
-	res = vkAllocateMemory(dev, &mem_info, NULL, &texture->memories[0]);
-	if (res != VK_SUCCESS) {
-		wlr_vk_error("vkAllocatorMemory failed", res);
-		goto error;
-	}
-
-	texture->mem_count = 1;
-	res = vkBindImageMemory(dev, texture->image, texture->memories[0], 0);
-	if (res != VK_SUCCESS) {
-		wlr_vk_error("vkBindMemory failed", res);
+	if (!vulkan_bind_image_memory(renderer, texture->image,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->memory)) {
 		goto error;
 	}
+	texture_set_memory_usage(&texture->wlr_texture, texture->memory.size, false);
 
 	pixman_region32_t region;
 	pixman_region32_init_rect(&region, 0, 0, width, height);
@@ -566,8 +624,12 @@ VkImage vulkan_import_dmabuf(struct wlr_vk_renderer *renderer,
 		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
 		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
 		.extent = (VkExtent3D) { attribs->width, attribs->height, 1 },
-		.usage = for_render ? vulkan_render_usage : vulkan_dma_tex_usage,
+		.usage = vulkan_dma_tex_usage,
 	};
+	if (for_render) {
+		img_info.usage = mod->render_sampled ?
+			vulkan_render_sampled_usage : vulkan_render_usage;
+	}
 	if (disjoint) {
 		img_info.flags = VK_IMAGE_CREATE_DISJOINT_BIT;
 	}
@@ -755,8 +817,14 @@ static struct wlr_vk_texture *vulkan_texture_from_dmabuf(
 		goto error;
 	}
 	texture_set_format(texture, &fmt->format, using_mutable_srgb);
+	if (fmt->format.is_ycbcr) {
+		const struct wlr_vk_format_modifier_props *mod =
+			vulkan_format_props_find_modifier(fmt, attribs->modifier, false);
+		texture->ycbcr_caps = mod->ycbcr;
+	}
 
 	texture->dmabuf_imported = true;
+	texture_set_memory_usage(&texture->wlr_texture, dmabuf_get_size(attribs), true);
 
 	return texture;
 
@@ -76,3 +76,23 @@ void vulkan_change_layout(VkCommandBuffer cb, VkImage img,
 	};
 	vkCmdPipelineBarrier(cb, srcs, dsts, 0, 0, NULL, 0, NULL, 1, &barrier);
 }
+
+void vulkan_transfer_image_ownership(VkCommandBuffer cb, VkImage img,
+		uint32_t src_family, uint32_t dst_family,
+		VkImageLayout ol, VkPipelineStageFlags srcs, VkAccessFlags srca,
+		VkImageLayout nl, VkPipelineStageFlags dsts, VkAccessFlags dsta) {
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.oldLayout = ol,
+		.newLayout = nl,
+		.image = img,
+		.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+		.subresourceRange.layerCount = 1,
+		.subresourceRange.levelCount = 1,
+		.srcAccessMask = srca,
+		.dstAccessMask = dsta,
+		.srcQueueFamilyIndex = src_family,
+		.dstQueueFamilyIndex = dst_family,
+	};
+	vkCmdPipelineBarrier(cb, srcs, dsts, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
@@ -16,6 +16,7 @@
 #include <wlr/config.h>
 #include "render/dmabuf.h"
 #include "render/vulkan.h"
+#include "util/env.h"
 
 #if defined(__linux__)
 #include <sys/sysmacros.h>
@@ -496,10 +497,33 @@ struct wlr_vk_device *vulkan_device_create(struct wlr_vk_instance *ini,
 			graphics_found = queue_props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT;
 			if (graphics_found) {
 				dev->queue_family = i;
+				dev->timestamp_valid_bits = queue_props[i].timestampValidBits;
+				dev->queue_compute = queue_props[i].queueFlags & VK_QUEUE_COMPUTE_BIT;
 				break;
 			}
 		}
 		assert(graphics_found);
+
+		VkPhysicalDeviceProperties phdev_props;
+		vkGetPhysicalDeviceProperties(phdev, &phdev_props);
+		dev->timestamp_period = phdev_props.limits.timestampPeriod;
+
+		// A transfer-only family is usually backed by a separate copy
+		// engine, which lets uploads run while the previous frame renders
+		dev->transfer_queue_family = VK_QUEUE_FAMILY_IGNORED;
+		if (!env_parse_bool("WLR_VK_NO_TRANSFER_QUEUE")) {
+			for (unsigned i = 0u; i < qfam_count; ++i) {
+				VkQueueFlags flags = queue_props[i].queueFlags;
+				if ((flags & VK_QUEUE_TRANSFER_BIT) &&
+						!(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+					dev->transfer_queue_family = i;
+					break;
+				}
+			}
+		}
+		wlr_log(WLR_DEBUG, "Dedicated transfer queue %s",
+			dev->transfer_queue_family != VK_QUEUE_FAMILY_IGNORED ?
+			"supported" : "not supported");
 	}
 
 	bool exportable_semaphore = false, importable_semaphore = false;
@@ -556,13 +580,69 @@ struct wlr_vk_device *vulkan_device_create(struct wlr_vk_instance *ini,
 	wlr_log(WLR_DEBUG, "Sampler YCbCr conversion %s",
 		dev->sampler_ycbcr_conversion ? "supported" : "not supported");
 
+	// Descriptor indexing lets all textures share a single descriptor set.
+	// We need update-after-bind for sampled images, so that textures can be
+	// added while earlier command buffers using the set are still pending,
+	// and non-uniform indexing since instanced draws mix textures.
+	if (check_extension(avail_ext_props, avail_extc,
+			VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+			!env_parse_bool("WLR_VK_NO_DESCRIPTOR_INDEXING")) {
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+		};
+		phdev_features.pNext = &indexing_features;
+		vkGetPhysicalDeviceFeatures2(phdev, &phdev_features);
+
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing_props = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT,
+		};
+		VkPhysicalDeviceProperties2 phdev_props = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+			.pNext = &indexing_props,
+		};
+		vkGetPhysicalDeviceProperties2(phdev, &phdev_props);
+
+		uint32_t max_textures =
+			indexing_props.maxPerStageDescriptorUpdateAfterBindSampledImages;
+		if (max_textures > indexing_props.maxDescriptorSetUpdateAfterBindSampledImages) {
+			max_textures = indexing_props.maxDescriptorSetUpdateAfterBindSampledImages;
+		}
+		if (max_textures > VULKAN_MAX_BINDLESS_TEXTURES) {
+			max_textures = VULKAN_MAX_BINDLESS_TEXTURES;
+		}
+
+		dev->descriptor_indexing = indexing_features.runtimeDescriptorArray &&
+			indexing_features.descriptorBindingPartiallyBound &&
+			indexing_features.descriptorBindingSampledImageUpdateAfterBind &&
+			indexing_features.descriptorBindingUpdateUnusedWhilePending &&
+			indexing_features.shaderSampledImageArrayNonUniformIndexing &&
+			max_textures >= VULKAN_MIN_BINDLESS_TEXTURES;
+		if (dev->descriptor_indexing) {
+			dev->max_bindless_textures = max_textures;
+			extensions[extensions_len++] = VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME; // or vulkan 1.2
+		}
+	}
+	wlr_log(WLR_DEBUG, "Descriptor indexing %s",
+		dev->descriptor_indexing ? "supported" : "not supported");
+
 	const float prio = 1.f;
-	VkDeviceQueueCreateInfo qinfo = {
-		.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-		.queueFamilyIndex = dev->queue_family,
-		.queueCount = 1,
-		.pQueuePriorities = &prio,
+	VkDeviceQueueCreateInfo qinfos[2] = {
+		{
+			.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			.queueFamilyIndex = dev->queue_family,
+			.queueCount = 1,
+			.pQueuePriorities = &prio,
+		},
+		{
+			.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			.queueFamilyIndex = dev->transfer_queue_family,
+			.queueCount = 1,
+			.pQueuePriorities = &prio,
+		},
 	};
+	VkDeviceQueueCreateInfo *qinfo = &qinfos[0];
+	uint32_t qinfos_len =
+		dev->transfer_queue_family != VK_QUEUE_FAMILY_IGNORED ? 2 : 1;
 
 	VkDeviceQueueGlobalPriorityCreateInfoKHR global_priority;
 	bool has_global_priority = check_extension(avail_ext_props, avail_extc,
@@ -573,7 +653,7 @@ struct wlr_vk_device *vulkan_device_create(struct wlr_vk_instance *ini,
 			.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_GLOBAL_PRIORITY_CREATE_INFO_KHR,
 			.globalPriority = VK_QUEUE_GLOBAL_PRIORITY_HIGH_KHR,
 		};
-		qinfo.pNext = &global_priority;
+		qinfo->pNext = &global_priority;
 		extensions[extensions_len++] = VK_KHR_GLOBAL_PRIORITY_EXTENSION_NAME;
 		wlr_log(WLR_DEBUG, "Requesting a high-priority device queue");
 	} else {
@@ -585,6 +665,17 @@ struct wlr_vk_device *vulkan_device_create(struct wlr_vk_instance *ini,
 		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES,
 		.samplerYcbcrConversion = dev->sampler_ycbcr_conversion,
 	};
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+		.runtimeDescriptorArray = VK_TRUE,
+		.shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+		.descriptorBindingPartiallyBound = VK_TRUE,
+		.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+		.descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+	};
+	if (dev->descriptor_indexing) {
+		sampler_ycbcr_features.pNext = &indexing_features;
+	}
 	VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features = {
 		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
 		.pNext = &sampler_ycbcr_features,
@@ -598,8 +689,8 @@ struct wlr_vk_device *vulkan_device_create(struct wlr_vk_instance *ini,
 	VkDeviceCreateInfo dev_info = {
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
 		.pNext = &timeline_features,
-		.queueCreateInfoCount = 1u,
-		.pQueueCreateInfos = &qinfo,
+		.queueCreateInfoCount = qinfos_len,
+		.pQueueCreateInfos = qinfos,
 		.enabledExtensionCount = extensions_len,
 		.ppEnabledExtensionNames = extensions,
 	};
@@ -613,7 +704,7 @@ struct wlr_vk_device *vulkan_device_create(struct wlr_vk_instance *ini,
 		// Try to recover from the driver denying a global priority queue
 		wlr_log(WLR_DEBUG, "Failed to obtain a high-priority device queue, "
 			"falling back to regular queue priority");
-		qinfo.pNext = NULL;
+		qinfo->pNext = NULL;
 		res = vkCreateDevice(phdev, &dev_info, NULL, &dev->dev);
 	}
 
@@ -623,6 +714,10 @@ struct wlr_vk_device *vulkan_device_create(struct wlr_vk_instance *ini,
 	}
 
 	vkGetDeviceQueue(dev->dev, dev->queue_family, 0, &dev->queue);
+	if (dev->transfer_queue_family != VK_QUEUE_FAMILY_IGNORED) {
+		vkGetDeviceQueue(dev->dev, dev->transfer_queue_family, 0,
+			&dev->transfer_queue);
+	}
 
 	load_device_proc(dev, "vkGetMemoryFdPropertiesKHR",
 		&dev->api.vkGetMemoryFdPropertiesKHR);
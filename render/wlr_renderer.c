@@ -302,6 +302,11 @@ int wlr_renderer_get_drm_fd(struct wlr_renderer *r) {
 	return r->impl->get_drm_fd(r);
 }
 
+void wlr_renderer_get_memory_usage(struct wlr_renderer *r,
+		struct wlr_renderer_memory_usage *usage) {
+	*usage = r->memory_usage;
+}
+
 struct wlr_render_pass *wlr_renderer_begin_buffer_pass(struct wlr_renderer *renderer,
 		struct wlr_buffer *buffer, const struct wlr_buffer_pass_options *options) {
 	struct wlr_buffer_pass_options default_options = {0};
@@ -309,7 +314,18 @@ struct wlr_render_pass *wlr_renderer_begin_buffer_pass(struct wlr_renderer *rend
 		options = &default_options;
 	}
 
-	return renderer->impl->begin_buffer_pass(renderer, buffer, options);
+	struct wlr_render_pass *pass =
+		renderer->impl->begin_buffer_pass(renderer, buffer, options);
+	if (pass == NULL || !options->cull_occluded) {
+		return pass;
+	}
+
+	struct wlr_render_pass *deferred = deferred_render_pass_create(pass, buffer);
+	if (deferred == NULL) {
+		// Render without culling rather than not at all
+		return pass;
+	}
+	return deferred;
 }
 
 struct wlr_render_timer *wlr_render_timer_create(struct wlr_renderer *renderer) {
@@ -332,3 +348,11 @@ void wlr_render_timer_destroy(struct wlr_render_timer *timer) {
 	}
 	timer->impl->destroy(timer);
 }
+
+void renderer_prepare_render_format(struct wlr_renderer *renderer,
+		uint32_t format) {
+	if (!renderer->impl->prepare_render_format) {
+		return;
+	}
+	renderer->impl->prepare_render_format(renderer, format);
+}
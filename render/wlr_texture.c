@@ -6,6 +6,7 @@
 #include <wlr/render/interface.h>
 #include <wlr/render/wlr_texture.h>
 #include "render/pixel_format.h"
+#include "render/wlr_renderer.h"
 #include "types/wlr_buffer.h"
 
 void wlr_texture_init(struct wlr_texture *texture, struct wlr_renderer *renderer,
@@ -70,6 +71,63 @@ uint32_t wlr_texture_preferred_read_format(struct wlr_texture *texture) {
 	return texture->impl->preferred_read_format(texture);
 }
 
+size_t wlr_texture_get_memory_usage(struct wlr_texture *texture) {
+	return texture->memory_usage;
+}
+
+void texture_set_memory_usage(struct wlr_texture *texture, size_t size,
+		bool imported) {
+	struct wlr_renderer_memory_usage *usage = &texture->renderer->memory_usage;
+	if (texture->memory_imported) {
+		usage->imported_textures -= texture->memory_usage;
+	} else {
+		usage->textures -= texture->memory_usage;
+	}
+
+	texture->memory_usage = size;
+	texture->memory_imported = imported;
+	if (imported) {
+		usage->imported_textures += size;
+	} else {
+		usage->textures += size;
+	}
+}
+
+void wlr_texture_readback_init(struct wlr_texture_readback *readback,
+		const struct wlr_texture_readback_impl *impl) {
+	assert(impl->copy && impl->destroy);
+
+	*readback = (struct wlr_texture_readback){
+		.impl = impl,
+	};
+	wl_signal_init(&readback->events.ready);
+}
+
+struct wlr_texture_readback *wlr_texture_read_pixels_async(
+		struct wlr_texture *texture,
+		const struct wlr_texture_read_pixels_options *options,
+		struct wl_event_loop *loop) {
+	if (!texture->impl->read_pixels_async) {
+		return NULL;
+	}
+
+	return texture->impl->read_pixels_async(texture, options, loop);
+}
+
+bool wlr_texture_readback_copy(struct wlr_texture_readback *readback,
+		void *data, uint32_t stride) {
+	return readback->impl->copy(readback, data, stride);
+}
+
+void wlr_texture_readback_destroy(struct wlr_texture_readback *readback) {
+	if (readback == NULL) {
+		return;
+	}
+
+	assert(wl_list_empty(&readback->events.ready.listener_list));
+	readback->impl->destroy(readback);
+}
+
 struct wlr_texture *wlr_texture_from_pixels(struct wlr_renderer *renderer,
 		uint32_t fmt, uint32_t stride, uint32_t width, uint32_t height,
 		const void *data) {
@@ -119,6 +177,29 @@ struct wlr_texture *wlr_texture_from_buffer(struct wlr_renderer *renderer,
 	return renderer->impl->texture_from_buffer(renderer, buffer);
 }
 
+struct wlr_texture *renderer_texture_from_buffer_cropped(
+		struct wlr_renderer *renderer, struct wlr_buffer *buffer,
+		const struct wlr_box *box) {
+	assert(box->x >= 0 && box->y >= 0 && box->width > 0 && box->height > 0 &&
+		box->x + box->width <= buffer->width &&
+		box->y + box->height <= buffer->height);
+	if (!renderer->impl->texture_from_buffer_cropped) {
+		return wlr_texture_from_buffer(renderer, buffer);
+	}
+	return renderer->impl->texture_from_buffer_cropped(renderer, buffer, box);
+}
+
+bool texture_contains_box(const struct wlr_texture *texture,
+		const struct wlr_fbox *box) {
+	const struct wlr_box *crop = &texture->crop;
+	if (wlr_box_empty(crop)) {
+		return true;
+	}
+	return box->x >= crop->x && box->y >= crop->y &&
+		box->x + box->width <= crop->x + crop->width &&
+		box->y + box->height <= crop->y + crop->height;
+}
+
 bool wlr_texture_update_from_buffer(struct wlr_texture *texture,
 		struct wlr_buffer *buffer, const pixman_region32_t *damage) {
 	if (!texture->impl->update_from_buffer) {
@@ -3,6 +3,7 @@
 #include <wlr/interfaces/wlr_buffer.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/util/log.h>
+#include "render/wlr_renderer.h"
 #include "types/wlr_buffer.h"
 
 static const struct wlr_buffer_impl client_buffer_impl;
@@ -27,6 +28,12 @@ static void client_buffer_destroy(struct wlr_buffer *buffer) {
 
 	wlr_buffer_finish(buffer);
 
+	if (client_buffer->texture_evicted) {
+		wlr_buffer_unlock(client_buffer->source);
+	}
+	if (!wlr_box_empty(&client_buffer->crop)) {
+		wlr_buffer_unlock(client_buffer->source);
+	}
 	wl_list_remove(&client_buffer->source_destroy.link);
 	wl_list_remove(&client_buffer->renderer_destroy.link);
 	wlr_texture_destroy(client_buffer->texture);
@@ -65,11 +72,29 @@ static void client_buffer_handle_renderer_destroy(struct wl_listener *listener,
 	wl_list_remove(&client_buffer->renderer_destroy.link);
 	wl_list_init(&client_buffer->renderer_destroy.link);
 	client_buffer->texture = NULL;
+	client_buffer->renderer = NULL;
+
+	if (client_buffer->texture_evicted) {
+		client_buffer->texture_evicted = false;
+		wlr_buffer_unlock(client_buffer->source);
+	}
+	if (!wlr_box_empty(&client_buffer->crop)) {
+		client_buffer->crop = (struct wlr_box){0};
+		wlr_buffer_unlock(client_buffer->source);
+	}
 }
 
-struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
-		struct wlr_renderer *renderer) {
-	struct wlr_texture *texture = wlr_texture_from_buffer(renderer, buffer);
+static struct wlr_texture *texture_from_buffer(struct wlr_renderer *renderer,
+		struct wlr_buffer *buffer, const struct wlr_box *crop) {
+	if (wlr_box_empty(crop)) {
+		return wlr_texture_from_buffer(renderer, buffer);
+	}
+	return renderer_texture_from_buffer_cropped(renderer, buffer, crop);
+}
+
+struct wlr_client_buffer *client_buffer_create_cropped(struct wlr_buffer *buffer,
+		struct wlr_renderer *renderer, const struct wlr_box *crop) {
+	struct wlr_texture *texture = texture_from_buffer(renderer, buffer, crop);
 	if (texture == NULL) {
 		wlr_log(WLR_ERROR, "Failed to create texture");
 		return NULL;
@@ -84,6 +109,8 @@ struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
 		texture->width, texture->height);
 	client_buffer->source = buffer;
 	client_buffer->texture = texture;
+	client_buffer->renderer = renderer;
+	client_buffer->crop = texture->crop;
 
 	wl_signal_add(&buffer->events.destroy, &client_buffer->source_destroy);
 	client_buffer->source_destroy.notify = client_buffer_handle_source_destroy;
@@ -91,6 +118,10 @@ struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
 	wl_signal_add(&texture->renderer->events.destroy, &client_buffer->renderer_destroy);
 	client_buffer->renderer_destroy.notify = client_buffer_handle_renderer_destroy;
 
+	if (!wlr_box_empty(&client_buffer->crop)) {
+		wlr_buffer_lock(buffer);
+	}
+
 	// Ensure the buffer will be released before being destroyed
 	wlr_buffer_lock(&client_buffer->base);
 	wlr_buffer_drop(&client_buffer->base);
@@ -98,6 +129,11 @@ struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
 	return client_buffer;
 }
 
+struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
+		struct wlr_renderer *renderer) {
+	return client_buffer_create_cropped(buffer, renderer, &(struct wlr_box){0});
+}
+
 bool wlr_client_buffer_apply_damage(struct wlr_client_buffer *client_buffer,
 		struct wlr_buffer *next, const pixman_region32_t *damage) {
 	if (client_buffer->base.n_locks - client_buffer->n_ignore_locks > 1) {
@@ -108,5 +144,49 @@ bool wlr_client_buffer_apply_damage(struct wlr_client_buffer *client_buffer,
 		return false;
 	}
 
-	return wlr_texture_update_from_buffer(client_buffer->texture, next, damage);
+	if (!wlr_texture_update_from_buffer(client_buffer->texture, next, damage)) {
+		return false;
+	}
+
+	if (!wlr_box_empty(&client_buffer->crop) && next != client_buffer->source) {
+		// Keep the buffer holding the texture contents locked instead
+		wlr_buffer_lock(next);
+		wl_list_remove(&client_buffer->source_destroy.link);
+		wl_signal_add(&next->events.destroy, &client_buffer->source_destroy);
+		struct wlr_buffer *prev = client_buffer->source;
+		client_buffer->source = next;
+		wlr_buffer_unlock(prev);
+	}
+	return true;
+}
+
+bool client_buffer_evict_texture(struct wlr_client_buffer *client_buffer) {
+	if (client_buffer->texture == NULL || client_buffer->source == NULL ||
+			client_buffer->source->n_locks == 0) {
+		return false;
+	}
+	// Cropped textures are small, and uploaded again when the crop moves
+	if (!wlr_box_empty(&client_buffer->crop)) {
+		return false;
+	}
+
+	wlr_buffer_lock(client_buffer->source);
+	client_buffer->texture_evicted = true;
+	wlr_texture_destroy(client_buffer->texture);
+	client_buffer->texture = NULL;
+	return true;
+}
+
+struct wlr_texture *client_buffer_get_texture(struct wlr_client_buffer *client_buffer) {
+	if (client_buffer->texture_evicted) {
+		client_buffer->texture_evicted = false;
+		client_buffer->texture = wlr_texture_from_buffer(client_buffer->renderer,
+			client_buffer->source);
+		if (client_buffer->texture == NULL) {
+			wlr_log(WLR_ERROR, "Failed to upload evicted buffer");
+		}
+		// May release the source
+		wlr_buffer_unlock(client_buffer->source);
+	}
+	return client_buffer->texture;
 }
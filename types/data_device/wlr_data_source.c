@@ -19,10 +19,15 @@ void wlr_data_source_init(struct wlr_data_source *source,
 	};
 	wl_array_init(&source->mime_types);
 	wl_signal_init(&source->events.destroy);
+	wl_list_init(&source->cache_entries);
 }
 
 void wlr_data_source_send(struct wlr_data_source *source, const char *mime_type,
 		int32_t fd) {
+	if (source->cache_event_loop != NULL) {
+		data_source_cache_send(source, mime_type, fd);
+		return;
+	}
 	source->impl->send(source, mime_type, fd);
 }
 
@@ -41,6 +46,8 @@ void wlr_data_source_destroy(struct wlr_data_source *source) {
 
 	wl_signal_emit_mutable(&source->events.destroy, source);
 
+	data_source_cache_finish(source);
+
 	char **p;
 	wl_array_for_each(p, &source->mime_types) {
 		free(*p);
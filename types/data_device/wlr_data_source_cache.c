@@ -0,0 +1,300 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_data_device.h>
+#include <wlr/util/log.h>
+#include "types/wlr_data_device.h"
+
+enum cache_entry_state {
+	CACHE_ENTRY_LOADING,
+	CACHE_ENTRY_READY,
+	// The data exceeded the size limit or couldn't be read
+	CACHE_ENTRY_UNCACHEABLE,
+};
+
+struct cache_entry {
+	struct wlr_data_source *source;
+	struct wl_list link; // wlr_data_source.cache_entries
+	char *mime_type;
+
+	enum cache_entry_state state;
+	struct wl_array data;
+
+	// Only while loading
+	int read_fd;
+	struct wl_event_source *read_source;
+	struct wl_array waiting_fds; // int32_t
+
+	struct wl_list writers; // cache_writer.link
+};
+
+struct cache_writer {
+	struct cache_entry *entry;
+	struct wl_list link; // cache_entry.writers
+	int fd;
+	size_t offset;
+	struct wl_event_source *event_source;
+};
+
+static void writer_destroy(struct cache_writer *writer) {
+	wl_event_source_remove(writer->event_source);
+	close(writer->fd);
+	wl_list_remove(&writer->link);
+	free(writer);
+}
+
+static int writer_handle_writable(int fd, uint32_t mask, void *data) {
+	struct cache_writer *writer = data;
+	struct cache_entry *entry = writer->entry;
+
+	if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+		writer_destroy(writer);
+		return 0;
+	}
+
+	ssize_t len = write(fd, (char *)entry->data.data + writer->offset,
+		entry->data.size - writer->offset);
+	if (len == -1) {
+		if (errno != EAGAIN) {
+			wlr_log_errno(WLR_DEBUG, "write error to target fd %d", fd);
+			writer_destroy(writer);
+		}
+		return 0;
+	}
+
+	writer->offset += len;
+	if (writer->offset == entry->data.size) {
+		writer_destroy(writer);
+	}
+	return 0;
+}
+
+static void entry_start_writer(struct cache_entry *entry, int fd) {
+	if (entry->data.size == 0) {
+		close(fd);
+		return;
+	}
+
+	struct cache_writer *writer = calloc(1, sizeof(*writer));
+	if (writer == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		close(fd);
+		return;
+	}
+
+	int flags = fcntl(fd, F_GETFL);
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		wlr_log_errno(WLR_ERROR, "fcntl() failed");
+		free(writer);
+		close(fd);
+		return;
+	}
+
+	writer->event_source = wl_event_loop_add_fd(entry->source->cache_event_loop,
+		fd, WL_EVENT_WRITABLE, writer_handle_writable, writer);
+	if (writer->event_source == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add writable fd to event loop");
+		free(writer);
+		close(fd);
+		return;
+	}
+
+	writer->entry = entry;
+	writer->fd = fd;
+	wl_list_insert(&entry->writers, &writer->link);
+}
+
+static void entry_stop_reading(struct cache_entry *entry) {
+	if (entry->read_source == NULL) {
+		return;
+	}
+	wl_event_source_remove(entry->read_source);
+	entry->read_source = NULL;
+	close(entry->read_fd);
+	entry->read_fd = -1;
+}
+
+static void entry_set_ready(struct cache_entry *entry) {
+	entry_stop_reading(entry);
+	entry->state = CACHE_ENTRY_READY;
+
+	int32_t *fd;
+	wl_array_for_each(fd, &entry->waiting_fds) {
+		entry_start_writer(entry, *fd);
+	}
+	wl_array_release(&entry->waiting_fds);
+	wl_array_init(&entry->waiting_fds);
+}
+
+static void entry_set_uncacheable(struct cache_entry *entry) {
+	entry_stop_reading(entry);
+	entry->state = CACHE_ENTRY_UNCACHEABLE;
+	wl_array_release(&entry->data);
+	wl_array_init(&entry->data);
+
+	// Let the source serve each reader itself
+	struct wlr_data_source *source = entry->source;
+	int32_t *fd;
+	wl_array_for_each(fd, &entry->waiting_fds) {
+		source->impl->send(source, entry->mime_type, *fd);
+	}
+	wl_array_release(&entry->waiting_fds);
+	wl_array_init(&entry->waiting_fds);
+}
+
+static int entry_handle_readable(int fd, uint32_t mask, void *data) {
+	struct cache_entry *entry = data;
+	size_t max_size = entry->source->cache_max_size;
+
+	while (true) {
+		char buf[4096];
+		ssize_t len = read(fd, buf, sizeof(buf));
+		if (len == -1) {
+			if (errno == EAGAIN) {
+				return 0;
+			}
+			wlr_log_errno(WLR_DEBUG, "read error from source fd %d", fd);
+			entry_set_uncacheable(entry);
+			return 0;
+		} else if (len == 0) {
+			entry_set_ready(entry);
+			return 0;
+		}
+
+		if (entry->data.size + len > max_size) {
+			wlr_log(WLR_DEBUG, "Selection data for MIME type %s exceeds "
+				"the cache size limit", entry->mime_type);
+			entry_set_uncacheable(entry);
+			return 0;
+		}
+
+		void *dst = wl_array_add(&entry->data, len);
+		if (dst == NULL) {
+			wlr_log(WLR_ERROR, "Allocation failed");
+			entry_set_uncacheable(entry);
+			return 0;
+		}
+		memcpy(dst, buf, len);
+	}
+}
+
+static struct cache_entry *entry_create(struct wlr_data_source *source,
+		const char *mime_type) {
+	struct cache_entry *entry = calloc(1, sizeof(*entry));
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	entry->mime_type = strdup(mime_type);
+	if (entry->mime_type == NULL) {
+		free(entry);
+		return NULL;
+	}
+
+	int p[2];
+	if (pipe(p) == -1) {
+		wlr_log_errno(WLR_ERROR, "pipe() failed");
+		free(entry->mime_type);
+		free(entry);
+		return NULL;
+	}
+
+	fcntl(p[0], F_SETFD, FD_CLOEXEC);
+	fcntl(p[0], F_SETFL, O_NONBLOCK);
+	fcntl(p[1], F_SETFD, FD_CLOEXEC);
+
+	entry->read_source = wl_event_loop_add_fd(source->cache_event_loop, p[0],
+		WL_EVENT_READABLE, entry_handle_readable, entry);
+	if (entry->read_source == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add readable fd to event loop");
+		close(p[0]);
+		close(p[1]);
+		free(entry->mime_type);
+		free(entry);
+		return NULL;
+	}
+
+	entry->source = source;
+	entry->state = CACHE_ENTRY_LOADING;
+	entry->read_fd = p[0];
+	wl_array_init(&entry->data);
+	wl_array_init(&entry->waiting_fds);
+	wl_list_init(&entry->writers);
+	wl_list_insert(&source->cache_entries, &entry->link);
+
+	source->impl->send(source, mime_type, p[1]);
+	return entry;
+}
+
+static void entry_destroy(struct cache_entry *entry) {
+	entry_stop_reading(entry);
+
+	int32_t *fd;
+	wl_array_for_each(fd, &entry->waiting_fds) {
+		close(*fd);
+	}
+	wl_array_release(&entry->waiting_fds);
+
+	struct cache_writer *writer, *tmp;
+	wl_list_for_each_safe(writer, tmp, &entry->writers, link) {
+		writer_destroy(writer);
+	}
+
+	wl_array_release(&entry->data);
+	wl_list_remove(&entry->link);
+	free(entry->mime_type);
+	free(entry);
+}
+
+void data_source_cache_send(struct wlr_data_source *source,
+		const char *mime_type, int32_t fd) {
+	struct cache_entry *entry = NULL, *iter;
+	wl_list_for_each(iter, &source->cache_entries, link) {
+		if (strcmp(iter->mime_type, mime_type) == 0) {
+			entry = iter;
+			break;
+		}
+	}
+
+	if (entry == NULL) {
+		entry = entry_create(source, mime_type);
+		if (entry == NULL) {
+			source->impl->send(source, mime_type, fd);
+			return;
+		}
+	}
+
+	switch (entry->state) {
+	case CACHE_ENTRY_LOADING:;
+		int32_t *waiting_fd = wl_array_add(&entry->waiting_fds, sizeof(*waiting_fd));
+		if (waiting_fd == NULL) {
+			wlr_log(WLR_ERROR, "Allocation failed");
+			close(fd);
+			return;
+		}
+		*waiting_fd = fd;
+		break;
+	case CACHE_ENTRY_READY:
+		entry_start_writer(entry, fd);
+		break;
+	case CACHE_ENTRY_UNCACHEABLE:
+		source->impl->send(source, mime_type, fd);
+		break;
+	}
+}
+
+void data_source_cache_finish(struct wlr_data_source *source) {
+	struct cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &source->cache_entries, link) {
+		entry_destroy(entry);
+	}
+}
+
+void wlr_data_source_enable_cache(struct wlr_data_source *source,
+		struct wl_event_loop *event_loop, size_t max_size) {
+	source->cache_event_loop = event_loop;
+	source->cache_max_size = max_size;
+}
@@ -0,0 +1,149 @@
+#include <assert.h>
+#include <drm_fourcc.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <wlr/interfaces/wlr_ext_image_capture_source_v1.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/swapchain.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/util/log.h>
+#include "ext-image-capture-source-v1-protocol.h"
+
+static void source_handle_destroy(struct wl_client *client,
+		struct wl_resource *source_resource) {
+	wl_resource_destroy(source_resource);
+}
+
+static const struct ext_image_capture_source_v1_interface source_impl = {
+	.destroy = source_handle_destroy,
+};
+
+struct wlr_ext_image_capture_source_v1 *wlr_ext_image_capture_source_v1_from_resource(
+		struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource,
+		&ext_image_capture_source_v1_interface, &source_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+static void source_handle_resource_destroy(struct wl_resource *resource) {
+	wl_list_remove(wl_resource_get_link(resource));
+}
+
+void wlr_ext_image_capture_source_v1_init(struct wlr_ext_image_capture_source_v1 *source,
+		const struct wlr_ext_image_capture_source_v1_interface *impl) {
+	assert(impl->start && impl->stop && impl->schedule_frame && impl->copy_frame);
+
+	*source = (struct wlr_ext_image_capture_source_v1){
+		.impl = impl,
+	};
+	wl_list_init(&source->resources);
+	wl_signal_init(&source->events.constraints_update);
+	wl_signal_init(&source->events.frame);
+	wl_signal_init(&source->events.destroy);
+}
+
+void wlr_ext_image_capture_source_v1_finish(struct wlr_ext_image_capture_source_v1 *source) {
+	wl_signal_emit_mutable(&source->events.destroy, NULL);
+
+	assert(wl_list_empty(&source->events.constraints_update.listener_list));
+	assert(wl_list_empty(&source->events.frame.listener_list));
+	assert(wl_list_empty(&source->events.destroy.listener_list));
+
+	struct wl_resource *resource, *tmp;
+	wl_resource_for_each_safe(resource, tmp, &source->resources) {
+		wl_resource_set_user_data(resource, NULL);
+		wl_list_remove(wl_resource_get_link(resource));
+		wl_list_init(wl_resource_get_link(resource));
+	}
+
+	free(source->shm_formats);
+	wlr_drm_format_set_finish(&source->dmabuf_formats);
+}
+
+bool wlr_ext_image_capture_source_v1_create_resource(struct wlr_ext_image_capture_source_v1 *source,
+		struct wl_client *client, uint32_t new_id) {
+	struct wl_resource *resource = wl_resource_create(client,
+		&ext_image_capture_source_v1_interface, 1, new_id);
+	if (resource == NULL) {
+		wl_client_post_no_memory(client);
+		return false;
+	}
+	wl_resource_set_implementation(resource, &source_impl, source,
+		source_handle_resource_destroy);
+	if (source != NULL) {
+		wl_list_insert(&source->resources, wl_resource_get_link(resource));
+	} else {
+		wl_list_init(wl_resource_get_link(resource));
+	}
+	return true;
+}
+
+bool wlr_ext_image_capture_source_v1_set_constraints_from_swapchain(
+		struct wlr_ext_image_capture_source_v1 *source,
+		struct wlr_swapchain *swapchain, struct wlr_renderer *renderer) {
+	source->width = swapchain->width;
+	source->height = swapchain->height;
+
+	// Shared memory buffers are filled by reading pixels back, only offer
+	// the format the renderer reads fastest
+	uint32_t shm_format = DRM_FORMAT_INVALID;
+	struct wlr_buffer *buffer = wlr_swapchain_acquire(swapchain);
+	if (buffer != NULL) {
+		struct wlr_texture *texture = wlr_texture_from_buffer(renderer, buffer);
+		wlr_buffer_unlock(buffer);
+		if (texture != NULL) {
+			shm_format = wlr_texture_preferred_read_format(texture);
+			wlr_texture_destroy(texture);
+		}
+	}
+
+	free(source->shm_formats);
+	source->shm_formats = NULL;
+	source->shm_formats_len = 0;
+	if (shm_format != DRM_FORMAT_INVALID) {
+		source->shm_formats = malloc(sizeof(source->shm_formats[0]));
+		if (source->shm_formats == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			return false;
+		}
+		source->shm_formats[0] = shm_format;
+		source->shm_formats_len = 1;
+	}
+
+	wlr_drm_format_set_finish(&source->dmabuf_formats);
+	source->dmabuf_formats = (struct wlr_drm_format_set){0};
+	source->dmabuf_device = 0;
+
+	int drm_fd = wlr_renderer_get_drm_fd(renderer);
+	struct stat dev_stat;
+	if (swapchain->allocator != NULL &&
+			(swapchain->allocator->buffer_caps & WLR_BUFFER_CAP_DMABUF) &&
+			drm_fd >= 0 && fstat(drm_fd, &dev_stat) == 0) {
+		source->dmabuf_device = dev_stat.st_rdev;
+
+		const struct wlr_drm_format *format = &swapchain->format;
+		for (size_t i = 0; i < format->len; i++) {
+			if (!wlr_drm_format_set_add(&source->dmabuf_formats,
+					format->format, format->modifiers[i])) {
+				wlr_log(WLR_ERROR, "Failed to add DMA-BUF format");
+				return false;
+			}
+		}
+	}
+
+	wl_signal_emit_mutable(&source->events.constraints_update, NULL);
+	return true;
+}
+
+void wlr_ext_image_capture_source_v1_cursor_init(struct wlr_ext_image_capture_source_v1_cursor *cursor,
+		const struct wlr_ext_image_capture_source_v1_interface *impl) {
+	*cursor = (struct wlr_ext_image_capture_source_v1_cursor){0};
+	wlr_ext_image_capture_source_v1_init(&cursor->base, impl);
+	wl_signal_init(&cursor->events.update);
+}
+
+void wlr_ext_image_capture_source_v1_cursor_finish(struct wlr_ext_image_capture_source_v1_cursor *cursor) {
+	wlr_ext_image_capture_source_v1_finish(&cursor->base);
+	assert(wl_list_empty(&cursor->events.update.listener_list));
+}
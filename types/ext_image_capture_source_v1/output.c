@@ -0,0 +1,505 @@
+#include <assert.h>
+#include <drm_fourcc.h>
+#include <stdlib.h>
+#include <wlr/interfaces/wlr_ext_image_capture_source_v1.h>
+#include <wlr/interfaces/wlr_output.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/pass.h>
+#include <wlr/render/swapchain.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_ext_image_copy_capture_v1.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/addon.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+#include <wlr/util/transform.h>
+#include "ext-image-capture-source-v1-protocol.h"
+#include "render/wlr_renderer.h"
+
+#define OUTPUT_IMAGE_SOURCE_MANAGER_V1_VERSION 1
+
+struct output_cursor_source {
+	struct wlr_ext_image_capture_source_v1_cursor base;
+	struct wlr_output *output;
+
+	// Cursor displayed on the output, and the image_seq of its last
+	// rendered image
+	struct wlr_output_cursor *output_cursor;
+	uint32_t image_seq;
+
+	struct wlr_swapchain *swapchain;
+	struct wlr_buffer *buffer; // last rendered cursor image
+
+	struct wl_event_source *idle_frame;
+};
+
+struct output_source {
+	struct wlr_ext_image_capture_source_v1 base;
+	struct wlr_output *output;
+	struct wlr_addon addon;
+
+	// Sessions asking for cursors to be painted in the frames
+	int num_with_cursors;
+	// Commit being emitted by events.frame
+	const struct wlr_output_event_commit *commit_event;
+
+	struct output_cursor_source cursor;
+
+	struct wl_listener output_commit;
+	struct wl_listener output_cursor_update;
+};
+
+static const struct wlr_ext_image_capture_source_v1_interface output_cursor_source_impl;
+
+static void output_source_start(struct wlr_ext_image_capture_source_v1 *base,
+		bool with_cursors) {
+	struct output_source *source = wl_container_of(base, source, base);
+	if (with_cursors) {
+		// Hardware cursors aren't part of the committed buffers
+		if (source->num_with_cursors == 0) {
+			wlr_output_lock_software_cursors(source->output, true);
+		}
+		source->num_with_cursors++;
+	}
+}
+
+static void output_source_stop(struct wlr_ext_image_capture_source_v1 *base,
+		bool with_cursors) {
+	struct output_source *source = wl_container_of(base, source, base);
+	if (with_cursors) {
+		assert(source->num_with_cursors > 0);
+		source->num_with_cursors--;
+		if (source->num_with_cursors == 0) {
+			wlr_output_lock_software_cursors(source->output, false);
+		}
+	}
+}
+
+static void output_source_schedule_frame(struct wlr_ext_image_capture_source_v1 *base) {
+	struct output_source *source = wl_container_of(base, source, base);
+	wlr_output_update_needs_frame(source->output);
+}
+
+static void output_source_copy_frame(struct wlr_ext_image_capture_source_v1 *base,
+		struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		struct wlr_ext_image_capture_source_v1_frame_event *frame_event) {
+	struct output_source *source = wl_container_of(base, source, base);
+	const struct wlr_output_event_commit *event = source->commit_event;
+	assert(event != NULL);
+
+	struct wlr_output *output = source->output;
+	if (wlr_ext_image_copy_capture_frame_v1_copy_buffer(frame,
+			event->state->buffer, output->renderer)) {
+		wlr_ext_image_copy_capture_frame_v1_ready(frame,
+			output->transform, event->when);
+	} else {
+		wlr_ext_image_copy_capture_frame_v1_fail(frame,
+			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_UNKNOWN);
+	}
+}
+
+static struct wlr_ext_image_capture_source_v1_cursor *output_source_get_pointer_cursor(
+		struct wlr_ext_image_capture_source_v1 *base, struct wlr_seat *seat) {
+	// Output cursors aren't tied to a seat, assume a single cursor per output
+	struct output_source *source = wl_container_of(base, source, base);
+	return &source->cursor.base;
+}
+
+static const struct wlr_ext_image_capture_source_v1_interface output_source_impl = {
+	.start = output_source_start,
+	.stop = output_source_stop,
+	.schedule_frame = output_source_schedule_frame,
+	.copy_frame = output_source_copy_frame,
+	.get_pointer_cursor = output_source_get_pointer_cursor,
+};
+
+static void output_source_update_constraints(struct output_source *source) {
+	struct wlr_output *output = source->output;
+	if (!output->enabled || output->renderer == NULL) {
+		return;
+	}
+	if (!wlr_output_configure_primary_swapchain(output, NULL, &output->swapchain)) {
+		return;
+	}
+	wlr_ext_image_capture_source_v1_set_constraints_from_swapchain(&source->base,
+		output->swapchain, output->renderer);
+}
+
+static struct wlr_output_cursor *output_pick_cursor(struct wlr_output *output) {
+	if (output->hardware_cursor != NULL) {
+		return output->hardware_cursor;
+	}
+	struct wlr_output_cursor *output_cursor;
+	wl_list_for_each(output_cursor, &output->cursors, link) {
+		if (output_cursor->enabled && output_cursor->texture != NULL) {
+			return output_cursor;
+		}
+	}
+	return NULL;
+}
+
+static void cursor_source_emit_frame(struct output_cursor_source *cursor_source,
+		const pixman_region32_t *damage) {
+	struct wlr_ext_image_capture_source_v1_frame_event event = {
+		.damage = damage,
+	};
+	wl_signal_emit_mutable(&cursor_source->base.base.events.frame, &event);
+}
+
+static bool cursor_source_render(struct output_cursor_source *cursor_source,
+		struct wlr_output_cursor *output_cursor, int width, int height) {
+	struct wlr_output *output = cursor_source->output;
+	struct wlr_renderer *renderer = output->renderer;
+	if (renderer == NULL || output->allocator == NULL) {
+		return false;
+	}
+
+	if (cursor_source->swapchain == NULL ||
+			cursor_source->swapchain->width != width ||
+			cursor_source->swapchain->height != height) {
+		const struct wlr_drm_format *format = wlr_drm_format_set_get(
+			wlr_renderer_get_render_formats(renderer), DRM_FORMAT_ARGB8888);
+		if (format == NULL) {
+			wlr_log(WLR_DEBUG, "Renderer doesn't support ARGB8888 for cursor capture");
+			return false;
+		}
+
+		wlr_swapchain_destroy(cursor_source->swapchain);
+		cursor_source->swapchain = wlr_swapchain_create(output->allocator,
+			width, height, format);
+		if (cursor_source->swapchain == NULL) {
+			wlr_log(WLR_ERROR, "Failed to create cursor capture swapchain");
+			return false;
+		}
+
+		wlr_ext_image_capture_source_v1_set_constraints_from_swapchain(
+			&cursor_source->base.base, cursor_source->swapchain, renderer);
+	}
+
+	struct wlr_buffer *buffer = wlr_swapchain_acquire(cursor_source->swapchain);
+	if (buffer == NULL) {
+		return false;
+	}
+
+	struct wlr_render_pass *pass = wlr_renderer_begin_buffer_pass(renderer, buffer, NULL);
+	if (pass == NULL) {
+		wlr_buffer_unlock(buffer);
+		return false;
+	}
+
+	wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
+		.box = { .width = width, .height = height },
+		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+	});
+	wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
+		.texture = output_cursor->texture,
+		.src_box = output_cursor->src_box,
+		.dst_box = { .width = width, .height = height },
+		.transform = output->transform,
+		.wait_timeline = output_cursor->wait_timeline,
+		.wait_point = output_cursor->wait_point,
+	});
+	if (!wlr_render_pass_submit(pass)) {
+		wlr_buffer_unlock(buffer);
+		return false;
+	}
+
+	wlr_buffer_unlock(cursor_source->buffer);
+	cursor_source->buffer = buffer;
+	return true;
+}
+
+static void cursor_source_update(struct output_cursor_source *cursor_source) {
+	struct wlr_output *output = cursor_source->output;
+	struct wlr_ext_image_capture_source_v1_cursor *cursor = &cursor_source->base;
+
+	struct wlr_output_cursor *output_cursor = output_pick_cursor(output);
+	if (output_cursor == NULL || !output_cursor->visible) {
+		if (cursor->entered) {
+			cursor->entered = false;
+			wl_signal_emit_mutable(&cursor->events.update, NULL);
+		}
+		return;
+	}
+
+	// Everything is reported in buffer-local coordinates
+	int output_width, output_height;
+	wlr_output_transformed_resolution(output, &output_width, &output_height);
+	struct wlr_box box = {
+		.x = output_cursor->x - output_cursor->hotspot_x,
+		.y = output_cursor->y - output_cursor->hotspot_y,
+		.width = output_cursor->width,
+		.height = output_cursor->height,
+	};
+	struct wlr_box hotspot = {
+		.x = output_cursor->hotspot_x,
+		.y = output_cursor->hotspot_y,
+	};
+	enum wl_output_transform inv_transform =
+		wlr_output_transform_invert(output->transform);
+	wlr_box_transform(&box, &box, inv_transform, output_width, output_height);
+	wlr_box_transform(&hotspot, &hotspot, inv_transform,
+		output_cursor->width, output_cursor->height);
+	if (box.width <= 0 || box.height <= 0) {
+		return;
+	}
+
+	if (output_cursor != cursor_source->output_cursor ||
+			output_cursor->image_seq != cursor_source->image_seq ||
+			cursor_source->buffer == NULL) {
+		if (!cursor_source_render(cursor_source, output_cursor, box.width, box.height)) {
+			wlr_log(WLR_DEBUG, "Failed to render cursor image for capture");
+			return;
+		}
+		cursor_source->output_cursor = output_cursor;
+		cursor_source->image_seq = output_cursor->image_seq;
+
+		pixman_region32_t damage;
+		pixman_region32_init_rect(&damage, 0, 0, box.width, box.height);
+		cursor_source_emit_frame(cursor_source, &damage);
+		pixman_region32_fini(&damage);
+	}
+
+	cursor->entered = true;
+	cursor->hotspot.x = hotspot.x;
+	cursor->hotspot.y = hotspot.y;
+	cursor->x = box.x + hotspot.x;
+	cursor->y = box.y + hotspot.y;
+	wl_signal_emit_mutable(&cursor->events.update, NULL);
+}
+
+static void cursor_source_start(struct wlr_ext_image_capture_source_v1 *base,
+		bool with_cursors) {
+	// No-op
+}
+
+static void cursor_source_stop(struct wlr_ext_image_capture_source_v1 *base,
+		bool with_cursors) {
+	// No-op
+}
+
+static void cursor_source_handle_idle_frame(void *data) {
+	struct output_cursor_source *cursor_source = data;
+	cursor_source->idle_frame = NULL;
+
+	// The cursor image damage was reported when it changed, this only lets
+	// sessions with pending damage catch up
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	cursor_source_emit_frame(cursor_source, &damage);
+	pixman_region32_fini(&damage);
+}
+
+static void cursor_source_schedule_frame(struct wlr_ext_image_capture_source_v1 *base) {
+	struct output_cursor_source *cursor_source =
+		wl_container_of(base, cursor_source, base.base);
+	if (cursor_source->buffer == NULL || cursor_source->idle_frame != NULL) {
+		return;
+	}
+
+	cursor_source->idle_frame = wl_event_loop_add_idle(cursor_source->output->event_loop,
+		cursor_source_handle_idle_frame, cursor_source);
+}
+
+static void cursor_source_copy_frame(struct wlr_ext_image_capture_source_v1 *base,
+		struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		struct wlr_ext_image_capture_source_v1_frame_event *frame_event) {
+	struct output_cursor_source *cursor_source =
+		wl_container_of(base, cursor_source, base.base);
+	struct wlr_output *output = cursor_source->output;
+
+	if (cursor_source->buffer != NULL &&
+			wlr_ext_image_copy_capture_frame_v1_copy_buffer(frame,
+				cursor_source->buffer, output->renderer)) {
+		wlr_ext_image_copy_capture_frame_v1_ready(frame, output->transform, NULL);
+	} else {
+		wlr_ext_image_copy_capture_frame_v1_fail(frame,
+			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_UNKNOWN);
+	}
+}
+
+static const struct wlr_ext_image_capture_source_v1_interface output_cursor_source_impl = {
+	.start = cursor_source_start,
+	.stop = cursor_source_stop,
+	.schedule_frame = cursor_source_schedule_frame,
+	.copy_frame = cursor_source_copy_frame,
+};
+
+static void output_source_handle_output_cursor_update(struct wl_listener *listener,
+		void *data) {
+	struct output_source *source =
+		wl_container_of(listener, source, output_cursor_update);
+	struct wlr_output_cursor *output_cursor = data;
+	if (output_cursor == source->cursor.output_cursor) {
+		// Don't keep a pointer to a cursor being destroyed, and re-render
+		// its replacement if any
+		source->cursor.output_cursor = NULL;
+	}
+	cursor_source_update(&source->cursor);
+}
+
+static void output_source_handle_output_commit(struct wl_listener *listener,
+		void *data) {
+	struct output_source *source = wl_container_of(listener, source, output_commit);
+	const struct wlr_output_event_commit *event = data;
+	const struct wlr_output_state *state = event->state;
+
+	if (state->committed & (WLR_OUTPUT_STATE_MODE |
+			WLR_OUTPUT_STATE_ENABLED | WLR_OUTPUT_STATE_RENDER_FORMAT)) {
+		output_source_update_constraints(source);
+	}
+	if (state->committed & (WLR_OUTPUT_STATE_SCALE | WLR_OUTPUT_STATE_TRANSFORM)) {
+		// The cursor image is scaled and rotated for the output
+		source->cursor.output_cursor = NULL;
+		cursor_source_update(&source->cursor);
+	}
+
+	if (!(state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		return;
+	}
+
+	struct wlr_buffer *buffer = state->buffer;
+	pixman_region32_t full_damage;
+	pixman_region32_init_rect(&full_damage, 0, 0, buffer->width, buffer->height);
+
+	struct wlr_ext_image_capture_source_v1_frame_event frame_event = {
+		.damage = (state->committed & WLR_OUTPUT_STATE_DAMAGE) ?
+			&state->damage : &full_damage,
+	};
+	source->commit_event = event;
+	wl_signal_emit_mutable(&source->base.events.frame, &frame_event);
+	source->commit_event = NULL;
+
+	pixman_region32_fini(&full_damage);
+}
+
+static void output_source_addon_destroy(struct wlr_addon *addon) {
+	struct output_source *source = wl_container_of(addon, source, addon);
+
+	wlr_ext_image_capture_source_v1_cursor_finish(&source->cursor.base);
+	wlr_ext_image_capture_source_v1_finish(&source->base);
+
+	if (source->num_with_cursors > 0) {
+		wlr_output_lock_software_cursors(source->output, false);
+	}
+	if (source->cursor.idle_frame != NULL) {
+		wl_event_source_remove(source->cursor.idle_frame);
+	}
+	wlr_buffer_unlock(source->cursor.buffer);
+	wlr_swapchain_destroy(source->cursor.swapchain);
+
+	wl_list_remove(&source->output_commit.link);
+	wl_list_remove(&source->output_cursor_update.link);
+	wlr_addon_finish(&source->addon);
+	free(source);
+}
+
+static const struct wlr_addon_interface output_source_addon_impl = {
+	.name = "wlr_ext_output_image_capture_source_v1",
+	.destroy = output_source_addon_destroy,
+};
+
+static struct output_source *output_source_get_or_create(struct wlr_output *output) {
+	struct wlr_addon *addon =
+		wlr_addon_find(&output->addons, NULL, &output_source_addon_impl);
+	if (addon != NULL) {
+		struct output_source *source = wl_container_of(addon, source, addon);
+		return source;
+	}
+
+	struct output_source *source = calloc(1, sizeof(*source));
+	if (source == NULL) {
+		return NULL;
+	}
+
+	wlr_ext_image_capture_source_v1_init(&source->base, &output_source_impl);
+	wlr_ext_image_capture_source_v1_cursor_init(&source->cursor.base,
+		&output_cursor_source_impl);
+	source->output = output;
+	source->cursor.output = output;
+	wlr_addon_init(&source->addon, &output->addons, NULL, &output_source_addon_impl);
+
+	source->output_commit.notify = output_source_handle_output_commit;
+	wl_signal_add(&output->events.commit, &source->output_commit);
+	source->output_cursor_update.notify = output_source_handle_output_cursor_update;
+	wl_signal_add(&output->cursor_update, &source->output_cursor_update);
+
+	output_source_update_constraints(source);
+	cursor_source_update(&source->cursor);
+
+	return source;
+}
+
+static void manager_handle_create_source(struct wl_client *client,
+		struct wl_resource *manager_resource, uint32_t new_id,
+		struct wl_resource *output_resource) {
+	struct wlr_output *output = wlr_output_from_resource(output_resource);
+
+	struct output_source *source = NULL;
+	if (output != NULL) {
+		source = output_source_get_or_create(output);
+		if (source == NULL) {
+			wl_client_post_no_memory(client);
+			return;
+		}
+	}
+
+	wlr_ext_image_capture_source_v1_create_resource(source != NULL ? &source->base : NULL,
+		client, new_id);
+}
+
+static void manager_handle_destroy(struct wl_client *client,
+		struct wl_resource *manager_resource) {
+	wl_resource_destroy(manager_resource);
+}
+
+static const struct ext_output_image_capture_source_manager_v1_interface manager_impl = {
+	.create_source = manager_handle_create_source,
+	.destroy = manager_handle_destroy,
+};
+
+static void manager_bind(struct wl_client *client, void *data,
+		uint32_t version, uint32_t id) {
+	struct wlr_ext_output_image_capture_source_manager_v1 *manager = data;
+
+	struct wl_resource *resource = wl_resource_create(client,
+		&ext_output_image_capture_source_manager_v1_interface, version, id);
+	if (resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &manager_impl, manager, NULL);
+}
+
+static void manager_handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_ext_output_image_capture_source_manager_v1 *manager =
+		wl_container_of(listener, manager, display_destroy);
+	wl_list_remove(&manager->display_destroy.link);
+	wl_global_destroy(manager->global);
+	free(manager);
+}
+
+struct wlr_ext_output_image_capture_source_manager_v1 *wlr_ext_output_image_capture_source_manager_v1_create(
+		struct wl_display *display, uint32_t version) {
+	assert(version <= OUTPUT_IMAGE_SOURCE_MANAGER_V1_VERSION);
+
+	struct wlr_ext_output_image_capture_source_manager_v1 *manager =
+		calloc(1, sizeof(*manager));
+	if (manager == NULL) {
+		return NULL;
+	}
+
+	manager->global = wl_global_create(display,
+		&ext_output_image_capture_source_manager_v1_interface, version,
+		manager, manager_bind);
+	if (manager->global == NULL) {
+		free(manager);
+		return NULL;
+	}
+
+	manager->display_destroy.notify = manager_handle_display_destroy;
+	wl_display_add_destroy_listener(display, &manager->display_destroy);
+
+	return manager;
+}
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <drm_fourcc.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/allocator.h>
 #include <wlr/render/swapchain.h>
@@ -10,9 +11,279 @@
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
 #include <wlr/util/transform.h>
+#include "render/drm_format_set.h"
 #include "types/wlr_buffer.h"
 #include "types/wlr_output.h"
 
+// Large enough to hold all frames of common animated cursors
+#define OUTPUT_CURSOR_CACHE_SIZE 64
+
+struct output_cursor_cache_entry {
+	struct wlr_output *output;
+	struct wlr_buffer *source;
+	struct wlr_texture *texture;
+
+	// Hardware cursor buffer rendered from the texture, NULL if none. The buffer
+	// may be shared with other outputs, each of them holds a lock.
+	struct wlr_buffer *buffer;
+	uint32_t cursor_width, cursor_height;
+	enum wl_output_transform output_transform;
+
+	struct wl_listener source_destroy;
+	struct wl_list link; // wlr_output.cursor_cache
+};
+
+/**
+ * Hardware cursor buffers rendered from a cursor image, attached to the image
+ * buffer. Outputs with the same renderer, allocator, scale and transform reuse
+ * them instead of rendering the image again.
+ */
+struct cursor_buffer_share_set {
+	struct wlr_addon addon;
+	struct wl_list shares; // cursor_buffer_share.link
+};
+
+struct cursor_buffer_share {
+	struct wlr_buffer *buffer; // weak reference
+	struct wlr_renderer *renderer;
+	struct wlr_allocator *allocator;
+	uint32_t cursor_width, cursor_height;
+	enum wl_output_transform output_transform;
+	uint32_t format;
+	bool dmabuf;
+	uint64_t modifier;
+
+	struct wl_listener buffer_destroy;
+	struct wl_list link; // cursor_buffer_share_set.shares
+};
+
+static void cursor_buffer_share_destroy(struct cursor_buffer_share *share) {
+	wl_list_remove(&share->buffer_destroy.link);
+	wl_list_remove(&share->link);
+	free(share);
+}
+
+static void cursor_buffer_share_handle_buffer_destroy(
+		struct wl_listener *listener, void *data) {
+	struct cursor_buffer_share *share =
+		wl_container_of(listener, share, buffer_destroy);
+	cursor_buffer_share_destroy(share);
+}
+
+static void cursor_buffer_share_set_addon_destroy(struct wlr_addon *addon) {
+	struct cursor_buffer_share_set *set = wl_container_of(addon, set, addon);
+	struct cursor_buffer_share *share, *tmp;
+	wl_list_for_each_safe(share, tmp, &set->shares, link) {
+		cursor_buffer_share_destroy(share);
+	}
+	wlr_addon_finish(&set->addon);
+	free(set);
+}
+
+static const struct wlr_addon_interface cursor_buffer_share_set_addon_impl = {
+	.name = "cursor_buffer_share_set",
+	.destroy = cursor_buffer_share_set_addon_destroy,
+};
+
+static struct cursor_buffer_share_set *cursor_buffer_share_set_get(
+		struct wlr_buffer *source, bool create) {
+	struct wlr_addon *addon = wlr_addon_find(&source->addons, NULL,
+		&cursor_buffer_share_set_addon_impl);
+	if (addon != NULL) {
+		struct cursor_buffer_share_set *set = wl_container_of(addon, set, addon);
+		return set;
+	}
+	if (!create) {
+		return NULL;
+	}
+
+	struct cursor_buffer_share_set *set = calloc(1, sizeof(*set));
+	if (set == NULL) {
+		return NULL;
+	}
+	wl_list_init(&set->shares);
+	wlr_addon_init(&set->addon, &source->addons, NULL,
+		&cursor_buffer_share_set_addon_impl);
+	return set;
+}
+
+static struct wlr_buffer *cursor_buffer_share_find(struct wlr_output *output,
+		struct wlr_buffer *source, int width, int height,
+		int cursor_width, int cursor_height) {
+	struct cursor_buffer_share_set *set = cursor_buffer_share_set_get(source, false);
+	if (set == NULL) {
+		return NULL;
+	}
+
+	const struct wlr_drm_format *format = &output->cursor_swapchain->format;
+	struct cursor_buffer_share *share;
+	wl_list_for_each(share, &set->shares, link) {
+		if (share->renderer == output->renderer &&
+				share->allocator == output->allocator &&
+				share->buffer->width == width && share->buffer->height == height &&
+				share->cursor_width == (uint32_t)cursor_width &&
+				share->cursor_height == (uint32_t)cursor_height &&
+				share->output_transform == output->transform &&
+				share->format == format->format &&
+				(!share->dmabuf || wlr_drm_format_has(format, share->modifier))) {
+			return share->buffer;
+		}
+	}
+	return NULL;
+}
+
+static void cursor_buffer_share_add(struct wlr_output *output,
+		struct wlr_buffer *source, struct wlr_buffer *buffer,
+		int cursor_width, int cursor_height) {
+	struct cursor_buffer_share_set *set = cursor_buffer_share_set_get(source, true);
+	if (set == NULL) {
+		return;
+	}
+
+	struct cursor_buffer_share *share = calloc(1, sizeof(*share));
+	if (share == NULL) {
+		return;
+	}
+	share->buffer = buffer;
+	share->renderer = output->renderer;
+	share->allocator = output->allocator;
+	share->cursor_width = cursor_width;
+	share->cursor_height = cursor_height;
+	share->output_transform = output->transform;
+	share->format = output->cursor_swapchain->format.format;
+
+	struct wlr_dmabuf_attributes dmabuf;
+	if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+		share->dmabuf = true;
+		share->modifier = dmabuf.modifier;
+	}
+
+	share->buffer_destroy.notify = cursor_buffer_share_handle_buffer_destroy;
+	wl_signal_add(&buffer->events.destroy, &share->buffer_destroy);
+	wl_list_insert(&set->shares, &share->link);
+}
+
+static bool cache_entry_in_use(struct output_cursor_cache_entry *entry) {
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &entry->output->cursors, link) {
+		if (cursor->texture == entry->texture) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void cache_entry_destroy(struct output_cursor_cache_entry *entry) {
+	struct wlr_texture *texture = entry->texture;
+
+	// Cursors still displaying the image take over the texture. If there are
+	// several of them, the others get their own copy.
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &entry->output->cursors, link) {
+		if (cursor->texture != entry->texture) {
+			continue;
+		}
+		assert(!cursor->own_texture);
+		if (texture != NULL) {
+			texture = NULL;
+		} else {
+			cursor->texture = wlr_texture_from_buffer(entry->output->renderer,
+				entry->source);
+		}
+		cursor->own_texture = true;
+	}
+	wlr_texture_destroy(texture);
+
+	wlr_buffer_unlock(entry->buffer);
+	wl_list_remove(&entry->source_destroy.link);
+	wl_list_remove(&entry->link);
+	free(entry);
+}
+
+void output_clear_cursor_cache(struct wlr_output *output) {
+	struct output_cursor_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &output->cursor_cache, link) {
+		cache_entry_destroy(entry);
+	}
+	wl_list_remove(&output->cursor_cache_renderer_destroy.link);
+	wl_list_init(&output->cursor_cache_renderer_destroy.link);
+}
+
+static void cache_entry_handle_source_destroy(struct wl_listener *listener,
+		void *data) {
+	struct output_cursor_cache_entry *entry =
+		wl_container_of(listener, entry, source_destroy);
+	cache_entry_destroy(entry);
+}
+
+static void output_handle_cursor_cache_renderer_destroy(
+		struct wl_listener *listener, void *data) {
+	struct wlr_output *output =
+		wl_container_of(listener, output, cursor_cache_renderer_destroy);
+	output_clear_cursor_cache(output);
+}
+
+static struct output_cursor_cache_entry *cursor_cache_get(
+		struct wlr_output *output, struct wlr_buffer *source) {
+	struct output_cursor_cache_entry *entry;
+	wl_list_for_each(entry, &output->cursor_cache, link) {
+		if (entry->source == source) {
+			wl_list_remove(&entry->link);
+			wl_list_insert(&output->cursor_cache, &entry->link);
+			return entry;
+		}
+	}
+
+	struct output_cursor_cache_entry *new_entry = calloc(1, sizeof(*new_entry));
+	if (new_entry == NULL) {
+		return NULL;
+	}
+	new_entry->texture = wlr_texture_from_buffer(output->renderer, source);
+	if (new_entry->texture == NULL) {
+		free(new_entry);
+		return NULL;
+	}
+	new_entry->output = output;
+	new_entry->source = source;
+
+	new_entry->source_destroy.notify = cache_entry_handle_source_destroy;
+	wl_signal_add(&source->events.destroy, &new_entry->source_destroy);
+
+	if (wl_list_empty(&output->cursor_cache)) {
+		output->cursor_cache_renderer_destroy.notify =
+			output_handle_cursor_cache_renderer_destroy;
+		wl_signal_add(&output->renderer->events.destroy,
+			&output->cursor_cache_renderer_destroy);
+	}
+	wl_list_insert(&output->cursor_cache, &new_entry->link);
+
+	// Evict the least recently used images which aren't displayed anymore
+	size_t len = wl_list_length(&output->cursor_cache);
+	struct output_cursor_cache_entry *tmp;
+	wl_list_for_each_reverse_safe(entry, tmp, &output->cursor_cache, link) {
+		if (len <= OUTPUT_CURSOR_CACHE_SIZE || entry == new_entry) {
+			break;
+		}
+		if (!cache_entry_in_use(entry)) {
+			cache_entry_destroy(entry);
+			len--;
+		}
+	}
+
+	return new_entry;
+}
+
+static struct output_cursor_cache_entry *cursor_cache_find_texture(
+		struct wlr_output *output, struct wlr_texture *texture) {
+	struct output_cursor_cache_entry *entry;
+	wl_list_for_each(entry, &output->cursor_cache, link) {
+		if (entry->texture == texture) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
 static bool output_set_hardware_cursor(struct wlr_output *output,
 		struct wlr_buffer *buffer, int hotspot_x, int hotspot_y) {
 	if (!output->impl->set_cursor) {
@@ -65,22 +336,106 @@ void wlr_output_lock_software_cursors(struct wlr_output *output, bool lock) {
 	// again.
 }
 
+/**
+ * Returns the box covered by the cursor image and its attachment, relative to
+ * the cursor position and scaled for its output.
+ */
+static void output_cursor_get_local_box(struct wlr_output_cursor *cursor,
+		struct wlr_box *box) {
+	*box = (struct wlr_box){
+		.x = -cursor->hotspot_x,
+		.y = -cursor->hotspot_y,
+		.width = cursor->width,
+		.height = cursor->height,
+	};
+
+	if (cursor->attachment.texture == NULL) {
+		return;
+	}
+
+	struct wlr_box attachment = {
+		.x = cursor->attachment.x,
+		.y = cursor->attachment.y,
+		.width = cursor->attachment.width,
+		.height = cursor->attachment.height,
+	};
+	if (cursor->texture == NULL) {
+		*box = attachment;
+		return;
+	}
+
+	int x1 = box->x < attachment.x ? box->x : attachment.x;
+	int y1 = box->y < attachment.y ? box->y : attachment.y;
+	int x2 = box->x + box->width;
+	if (attachment.x + attachment.width > x2) {
+		x2 = attachment.x + attachment.width;
+	}
+	int y2 = box->y + box->height;
+	if (attachment.y + attachment.height > y2) {
+		y2 = attachment.y + attachment.height;
+	}
+	*box = (struct wlr_box){ .x = x1, .y = y1, .width = x2 - x1, .height = y2 - y1 };
+}
+
 /**
  * Returns the cursor box, scaled for its output.
  */
 static void output_cursor_get_box(struct wlr_output_cursor *cursor,
 		struct wlr_box *box) {
+	output_cursor_get_local_box(cursor, box);
+	box->x = cursor->x + box->x;
+	box->y = cursor->y + box->y;
+}
+
+static void output_cursor_get_image_box(struct wlr_output_cursor *cursor,
+		struct wlr_box *box) {
 	box->x = cursor->x - cursor->hotspot_x;
 	box->y = cursor->y - cursor->hotspot_y;
 	box->width = cursor->width;
 	box->height = cursor->height;
 }
 
-void wlr_output_add_software_cursors_to_render_pass(struct wlr_output *output,
-		struct wlr_render_pass *render_pass, const pixman_region32_t *damage) {
+static void output_cursor_get_attachment_box(struct wlr_output_cursor *cursor,
+		struct wlr_box *box) {
+	box->x = cursor->x + cursor->attachment.x;
+	box->y = cursor->y + cursor->attachment.y;
+	box->width = cursor->attachment.width;
+	box->height = cursor->attachment.height;
+}
+
+static void render_software_cursor_texture(struct wlr_output *output,
+		struct wlr_render_pass *render_pass, const pixman_region32_t *damage,
+		struct wlr_texture *texture, const struct wlr_fbox *src_box,
+		const struct wlr_box *cursor_box, enum wl_output_transform transform) {
 	int width, height;
 	wlr_output_transformed_resolution(output, &width, &height);
 
+	struct wlr_box box;
+	wlr_box_transform(&box, cursor_box,
+		wlr_output_transform_invert(output->transform), width, height);
+
+	pixman_region32_t cursor_damage;
+	pixman_region32_init_rect(&cursor_damage,
+		box.x, box.y, box.width, box.height);
+	if (damage != NULL) {
+		pixman_region32_intersect(&cursor_damage, &cursor_damage, damage);
+	}
+
+	if (pixman_region32_not_empty(&cursor_damage)) {
+		wlr_render_pass_add_texture(render_pass, &(struct wlr_render_texture_options) {
+			.texture = texture,
+			.src_box = *src_box,
+			.dst_box = box,
+			.clip = &cursor_damage,
+			.transform = transform,
+		});
+	}
+
+	pixman_region32_fini(&cursor_damage);
+}
+
+void wlr_output_add_software_cursors_to_render_pass(struct wlr_output *output,
+		struct wlr_render_pass *render_pass, const pixman_region32_t *damage) {
 	struct wlr_output_cursor *cursor;
 	wl_list_for_each(cursor, &output->cursors, link) {
 		if (!cursor->enabled || !cursor->visible ||
@@ -88,37 +443,22 @@ void wlr_output_add_software_cursors_to_render_pass(struct wlr_output *output,
 			continue;
 		}
 
-		struct wlr_texture *texture = cursor->texture;
-		if (texture == NULL) {
-			continue;
-		}
-
 		struct wlr_box box;
-		output_cursor_get_box(cursor, &box);
-		wlr_box_transform(&box, &box,
-			wlr_output_transform_invert(output->transform), width, height);
-
-		pixman_region32_t cursor_damage;
-		pixman_region32_init_rect(&cursor_damage,
-			box.x, box.y, box.width, box.height);
-		if (damage != NULL) {
-			pixman_region32_intersect(&cursor_damage, &cursor_damage, damage);
+		if (cursor->attachment.texture != NULL) {
+			output_cursor_get_attachment_box(cursor, &box);
+			enum wl_output_transform transform = wlr_output_transform_compose(
+				wlr_output_transform_invert(cursor->attachment.transform),
+				output->transform);
+			render_software_cursor_texture(output, render_pass, damage,
+				cursor->attachment.texture, &cursor->attachment.src_box,
+				&box, transform);
 		}
 
-		if (!pixman_region32_not_empty(&cursor_damage)) {
-			pixman_region32_fini(&cursor_damage);
-			continue;
+		if (cursor->texture != NULL) {
+			output_cursor_get_image_box(cursor, &box);
+			render_software_cursor_texture(output, render_pass, damage,
+				cursor->texture, &cursor->src_box, &box, output->transform);
 		}
-
-		wlr_render_pass_add_texture(render_pass, &(struct wlr_render_texture_options) {
-			.texture = texture,
-			.src_box = cursor->src_box,
-			.dst_box = box,
-			.clip = &cursor_damage,
-			.transform = output->transform,
-		});
-
-		pixman_region32_fini(&cursor_damage);
 	}
 }
 
@@ -176,25 +516,28 @@ static bool output_pick_cursor_format(struct wlr_output *output,
 	return output_pick_format(output, display_formats, format, DRM_FORMAT_ARGB8888);
 }
 
-static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor) {
-	struct wlr_output *output = cursor->output;
-
-	struct wlr_texture *texture = cursor->texture;
-	if (texture == NULL) {
-		return NULL;
+/**
+ * Pick the size of the cursor plane buffer for a cursor image of the
+ * specified size, in output-transformed coordinates.
+ */
+static bool output_pick_cursor_buffer_size(struct wlr_output *output,
+		int cursor_width, int cursor_height, int *buffer_width, int *buffer_height) {
+	// Size of the cursor image once transformed for the output buffer. It
+	// doesn't depend on the texture size: with a fractional scale or a client
+	// buffer scale, the texture is scaled on the way to the cursor plane.
+	int width = cursor_width;
+	int height = cursor_height;
+	if (output->transform & WL_OUTPUT_TRANSFORM_90) {
+		width = cursor_height;
+		height = cursor_width;
 	}
-
-	struct wlr_allocator *allocator = output->allocator;
-	struct wlr_renderer *renderer = output->renderer;
-	assert(allocator != NULL && renderer != NULL);
-
-	int width = cursor->width;
-	int height = cursor->height;
+	int image_width = width;
+	int image_height = height;
 	if (output->impl->get_cursor_sizes) {
 		// Apply hardware limitations on buffer size
 		size_t sizes_len = 0;
 		const struct wlr_output_cursor_size *sizes =
-			output->impl->get_cursor_sizes(cursor->output, &sizes_len);
+			output->impl->get_cursor_sizes(output, &sizes_len);
 		if (sizes_len == 0) {
 			wlr_log(WLR_DEBUG, "Hardware cursor not supported");
 			return NULL;
@@ -203,7 +546,7 @@ static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor)
 		bool found = false;
 		for (size_t i = 0; i < sizes_len; i++) {
 			struct wlr_output_cursor_size size = sizes[i];
-			if ((int)texture->width <= size.width && (int)texture->height <= size.height) {
+			if (image_width <= size.width && image_height <= size.height) {
 				width = size.width;
 				height = size.height;
 				found = true;
@@ -212,51 +555,135 @@ static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor)
 		}
 
 		if (!found) {
-			wlr_log(WLR_DEBUG, "Cursor texture too large (%dx%d), "
-				"exceeds hardware limitations", texture->width,
-				texture->height);
-			return NULL;
+			wlr_log(WLR_DEBUG, "Cursor image too large (%dx%d), "
+				"exceeds hardware limitations", image_width, image_height);
+			return false;
 		}
 	}
 
+	*buffer_width = width;
+	*buffer_height = height;
+	return true;
+}
+
+static bool output_ensure_cursor_swapchain(struct wlr_output *output,
+		int width, int height) {
 	if (output->cursor_swapchain == NULL ||
 			output->cursor_swapchain->width != width ||
 			output->cursor_swapchain->height != height) {
 		struct wlr_drm_format format = {0};
 		if (!output_pick_cursor_format(output, &format)) {
 			wlr_log(WLR_DEBUG, "Failed to pick cursor format");
-			return NULL;
+			return false;
 		}
 
 		wlr_swapchain_destroy(output->cursor_swapchain);
-		output->cursor_swapchain = wlr_swapchain_create(allocator,
+		output->cursor_swapchain = wlr_swapchain_create(output->allocator,
 			width, height, &format);
 		wlr_drm_format_finish(&format);
 		if (output->cursor_swapchain == NULL) {
 			wlr_log(WLR_ERROR, "Failed to create cursor swapchain");
-			return NULL;
+			return false;
+		}
+
+		// The cached buffers may not have the new format
+		struct output_cursor_cache_entry *entry;
+		wl_list_for_each(entry, &output->cursor_cache, link) {
+			wlr_buffer_unlock(entry->buffer);
+			entry->buffer = NULL;
 		}
 	}
 
-	struct wlr_buffer *buffer = wlr_swapchain_acquire(output->cursor_swapchain);
+	return true;
+}
+
+/**
+ * Returns the size of a cursor plane buffer in output-transformed
+ * coordinates.
+ */
+static void cursor_buffer_get_transformed_size(struct wlr_output *output,
+		struct wlr_buffer *buffer, int *width, int *height) {
+	*width = buffer->width;
+	*height = buffer->height;
+	if (output->transform & WL_OUTPUT_TRANSFORM_90) {
+		*width = buffer->height;
+		*height = buffer->width;
+	}
+}
+
+/**
+ * Render a cursor texture into a buffer suitable for the output's cursor
+ * plane. The cursor_width and cursor_height are the size of the cursor on the
+ * output, in output-transformed coordinates.
+ */
+static struct wlr_buffer *render_cursor_buffer(struct wlr_output *output,
+		struct wlr_texture *texture, const struct wlr_fbox *src_box,
+		int cursor_width, int cursor_height, enum wl_output_transform cursor_transform,
+		struct wlr_drm_syncobj_timeline *wait_timeline, uint64_t wait_point) {
+	struct wlr_allocator *allocator = output->allocator;
+	struct wlr_renderer *renderer = output->renderer;
+	assert(allocator != NULL && renderer != NULL);
+
+	int width, height;
+	if (!output_pick_cursor_buffer_size(output, cursor_width, cursor_height,
+			&width, &height) ||
+			!output_ensure_cursor_swapchain(output, width, height)) {
+		return NULL;
+	}
+
+	struct output_cursor_cache_entry *entry =
+		cursor_cache_find_texture(output, texture);
+	if (entry != NULL && entry->buffer != NULL &&
+			entry->buffer->width == width && entry->buffer->height == height &&
+			entry->cursor_width == (uint32_t)cursor_width &&
+			entry->cursor_height == (uint32_t)cursor_height &&
+			entry->output_transform == output->transform) {
+		return wlr_buffer_lock(entry->buffer);
+	}
+
+	if (entry != NULL) {
+		// Another output may have rendered the same image already
+		struct wlr_buffer *shared = cursor_buffer_share_find(output,
+			entry->source, width, height, cursor_width, cursor_height);
+		if (shared != NULL) {
+			wlr_buffer_unlock(entry->buffer);
+			entry->buffer = wlr_buffer_lock(shared);
+			entry->cursor_width = cursor_width;
+			entry->cursor_height = cursor_height;
+			entry->output_transform = output->transform;
+			return wlr_buffer_lock(shared);
+		}
+	}
+
+	struct wlr_buffer *buffer;
+	if (entry != NULL) {
+		// Cached buffers are allocated outside of the swapchain, animated
+		// cursors would otherwise hold on to all of its slots
+		buffer = wlr_allocator_create_buffer(allocator, width, height,
+			&output->cursor_swapchain->format);
+	} else {
+		buffer = wlr_swapchain_acquire(output->cursor_swapchain);
+	}
 	if (buffer == NULL) {
 		return NULL;
 	}
 
+	int transformed_width, transformed_height;
+	cursor_buffer_get_transformed_size(output, buffer,
+		&transformed_width, &transformed_height);
 	struct wlr_box dst_box = {
-		.width = cursor->width,
-		.height = cursor->height,
+		.width = cursor_width,
+		.height = cursor_height,
 	};
 	wlr_box_transform(&dst_box, &dst_box, wlr_output_transform_invert(output->transform),
-		buffer->width, buffer->height);
+		transformed_width, transformed_height);
 
 	struct wlr_render_pass *pass = wlr_renderer_begin_buffer_pass(renderer, buffer, NULL);
 	if (pass == NULL) {
-		wlr_buffer_unlock(buffer);
-		return NULL;
+		goto error_buffer;
 	}
 
-	enum wl_output_transform transform = wlr_output_transform_invert(cursor->transform);
+	enum wl_output_transform transform = wlr_output_transform_invert(cursor_transform);
 	transform = wlr_output_transform_compose(transform, output->transform);
 
 	wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
@@ -265,13 +692,128 @@ static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor)
 	});
 	wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
 		.texture = texture,
-		.src_box = cursor->src_box,
+		.src_box = *src_box,
 		.dst_box = dst_box,
 		.transform = transform,
-		.wait_timeline = cursor->wait_timeline,
-		.wait_point = cursor->wait_point,
+		.wait_timeline = wait_timeline,
+		.wait_point = wait_point,
 	});
 
+	if (!wlr_render_pass_submit(pass)) {
+		goto error_buffer;
+	}
+
+	if (entry != NULL) {
+		// The buffer is destroyed once no cache entry holds a lock anymore
+		wlr_buffer_unlock(entry->buffer);
+		entry->buffer = wlr_buffer_lock(buffer);
+		wlr_buffer_drop(buffer);
+		entry->cursor_width = cursor_width;
+		entry->cursor_height = cursor_height;
+		entry->output_transform = output->transform;
+		cursor_buffer_share_add(output, entry->source, buffer,
+			cursor_width, cursor_height);
+		return wlr_buffer_lock(buffer);
+	}
+	return buffer;
+
+error_buffer:
+	if (entry != NULL) {
+		wlr_buffer_drop(buffer);
+	} else {
+		wlr_buffer_unlock(buffer);
+	}
+	return NULL;
+}
+
+static void add_cursor_buffer_texture(struct wlr_render_pass *pass,
+		struct wlr_output *output, struct wlr_buffer *buffer,
+		const struct wlr_box *local_box, struct wlr_texture *texture,
+		const struct wlr_fbox *src_box, const struct wlr_box *box,
+		enum wl_output_transform texture_transform,
+		struct wlr_drm_syncobj_timeline *wait_timeline, uint64_t wait_point) {
+	int transformed_width, transformed_height;
+	cursor_buffer_get_transformed_size(output, buffer,
+		&transformed_width, &transformed_height);
+
+	struct wlr_box dst_box = {
+		.x = box->x - local_box->x,
+		.y = box->y - local_box->y,
+		.width = box->width,
+		.height = box->height,
+	};
+	wlr_box_transform(&dst_box, &dst_box, wlr_output_transform_invert(output->transform),
+		transformed_width, transformed_height);
+
+	enum wl_output_transform transform = wlr_output_transform_invert(texture_transform);
+	transform = wlr_output_transform_compose(transform, output->transform);
+
+	wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
+		.texture = texture,
+		.src_box = *src_box,
+		.dst_box = dst_box,
+		.transform = transform,
+		.wait_timeline = wait_timeline,
+		.wait_point = wait_point,
+	});
+}
+
+/**
+ * Render the cursor image along with its attachment into a buffer suitable
+ * for the output's cursor plane. The attachment changes rarely compared to
+ * the pointer position, so this isn't cached.
+ */
+static struct wlr_buffer *render_cursor_attachment_buffer(
+		struct wlr_output_cursor *cursor, const struct wlr_box *local_box) {
+	struct wlr_output *output = cursor->output;
+	struct wlr_renderer *renderer = output->renderer;
+	assert(output->allocator != NULL && renderer != NULL);
+
+	int width, height;
+	if (!output_pick_cursor_buffer_size(output, local_box->width,
+			local_box->height, &width, &height) ||
+			!output_ensure_cursor_swapchain(output, width, height)) {
+		return NULL;
+	}
+
+	struct wlr_buffer *buffer = wlr_swapchain_acquire(output->cursor_swapchain);
+	if (buffer == NULL) {
+		return NULL;
+	}
+
+	struct wlr_render_pass *pass = wlr_renderer_begin_buffer_pass(renderer, buffer, NULL);
+	if (pass == NULL) {
+		wlr_buffer_unlock(buffer);
+		return NULL;
+	}
+
+	wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
+		.box = { .width = buffer->width, .height = buffer->height },
+		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+	});
+
+	struct wlr_box attachment_box = {
+		.x = cursor->attachment.x,
+		.y = cursor->attachment.y,
+		.width = cursor->attachment.width,
+		.height = cursor->attachment.height,
+	};
+	add_cursor_buffer_texture(pass, output, buffer, local_box,
+		cursor->attachment.texture, &cursor->attachment.src_box,
+		&attachment_box, cursor->attachment.transform, NULL, 0);
+
+	if (cursor->texture != NULL) {
+		struct wlr_box image_box = {
+			.x = -cursor->hotspot_x,
+			.y = -cursor->hotspot_y,
+			.width = cursor->width,
+			.height = cursor->height,
+		};
+		add_cursor_buffer_texture(pass, output, buffer, local_box,
+			cursor->texture, &cursor->src_box, &image_box, cursor->transform,
+			cursor->wait_timeline, cursor->wait_point);
+	}
+
 	if (!wlr_render_pass_submit(pass)) {
 		wlr_buffer_unlock(buffer);
 		return NULL;
@@ -302,22 +844,40 @@ static bool output_cursor_attempt_hardware(struct wlr_output_cursor *cursor) {
 	output->impl->move_cursor(cursor->output,
 		(int)cursor->x, (int)cursor->y);
 
+	struct wlr_box hotspot = {
+		.x = cursor->hotspot_x,
+		.y = cursor->hotspot_y,
+	};
+
 	struct wlr_buffer *buffer = NULL;
-	if (texture != NULL) {
-		buffer = render_cursor_buffer(cursor);
+	if (texture != NULL && cursor->attachment.texture != NULL) {
+		struct wlr_box local_box;
+		output_cursor_get_local_box(cursor, &local_box);
+		buffer = render_cursor_attachment_buffer(cursor, &local_box);
+		if (buffer == NULL) {
+			wlr_log(WLR_DEBUG, "Failed to render cursor buffer with attachment");
+			return false;
+		}
+		hotspot.x = -local_box.x;
+		hotspot.y = -local_box.y;
+	} else if (texture != NULL) {
+		buffer = render_cursor_buffer(output, texture, &cursor->src_box,
+			cursor->width, cursor->height, cursor->transform,
+			cursor->wait_timeline, cursor->wait_point);
 		if (buffer == NULL) {
 			wlr_log(WLR_DEBUG, "Failed to render cursor buffer");
 			return false;
 		}
 	}
 
-	struct wlr_box hotspot = {
-		.x = cursor->hotspot_x,
-		.y = cursor->hotspot_y,
-	};
+	int transformed_width = 0, transformed_height = 0;
+	if (buffer != NULL) {
+		cursor_buffer_get_transformed_size(output, buffer,
+			&transformed_width, &transformed_height);
+	}
 	wlr_box_transform(&hotspot, &hotspot,
 		wlr_output_transform_invert(output->transform),
-		buffer ? buffer->width : 0, buffer ? buffer->height : 0);
+		transformed_width, transformed_height);
 
 	bool ok = output_set_hardware_cursor(output, buffer, hotspot.x, hotspot.y);
 	wlr_buffer_unlock(buffer);
@@ -327,44 +887,111 @@ static bool output_cursor_attempt_hardware(struct wlr_output_cursor *cursor) {
 	return ok;
 }
 
+static void buffer_texture_get_size(struct wlr_output *output,
+		struct wlr_texture *texture, int *dst_width, int *dst_height) {
+	*dst_width = texture->width / output->scale;
+	*dst_height = texture->height / output->scale;
+}
+
+static bool output_cursor_set_buffer_texture(struct wlr_output_cursor *cursor,
+		struct wlr_texture *texture, bool own_texture,
+		int32_t hotspot_x, int32_t hotspot_y) {
+	struct wlr_fbox src_box = {0};
+	int dst_width = 0, dst_height = 0;
+	if (texture != NULL) {
+		src_box = (struct wlr_fbox){
+			.width = texture->width,
+			.height = texture->height,
+		};
+
+		buffer_texture_get_size(cursor->output, texture, &dst_width, &dst_height);
+	}
+
+	hotspot_x /= cursor->output->scale;
+	hotspot_y /= cursor->output->scale;
+
+	return output_cursor_set_texture(cursor, texture, own_texture, &src_box,
+		dst_width, dst_height, WL_OUTPUT_TRANSFORM_NORMAL, hotspot_x, hotspot_y,
+		NULL, 0);
+}
+
 bool wlr_output_cursor_set_buffer(struct wlr_output_cursor *cursor,
 		struct wlr_buffer *buffer, int32_t hotspot_x, int32_t hotspot_y) {
 	struct wlr_renderer *renderer = cursor->output->renderer;
 	assert(renderer != NULL);
 
 	struct wlr_texture *texture = NULL;
-	struct wlr_fbox src_box = {0};
-	int dst_width = 0, dst_height = 0;
 	if (buffer != NULL) {
 		texture = wlr_texture_from_buffer(renderer, buffer);
 		if (texture == NULL) {
 			return false;
 		}
+	}
 
-		src_box = (struct wlr_fbox){
-			.width = texture->width,
-			.height = texture->height,
-		};
+	return output_cursor_set_buffer_texture(cursor, texture, true,
+		hotspot_x, hotspot_y);
+}
 
-		dst_width = texture->width / cursor->output->scale;
-		dst_height = texture->height / cursor->output->scale;
+bool output_cursor_set_cached_buffer(struct wlr_output_cursor *cursor,
+		struct wlr_buffer *buffer, int32_t hotspot_x, int32_t hotspot_y) {
+	assert(cursor->output->renderer != NULL);
+
+	struct output_cursor_cache_entry *entry =
+		cursor_cache_get(cursor->output, buffer);
+	if (entry == NULL) {
+		return false;
 	}
 
-	hotspot_x /= cursor->output->scale;
-	hotspot_y /= cursor->output->scale;
+	return output_cursor_set_buffer_texture(cursor, entry->texture, false,
+		hotspot_x, hotspot_y);
+}
 
-	return output_cursor_set_texture(cursor, texture, true, &src_box,
-		dst_width, dst_height, WL_OUTPUT_TRANSFORM_NORMAL, hotspot_x, hotspot_y,
+void output_cursor_prepare_cached_buffer(struct wlr_output_cursor *cursor,
+		struct wlr_buffer *buffer) {
+	struct wlr_output *output = cursor->output;
+	assert(output->renderer != NULL);
+
+	struct output_cursor_cache_entry *entry = cursor_cache_get(output, buffer);
+	if (entry == NULL || output->hardware_cursor != cursor) {
+		// Software cursors only need the texture
+		return;
+	}
+
+	// Same size as the one output_cursor_set_buffer_texture() would pick
+	struct wlr_texture *texture = entry->texture;
+	int dst_width, dst_height;
+	buffer_texture_get_size(output, texture, &dst_width, &dst_height);
+	struct wlr_fbox src_box = {
+		.width = texture->width,
+		.height = texture->height,
+	};
+	struct wlr_buffer *cursor_buffer = render_cursor_buffer(output, texture,
+		&src_box, (int)roundf(dst_width * output->scale),
+		(int)roundf(dst_height * output->scale), WL_OUTPUT_TRANSFORM_NORMAL,
 		NULL, 0);
+	wlr_buffer_unlock(cursor_buffer);
 }
 
 static void output_cursor_handle_renderer_destroy(struct wl_listener *listener,
 		void *data) {
 	struct wlr_output_cursor *cursor = wl_container_of(listener, cursor, renderer_destroy);
+	memset(&cursor->attachment, 0, sizeof(cursor->attachment));
 	output_cursor_set_texture(cursor, NULL, false, NULL, 0, 0,
 		WL_OUTPUT_TRANSFORM_NORMAL, 0, 0, NULL, 0);
 }
 
+static void output_cursor_update_hardware(struct wlr_output_cursor *cursor) {
+	struct wlr_output *output = cursor->output;
+
+	if (!output_cursor_attempt_hardware(cursor)) {
+		wlr_log(WLR_DEBUG, "Falling back to software cursor on output '%s'", output->name);
+		output_disable_hardware_cursor(output);
+		output_cursor_damage_whole(cursor);
+	}
+
+	wl_signal_emit_mutable(&output->cursor_update, cursor);
+}
+
 bool output_cursor_set_texture(struct wlr_output_cursor *cursor,
 		struct wlr_texture *texture, bool own_texture, const struct wlr_fbox *src_box,
 		int dst_width, int dst_height, enum wl_output_transform transform,
@@ -395,6 +1022,7 @@ bool output_cursor_set_texture(struct wlr_output_cursor *cursor,
 	}
 	cursor->texture = texture;
 	cursor->own_texture = own_texture;
+	cursor->image_seq++;
 
 	wlr_drm_syncobj_timeline_unref(cursor->wait_timeline);
 	if (wait_timeline != NULL) {
@@ -413,14 +1041,32 @@ bool output_cursor_set_texture(struct wlr_output_cursor *cursor,
 		wl_list_init(&cursor->renderer_destroy.link);
 	}
 
-	if (output_cursor_attempt_hardware(cursor)) {
-		return true;
+	output_cursor_update_hardware(cursor);
+	return true;
+}
+
+void output_cursor_set_attachment(struct wlr_output_cursor *cursor,
+		struct wlr_texture *texture, const struct wlr_fbox *src_box,
+		int dst_width, int dst_height, enum wl_output_transform transform,
+		int32_t x, int32_t y) {
+	struct wlr_output *output = cursor->output;
+
+	output_cursor_reset(cursor);
+
+	if (texture != NULL) {
+		cursor->attachment.texture = texture;
+		cursor->attachment.src_box = *src_box;
+		cursor->attachment.transform = transform;
+		cursor->attachment.x = (int)roundf(x * output->scale);
+		cursor->attachment.y = (int)roundf(y * output->scale);
+		cursor->attachment.width = (int)roundf(dst_width * output->scale);
+		cursor->attachment.height = (int)roundf(dst_height * output->scale);
+	} else {
+		memset(&cursor->attachment, 0, sizeof(cursor->attachment));
 	}
 
-	wlr_log(WLR_DEBUG, "Falling back to software cursor on output '%s'", output->name);
-	output_disable_hardware_cursor(output);
-	output_cursor_damage_whole(cursor);
-	return true;
+	output_cursor_update_visible(cursor);
+	output_cursor_update_hardware(cursor);
 }
 
 bool wlr_output_cursor_move(struct wlr_output_cursor *cursor,
@@ -441,6 +1087,7 @@ bool wlr_output_cursor_move(struct wlr_output_cursor *cursor,
 	cursor->y = y;
 	bool was_visible = cursor->visible;
 	output_cursor_update_visible(cursor);
+	wl_signal_emit_mutable(&cursor->output->cursor_update, cursor);
 
 	if (!was_visible && !cursor->visible) {
 		// Cursor is still hidden, do nothing
@@ -483,5 +1130,6 @@ void wlr_output_cursor_destroy(struct wlr_output_cursor *cursor) {
 	}
 	wlr_drm_syncobj_timeline_unref(cursor->wait_timeline);
 	wl_list_remove(&cursor->link);
+	wl_signal_emit_mutable(&cursor->output->cursor_update, cursor);
 	free(cursor);
 }
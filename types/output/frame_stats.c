@@ -0,0 +1,110 @@
+#include <string.h>
+#include <wlr/types/wlr_output.h>
+#include "types/wlr_output.h"
+#include "util/time.h"
+
+static void histogram_add(struct wlr_output_frame_histogram *histogram,
+		int64_t duration_ns) {
+	if (duration_ns < 0) {
+		return;
+	}
+
+	int64_t bucket = duration_ns / WLR_OUTPUT_FRAME_HISTOGRAM_BUCKET_NS;
+	if (bucket >= WLR_OUTPUT_FRAME_HISTOGRAM_BUCKETS) {
+		bucket = WLR_OUTPUT_FRAME_HISTOGRAM_BUCKETS - 1;
+	}
+	histogram->buckets[bucket]++;
+	histogram->count++;
+	histogram->sum_ns += duration_ns;
+	if (duration_ns > histogram->max_ns) {
+		histogram->max_ns = duration_ns;
+	}
+}
+
+int64_t wlr_output_frame_histogram_get_percentile(
+		const struct wlr_output_frame_histogram *histogram, double fraction) {
+	if (histogram->count == 0) {
+		return -1;
+	}
+
+	uint64_t threshold = (uint64_t)(fraction * histogram->count);
+	uint64_t count = 0;
+	for (int i = 0; i < WLR_OUTPUT_FRAME_HISTOGRAM_BUCKETS - 1; i++) {
+		count += histogram->buckets[i];
+		if (count >= threshold) {
+			return (int64_t)(i + 1) * WLR_OUTPUT_FRAME_HISTOGRAM_BUCKET_NS;
+		}
+	}
+	return histogram->max_ns;
+}
+
+void output_frame_stats_add_commit(struct wlr_output *output,
+		const struct wlr_output_state *state, const struct timespec *when) {
+	if (!(state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		return;
+	}
+
+	size_t commits_len = sizeof(output->frame_stats_commits) /
+		sizeof(output->frame_stats_commits[0]);
+	size_t i = output->frame_stats_next_commit;
+	output->frame_stats_commits[i].seq = output->commit_seq;
+	output->frame_stats_commits[i].when_ns = timespec_to_nsec(when);
+	output->frame_stats_next_commit = (i + 1) % commits_len;
+}
+
+void output_frame_stats_add_present(struct wlr_output *output,
+		const struct wlr_output_event_present *event) {
+	struct wlr_output_frame_stats *stats = &output->frame_stats;
+
+	size_t commits_len = sizeof(output->frame_stats_commits) /
+		sizeof(output->frame_stats_commits[0]);
+	int64_t commit_ns = 0;
+	for (size_t i = 0; i < commits_len; i++) {
+		if (output->frame_stats_commits[i].when_ns != 0 &&
+				output->frame_stats_commits[i].seq == event->commit_seq) {
+			commit_ns = output->frame_stats_commits[i].when_ns;
+			output->frame_stats_commits[i].when_ns = 0;
+			break;
+		}
+	}
+	if (commit_ns == 0) {
+		// Not a buffer commit, or one older than the tracked ones
+		return;
+	}
+
+	if (!event->presented) {
+		stats->discarded++;
+		return;
+	}
+
+	stats->presented++;
+	if (event->flags & WLR_OUTPUT_PRESENT_ZERO_COPY) {
+		stats->zero_copy++;
+	}
+
+	int64_t latency_ns = timespec_to_nsec(&event->when) - commit_ns;
+	histogram_add(&stats->commit_to_present, latency_ns);
+
+	int64_t refresh_ns = event->refresh;
+	if (refresh_ns <= 0 && output->refresh > 0) {
+		refresh_ns = 1000000000000ll / output->refresh;
+	}
+	if ((event->flags & WLR_OUTPUT_PRESENT_VSYNC) && refresh_ns > 0 &&
+			latency_ns > 0) {
+		stats->missed_vblanks += latency_ns / refresh_ns;
+	}
+}
+
+const struct wlr_output_frame_stats *wlr_output_get_frame_stats(
+		struct wlr_output *output) {
+	return &output->frame_stats;
+}
+
+void wlr_output_reset_frame_stats(struct wlr_output *output) {
+	memset(&output->frame_stats, 0, sizeof(output->frame_stats));
+}
+
+void wlr_output_add_render_duration(struct wlr_output *output,
+		int64_t duration_ns) {
+	histogram_add(&output->frame_stats.render, duration_ns);
+}
@@ -254,6 +254,7 @@ static void output_apply_state(struct wlr_output *output,
 		output->swapchain = NULL;
 		wlr_swapchain_destroy(output->cursor_swapchain);
 		output->cursor_swapchain = NULL;
+		output_clear_cursor_cache(output);
 	}
 
 	if (state->committed & WLR_OUTPUT_STATE_LAYERS) {
@@ -347,6 +348,8 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 
 	wl_list_init(&output->modes);
 	wl_list_init(&output->cursors);
+	wl_list_init(&output->cursor_cache);
+	wl_list_init(&output->cursor_cache_renderer_destroy.link);
 	wl_list_init(&output->layers);
 	wl_list_init(&output->resources);
 	wl_signal_init(&output->events.frame);
@@ -359,6 +362,7 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 	wl_signal_init(&output->events.description);
 	wl_signal_init(&output->events.request_state);
 	wl_signal_init(&output->events.destroy);
+	wl_signal_init(&output->cursor_update);
 
 	output->software_cursor_locks = env_parse_bool("WLR_NO_HARDWARE_CURSORS");
 	if (output->software_cursor_locks) {
@@ -369,6 +373,8 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 
 	wl_list_init(&output->display_destroy.link);
 	output->display_destroy.notify = handle_display_destroy;
+	wl_list_init(&output->frame_leader_present.link);
+	wl_list_init(&output->frame_leader_destroy.link);
 
 	if (state) {
 		output_apply_state(output, state);
@@ -376,8 +382,11 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 }
 
 void wlr_output_finish(struct wlr_output *output) {
+	// Don't send a frame event when unlinking the frame leader below
+	output->frame_follower_waiting = false;
 	wl_signal_emit_mutable(&output->events.destroy, output);
 
+	wlr_output_set_frame_leader(output, NULL);
 	wlr_output_destroy_global(output);
 
 	wl_list_remove(&output->display_destroy.link);
@@ -396,6 +405,7 @@ void wlr_output_finish(struct wlr_output *output) {
 		wlr_output_layer_destroy(layer);
 	}
 
+	output_clear_cursor_cache(output);
 	wlr_swapchain_destroy(output->cursor_swapchain);
 	wlr_buffer_unlock(output->cursor_front_buffer);
 
@@ -737,6 +747,8 @@ void output_apply_commit(struct wlr_output *output, const struct wlr_output_stat
 
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
+	output_frame_stats_add_commit(output, state, &now);
+
 	struct wlr_output_event_commit event = {
 		.output = output,
 		.when = &now,
@@ -784,13 +796,64 @@ bool wlr_output_commit_state(struct wlr_output *output,
 	return true;
 }
 
-void wlr_output_send_frame(struct wlr_output *output) {
+static void output_emit_frame(struct wlr_output *output) {
+	output->frame_follower_waiting = false;
 	output->frame_pending = false;
 	if (output->enabled) {
 		wl_signal_emit_mutable(&output->events.frame, output);
 	}
 }
 
+void wlr_output_send_frame(struct wlr_output *output) {
+	if (output->frame_leader != NULL && output->frame_leader->enabled &&
+			output->frame_leader->frame_pending) {
+		// Wait for the leader's frame to be presented
+		output->frame_follower_waiting = true;
+		return;
+	}
+	output_emit_frame(output);
+}
+
+static void output_handle_frame_leader_present(struct wl_listener *listener,
+		void *data) {
+	struct wlr_output *output =
+		wl_container_of(listener, output, frame_leader_present);
+	if (output->frame_follower_waiting) {
+		output_emit_frame(output);
+	}
+}
+
+static void output_handle_frame_leader_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_output *output =
+		wl_container_of(listener, output, frame_leader_destroy);
+	wlr_output_set_frame_leader(output, NULL);
+}
+
+void wlr_output_set_frame_leader(struct wlr_output *output,
+		struct wlr_output *leader) {
+	assert(leader != output);
+	assert(leader == NULL || leader->frame_leader == NULL);
+	if (output->frame_leader == leader) {
+		return;
+	}
+
+	wl_list_remove(&output->frame_leader_present.link);
+	wl_list_remove(&output->frame_leader_destroy.link);
+	wl_list_init(&output->frame_leader_present.link);
+	wl_list_init(&output->frame_leader_destroy.link);
+	output->frame_leader = leader;
+
+	if (leader != NULL) {
+		output->frame_leader_present.notify = output_handle_frame_leader_present;
+		wl_signal_add(&leader->events.present, &output->frame_leader_present);
+		output->frame_leader_destroy.notify = output_handle_frame_leader_destroy;
+		wl_signal_add(&leader->events.destroy, &output->frame_leader_destroy);
+	} else if (output->frame_follower_waiting) {
+		output_emit_frame(output);
+	}
+}
+
 static void schedule_frame_handle_idle_timer(void *data) {
 	struct wlr_output *output = data;
 	output->idle_frame = NULL;
@@ -828,6 +891,7 @@ void wlr_output_send_present(struct wlr_output *output,
 		}
 	}
 
+	output_frame_stats_add_present(output, event);
 	wl_signal_emit_mutable(&output->events.present, event);
 }
 
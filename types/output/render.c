@@ -31,6 +31,7 @@ bool wlr_output_init_render(struct wlr_output *output,
 
 	wlr_swapchain_destroy(output->cursor_swapchain);
 	output->cursor_swapchain = NULL;
+	output_clear_cursor_cache(output);
 
 	output->allocator = allocator;
 	output->renderer = renderer;
@@ -120,6 +121,14 @@ bool output_ensure_buffer(struct wlr_output *output,
 		return true;
 	}
 
+	// Let the renderer build whatever the first real frames will need while
+	// the empty one is rendered and the output is modeset
+	uint32_t render_format = output->render_format;
+	if (state->committed & WLR_OUTPUT_STATE_RENDER_FORMAT) {
+		render_format = state->render_format;
+	}
+	renderer_prepare_render_format(output->renderer, render_format);
+
 	wlr_log(WLR_DEBUG, "Attaching empty buffer to output for modeset");
 	struct wlr_buffer *buffer = output_acquire_empty_buffer(output, state);
 	if (buffer == NULL) {
@@ -194,6 +203,46 @@ bool output_pick_format(struct wlr_output *output,
 	return true;
 }
 
+bool output_format_restrict_modifiers(struct wlr_drm_format *format,
+		enum output_modifier_tier tier, bool *changed) {
+	*changed = false;
+
+	switch (tier) {
+	case OUTPUT_MODIFIER_TIER_ALL:
+		return true;
+	case OUTPUT_MODIFIER_TIER_UNCOMPRESSED:;
+		size_t len = 0;
+		for (size_t i = 0; i < format->len; i++) {
+			if (!drm_modifier_is_compressed(format->modifiers[i])) {
+				format->modifiers[len++] = format->modifiers[i];
+			}
+		}
+		*changed = len != format->len;
+		format->len = len;
+		if (len == 0) {
+			wlr_log(WLR_DEBUG, "No uncompressed modifier supported");
+			return false;
+		}
+		return true;
+	case OUTPUT_MODIFIER_TIER_IMPLICIT:
+		if (format->len == 1 && format->modifiers[0] == DRM_FORMAT_MOD_LINEAR) {
+			return true;
+		}
+		if (!wlr_drm_format_has(format, DRM_FORMAT_MOD_INVALID)) {
+			wlr_log(WLR_DEBUG, "Implicit modifiers not supported");
+			return false;
+		}
+		format->len = 0;
+		if (!wlr_drm_format_add(format, DRM_FORMAT_MOD_INVALID)) {
+			wlr_log(WLR_DEBUG, "Failed to add implicit modifier to format");
+			return false;
+		}
+		*changed = true;
+		return true;
+	}
+	abort(); // unreachable
+}
+
 struct wlr_render_pass *wlr_output_begin_render_pass(struct wlr_output *output,
 		struct wlr_output_state *state, struct wlr_buffer_pass_options *render_options) {
 	if (!wlr_output_configure_primary_swapchain(output, state, &output->swapchain)) {
@@ -1,9 +1,44 @@
+#include <assert.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wlr/render/drm_syncobj.h>
 #include <wlr/util/log.h>
 #include "types/wlr_output.h"
 
+/**
+ * Gamma LUTs are immutable once set, so copies of a state share them instead
+ * of duplicating a few kilobytes of ramps for each test-then-commit.
+ */
+struct output_gamma_lut {
+	size_t n_refs;
+	uint16_t data[];
+};
+
+static struct output_gamma_lut *gamma_lut_from_data(uint16_t *data) {
+	return (struct output_gamma_lut *)((char *)data -
+		offsetof(struct output_gamma_lut, data));
+}
+
+static uint16_t *gamma_lut_ref(uint16_t *data) {
+	if (data != NULL) {
+		gamma_lut_from_data(data)->n_refs++;
+	}
+	return data;
+}
+
+static void gamma_lut_unref(uint16_t *data) {
+	if (data == NULL) {
+		return;
+	}
+	struct output_gamma_lut *lut = gamma_lut_from_data(data);
+	assert(lut->n_refs > 0);
+	lut->n_refs--;
+	if (lut->n_refs == 0) {
+		free(lut);
+	}
+}
+
 void wlr_output_state_init(struct wlr_output_state *state) {
 	*state = (struct wlr_output_state){0};
 	pixman_region32_init(&state->damage);
@@ -16,7 +51,7 @@ void wlr_output_state_finish(struct wlr_output_state *state) {
 	// reads it after output_state_finish().
 	state->buffer = NULL;
 	pixman_region32_fini(&state->damage);
-	free(state->gamma_lut);
+	gamma_lut_unref(state->gamma_lut);
 	wlr_drm_syncobj_timeline_unref(state->wait_timeline);
 	wlr_drm_syncobj_timeline_unref(state->signal_timeline);
 }
@@ -92,17 +127,19 @@ bool wlr_output_state_set_gamma_lut(struct wlr_output_state *state,
 		size_t ramp_size, const uint16_t *r, const uint16_t *g, const uint16_t *b) {
 	uint16_t *gamma_lut = NULL;
 	if (ramp_size > 0) {
-		gamma_lut = realloc(state->gamma_lut, 3 * ramp_size * sizeof(uint16_t));
-		if (gamma_lut == NULL) {
+		struct output_gamma_lut *lut =
+			malloc(sizeof(*lut) + 3 * ramp_size * sizeof(uint16_t));
+		if (lut == NULL) {
 			wlr_log_errno(WLR_ERROR, "Allocation failed");
 			return false;
 		}
+		lut->n_refs = 1;
+		gamma_lut = lut->data;
 		memcpy(gamma_lut, r, ramp_size * sizeof(uint16_t));
 		memcpy(gamma_lut + ramp_size, g, ramp_size * sizeof(uint16_t));
 		memcpy(gamma_lut + 2 * ramp_size, b, ramp_size * sizeof(uint16_t));
-	} else {
-		free(state->gamma_lut);
 	}
+	gamma_lut_unref(state->gamma_lut);
 
 	state->committed |= WLR_OUTPUT_STATE_GAMMA_LUT;
 	state->gamma_lut_size = ramp_size;
@@ -161,12 +198,9 @@ bool wlr_output_state_copy(struct wlr_output_state *dst,
 	}
 
 	if (src->committed & WLR_OUTPUT_STATE_GAMMA_LUT) {
-		const uint16_t *r = src->gamma_lut;
-		const uint16_t *g = src->gamma_lut + src->gamma_lut_size;
-		const uint16_t *b = src->gamma_lut + 2 * src->gamma_lut_size;
-		if (!wlr_output_state_set_gamma_lut(&copy, src->gamma_lut_size, r, g, b)) {
-			goto err;
-		}
+		copy.committed |= WLR_OUTPUT_STATE_GAMMA_LUT;
+		copy.gamma_lut = gamma_lut_ref(src->gamma_lut);
+		copy.gamma_lut_size = src->gamma_lut_size;
 	}
 
 	if (src->committed & WLR_OUTPUT_STATE_WAIT_TIMELINE) {
@@ -181,8 +215,4 @@ bool wlr_output_state_copy(struct wlr_output_state *dst,
 	wlr_output_state_finish(dst);
 	*dst = copy;
 	return true;
-
-err:
-	wlr_output_state_finish(&copy);
-	return false;
 }
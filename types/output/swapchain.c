@@ -9,8 +9,15 @@
 #include "render/drm_format_set.h"
 #include "types/wlr_output.h"
 
+static const char *const modifier_tier_names[] = {
+	[OUTPUT_MODIFIER_TIER_ALL] = "all",
+	[OUTPUT_MODIFIER_TIER_UNCOMPRESSED] = "uncompressed",
+	[OUTPUT_MODIFIER_TIER_IMPLICIT] = "implicit",
+};
+
 static struct wlr_swapchain *create_swapchain(struct wlr_output *output,
-		int width, int height, uint32_t render_format, bool allow_modifiers) {
+		int width, int height, uint32_t render_format,
+		enum output_modifier_tier tier, bool *changed) {
 	struct wlr_allocator *allocator = output->allocator;
 	assert(output->allocator != NULL);
 
@@ -23,24 +30,16 @@ static struct wlr_swapchain *create_swapchain(struct wlr_output *output,
 		return NULL;
 	}
 
-	char *format_name = drmGetFormatName(format.format);
-	wlr_log(WLR_DEBUG, "Choosing primary buffer format %s (0x%08"PRIX32") for output '%s'",
-		format_name ? format_name : "<unknown>", format.format, output->name);
-	free(format_name);
-
-	if (!allow_modifiers && (format.len != 1 || format.modifiers[0] != DRM_FORMAT_MOD_LINEAR)) {
-		if (!wlr_drm_format_has(&format, DRM_FORMAT_MOD_INVALID)) {
-			wlr_log(WLR_DEBUG, "Implicit modifiers not supported");
-			wlr_drm_format_finish(&format);
-			return NULL;
-		}
+	if (tier == OUTPUT_MODIFIER_TIER_ALL) {
+		char *format_name = drmGetFormatName(format.format);
+		wlr_log(WLR_DEBUG, "Choosing primary buffer format %s (0x%08"PRIX32") for output '%s'",
+			format_name ? format_name : "<unknown>", format.format, output->name);
+		free(format_name);
+	}
 
-		format.len = 0;
-		if (!wlr_drm_format_add(&format, DRM_FORMAT_MOD_INVALID)) {
-			wlr_log(WLR_DEBUG, "Failed to add implicit modifier to format");
-			wlr_drm_format_finish(&format);
-			return NULL;
-		}
+	if (!output_format_restrict_modifiers(&format, tier, changed)) {
+		wlr_drm_format_finish(&format);
+		return NULL;
 	}
 
 	struct wlr_swapchain *swapchain = wlr_swapchain_create(allocator, width, height, &format);
@@ -87,29 +86,36 @@ bool wlr_output_configure_primary_swapchain(struct wlr_output *output,
 		return true;
 	}
 
-	struct wlr_swapchain *swapchain = create_swapchain(output, width, height, format, true);
-	if (swapchain == NULL) {
-		wlr_log(WLR_ERROR, "Failed to create swapchain for output '%s'", output->name);
-		return false;
-	}
-
-	wlr_log(WLR_DEBUG, "Testing swapchain for output '%s'", output->name);
-	if (!test_swapchain(output, swapchain, state)) {
-		wlr_log(WLR_DEBUG, "Output test failed on '%s', retrying without modifiers",
-			output->name);
-		wlr_swapchain_destroy(swapchain);
-		swapchain = create_swapchain(output, width, height, format, false);
+	// Try modifiers which save memory bandwidth first, and fall back to more
+	// compatible ones if the backend rejects them
+	struct wlr_swapchain *swapchain = NULL;
+	for (int tier = 0; tier < OUTPUT_MODIFIER_TIER_COUNT; tier++) {
+		bool changed = false;
+		swapchain = create_swapchain(output, width, height, format, tier, &changed);
 		if (swapchain == NULL) {
-			wlr_log(WLR_ERROR, "Failed to create modifier-less swapchain for output '%s'",
-				output->name);
-			return false;
+			wlr_log(WLR_DEBUG, "Failed to create swapchain with %s modifiers "
+				"for output '%s'", modifier_tier_names[tier], output->name);
+			continue;
 		}
-		wlr_log(WLR_DEBUG, "Testing modifier-less swapchain for output '%s'", output->name);
-		if (!test_swapchain(output, swapchain, state)) {
-			wlr_log(WLR_ERROR, "Swapchain for output '%s' failed test", output->name);
+		if (tier != OUTPUT_MODIFIER_TIER_ALL && !changed) {
+			// Same modifiers as a tier which already failed
 			wlr_swapchain_destroy(swapchain);
-			return false;
+			swapchain = NULL;
+			continue;
 		}
+
+		wlr_log(WLR_DEBUG, "Testing swapchain with %s modifiers for output '%s'",
+			modifier_tier_names[tier], output->name);
+		if (test_swapchain(output, swapchain, state)) {
+			break;
+		}
+
+		wlr_swapchain_destroy(swapchain);
+		swapchain = NULL;
+	}
+	if (swapchain == NULL) {
+		wlr_log(WLR_ERROR, "Swapchain for output '%s' failed test", output->name);
+		return false;
 	}
 
 	wlr_swapchain_destroy(*swapchain_ptr);
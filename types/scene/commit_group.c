@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include <time.h>
+#include <wlr/backend.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/log.h>
+
+struct wlr_scene_commit_group_output {
+	struct wlr_scene_commit_group *group;
+	struct wlr_scene_output *scene_output;
+	struct wl_list link; // wlr_scene_commit_group.outputs
+
+	// Whether a frame event has been received since the last group commit
+	bool frame_pending;
+
+	struct wl_listener output_frame;
+	struct wl_listener scene_output_destroy;
+};
+
+static void group_output_destroy(struct wlr_scene_commit_group_output *group_output) {
+	wl_list_remove(&group_output->output_frame.link);
+	wl_list_remove(&group_output->scene_output_destroy.link);
+	wl_list_remove(&group_output->link);
+	free(group_output);
+}
+
+static void group_commit(struct wlr_scene_commit_group *group) {
+	size_t pending_len = 0;
+	struct wlr_scene_commit_group_output *group_output;
+	wl_list_for_each(group_output, &group->outputs, link) {
+		if (group_output->frame_pending) {
+			pending_len++;
+		}
+	}
+	if (pending_len == 0) {
+		return;
+	}
+
+	struct wlr_backend_output_state *states = calloc(pending_len, sizeof(states[0]));
+	if (states == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+
+	size_t states_len = 0;
+	wl_list_for_each(group_output, &group->outputs, link) {
+		struct wlr_scene_output *scene_output = group_output->scene_output;
+		if (!group_output->frame_pending ||
+				!wlr_scene_output_needs_frame(scene_output)) {
+			continue;
+		}
+
+		struct wlr_backend_output_state *state = &states[states_len];
+		state->output = scene_output->output;
+		wlr_output_state_init(&state->base);
+		if (!wlr_scene_output_build_state(scene_output, &state->base, NULL)) {
+			wlr_output_state_finish(&state->base);
+			continue;
+		}
+		states_len++;
+	}
+
+	// A failed commit may have been applied to some of the outputs already,
+	// so only fall back to separate commits when the group fails the test
+	if (states_len > 0 && wlr_backend_test(group->backend, states, states_len)) {
+		if (!wlr_backend_commit(group->backend, states, states_len)) {
+			wlr_log(WLR_ERROR, "Grouped commit of %zu outputs failed", states_len);
+		}
+	} else if (states_len > 0) {
+		// One broken output shouldn't prevent the others from being updated
+		wlr_log(WLR_DEBUG, "Grouped commit test of %zu outputs failed, "
+			"committing them separately", states_len);
+		for (size_t i = 0; i < states_len; i++) {
+			wlr_output_commit_state(states[i].output, &states[i].base);
+		}
+	}
+
+	for (size_t i = 0; i < states_len; i++) {
+		wlr_output_state_finish(&states[i].base);
+	}
+	free(states);
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	wl_list_for_each(group_output, &group->outputs, link) {
+		if (group_output->frame_pending) {
+			group_output->frame_pending = false;
+			wlr_scene_output_send_frame_done(group_output->scene_output, &now);
+		}
+	}
+}
+
+static void group_handle_idle(void *data) {
+	struct wlr_scene_commit_group *group = data;
+	group->idle = NULL;
+	group_commit(group);
+}
+
+static void group_output_handle_output_frame(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_commit_group_output *group_output =
+		wl_container_of(listener, group_output, output_frame);
+	struct wlr_scene_commit_group *group = group_output->group;
+
+	group_output->frame_pending = true;
+
+	// Page-flip events of outputs committed together are read at once, wait
+	// for the frame events of the other outputs before committing
+	if (group->idle == NULL) {
+		struct wl_event_loop *loop = group_output->scene_output->output->event_loop;
+		group->idle = wl_event_loop_add_idle(loop, group_handle_idle, group);
+		if (group->idle == NULL) {
+			wlr_log(WLR_ERROR, "Failed to schedule grouped commit");
+			group_commit(group);
+		}
+	}
+}
+
+static void group_output_handle_scene_output_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_commit_group_output *group_output =
+		wl_container_of(listener, group_output, scene_output_destroy);
+	group_output_destroy(group_output);
+}
+
+struct wlr_scene_commit_group *wlr_scene_commit_group_create(
+		struct wlr_backend *backend) {
+	struct wlr_scene_commit_group *group = calloc(1, sizeof(*group));
+	if (group == NULL) {
+		return NULL;
+	}
+
+	group->backend = backend;
+	wl_list_init(&group->outputs);
+	wl_signal_init(&group->events.destroy);
+
+	return group;
+}
+
+void wlr_scene_commit_group_destroy(struct wlr_scene_commit_group *group) {
+	if (group == NULL) {
+		return;
+	}
+
+	wl_signal_emit_mutable(&group->events.destroy, NULL);
+
+	if (group->idle != NULL) {
+		wl_event_source_remove(group->idle);
+	}
+
+	struct wlr_scene_commit_group_output *group_output, *tmp;
+	wl_list_for_each_safe(group_output, tmp, &group->outputs, link) {
+		group_output_destroy(group_output);
+	}
+
+	free(group);
+}
+
+static struct wlr_scene_commit_group_output *group_get_output(
+		struct wlr_scene_commit_group *group, struct wlr_scene_output *scene_output) {
+	struct wlr_scene_commit_group_output *group_output;
+	wl_list_for_each(group_output, &group->outputs, link) {
+		if (group_output->scene_output == scene_output) {
+			return group_output;
+		}
+	}
+	return NULL;
+}
+
+bool wlr_scene_commit_group_add_output(struct wlr_scene_commit_group *group,
+		struct wlr_scene_output *scene_output) {
+	if (group_get_output(group, scene_output) != NULL) {
+		return true;
+	}
+
+	struct wlr_scene_commit_group_output *group_output = calloc(1, sizeof(*group_output));
+	if (group_output == NULL) {
+		return false;
+	}
+
+	group_output->group = group;
+	group_output->scene_output = scene_output;
+	wl_list_insert(group->outputs.prev, &group_output->link);
+
+	group_output->output_frame.notify = group_output_handle_output_frame;
+	wl_signal_add(&scene_output->output->events.frame, &group_output->output_frame);
+	group_output->scene_output_destroy.notify = group_output_handle_scene_output_destroy;
+	wl_signal_add(&scene_output->events.destroy, &group_output->scene_output_destroy);
+
+	return true;
+}
+
+void wlr_scene_commit_group_remove_output(struct wlr_scene_commit_group *group,
+		struct wlr_scene_output *scene_output) {
+	struct wlr_scene_commit_group_output *group_output =
+		group_get_output(group, scene_output);
+	if (group_output != NULL) {
+		group_output_destroy(group_output);
+	}
+}
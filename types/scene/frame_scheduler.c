@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <time.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/log.h>
+#include "util/time.h"
+
+#define DEFAULT_MARGIN_NS 1500000 // 1.5ms
+
+static int64_t scheduler_predict_render_time(
+		const struct wlr_scene_frame_scheduler *scheduler) {
+	// Use the worst recent render time, missing the deadline is a lot worse
+	// than waking up a little too early
+	int64_t max = 0;
+	for (size_t i = 0; i < scheduler->samples_len; i++) {
+		if (scheduler->samples[i] > max) {
+			max = scheduler->samples[i];
+		}
+	}
+	return max;
+}
+
+static void scheduler_add_sample(struct wlr_scene_frame_scheduler *scheduler,
+		int64_t duration) {
+	scheduler->samples[scheduler->next_sample] = duration;
+	scheduler->next_sample =
+		(scheduler->next_sample + 1) % WLR_SCENE_FRAME_SCHEDULER_SAMPLES;
+	if (scheduler->samples_len < WLR_SCENE_FRAME_SCHEDULER_SAMPLES) {
+		scheduler->samples_len++;
+	}
+}
+
+static void scheduler_emit_frame(struct wlr_scene_frame_scheduler *scheduler) {
+	wl_signal_emit_mutable(&scheduler->events.frame, &scheduler->timer);
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	wlr_scene_output_send_frame_done(scheduler->scene_output, &now);
+}
+
+static int scheduler_handle_delay_timer(void *data) {
+	struct wlr_scene_frame_scheduler *scheduler = data;
+	scheduler_emit_frame(scheduler);
+	return 0;
+}
+
+static void scheduler_handle_output_frame(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_frame_scheduler *scheduler =
+		wl_container_of(listener, scheduler, output_frame);
+
+	if (!scheduler->vsync || scheduler->refresh_ns <= 0 ||
+			scheduler->samples_len == 0) {
+		scheduler_emit_frame(scheduler);
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t now_ns = timespec_to_nsec(&now);
+
+	// The output may have been idle for a while, find the next refresh
+	int64_t refresh_ns = scheduler->refresh_ns;
+	int64_t next_refresh_ns = scheduler->last_present_ns + refresh_ns;
+	if (next_refresh_ns <= now_ns) {
+		next_refresh_ns += ((now_ns - next_refresh_ns) / refresh_ns + 1) * refresh_ns;
+	}
+
+	int64_t deadline_ns = next_refresh_ns -
+		scheduler_predict_render_time(scheduler) - scheduler->margin_ns;
+	int64_t delay_ms = (deadline_ns - now_ns) / 1000000;
+	if (delay_ms <= 0) {
+		scheduler_emit_frame(scheduler);
+		return;
+	}
+
+	wl_event_source_timer_update(scheduler->delay_timer, delay_ms);
+}
+
+static void scheduler_handle_output_present(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_frame_scheduler *scheduler =
+		wl_container_of(listener, scheduler, output_present);
+	const struct wlr_output_event_present *event = data;
+
+	if (!event->presented) {
+		return;
+	}
+
+	scheduler->last_present_ns = timespec_to_nsec(&event->when);
+	scheduler->vsync = event->flags & WLR_OUTPUT_PRESENT_VSYNC;
+
+	struct wlr_output *output = scheduler->scene_output->output;
+	if (event->refresh > 0) {
+		scheduler->refresh_ns = event->refresh;
+	} else if (output->refresh > 0) {
+		scheduler->refresh_ns = 1000000000000ll / output->refresh;
+	} else {
+		scheduler->refresh_ns = 0;
+	}
+
+	// The frame has been displayed, so the GPU is done with it and the timer
+	// measurements are available
+	struct wlr_scene_timer *timer = &scheduler->timer;
+	if (timer->pre_render_duration > 0 || timer->render_timer != NULL) {
+		int64_t duration = wlr_scene_timer_get_duration_ns(timer);
+		if (duration >= 0) {
+			scheduler_add_sample(scheduler, duration);
+			wlr_output_add_render_duration(output, duration);
+		}
+	}
+	wlr_scene_timer_finish(timer);
+	*timer = (struct wlr_scene_timer){0};
+}
+
+static void scheduler_handle_scene_output_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_frame_scheduler *scheduler =
+		wl_container_of(listener, scheduler, scene_output_destroy);
+	wlr_scene_frame_scheduler_destroy(scheduler);
+}
+
+struct wlr_scene_frame_scheduler *wlr_scene_frame_scheduler_create(
+		struct wlr_scene_output *scene_output) {
+	struct wlr_scene_frame_scheduler *scheduler = calloc(1, sizeof(*scheduler));
+	if (scheduler == NULL) {
+		return NULL;
+	}
+
+	struct wlr_output *output = scene_output->output;
+	scheduler->delay_timer = wl_event_loop_add_timer(output->event_loop,
+		scheduler_handle_delay_timer, scheduler);
+	if (scheduler->delay_timer == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create frame scheduler timer");
+		free(scheduler);
+		return NULL;
+	}
+
+	scheduler->scene_output = scene_output;
+	scheduler->margin_ns = DEFAULT_MARGIN_NS;
+
+	wl_signal_init(&scheduler->events.frame);
+	wl_signal_init(&scheduler->events.destroy);
+
+	scheduler->output_frame.notify = scheduler_handle_output_frame;
+	wl_signal_add(&output->events.frame, &scheduler->output_frame);
+	scheduler->output_present.notify = scheduler_handle_output_present;
+	wl_signal_add(&output->events.present, &scheduler->output_present);
+	scheduler->scene_output_destroy.notify = scheduler_handle_scene_output_destroy;
+	wl_signal_add(&scene_output->events.destroy, &scheduler->scene_output_destroy);
+
+	return scheduler;
+}
+
+void wlr_scene_frame_scheduler_destroy(struct wlr_scene_frame_scheduler *scheduler) {
+	if (scheduler == NULL) {
+		return;
+	}
+
+	wl_signal_emit_mutable(&scheduler->events.destroy, NULL);
+
+	wl_event_source_remove(scheduler->delay_timer);
+	wlr_scene_timer_finish(&scheduler->timer);
+	wl_list_remove(&scheduler->output_frame.link);
+	wl_list_remove(&scheduler->output_present.link);
+	wl_list_remove(&scheduler->scene_output_destroy.link);
+	free(scheduler);
+}
@@ -63,6 +63,54 @@ static void layer_surface_exclusive_zone(
 	}
 }
 
+static bool arrange_cache_matches(
+		struct wlr_scene_layer_surface_v1 *scene_layer_surface,
+		const struct wlr_box *full_area, const struct wlr_box *usable_area) {
+	struct wlr_layer_surface_v1 *layer_surface =
+		scene_layer_surface->layer_surface;
+	struct wlr_layer_surface_v1_state *state = &layer_surface->current;
+
+	// The initial commit always needs a configure event
+	if (!scene_layer_surface->arrange_cache.valid ||
+			layer_surface->initial_commit) {
+		return false;
+	}
+
+	return scene_layer_surface->arrange_cache.mapped ==
+			layer_surface->surface->mapped &&
+		scene_layer_surface->arrange_cache.anchor == state->anchor &&
+		scene_layer_surface->arrange_cache.exclusive_zone == state->exclusive_zone &&
+		scene_layer_surface->arrange_cache.margin_top == state->margin.top &&
+		scene_layer_surface->arrange_cache.margin_right == state->margin.right &&
+		scene_layer_surface->arrange_cache.margin_bottom == state->margin.bottom &&
+		scene_layer_surface->arrange_cache.margin_left == state->margin.left &&
+		scene_layer_surface->arrange_cache.desired_width == state->desired_width &&
+		scene_layer_surface->arrange_cache.desired_height == state->desired_height &&
+		wlr_box_equal(&scene_layer_surface->arrange_cache.full_area, full_area) &&
+		wlr_box_equal(&scene_layer_surface->arrange_cache.usable_area, usable_area);
+}
+
+static void arrange_cache_update_inputs(
+		struct wlr_scene_layer_surface_v1 *scene_layer_surface,
+		const struct wlr_box *full_area, const struct wlr_box *usable_area) {
+	struct wlr_layer_surface_v1 *layer_surface =
+		scene_layer_surface->layer_surface;
+	struct wlr_layer_surface_v1_state *state = &layer_surface->current;
+
+	scene_layer_surface->arrange_cache.valid = true;
+	scene_layer_surface->arrange_cache.mapped = layer_surface->surface->mapped;
+	scene_layer_surface->arrange_cache.anchor = state->anchor;
+	scene_layer_surface->arrange_cache.exclusive_zone = state->exclusive_zone;
+	scene_layer_surface->arrange_cache.margin_top = state->margin.top;
+	scene_layer_surface->arrange_cache.margin_right = state->margin.right;
+	scene_layer_surface->arrange_cache.margin_bottom = state->margin.bottom;
+	scene_layer_surface->arrange_cache.margin_left = state->margin.left;
+	scene_layer_surface->arrange_cache.desired_width = state->desired_width;
+	scene_layer_surface->arrange_cache.desired_height = state->desired_height;
+	scene_layer_surface->arrange_cache.full_area = *full_area;
+	scene_layer_surface->arrange_cache.usable_area = *usable_area;
+}
+
 void wlr_scene_layer_surface_v1_configure(
 		struct wlr_scene_layer_surface_v1 *scene_layer_surface,
 		const struct wlr_box *full_area, struct wlr_box *usable_area) {
@@ -70,6 +118,17 @@ void wlr_scene_layer_surface_v1_configure(
 		scene_layer_surface->layer_surface;
 	struct wlr_layer_surface_v1_state *state = &layer_surface->current;
 
+	if (arrange_cache_matches(scene_layer_surface, full_area, usable_area)) {
+		// The layer surface already has the right size, don't send another
+		// configure event
+		const struct wlr_box *box = &scene_layer_surface->arrange_cache.box;
+		wlr_scene_node_set_position(&scene_layer_surface->tree->node,
+			box->x, box->y);
+		*usable_area = scene_layer_surface->arrange_cache.result_usable_area;
+		return;
+	}
+	arrange_cache_update_inputs(scene_layer_surface, full_area, usable_area);
+
 	// If the exclusive zone is set to -1, the layer surface will use the
 	// full area of the output, otherwise it is constrained to the
 	// remaining usable area.
@@ -123,6 +182,9 @@ void wlr_scene_layer_surface_v1_configure(
 	if (layer_surface->surface->mapped && state->exclusive_zone > 0) {
 		layer_surface_exclusive_zone(state, usable_area);
 	}
+
+	scene_layer_surface->arrange_cache.box = box;
+	scene_layer_surface->arrange_cache.result_usable_area = *usable_area;
 }
 
 struct wlr_scene_layer_surface_v1 *wlr_scene_layer_surface_v1_create(
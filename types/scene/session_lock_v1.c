@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_session_lock_v1.h>
+#include <wlr/util/log.h>
+#include "types/wlr_scene.h"
+
+struct wlr_scene_session_lock_v1 {
+	struct wlr_scene_tree *tree;
+	struct wlr_session_lock_v1 *lock; // NULL once the lock is destroyed
+	struct wlr_scene *scene;
+
+	struct wl_list hidden_nodes; // scene_lock_hidden_node.link
+	struct wl_list surfaces; // scene_lock_surface.link
+
+	struct wl_listener tree_destroy;
+	struct wl_listener lock_new_surface;
+	struct wl_listener lock_unlock;
+	struct wl_listener lock_destroy;
+};
+
+// A node disabled by us while the session is locked
+struct scene_lock_hidden_node {
+	struct wlr_scene_node *node;
+	struct wl_list link; // wlr_scene_session_lock_v1.hidden_nodes
+
+	struct wl_listener node_destroy;
+};
+
+struct scene_lock_surface {
+	struct wlr_scene_session_lock_v1 *scene_lock;
+	struct wlr_session_lock_surface_v1 *lock_surface;
+	struct wlr_scene_tree *surface_tree;
+	struct wl_list link; // wlr_scene_session_lock_v1.surfaces
+
+	struct wl_listener tree_destroy;
+	struct wl_listener surface_commit;
+};
+
+static void hidden_node_destroy(struct scene_lock_hidden_node *hidden) {
+	wl_list_remove(&hidden->node_destroy.link);
+	wl_list_remove(&hidden->link);
+	free(hidden);
+}
+
+static void hidden_node_handle_node_destroy(struct wl_listener *listener,
+		void *data) {
+	struct scene_lock_hidden_node *hidden =
+		wl_container_of(listener, hidden, node_destroy);
+	hidden_node_destroy(hidden);
+}
+
+static void scene_lock_hide_node(struct wlr_scene_session_lock_v1 *scene_lock,
+		struct wlr_scene_node *node) {
+	if (!node->enabled) {
+		return;
+	}
+
+	struct scene_lock_hidden_node *hidden = calloc(1, sizeof(*hidden));
+	if (hidden == NULL) {
+		// Never leave content visible behind the lock
+		wlr_log(WLR_ERROR, "Allocation failed");
+		wlr_scene_node_set_enabled(node, false);
+		return;
+	}
+
+	hidden->node = node;
+	hidden->node_destroy.notify = hidden_node_handle_node_destroy;
+	wl_signal_add(&node->events.destroy, &hidden->node_destroy);
+	wl_list_insert(&scene_lock->hidden_nodes, &hidden->link);
+
+	wlr_scene_node_set_enabled(node, false);
+}
+
+// Disable every node which isn't an ancestor or a descendant of the lock tree
+static void scene_lock_hide_content(struct wlr_scene_session_lock_v1 *scene_lock) {
+	struct wlr_scene_node *node = &scene_lock->tree->node;
+	while (node->parent != NULL) {
+		struct wlr_scene_node *sibling;
+		wl_list_for_each(sibling, &node->parent->children, link) {
+			if (sibling != node) {
+				scene_lock_hide_node(scene_lock, sibling);
+			}
+		}
+		node = &node->parent->node;
+	}
+}
+
+static void scene_lock_show_content(struct wlr_scene_session_lock_v1 *scene_lock) {
+	struct scene_lock_hidden_node *hidden, *tmp;
+	wl_list_for_each_safe(hidden, tmp, &scene_lock->hidden_nodes, link) {
+		wlr_scene_node_set_enabled(hidden->node, true);
+		hidden_node_destroy(hidden);
+	}
+}
+
+static void lock_surface_update_position(struct scene_lock_surface *surface) {
+	struct wlr_scene_output *scene_output = wlr_scene_get_scene_output(
+		surface->scene_lock->scene, surface->lock_surface->output);
+	if (scene_output == NULL) {
+		wlr_scene_node_set_enabled(&surface->surface_tree->node, false);
+		return;
+	}
+
+	wlr_scene_node_set_position(&surface->surface_tree->node,
+		scene_output->x, scene_output->y);
+	wlr_scene_node_set_enabled(&surface->surface_tree->node, true);
+}
+
+static void lock_surface_handle_tree_destroy(struct wl_listener *listener,
+		void *data) {
+	struct scene_lock_surface *surface =
+		wl_container_of(listener, surface, tree_destroy);
+	wl_list_remove(&surface->tree_destroy.link);
+	wl_list_remove(&surface->surface_commit.link);
+	wl_list_remove(&surface->link);
+	free(surface);
+}
+
+static void lock_surface_handle_surface_commit(struct wl_listener *listener,
+		void *data) {
+	struct scene_lock_surface *surface =
+		wl_container_of(listener, surface, surface_commit);
+	lock_surface_update_position(surface);
+}
+
+static void scene_lock_add_surface(struct wlr_scene_session_lock_v1 *scene_lock,
+		struct wlr_session_lock_surface_v1 *lock_surface) {
+	struct scene_lock_surface *surface = calloc(1, sizeof(*surface));
+	if (surface == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return;
+	}
+
+	// Destroyed along with the wlr_surface
+	surface->surface_tree = wlr_scene_subsurface_tree_create(
+		scene_lock->tree, lock_surface->surface);
+	if (surface->surface_tree == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create lock surface scene tree");
+		free(surface);
+		return;
+	}
+
+	surface->scene_lock = scene_lock;
+	surface->lock_surface = lock_surface;
+	wl_list_insert(&scene_lock->surfaces, &surface->link);
+
+	surface->tree_destroy.notify = lock_surface_handle_tree_destroy;
+	wl_signal_add(&surface->surface_tree->node.events.destroy,
+		&surface->tree_destroy);
+	surface->surface_commit.notify = lock_surface_handle_surface_commit;
+	wl_signal_add(&lock_surface->surface->events.commit,
+		&surface->surface_commit);
+
+	lock_surface_update_position(surface);
+}
+
+static void scene_lock_finish_lock(struct wlr_scene_session_lock_v1 *scene_lock) {
+	if (scene_lock->lock == NULL) {
+		return;
+	}
+	wl_list_remove(&scene_lock->lock_new_surface.link);
+	wl_list_remove(&scene_lock->lock_unlock.link);
+	wl_list_remove(&scene_lock->lock_destroy.link);
+	scene_lock->lock = NULL;
+}
+
+static void scene_lock_handle_tree_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_session_lock_v1 *scene_lock =
+		wl_container_of(listener, scene_lock, tree_destroy);
+
+	// Our destroy signal fires before the children are destroyed
+	struct scene_lock_surface *surface, *tmp;
+	wl_list_for_each_safe(surface, tmp, &scene_lock->surfaces, link) {
+		wlr_scene_node_destroy(&surface->surface_tree->node);
+	}
+
+	scene_lock_show_content(scene_lock);
+	scene_lock_finish_lock(scene_lock);
+	wl_list_remove(&scene_lock->tree_destroy.link);
+	free(scene_lock);
+}
+
+static void scene_lock_handle_new_surface(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_session_lock_v1 *scene_lock =
+		wl_container_of(listener, scene_lock, lock_new_surface);
+	struct wlr_session_lock_surface_v1 *lock_surface = data;
+	scene_lock_add_surface(scene_lock, lock_surface);
+}
+
+static void scene_lock_handle_unlock(struct wl_listener *listener, void *data) {
+	struct wlr_scene_session_lock_v1 *scene_lock =
+		wl_container_of(listener, scene_lock, lock_unlock);
+	wlr_scene_node_destroy(&scene_lock->tree->node);
+}
+
+static void scene_lock_handle_lock_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_session_lock_v1 *scene_lock =
+		wl_container_of(listener, scene_lock, lock_destroy);
+	// The client went away without unlocking: the session must stay locked,
+	// so keep the content hidden until the compositor destroys the tree
+	scene_lock_finish_lock(scene_lock);
+}
+
+struct wlr_scene_tree *wlr_scene_session_lock_v1_create(
+		struct wlr_scene_tree *parent, struct wlr_session_lock_v1 *lock) {
+	struct wlr_scene_session_lock_v1 *scene_lock = calloc(1, sizeof(*scene_lock));
+	if (scene_lock == NULL) {
+		return NULL;
+	}
+
+	scene_lock->tree = wlr_scene_tree_create(parent);
+	if (scene_lock->tree == NULL) {
+		free(scene_lock);
+		return NULL;
+	}
+
+	scene_lock->lock = lock;
+	scene_lock->scene = scene_node_get_root(&parent->node);
+	wl_list_init(&scene_lock->hidden_nodes);
+	wl_list_init(&scene_lock->surfaces);
+
+	scene_lock->tree_destroy.notify = scene_lock_handle_tree_destroy;
+	wl_signal_add(&scene_lock->tree->node.events.destroy,
+		&scene_lock->tree_destroy);
+	scene_lock->lock_new_surface.notify = scene_lock_handle_new_surface;
+	wl_signal_add(&lock->events.new_surface, &scene_lock->lock_new_surface);
+	scene_lock->lock_unlock.notify = scene_lock_handle_unlock;
+	wl_signal_add(&lock->events.unlock, &scene_lock->lock_unlock);
+	scene_lock->lock_destroy.notify = scene_lock_handle_lock_destroy;
+	wl_signal_add(&lock->events.destroy, &scene_lock->lock_destroy);
+
+	struct wlr_session_lock_surface_v1 *lock_surface;
+	wl_list_for_each(lock_surface, &lock->surfaces, link) {
+		scene_lock_add_surface(scene_lock, lock_surface);
+	}
+
+	scene_lock_hide_content(scene_lock);
+
+	return scene_lock->tree;
+}
@@ -159,8 +159,12 @@ static void subsurface_tree_handle_surface_commit(struct wl_listener *listener,
 	struct wlr_scene_subsurface_tree *subsurface_tree =
 		wl_container_of(listener, subsurface_tree, surface_commit);
 
-	// TODO: only do this on subsurface order or position change
-	subsurface_tree_reconfigure(subsurface_tree);
+	if (subsurface_tree->surface->current.committed & WLR_SURFACE_STATE_SUBSURFACES) {
+		subsurface_tree_reconfigure(subsurface_tree);
+	} else {
+		// Sub-surfaces are unchanged, but the clipped surface size may not be
+		subsurface_tree_reconfigure_clip(subsurface_tree);
+	}
 }
 
 static void subsurface_tree_handle_subsurface_destroy(struct wl_listener *listener,
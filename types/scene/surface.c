@@ -102,6 +102,48 @@ static int min(int a, int b) {
 	return a < b ? a : b;
 }
 
+static float surface_get_opacity(struct wlr_surface *surface) {
+	const struct wlr_alpha_modifier_surface_v1_state *alpha_modifier_state =
+		wlr_alpha_modifier_v1_get_surface_state(surface);
+	if (alpha_modifier_state != NULL) {
+		return (float)alpha_modifier_state->multiplier;
+	}
+	return 1.0;
+}
+
+static void surface_update_buffer(struct wlr_scene_surface *scene_surface) {
+	struct wlr_scene_buffer *scene_buffer = scene_surface->buffer;
+	struct wlr_surface *surface = scene_surface->surface;
+
+	scene_buffer_unmark_client_buffer(scene_buffer);
+
+	client_buffer_mark_next_can_damage(surface->buffer);
+
+	struct wlr_linux_drm_syncobj_surface_v1_state *syncobj_surface_state =
+		wlr_linux_drm_syncobj_v1_get_surface_state(surface);
+
+	struct wlr_drm_syncobj_timeline *wait_timeline = NULL;
+	uint64_t wait_point = 0;
+	if (syncobj_surface_state != NULL) {
+		wait_timeline = syncobj_surface_state->acquire_timeline;
+		wait_point = syncobj_surface_state->acquire_point;
+	}
+
+	struct wlr_scene_buffer_set_buffer_options options = {
+		.damage = &surface->buffer_damage,
+		.wait_timeline = wait_timeline,
+		.wait_point = wait_point,
+	};
+	wlr_scene_buffer_set_buffer_with_options(scene_buffer,
+		&surface->buffer->base, &options);
+
+	if (syncobj_surface_state != NULL &&
+			(surface->current.committed & WLR_SURFACE_STATE_BUFFER)) {
+		wlr_linux_drm_syncobj_v1_state_signal_release_with_buffer(syncobj_surface_state,
+			&surface->buffer->base);
+	}
+}
+
 static void surface_reconfigure(struct wlr_scene_surface *scene_surface) {
 	struct wlr_scene_buffer *scene_buffer = scene_surface->buffer;
 	struct wlr_surface *surface = scene_surface->surface;
@@ -141,67 +183,79 @@ static void surface_reconfigure(struct wlr_scene_surface *scene_surface) {
 		pixman_region32_intersect_rect(&opaque, &opaque, 0, 0, width, height);
 	}
 
+	scene_surface->buffer_width = scene_surface->buffer_height = 0;
+
 	if (width <= 0 || height <= 0) {
 		wlr_scene_buffer_set_buffer(scene_buffer, NULL);
 		pixman_region32_fini(&opaque);
 		return;
 	}
 
-	float opacity = 1.0;
-	const struct wlr_alpha_modifier_surface_v1_state *alpha_modifier_state =
-		wlr_alpha_modifier_v1_get_surface_state(surface);
-	if (alpha_modifier_state != NULL) {
-		opacity = (float)alpha_modifier_state->multiplier;
-	}
-
 	wlr_scene_buffer_set_opaque_region(scene_buffer, &opaque);
 	wlr_scene_buffer_set_source_box(scene_buffer, &src_box);
 	wlr_scene_buffer_set_dest_size(scene_buffer, width, height);
 	wlr_scene_buffer_set_transform(scene_buffer, state->transform);
-	wlr_scene_buffer_set_opacity(scene_buffer, opacity);
-
-	scene_buffer_unmark_client_buffer(scene_buffer);
+	wlr_scene_buffer_set_opacity(scene_buffer, surface_get_opacity(surface));
 
 	if (surface->buffer) {
-		client_buffer_mark_next_can_damage(surface->buffer);
-
-		struct wlr_linux_drm_syncobj_surface_v1_state *syncobj_surface_state =
-			wlr_linux_drm_syncobj_v1_get_surface_state(surface);
-
-		struct wlr_drm_syncobj_timeline *wait_timeline = NULL;
-		uint64_t wait_point = 0;
-		if (syncobj_surface_state != NULL) {
-			wait_timeline = syncobj_surface_state->acquire_timeline;
-			wait_point = syncobj_surface_state->acquire_point;
-		}
-
-		struct wlr_scene_buffer_set_buffer_options options = {
-			.damage = &surface->buffer_damage,
-			.wait_timeline = wait_timeline,
-			.wait_point = wait_point,
-		};
-		wlr_scene_buffer_set_buffer_with_options(scene_buffer,
-			&surface->buffer->base, &options);
-
-		if (syncobj_surface_state != NULL &&
-				(surface->current.committed & WLR_SURFACE_STATE_BUFFER)) {
-			wlr_linux_drm_syncobj_v1_state_signal_release_with_buffer(syncobj_surface_state,
-				&surface->buffer->base);
-		}
+		surface_update_buffer(scene_surface);
+		scene_surface->buffer_width = state->buffer_width;
+		scene_surface->buffer_height = state->buffer_height;
 	} else {
+		scene_buffer_unmark_client_buffer(scene_buffer);
 		wlr_scene_buffer_set_buffer(scene_buffer, NULL);
 	}
 
 	pixman_region32_fini(&opaque);
 }
 
+/**
+ * Check whether the last commit only changed the contents of the surface,
+ * leaving the geometry computed by surface_reconfigure() untouched.
+ */
+static bool surface_commit_is_content_only(struct wlr_scene_surface *scene_surface) {
+	struct wlr_surface *surface = scene_surface->surface;
+	struct wlr_surface_state *state = &surface->current;
+
+	uint32_t content_fields = WLR_SURFACE_STATE_BUFFER |
+		WLR_SURFACE_STATE_SURFACE_DAMAGE | WLR_SURFACE_STATE_BUFFER_DAMAGE |
+		WLR_SURFACE_STATE_FRAME_CALLBACK_LIST | WLR_SURFACE_STATE_OFFSET |
+		WLR_SURFACE_STATE_SUBSURFACES;
+	if ((state->committed & ~content_fields) != 0) {
+		return false;
+	}
+
+	// The source box and destination size depend on the buffer size
+	if (surface->buffer == NULL || scene_surface->buffer_width == 0 ||
+			state->buffer_width != scene_surface->buffer_width ||
+			state->buffer_height != scene_surface->buffer_height) {
+		return false;
+	}
+
+	// Some state isn't tracked by the committed fields: the alpha modifier
+	// and the opaque region, which also depends on the buffer format
+	struct wlr_scene_buffer *scene_buffer = scene_surface->buffer;
+	return wlr_box_empty(&scene_surface->clip) &&
+		surface_get_opacity(surface) == scene_buffer->opacity &&
+		pixman_region32_equal(&surface->opaque_region, &scene_buffer->opaque_region);
+}
+
 static void handle_scene_surface_surface_commit(
 		struct wl_listener *listener, void *data) {
 	struct wlr_scene_surface *surface =
 		wl_container_of(listener, surface, surface_commit);
 	struct wlr_scene_buffer *scene_buffer = surface->buffer;
 
-	surface_reconfigure(surface);
+	if (surface_commit_is_content_only(surface)) {
+		// Fast path for clients re-rendering every frame: only swap the
+		// buffer, the node geometry and input region are unchanged
+		surface_update_buffer(surface);
+	} else {
+		surface_reconfigure(surface);
+
+		// The input region may have changed
+		scene_invalidate_node_at_cache(scene_node_get_root(&scene_buffer->node));
+	}
 
 	// If the surface has requested a frame done event, honour that. The
 	// frame_callback_list will be populated in this case. We should only
@@ -228,6 +282,39 @@ static bool scene_buffer_point_accepts_input(struct wlr_scene_buffer *scene_buff
 	return wlr_surface_point_accepts_input(scene_surface->surface, *sx, *sy);
 }
 
+bool scene_buffer_get_input_box(struct wlr_scene_buffer *scene_buffer,
+		int x, int y, struct wlr_box *box) {
+	// A custom callback may reject any point
+	if (scene_buffer->point_accepts_input != scene_buffer_point_accepts_input) {
+		return false;
+	}
+
+	struct wlr_scene_surface *scene_surface =
+		wlr_scene_surface_try_from_buffer(scene_buffer);
+	struct wlr_surface *surface = scene_surface->surface;
+	struct wlr_box *clip = &scene_surface->clip;
+
+	pixman_box32_t rect;
+	if (!pixman_region32_contains_point(&surface->input_region,
+			x + clip->x, y + clip->y, &rect)) {
+		return false;
+	}
+
+	struct wlr_box input_box = {
+		.x = rect.x1 - clip->x,
+		.y = rect.y1 - clip->y,
+		.width = rect.x2 - rect.x1,
+		.height = rect.y2 - rect.y1,
+	};
+	struct wlr_box surface_box = {
+		.x = -clip->x,
+		.y = -clip->y,
+		.width = surface->current.width,
+		.height = surface->current.height,
+	};
+	return wlr_box_intersection(box, &input_box, &surface_box);
+}
+
 static void surface_addon_destroy(struct wlr_addon *addon) {
 	struct wlr_scene_surface *surface = wl_container_of(addon, surface, addon);
 
@@ -1,25 +1,41 @@
 #include <assert.h>
+#include <drm_fourcc.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <wlr/backend.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/color.h>
 #include <wlr/render/swapchain.h>
 #include <wlr/render/drm_syncobj.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_content_type_v1.h>
 #include <wlr/types/wlr_damage_ring.h>
 #include <wlr/types/wlr_gamma_control_v1.h>
 #include <wlr/types/wlr_linux_dmabuf_v1.h>
+#include <wlr/types/wlr_output_layer.h>
 #include <wlr/types/wlr_presentation_time.h>
 #include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_single_pixel_buffer_v1.h>
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
 #include <wlr/util/transform.h>
+#include "render/color.h"
+#include "render/drm_format_set.h"
+#include "render/texture_atlas.h"
+#include "render/wlr_renderer.h"
 #include "types/wlr_buffer.h"
 #include "types/wlr_output.h"
 #include "types/wlr_scene.h"
 #include "util/array.h"
 #include "util/env.h"
+#include "util/pool.h"
+#include "util/rect_union.h"
+#include "util/thread_pool.h"
 #include "util/time.h"
+#include "util/trace.h"
 
 #include <wlr/config.h>
 
@@ -29,6 +45,20 @@
 
 #define HIGHLIGHT_DAMAGE_FADEOUT_TIME 250
 
+// Overdraw levels shown by the heatmap, the last one means "at least"
+#define OVERDRAW_LEVELS 4
+#define OVERDRAW_SUMMARY_INTERVAL_MS 1000
+
+#define SCENE_OUTPUT_MAX_LAYERS 3
+
+// Another output needs to display this much more of a buffer than its primary
+// output to become the primary output, in percent
+#define PRIMARY_OUTPUT_HYSTERESIS 25
+
+#define TEXTURE_EVICTION_INTERVAL_MS 1000
+// Buffers hidden for less than this keep their texture
+#define TEXTURE_EVICTION_DELAY_MS 5000
+
 struct wlr_scene_tree *wlr_scene_tree_from_node(struct wlr_scene_node *node) {
 	assert(node->type == WLR_SCENE_NODE_TREE);
 	struct wlr_scene_tree *tree = wl_container_of(node, tree, node);
@@ -63,18 +93,49 @@ struct wlr_scene *scene_node_get_root(struct wlr_scene_node *node) {
 	return scene;
 }
 
+struct wlr_scene_node_pools {
+	struct object_pool trees, rects, buffers;
+};
+
+static struct object_pool *scene_get_node_pool(struct wlr_scene *scene,
+		enum wlr_scene_node_type type) {
+	struct wlr_scene_node_pools *pools = scene->node_pools;
+	switch (type) {
+	case WLR_SCENE_NODE_TREE:
+		return &pools->trees;
+	case WLR_SCENE_NODE_RECT:
+		return &pools->rects;
+	case WLR_SCENE_NODE_BUFFER:
+		return &pools->buffers;
+	}
+	abort(); // unreachable
+}
+
+static void *scene_node_alloc(struct wlr_scene_tree *parent,
+		enum wlr_scene_node_type type, size_t size) {
+	struct wlr_scene *scene = scene_node_get_root(&parent->node);
+	if (!scene->node_pooling) {
+		return calloc(1, size);
+	}
+	return object_pool_alloc(scene_get_node_pool(scene, type));
+}
+
 static void scene_node_init(struct wlr_scene_node *node,
 		enum wlr_scene_node_type type, struct wlr_scene_tree *parent) {
+	struct wlr_scene *scene = parent != NULL ?
+		scene_node_get_root(&parent->node) : NULL;
 	*node = (struct wlr_scene_node){
 		.type = type,
 		.parent = parent,
 		.enabled = true,
+		.pooled = scene != NULL && scene->node_pooling,
 	};
 
 	wl_list_init(&node->link);
 
 	wl_signal_init(&node->events.destroy);
 	pixman_region32_init(&node->visible);
+	pixman_region32_init(&node->opaque);
 
 	if (parent != NULL) {
 		wl_list_insert(parent->children.prev, &node->link);
@@ -94,6 +155,67 @@ static void scene_buffer_set_buffer(struct wlr_scene_buffer *scene_buffer,
 static void scene_buffer_set_texture(struct wlr_scene_buffer *scene_buffer,
 	struct wlr_texture *texture);
 
+struct wlr_scene_tree_cache {
+	struct wlr_buffer *buffer;
+	struct wlr_texture *texture;
+	struct wlr_renderer *renderer;
+	float scale;
+	// Area of the tree covered by the buffer, relative to the tree
+	struct wlr_box box;
+
+	// Area which needs to be re-rendered, relative to the tree
+	pixman_region32_t damage;
+	bool dirty; // the whole buffer needs to be re-rendered
+
+	struct wl_listener renderer_destroy;
+};
+
+struct wlr_scene_tree_capture {
+	struct wlr_scene_tree *tree; // NULL if the tree has been destroyed
+	struct wl_list link; // wlr_scene_tree.captures
+
+	float scale;
+	// Area of the tree covered by the buffers, relative to the tree
+	struct wlr_box box;
+
+	// Damage since the last render, relative to the tree
+	pixman_region32_t damage;
+	bool dirty; // everything needs to be re-rendered
+
+	// Buffer-local damage of each capture buffer
+	struct wlr_damage_ring ring;
+};
+
+static void scene_tree_cache_release(struct wlr_scene_tree_cache *cache) {
+	wlr_texture_destroy(cache->texture);
+	cache->texture = NULL;
+	wlr_buffer_drop(cache->buffer);
+	cache->buffer = NULL;
+
+	wl_list_remove(&cache->renderer_destroy.link);
+	wl_list_init(&cache->renderer_destroy.link);
+	cache->renderer = NULL;
+	cache->dirty = true;
+}
+
+static void scene_tree_cache_handle_renderer_destroy(
+		struct wl_listener *listener, void *data) {
+	struct wlr_scene_tree_cache *cache =
+		wl_container_of(listener, cache, renderer_destroy);
+	scene_tree_cache_release(cache);
+}
+
+static void scene_tree_cache_destroy(struct wlr_scene_tree_cache *cache) {
+	if (cache == NULL) {
+		return;
+	}
+
+	scene_tree_cache_release(cache);
+	wl_list_remove(&cache->renderer_destroy.link);
+	pixman_region32_fini(&cache->damage);
+	free(cache);
+}
+
 void wlr_scene_node_destroy(struct wlr_scene_node *node) {
 	if (node == NULL) {
 		return;
@@ -111,7 +233,10 @@ void wlr_scene_node_destroy(struct wlr_scene_node *node) {
 	if (node->type == WLR_SCENE_NODE_BUFFER) {
 		struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
 
-		uint64_t active = scene_buffer->active_outputs;
+		// Pending output changes are dropped, only the outputs clients have
+		// been told about need to be left
+		wl_list_remove(&scene_buffer->outputs_update_link);
+		uint64_t active = scene_buffer->sent_active_outputs;
 		if (active) {
 			struct wlr_scene_output *scene_output;
 			wl_list_for_each(scene_output, &scene->outputs, link) {
@@ -145,6 +270,10 @@ void wlr_scene_node_destroy(struct wlr_scene_node *node) {
 			wl_list_remove(&scene->linux_dmabuf_v1_destroy.link);
 			wl_list_remove(&scene->gamma_control_manager_v1_destroy.link);
 			wl_list_remove(&scene->gamma_control_manager_v1_set_gamma.link);
+			wl_list_remove(&scene->content_type_manager_v1_destroy.link);
+			wl_list_remove(&scene->atlas_renderer_destroy.link);
+			texture_atlas_destroy(scene->atlas);
+			thread_pool_destroy(scene->render_list_pool);
 		} else {
 			assert(node->parent);
 		}
@@ -154,12 +283,34 @@ void wlr_scene_node_destroy(struct wlr_scene_node *node) {
 				&scene_tree->children, link) {
 			wlr_scene_node_destroy(child);
 		}
+
+		scene_tree_cache_destroy(scene_tree->cache);
+
+		struct wlr_scene_tree_capture *capture, *capture_tmp;
+		wl_list_for_each_safe(capture, capture_tmp, &scene_tree->captures, link) {
+			capture->tree = NULL;
+			wl_list_remove(&capture->link);
+			wl_list_init(&capture->link);
+		}
 	}
 
 	assert(wl_list_empty(&node->events.destroy.listener_list));
 
 	wl_list_remove(&node->link);
 	pixman_region32_fini(&node->visible);
+	pixman_region32_fini(&node->opaque);
+
+	if (node->pooled) {
+		object_pool_free(scene_get_node_pool(scene, node->type), node);
+		return;
+	}
+	if (node == &scene->tree.node && scene->node_pools != NULL) {
+		// All pooled nodes are gone along with the children
+		object_pool_finish(&scene->node_pools->trees);
+		object_pool_finish(&scene->node_pools->rects);
+		object_pool_finish(&scene->node_pools->buffers);
+		free(scene->node_pools);
+	}
 	free(node);
 }
 
@@ -168,6 +319,7 @@ static void scene_tree_init(struct wlr_scene_tree *tree,
 	*tree = (struct wlr_scene_tree){0};
 	scene_node_init(&tree->node, WLR_SCENE_NODE_TREE, parent);
 	wl_list_init(&tree->children);
+	wl_list_init(&tree->captures);
 }
 
 struct wlr_scene *wlr_scene_create(void) {
@@ -179,29 +331,67 @@ struct wlr_scene *wlr_scene_create(void) {
 	scene_tree_init(&scene->tree, NULL);
 
 	wl_list_init(&scene->outputs);
+	wl_list_init(&scene->outputs_update_queue);
 	wl_list_init(&scene->linux_dmabuf_v1_destroy.link);
 	wl_list_init(&scene->gamma_control_manager_v1_destroy.link);
 	wl_list_init(&scene->gamma_control_manager_v1_set_gamma.link);
+	wl_list_init(&scene->content_type_manager_v1_destroy.link);
+	wl_list_init(&scene->atlas_renderer_destroy.link);
 
 	const char *debug_damage_options[] = {
 		"none",
 		"rerender",
 		"highlight",
+		"overdraw",
 		NULL
 	};
 
 	scene->debug_damage_option = env_parse_switch("WLR_SCENE_DEBUG_DAMAGE", debug_damage_options);
 	scene->direct_scanout = !env_parse_bool("WLR_SCENE_DISABLE_DIRECT_SCANOUT");
+	scene->output_layers = !env_parse_bool("WLR_SCENE_DISABLE_OUTPUT_LAYERS");
+	scene->texture_atlas = !env_parse_bool("WLR_SCENE_DISABLE_TEXTURE_ATLAS");
 	scene->calculate_visibility = !env_parse_bool("WLR_SCENE_DISABLE_VISIBILITY");
 	scene->highlight_transparent_region = env_parse_bool("WLR_SCENE_HIGHLIGHT_TRANSPARENT_REGION");
 
 	return scene;
 }
 
+void wlr_scene_set_hidden_frame_interval(struct wlr_scene *scene,
+		int interval_ms) {
+	assert(interval_ms >= 0);
+	scene->hidden_frame_interval_ms = interval_ms;
+}
+
+void wlr_scene_set_render_cost_tracking(struct wlr_scene *scene, bool enabled) {
+	scene->render_cost_tracking = enabled;
+}
+
+void wlr_scene_set_texture_budget(struct wlr_scene *scene, size_t budget) {
+	scene->texture_budget = budget;
+}
+
+void wlr_scene_set_node_pooling(struct wlr_scene *scene, bool enabled) {
+	if (enabled && scene->node_pools == NULL) {
+		struct wlr_scene_node_pools *pools = calloc(1, sizeof(*pools));
+		if (pools == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			return;
+		}
+		object_pool_init(&pools->trees, sizeof(struct wlr_scene_tree));
+		object_pool_init(&pools->rects, sizeof(struct wlr_scene_rect));
+		object_pool_init(&pools->buffers, sizeof(struct wlr_scene_buffer));
+		scene->node_pools = pools;
+	}
+	// The pools are kept until the scene is destroyed, for the nodes already
+	// allocated from them
+	scene->node_pooling = enabled;
+}
+
 struct wlr_scene_tree *wlr_scene_tree_create(struct wlr_scene_tree *parent) {
 	assert(parent);
 
-	struct wlr_scene_tree *tree = calloc(1, sizeof(*tree));
+	struct wlr_scene_tree *tree =
+		scene_node_alloc(parent, WLR_SCENE_NODE_TREE, sizeof(*tree));
 	if (tree == NULL) {
 		return NULL;
 	}
@@ -210,8 +400,179 @@ struct wlr_scene_tree *wlr_scene_tree_create(struct wlr_scene_tree *parent) {
 	return tree;
 }
 
+static void scene_invalidate_render_lists(struct wlr_scene *scene);
+
+void wlr_scene_tree_set_cached(struct wlr_scene_tree *tree, bool cached) {
+	if ((tree->cache != NULL) == cached) {
+		return;
+	}
+
+	if (cached) {
+		struct wlr_scene_tree_cache *cache = calloc(1, sizeof(*cache));
+		if (cache == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			return;
+		}
+
+		pixman_region32_init(&cache->damage);
+		wl_list_init(&cache->renderer_destroy.link);
+		cache->renderer_destroy.notify = scene_tree_cache_handle_renderer_destroy;
+		cache->dirty = true;
+		tree->cache = cache;
+	} else {
+		scene_tree_cache_destroy(tree->cache);
+		tree->cache = NULL;
+	}
+
+	// The sub-tree changes from many render list entries to a single one
+	scene_invalidate_render_lists(scene_node_get_root(&tree->node));
+}
+
+/**
+ * Mark a box relative to the node as needing to be re-rendered in the caches
+ * of the trees above it. A NULL box damages the caches as a whole.
+ */
+static void scene_node_damage_tree_caches(struct wlr_scene_node *node,
+		const struct wlr_box *box) {
+	int x = node->x, y = node->y;
+	for (struct wlr_scene_tree *tree = node->parent; tree != NULL;
+			tree = tree->node.parent) {
+		struct wlr_scene_tree_cache *cache = tree->cache;
+		if (cache != NULL) {
+			if (box == NULL) {
+				cache->dirty = true;
+			} else {
+				pixman_region32_union_rect(&cache->damage, &cache->damage,
+					x + box->x, y + box->y, box->width, box->height);
+			}
+		}
+
+		struct wlr_scene_tree_capture *capture;
+		wl_list_for_each(capture, &tree->captures, link) {
+			if (box == NULL) {
+				capture->dirty = true;
+			} else {
+				pixman_region32_union_rect(&capture->damage, &capture->damage,
+					x + box->x, y + box->y, box->width, box->height);
+			}
+		}
+
+		x += tree->node.x;
+		y += tree->node.y;
+	}
+}
+
 static void scene_node_get_size(struct wlr_scene_node *node, int *lx, int *ly);
 
+static void box_union(struct wlr_box *dst, const struct wlr_box *box) {
+	if (wlr_box_empty(box)) {
+		return;
+	}
+	if (wlr_box_empty(dst)) {
+		*dst = *box;
+		return;
+	}
+
+	int x1 = dst->x < box->x ? dst->x : box->x;
+	int y1 = dst->y < box->y ? dst->y : box->y;
+	int x2 = dst->x + dst->width > box->x + box->width ?
+		dst->x + dst->width : box->x + box->width;
+	int y2 = dst->y + dst->height > box->y + box->height ?
+		dst->y + dst->height : box->y + box->height;
+
+	*dst = (struct wlr_box){
+		.x = x1,
+		.y = y1,
+		.width = x2 - x1,
+		.height = y2 - y1,
+	};
+}
+
+/**
+ * Get the bounding box of a node and all of its descendants, relative to the
+ * node's parent.
+ */
+static void scene_node_get_bounds(struct wlr_scene_node *node,
+		struct wlr_box *box) {
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		*box = scene_tree->bounds;
+	} else {
+		*box = (struct wlr_box){0};
+		scene_node_get_size(node, &box->width, &box->height);
+	}
+
+	box->x += node->x;
+	box->y += node->y;
+}
+
+static bool box_contains_box(const struct wlr_box *outer,
+		const struct wlr_box *inner) {
+	return inner->x >= outer->x && inner->y >= outer->y &&
+		inner->x + inner->width <= outer->x + outer->width &&
+		inner->y + inner->height <= outer->y + outer->height;
+}
+
+static bool box_touches_edge(const struct wlr_box *bounds,
+		const struct wlr_box *box) {
+	return box->x <= bounds->x || box->y <= bounds->y ||
+		box->x + box->width >= bounds->x + bounds->width ||
+		box->y + box->height >= bounds->y + bounds->height;
+}
+
+/**
+ * Update the bounds of a tree after the box of one of its children changed
+ * from old to new. Returns false if the bounds are unchanged.
+ */
+static bool scene_tree_update_child_bounds(struct wlr_scene_tree *tree,
+		const struct wlr_box *old, const struct wlr_box *new) {
+	struct wlr_box bounds = tree->bounds;
+	if (wlr_box_empty(old) || !box_touches_edge(&bounds, old) ||
+			box_contains_box(new, old)) {
+		// The other children still span the current bounds
+		box_union(&bounds, new);
+	} else {
+		// The child may have been the only one reaching an edge
+		bounds = (struct wlr_box){0};
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &tree->children, link) {
+			box_union(&bounds, &child->parent_bounds);
+		}
+	}
+
+	if (wlr_box_equal(&tree->bounds, &bounds)) {
+		return false;
+	}
+	tree->bounds = bounds;
+	return true;
+}
+
+/**
+ * Update the part of its parent's bounds accounted for a node and propagate
+ * the change up to the root. Trees act as a bounding volume hierarchy: box
+ * queries skip whole sub-trees which don't intersect the box.
+ */
+static void scene_node_update_bounds(struct wlr_scene_node *node) {
+	while (node->parent != NULL) {
+		// A disabled node doesn't contribute to the bounds of its parent
+		struct wlr_box bounds = {0};
+		if (node->enabled) {
+			scene_node_get_bounds(node, &bounds);
+		}
+		if (wlr_box_equal(&node->parent_bounds, &bounds)) {
+			return;
+		}
+
+		struct wlr_box old = node->parent_bounds;
+		node->parent_bounds = bounds;
+		struct wlr_scene_tree *tree = node->parent;
+		if (!scene_tree_update_child_bounds(tree, &old, &bounds)) {
+			return;
+		}
+		node = &tree->node;
+	}
+}
+
 typedef bool (*scene_node_box_iterator_func_t)(struct wlr_scene_node *node,
 	int sx, int sy, void *data);
 
@@ -224,6 +585,13 @@ static bool _scene_nodes_in_box(struct wlr_scene_node *node, struct wlr_box *box
 	switch (node->type) {
 	case WLR_SCENE_NODE_TREE:;
 		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		struct wlr_box bounds = scene_tree->bounds;
+		bounds.x += lx;
+		bounds.y += ly;
+		if (!wlr_box_intersection(&bounds, &bounds, box)) {
+			break;
+		}
+
 		struct wlr_scene_node *child;
 		wl_list_for_each_reverse(child, &scene_tree->children, link) {
 			if (_scene_nodes_in_box(child, box, iterator, user_data, lx + child->x, ly + child->y)) {
@@ -254,11 +622,13 @@ static bool scene_nodes_in_box(struct wlr_scene_node *node, struct wlr_box *box,
 	return _scene_nodes_in_box(node, box, iterator, user_data, x, y);
 }
 
-static void scene_node_opaque_region(struct wlr_scene_node *node, int x, int y,
+static void scene_node_compute_opaque_region(struct wlr_scene_node *node,
 		pixman_region32_t *opaque) {
 	int width, height;
 	scene_node_get_size(node, &width, &height);
 
+	pixman_region32_clear(opaque);
+
 	if (node->type == WLR_SCENE_NODE_RECT) {
 		struct wlr_scene_rect *scene_rect = wlr_scene_rect_from_node(node);
 		if (scene_rect->color[3] != 1) {
@@ -276,15 +646,36 @@ static void scene_node_opaque_region(struct wlr_scene_node *node, int x, int y,
 		}
 
 		if (!scene_buffer->buffer_is_opaque) {
-			pixman_region32_copy(opaque, &scene_buffer->opaque_region);
-			pixman_region32_intersect_rect(opaque, opaque, 0, 0, width, height);
-			pixman_region32_translate(opaque, x, y);
+			pixman_region32_intersect_rect(opaque, &scene_buffer->opaque_region,
+				0, 0, width, height);
 			return;
 		}
 	}
 
-	pixman_region32_fini(opaque);
-	pixman_region32_init_rect(opaque, x, y, width, height);
+	pixman_region32_union_rect(opaque, opaque, 0, 0, width, height);
+}
+
+/**
+ * Mark the cached opaque region of a node as stale. This needs to be called
+ * whenever the size, opacity or opaque region of the node changes.
+ */
+static void scene_node_invalidate_opaque_region(struct wlr_scene_node *node) {
+	node->opaque_valid = false;
+}
+
+static const pixman_region32_t *scene_node_get_opaque_region(
+		struct wlr_scene_node *node) {
+	if (!node->opaque_valid) {
+		scene_node_compute_opaque_region(node, &node->opaque);
+		node->opaque_valid = true;
+	}
+	return &node->opaque;
+}
+
+static void scene_node_opaque_region(struct wlr_scene_node *node, int x, int y,
+		pixman_region32_t *opaque) {
+	pixman_region32_copy(opaque, scene_node_get_opaque_region(node));
+	pixman_region32_translate(opaque, x, y);
 }
 
 struct scene_update_data {
@@ -329,6 +720,10 @@ struct render_data {
 
 	struct wlr_render_pass *render_pass;
 	pixman_region32_t damage;
+
+	// Render nodes as a whole regardless of their visibility, used when
+	// rendering into a tree cache
+	bool ignore_visibility;
 };
 
 static void logical_to_buffer_coords(pixman_region32_t *damage, const struct render_data *data) {
@@ -362,23 +757,40 @@ static void transform_output_box(struct wlr_box *box, const struct render_data *
 	wlr_box_transform(box, box, transform, data->trans_width, data->trans_height);
 }
 
+// Damage is accumulated in a rect_union and only merged into the damage ring
+// once per frame, instead of doing a pixman union for every damaged node
 static void scene_output_damage(struct wlr_scene_output *scene_output,
 		const pixman_region32_t *damage) {
 	struct wlr_output *output = scene_output->output;
 
-	pixman_region32_t clipped;
-	pixman_region32_init(&clipped);
-	pixman_region32_intersect_rect(&clipped, damage, 0, 0, output->width, output->height);
+	const pixman_box32_t *extents = pixman_region32_extents(damage);
+	if (!pixman_region32_not_empty(damage) || extents->x2 <= 0 ||
+			extents->y2 <= 0 || extents->x1 >= output->width ||
+			extents->y1 >= output->height) {
+		return;
+	}
 
-	if (pixman_region32_not_empty(&clipped)) {
-		wlr_output_schedule_frame(scene_output->output);
-		wlr_damage_ring_add(&scene_output->damage_ring, &clipped);
+	wlr_output_schedule_frame(scene_output->output);
+	rect_union_add_region(scene_output->pending_damage, damage);
+}
+
+static void scene_output_flush_damage(struct wlr_scene_output *scene_output) {
+	struct wlr_output *output = scene_output->output;
+
+	pixman_region32_t output_region;
+	pixman_region32_init_rect(&output_region, 0, 0, output->width, output->height);
+	rect_union_intersect(scene_output->pending_damage, &output_region);
+	pixman_region32_fini(&output_region);
 
+	const pixman_region32_t *damage = rect_union_evaluate(scene_output->pending_damage);
+	if (pixman_region32_not_empty(damage)) {
+		wlr_damage_ring_add(&scene_output->damage_ring, damage);
 		pixman_region32_union(&scene_output->pending_commit_damage,
-			&scene_output->pending_commit_damage, &clipped);
+			&scene_output->pending_commit_damage, damage);
 	}
 
-	pixman_region32_fini(&clipped);
+	rect_union_finish(scene_output->pending_damage);
+	rect_union_init(scene_output->pending_damage);
 }
 
 static void scene_output_damage_whole(struct wlr_scene_output *scene_output) {
@@ -409,6 +821,85 @@ static void scene_damage_outputs(struct wlr_scene *scene, pixman_region32_t *dam
 	}
 }
 
+static void scene_invalidate_render_lists(struct wlr_scene *scene) {
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		scene_output->render_list_dirty = true;
+	}
+}
+
+/**
+ * Signal the changes to the outputs of a buffer since the last call:
+ * output_enter, output_leave, then outputs_update.
+ */
+static void scene_buffer_send_outputs_update(struct wlr_scene_buffer *scene_buffer,
+		struct wl_list *outputs, struct wlr_scene_output *force) {
+	wl_list_remove(&scene_buffer->outputs_update_link);
+	wl_list_init(&scene_buffer->outputs_update_link);
+
+	uint64_t active_outputs = scene_buffer->active_outputs;
+	uint64_t old_active = scene_buffer->sent_active_outputs;
+	struct wlr_scene_output *old_primary_output = scene_buffer->sent_primary_output;
+	scene_buffer->sent_active_outputs = active_outputs;
+	scene_buffer->sent_primary_output = scene_buffer->primary_output;
+
+	size_t count = 0;
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, outputs, link) {
+		uint64_t mask = 1ull << scene_output->index;
+		bool intersects = active_outputs & mask;
+		bool intersects_before = old_active & mask;
+
+		if (intersects && !intersects_before) {
+			wl_signal_emit_mutable(&scene_buffer->events.output_enter, scene_output);
+		} else if (!intersects && intersects_before) {
+			wl_signal_emit_mutable(&scene_buffer->events.output_leave, scene_output);
+		}
+
+		if (intersects) {
+			count++;
+		}
+	}
+
+	// Skip output update event if nothing was updated
+	if (old_active == active_outputs &&
+			(!force || ((1ull << force->index) & ~active_outputs)) &&
+			old_primary_output == scene_buffer->primary_output) {
+		return;
+	}
+
+	struct wlr_scene_output *outputs_array[64];
+	struct wlr_scene_outputs_update_event event = {
+		.active = outputs_array,
+		.size = count,
+	};
+
+	size_t i = 0;
+	wl_list_for_each(scene_output, outputs, link) {
+		if (~active_outputs & (1ull << scene_output->index)) {
+			continue;
+		}
+
+		assert(i < count);
+		outputs_array[i++] = scene_output;
+	}
+
+	wl_signal_emit_mutable(&scene_buffer->events.outputs_update, &event);
+}
+
+/**
+ * Signal the output changes of all buffers. This is done once per frame, so
+ * that nodes moving across outputs (e.g. a window being dragged) don't make
+ * clients re-render for every intermediate position.
+ */
+static void scene_send_outputs_update(struct wlr_scene *scene) {
+	while (!wl_list_empty(&scene->outputs_update_queue)) {
+		struct wlr_scene_buffer *scene_buffer = wl_container_of(
+			scene->outputs_update_queue.next, scene_buffer, outputs_update_link);
+		scene_buffer_send_outputs_update(scene_buffer, &scene->outputs, NULL);
+	}
+}
+
 static void update_node_update_outputs(struct wlr_scene_node *node,
 		struct wl_list *outputs, struct wlr_scene_output *ignore,
 		struct wlr_scene_output *force) {
@@ -419,18 +910,12 @@ static void update_node_update_outputs(struct wlr_scene_node *node,
 	struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
 
 	uint32_t largest_overlap = 0;
+	uint32_t old_primary_overlap = 0;
 	struct wlr_scene_output *old_primary_output = scene_buffer->primary_output;
 	scene_buffer->primary_output = NULL;
 
-	size_t count = 0;
 	uint64_t active_outputs = 0;
 
-	// let's update the outputs in two steps:
-	//  - the primary outputs
-	//  - the enter/leave signals
-	// This ensures that the enter/leave signals can rely on the primary output
-	// to have a reasonable value. Otherwise, they may get a value that's in
-	// the middle of a calculation.
 	struct wlr_scene_output *scene_output;
 	wl_list_for_each(scene_output, outputs, link) {
 		if (scene_output == ignore) {
@@ -459,62 +944,52 @@ static void update_node_update_outputs(struct wlr_scene_node *node,
 				largest_overlap = overlap;
 				scene_buffer->primary_output = scene_output;
 			}
+			if (scene_output == old_primary_output) {
+				old_primary_overlap = overlap;
+			}
 
 			active_outputs |= 1ull << scene_output->index;
-			count++;
 		}
 
 		pixman_region32_fini(&intersection);
 	}
 
+	// Keep the primary output while no other output displays significantly
+	// more of the buffer, so that it doesn't flip back and forth around the
+	// middle of two outputs
+	if (old_primary_overlap > 0 && (uint64_t)largest_overlap * 100 <
+			(uint64_t)old_primary_overlap * (100 + PRIMARY_OUTPUT_HYSTERESIS)) {
+		scene_buffer->primary_output = old_primary_output;
+	}
+
 	if (old_primary_output != scene_buffer->primary_output) {
 		scene_buffer->prev_feedback_options =
 			(struct wlr_linux_dmabuf_feedback_v1_init_options){0};
 	}
 
-	uint64_t old_active = scene_buffer->active_outputs;
 	scene_buffer->active_outputs = active_outputs;
 
-	wl_list_for_each(scene_output, outputs, link) {
-		uint64_t mask = 1ull << scene_output->index;
-		bool intersects = active_outputs & mask;
-		bool intersects_before = old_active & mask;
-
-		if (intersects && !intersects_before) {
-			wl_signal_emit_mutable(&scene_buffer->events.output_enter, scene_output);
-		} else if (!intersects && intersects_before) {
-			wl_signal_emit_mutable(&scene_buffer->events.output_leave, scene_output);
-		}
-	}
-
 	// if there are active outputs on this node, we should always have a primary
 	// output
 	assert(!scene_buffer->active_outputs || scene_buffer->primary_output);
 
-	// Skip output update event if nothing was updated
-	if (old_active == active_outputs &&
-			(!force || ((1ull << force->index) & ~active_outputs)) &&
-			old_primary_output == scene_buffer->primary_output) {
+	if (ignore != NULL || force != NULL) {
+		// Outputs are being destroyed or reconfigured, listeners must not be
+		// left with stale state
+		scene_buffer_send_outputs_update(scene_buffer, outputs, force);
 		return;
 	}
 
-	struct wlr_scene_output *outputs_array[64];
-	struct wlr_scene_outputs_update_event event = {
-		.active = outputs_array,
-		.size = count,
-	};
-
-	size_t i = 0;
-	wl_list_for_each(scene_output, outputs, link) {
-		if (~active_outputs & (1ull << scene_output->index)) {
-			continue;
-		}
-
-		assert(i < count);
-		outputs_array[i++] = scene_output;
+	if (active_outputs == scene_buffer->sent_active_outputs &&
+			scene_buffer->primary_output == scene_buffer->sent_primary_output) {
+		// Changed back before the changes were signalled
+		wl_list_remove(&scene_buffer->outputs_update_link);
+		wl_list_init(&scene_buffer->outputs_update_link);
+	} else if (wl_list_empty(&scene_buffer->outputs_update_link)) {
+		struct wlr_scene *scene = scene_node_get_root(node);
+		wl_list_insert(scene->outputs_update_queue.prev,
+			&scene_buffer->outputs_update_link);
 	}
-
-	wl_signal_emit_mutable(&scene_buffer->events.outputs_update, &event);
 }
 
 #if WLR_HAS_XWAYLAND
@@ -592,7 +1067,8 @@ static bool scene_node_update_iterator(struct wlr_scene_node *node,
 	pixman_region32_intersect_rect(&node->visible, &node->visible,
 		lx, ly, box.width, box.height);
 
-	if (data->calculate_visibility) {
+	if (data->calculate_visibility && pixman_region32_not_empty(data->visible) &&
+			pixman_region32_not_empty(scene_node_get_opaque_region(node))) {
 		pixman_region32_t opaque;
 		pixman_region32_init(&opaque);
 		scene_node_opaque_region(node, lx, ly, &opaque);
@@ -608,8 +1084,8 @@ static bool scene_node_update_iterator(struct wlr_scene_node *node,
 	return false;
 }
 
-static void scene_node_visibility(struct wlr_scene_node *node,
-		pixman_region32_t *visible) {
+static void scene_node_add_visibility(struct wlr_scene_node *node,
+		struct rect_union *visible) {
 	if (!node->enabled) {
 		return;
 	}
@@ -618,16 +1094,26 @@ static void scene_node_visibility(struct wlr_scene_node *node,
 		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
 		struct wlr_scene_node *child;
 		wl_list_for_each(child, &scene_tree->children, link) {
-			scene_node_visibility(child, visible);
+			scene_node_add_visibility(child, visible);
 		}
 		return;
 	}
 
-	pixman_region32_union(visible, visible, &node->visible);
+	rect_union_add_region(visible, &node->visible);
 }
 
-static void scene_node_bounds(struct wlr_scene_node *node,
-		int x, int y, pixman_region32_t *visible) {
+static void scene_node_visibility(struct wlr_scene_node *node,
+		pixman_region32_t *visible) {
+	struct rect_union ru;
+	rect_union_init(&ru);
+	rect_union_add_region(&ru, visible);
+	scene_node_add_visibility(node, &ru);
+	pixman_region32_copy(visible, rect_union_evaluate(&ru));
+	rect_union_finish(&ru);
+}
+
+static void scene_node_add_bounds(struct wlr_scene_node *node,
+		int x, int y, struct rect_union *bounds) {
 	if (!node->enabled) {
 		return;
 	}
@@ -636,14 +1122,29 @@ static void scene_node_bounds(struct wlr_scene_node *node,
 		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
 		struct wlr_scene_node *child;
 		wl_list_for_each(child, &scene_tree->children, link) {
-			scene_node_bounds(child, x + child->x, y + child->y, visible);
+			scene_node_add_bounds(child, x + child->x, y + child->y, bounds);
 		}
 		return;
 	}
 
 	int width, height;
 	scene_node_get_size(node, &width, &height);
-	pixman_region32_union_rect(visible, visible, x, y, width, height);
+	rect_union_add(bounds, (pixman_box32_t){
+		.x1 = x,
+		.y1 = y,
+		.x2 = x + width,
+		.y2 = y + height,
+	});
+}
+
+static void scene_node_bounds(struct wlr_scene_node *node,
+		int x, int y, pixman_region32_t *visible) {
+	struct rect_union ru;
+	rect_union_init(&ru);
+	rect_union_add_region(&ru, visible);
+	scene_node_add_bounds(node, x, y, &ru);
+	pixman_region32_copy(visible, rect_union_evaluate(&ru));
+	rect_union_finish(&ru);
 }
 
 static void scene_update_region(struct wlr_scene *scene,
@@ -666,6 +1167,8 @@ static void scene_update_region(struct wlr_scene *scene,
 		.calculate_visibility = scene->calculate_visibility,
 	};
 
+	scene_invalidate_render_lists(scene);
+
 	// update node visibility and output enter/leave events
 	scene_nodes_in_box(&scene->tree.node, &data.update_box, scene_node_update_iterator, &data);
 
@@ -676,6 +1179,12 @@ static void scene_node_update(struct wlr_scene_node *node,
 		pixman_region32_t *damage) {
 	struct wlr_scene *scene = scene_node_get_root(node);
 
+	scene_invalidate_node_at_cache(scene);
+
+	scene_node_invalidate_opaque_region(node);
+	scene_node_damage_tree_caches(node, NULL);
+	scene_node_update_bounds(node);
+
 	int x, y;
 	if (!wlr_scene_node_coords(node, &x, &y)) {
 #if WLR_HAS_XWAYLAND
@@ -715,7 +1224,8 @@ struct wlr_scene_rect *wlr_scene_rect_create(struct wlr_scene_tree *parent,
 	assert(parent);
 	assert(width >= 0 && height >= 0);
 
-	struct wlr_scene_rect *scene_rect = calloc(1, sizeof(*scene_rect));
+	struct wlr_scene_rect *scene_rect =
+		scene_node_alloc(parent, WLR_SCENE_NODE_RECT, sizeof(*scene_rect));
 	if (scene_rect == NULL) {
 		return NULL;
 	}
@@ -759,6 +1269,10 @@ static void scene_buffer_handle_buffer_release(struct wl_listener *listener,
 	scene_buffer->buffer = NULL;
 	wl_list_remove(&scene_buffer->buffer_release.link);
 	wl_list_init(&scene_buffer->buffer_release.link);
+	scene_node_invalidate_opaque_region(&scene_buffer->node);
+
+	// The node may have become invisible
+	scene_invalidate_render_lists(scene_node_get_root(&scene_buffer->node));
 }
 
 static void scene_buffer_set_buffer(struct wlr_scene_buffer *scene_buffer,
@@ -772,6 +1286,8 @@ static void scene_buffer_set_buffer(struct wlr_scene_buffer *scene_buffer,
 	scene_buffer->own_buffer = false;
 	scene_buffer->buffer_width = scene_buffer->buffer_height = 0;
 	scene_buffer->buffer_is_opaque = false;
+	scene_buffer->is_single_pixel_buffer = false;
+	scene_node_invalidate_opaque_region(&scene_buffer->node);
 
 	if (!buffer) {
 		return;
@@ -783,6 +1299,27 @@ static void scene_buffer_set_buffer(struct wlr_scene_buffer *scene_buffer,
 	scene_buffer->buffer_height = buffer->height;
 	scene_buffer->buffer_is_opaque = buffer_is_opaque(buffer);
 
+	struct wlr_buffer *source = buffer;
+	struct wlr_client_buffer *client_buffer = wlr_client_buffer_get(buffer);
+	if (client_buffer != NULL && client_buffer->source != NULL) {
+		source = client_buffer->source;
+	}
+	struct wlr_single_pixel_buffer_v1 *single_pixel_buffer =
+		wlr_single_pixel_buffer_v1_try_from_buffer(source);
+	if (single_pixel_buffer != NULL) {
+		// Rendered as a solid fill instead of a stretched 1x1 texture
+		scene_buffer->is_single_pixel_buffer = true;
+		scene_buffer->single_pixel_buffer_color[0] =
+			(float)single_pixel_buffer->r / UINT32_MAX;
+		scene_buffer->single_pixel_buffer_color[1] =
+			(float)single_pixel_buffer->g / UINT32_MAX;
+		scene_buffer->single_pixel_buffer_color[2] =
+			(float)single_pixel_buffer->b / UINT32_MAX;
+		scene_buffer->single_pixel_buffer_color[3] =
+			(float)single_pixel_buffer->a / UINT32_MAX;
+		scene_buffer->buffer_is_opaque = single_pixel_buffer->a == UINT32_MAX;
+	}
+
 	scene_buffer->buffer_release.notify = scene_buffer_handle_buffer_release;
 	wl_signal_add(&buffer->events.release, &scene_buffer->buffer_release);
 }
@@ -791,10 +1328,14 @@ static void scene_buffer_handle_renderer_destroy(struct wl_listener *listener,
 		void *data) {
 	struct wlr_scene_buffer *scene_buffer = wl_container_of(listener, scene_buffer, renderer_destroy);
 	scene_buffer_set_texture(scene_buffer, NULL);
+	scene_invalidate_render_lists(scene_node_get_root(&scene_buffer->node));
 }
 
 static void scene_buffer_set_texture(struct wlr_scene_buffer *scene_buffer,
 		struct wlr_texture *texture) {
+	texture_atlas_entry_destroy(scene_buffer->atlas_entry);
+	scene_buffer->atlas_entry = NULL;
+
 	wl_list_remove(&scene_buffer->renderer_destroy.link);
 	wlr_texture_destroy(scene_buffer->texture);
 	scene_buffer->texture = texture;
@@ -821,11 +1362,12 @@ static void scene_buffer_set_wait_timeline(struct wlr_scene_buffer *scene_buffer
 
 struct wlr_scene_buffer *wlr_scene_buffer_create(struct wlr_scene_tree *parent,
 		struct wlr_buffer *buffer) {
-	struct wlr_scene_buffer *scene_buffer = calloc(1, sizeof(*scene_buffer));
+	assert(parent);
+	struct wlr_scene_buffer *scene_buffer =
+		scene_node_alloc(parent, WLR_SCENE_NODE_BUFFER, sizeof(*scene_buffer));
 	if (scene_buffer == NULL) {
 		return NULL;
 	}
-	assert(parent);
 	scene_node_init(&scene_buffer->node, WLR_SCENE_NODE_BUFFER, parent);
 
 	wl_signal_init(&scene_buffer->events.outputs_update);
@@ -836,6 +1378,7 @@ struct wlr_scene_buffer *wlr_scene_buffer_create(struct wlr_scene_tree *parent,
 	pixman_region32_init(&scene_buffer->opaque_region);
 	wl_list_init(&scene_buffer->buffer_release.link);
 	wl_list_init(&scene_buffer->renderer_destroy.link);
+	wl_list_init(&scene_buffer->outputs_update_link);
 	scene_buffer->opacity = 1;
 
 	scene_buffer_set_buffer(scene_buffer, buffer);
@@ -873,9 +1416,29 @@ void wlr_scene_buffer_set_buffer_with_options(struct wlr_scene_buffer *scene_buf
 			scene_buffer->buffer_height != buffer->height;
 	}
 
+	// Textures uploaded by the scene can be updated in place, only uploading
+	// the damaged region
+	struct wlr_texture *texture = scene_buffer->texture;
+	bool texture_updated = false;
+	if (texture != NULL && buffer != NULL && !update &&
+			texture->width == (uint32_t)buffer->width &&
+			texture->height == (uint32_t)buffer->height) {
+		pixman_region32_t full;
+		pixman_region32_init_rect(&full, 0, 0, buffer->width, buffer->height);
+		texture_updated = wlr_texture_update_from_buffer(texture, buffer,
+			options->damage != NULL ? options->damage : &full);
+		pixman_region32_fini(&full);
+	}
+
 	scene_buffer_set_buffer(scene_buffer, buffer);
-	scene_buffer_set_texture(scene_buffer, NULL);
-	scene_buffer_set_wait_timeline(scene_buffer,
+	if (texture_updated) {
+		// Like scene_buffer_get_texture(), the texture holds the contents
+		scene_buffer->own_buffer = false;
+		wlr_buffer_unlock(buffer);
+	} else {
+		scene_buffer_set_texture(scene_buffer, NULL);
+	}
+	scene_buffer_set_wait_timeline(scene_buffer,
 		options->wait_timeline, options->wait_point);
 
 	if (update) {
@@ -885,6 +1448,10 @@ void wlr_scene_buffer_set_buffer_with_options(struct wlr_scene_buffer *scene_buf
 		return;
 	}
 
+	struct wlr_box node_box = {0};
+	scene_node_get_size(&scene_buffer->node, &node_box.width, &node_box.height);
+	scene_node_damage_tree_caches(&scene_buffer->node, &node_box);
+
 	int lx, ly;
 	if (!wlr_scene_node_coords(&scene_buffer->node, &lx, &ly)) {
 		return;
@@ -995,6 +1562,7 @@ void wlr_scene_buffer_set_opaque_region(struct wlr_scene_buffer *scene_buffer,
 	}
 
 	pixman_region32_copy(&scene_buffer->opaque_region, region);
+	scene_node_invalidate_opaque_region(&scene_buffer->node);
 
 	int x, y;
 	if (!wlr_scene_node_coords(&scene_buffer->node, &x, &y)) {
@@ -1074,8 +1642,97 @@ void wlr_scene_buffer_set_filter_mode(struct wlr_scene_buffer *scene_buffer,
 	scene_node_update(&scene_buffer->node, NULL);
 }
 
-static struct wlr_texture *scene_buffer_get_texture(
+void wlr_scene_buffer_get_render_cost(struct wlr_scene_buffer *scene_buffer,
+		struct wlr_scene_buffer_render_cost *cost) {
+	*cost = scene_buffer->render_cost;
+}
+
+void wlr_scene_buffer_reset_render_cost(struct wlr_scene_buffer *scene_buffer) {
+	scene_buffer->render_cost = (struct wlr_scene_buffer_render_cost){0};
+}
+
+static void scene_handle_atlas_renderer_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene *scene = wl_container_of(listener, scene, atlas_renderer_destroy);
+	wl_list_remove(&scene->atlas_renderer_destroy.link);
+	wl_list_init(&scene->atlas_renderer_destroy.link);
+
+	// Entries are released lazily by their scene buffers
+	texture_atlas_destroy(scene->atlas);
+	scene->atlas = NULL;
+	scene_invalidate_render_lists(scene);
+}
+
+static struct wlr_texture_atlas_entry *scene_buffer_add_to_atlas(
 		struct wlr_scene_buffer *scene_buffer, struct wlr_renderer *renderer) {
+	struct wlr_scene *scene = scene_node_get_root(&scene_buffer->node);
+	struct wlr_buffer *buffer = scene_buffer->buffer;
+	if (!scene->texture_atlas ||
+			buffer->width > TEXTURE_ATLAS_MAX_ENTRY_SIZE ||
+			buffer->height > TEXTURE_ATLAS_MAX_ENTRY_SIZE) {
+		return NULL;
+	}
+
+	if (scene->atlas == NULL) {
+		scene->atlas = texture_atlas_create(renderer);
+		if (scene->atlas == NULL) {
+			return NULL;
+		}
+		scene->atlas_renderer_destroy.notify = scene_handle_atlas_renderer_destroy;
+		wl_signal_add(&renderer->events.destroy, &scene->atlas_renderer_destroy);
+	} else if (scene->atlas->renderer != renderer) {
+		return NULL;
+	}
+
+	void *data;
+	uint32_t format;
+	size_t stride;
+	if (!wlr_buffer_begin_data_ptr_access(buffer,
+			WLR_BUFFER_DATA_PTR_ACCESS_READ, &data, &format, &stride)) {
+		return NULL;
+	}
+
+	struct wlr_texture_atlas_entry *entry = texture_atlas_add(scene->atlas,
+		format, stride, buffer->width, buffer->height, data);
+	wlr_buffer_end_data_ptr_access(buffer);
+	return entry;
+}
+
+/**
+ * Get the texture to render the buffer with. The source box is adjusted if
+ * the buffer is stored in a region of a shared texture.
+ */
+static struct wlr_texture *scene_buffer_get_texture(
+		struct wlr_scene_buffer *scene_buffer, struct wlr_renderer *renderer,
+		struct wlr_fbox *src_box) {
+	struct wlr_texture_atlas_entry *entry = scene_buffer->atlas_entry;
+	if (entry != NULL && entry->texture == NULL) {
+		// The atlas has been destroyed along with its renderer
+		texture_atlas_entry_destroy(entry);
+		scene_buffer->atlas_entry = entry = NULL;
+	}
+
+	if (entry == NULL && scene_buffer->buffer != NULL &&
+			scene_buffer->texture == NULL &&
+			wlr_client_buffer_get(scene_buffer->buffer) == NULL) {
+		// The buffer is kept locked: it's needed to re-upload the contents if
+		// the atlas goes away
+		scene_buffer->atlas_entry = entry =
+			scene_buffer_add_to_atlas(scene_buffer, renderer);
+	}
+
+	if (entry != NULL) {
+		if (wlr_fbox_empty(src_box)) {
+			*src_box = (struct wlr_fbox){
+				.width = entry->box.width,
+				.height = entry->box.height,
+			};
+		}
+		src_box->x += entry->box.x;
+		src_box->y += entry->box.y;
+		return entry->texture;
+	}
+
 	if (scene_buffer->buffer == NULL || scene_buffer->texture != NULL) {
 		return scene_buffer->texture;
 	}
@@ -1083,7 +1740,7 @@ static struct wlr_texture *scene_buffer_get_texture(
 	struct wlr_client_buffer *client_buffer =
 		wlr_client_buffer_get(scene_buffer->buffer);
 	if (client_buffer != NULL) {
-		return client_buffer->texture;
+		return client_buffer_get_texture(client_buffer);
 	}
 
 	struct wlr_texture *texture =
@@ -1096,6 +1753,153 @@ static struct wlr_texture *scene_buffer_get_texture(
 	return texture;
 }
 
+// Get the texture of the buffer without uploading anything
+static struct wlr_texture *scene_buffer_peek_texture(
+		struct wlr_scene_buffer *scene_buffer) {
+	if (scene_buffer->texture != NULL || scene_buffer->buffer == NULL) {
+		return scene_buffer->texture;
+	}
+	struct wlr_client_buffer *client_buffer =
+		wlr_client_buffer_get(scene_buffer->buffer);
+	if (client_buffer != NULL) {
+		return client_buffer->texture;
+	}
+	return NULL;
+}
+
+/**
+ * Sum up the memory used by the textures of the sub-tree. If candidates is
+ * not NULL, buffers which have been hidden for long enough are added to it.
+ * Disabled nodes are included, their textures are the first to go.
+ */
+static void scene_node_collect_textures(struct wlr_scene_node *node,
+		bool enabled, const struct timespec *now, struct wl_array *candidates,
+		size_t *usage) {
+	enabled = enabled && node->enabled;
+
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &tree->children, link) {
+			scene_node_collect_textures(child, enabled, now, candidates, usage);
+		}
+		return;
+	} else if (node->type != WLR_SCENE_NODE_BUFFER) {
+		return;
+	}
+
+	struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
+	struct wlr_texture *texture = scene_buffer_peek_texture(scene_buffer);
+	if (texture == NULL) {
+		return;
+	}
+	*usage += wlr_texture_get_memory_usage(texture);
+
+	if (candidates == NULL) {
+		return;
+	}
+
+	// The outputs of disabled nodes aren't updated
+	if (enabled && scene_buffer->active_outputs != 0) {
+		scene_buffer->last_visible_time = *now;
+		return;
+	}
+
+	struct timespec elapsed;
+	timespec_sub(&elapsed, now, &scene_buffer->last_visible_time);
+	if (timespec_to_msec(&elapsed) < TEXTURE_EVICTION_DELAY_MS) {
+		return;
+	}
+
+	struct wlr_scene_buffer **ptr = wl_array_add(candidates, sizeof(*ptr));
+	if (ptr != NULL) {
+		*ptr = scene_buffer;
+	}
+}
+
+size_t wlr_scene_get_texture_memory_usage(struct wlr_scene *scene) {
+	size_t usage = 0;
+	scene_node_collect_textures(&scene->tree.node, true, NULL, NULL, &usage);
+	return usage;
+}
+
+static bool scene_buffer_evict_texture(struct wlr_scene_buffer *scene_buffer) {
+	if (scene_buffer->buffer == NULL) {
+		// The buffer has been released, its contents may have changed
+		return false;
+	}
+
+	if (scene_buffer->texture == NULL) {
+		struct wlr_client_buffer *client_buffer =
+			wlr_client_buffer_get(scene_buffer->buffer);
+		return client_buffer != NULL && client_buffer_evict_texture(client_buffer);
+	}
+
+	// Keep the buffer to upload it again
+	if (!scene_buffer->own_buffer) {
+		scene_buffer->own_buffer = true;
+		wlr_buffer_lock(scene_buffer->buffer);
+	}
+	scene_buffer_set_texture(scene_buffer, NULL);
+	return true;
+}
+
+static int scene_buffer_compare_last_visible(const void *a, const void *b) {
+	const struct wlr_scene_buffer *buffer_a = *(struct wlr_scene_buffer *const *)a;
+	const struct wlr_scene_buffer *buffer_b = *(struct wlr_scene_buffer *const *)b;
+	const struct timespec *time_a = &buffer_a->last_visible_time;
+	const struct timespec *time_b = &buffer_b->last_visible_time;
+	if (time_a->tv_sec != time_b->tv_sec) {
+		return time_a->tv_sec < time_b->tv_sec ? -1 : 1;
+	}
+	if (time_a->tv_nsec != time_b->tv_nsec) {
+		return time_a->tv_nsec < time_b->tv_nsec ? -1 : 1;
+	}
+	return 0;
+}
+
+static void scene_evict_textures(struct wlr_scene *scene) {
+	if (scene->texture_budget == 0) {
+		return;
+	}
+
+	struct timespec now, elapsed;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	timespec_sub(&elapsed, &now, &scene->texture_eviction_time);
+	if (timespec_to_msec(&elapsed) < TEXTURE_EVICTION_INTERVAL_MS) {
+		return;
+	}
+	scene->texture_eviction_time = now;
+
+	struct wl_array buffers;
+	wl_array_init(&buffers);
+	size_t usage = 0;
+	scene_node_collect_textures(&scene->tree.node, true, &now, &buffers, &usage);
+
+	struct wlr_scene_buffer **candidates = buffers.data;
+	size_t candidates_len = buffers.size / sizeof(*candidates);
+	if (usage > scene->texture_budget && candidates_len > 0) {
+		qsort(candidates, candidates_len, sizeof(*candidates),
+			scene_buffer_compare_last_visible);
+
+		size_t evicted = 0;
+		for (size_t i = 0; i < candidates_len && usage > scene->texture_budget; i++) {
+			struct wlr_texture *texture = scene_buffer_peek_texture(candidates[i]);
+			size_t size = wlr_texture_get_memory_usage(texture);
+			if (scene_buffer_evict_texture(candidates[i])) {
+				usage -= size;
+				evicted += size;
+			}
+		}
+		if (evicted > 0) {
+			wlr_log(WLR_DEBUG, "Evicted %zu bytes of textures, %zu bytes in use",
+				evicted, usage);
+		}
+	}
+
+	wl_array_release(&buffers);
+}
+
 static void scene_node_get_size(struct wlr_scene_node *node,
 		int *width, int *height) {
 	*width = 0;
@@ -1209,6 +2013,9 @@ void wlr_scene_node_reparent(struct wlr_scene_node *node,
 			ancestor = ancestor->node.parent) {
 		assert(&ancestor->node != node);
 	}
+	// Pooled nodes are returned to the pools of their scene
+	assert(!node->pooled ||
+		scene_node_get_root(node) == scene_node_get_root(&new_parent->node));
 
 	int x, y;
 	pixman_region32_t visible;
@@ -1217,7 +2024,14 @@ void wlr_scene_node_reparent(struct wlr_scene_node *node,
 		scene_node_visibility(node, &visible);
 	}
 
+	struct wlr_scene_tree *old_parent = node->parent;
 	wl_list_remove(&node->link);
+	struct wlr_box old_bounds = node->parent_bounds;
+	node->parent_bounds = (struct wlr_box){0};
+	if (scene_tree_update_child_bounds(old_parent, &old_bounds, &node->parent_bounds)) {
+		scene_node_update_bounds(&old_parent->node);
+	}
+
 	node->parent = new_parent;
 	wl_list_insert(new_parent->children.prev, &node->link);
 	scene_node_update(node, &visible);
@@ -1300,6 +2114,73 @@ static bool scene_node_at_iterator(struct wlr_scene_node *node,
 	return true;
 }
 
+void scene_invalidate_node_at_cache(struct wlr_scene *scene) {
+	scene->node_at_cache.valid = false;
+}
+
+static bool scene_node_at_cache_iterator(struct wlr_scene_node *node,
+		int lx, int ly, void *data) {
+	struct wlr_scene_node **first = data;
+	*first = node;
+	return true;
+}
+
+// Remember the box around the point where the hit node is known to be the
+// result, so that motion within the same surface doesn't need to walk the
+// whole tree again
+static void scene_node_at_cache_update(struct wlr_scene *scene,
+		struct wlr_scene_node *root, struct wlr_scene_node *hit,
+		int point_x, int point_y, double offset_x, double offset_y) {
+	int node_x, node_y;
+	wlr_scene_node_coords(hit, &node_x, &node_y);
+
+	struct wlr_box node_box = { .x = node_x, .y = node_y };
+	scene_node_get_size(hit, &node_box.width, &node_box.height);
+
+	struct wlr_box box = node_box;
+	wlr_scene_buffer_point_accepts_input_func_t point_accepts_input = NULL;
+	if (hit->type == WLR_SCENE_NODE_BUFFER) {
+		struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(hit);
+		point_accepts_input = scene_buffer->point_accepts_input;
+		if (point_accepts_input != NULL) {
+			// Fails for custom callbacks, which may reject any point
+			struct wlr_box input_box;
+			if (!scene_buffer_get_input_box(scene_buffer,
+					point_x - node_x, point_y - node_y, &input_box)) {
+				return;
+			}
+			input_box.x += node_x;
+			input_box.y += node_y;
+			if (!wlr_box_intersection(&box, &node_box, &input_box)) {
+				return;
+			}
+		}
+	}
+
+	// Nothing above the hit node may overlap with the box
+	struct wlr_scene_node *first = NULL;
+	scene_nodes_in_box(root, &box, scene_node_at_cache_iterator, &first);
+	if (first != hit) {
+		return;
+	}
+
+	scene->node_at_cache.valid = true;
+	scene->node_at_cache.root = root;
+	scene->node_at_cache.node = hit;
+	scene->node_at_cache.point_accepts_input = point_accepts_input;
+	scene->node_at_cache.box = box;
+	scene->node_at_cache.offset_x = offset_x;
+	scene->node_at_cache.offset_y = offset_y;
+}
+
+// Compositors may replace the callback of a buffer at any time
+static bool scene_node_at_cache_is_current(struct wlr_scene *scene) {
+	struct wlr_scene_node *node = scene->node_at_cache.node;
+	return node->type != WLR_SCENE_NODE_BUFFER ||
+		wlr_scene_buffer_from_node(node)->point_accepts_input ==
+		scene->node_at_cache.point_accepts_input;
+}
+
 struct wlr_scene_node *wlr_scene_node_at(struct wlr_scene_node *node,
 		double lx, double ly, double *nx, double *ny) {
 	struct wlr_box box = {
@@ -1309,6 +2190,19 @@ struct wlr_scene_node *wlr_scene_node_at(struct wlr_scene_node *node,
 		.height = 1
 	};
 
+	struct wlr_scene *scene = scene_node_get_root(node);
+	if (scene->node_at_cache.valid && scene->node_at_cache.root == node &&
+			scene_node_at_cache_is_current(scene) &&
+			wlr_box_contains_point(&scene->node_at_cache.box, box.x, box.y)) {
+		if (nx) {
+			*nx = lx - scene->node_at_cache.offset_x;
+		}
+		if (ny) {
+			*ny = ly - scene->node_at_cache.offset_y;
+		}
+		return scene->node_at_cache.node;
+	}
+
 	struct node_at_data data = {
 		.lx = lx,
 		.ly = ly
@@ -1321,6 +2215,9 @@ struct wlr_scene_node *wlr_scene_node_at(struct wlr_scene_node *node,
 		if (ny) {
 			*ny = data.ry;
 		}
+
+		scene_node_at_cache_update(scene, node, data.node,
+			box.x, box.y, lx - data.rx, ly - data.ry);
 		return data.node;
 	}
 
@@ -1331,122 +2228,630 @@ struct render_list_entry {
 	struct wlr_scene_node *node;
 	bool sent_dmabuf_feedback;
 	bool highlight_transparent_region;
+	bool offloaded; // displayed via an output layer
 	int x, y;
 };
 
-static void scene_entry_render(struct render_list_entry *entry, const struct render_data *data) {
-	struct wlr_scene_node *node = entry->node;
+static bool scene_node_invisible(struct wlr_scene_node *node) {
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		return true;
+	} else if (node->type == WLR_SCENE_NODE_RECT) {
+		struct wlr_scene_rect *rect = wlr_scene_rect_from_node(node);
 
-	pixman_region32_t render_region;
-	pixman_region32_init(&render_region);
-	pixman_region32_copy(&render_region, &node->visible);
-	pixman_region32_translate(&render_region, -data->logical.x, -data->logical.y);
-	logical_to_buffer_coords(&render_region, data);
-	pixman_region32_intersect(&render_region, &render_region, &data->damage);
-	if (!pixman_region32_not_empty(&render_region)) {
-		pixman_region32_fini(&render_region);
+		return rect->color[3] == 0.f;
+	} else if (node->type == WLR_SCENE_NODE_BUFFER) {
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+
+		return buffer->buffer == NULL && buffer->texture == NULL;
+	}
+
+	return false;
+}
+
+static void scene_entry_render(struct render_list_entry *entry, const struct render_data *data);
+
+static void scene_tree_render_children(struct wlr_scene_node *node,
+		int x, int y, const struct render_data *data) {
+	if (!node->enabled) {
 		return;
 	}
 
-	int x = entry->x - data->logical.x;
-	int y = entry->y - data->logical.y;
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &scene_tree->children, link) {
+			scene_tree_render_children(child, x + child->x, y + child->y, data);
+		}
+		return;
+	}
 
-	struct wlr_box dst_box = {
+	if (scene_node_invisible(node)) {
+		return;
+	}
+
+	struct render_list_entry entry = {
+		.node = node,
 		.x = x,
 		.y = y,
 	};
-	scene_node_get_size(node, &dst_box.width, &dst_box.height);
-	transform_output_box(&dst_box, data);
+	scene_entry_render(&entry, data);
+}
 
-	pixman_region32_t opaque;
-	pixman_region32_init(&opaque);
-	scene_node_opaque_region(node, x, y, &opaque);
-	logical_to_buffer_coords(&opaque, data);
-	pixman_region32_subtract(&opaque, &render_region, &opaque);
+static bool scene_tree_cache_ensure_buffer(struct wlr_scene_tree_cache *cache,
+		struct wlr_output *output, int width, int height, float scale) {
+	if (cache->buffer != NULL && cache->renderer == output->renderer &&
+			cache->buffer->width == width && cache->buffer->height == height) {
+		if (cache->scale != scale) {
+			cache->scale = scale;
+			cache->dirty = true;
+		}
+		return true;
+	}
 
-	switch (node->type) {
-	case WLR_SCENE_NODE_TREE:
-		assert(false);
-		break;
-	case WLR_SCENE_NODE_RECT:;
-		struct wlr_scene_rect *scene_rect = wlr_scene_rect_from_node(node);
+	scene_tree_cache_release(cache);
 
-		wlr_render_pass_add_rect(data->render_pass, &(struct wlr_render_rect_options){
-			.box = dst_box,
-			.color = {
-				.r = scene_rect->color[0],
-				.g = scene_rect->color[1],
-				.b = scene_rect->color[2],
-				.a = scene_rect->color[3],
-			},
-			.clip = &render_region,
-		});
-		break;
-	case WLR_SCENE_NODE_BUFFER:;
-		struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
+	if (output->allocator == NULL || output->renderer == NULL) {
+		return false;
+	}
 
-		struct wlr_texture *texture = scene_buffer_get_texture(scene_buffer,
-			data->output->output->renderer);
-		if (texture == NULL) {
-			scene_output_damage(data->output, &render_region);
-			break;
-		}
+	const struct wlr_drm_format_set *formats =
+		wlr_renderer_get_render_formats(output->renderer);
+	const struct wlr_drm_format *format = formats != NULL ?
+		wlr_drm_format_set_get(formats, DRM_FORMAT_ARGB8888) : NULL;
+	if (format == NULL) {
+		wlr_log(WLR_DEBUG, "Renderer doesn't support ARGB8888, "
+			"cannot cache scene tree");
+		return false;
+	}
 
-		enum wl_output_transform transform =
-			wlr_output_transform_invert(scene_buffer->transform);
-		transform = wlr_output_transform_compose(transform, data->transform);
+	cache->buffer = wlr_allocator_create_buffer(output->allocator,
+		width, height, format);
+	if (cache->buffer == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate scene tree cache buffer");
+		return false;
+	}
 
-		wlr_render_pass_add_texture(data->render_pass, &(struct wlr_render_texture_options) {
-			.texture = texture,
-			.src_box = scene_buffer->src_box,
-			.dst_box = dst_box,
-			.transform = transform,
-			.clip = &render_region,
-			.alpha = &scene_buffer->opacity,
-			.filter_mode = scene_buffer->filter_mode,
-			.blend_mode = !data->output->scene->calculate_visibility ||
-					pixman_region32_not_empty(&opaque) ?
-				WLR_RENDER_BLEND_MODE_PREMULTIPLIED : WLR_RENDER_BLEND_MODE_NONE,
-			.wait_timeline = scene_buffer->wait_timeline,
-			.wait_point = scene_buffer->wait_point,
-		});
+	cache->renderer = output->renderer;
+	wl_signal_add(&output->renderer->events.destroy, &cache->renderer_destroy);
+	cache->scale = scale;
+	cache->dirty = true;
+	return true;
+}
 
-		struct wlr_scene_output_sample_event sample_event = {
-			.output = data->output,
-			.direct_scanout = false,
-		};
-		wl_signal_emit_mutable(&scene_buffer->events.output_sample, &sample_event);
+/**
+ * Re-render the damaged parts of a cached tree located at (x, y) in layout
+ * coordinates. Must be called outside of any other render pass.
+ */
+static void scene_tree_cache_update(struct wlr_scene_tree *tree,
+		int x, int y, const struct render_data *data) {
+	struct wlr_scene_tree_cache *cache = tree->cache;
+	struct wlr_box box = tree->bounds;
+	if (wlr_box_empty(&box)) {
+		return;
+	}
 
-		if (entry->highlight_transparent_region) {
-			wlr_render_pass_add_rect(data->render_pass, &(struct wlr_render_rect_options){
-				.box = dst_box,
-				.color = { .r = 0, .g = 0.3, .b = 0, .a = 0.3 },
-				.clip = &opaque,
-			});
-		}
+	int width = ceil(box.width * data->scale);
+	int height = ceil(box.height * data->scale);
+	if (!scene_tree_cache_ensure_buffer(cache, data->output->output,
+			width, height, data->scale)) {
+		return;
+	}
 
-		break;
+	if (!wlr_box_equal(&cache->box, &box)) {
+		cache->box = box;
+		cache->dirty = true;
 	}
 
-	pixman_region32_fini(&opaque);
-	pixman_region32_fini(&render_region);
-}
+	if (!cache->dirty && !pixman_region32_not_empty(&cache->damage) &&
+			cache->texture != NULL) {
+		return;
+	}
 
-static void scene_handle_linux_dmabuf_v1_destroy(struct wl_listener *listener,
-		void *data) {
-	struct wlr_scene *scene =
-		wl_container_of(listener, scene, linux_dmabuf_v1_destroy);
-	wl_list_remove(&scene->linux_dmabuf_v1_destroy.link);
-	wl_list_init(&scene->linux_dmabuf_v1_destroy.link);
-	scene->linux_dmabuf_v1 = NULL;
-}
+	struct render_data cache_data = {
+		.transform = WL_OUTPUT_TRANSFORM_NORMAL,
+		.scale = cache->scale,
+		.logical = {
+			.x = x + box.x,
+			.y = y + box.y,
+			.width = box.width,
+			.height = box.height,
+		},
+		.trans_width = width,
+		.trans_height = height,
+		.output = data->output,
+		.ignore_visibility = true,
+	};
 
-void wlr_scene_set_linux_dmabuf_v1(struct wlr_scene *scene,
-		struct wlr_linux_dmabuf_v1 *linux_dmabuf_v1) {
-	assert(scene->linux_dmabuf_v1 == NULL);
-	scene->linux_dmabuf_v1 = linux_dmabuf_v1;
-	scene->linux_dmabuf_v1_destroy.notify = scene_handle_linux_dmabuf_v1_destroy;
-	wl_signal_add(&linux_dmabuf_v1->events.destroy, &scene->linux_dmabuf_v1_destroy);
+	pixman_region32_init(&cache_data.damage);
+	if (cache->dirty || cache->texture == NULL) {
+		pixman_region32_union_rect(&cache_data.damage, &cache_data.damage,
+			0, 0, width, height);
+	} else {
+		pixman_region32_copy(&cache_data.damage, &cache->damage);
+		pixman_region32_translate(&cache_data.damage, -box.x, -box.y);
+		scale_output_damage(&cache_data.damage, cache->scale);
+		pixman_region32_intersect_rect(&cache_data.damage, &cache_data.damage,
+			0, 0, width, height);
+	}
+
+	cache_data.render_pass = wlr_renderer_begin_buffer_pass(cache->renderer,
+		cache->buffer, NULL);
+	if (cache_data.render_pass == NULL) {
+		pixman_region32_fini(&cache_data.damage);
+		return;
+	}
+
+	wlr_render_pass_add_rect(cache_data.render_pass, &(struct wlr_render_rect_options){
+		.box = { .width = width, .height = height },
+		.color = { .r = 0, .g = 0, .b = 0, .a = 0 },
+		.clip = &cache_data.damage,
+		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+	});
+
+	scene_tree_render_children(&tree->node, x, y, &cache_data);
+
+	if (!wlr_render_pass_submit(cache_data.render_pass)) {
+		wlr_texture_destroy(cache->texture);
+		cache->texture = NULL;
+		pixman_region32_fini(&cache_data.damage);
+		return;
+	}
+
+	// Textures imported from a DMA-BUF sample the buffer directly and can be
+	// kept as-is. Others are copies: only upload the re-rendered region.
+	struct wlr_dmabuf_attributes dmabuf;
+	if (cache->texture != NULL && !wlr_buffer_get_dmabuf(cache->buffer, &dmabuf) &&
+			!wlr_texture_update_from_buffer(cache->texture, cache->buffer,
+				&cache_data.damage)) {
+		wlr_texture_destroy(cache->texture);
+		cache->texture = NULL;
+	}
+	pixman_region32_fini(&cache_data.damage);
+
+	if (cache->texture == NULL) {
+		cache->texture = wlr_texture_from_buffer(cache->renderer, cache->buffer);
+	}
+	if (cache->texture != NULL) {
+		cache->dirty = false;
+		pixman_region32_clear(&cache->damage);
+	}
+}
+
+struct wlr_scene_tree_capture *wlr_scene_tree_capture_create(
+		struct wlr_scene_tree *tree) {
+	struct wlr_scene_tree_capture *capture = calloc(1, sizeof(*capture));
+	if (capture == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	capture->tree = tree;
+	capture->dirty = true;
+	pixman_region32_init(&capture->damage);
+	wlr_damage_ring_init(&capture->ring);
+	wl_list_insert(&tree->captures, &capture->link);
+	return capture;
+}
+
+void wlr_scene_tree_capture_destroy(struct wlr_scene_tree_capture *capture) {
+	if (capture == NULL) {
+		return;
+	}
+
+	wl_list_remove(&capture->link);
+	wlr_damage_ring_finish(&capture->ring);
+	pixman_region32_fini(&capture->damage);
+	free(capture);
+}
+
+bool wlr_scene_tree_capture_get_size(struct wlr_scene_tree_capture *capture,
+		float scale, int *width, int *height) {
+	if (capture->tree == NULL || wlr_box_empty(&capture->tree->bounds)) {
+		return false;
+	}
+
+	*width = ceil(capture->tree->bounds.width * scale);
+	*height = ceil(capture->tree->bounds.height * scale);
+	return true;
+}
+
+bool wlr_scene_tree_capture_render(struct wlr_scene_tree_capture *capture,
+		struct wlr_scene_output *scene_output, struct wlr_buffer *buffer,
+		float scale, pixman_region32_t *damage) {
+	struct wlr_scene_tree *tree = capture->tree;
+	struct wlr_renderer *renderer = scene_output->output->renderer;
+	if (tree == NULL || renderer == NULL) {
+		return false;
+	}
+
+	struct wlr_box box = tree->bounds;
+	if (capture->scale != scale || !wlr_box_equal(&capture->box, &box)) {
+		capture->scale = scale;
+		capture->box = box;
+		capture->dirty = true;
+	}
+
+	// Move the damage accumulated by the sub-tree into the ring, so that
+	// it applies to every capture buffer
+	if (capture->dirty) {
+		wlr_damage_ring_add_whole(&capture->ring);
+		wlr_damage_ring_add_box(&capture->ring, &(struct wlr_box){
+			.width = buffer->width,
+			.height = buffer->height,
+		});
+		capture->dirty = false;
+	} else {
+		pixman_region32_translate(&capture->damage, -box.x, -box.y);
+		scale_output_damage(&capture->damage, scale);
+		wlr_damage_ring_add(&capture->ring, &capture->damage);
+	}
+	pixman_region32_clear(&capture->damage);
+
+	struct render_data data = {
+		.transform = WL_OUTPUT_TRANSFORM_NORMAL,
+		.scale = scale,
+		.logical = box,
+		.trans_width = buffer->width,
+		.trans_height = buffer->height,
+		.output = scene_output,
+		.ignore_visibility = true,
+	};
+
+	pixman_region32_init(&data.damage);
+	wlr_damage_ring_rotate_buffer(&capture->ring, buffer, &data.damage);
+	pixman_region32_intersect_rect(&data.damage, &data.damage,
+		0, 0, buffer->width, buffer->height);
+	if (damage != NULL) {
+		pixman_region32_copy(damage, &data.damage);
+	}
+
+	if (!pixman_region32_not_empty(&data.damage)) {
+		pixman_region32_fini(&data.damage);
+		return true;
+	}
+
+	data.render_pass = wlr_renderer_begin_buffer_pass(renderer, buffer, NULL);
+	if (data.render_pass == NULL) {
+		wlr_damage_ring_add(&capture->ring, &data.damage);
+		pixman_region32_fini(&data.damage);
+		return false;
+	}
+
+	wlr_render_pass_add_rect(data.render_pass, &(struct wlr_render_rect_options){
+		.box = { .width = buffer->width, .height = buffer->height },
+		.color = { .r = 0, .g = 0, .b = 0, .a = 0 },
+		.clip = &data.damage,
+		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+	});
+
+	// Skip the tree itself, which may be disabled
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &tree->children, link) {
+		scene_tree_render_children(child, child->x, child->y, &data);
+	}
+
+	bool ok = wlr_render_pass_submit(data.render_pass);
+	if (!ok) {
+		wlr_damage_ring_add(&capture->ring, &data.damage);
+	}
+	pixman_region32_fini(&data.damage);
+	return ok;
+}
+
+static uint64_t region_area(const pixman_region32_t *region) {
+	int rects_len;
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+	uint64_t area = 0;
+	for (int i = 0; i < rects_len; i++) {
+		area += (uint64_t)(rects[i].x2 - rects[i].x1) * (rects[i].y2 - rects[i].y1);
+	}
+	return area;
+}
+
+/**
+ * Account for a buffer drawn into region, mapping src_box of texture (or the
+ * whole texture if NULL) onto dst_box.
+ */
+static void scene_buffer_add_render_cost(struct wlr_scene_buffer *scene_buffer,
+		const pixman_region32_t *region, struct wlr_texture *texture,
+		const struct wlr_fbox *src_box, const struct wlr_box *dst_box,
+		enum wl_output_transform transform) {
+	struct wlr_scene_buffer_render_cost *cost = &scene_buffer->render_cost;
+	uint64_t dst_pixels = region_area(region);
+	cost->draws++;
+	cost->dst_pixels += dst_pixels;
+
+	if (texture == NULL || wlr_box_empty(dst_box)) {
+		return;
+	}
+
+	double src_width = texture->width, src_height = texture->height;
+	if (src_box != NULL && !wlr_fbox_empty(src_box)) {
+		src_width = src_box->width;
+		src_height = src_box->height;
+	}
+	double dst_width = dst_box->width, dst_height = dst_box->height;
+	if (transform & WL_OUTPUT_TRANSFORM_90) {
+		dst_width = dst_box->height;
+		dst_height = dst_box->width;
+	}
+
+	cost->src_texels += dst_pixels * (src_width * src_height) /
+		(dst_width * dst_height);
+	if (src_width != dst_width || src_height != dst_height) {
+		cost->scaled_pixels += dst_pixels;
+	}
+}
+
+/**
+ * Get the region an entry covers in buffer coordinates, ignoring damage.
+ */
+static void scene_entry_get_region(struct render_list_entry *entry,
+		const struct render_data *data, pixman_region32_t *region) {
+	struct wlr_scene_node *node = entry->node;
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		scene_node_visibility(node, region);
+	} else if (data->ignore_visibility) {
+		int width, height;
+		scene_node_get_size(node, &width, &height);
+		pixman_region32_union_rect(region, region,
+			entry->x, entry->y, width, height);
+	} else {
+		pixman_region32_copy(region, &node->visible);
+	}
+	pixman_region32_translate(region, -data->logical.x, -data->logical.y);
+	logical_to_buffer_coords(region, data);
+}
+
+/**
+ * The buffers of a cached tree are sampled through the cache texture: emit
+ * output_sample for those within the rendered region, in buffer coordinates.
+ */
+static void scene_tree_cache_emit_output_sample(struct wlr_scene_node *node,
+		int x, int y, const struct render_data *data,
+		const pixman_region32_t *render_region) {
+	if (!node->enabled) {
+		return;
+	}
+
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &scene_tree->children, link) {
+			scene_tree_cache_emit_output_sample(child, x + child->x, y + child->y,
+				data, render_region);
+		}
+		return;
+	}
+
+	if (node->type != WLR_SCENE_NODE_BUFFER || scene_node_invisible(node)) {
+		return;
+	}
+
+	int width, height;
+	scene_node_get_size(node, &width, &height);
+	pixman_region32_t region;
+	pixman_region32_init_rect(&region, x - data->logical.x, y - data->logical.y,
+		width, height);
+	logical_to_buffer_coords(&region, data);
+	pixman_region32_intersect(&region, &region, render_region);
+	if (pixman_region32_not_empty(&region)) {
+		struct wlr_scene_output_sample_event sample_event = {
+			.output = data->output,
+			.direct_scanout = false,
+		};
+		wl_signal_emit_mutable(&wlr_scene_buffer_from_node(node)->events.output_sample,
+			&sample_event);
+	}
+	pixman_region32_fini(&region);
+}
+
+static void scene_entry_render(struct render_list_entry *entry, const struct render_data *data) {
+	struct wlr_scene_node *node = entry->node;
+
+	pixman_region32_t render_region;
+	pixman_region32_init(&render_region);
+	scene_entry_get_region(entry, data, &render_region);
+	pixman_region32_intersect(&render_region, &render_region, &data->damage);
+	if (!pixman_region32_not_empty(&render_region)) {
+		pixman_region32_fini(&render_region);
+		return;
+	}
+
+	int x = entry->x - data->logical.x;
+	int y = entry->y - data->logical.y;
+
+	struct wlr_box dst_box = {
+		.x = x,
+		.y = y,
+	};
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		dst_box.x += scene_tree->bounds.x;
+		dst_box.y += scene_tree->bounds.y;
+		dst_box.width = scene_tree->bounds.width;
+		dst_box.height = scene_tree->bounds.height;
+	} else {
+		scene_node_get_size(node, &dst_box.width, &dst_box.height);
+	}
+	transform_output_box(&dst_box, data);
+
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+	scene_node_opaque_region(node, x, y, &opaque);
+	logical_to_buffer_coords(&opaque, data);
+	pixman_region32_subtract(&opaque, &render_region, &opaque);
+
+	switch (node->type) {
+	case WLR_SCENE_NODE_TREE:;
+		// Only trees with a cache end up in the render list
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_tree_cache *cache = scene_tree->cache;
+		if (cache == NULL || cache->texture == NULL) {
+			// Caching failed, render the sub-tree directly
+			scene_tree_render_children(node, entry->x, entry->y, data);
+			break;
+		}
+
+		wlr_render_pass_add_texture(data->render_pass, &(struct wlr_render_texture_options) {
+			.texture = cache->texture,
+			.dst_box = dst_box,
+			.transform = data->transform,
+			.clip = &render_region,
+			.blend_mode = WLR_RENDER_BLEND_MODE_PREMULTIPLIED,
+		});
+		scene_tree_cache_emit_output_sample(node, entry->x, entry->y,
+			data, &render_region);
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *scene_rect = wlr_scene_rect_from_node(node);
+
+		wlr_render_pass_add_rect(data->render_pass, &(struct wlr_render_rect_options){
+			.box = dst_box,
+			.color = {
+				.r = scene_rect->color[0],
+				.g = scene_rect->color[1],
+				.b = scene_rect->color[2],
+				.a = scene_rect->color[3],
+			},
+			.clip = &render_region,
+		});
+		break;
+	case WLR_SCENE_NODE_BUFFER:;
+		struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
+
+		struct wlr_scene_output_sample_event sample_event = {
+			.output = data->output,
+			.direct_scanout = false,
+		};
+
+		if (scene_buffer->is_single_pixel_buffer) {
+			const float *color = scene_buffer->single_pixel_buffer_color;
+			float opacity = scene_buffer->opacity;
+			wlr_render_pass_add_rect(data->render_pass, &(struct wlr_render_rect_options){
+				.box = dst_box,
+				.color = {
+					.r = color[0] * opacity,
+					.g = color[1] * opacity,
+					.b = color[2] * opacity,
+					.a = color[3] * opacity,
+				},
+				.clip = &render_region,
+				.blend_mode = !data->output->scene->calculate_visibility ||
+						pixman_region32_not_empty(&opaque) ?
+					WLR_RENDER_BLEND_MODE_PREMULTIPLIED : WLR_RENDER_BLEND_MODE_NONE,
+			});
+			if (data->output->scene->render_cost_tracking) {
+				scene_buffer_add_render_cost(scene_buffer, &render_region,
+					NULL, NULL, &dst_box, data->transform);
+			}
+			if (!data->ignore_visibility) {
+				wl_signal_emit_mutable(&scene_buffer->events.output_sample, &sample_event);
+			}
+			break;
+		}
+
+		struct wlr_fbox src_box = scene_buffer->src_box;
+		struct wlr_texture *texture = scene_buffer_get_texture(scene_buffer,
+			data->output->output->renderer, &src_box);
+		if (texture == NULL) {
+			if (!data->ignore_visibility) {
+				scene_output_damage(data->output, &render_region);
+			}
+			break;
+		}
+
+		enum wl_output_transform transform =
+			wlr_output_transform_invert(scene_buffer->transform);
+		transform = wlr_output_transform_compose(transform, data->transform);
+
+		wlr_render_pass_add_texture(data->render_pass, &(struct wlr_render_texture_options) {
+			.texture = texture,
+			.src_box = src_box,
+			.dst_box = dst_box,
+			.transform = transform,
+			.clip = &render_region,
+			.alpha = &scene_buffer->opacity,
+			.filter_mode = scene_buffer->filter_mode,
+			.blend_mode = !data->output->scene->calculate_visibility ||
+					pixman_region32_not_empty(&opaque) ?
+				WLR_RENDER_BLEND_MODE_PREMULTIPLIED : WLR_RENDER_BLEND_MODE_NONE,
+			.wait_timeline = scene_buffer->wait_timeline,
+			.wait_point = scene_buffer->wait_point,
+		});
+
+		if (data->output->scene->render_cost_tracking) {
+			scene_buffer_add_render_cost(scene_buffer, &render_region,
+				texture, &src_box, &dst_box, transform);
+		}
+
+		// Offscreen renders aren't displayed by themselves
+		if (!data->ignore_visibility) {
+			wl_signal_emit_mutable(&scene_buffer->events.output_sample, &sample_event);
+		}
+
+		if (entry->highlight_transparent_region) {
+			wlr_render_pass_add_rect(data->render_pass, &(struct wlr_render_rect_options){
+				.box = dst_box,
+				.color = { .r = 0, .g = 0.3, .b = 0, .a = 0.3 },
+				.clip = &opaque,
+			});
+		}
+
+		break;
+	}
+
+	pixman_region32_fini(&opaque);
+	pixman_region32_fini(&render_region);
+}
+
+static void scene_handle_linux_dmabuf_v1_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene *scene =
+		wl_container_of(listener, scene, linux_dmabuf_v1_destroy);
+	wl_list_remove(&scene->linux_dmabuf_v1_destroy.link);
+	wl_list_init(&scene->linux_dmabuf_v1_destroy.link);
+	scene->linux_dmabuf_v1 = NULL;
+}
+
+void wlr_scene_set_linux_dmabuf_v1(struct wlr_scene *scene,
+		struct wlr_linux_dmabuf_v1 *linux_dmabuf_v1) {
+	assert(scene->linux_dmabuf_v1 == NULL);
+	scene->linux_dmabuf_v1 = linux_dmabuf_v1;
+	scene->linux_dmabuf_v1_destroy.notify = scene_handle_linux_dmabuf_v1_destroy;
+	wl_signal_add(&linux_dmabuf_v1->events.destroy, &scene->linux_dmabuf_v1_destroy);
+}
+
+static void scene_output_set_last_frame(struct wlr_scene_output *scene_output,
+		struct wlr_buffer *buffer, struct wlr_swapchain *swapchain,
+		struct wlr_color_transform *color_transform) {
+	wlr_buffer_unlock(scene_output->last_frame);
+	wlr_color_transform_unref(scene_output->last_frame_color_transform);
+	scene_output->last_frame = NULL;
+	scene_output->last_frame_swapchain = NULL;
+	scene_output->last_frame_color_transform = NULL;
+	if (buffer != NULL) {
+		scene_output->last_frame = wlr_buffer_lock(buffer);
+		scene_output->last_frame_swapchain = swapchain;
+		if (color_transform != NULL) {
+			scene_output->last_frame_color_transform =
+				wlr_color_transform_ref(color_transform);
+		}
+	}
+}
+
+static void scene_output_set_gamma_fallback(struct wlr_scene_output *scene_output,
+		struct wlr_color_transform *fallback) {
+	if (scene_output->gamma_fallback == NULL && fallback == NULL) {
+		return;
+	}
+	wlr_color_transform_unref(scene_output->gamma_fallback);
+	scene_output->gamma_fallback = NULL;
+	if (fallback != NULL) {
+		scene_output->gamma_fallback = wlr_color_transform_ref(fallback);
+	}
+	// Every pixel changes, later frames only transform damaged ones
+	scene_output_damage_whole(scene_output);
 }
 
 static void scene_handle_gamma_control_manager_v1_set_gamma(struct wl_listener *listener,
@@ -1479,6 +2884,7 @@ static void scene_handle_gamma_control_manager_v1_destroy(struct wl_listener *li
 	wl_list_for_each(output, &scene->outputs, link) {
 		output->gamma_lut_changed = false;
 		output->gamma_lut = NULL;
+		scene_output_set_gamma_fallback(output, NULL);
 	}
 }
 
@@ -1495,6 +2901,91 @@ void wlr_scene_set_gamma_control_manager_v1(struct wlr_scene *scene,
 	wl_signal_add(&gamma_control->events.set_gamma, &scene->gamma_control_manager_v1_set_gamma);
 }
 
+static void scene_handle_content_type_manager_v1_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene *scene =
+		wl_container_of(listener, scene, content_type_manager_v1_destroy);
+	wl_list_remove(&scene->content_type_manager_v1_destroy.link);
+	wl_list_init(&scene->content_type_manager_v1_destroy.link);
+	scene->content_type_manager_v1 = NULL;
+
+	// Revert the policy on the next frame
+	struct wlr_scene_output *output;
+	wl_list_for_each(output, &scene->outputs, link) {
+		wlr_output_schedule_frame(output->output);
+	}
+}
+
+void wlr_scene_set_content_type_manager_v1(struct wlr_scene *scene,
+		struct wlr_content_type_manager_v1 *content_type) {
+	assert(scene->content_type_manager_v1 == NULL);
+	scene->content_type_manager_v1 = content_type;
+
+	scene->content_type_manager_v1_destroy.notify =
+		scene_handle_content_type_manager_v1_destroy;
+	wl_signal_add(&content_type->events.destroy, &scene->content_type_manager_v1_destroy);
+}
+
+// Scene state of an output layer, stored in wlr_output_layer.data
+struct scene_output_layer {
+	struct wlr_output_layer *layer;
+
+	// Last feedback sent by the backend, if any. The backend only sends
+	// feedback when the planes which could display the layer change.
+	bool has_feedback;
+	struct wlr_drm_format_set feedback_formats;
+	struct wlr_output_layer_feedback_event feedback;
+
+	struct wl_listener layer_feedback;
+};
+
+static void scene_output_layer_handle_feedback(struct wl_listener *listener,
+		void *data) {
+	struct scene_output_layer *scene_layer =
+		wl_container_of(listener, scene_layer, layer_feedback);
+	const struct wlr_output_layer_feedback_event *event = data;
+
+	struct wlr_drm_format_set formats = {0};
+	if (!wlr_drm_format_set_copy(&formats, event->formats)) {
+		return;
+	}
+	wlr_drm_format_set_finish(&scene_layer->feedback_formats);
+	scene_layer->feedback_formats = formats;
+	scene_layer->feedback = (struct wlr_output_layer_feedback_event){
+		.target_device = event->target_device,
+		.formats = &scene_layer->feedback_formats,
+	};
+	scene_layer->has_feedback = true;
+}
+
+static struct wlr_output_layer *scene_output_layer_create(
+		struct wlr_output *output) {
+	struct scene_output_layer *scene_layer = calloc(1, sizeof(*scene_layer));
+	if (scene_layer == NULL) {
+		return NULL;
+	}
+
+	scene_layer->layer = wlr_output_layer_create(output);
+	if (scene_layer->layer == NULL) {
+		free(scene_layer);
+		return NULL;
+	}
+	scene_layer->layer->data = scene_layer;
+
+	scene_layer->layer_feedback.notify = scene_output_layer_handle_feedback;
+	wl_signal_add(&scene_layer->layer->events.feedback, &scene_layer->layer_feedback);
+
+	return scene_layer->layer;
+}
+
+static void scene_output_layer_destroy(struct wlr_output_layer *layer) {
+	struct scene_output_layer *scene_layer = layer->data;
+	wl_list_remove(&scene_layer->layer_feedback.link);
+	wlr_output_layer_destroy(layer);
+	wlr_drm_format_set_finish(&scene_layer->feedback_formats);
+	free(scene_layer);
+}
+
 static void scene_output_handle_destroy(struct wlr_addon *addon) {
 	struct wlr_scene_output *scene_output =
 		wl_container_of(addon, scene_output, addon);
@@ -1521,9 +3012,51 @@ static void scene_node_output_update(struct wlr_scene_node *node,
 	update_node_update_outputs(node, outputs, ignore, force);
 }
 
+static void scene_node_output_update_region(struct wlr_scene_node *node,
+		struct wl_list *outputs, const pixman_region32_t *region, int lx, int ly) {
+	switch (node->type) {
+	case WLR_SCENE_NODE_TREE:;
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		// Disabled trees aren't part of the bounds of their parent, only
+		// enabled ones can be skipped
+		if (node->enabled) {
+			pixman_box32_t bounds = {
+				.x1 = lx + scene_tree->bounds.x,
+				.y1 = ly + scene_tree->bounds.y,
+				.x2 = lx + scene_tree->bounds.x + scene_tree->bounds.width,
+				.y2 = ly + scene_tree->bounds.y + scene_tree->bounds.height,
+			};
+			if (pixman_region32_contains_rectangle(region, &bounds) ==
+					PIXMAN_REGION_OUT) {
+				return;
+			}
+		}
+
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &scene_tree->children, link) {
+			scene_node_output_update_region(child, outputs, region,
+				lx + child->x, ly + child->y);
+		}
+		break;
+	case WLR_SCENE_NODE_RECT:
+		break;
+	case WLR_SCENE_NODE_BUFFER:;
+		// The overlap with outputs is computed from the visible region, which
+		// is in layout coordinates
+		if (!pixman_region32_not_empty(&node->visible) ||
+				pixman_region32_contains_rectangle(region,
+					pixman_region32_extents(&node->visible)) == PIXMAN_REGION_OUT) {
+			return;
+		}
+		update_node_update_outputs(node, outputs, NULL, NULL);
+		break;
+	}
+}
+
 static void scene_output_update_geometry(struct wlr_scene_output *scene_output,
 		bool force_update) {
 	scene_output_damage_whole(scene_output);
+	scene_output->render_list_dirty = true;
 
 	scene_node_output_update(&scene_output->scene->tree.node,
 			&scene_output->scene->outputs, NULL, force_update ? scene_output : NULL);
@@ -1539,6 +3072,11 @@ static void scene_output_handle_commit(struct wl_listener *listener, void *data)
 	// will be acknowledged by the backend so we don't need to keep track of it
 	// anymore
 	if (state->committed & WLR_OUTPUT_STATE_BUFFER) {
+		if (state->buffer != scene_output->last_frame) {
+			scene_output_set_last_frame(scene_output, NULL, NULL, NULL);
+		}
+
+		scene_output_flush_damage(scene_output);
 		if (state->committed & WLR_OUTPUT_STATE_DAMAGE) {
 			pixman_region32_subtract(&scene_output->pending_commit_damage,
 				&scene_output->pending_commit_damage, &state->damage);
@@ -1563,6 +3101,11 @@ static void scene_output_handle_commit(struct wl_listener *listener, void *data)
 		wlr_output_schedule_frame(scene_output->output);
 	}
 
+	if ((state->committed & WLR_OUTPUT_STATE_ENABLED) &&
+			!scene_output->output->enabled) {
+		scene_output_set_last_frame(scene_output, NULL, NULL, NULL);
+	}
+
 	// Next time the output is enabled, try to re-apply the gamma LUT
 	if (scene_output->scene->gamma_control_manager_v1 &&
 			(state->committed & WLR_OUTPUT_STATE_ENABLED) &&
@@ -1604,6 +3147,13 @@ struct wlr_scene_output *wlr_scene_output_create(struct wlr_scene *scene,
 
 	scene_output->output = output;
 	scene_output->scene = scene;
+	scene_output->pending_damage = calloc(1, sizeof(*scene_output->pending_damage));
+	if (scene_output->pending_damage == NULL) {
+		free(scene_output);
+		return NULL;
+	}
+	rect_union_init(scene_output->pending_damage);
+
 	wlr_addon_init(&scene_output->addon, &output->addons, scene, &output_addon_impl);
 
 	wlr_damage_ring_init(&scene_output->damage_ring);
@@ -1678,12 +3228,25 @@ void wlr_scene_output_destroy(struct wlr_scene_output *scene_output) {
 	wlr_addon_finish(&scene_output->addon);
 	wlr_damage_ring_finish(&scene_output->damage_ring);
 	pixman_region32_fini(&scene_output->pending_commit_damage);
+	rect_union_finish(scene_output->pending_damage);
+	free(scene_output->pending_damage);
 	wl_list_remove(&scene_output->link);
 	wl_list_remove(&scene_output->output_commit.link);
 	wl_list_remove(&scene_output->output_damage.link);
 	wl_list_remove(&scene_output->output_needs_frame.link);
 	wlr_drm_syncobj_timeline_unref(scene_output->in_timeline);
+	scene_output_set_last_frame(scene_output, NULL, NULL, NULL);
+	wlr_color_transform_unref(scene_output->gamma_color_transform);
+	wlr_color_transform_unref(scene_output->gamma_fallback);
 	wl_array_release(&scene_output->render_list);
+
+	struct wlr_output_layer_state *layer_state;
+	wl_array_for_each(layer_state, &scene_output->layers) {
+		scene_output_layer_destroy(layer_state->layer);
+	}
+	wl_array_release(&scene_output->layers);
+	wl_array_release(&scene_output->layer_nodes);
+
 	free(scene_output);
 }
 
@@ -1705,26 +3268,29 @@ void wlr_scene_output_set_position(struct wlr_scene_output *scene_output,
 		return;
 	}
 
+	struct wlr_box box = { .x = scene_output->x, .y = scene_output->y };
+	wlr_output_effective_resolution(scene_output->output, &box.width, &box.height);
+
 	scene_output->x = lx;
 	scene_output->y = ly;
 
-	scene_output_update_geometry(scene_output, false);
-}
-
-static bool scene_node_invisible(struct wlr_scene_node *node) {
-	if (node->type == WLR_SCENE_NODE_TREE) {
-		return true;
-	} else if (node->type == WLR_SCENE_NODE_RECT) {
-		struct wlr_scene_rect *rect = wlr_scene_rect_from_node(node);
-
-		return rect->color[3] == 0.f;
-	} else if (node->type == WLR_SCENE_NODE_BUFFER) {
-		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+	scene_output_damage_whole(scene_output);
+	scene_output->render_list_dirty = true;
 
-		return buffer->buffer == NULL && buffer->texture == NULL;
+	// A disabled output doesn't overlap with any node
+	if (!scene_output->output->enabled) {
+		return;
 	}
 
-	return false;
+	// Only nodes overlapping the old or the new position of the output may see
+	// their outputs change
+	pixman_region32_t region;
+	pixman_region32_init_rect(&region, box.x, box.y, box.width, box.height);
+	pixman_region32_union_rect(&region, &region, lx, ly, box.width, box.height);
+	scene_node_output_update_region(&scene_output->scene->tree.node,
+		&scene_output->scene->outputs, &region,
+		scene_output->scene->tree.node.x, scene_output->scene->tree.node.y);
+	pixman_region32_fini(&region);
 }
 
 struct render_list_constructor_data {
@@ -1769,6 +3335,26 @@ static bool construct_render_list_iterator(struct wlr_scene_node *node,
 
 	pixman_region32_fini(&intersection);
 
+	// Cached sub-trees are rendered as a single entry for their top-most
+	// cached tree. All of its nodes are visited in a row.
+	struct wlr_scene_tree *cached_tree = NULL;
+	for (struct wlr_scene_tree *tree = node->parent; tree != NULL;
+			tree = tree->node.parent) {
+		if (tree->cache != NULL) {
+			cached_tree = tree;
+		}
+	}
+	if (cached_tree != NULL) {
+		struct render_list_entry *entries = data->render_list->data;
+		size_t len = data->render_list->size / sizeof(*entries);
+		if (len > 0 && entries[len - 1].node == &cached_tree->node) {
+			return false;
+		}
+
+		node = &cached_tree->node;
+		wlr_scene_node_coords(node, &lx, &ly);
+	}
+
 	struct render_list_entry *entry = wl_array_add(data->render_list, sizeof(*entry));
 	if (!entry) {
 		return false;
@@ -1802,117 +3388,508 @@ static void scene_buffer_send_dmabuf_feedback(const struct wlr_scene *scene,
 		return;
 	}
 
-	scene_buffer->prev_feedback_options = *options;
+	scene_buffer->prev_feedback_options = *options;
+
+	struct wlr_linux_dmabuf_feedback_v1 feedback = {0};
+	if (!wlr_linux_dmabuf_feedback_v1_init_with_options(&feedback, options)) {
+		return;
+	}
+
+	wlr_linux_dmabuf_v1_set_surface_feedback(scene->linux_dmabuf_v1,
+		surface->surface, &feedback);
+
+	wlr_linux_dmabuf_feedback_v1_finish(&feedback);
+}
+
+static struct wlr_buffer *scene_buffer_get_scanout_buffer(
+		struct wlr_scene_buffer *scene_buffer) {
+	struct wlr_buffer *buffer = scene_buffer->buffer;
+	struct wlr_client_buffer *client_buffer = wlr_client_buffer_get(buffer);
+	if (client_buffer != NULL && client_buffer->source != NULL && client_buffer->source->n_locks > 0) {
+		buffer = client_buffer->source;
+	}
+	return buffer;
+}
+
+static bool scene_entry_try_direct_scanout(struct render_list_entry *entry,
+		struct wlr_output_state *state, const struct render_data *data) {
+	struct wlr_scene_output *scene_output = data->output;
+	struct wlr_scene_node *node = entry->node;
+
+	if (!scene_output->scene->direct_scanout) {
+		return false;
+	}
+
+	if (node->type != WLR_SCENE_NODE_BUFFER) {
+		return false;
+	}
+
+	if (state->committed & (WLR_OUTPUT_STATE_MODE |
+			WLR_OUTPUT_STATE_ENABLED |
+			WLR_OUTPUT_STATE_RENDER_FORMAT)) {
+		// Legacy DRM will explode if we try to modeset with a direct scanout buffer
+		return false;
+	}
+
+	if (!wlr_output_is_direct_scanout_allowed(scene_output->output)) {
+		return false;
+	}
+
+	struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+	if (buffer->buffer == NULL || buffer->is_single_pixel_buffer) {
+		return false;
+	}
+
+	// The native size of the buffer after any transform is applied
+	int default_width = buffer->buffer->width;
+	int default_height = buffer->buffer->height;
+	wlr_output_transform_coords(buffer->transform, &default_width, &default_height);
+	struct wlr_fbox default_box = {
+		.width = default_width,
+		.height = default_height,
+	};
+
+	if (buffer->transform != data->transform) {
+		return false;
+	}
+
+	if (buffer->primary_output == scene_output) {
+		struct wlr_linux_dmabuf_feedback_v1_init_options options = {
+			.main_renderer = scene_output->output->renderer,
+			.scanout_primary_output = scene_output->output,
+		};
+
+		scene_buffer_send_dmabuf_feedback(scene_output->scene, buffer, &options);
+		entry->sent_dmabuf_feedback = true;
+	}
+
+	struct wlr_output_state pending;
+	wlr_output_state_init(&pending);
+	if (!wlr_output_state_copy(&pending, state)) {
+		return false;
+	}
+
+	if (!wlr_fbox_empty(&buffer->src_box) &&
+			!wlr_fbox_equal(&buffer->src_box, &default_box)) {
+		pending.buffer_src_box = buffer->src_box;
+	}
+
+	// Translate the position from scene coordinates to output coordinates
+	pending.buffer_dst_box.x = entry->x - scene_output->x;
+	pending.buffer_dst_box.y = entry->y - scene_output->y;
+
+	scene_node_get_size(node, &pending.buffer_dst_box.width, &pending.buffer_dst_box.height);
+	transform_output_box(&pending.buffer_dst_box, data);
+
+	wlr_output_state_set_buffer(&pending, scene_buffer_get_scanout_buffer(buffer));
+	if (buffer->wait_timeline != NULL) {
+		wlr_output_state_set_wait_timeline(&pending, buffer->wait_timeline, buffer->wait_point);
+	}
+
+	if (!wlr_output_test_state(scene_output->output, &pending)) {
+		wlr_output_state_finish(&pending);
+		return false;
+	}
+
+	wlr_output_state_copy(state, &pending);
+	wlr_output_state_finish(&pending);
+
+	struct wlr_scene_output_sample_event sample_event = {
+		.output = scene_output,
+		.direct_scanout = true,
+	};
+	wl_signal_emit_mutable(&buffer->events.output_sample, &sample_event);
+	return true;
+}
+
+/**
+ * Check whether an entry is an opaque black solid fill. These don't need any
+ * plane: the CRTC displays black where no plane covers it, like the
+ * background cleared when compositing.
+ */
+static bool scene_entry_is_black_fill(struct render_list_entry *entry) {
+	struct wlr_scene_node *node = entry->node;
+	const float *color;
+	if (node->type == WLR_SCENE_NODE_RECT) {
+		color = wlr_scene_rect_from_node(node)->color;
+	} else if (node->type == WLR_SCENE_NODE_BUFFER) {
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+		if (!buffer->is_single_pixel_buffer || buffer->opacity != 1) {
+			return false;
+		}
+		color = buffer->single_pixel_buffer_color;
+	} else {
+		return false;
+	}
+	return color[0] == 0 && color[1] == 0 && color[2] == 0 && color[3] == 1;
+}
+
+static bool scene_entry_can_offload(struct render_list_entry *entry,
+		const struct render_data *data) {
+	struct wlr_scene_node *node = entry->node;
+	if (node->type != WLR_SCENE_NODE_BUFFER) {
+		return false;
+	}
+
+	// Output layers don't support transforms nor explicit sync
+	struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+	if (buffer->buffer == NULL || buffer->is_single_pixel_buffer ||
+			buffer->transform != data->transform ||
+			buffer->wait_timeline != NULL) {
+		return false;
+	}
+
+	// Display engines don't necessarily blend like the renderer, and the
+	// nodes below would still need to be composited: only offload nodes
+	// which are opaque everywhere, considering their alpha channel, opaque
+	// region and opacity
+	int width, height;
+	scene_node_get_size(node, &width, &height);
+	pixman_box32_t node_box = { .x2 = width, .y2 = height };
+	if (pixman_region32_contains_rectangle(scene_node_get_opaque_region(node),
+			&node_box) != PIXMAN_REGION_IN) {
+		return false;
+	}
+
+	// Layers are displayed above everything composited into the primary
+	// buffer, so only nodes which aren't occluded at all can be offloaded.
+	pixman_box32_t box = {
+		.x1 = entry->x,
+		.y1 = entry->y,
+		.x2 = entry->x + width,
+		.y2 = entry->y + height,
+	};
+	return pixman_region32_contains_rectangle(&node->visible, &box) ==
+		PIXMAN_REGION_IN;
+}
+
+static bool scene_output_ensure_layers(struct wlr_scene_output *scene_output) {
+	if (scene_output->layers.size > 0) {
+		return true;
+	}
+
+	// Output layers must all be specified on commit, so don't use them if
+	// somebody else already manages layers on this output
+	if (!wl_list_empty(&scene_output->output->layers)) {
+		return false;
+	}
+
+	for (size_t i = 0; i < SCENE_OUTPUT_MAX_LAYERS; i++) {
+		struct wlr_output_layer_state *layer_state =
+			wl_array_add(&scene_output->layers, sizeof(*layer_state));
+		if (layer_state == NULL) {
+			return false;
+		}
+
+		*layer_state = (struct wlr_output_layer_state){
+			.layer = scene_output_layer_create(scene_output->output),
+		};
+		if (layer_state->layer == NULL) {
+			scene_output->layers.size -= sizeof(*layer_state);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void scene_output_reset_layers(struct wlr_scene_output *scene_output,
+		struct wlr_output_state *state) {
+	if (scene_output->layers.size == 0) {
+		return;
+	}
+
+	struct wlr_output_layer_state *layer_state;
+	wl_array_for_each(layer_state, &scene_output->layers) {
+		*layer_state = (struct wlr_output_layer_state){
+			.layer = layer_state->layer,
+		};
+	}
+
+	wlr_output_state_set_layers(state, scene_output->layers.data,
+		scene_output->layers.size / sizeof(*layer_state));
+}
+
+/**
+ * Try to display the top-most entries of the render list with output layers.
+ * Returns the number of entries which have been offloaded.
+ */
+static int scene_output_offload_layers(struct wlr_scene_output *scene_output,
+		struct wlr_output_state *state, struct render_list_entry *list,
+		int list_len, const struct render_data *data) {
+	struct wlr_output *output = scene_output->output;
+
+	if (!scene_output->scene->output_layers || scene_output->layers_rejected) {
+		return 0;
+	}
+
+	if (state->committed & (WLR_OUTPUT_STATE_MODE |
+			WLR_OUTPUT_STATE_ENABLED |
+			WLR_OUTPUT_STATE_RENDER_FORMAT)) {
+		return 0;
+	}
+
+	// Software cursors and screen capture need everything in the primary
+	// buffer
+	if (!wlr_output_is_direct_scanout_allowed(output)) {
+		return 0;
+	}
+
+	int candidates = 0;
+	while (candidates < list_len && candidates < SCENE_OUTPUT_MAX_LAYERS &&
+			scene_entry_can_offload(&list[candidates], data)) {
+		candidates++;
+	}
+	if (candidates == 0 || !scene_output_ensure_layers(scene_output)) {
+		return 0;
+	}
+
+	// Layers are ordered from bottom to top, the render list from top to
+	// bottom
+	struct wlr_output_layer_state *layers = scene_output->layers.data;
+	int layers_len = scene_output->layers.size / sizeof(*layers);
+	for (int i = 0; i < candidates; i++) {
+		struct render_list_entry *entry = &list[i];
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(entry->node);
+		struct wlr_output_layer_state *layer_state = &layers[layers_len - 1 - i];
+
+		layer_state->buffer = scene_buffer_get_scanout_buffer(buffer);
+		layer_state->src_box = buffer->src_box;
+		layer_state->dst_box = (struct wlr_box){
+			.x = entry->x - scene_output->x,
+			.y = entry->y - scene_output->y,
+		};
+		scene_node_get_size(entry->node,
+			&layer_state->dst_box.width, &layer_state->dst_box.height);
+		transform_output_box(&layer_state->dst_box, data);
+	}
+
+	wlr_output_state_set_layers(state, layers, layers_len);
+
+	// A layer can only be used if all layers above it have been accepted:
+	// anything composited ends up below all layers.
+	int accepted = 0;
+	if (wlr_output_test_state(output, state)) {
+		while (accepted < candidates &&
+				layers[layers_len - 1 - accepted].accepted) {
+			accepted++;
+		}
+	}
+
+	if (accepted > 0 && accepted < candidates) {
+		for (int i = accepted; i < candidates; i++) {
+			layers[layers_len - 1 - i].buffer = NULL;
+		}
+
+		if (!wlr_output_test_state(output, state)) {
+			accepted = 0;
+		}
+		for (int i = 0; i < accepted; i++) {
+			if (!layers[layers_len - 1 - i].accepted) {
+				accepted = 0;
+				break;
+			}
+		}
+	}
+
+	// Advertise the formats of the planes able to display each layer, so
+	// that clients allocate buffers which can stay on planes
+	for (int i = 0; i < candidates; i++) {
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(list[i].node);
+		struct scene_output_layer *scene_layer = layers[layers_len - 1 - i].layer->data;
+		if (buffer->primary_output != scene_output || !scene_layer->has_feedback) {
+			continue;
+		}
+
+		struct wlr_linux_dmabuf_feedback_v1_init_options options = {
+			.main_renderer = output->renderer,
+			.output_layer_feedback_event = &scene_layer->feedback,
+		};
+		scene_buffer_send_dmabuf_feedback(scene_output->scene, buffer, &options);
+		list[i].sent_dmabuf_feedback = true;
+	}
+
+	if (accepted == 0) {
+		scene_output->layers_rejected = true;
+		scene_output_reset_layers(scene_output, state);
+		return 0;
+	}
+
+	for (int i = 0; i < accepted; i++) {
+		struct render_list_entry *entry = &list[i];
+		entry->offloaded = true;
 
-	struct wlr_linux_dmabuf_feedback_v1 feedback = {0};
-	if (!wlr_linux_dmabuf_feedback_v1_init_with_options(&feedback, options)) {
-		return;
+		struct wlr_scene_output_sample_event sample_event = {
+			.output = scene_output,
+			.direct_scanout = true,
+		};
+		wl_signal_emit_mutable(&wlr_scene_buffer_from_node(entry->node)->events.output_sample,
+			&sample_event);
 	}
 
-	wlr_linux_dmabuf_v1_set_surface_feedback(scene->linux_dmabuf_v1,
-		surface->surface, &feedback);
-
-	wlr_linux_dmabuf_feedback_v1_finish(&feedback);
+	return accepted;
 }
 
-static bool scene_entry_try_direct_scanout(struct render_list_entry *entry,
-		struct wlr_output_state *state, const struct render_data *data) {
-	struct wlr_scene_output *scene_output = data->output;
-	struct wlr_scene_node *node = entry->node;
-
-	if (!scene_output->scene->direct_scanout) {
-		return false;
+/**
+ * Remember which nodes are displayed via output layers. When this changes,
+ * the primary buffer contents are stale underneath the affected nodes, so
+ * damage the whole output.
+ */
+static void scene_output_update_layer_nodes(struct wlr_scene_output *scene_output,
+		struct render_list_entry *list, int offloaded) {
+	struct wlr_scene_node **nodes = scene_output->layer_nodes.data;
+	int nodes_len = scene_output->layer_nodes.size / sizeof(*nodes);
+
+	bool changed = nodes_len != offloaded;
+	for (int i = 0; !changed && i < offloaded; i++) {
+		changed = nodes[i] != list[i].node;
+	}
+	if (!changed) {
+		return;
 	}
 
-	if (node->type != WLR_SCENE_NODE_BUFFER) {
-		return false;
-	}
+	scene_output_damage_whole(scene_output);
 
-	if (state->committed & (WLR_OUTPUT_STATE_MODE |
-			WLR_OUTPUT_STATE_ENABLED |
-			WLR_OUTPUT_STATE_RENDER_FORMAT)) {
-		// Legacy DRM will explode if we try to modeset with a direct scanout buffer
-		return false;
+	scene_output->layer_nodes.size = 0;
+	for (int i = 0; i < offloaded; i++) {
+		struct wlr_scene_node **node_ptr =
+			wl_array_add(&scene_output->layer_nodes, sizeof(*node_ptr));
+		if (node_ptr == NULL) {
+			break;
+		}
+		*node_ptr = list[i].node;
 	}
+}
 
-	if (!wlr_output_is_direct_scanout_allowed(scene_output->output)) {
-		return false;
-	}
+static bool scene_output_render_list_needs_update(
+		struct wlr_scene_output *scene_output, const struct wlr_box *box,
+		float scale) {
+	// Content-only updates (e.g. a new buffer of the same size) don't change
+	// the render list, so it can be reused as-is from the previous frame.
+	return scene_output->render_list_dirty ||
+		!wlr_box_equal(&scene_output->render_list_box, box) ||
+		scene_output->render_list_fractional_scale != (floor(scale) != scale);
+}
 
-	struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
-	if (buffer->buffer == NULL) {
+/**
+ * Rebuild the render list for the given logical box if needed. Only reads
+ * the scene-graph, and only writes to the scene output: this may run
+ * concurrently for different scene outputs.
+ */
+static bool scene_output_update_render_list(struct wlr_scene_output *scene_output,
+		const struct wlr_box *box, float scale) {
+	if (!scene_output_render_list_needs_update(scene_output, box, scale)) {
 		return false;
 	}
 
-	// The native size of the buffer after any transform is applied
-	int default_width = buffer->buffer->width;
-	int default_height = buffer->buffer->height;
-	wlr_output_transform_coords(buffer->transform, &default_width, &default_height);
-	struct wlr_fbox default_box = {
-		.width = default_width,
-		.height = default_height,
+	struct render_list_constructor_data list_con = {
+		.box = *box,
+		.render_list = &scene_output->render_list,
+		.calculate_visibility = scene_output->scene->calculate_visibility,
+		.highlight_transparent_region = scene_output->scene->highlight_transparent_region,
+		.fractional_scale = floor(scale) != scale,
 	};
 
-	if (buffer->transform != data->transform) {
-		return false;
-	}
+	list_con.render_list->size = 0;
+	scene_nodes_in_box(&scene_output->scene->tree.node, &list_con.box,
+		construct_render_list_iterator, &list_con);
+	array_realloc(list_con.render_list, list_con.render_list->size);
 
-	if (buffer->primary_output == scene_output) {
-		struct wlr_linux_dmabuf_feedback_v1_init_options options = {
-			.main_renderer = scene_output->output->renderer,
-			.scanout_primary_output = scene_output->output,
-		};
+	scene_output->render_list_dirty = false;
+	scene_output->render_list_box = list_con.box;
+	scene_output->render_list_fractional_scale = list_con.fractional_scale;
+	scene_output->layers_rejected = false;
+	return true;
+}
 
-		scene_buffer_send_dmabuf_feedback(scene_output->scene, buffer, &options);
-		entry->sent_dmabuf_feedback = true;
+// Upper bound on the number of threads building render lists
+#define RENDER_LIST_MAX_THREADS 8
+
+struct scene_render_list_job {
+	struct wlr_scene_output *scene_output;
+	struct wlr_box box;
+	float scale;
+};
+
+static void scene_render_list_job_run(void *data, int index) {
+	struct scene_render_list_job *jobs = data;
+	struct scene_render_list_job *job = &jobs[index];
+	scene_output_update_render_list(job->scene_output, &job->box, job->scale);
+}
+
+static struct thread_pool *scene_get_render_list_pool(struct wlr_scene *scene) {
+	if (scene->render_list_pool != NULL || scene->render_list_pool_failed) {
+		return scene->render_list_pool;
 	}
 
-	struct wlr_output_state pending;
-	wlr_output_state_init(&pending);
-	if (!wlr_output_state_copy(&pending, state)) {
-		return false;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int threads = cpus > RENDER_LIST_MAX_THREADS ? RENDER_LIST_MAX_THREADS : (int)cpus;
+	if (threads > 1) {
+		scene->render_list_pool = thread_pool_create(threads);
+	}
+	if (scene->render_list_pool == NULL) {
+		wlr_log(WLR_DEBUG, "Building render lists on the calling thread only");
+		scene->render_list_pool_failed = true;
 	}
+	return scene->render_list_pool;
+}
 
-	if (!wlr_fbox_empty(&buffer->src_box) &&
-			!wlr_fbox_equal(&buffer->src_box, &default_box)) {
-		pending.buffer_src_box = buffer->src_box;
+void wlr_scene_prepare_render_lists(struct wlr_scene *scene) {
+	int outputs_len = wl_list_length(&scene->outputs);
+	if (outputs_len == 0) {
+		return;
 	}
 
-	// Translate the position from scene coordinates to output coordinates
-	pending.buffer_dst_box.x = entry->x - scene_output->x;
-	pending.buffer_dst_box.y = entry->y - scene_output->y;
+	struct scene_render_list_job *jobs = calloc(outputs_len, sizeof(*jobs));
+	if (jobs == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
 
-	scene_node_get_size(node, &pending.buffer_dst_box.width, &pending.buffer_dst_box.height);
-	transform_output_box(&pending.buffer_dst_box, data);
+	int jobs_len = 0;
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		struct wlr_output *output = scene_output->output;
+		if (!output->enabled) {
+			continue;
+		}
 
-	struct wlr_buffer *wlr_buffer = buffer->buffer;
-	struct wlr_client_buffer *client_buffer = wlr_client_buffer_get(wlr_buffer);
-	if (client_buffer != NULL && client_buffer->source != NULL && client_buffer->source->n_locks > 0) {
-		wlr_buffer = client_buffer->source;
-	}
+		int width, height;
+		wlr_output_transformed_resolution(output, &width, &height);
+		struct wlr_box box = {
+			.x = scene_output->x,
+			.y = scene_output->y,
+			.width = width / output->scale,
+			.height = height / output->scale,
+		};
+		if (!scene_output_render_list_needs_update(scene_output,
+				&box, output->scale)) {
+			continue;
+		}
 
-	wlr_output_state_set_buffer(&pending, wlr_buffer);
-	if (buffer->wait_timeline != NULL) {
-		wlr_output_state_set_wait_timeline(&pending, buffer->wait_timeline, buffer->wait_point);
+		jobs[jobs_len++] = (struct scene_render_list_job){
+			.scene_output = scene_output,
+			.box = box,
+			.scale = output->scale,
+		};
 	}
 
-	if (!wlr_output_test_state(scene_output->output, &pending)) {
-		wlr_output_state_finish(&pending);
-		return false;
+	// The worker threads are kept around between frames, the calling thread
+	// runs jobs as well
+	struct thread_pool *pool = jobs_len > 1 ? scene_get_render_list_pool(scene) : NULL;
+	if (pool != NULL) {
+		thread_pool_run(pool, scene_render_list_job_run, jobs, jobs_len);
+	} else {
+		for (int i = 0; i < jobs_len; i++) {
+			scene_render_list_job_run(jobs, i);
+		}
 	}
 
-	wlr_output_state_copy(state, &pending);
-	wlr_output_state_finish(&pending);
-
-	struct wlr_scene_output_sample_event sample_event = {
-		.output = scene_output,
-		.direct_scanout = true,
-	};
-	wl_signal_emit_mutable(&buffer->events.output_sample, &sample_event);
-	return true;
+	free(jobs);
 }
 
 bool wlr_scene_output_needs_frame(struct wlr_scene_output *scene_output) {
+	scene_output_flush_damage(scene_output);
 	return scene_output->output->needs_frame || pixman_region32_not_empty(
 		&scene_output->pending_commit_damage) || scene_output->gamma_lut_changed;
 }
@@ -1940,6 +3917,58 @@ out:
 	return ok;
 }
 
+/**
+ * Add to the state a gamma LUT applying the color transform, so that the
+ * transform can be offloaded to the display hardware. Returns false if the
+ * transform can't be expressed as a gamma LUT, or if the gamma LUT is already
+ * used by a gamma control.
+ */
+static bool scene_output_state_offload_color_transform(
+		struct wlr_scene_output *scene_output, struct wlr_output_state *state,
+		struct wlr_color_transform *color_transform) {
+	if (scene_output->gamma_lut != NULL) {
+		return false;
+	}
+	if (scene_output->gamma_color_transform == color_transform) {
+		// Already applied by the output
+		return true;
+	}
+
+	size_t ramp_size = wlr_output_get_gamma_size(scene_output->output);
+	if (ramp_size == 0) {
+		return false;
+	}
+
+	uint16_t *ramps = calloc(3 * ramp_size, sizeof(ramps[0]));
+	if (ramps == NULL) {
+		return false;
+	}
+	uint16_t *r = ramps, *g = ramps + ramp_size, *b = ramps + 2 * ramp_size;
+	bool ok = color_transform_get_gamma_lut(color_transform, ramp_size, r, g, b) &&
+		wlr_output_state_set_gamma_lut(state, ramp_size, r, g, b);
+	free(ramps);
+	return ok;
+}
+
+static void scene_output_set_gamma_color_transform(
+		struct wlr_scene_output *scene_output,
+		struct wlr_color_transform *color_transform) {
+	if (scene_output->gamma_color_transform == color_transform) {
+		return;
+	}
+	wlr_color_transform_unref(scene_output->gamma_color_transform);
+	scene_output->gamma_color_transform = NULL;
+	if (color_transform != NULL) {
+		scene_output->gamma_color_transform =
+			wlr_color_transform_ref(color_transform);
+	}
+}
+
+/**
+ * Apply a gamma LUT change from a gamma control to the state. Must be called
+ * before rendering: if the output rejects the gamma LUT, it is applied by the
+ * renderer.
+ */
 static void scene_output_state_attempt_gamma(struct wlr_scene_output *scene_output,
 		struct wlr_output_state *state) {
 	if (!scene_output->gamma_lut_changed) {
@@ -1957,28 +3986,235 @@ static void scene_output_state_attempt_gamma(struct wlr_scene_output *scene_outp
 	}
 
 	scene_output->gamma_lut_changed = false;
-	if (!wlr_output_test_state(scene_output->output, &gamma_pending)) {
-		wlr_gamma_control_v1_send_failed_and_destroy(scene_output->gamma_lut);
-
-		scene_output->gamma_lut = NULL;
+	if (wlr_output_test_state(scene_output->output, &gamma_pending)) {
+		// The gamma LUT belongs to the gamma control now
+		scene_output_set_gamma_color_transform(scene_output, NULL);
+		scene_output_set_gamma_fallback(scene_output, NULL);
+		wlr_output_state_copy(state, &gamma_pending);
 		wlr_output_state_finish(&gamma_pending);
 		return;
 	}
 
-	wlr_output_state_copy(state, &gamma_pending);
+	// Apply the gamma LUT while rendering instead, if the renderer can
+	struct wlr_color_transform *fallback = NULL;
+	struct wlr_renderer *renderer = scene_output->output->renderer;
+	if (renderer != NULL && renderer->features.output_color_transform &&
+			gamma_pending.gamma_lut_size >= 2) {
+		size_t ramp_size = gamma_pending.gamma_lut_size;
+		const uint16_t *r = gamma_pending.gamma_lut;
+		fallback = color_transform_init_gamma_lut(ramp_size,
+			r, r + ramp_size, r + 2 * ramp_size);
+	}
 	wlr_output_state_finish(&gamma_pending);
+
+	if (fallback == NULL) {
+		wlr_gamma_control_v1_send_failed_and_destroy(scene_output->gamma_lut);
+		scene_output->gamma_lut = NULL;
+		return;
+	}
+
+	wlr_log(WLR_DEBUG, "Output %s rejected gamma LUT, applying it while "
+		"rendering", scene_output->output->name);
+	scene_output_set_gamma_fallback(scene_output, fallback);
+	wlr_color_transform_unref(fallback);
 }
 
-bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
+/**
+ * Draw a heatmap of how many render list entries cover each pixel, and
+ * periodically log how much was drawn and culled.
+ */
+static void scene_output_render_overdraw(struct wlr_scene_output *scene_output,
+		struct render_list_entry *list_data, int list_len,
+		const struct render_data *data, int width, int height) {
+	// levels[i] is the area covered by more than i entries
+	pixman_region32_t levels[OVERDRAW_LEVELS];
+	for (int i = 0; i < OVERDRAW_LEVELS; i++) {
+		pixman_region32_init(&levels[i]);
+	}
+
+	uint64_t drawn = 0, culled = 0;
+	pixman_region32_t region, full, covered;
+	pixman_region32_init(&region);
+	pixman_region32_init(&full);
+	pixman_region32_init(&covered);
+	for (int i = 0; i < list_len; i++) {
+		struct render_list_entry *entry = &list_data[i];
+
+		pixman_region32_clear(&region);
+		scene_entry_get_region(entry, data, &region);
+		pixman_region32_intersect_rect(&region, &region, 0, 0, width, height);
+		drawn += region_area(&region);
+
+		struct wlr_box box = { .x = entry->x, .y = entry->y };
+		if (entry->node->type == WLR_SCENE_NODE_TREE) {
+			struct wlr_scene_tree *tree = wlr_scene_tree_from_node(entry->node);
+			box.x += tree->bounds.x;
+			box.y += tree->bounds.y;
+			box.width = tree->bounds.width;
+			box.height = tree->bounds.height;
+		} else {
+			scene_node_get_size(entry->node, &box.width, &box.height);
+		}
+		pixman_region32_fini(&full);
+		pixman_region32_init_rect(&full, box.x - data->logical.x,
+			box.y - data->logical.y, box.width, box.height);
+		logical_to_buffer_coords(&full, data);
+		pixman_region32_intersect_rect(&full, &full, 0, 0, width, height);
+		uint64_t full_area = region_area(&full);
+		culled += full_area > region_area(&region) ?
+			full_area - region_area(&region) : 0;
+
+		for (int j = OVERDRAW_LEVELS - 1; j > 0; j--) {
+			pixman_region32_intersect(&covered, &levels[j - 1], &region);
+			pixman_region32_union(&levels[j], &levels[j], &covered);
+		}
+		pixman_region32_union(&levels[0], &levels[0], &region);
+	}
+	pixman_region32_fini(&covered);
+	pixman_region32_fini(&full);
+	pixman_region32_fini(&region);
+
+	static const float colors[OVERDRAW_LEVELS][4] = {
+		{ 0, 0, 0.3, 0.3 },
+		{ 0, 0.4, 0, 0.4 },
+		{ 0.5, 0.5, 0, 0.5 },
+		{ 0.6, 0, 0, 0.6 },
+	};
+	for (int i = 0; i < OVERDRAW_LEVELS; i++) {
+		// Only the pixels at exactly this level, except for the last one
+		if (i + 1 < OVERDRAW_LEVELS) {
+			pixman_region32_subtract(&levels[i], &levels[i], &levels[i + 1]);
+		}
+		wlr_render_pass_add_rect(data->render_pass, &(struct wlr_render_rect_options){
+			.box = { .width = width, .height = height },
+			.color = {
+				.r = colors[i][0],
+				.g = colors[i][1],
+				.b = colors[i][2],
+				.a = colors[i][3],
+			},
+			.clip = &levels[i],
+		});
+		pixman_region32_fini(&levels[i]);
+	}
+
+	struct timespec now, time_diff;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	timespec_sub(&time_diff, &now, &scene_output->overdraw_summary_time);
+	if (timespec_to_msec(&time_diff) >= OVERDRAW_SUMMARY_INTERVAL_MS) {
+		scene_output->overdraw_summary_time = now;
+		uint64_t output_area = (uint64_t)width * height;
+		wlr_log(WLR_DEBUG, "Scene overdraw on %s: %d entries, %"PRIu64" pixels "
+			"drawn for %"PRIu64" output pixels (%.2fx), %"PRIu64" pixels culled",
+			scene_output->output->name, list_len, drawn, output_area,
+			output_area > 0 ? (double)drawn / output_area : 0.0, culled);
+	}
+}
+
+static enum wp_content_type_v1_type scene_output_get_content_type(
+		struct wlr_scene_output *scene_output, struct render_list_entry *list_data,
+		int list_len, const struct wlr_box *logical) {
+	struct wlr_content_type_manager_v1 *manager =
+		scene_output->scene->content_type_manager_v1;
+	if (manager == NULL) {
+		return WP_CONTENT_TYPE_V1_TYPE_NONE;
+	}
+
+	struct wlr_surface *dominant = NULL;
+	int dominant_area = 0;
+	for (int i = 0; i < list_len; i++) {
+		struct wlr_scene_node *node = list_data[i].node;
+		if (node->type != WLR_SCENE_NODE_BUFFER) {
+			continue;
+		}
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_try_from_buffer(wlr_scene_buffer_from_node(node));
+		if (scene_surface == NULL) {
+			continue;
+		}
+
+		struct wlr_box box = { .x = list_data[i].x, .y = list_data[i].y };
+		scene_node_get_size(node, &box.width, &box.height);
+		if (!wlr_box_intersection(&box, &box, logical)) {
+			continue;
+		}
+		int area = box.width * box.height;
+		if (area > dominant_area) {
+			dominant = scene_surface->surface;
+			dominant_area = area;
+		}
+	}
+
+	// Small surfaces don't decide how the whole output is presented
+	if (dominant == NULL ||
+			dominant_area * 2 < logical->width * logical->height) {
+		return WP_CONTENT_TYPE_V1_TYPE_NONE;
+	}
+	return wlr_surface_get_content_type_v1(manager, dominant);
+}
+
+/**
+ * Enables adaptive sync for games and videos, returns whether tearing
+ * page-flips should be attempted.
+ */
+static bool scene_output_apply_content_type(struct wlr_scene_output *scene_output,
+		struct wlr_output_state *state, enum wp_content_type_v1_type content_type) {
+	struct wlr_output *output = scene_output->output;
+
+	if (scene_output->content_type != content_type) {
+		scene_output->content_type = content_type;
+		scene_output->content_type_adaptive_sync_rejected = false;
+		scene_output->content_type_tearing_rejected = false;
+	}
+
+	bool adaptive_sync = content_type == WP_CONTENT_TYPE_V1_TYPE_GAME ||
+		content_type == WP_CONTENT_TYPE_V1_TYPE_VIDEO;
+	bool enabled = output->adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
+	if (output->adaptive_sync_supported &&
+			!(state->committed & WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED)) {
+		if (adaptive_sync && !enabled &&
+				!scene_output->content_type_adaptive_sync_rejected) {
+			struct wlr_output_state test_state;
+			wlr_output_state_init(&test_state);
+			wlr_output_state_set_adaptive_sync_enabled(&test_state, true);
+			if (wlr_output_test_state(output, &test_state)) {
+				wlr_output_state_set_adaptive_sync_enabled(state, true);
+				scene_output->content_type_adaptive_sync = true;
+			} else {
+				scene_output->content_type_adaptive_sync_rejected = true;
+			}
+			wlr_output_state_finish(&test_state);
+		} else if (!adaptive_sync && enabled &&
+				scene_output->content_type_adaptive_sync) {
+			wlr_output_state_set_adaptive_sync_enabled(state, false);
+			scene_output->content_type_adaptive_sync = false;
+		}
+	}
+
+	return content_type == WP_CONTENT_TYPE_V1_TYPE_GAME &&
+		!state->tearing_page_flip &&
+		!scene_output->content_type_tearing_rejected;
+}
+
+static bool scene_output_build_state(struct wlr_scene_output *scene_output,
 		struct wlr_output_state *state, const struct wlr_scene_output_state_options *options) {
 	struct wlr_scene_output_state_options default_options = {0};
 	if (!options) {
 		options = &default_options;
 	}
 	struct wlr_scene_timer *timer = options->timer;
+
+	scene_send_outputs_update(scene_output->scene);
+	scene_evict_textures(scene_output->scene);
+
 	struct timespec start_time;
 	if (timer) {
 		clock_gettime(CLOCK_MONOTONIC, &start_time);
+		if (timer->pre_render_duration > 0 || timer->render_timer != NULL) {
+			// The previous frame has been rendered by now
+			wlr_output_add_render_duration(scene_output->output,
+				wlr_scene_timer_get_duration_ns(timer));
+		}
 		wlr_scene_timer_finish(timer);
 		*timer = (struct wlr_scene_timer){0};
 	}
@@ -2027,25 +4263,46 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 	render_data.logical.width = render_data.trans_width / render_data.scale;
 	render_data.logical.height = render_data.trans_height / render_data.scale;
 
-	struct render_list_constructor_data list_con = {
-		.box = render_data.logical,
-		.render_list = &scene_output->render_list,
-		.calculate_visibility = scene_output->scene->calculate_visibility,
-		.highlight_transparent_region = scene_output->scene->highlight_transparent_region,
-		.fractional_scale = floor(render_data.scale) != render_data.scale,
-	};
+	bool rebuild_render_list = scene_output_update_render_list(scene_output,
+		&render_data.logical, render_data.scale);
 
-	list_con.render_list->size = 0;
-	scene_nodes_in_box(&scene_output->scene->tree.node, &list_con.box,
-		construct_render_list_iterator, &list_con);
-	array_realloc(list_con.render_list, list_con.render_list->size);
+	struct render_list_entry *list_data = scene_output->render_list.data;
+	int list_len = scene_output->render_list.size / sizeof(*list_data);
 
-	struct render_list_entry *list_data = list_con.render_list->data;
-	int list_len = list_con.render_list->size / sizeof(*list_data);
+	if (!rebuild_render_list) {
+		for (int i = 0; i < list_len; i++) {
+			list_data[i].sent_dmabuf_feedback = false;
+			list_data[i].offloaded = false;
+		}
+	}
 
-	if (debug_damage == WLR_SCENE_DEBUG_DAMAGE_RERENDER) {
+	if (debug_damage == WLR_SCENE_DEBUG_DAMAGE_RERENDER ||
+			debug_damage == WLR_SCENE_DEBUG_DAMAGE_OVERDRAW) {
 		scene_output_damage_whole(scene_output);
 	}
+	// Debug overlays need the whole frame to be composited
+	bool debug_overlay = debug_damage == WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT ||
+		debug_damage == WLR_SCENE_DEBUG_DAMAGE_OVERDRAW;
+
+	bool gamma_changed = scene_output->gamma_lut_changed;
+	scene_output_state_attempt_gamma(scene_output, state);
+	scene_output_flush_damage(scene_output);
+
+	// Night-light style gamma updates: if nothing else changed, only send
+	// the gamma LUT to the display without a new buffer
+	if (gamma_changed && (state->committed & WLR_OUTPUT_STATE_GAMMA_LUT) &&
+			(state->committed & ~WLR_OUTPUT_STATE_GAMMA_LUT) == 0 &&
+			output->enabled && !output->needs_frame && !rebuild_render_list &&
+			!debug_overlay &&
+			!pixman_region32_not_empty(&scene_output->pending_commit_damage)) {
+		return true;
+	}
+
+	// Color transform applied while rendering
+	struct wlr_color_transform *color_transform = options->color_transform;
+	if (color_transform == NULL) {
+		color_transform = scene_output->gamma_fallback;
+	}
 
 	struct timespec now;
 	if (debug_damage == WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT) {
@@ -2085,15 +4342,66 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		pixman_region32_fini(&acc_damage);
 	}
 
+	scene_output_flush_damage(scene_output);
+
+	// Layers which aren't used in this frame need to be disabled explicitly
+	scene_output_reset_layers(scene_output, state);
+
+	enum wp_content_type_v1_type content_type = scene_output_get_content_type(
+		scene_output, list_data, list_len, &render_data.logical);
+	// Tearing is only used for direct scan-out, composited frames don't
+	// benefit from it
+	bool tearing = scene_output_apply_content_type(scene_output, state,
+		content_type);
+
 	wlr_output_state_set_damage(state, &scene_output->pending_commit_damage);
 
+	// Letterboxing is commonly done with black fills below the content,
+	// which can be left to the CRTC background
+	int scanout_list_len = list_len;
+	while (scanout_list_len > 1 &&
+			scene_entry_is_black_fill(&list_data[scanout_list_len - 1])) {
+		scanout_list_len--;
+	}
+
 	// We only want to try direct scanout if:
-	// - There is only one entry in the render list
-	// - There are no color transforms that need to be applied
-	// - Damage highlight debugging is not enabled
-	bool scanout = options->color_transform == NULL &&
-		list_len == 1 && debug_damage != WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT &&
-		scene_entry_try_direct_scanout(&list_data[0], state, &render_data);
+	// - There is only one entry in the render list, ignoring black fills
+	// - There are no color transforms that need to be applied, or the output
+	//   can apply them with its gamma LUT
+	// - Damage highlight and overdraw debugging are not enabled
+	bool scanout = false;
+	if (scanout_list_len == 1 && !debug_overlay &&
+			scene_output->gamma_fallback == NULL) {
+		if (color_transform == NULL && tearing) {
+			state->tearing_page_flip = true;
+			scanout = scene_entry_try_direct_scanout(&list_data[0], state, &render_data);
+			if (!scanout) {
+				state->tearing_page_flip = false;
+				scanout = scene_entry_try_direct_scanout(&list_data[0],
+					state, &render_data);
+				// Only give up on tearing if it was the reason of the failure
+				scene_output->content_type_tearing_rejected = scanout;
+			}
+		} else if (color_transform == NULL) {
+			scanout = scene_entry_try_direct_scanout(&list_data[0], state, &render_data);
+		} else {
+			struct wlr_output_state scanout_state = {0};
+			if (wlr_output_state_copy(&scanout_state, state) &&
+					scene_output_state_offload_color_transform(scene_output,
+						&scanout_state, options->color_transform)) {
+				scanout = scene_entry_try_direct_scanout(&list_data[0],
+					&scanout_state, &render_data);
+			}
+			if (scanout) {
+				wlr_output_state_copy(state, &scanout_state);
+				scene_output_set_gamma_color_transform(scene_output,
+					options->color_transform);
+				// Supersedes the reset of a destroyed gamma control
+				scene_output->gamma_lut_changed = false;
+			}
+			wlr_output_state_finish(&scanout_state);
+		}
+	}
 
 	if (scene_output->prev_scanout != scanout) {
 		scene_output->prev_scanout = scanout;
@@ -2101,9 +4409,16 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 			scanout ? "enabled" : "disabled");
 	}
 
-	if (scanout) {
-		scene_output_state_attempt_gamma(scene_output, state);
+	int offloaded = 0;
+	if (!scanout && color_transform == NULL && !debug_overlay) {
+		offloaded = scene_output_offload_layers(scene_output, state,
+			list_data, list_len, &render_data);
+	}
+
+	scene_output_update_layer_nodes(scene_output, list_data, offloaded);
+	wlr_output_state_set_damage(state, &scene_output->pending_commit_damage);
 
+	if (scanout) {
 		if (timer) {
 			struct timespec end_time, duration;
 			clock_gettime(CLOCK_MONOTONIC, &end_time);
@@ -2122,6 +4437,34 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		swapchain = output->swapchain;
 	}
 
+	// Commits without any change to the scene (e.g. for presentation
+	// feedback or gamma changes) can submit the last composited frame again
+	struct wlr_buffer *last_frame = scene_output->last_frame;
+	if (last_frame != NULL && !rebuild_render_list && !debug_overlay &&
+			offloaded == 0 && swapchain == scene_output->last_frame_swapchain &&
+			color_transform == scene_output->last_frame_color_transform &&
+			last_frame->width == resolution_width &&
+			last_frame->height == resolution_height &&
+			!pixman_region32_not_empty(&scene_output->pending_commit_damage)) {
+		wlr_output_state_set_buffer(state, last_frame);
+		if (scene_output->in_timeline != NULL) {
+			wlr_output_state_set_wait_timeline(state, scene_output->in_timeline,
+				scene_output->in_point);
+		}
+		if (scene_output->gamma_color_transform != NULL) {
+			// The frame was composited with the color transform applied
+			wlr_output_state_set_gamma_lut(state, 0, NULL, NULL, NULL);
+			scene_output_set_gamma_color_transform(scene_output, NULL);
+		}
+		if (timer) {
+			struct timespec end_time, duration;
+			clock_gettime(CLOCK_MONOTONIC, &end_time);
+			timespec_sub(&duration, &end_time, &start_time);
+			timer->pre_render_duration = timespec_to_nsec(&duration);
+		}
+		return true;
+	}
+
 	struct wlr_buffer *buffer = wlr_swapchain_acquire(swapchain);
 	if (buffer == NULL) {
 		return false;
@@ -2138,11 +4481,20 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		timer->pre_render_duration = timespec_to_nsec(&duration);
 	}
 
+	// Cached trees are rendered in their own passes, which can't be nested
+	for (int i = 0; i < list_len; i++) {
+		struct render_list_entry *entry = &list_data[i];
+		if (entry->node->type == WLR_SCENE_NODE_TREE) {
+			scene_tree_cache_update(wlr_scene_tree_from_node(entry->node),
+				entry->x, entry->y, &render_data);
+		}
+	}
+
 	scene_output->in_point++;
 	struct wlr_render_pass *render_pass = wlr_renderer_begin_buffer_pass(output->renderer, buffer,
 			&(struct wlr_buffer_pass_options){
 		.timer = timer ? timer->render_timer : NULL,
-		.color_transform = options->color_transform,
+		.color_transform = color_transform,
 		.signal_timeline = scene_output->in_timeline,
 		.signal_point = scene_output->in_point,
 	});
@@ -2167,6 +4519,9 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 	if (scene_output->scene->calculate_visibility) {
 		for (int i = list_len - 1; i >= 0; i--) {
 			struct render_list_entry *entry = &list_data[i];
+			if (entry->offloaded) {
+				continue;
+			}
 
 			// We must only cull opaque regions that are visible by the node.
 			// The node's visibility will have the knowledge of a black rect
@@ -2202,12 +4557,20 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 
 	for (int i = list_len - 1; i >= 0; i--) {
 		struct render_list_entry *entry = &list_data[i];
-		scene_entry_render(entry, &render_data);
+		if (!entry->offloaded) {
+			scene_entry_render(entry, &render_data);
+		}
 
 		if (entry->node->type == WLR_SCENE_NODE_BUFFER) {
 			struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(entry->node);
 
-			if (buffer->primary_output == scene_output && !entry->sent_dmabuf_feedback) {
+			// Keep advertising the plane formats while output layers
+			// are rejected, so that the client gets a chance to
+			// reallocate its buffers
+			bool keep_layer_feedback = scene_output->layers_rejected &&
+				buffer->prev_feedback_options.output_layer_feedback_event != NULL;
+			if (buffer->primary_output == scene_output &&
+					!entry->sent_dmabuf_feedback && !keep_layer_feedback) {
 				struct wlr_linux_dmabuf_feedback_v1_init_options options = {
 					.main_renderer = output->renderer,
 					.scanout_primary_output = NULL,
@@ -2218,6 +4581,11 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		}
 	}
 
+	if (debug_damage == WLR_SCENE_DEBUG_DAMAGE_OVERDRAW) {
+		scene_output_render_overdraw(scene_output, list_data, list_len,
+			&render_data, buffer->width, buffer->height);
+	}
+
 	if (debug_damage == WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT) {
 		struct highlight_region *damage;
 		wl_list_for_each(damage, &scene_output->damage_highlight_regions, link) {
@@ -2247,6 +4615,9 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 	}
 
 	wlr_output_state_set_buffer(state, buffer);
+	// Frames without offloaded layers hold the whole scene
+	scene_output_set_last_frame(scene_output, offloaded == 0 ? buffer : NULL,
+		swapchain, color_transform);
 	wlr_buffer_unlock(buffer);
 
 	if (scene_output->in_timeline != NULL) {
@@ -2254,7 +4625,11 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 			scene_output->in_point);
 	}
 
-	scene_output_state_attempt_gamma(scene_output, state);
+	if (scene_output->gamma_color_transform != NULL) {
+		// The color transform is applied while rendering now
+		wlr_output_state_set_gamma_lut(state, 0, NULL, NULL, NULL);
+		scene_output_set_gamma_color_transform(scene_output, NULL);
+	}
 
 	return true;
 }
@@ -2274,6 +4649,18 @@ void wlr_scene_timer_finish(struct wlr_scene_timer *timer) {
 	}
 }
 
+static void scene_buffer_send_hidden_frame_done(struct wlr_scene_buffer *scene_buffer,
+		int interval_ms, struct timespec *now) {
+	struct timespec elapsed;
+	timespec_sub(&elapsed, now, &scene_buffer->last_hidden_frame_done);
+	if (timespec_to_msec(&elapsed) < interval_ms) {
+		return;
+	}
+
+	scene_buffer->last_hidden_frame_done = *now;
+	wl_signal_emit_mutable(&scene_buffer->events.frame_done, now);
+}
+
 static void scene_node_send_frame_done(struct wlr_scene_node *node,
 		struct wlr_scene_output *scene_output, struct timespec *now) {
 	if (!node->enabled) {
@@ -2286,6 +4673,12 @@ static void scene_node_send_frame_done(struct wlr_scene_node *node,
 
 		if (scene_buffer->primary_output == scene_output) {
 			wlr_scene_buffer_send_frame_done(scene_buffer, now);
+		} else if (scene_buffer->primary_output == NULL &&
+				scene_output->scene->hidden_frame_interval_ms > 0) {
+			// Each output's frame may reach this, the interval is
+			// tracked per buffer
+			scene_buffer_send_hidden_frame_done(scene_buffer,
+				scene_output->scene->hidden_frame_interval_ms, now);
 		}
 	} else if (node->type == WLR_SCENE_NODE_TREE) {
 		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
@@ -2296,10 +4689,20 @@ static void scene_node_send_frame_done(struct wlr_scene_node *node,
 	}
 }
 
+bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
+		struct wlr_output_state *state, const struct wlr_scene_output_state_options *options) {
+	trace_begin("scene_output_build_state");
+	bool ok = scene_output_build_state(scene_output, state, options);
+	trace_end();
+	return ok;
+}
+
 void wlr_scene_output_send_frame_done(struct wlr_scene_output *scene_output,
 		struct timespec *now) {
+	trace_begin("scene_output_send_frame_done");
 	scene_node_send_frame_done(&scene_output->scene->tree.node,
 		scene_output, now);
+	trace_end();
 }
 
 static void scene_output_for_each_scene_buffer(const struct wlr_box *output_box,
@@ -2324,6 +4727,13 @@ static void scene_output_for_each_scene_buffer(const struct wlr_box *output_box,
 		}
 	} else if (node->type == WLR_SCENE_NODE_TREE) {
 		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		struct wlr_box bounds = scene_tree->bounds;
+		bounds.x += lx;
+		bounds.y += ly;
+		if (!wlr_box_intersection(&bounds, &bounds, output_box)) {
+			return;
+		}
+
 		struct wlr_scene_node *child;
 		wl_list_for_each(child, &scene_tree->children, link) {
 			scene_output_for_each_scene_buffer(output_box, child, lx, ly,
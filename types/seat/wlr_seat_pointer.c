@@ -53,10 +53,12 @@ const struct wlr_pointer_grab_interface default_pointer_grab_impl = {
 };
 
 
-static void pointer_send_frame(struct wl_resource *resource) {
+static void pointer_send_frame(struct wlr_seat_client *seat_client,
+		struct wl_resource *resource) {
 	if (wl_resource_get_version(resource) >=
 			WL_POINTER_FRAME_SINCE_VERSION) {
 		wl_pointer_send_frame(resource);
+		seat_client->seat->pointer_state.sent_events++;
 	}
 }
 
@@ -152,7 +154,8 @@ void seat_client_send_pointer_leave_raw(struct wlr_seat_client *seat_client,
 		}
 
 		wl_pointer_send_leave(resource, serial, surface->resource);
-		pointer_send_frame(resource);
+		seat_client->seat->pointer_state.sent_events++;
+		pointer_send_frame(seat_client, resource);
 	}
 }
 
@@ -190,7 +193,8 @@ void wlr_seat_pointer_enter(struct wlr_seat *wlr_seat,
 
 			wl_pointer_send_enter(resource, serial, surface->resource,
 				wl_fixed_from_double(sx), wl_fixed_from_double(sy));
-			pointer_send_frame(resource);
+			wlr_seat->pointer_state.sent_events++;
+			pointer_send_frame(client, resource);
 		}
 	}
 
@@ -252,7 +256,9 @@ void wlr_seat_pointer_send_motion(struct wlr_seat *wlr_seat, uint32_t time,
 			}
 
 			wl_pointer_send_motion(resource, time, sx_fixed, sy_fixed);
+			wlr_seat->pointer_state.sent_events++;
 		}
+		client->needs_pointer_frame = true;
 	}
 
 	wlr_seat_pointer_warp(wlr_seat, sx, sy);
@@ -273,7 +279,9 @@ uint32_t wlr_seat_pointer_send_button(struct wlr_seat *wlr_seat, uint32_t time,
 		}
 
 		wl_pointer_send_button(resource, serial, time, button, state);
+		wlr_seat->pointer_state.sent_events++;
 	}
+	client->needs_pointer_frame = true;
 	return serial;
 }
 
@@ -357,6 +365,9 @@ void wlr_seat_pointer_send_axis(struct wlr_seat *wlr_seat, uint32_t time,
 			continue;
 		}
 
+		client->needs_pointer_frame = true;
+		wlr_seat->pointer_state.sent_events++;
+
 		if (send_source && version >= WL_POINTER_AXIS_SOURCE_SINCE_VERSION) {
 			wl_pointer_send_axis_source(resource, source);
 		}
@@ -400,13 +411,19 @@ void wlr_seat_pointer_send_frame(struct wlr_seat *wlr_seat) {
 
 	wlr_seat->pointer_state.sent_axis_source = false;
 
+	// Duplicate motion events are dropped, don't send empty frames either
+	if (!client->needs_pointer_frame) {
+		return;
+	}
+	client->needs_pointer_frame = false;
+
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &client->pointers) {
 		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
 			continue;
 		}
 
-		pointer_send_frame(resource);
+		pointer_send_frame(client, resource);
 	}
 }
 
@@ -577,7 +594,8 @@ void seat_client_create_pointer(struct wlr_seat_client *seat_client,
 
 				wl_pointer_send_enter(resource, serial, focused_surface->resource,
 					wl_fixed_from_double(sx), wl_fixed_from_double(sy));
-				pointer_send_frame(resource);
+				seat_client->seat->pointer_state.sent_events++;
+				pointer_send_frame(focused_client, resource);
 			}
 		}
 	}
@@ -330,6 +330,7 @@ uint32_t wlr_seat_touch_send_down(struct wlr_seat *seat,
 		}
 		wl_touch_send_down(resource, serial, time, surface->resource,
 			touch_id, wl_fixed_from_double(sx), wl_fixed_from_double(sy));
+		seat->touch_state.sent_events++;
 	}
 
 	point->client->needs_touch_frame = true;
@@ -351,6 +352,7 @@ uint32_t wlr_seat_touch_send_up(struct wlr_seat *seat, uint32_t time, int32_t to
 			continue;
 		}
 		wl_touch_send_up(resource, serial, time, touch_id);
+		seat->touch_state.sent_events++;
 	}
 
 	point->client->needs_touch_frame = true;
@@ -372,6 +374,7 @@ void wlr_seat_touch_send_motion(struct wlr_seat *seat, uint32_t time, int32_t to
 		}
 		wl_touch_send_motion(resource, time, touch_id, wl_fixed_from_double(sx),
 			wl_fixed_from_double(sy));
+		seat->touch_state.sent_events++;
 	}
 
 	point->client->needs_touch_frame = true;
@@ -387,6 +390,7 @@ void wlr_seat_touch_send_frame(struct wlr_seat *seat) {
 		struct wl_resource *resource;
 		wl_resource_for_each(resource, &seat_client->touches) {
 			wl_touch_send_frame(resource);
+			seat->touch_state.sent_events++;
 		}
 		seat_client->needs_touch_frame = false;
 	}
@@ -400,6 +404,7 @@ void wlr_seat_touch_send_cancel(struct wlr_seat *seat,
 			continue;
 		}
 		wl_touch_send_cancel(resource);
+		seat_client->seat->touch_state.sent_events++;
 	}
 }
 
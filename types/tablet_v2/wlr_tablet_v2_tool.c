@@ -285,9 +285,41 @@ static ssize_t tablet_tool_button_update(struct wlr_tablet_v2_tablet_tool *tool,
 	return i;
 }
 
+static void flush_tool_axes(struct wlr_tablet_tool_client_v2 *tool) {
+	uint32_t axes = tool->pending_axes;
+	tool->pending_axes = 0;
+
+	if (axes & TABLET_TOOL_AXIS_MOTION) {
+		zwp_tablet_tool_v2_send_motion(tool->resource,
+			wl_fixed_from_double(tool->x), wl_fixed_from_double(tool->y));
+	}
+	if (axes & TABLET_TOOL_AXIS_PRESSURE) {
+		zwp_tablet_tool_v2_send_pressure(tool->resource,
+			tool->pressure * 65535);
+	}
+	if (axes & TABLET_TOOL_AXIS_DISTANCE) {
+		zwp_tablet_tool_v2_send_distance(tool->resource,
+			tool->distance * 65535);
+	}
+	if (axes & TABLET_TOOL_AXIS_TILT) {
+		zwp_tablet_tool_v2_send_tilt(tool->resource,
+			wl_fixed_from_double(tool->tilt_x),
+			wl_fixed_from_double(tool->tilt_y));
+	}
+	if (axes & TABLET_TOOL_AXIS_ROTATION) {
+		zwp_tablet_tool_v2_send_rotation(tool->resource,
+			wl_fixed_from_double(tool->rotation));
+	}
+	if (axes & TABLET_TOOL_AXIS_SLIDER) {
+		zwp_tablet_tool_v2_send_slider(tool->resource,
+			tool->slider * 65535);
+	}
+}
+
 static void send_tool_frame(void *data) {
 	struct wlr_tablet_tool_client_v2 *tool = data;
 
+	flush_tool_axes(tool);
 	zwp_tablet_tool_v2_send_frame(tool->resource, get_current_time_msec());
 	tool->frame_source = NULL;
 }
@@ -384,8 +416,11 @@ void wlr_send_tablet_v2_tablet_tool_motion(
 		return;
 	}
 
-	zwp_tablet_tool_v2_send_motion(tool->current_client->resource,
-		wl_fixed_from_double(x), wl_fixed_from_double(y));
+	// Axis updates are merged until the frame is sent, so that each axis is
+	// sent at most once per frame
+	tool->current_client->x = x;
+	tool->current_client->y = y;
+	tool->current_client->pending_axes |= TABLET_TOOL_AXIS_MOTION;
 
 	queue_tool_frame(tool->current_client);
 }
@@ -393,6 +428,7 @@ void wlr_send_tablet_v2_tablet_tool_motion(
 void wlr_send_tablet_v2_tablet_tool_proximity_out(
 		struct wlr_tablet_v2_tablet_tool *tool) {
 	if (tool->current_client) {
+		flush_tool_axes(tool->current_client);
 		for (size_t i = 0; i < tool->num_buttons; ++i) {
 			zwp_tablet_tool_v2_send_button(tool->current_client->resource,
 				tool->pressed_serials[i],
@@ -419,8 +455,8 @@ void wlr_send_tablet_v2_tablet_tool_proximity_out(
 void wlr_send_tablet_v2_tablet_tool_pressure(
 		struct wlr_tablet_v2_tablet_tool *tool, double pressure) {
 	if (tool->current_client) {
-		zwp_tablet_tool_v2_send_pressure(tool->current_client->resource,
-			pressure * 65535);
+		tool->current_client->pressure = pressure;
+		tool->current_client->pending_axes |= TABLET_TOOL_AXIS_PRESSURE;
 
 		queue_tool_frame(tool->current_client);
 	}
@@ -429,8 +465,8 @@ void wlr_send_tablet_v2_tablet_tool_pressure(
 void wlr_send_tablet_v2_tablet_tool_distance(
 		struct wlr_tablet_v2_tablet_tool *tool, double distance) {
 	if (tool->current_client) {
-		zwp_tablet_tool_v2_send_distance(tool->current_client->resource,
-			distance * 65535);
+		tool->current_client->distance = distance;
+		tool->current_client->pending_axes |= TABLET_TOOL_AXIS_DISTANCE;
 
 		queue_tool_frame(tool->current_client);
 	}
@@ -442,8 +478,9 @@ void wlr_send_tablet_v2_tablet_tool_tilt(
 		return;
 	}
 
-	zwp_tablet_tool_v2_send_tilt(tool->current_client->resource,
-		wl_fixed_from_double(x), wl_fixed_from_double(y));
+	tool->current_client->tilt_x = x;
+	tool->current_client->tilt_y = y;
+	tool->current_client->pending_axes |= TABLET_TOOL_AXIS_TILT;
 
 	queue_tool_frame(tool->current_client);
 }
@@ -454,8 +491,8 @@ void wlr_send_tablet_v2_tablet_tool_rotation(
 		return;
 	}
 
-	zwp_tablet_tool_v2_send_rotation(tool->current_client->resource,
-		wl_fixed_from_double(degrees));
+	tool->current_client->rotation = degrees;
+	tool->current_client->pending_axes |= TABLET_TOOL_AXIS_ROTATION;
 
 	queue_tool_frame(tool->current_client);
 }
@@ -466,8 +503,8 @@ void wlr_send_tablet_v2_tablet_tool_slider(
 		return;
 	}
 
-	zwp_tablet_tool_v2_send_slider(tool->current_client->resource,
-		position * 65535);
+	tool->current_client->slider = position;
+	tool->current_client->pending_axes |= TABLET_TOOL_AXIS_SLIDER;
 
 	queue_tool_frame(tool->current_client);
 }
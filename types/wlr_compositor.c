@@ -1,4 +1,6 @@
 #include <assert.h>
+#include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <wayland-server-core.h>
@@ -10,11 +12,13 @@
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
 #include <wlr/util/transform.h>
+#include "render/wlr_renderer.h"
 #include "types/wlr_buffer.h"
 #include "types/wlr_region.h"
 #include "types/wlr_subcompositor.h"
 #include "util/array.h"
 #include "util/time.h"
+#include "util/trace.h"
 
 #define COMPOSITOR_VERSION 6
 #define CALLBACK_VERSION 1
@@ -295,15 +299,70 @@ static void *surface_synced_create_state(struct wlr_surface_synced *synced) {
 	return state;
 }
 
+static bool surface_state_block_contains(const struct wlr_surface_state *state,
+		const void *synced_state) {
+	const char *block = state->synced_block;
+	const char *ptr = synced_state;
+	return block != NULL && ptr >= block && ptr < block + state->synced_block_size;
+}
+
+// Frees a sync'ed object state, unless it lives in the state's block
+static void surface_state_free_synced(const struct wlr_surface_state *state,
+		void *synced_state) {
+	if (!surface_state_block_contains(state, synced_state)) {
+		free(synced_state);
+	}
+}
+
 static void surface_synced_destroy_state(struct wlr_surface_synced *synced,
-		void *state) {
+		const struct wlr_surface_state *owner, void *state) {
 	if (state == NULL) {
 		return;
 	}
 	if (synced->impl->finish_state) {
 		synced->impl->finish_state(state);
 	}
-	free(state);
+	surface_state_free_synced(owner, state);
+}
+
+static size_t synced_state_aligned_size(const struct wlr_surface_synced *synced) {
+	size_t align = _Alignof(max_align_t);
+	return (synced->impl->state_size + align - 1) / align * align;
+}
+
+/**
+ * Allocate all sync'ed object states of a cached state in a single block,
+ * instead of once per sync'ed object.
+ */
+static bool surface_state_create_synced_block(struct wlr_surface_state *state,
+		struct wlr_surface *surface) {
+	size_t size = 0;
+	struct wlr_surface_synced *synced;
+	wl_list_for_each(synced, &surface->synced, link) {
+		size += synced_state_aligned_size(synced);
+	}
+	if (size == 0) {
+		return true;
+	}
+
+	char *block = calloc(1, size);
+	if (block == NULL) {
+		return false;
+	}
+	state->synced_block = block;
+	state->synced_block_size = size;
+
+	void **synced_states = state->synced.data;
+	size_t offset = 0;
+	wl_list_for_each(synced, &surface->synced, link) {
+		void *synced_state = block + offset;
+		if (synced->impl->init_state) {
+			synced->impl->init_state(synced_state);
+		}
+		synced_states[synced->index] = synced_state;
+		offset += synced_state_aligned_size(synced);
+	}
+	return true;
 }
 
 static void surface_synced_move_state(struct wlr_surface_synced *synced,
@@ -404,6 +463,41 @@ static void surface_state_move(struct wlr_surface_state *state,
 	next->cached_state_locks = 0;
 }
 
+// Cropping is only worth it when most of the buffer is outside the source box
+#define UPLOAD_CROP_MAX_RATIO 0.5
+
+/**
+ * Get the part of the buffer to upload, empty for all of it. Surfaces cropped
+ * with a viewport only need their source box, plus a pixel on each side for
+ * linear filtering.
+ */
+static void surface_get_upload_crop(struct wlr_surface *surface,
+		struct wlr_buffer *buffer, struct wlr_box *crop) {
+	*crop = (struct wlr_box){0};
+	if (!surface->current.viewport.has_src) {
+		return;
+	}
+
+	struct wlr_fbox src;
+	wlr_surface_get_buffer_source_box(surface, &src);
+
+	int x1 = fmax(floor(src.x) - 1, 0);
+	int y1 = fmax(floor(src.y) - 1, 0);
+	int x2 = fmin(ceil(src.x + src.width) + 1, buffer->width);
+	int y2 = fmin(ceil(src.y + src.height) + 1, buffer->height);
+	if (x2 <= x1 || y2 <= y1 || (double)(x2 - x1) * (y2 - y1) >
+			UPLOAD_CROP_MAX_RATIO * buffer->width * buffer->height) {
+		return;
+	}
+
+	*crop = (struct wlr_box){
+		.x = x1,
+		.y = y1,
+		.width = x2 - x1,
+		.height = y2 - y1,
+	};
+}
+
 static void surface_apply_damage(struct wlr_surface *surface) {
 	if (surface->current.buffer == NULL) {
 		// NULL commit
@@ -417,7 +511,11 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 
 	surface->opaque = buffer_is_opaque(surface->current.buffer);
 
-	if (surface->buffer != NULL) {
+	// A cropped texture can't be reused if the source box moved outside of it
+	struct wlr_fbox src;
+	wlr_surface_get_buffer_source_box(surface, &src);
+	if (surface->buffer != NULL && (surface->buffer->texture == NULL ||
+			texture_contains_box(surface->buffer->texture, &src))) {
 		if (wlr_client_buffer_apply_damage(surface->buffer,
 				surface->current.buffer, &surface->buffer_damage)) {
 			wlr_buffer_unlock(surface->current.buffer);
@@ -430,8 +528,10 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 		return;
 	}
 
-	struct wlr_client_buffer *buffer = wlr_client_buffer_create(
-			surface->current.buffer, surface->compositor->renderer);
+	struct wlr_box crop;
+	surface_get_upload_crop(surface, surface->current.buffer, &crop);
+	struct wlr_client_buffer *buffer = client_buffer_create_cropped(
+		surface->current.buffer, surface->compositor->renderer, &crop);
 
 	if (buffer == NULL) {
 		wlr_log(WLR_ERROR, "Failed to upload buffer");
@@ -444,6 +544,39 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 	surface->buffer = buffer;
 }
 
+/**
+ * Upload another part of the buffer if the viewport source box moved outside
+ * of the cropped texture without a new buffer.
+ */
+static void surface_update_buffer_crop(struct wlr_surface *surface) {
+	struct wlr_client_buffer *client_buffer = surface->buffer;
+	if (client_buffer == NULL || client_buffer->texture == NULL) {
+		return;
+	}
+
+	struct wlr_fbox src;
+	wlr_surface_get_buffer_source_box(surface, &src);
+	if (texture_contains_box(client_buffer->texture, &src)) {
+		return;
+	}
+
+	// Cropped client buffers keep their source locked
+	struct wlr_buffer *source = client_buffer->source;
+	assert(source != NULL);
+
+	struct wlr_box crop;
+	surface_get_upload_crop(surface, source, &crop);
+	struct wlr_client_buffer *buffer = client_buffer_create_cropped(source,
+		surface->compositor->renderer, &crop);
+	if (buffer == NULL) {
+		wlr_log(WLR_ERROR, "Failed to upload buffer");
+		return;
+	}
+
+	wlr_buffer_unlock(&client_buffer->base);
+	surface->buffer = buffer;
+}
+
 static void surface_update_opaque_region(struct wlr_surface *surface) {
 	if (!wlr_surface_has_buffer(surface)) {
 		pixman_region32_clear(&surface->opaque_region);
@@ -470,10 +603,49 @@ static void surface_update_input_region(struct wlr_surface *surface) {
 
 static bool surface_state_init(struct wlr_surface_state *state,
 	struct wlr_surface *surface);
+static void surface_state_init_fields(struct wlr_surface_state *state);
 static void surface_state_finish(struct wlr_surface_state *state);
 
+// Takes a cached state from the pool, its synced states are freshly initialized
+static struct wlr_surface_state *surface_get_pooled_cached(
+		struct wlr_surface *surface) {
+	if (wl_list_empty(&surface->cached_pool)) {
+		return NULL;
+	}
+
+	struct wlr_surface_state *cached =
+		wl_container_of(surface->cached_pool.next, cached, cached_state_link);
+	wl_list_remove(&cached->cached_state_link);
+	surface->cached_pool_len--;
+
+	struct wl_array synced_states = cached->synced;
+	void *synced_block = cached->synced_block;
+	size_t synced_block_size = cached->synced_block_size;
+	surface_state_init_fields(cached);
+	cached->synced = synced_states;
+	cached->synced_block = synced_block;
+	cached->synced_block_size = synced_block_size;
+
+	void **cached_synced = cached->synced.data;
+	struct wlr_surface_synced *synced;
+	wl_list_for_each(synced, &surface->synced, link) {
+		void *synced_state = cached_synced[synced->index];
+		memset(synced_state, 0, synced->impl->state_size);
+		if (synced->impl->init_state) {
+			synced->impl->init_state(synced_state);
+		}
+	}
+
+	return cached;
+}
+
 static void surface_cache_pending(struct wlr_surface *surface) {
-	struct wlr_surface_state *cached = calloc(1, sizeof(*cached));
+	struct wlr_surface_state *cached = surface_get_pooled_cached(surface);
+	if (cached != NULL) {
+		goto move;
+	}
+
+	cached = calloc(1, sizeof(*cached));
 	if (!cached) {
 		goto error;
 	}
@@ -482,16 +654,11 @@ static void surface_cache_pending(struct wlr_surface *surface) {
 		goto error_cached;
 	}
 
-	void **cached_synced = cached->synced.data;
-	struct wlr_surface_synced *synced;
-	wl_list_for_each(synced, &surface->synced, link) {
-		void *synced_state = surface_synced_create_state(synced);
-		if (synced_state == NULL) {
-			goto error_state;
-		}
-		cached_synced[synced->index] = synced_state;
+	if (!surface_state_create_synced_block(cached, surface)) {
+		goto error_state;
 	}
 
+move:
 	surface_state_move(cached, &surface->pending, surface);
 
 	wl_list_insert(surface->cached.prev, &cached->cached_state_link);
@@ -512,6 +679,8 @@ static void surface_commit_state(struct wlr_surface *surface,
 		struct wlr_surface_state *next) {
 	assert(next->cached_state_locks == 0);
 
+	trace_begin("surface_commit");
+
 	bool invalid_buffer = next->committed & WLR_SURFACE_STATE_BUFFER;
 
 	if (invalid_buffer && next->buffer == NULL) {
@@ -522,6 +691,7 @@ static void surface_commit_state(struct wlr_surface *surface,
 	}
 
 	surface_update_damage(&surface->buffer_damage, &surface->current, next);
+	surface->effective_damage_valid = false;
 
 	surface->previous.scale = surface->current.scale;
 	surface->previous.transform = surface->current.transform;
@@ -534,6 +704,9 @@ static void surface_commit_state(struct wlr_surface *surface,
 
 	if (invalid_buffer) {
 		surface_apply_damage(surface);
+	} else if (surface->current.committed & (WLR_SURFACE_STATE_VIEWPORT |
+			WLR_SURFACE_STATE_SCALE | WLR_SURFACE_STATE_TRANSFORM)) {
+		surface_update_buffer_crop(surface);
 	}
 	surface_update_opaque_region(surface);
 	surface_update_input_region(surface);
@@ -564,11 +737,17 @@ static void surface_commit_state(struct wlr_surface *surface,
 	// released immediately on commit when they are uploaded to the GPU.
 	wlr_buffer_unlock(surface->current.buffer);
 	surface->current.buffer = NULL;
+
+	trace_end();
 }
 
+static void compositor_client_account_commit(struct wlr_compositor *compositor,
+	struct wl_client *client, struct wlr_surface *surface);
+
 static void surface_handle_commit(struct wl_client *client,
 		struct wl_resource *resource) {
 	struct wlr_surface *surface = wlr_surface_from_resource(resource);
+	compositor_client_account_commit(surface->compositor, client, surface);
 	surface->handling_commit = true;
 
 	surface_finalize_pending(surface);
@@ -660,8 +839,7 @@ struct wlr_surface *wlr_surface_from_resource(struct wl_resource *resource) {
 	return wl_resource_get_user_data(resource);
 }
 
-static bool surface_state_init(struct wlr_surface_state *state,
-		struct wlr_surface *surface) {
+static void surface_state_init_fields(struct wlr_surface_state *state) {
 	*state = (struct wlr_surface_state){
 		.scale = 1,
 		.transform = WL_OUTPUT_TRANSFORM_NORMAL,
@@ -679,6 +857,11 @@ static bool surface_state_init(struct wlr_surface_state *state,
 		INT32_MIN, INT32_MIN, UINT32_MAX, UINT32_MAX);
 
 	wl_array_init(&state->synced);
+}
+
+static bool surface_state_init(struct wlr_surface_state *state,
+		struct wlr_surface *surface) {
+	surface_state_init_fields(state);
 	void *ptr = wl_array_add(&state->synced, surface->synced_len * sizeof(void *));
 	return ptr != NULL;
 }
@@ -704,14 +887,66 @@ static void surface_state_destroy_cached(struct wlr_surface_state *state,
 	void **synced_states = state->synced.data;
 	struct wlr_surface_synced *synced;
 	wl_list_for_each(synced, &surface->synced, link) {
-		surface_synced_destroy_state(synced, synced_states[synced->index]);
+		surface_synced_destroy_state(synced, state, synced_states[synced->index]);
 	}
 
 	surface_state_finish(state);
 	wl_list_remove(&state->cached_state_link);
+	free(state->synced_block);
 	free(state);
 }
 
+// Maximum number of applied cached states kept for re-use
+#define SURFACE_CACHED_POOL_MAX 2
+
+/**
+ * Destroy an applied cached state, keeping its allocations around if the pool
+ * isn't full. wlr_surface_lock_pending() users lock every commit, this avoids
+ * allocating the state and all of its synced states each time.
+ */
+static void surface_state_recycle_cached(struct wlr_surface_state *state,
+		struct wlr_surface *surface) {
+	if (surface->cached_pool_len >= SURFACE_CACHED_POOL_MAX) {
+		surface_state_destroy_cached(state, surface);
+		return;
+	}
+
+	void **synced_states = state->synced.data;
+	struct wlr_surface_synced *synced;
+	wl_list_for_each(synced, &surface->synced, link) {
+		if (synced->impl->finish_state) {
+			synced->impl->finish_state(synced_states[synced->index]);
+		}
+	}
+
+	struct wl_array synced_array = state->synced;
+	wl_array_init(&state->synced);
+	surface_state_finish(state);
+	state->synced = synced_array;
+
+	wl_list_remove(&state->cached_state_link);
+	wl_list_insert(&surface->cached_pool, &state->cached_state_link);
+	surface->cached_pool_len++;
+}
+
+// Must be called before the list of synced states changes
+static void surface_clear_cached_pool(struct wlr_surface *surface) {
+	struct wlr_surface_state *state, *tmp;
+	wl_list_for_each_safe(state, tmp, &surface->cached_pool, cached_state_link) {
+		// Synced states have already been finished
+		void **synced_states = state->synced.data;
+		size_t synced_len = state->synced.size / sizeof(void *);
+		for (size_t i = 0; i < synced_len; i++) {
+			surface_state_free_synced(state, synced_states[i]);
+		}
+		wl_array_release(&state->synced);
+		free(state->synced_block);
+		wl_list_remove(&state->cached_state_link);
+		free(state);
+	}
+	surface->cached_pool_len = 0;
+}
+
 static void surface_output_destroy(struct wlr_surface_output *surface_output);
 static void surface_destroy_role_object(struct wlr_surface *surface);
 
@@ -735,14 +970,17 @@ static void surface_handle_resource_destroy(struct wl_resource *resource) {
 	wl_list_for_each_safe(cached, cached_tmp, &surface->cached, cached_state_link) {
 		surface_state_destroy_cached(cached, surface);
 	}
+	surface_clear_cached_pool(surface);
 
 	wl_list_remove(&surface->role_resource_destroy.link);
 
 	wl_list_remove(&surface->pending_buffer_resource_destroy.link);
+	wl_list_remove(&surface->deferred_link);
 
 	surface_state_finish(&surface->pending);
 	surface_state_finish(&surface->current);
 	pixman_region32_fini(&surface->buffer_damage);
+	pixman_region32_fini(&surface->effective_damage);
 	pixman_region32_fini(&surface->opaque_region);
 	pixman_region32_fini(&surface->input_region);
 	if (surface->buffer != NULL) {
@@ -784,7 +1022,9 @@ static struct wlr_surface *surface_create(struct wl_client *client,
 	wl_signal_init(&surface->events.new_subsurface);
 	wl_list_init(&surface->current_outputs);
 	wl_list_init(&surface->cached);
+	wl_list_init(&surface->cached_pool);
 	pixman_region32_init(&surface->buffer_damage);
+	pixman_region32_init(&surface->effective_damage);
 	pixman_region32_init(&surface->opaque_region);
 	pixman_region32_init(&surface->input_region);
 	wlr_addon_set_init(&surface->addons);
@@ -795,6 +1035,8 @@ static struct wlr_surface *surface_create(struct wl_client *client,
 	surface->pending_buffer_resource_destroy.notify = pending_buffer_resource_handle_destroy;
 	wl_list_init(&surface->pending_buffer_resource_destroy.link);
 
+	wl_list_init(&surface->deferred_link);
+
 	return surface;
 }
 
@@ -802,7 +1044,7 @@ struct wlr_texture *wlr_surface_get_texture(struct wlr_surface *surface) {
 	if (surface->buffer == NULL) {
 		return NULL;
 	}
-	return surface->buffer->texture;
+	return client_buffer_get_texture(surface->buffer);
 }
 
 bool wlr_surface_has_buffer(struct wlr_surface *surface) {
@@ -971,7 +1213,7 @@ void wlr_surface_unlock_cached(struct wlr_surface *surface, uint32_t seq) {
 		}
 
 		surface_commit_state(surface, next);
-		surface_state_destroy_cached(next, surface);
+		surface_state_recycle_cached(next, surface);
 	}
 }
 
@@ -1203,7 +1445,7 @@ static void crop_region(pixman_region32_t *dst, pixman_region32_t *src,
 	pixman_region32_translate(dst, -box->x, -box->y);
 }
 
-void wlr_surface_get_effective_damage(struct wlr_surface *surface,
+static void surface_compute_effective_damage(struct wlr_surface *surface,
 		pixman_region32_t *damage) {
 	pixman_region32_clear(damage);
 
@@ -1232,6 +1474,15 @@ void wlr_surface_get_effective_damage(struct wlr_surface *surface,
 	}
 }
 
+void wlr_surface_get_effective_damage(struct wlr_surface *surface,
+		pixman_region32_t *damage) {
+	if (!surface->effective_damage_valid) {
+		surface_compute_effective_damage(surface, &surface->effective_damage);
+		surface->effective_damage_valid = true;
+	}
+	pixman_region32_copy(damage, &surface->effective_damage);
+}
+
 void wlr_surface_get_buffer_source_box(struct wlr_surface *surface,
 		struct wlr_fbox *box) {
 	box->x = box->y = 0;
@@ -1319,10 +1570,135 @@ static const struct wl_compositor_interface compositor_impl = {
 	.create_region = compositor_create_region,
 };
 
+struct compositor_client {
+	struct wlr_compositor *compositor;
+	struct wl_list link; // wlr_compositor.clients
+	struct wlr_compositor_client_stats stats;
+	uint32_t budget_commits; // commits in the current iteration
+
+	struct wl_listener client_destroy;
+};
+
+static void compositor_client_destroy(struct compositor_client *client) {
+	wl_list_remove(&client->client_destroy.link);
+	wl_list_remove(&client->link);
+	free(client);
+}
+
+static void compositor_client_handle_destroy(struct wl_listener *listener,
+		void *data) {
+	struct compositor_client *client =
+		wl_container_of(listener, client, client_destroy);
+	compositor_client_destroy(client);
+}
+
+static struct compositor_client *compositor_client_get(
+		struct wlr_compositor *compositor, struct wl_client *wl_client) {
+	struct wl_listener *listener = wl_client_get_destroy_listener(wl_client,
+		compositor_client_handle_destroy);
+	if (listener == NULL) {
+		return NULL;
+	}
+	struct compositor_client *client =
+		wl_container_of(listener, client, client_destroy);
+	return client->compositor == compositor ? client : NULL;
+}
+
+static void compositor_handle_budget_idle(void *data) {
+	struct wlr_compositor *compositor = data;
+	compositor->budget_idle = NULL;
+
+	struct compositor_client *client;
+	wl_list_for_each(client, &compositor->clients, link) {
+		client->budget_commits = 0;
+	}
+
+	struct wlr_surface *surface, *tmp;
+	wl_list_for_each_safe(surface, tmp, &compositor->deferred_surfaces, deferred_link) {
+		wl_list_remove(&surface->deferred_link);
+		wl_list_init(&surface->deferred_link);
+		wlr_surface_unlock_cached(surface, surface->deferred_seq);
+	}
+}
+
+static void compositor_client_account_commit(struct wlr_compositor *compositor,
+		struct wl_client *wl_client, struct wlr_surface *surface) {
+	struct compositor_client *client = compositor_client_get(compositor, wl_client);
+	if (client == NULL) {
+		return;
+	}
+
+	client->stats.commits++;
+	if (compositor->client_commit_budget == 0) {
+		return;
+	}
+
+	if (compositor->budget_idle == NULL) {
+		compositor->budget_idle = wl_event_loop_add_idle(compositor->event_loop,
+			compositor_handle_budget_idle, compositor);
+		if (compositor->budget_idle == NULL) {
+			return;
+		}
+	}
+
+	client->budget_commits++;
+	if (client->budget_commits <= compositor->client_commit_budget) {
+		return;
+	}
+
+	client->stats.deferred_commits++;
+	// Following commits are queued behind this lock
+	if (wl_list_empty(&surface->deferred_link)) {
+		surface->deferred_seq = wlr_surface_lock_pending(surface);
+		wl_list_insert(&compositor->deferred_surfaces, &surface->deferred_link);
+	}
+}
+
+static void compositor_handle_protocol_log(void *data,
+		enum wl_protocol_logger_type type,
+		const struct wl_protocol_logger_message *message) {
+	struct wlr_compositor *compositor = data;
+	if (type != WL_PROTOCOL_LOGGER_REQUEST) {
+		return;
+	}
+	struct compositor_client *client = compositor_client_get(compositor,
+		wl_resource_get_client(message->resource));
+	if (client != NULL) {
+		client->stats.requests++;
+	}
+}
+
+void wlr_compositor_set_client_commit_budget(struct wlr_compositor *compositor,
+		uint32_t max_commits) {
+	compositor->client_commit_budget = max_commits;
+}
+
+bool wlr_compositor_get_client_stats(struct wlr_compositor *compositor,
+		struct wl_client *wl_client, struct wlr_compositor_client_stats *stats) {
+	struct compositor_client *client = compositor_client_get(compositor, wl_client);
+	if (client == NULL) {
+		return false;
+	}
+	*stats = client->stats;
+	return true;
+}
+
 static void compositor_bind(struct wl_client *wl_client, void *data,
 		uint32_t version, uint32_t id) {
 	struct wlr_compositor *compositor = data;
 
+	if (compositor_client_get(compositor, wl_client) == NULL) {
+		struct compositor_client *client = calloc(1, sizeof(*client));
+		if (client == NULL) {
+			wl_client_post_no_memory(wl_client);
+			return;
+		}
+		client->compositor = compositor;
+		client->client_destroy.notify = compositor_client_handle_destroy;
+		wl_client_add_destroy_listener(wl_client, &client->client_destroy);
+		wl_list_insert(&compositor->clients, &client->link);
+	}
+
 	struct wl_resource *resource =
 		wl_resource_create(wl_client, &wl_compositor_interface, version, id);
 	if (resource == NULL) {
@@ -1339,6 +1715,24 @@ static void compositor_handle_display_destroy(
 	wl_signal_emit_mutable(&compositor->events.destroy, NULL);
 	wl_list_remove(&compositor->display_destroy.link);
 	wl_list_remove(&compositor->renderer_destroy.link);
+
+	struct compositor_client *client, *client_tmp;
+	wl_list_for_each_safe(client, client_tmp, &compositor->clients, link) {
+		compositor_client_destroy(client);
+	}
+	struct wlr_surface *surface, *surface_tmp;
+	wl_list_for_each_safe(surface, surface_tmp, &compositor->deferred_surfaces,
+			deferred_link) {
+		wl_list_remove(&surface->deferred_link);
+		wl_list_init(&surface->deferred_link);
+	}
+	if (compositor->budget_idle != NULL) {
+		wl_event_source_remove(compositor->budget_idle);
+	}
+	if (compositor->protocol_logger != NULL) {
+		wl_protocol_logger_destroy(compositor->protocol_logger);
+	}
+
 	wl_global_destroy(compositor->global);
 	free(compositor);
 }
@@ -1350,6 +1744,34 @@ static void compositor_handle_renderer_destroy(
 	wlr_compositor_set_renderer(compositor, NULL);
 }
 
+struct client_memory_usage_data {
+	struct wlr_compositor *compositor;
+	size_t usage;
+};
+
+static enum wl_iterator_result client_memory_usage_iterator(
+		struct wl_resource *resource, void *user_data) {
+	struct client_memory_usage_data *data = user_data;
+	if (!wl_resource_instance_of(resource, &wl_surface_interface,
+			&surface_implementation)) {
+		return WL_ITERATOR_CONTINUE;
+	}
+
+	struct wlr_surface *surface = wlr_surface_from_resource(resource);
+	if (surface->compositor == data->compositor && surface->buffer != NULL &&
+			surface->buffer->texture != NULL) {
+		data->usage += wlr_texture_get_memory_usage(surface->buffer->texture);
+	}
+	return WL_ITERATOR_CONTINUE;
+}
+
+size_t wlr_compositor_get_client_memory_usage(struct wlr_compositor *compositor,
+		struct wl_client *client) {
+	struct client_memory_usage_data data = { .compositor = compositor };
+	wl_client_for_each_resource(client, client_memory_usage_iterator, &data);
+	return data.usage;
+}
+
 struct wlr_compositor *wlr_compositor_create(struct wl_display *display,
 		uint32_t version, struct wlr_renderer *renderer) {
 	assert(version <= COMPOSITOR_VERSION);
@@ -1369,6 +1791,12 @@ struct wlr_compositor *wlr_compositor_create(struct wl_display *display,
 	wl_signal_init(&compositor->events.new_surface);
 	wl_signal_init(&compositor->events.destroy);
 	wl_list_init(&compositor->renderer_destroy.link);
+	wl_list_init(&compositor->clients);
+	wl_list_init(&compositor->deferred_surfaces);
+
+	compositor->event_loop = wl_display_get_event_loop(display);
+	compositor->protocol_logger = wl_display_add_protocol_logger(display,
+		compositor_handle_protocol_log, compositor);
 
 	compositor->display_destroy.notify = compositor_handle_display_destroy;
 	wl_display_add_destroy_listener(display, &compositor->display_destroy);
@@ -1411,7 +1839,7 @@ static void *surface_state_remove_synced(struct wlr_surface_state *state,
 static void surface_state_remove_and_destroy_synced(struct wlr_surface_state *state,
 		struct wlr_surface_synced *synced) {
 	void *synced_state = surface_state_remove_synced(state, synced);
-	surface_synced_destroy_state(synced, synced_state);
+	surface_synced_destroy_state(synced, state, synced_state);
 }
 
 bool wlr_surface_synced_init(struct wlr_surface_synced *synced,
@@ -1424,6 +1852,8 @@ bool wlr_surface_synced_init(struct wlr_surface_synced *synced,
 		assert(synced != other);
 	}
 
+	surface_clear_cached_pool(surface);
+
 	memset(pending, 0, impl->state_size);
 	memset(current, 0, impl->state_size);
 	if (impl->init_state) {
@@ -1448,7 +1878,7 @@ bool wlr_surface_synced_init(struct wlr_surface_synced *synced,
 		void *synced_state = surface_synced_create_state(synced);
 		if (synced_state == NULL ||
 				!surface_state_add_synced(cached, synced_state)) {
-			surface_synced_destroy_state(synced, synced_state);
+			surface_synced_destroy_state(synced, cached, synced_state);
 			goto error_cached;
 		}
 	}
@@ -1491,6 +1921,8 @@ void wlr_surface_synced_finish(struct wlr_surface_synced *synced) {
 	}
 	assert(found);
 
+	surface_clear_cached_pool(surface);
+
 	struct wlr_surface_state *cached;
 	wl_list_for_each(cached, &surface->cached, cached_state_link) {
 		surface_state_remove_and_destroy_synced(cached, synced);
@@ -1,10 +1,11 @@
 #include <assert.h>
-#include <drm_fourcc.h>
 #include <limits.h>
 #include <math.h>
 #include <stdlib.h>
+#include <time.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_cursor.h>
+#include <wlr/types/wlr_data_device.h>
 #include <wlr/types/wlr_fractional_scale_v1.h>
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_linux_drm_syncobj_v1.h>
@@ -17,8 +18,15 @@
 #include <wlr/types/wlr_xcursor_manager.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
-#include "types/wlr_buffer.h"
 #include "types/wlr_output.h"
+#include "types/wlr_xcursor_manager.h"
+#include "util/time.h"
+
+// Touch motion is extrapolated at most by this duration, and at most by half
+// the interval between the last two samples
+#define TOUCH_RESAMPLE_MAX_PREDICTION_MSEC 8
+// Samples closer together than this don't give a reliable velocity
+#define TOUCH_RESAMPLE_MIN_DELTA_MSEC 2
 
 struct wlr_cursor_device {
 	struct wlr_cursor *cursor;
@@ -65,12 +73,35 @@ struct wlr_cursor_output_cursor {
 	// only when using a surface as the cursor image
 	struct wl_listener output_commit;
 
+	// only useful when coalescing pointer motion or resampling touch motion
+	struct wl_listener output_frame;
+
+	// only useful when resampling touch motion
+	struct wl_listener output_present;
+	int64_t last_present_nsec; // zero if unknown
+	int refresh_nsec; // zero if unknown
+
 	// only when using an XCursor as the cursor image
 	struct wlr_xcursor *xcursor;
 	size_t xcursor_index;
 	struct wl_event_source *xcursor_timer;
 };
 
+struct cursor_touch_sample {
+	uint32_t time_msec;
+	double x, y;
+};
+
+struct cursor_touch_point {
+	struct wlr_touch *touch;
+	int32_t touch_id;
+	// last raw samples, oldest first
+	struct cursor_touch_sample samples[2];
+	size_t samples_len;
+	// whether a motion needs to be emitted on the next output frame
+	bool motion_pending;
+};
+
 struct wlr_cursor_state {
 	struct wlr_cursor cursor;
 
@@ -102,6 +133,26 @@ struct wlr_cursor_state {
 	// only when using an XCursor as the cursor image
 	struct wlr_xcursor_manager *xcursor_manager;
 	char *xcursor_name;
+
+	// drawn along with the cursor image, independently of it
+	struct wlr_drag_icon *drag_icon;
+	struct {
+		int32_t x, y;
+	} drag_icon_offset; // accumulated surface offset
+	struct wl_listener drag_icon_surface_commit;
+	struct wl_listener drag_icon_destroy;
+
+	bool coalesce_motion;
+	// accumulated relative motion, emitted on the next output frame
+	bool motion_pending;
+	bool motion_frame_pending;
+	struct wlr_pointer_motion_event pending_motion;
+
+	bool resample_touch;
+	struct wl_array touch_points; // struct cursor_touch_point
+	// resampled touch motion is emitted on the next output frame
+	bool touch_motion_pending;
+	bool touch_frame_pending;
 };
 
 struct wlr_cursor *wlr_cursor_create(void) {
@@ -116,6 +167,7 @@ struct wlr_cursor *wlr_cursor_create(void) {
 
 	wl_list_init(&cur->state->devices);
 	wl_list_init(&cur->state->output_cursors);
+	wl_array_init(&cur->state->touch_points);
 
 	// pointer signals
 	wl_signal_init(&cur->events.motion);
@@ -147,6 +199,8 @@ struct wlr_cursor *wlr_cursor_create(void) {
 
 	wl_list_init(&cur->state->surface_destroy.link);
 	wl_list_init(&cur->state->surface_commit.link);
+	wl_list_init(&cur->state->drag_icon_surface_commit.link);
+	wl_list_init(&cur->state->drag_icon_destroy.link);
 
 	cur->x = 100;
 	cur->y = 100;
@@ -161,6 +215,8 @@ static void output_cursor_destroy(struct wlr_cursor_output_cursor *output_cursor
 	wl_list_remove(&output_cursor->layout_output_destroy.link);
 	wl_list_remove(&output_cursor->link);
 	wl_list_remove(&output_cursor->output_commit.link);
+	wl_list_remove(&output_cursor->output_frame.link);
+	wl_list_remove(&output_cursor->output_present.link);
 	wlr_output_cursor_destroy(output_cursor->output_cursor);
 	free(output_cursor);
 }
@@ -183,7 +239,12 @@ static void cursor_detach_output_layout(struct wlr_cursor *cur) {
 	cur->state->layout = NULL;
 }
 
+static void cursor_remove_touch_points(struct wlr_cursor *cur,
+		struct wlr_touch *touch, int32_t touch_id, bool all_ids);
+
 static void cursor_device_destroy(struct wlr_cursor_device *c_device) {
+	wlr_cursor_flush_motion(c_device->cursor);
+
 	struct wlr_input_device *dev = c_device->device;
 	switch (dev->type) {
 	case WLR_INPUT_DEVICE_POINTER:
@@ -202,6 +263,8 @@ static void cursor_device_destroy(struct wlr_cursor_device *c_device) {
 		wl_list_remove(&c_device->hold_end.link);
 		break;
 	case WLR_INPUT_DEVICE_TOUCH:
+		cursor_remove_touch_points(c_device->cursor,
+			wlr_touch_from_input_device(dev), 0, true);
 		wl_list_remove(&c_device->touch_down.link);
 		wl_list_remove(&c_device->touch_up.link);
 		wl_list_remove(&c_device->touch_motion.link);
@@ -247,7 +310,12 @@ static void cursor_reset_image(struct wlr_cursor *cur) {
 }
 
 void wlr_cursor_destroy(struct wlr_cursor *cur) {
+	// Don't emit the pending motion while tearing down the devices
+	cur->state->motion_pending = false;
+	cur->state->touch_motion_pending = false;
+	cur->state->touch_frame_pending = false;
 	cursor_reset_image(cur);
+	wlr_cursor_set_drag_icon(cur, NULL);
 	cursor_detach_output_layout(cur);
 
 	struct wlr_cursor_device *device, *device_tmp = NULL;
@@ -255,6 +323,7 @@ void wlr_cursor_destroy(struct wlr_cursor *cur) {
 		cursor_device_destroy(device);
 	}
 
+	wl_array_release(&cur->state->touch_points);
 	free(cur->state);
 }
 
@@ -471,13 +540,15 @@ static int handle_xcursor_timer(void *data) {
 static void output_cursor_set_xcursor_image(struct wlr_cursor_output_cursor *output_cursor, size_t i) {
 	struct wlr_xcursor_image *image = output_cursor->xcursor->images[i];
 
-	struct wlr_readonly_data_buffer *ro_buffer = readonly_data_buffer_create(
-		DRM_FORMAT_ARGB8888, 4 * image->width, image->width, image->height, image->buffer);
-	if (ro_buffer == NULL) {
+	// The buffers of a manager are never modified, let the output keep the
+	// textures and rendered cursors around for the next animation cycle
+	struct wlr_buffer *buffer = xcursor_manager_get_image_buffer(
+		output_cursor->cursor->state->xcursor_manager, image);
+	if (buffer == NULL) {
 		return;
 	}
-	wlr_output_cursor_set_buffer(output_cursor->output_cursor, &ro_buffer->base, image->hotspot_x, image->hotspot_y);
-	wlr_buffer_drop(&ro_buffer->base);
+	output_cursor_set_cached_buffer(output_cursor->output_cursor, buffer,
+		image->hotspot_x, image->hotspot_y);
 
 	output_cursor->xcursor_index = i;
 
@@ -498,6 +569,58 @@ static void output_cursor_set_xcursor_image(struct wlr_cursor_output_cursor *out
 	wl_event_source_timer_update(output_cursor->xcursor_timer, image->delay);
 }
 
+/**
+ * Convert all frames of an animated xcursor into cursor plane buffers up-front,
+ * so that the animation only cycles through cached buffers.
+ */
+static void output_cursor_prepare_xcursor_images(
+		struct wlr_cursor_output_cursor *output_cursor) {
+	struct wlr_xcursor *xcursor = output_cursor->xcursor;
+	for (size_t i = 1; i < xcursor->image_count; i++) {
+		struct wlr_buffer *buffer = xcursor_manager_get_image_buffer(
+			output_cursor->cursor->state->xcursor_manager, xcursor->images[i]);
+		if (buffer == NULL) {
+			return;
+		}
+		output_cursor_prepare_cached_buffer(output_cursor->output_cursor, buffer);
+	}
+}
+
+static void cursor_output_cursor_update_drag_icon(
+		struct wlr_cursor_output_cursor *output_cursor) {
+	struct wlr_cursor_state *state = output_cursor->cursor->state;
+	struct wlr_output_cursor *cursor = output_cursor->output_cursor;
+	struct wlr_output *output = cursor->output;
+
+	struct wlr_surface *surface = NULL;
+	struct wlr_texture *texture = NULL;
+	if (state->drag_icon != NULL) {
+		surface = state->drag_icon->surface;
+		texture = wlr_surface_get_texture(surface);
+	}
+
+	if (texture == NULL) {
+		if (cursor->attachment.texture != NULL) {
+			output_cursor_set_attachment(cursor, NULL, NULL, 0, 0,
+				WL_OUTPUT_TRANSFORM_NORMAL, 0, 0);
+		}
+		return;
+	}
+
+	struct wlr_fbox src_box;
+	wlr_surface_get_buffer_source_box(surface, &src_box);
+	output_cursor_set_attachment(cursor, texture, &src_box,
+		surface->current.width, surface->current.height,
+		surface->current.transform,
+		state->drag_icon_offset.x, state->drag_icon_offset.y);
+
+	if (cursor->visible) {
+		wlr_surface_send_enter(surface, output);
+	} else {
+		wlr_surface_send_leave(surface, output);
+	}
+}
+
 static void cursor_output_cursor_update(struct wlr_cursor_output_cursor *output_cursor) {
 	struct wlr_cursor *cur = output_cursor->cursor;
 	struct wlr_output *output = output_cursor->output_cursor->output;
@@ -603,9 +726,12 @@ static void cursor_output_cursor_update(struct wlr_cursor_output_cursor *output_
 
 		output_cursor->xcursor = xcursor;
 		output_cursor_set_xcursor_image(output_cursor, 0);
+		output_cursor_prepare_xcursor_images(output_cursor);
 	} else {
 		wlr_output_cursor_set_buffer(output_cursor->output_cursor, NULL, 0, 0);
 	}
+
+	cursor_output_cursor_update_drag_icon(output_cursor);
 }
 
 static void output_cursor_output_handle_output_commit(
@@ -619,11 +745,74 @@ static void output_cursor_output_handle_output_commit(
 		cursor_output_cursor_update(output_cursor);
 	}
 
-	struct wlr_surface *surface = output_cursor->cursor->state->surface;
-	if (surface && output_cursor->output_cursor->visible &&
-			(event->state->committed & WLR_OUTPUT_STATE_BUFFER)) {
-		wlr_surface_send_frame_done(surface, event->when);
+	struct wlr_cursor_state *state = output_cursor->cursor->state;
+	if (!output_cursor->output_cursor->visible ||
+			!(event->state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		return;
+	}
+	if (state->surface != NULL) {
+		wlr_surface_send_frame_done(state->surface, event->when);
+	}
+	if (state->drag_icon != NULL) {
+		wlr_surface_send_frame_done(state->drag_icon->surface, event->when);
+	}
+}
+
+static void cursor_flush_pointer_motion(struct wlr_cursor *cur);
+static void cursor_flush_touch_motion(struct wlr_cursor *cur,
+	const uint32_t *time_msec);
+
+// Returns the time at which the next frame will be presented, if the output
+// reported its refresh cycle
+static bool output_cursor_predict_presentation(
+		struct wlr_cursor_output_cursor *output_cursor, uint32_t *time_msec) {
+	if (output_cursor->last_present_nsec == 0 ||
+			output_cursor->refresh_nsec <= 0) {
+		return false;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t now_nsec = timespec_to_nsec(&now);
+
+	int64_t refresh_nsec = output_cursor->refresh_nsec;
+	int64_t next_nsec = output_cursor->last_present_nsec + refresh_nsec;
+	if (next_nsec <= now_nsec) {
+		next_nsec += ((now_nsec - next_nsec) / refresh_nsec + 1) * refresh_nsec;
+	}
+
+	*time_msec = (uint32_t)(next_nsec / 1000000);
+	return true;
+}
+
+static void output_cursor_output_handle_output_frame(
+		struct wl_listener *listener, void *data) {
+	struct wlr_cursor_output_cursor *output_cursor =
+		wl_container_of(listener, output_cursor, output_frame);
+	struct wlr_cursor *cur = output_cursor->cursor;
+
+	cursor_flush_pointer_motion(cur);
+
+	if (cur->state->touch_motion_pending) {
+		uint32_t time_msec;
+		if (output_cursor_predict_presentation(output_cursor, &time_msec)) {
+			cursor_flush_touch_motion(cur, &time_msec);
+		} else {
+			cursor_flush_touch_motion(cur, NULL);
+		}
+	}
+}
+
+static void output_cursor_output_handle_output_present(
+		struct wl_listener *listener, void *data) {
+	struct wlr_cursor_output_cursor *output_cursor =
+		wl_container_of(listener, output_cursor, output_present);
+	const struct wlr_output_event_present *event = data;
+	if (!event->presented) {
+		return;
 	}
+	output_cursor->last_present_nsec = timespec_to_nsec(&event->when);
+	output_cursor->refresh_nsec = event->refresh;
 }
 
 static void cursor_update_outputs(struct wlr_cursor *cur) {
@@ -696,11 +885,301 @@ void wlr_cursor_set_surface(struct wlr_cursor *cur, struct wlr_surface *surface,
 	cursor_update_outputs(cur);
 }
 
+static void cursor_handle_drag_icon_surface_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_cursor_state *state =
+		wl_container_of(listener, state, drag_icon_surface_commit);
+	struct wlr_surface *surface = state->drag_icon->surface;
+
+	state->drag_icon_offset.x += surface->current.dx;
+	state->drag_icon_offset.y += surface->current.dy;
+
+	struct wlr_cursor_output_cursor *output_cursor;
+	wl_list_for_each(output_cursor, &state->output_cursors, link) {
+		if (output_cursor->output_cursor->output->enabled) {
+			cursor_output_cursor_update_drag_icon(output_cursor);
+		}
+	}
+}
+
+static void cursor_handle_drag_icon_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_cursor_state *state =
+		wl_container_of(listener, state, drag_icon_destroy);
+	wlr_cursor_set_drag_icon(&state->cursor, NULL);
+}
+
+void wlr_cursor_set_drag_icon(struct wlr_cursor *cur, struct wlr_drag_icon *icon) {
+	struct wlr_cursor_state *state = cur->state;
+	if (icon == state->drag_icon) {
+		return;
+	}
+
+	struct wlr_cursor_output_cursor *output_cursor;
+	if (state->drag_icon != NULL) {
+		wl_list_for_each(output_cursor, &state->output_cursors, link) {
+			wlr_surface_send_leave(state->drag_icon->surface,
+				output_cursor->output_cursor->output);
+		}
+	}
+
+	wl_list_remove(&state->drag_icon_surface_commit.link);
+	wl_list_remove(&state->drag_icon_destroy.link);
+	wl_list_init(&state->drag_icon_surface_commit.link);
+	wl_list_init(&state->drag_icon_destroy.link);
+
+	state->drag_icon = icon;
+	state->drag_icon_offset.x = 0;
+	state->drag_icon_offset.y = 0;
+	if (icon != NULL) {
+		state->drag_icon_surface_commit.notify = cursor_handle_drag_icon_surface_commit;
+		wl_signal_add(&icon->surface->events.commit, &state->drag_icon_surface_commit);
+		state->drag_icon_destroy.notify = cursor_handle_drag_icon_destroy;
+		wl_signal_add(&icon->events.destroy, &state->drag_icon_destroy);
+	}
+
+	wl_list_for_each(output_cursor, &state->output_cursors, link) {
+		if (output_cursor->output_cursor->output->enabled) {
+			cursor_output_cursor_update_drag_icon(output_cursor);
+		}
+	}
+}
+
+static void cursor_flush_pointer_motion(struct wlr_cursor *cur) {
+	struct wlr_cursor_state *state = cur->state;
+	if (!state->motion_pending) {
+		return;
+	}
+
+	struct wlr_pointer_motion_event event = state->pending_motion;
+	bool frame = state->motion_frame_pending;
+	state->motion_pending = false;
+	state->motion_frame_pending = false;
+
+	wl_signal_emit_mutable(&cur->events.motion, &event);
+	if (frame) {
+		wl_signal_emit_mutable(&cur->events.frame, cur);
+	}
+}
+
+static double clamp_unit(double v) {
+	return v < 0.0 ? 0.0 : (v > 1.0 ? 1.0 : v);
+}
+
+/**
+ * Estimate the position of a touch point at the given time, from the velocity
+ * between its last two samples. Times before the last sample are
+ * interpolated, times after it are extrapolated by a bounded amount.
+ */
+static void touch_point_resample(const struct cursor_touch_point *point,
+		uint32_t time_msec, struct cursor_touch_sample *out) {
+	const struct cursor_touch_sample *last = &point->samples[point->samples_len - 1];
+	*out = *last;
+	if (point->samples_len < 2) {
+		return;
+	}
+
+	const struct cursor_touch_sample *prev = &point->samples[0];
+	int32_t delta = (int32_t)(last->time_msec - prev->time_msec);
+	if (delta < TOUCH_RESAMPLE_MIN_DELTA_MSEC) {
+		return;
+	}
+
+	int32_t offset = (int32_t)(time_msec - last->time_msec);
+	int32_t max_offset = delta / 2;
+	if (max_offset > TOUCH_RESAMPLE_MAX_PREDICTION_MSEC) {
+		max_offset = TOUCH_RESAMPLE_MAX_PREDICTION_MSEC;
+	}
+	if (offset > max_offset) {
+		offset = max_offset;
+	} else if (offset < -delta) {
+		offset = -delta;
+	}
+
+	double alpha = (double)offset / delta;
+	out->time_msec = last->time_msec + offset;
+	out->x = clamp_unit(last->x + alpha * (last->x - prev->x));
+	out->y = clamp_unit(last->y + alpha * (last->y - prev->y));
+}
+
+/**
+ * Emit the pending touch motion. If time_msec is NULL, the last samples are
+ * emitted as is.
+ */
+static void cursor_flush_touch_motion(struct wlr_cursor *cur,
+		const uint32_t *time_msec) {
+	struct wlr_cursor_state *state = cur->state;
+	if (!state->touch_motion_pending) {
+		return;
+	}
+
+	bool frame = state->touch_frame_pending;
+	state->touch_motion_pending = false;
+	state->touch_frame_pending = false;
+
+	// Copy the points, listeners may add or remove some
+	struct wl_array points;
+	wl_array_init(&points);
+	bool copied = wl_array_copy(&points, &state->touch_points) == 0;
+
+	struct cursor_touch_point *point;
+	wl_array_for_each(point, &state->touch_points) {
+		point->motion_pending = false;
+	}
+
+	if (!copied) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		wl_array_release(&points);
+		return;
+	}
+
+	wl_array_for_each(point, &points) {
+		if (!point->motion_pending) {
+			continue;
+		}
+
+		struct cursor_touch_sample sample;
+		if (time_msec != NULL) {
+			touch_point_resample(point, *time_msec, &sample);
+		} else {
+			sample = point->samples[point->samples_len - 1];
+		}
+
+		struct wlr_touch_motion_event event = {
+			.touch = point->touch,
+			.time_msec = sample.time_msec,
+			.touch_id = point->touch_id,
+			.x = sample.x,
+			.y = sample.y,
+		};
+		wl_signal_emit_mutable(&cur->events.touch_motion, &event);
+	}
+	wl_array_release(&points);
+
+	if (frame) {
+		wl_signal_emit_mutable(&cur->events.touch_frame, NULL);
+	}
+}
+
+void wlr_cursor_flush_motion(struct wlr_cursor *cur) {
+	cursor_flush_pointer_motion(cur);
+	cursor_flush_touch_motion(cur, NULL);
+}
+
+static struct cursor_touch_point *cursor_get_touch_point(struct wlr_cursor *cur,
+		struct wlr_touch *touch, int32_t touch_id, bool create) {
+	struct cursor_touch_point *point;
+	wl_array_for_each(point, &cur->state->touch_points) {
+		if (point->touch == touch && point->touch_id == touch_id) {
+			return point;
+		}
+	}
+	if (!create) {
+		return NULL;
+	}
+
+	point = wl_array_add(&cur->state->touch_points, sizeof(*point));
+	if (point == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	*point = (struct cursor_touch_point){
+		.touch = touch,
+		.touch_id = touch_id,
+	};
+	return point;
+}
+
+static void touch_point_add_sample(struct cursor_touch_point *point,
+		uint32_t time_msec, double x, double y) {
+	if (point->samples_len == 2) {
+		point->samples[0] = point->samples[1];
+		point->samples_len = 1;
+	}
+	point->samples[point->samples_len++] = (struct cursor_touch_sample){
+		.time_msec = time_msec,
+		.x = x,
+		.y = y,
+	};
+}
+
+static void cursor_remove_touch_points(struct wlr_cursor *cur,
+		struct wlr_touch *touch, int32_t touch_id, bool all_ids) {
+	struct wl_array *points = &cur->state->touch_points;
+	struct cursor_touch_point *data = points->data;
+	size_t len = points->size / sizeof(*data);
+	size_t j = 0;
+	for (size_t i = 0; i < len; i++) {
+		if (data[i].touch == touch && (all_ids || data[i].touch_id == touch_id)) {
+			continue;
+		}
+		data[j++] = data[i];
+	}
+	points->size = j * sizeof(*data);
+}
+
+void wlr_cursor_set_touch_resampling(struct wlr_cursor *cur, bool enabled) {
+	cur->state->resample_touch = enabled;
+	if (!enabled) {
+		cursor_flush_touch_motion(cur, NULL);
+		cur->state->touch_points.size = 0;
+	}
+}
+
+void wlr_cursor_set_motion_coalescing(struct wlr_cursor *cur, bool enabled) {
+	cur->state->coalesce_motion = enabled;
+	if (!enabled) {
+		wlr_cursor_flush_motion(cur);
+	}
+}
+
+static bool cursor_schedule_motion(struct wlr_cursor *cur) {
+	bool scheduled = false;
+	struct wlr_cursor_output_cursor *output_cursor;
+	wl_list_for_each(output_cursor, &cur->state->output_cursors, link) {
+		struct wlr_output *output = output_cursor->output_cursor->output;
+		if (output->enabled) {
+			wlr_output_schedule_frame(output);
+			scheduled = true;
+		}
+	}
+	return scheduled;
+}
+
 static void handle_pointer_motion(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_motion_event *event = data;
 	struct wlr_cursor_device *device =
 		wl_container_of(listener, device, motion);
-	wl_signal_emit_mutable(&device->cursor->events.motion, event);
+	struct wlr_cursor_state *state = device->cursor->state;
+
+	cursor_flush_touch_motion(device->cursor, NULL);
+	if (state->motion_pending && state->pending_motion.pointer != event->pointer) {
+		cursor_flush_pointer_motion(device->cursor);
+	}
+
+	if (!state->coalesce_motion) {
+		wl_signal_emit_mutable(&device->cursor->events.motion, event);
+		return;
+	}
+
+	if (state->motion_pending) {
+		struct wlr_pointer_motion_event *pending = &state->pending_motion;
+		pending->time_msec = event->time_msec;
+		pending->delta_x += event->delta_x;
+		pending->delta_y += event->delta_y;
+		pending->unaccel_dx += event->unaccel_dx;
+		pending->unaccel_dy += event->unaccel_dy;
+		return;
+	}
+
+	// Without an output to wait for, there is nothing to coalesce with
+	if (!cursor_schedule_motion(device->cursor)) {
+		wl_signal_emit_mutable(&device->cursor->events.motion, event);
+		return;
+	}
+
+	state->pending_motion = *event;
+	state->motion_pending = true;
 }
 
 static void apply_output_transform(double *x, double *y,
@@ -766,6 +1245,7 @@ static void handle_pointer_motion_absolute(struct wl_listener *listener,
 	struct wlr_pointer_motion_absolute_event *event = data;
 	struct wlr_cursor_device *device =
 		wl_container_of(listener, device, motion_absolute);
+	wlr_cursor_flush_motion(device->cursor);
 
 	struct wlr_output *output =
 		get_mapped_output(device);
@@ -779,65 +1259,81 @@ static void handle_pointer_button(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_button_event *event = data;
 	struct wlr_cursor_device *device =
 		wl_container_of(listener, device, button);
+	wlr_cursor_flush_motion(device->cursor);
 	wl_signal_emit_mutable(&device->cursor->events.button, event);
 }
 
 static void handle_pointer_axis(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_axis_event *event = data;
 	struct wlr_cursor_device *device = wl_container_of(listener, device, axis);
+	wlr_cursor_flush_motion(device->cursor);
 	wl_signal_emit_mutable(&device->cursor->events.axis, event);
 }
 
 static void handle_pointer_frame(struct wl_listener *listener, void *data) {
 	struct wlr_cursor_device *device = wl_container_of(listener, device, frame);
+	struct wlr_cursor_state *state = device->cursor->state;
+	if (state->motion_pending) {
+		// Sent along with the coalesced motion
+		state->motion_frame_pending = true;
+		return;
+	}
 	wl_signal_emit_mutable(&device->cursor->events.frame, device->cursor);
 }
 
 static void handle_pointer_swipe_begin(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_swipe_begin_event *event = data;
 	struct wlr_cursor_device *device = wl_container_of(listener, device, swipe_begin);
+	wlr_cursor_flush_motion(device->cursor);
 	wl_signal_emit_mutable(&device->cursor->events.swipe_begin, event);
 }
 
 static void handle_pointer_swipe_update(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_swipe_update_event *event = data;
 	struct wlr_cursor_device *device = wl_container_of(listener, device, swipe_update);
+	wlr_cursor_flush_motion(device->cursor);
 	wl_signal_emit_mutable(&device->cursor->events.swipe_update, event);
 }
 
 static void handle_pointer_swipe_end(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_swipe_end_event *event = data;
 	struct wlr_cursor_device *device = wl_container_of(listener, device, swipe_end);
+	wlr_cursor_flush_motion(device->cursor);
 	wl_signal_emit_mutable(&device->cursor->events.swipe_end, event);
 }
 
 static void handle_pointer_pinch_begin(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_pinch_begin_event *event = data;
 	struct wlr_cursor_device *device = wl_container_of(listener, device, pinch_begin);
+	wlr_cursor_flush_motion(device->cursor);
 	wl_signal_emit_mutable(&device->cursor->events.pinch_begin, event);
 }
 
 static void handle_pointer_pinch_update(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_pinch_update_event *event = data;
 	struct wlr_cursor_device *device = wl_container_of(listener, device, pinch_update);
+	wlr_cursor_flush_motion(device->cursor);
 	wl_signal_emit_mutable(&device->cursor->events.pinch_update, event);
 }
 
 static void handle_pointer_pinch_end(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_pinch_end_event *event = data;
 	struct wlr_cursor_device *device = wl_container_of(listener, device, pinch_end);
+	wlr_cursor_flush_motion(device->cursor);
 	wl_signal_emit_mutable(&device->cursor->events.pinch_end, event);
 }
 
 static void handle_pointer_hold_begin(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_hold_begin_event *event = data;
 	struct wlr_cursor_device *device = wl_container_of(listener, device, hold_begin);
+	wlr_cursor_flush_motion(device->cursor);
 	wl_signal_emit_mutable(&device->cursor->events.hold_begin, event);
 }
 
 static void handle_pointer_hold_end(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_hold_end_event *event = data;
 	struct wlr_cursor_device *device = wl_container_of(listener, device, hold_end);
+	wlr_cursor_flush_motion(device->cursor);
 	wl_signal_emit_mutable(&device->cursor->events.hold_end, event);
 }
 
@@ -845,6 +1341,9 @@ static void handle_touch_up(struct wl_listener *listener, void *data) {
 	struct wlr_touch_up_event *event = data;
 	struct wlr_cursor_device *device;
 	device = wl_container_of(listener, device, touch_up);
+	wlr_cursor_flush_motion(device->cursor);
+	cursor_remove_touch_points(device->cursor, event->touch,
+		event->touch_id, false);
 	wl_signal_emit_mutable(&device->cursor->events.touch_up, event);
 }
 
@@ -852,12 +1351,23 @@ static void handle_touch_down(struct wl_listener *listener, void *data) {
 	struct wlr_touch_down_event *event = data;
 	struct wlr_cursor_device *device;
 	device = wl_container_of(listener, device, touch_down);
+	wlr_cursor_flush_motion(device->cursor);
 
 	struct wlr_output *output =
 		get_mapped_output(device);
 	if (output) {
 		apply_output_transform(&event->x, &event->y, output->transform);
 	}
+
+	if (device->cursor->state->resample_touch) {
+		struct cursor_touch_point *point = cursor_get_touch_point(device->cursor,
+			event->touch, event->touch_id, true);
+		if (point != NULL) {
+			point->samples_len = 0;
+			touch_point_add_sample(point, event->time_msec, event->x, event->y);
+		}
+	}
+
 	wl_signal_emit_mutable(&device->cursor->events.touch_down, event);
 }
 
@@ -865,25 +1375,61 @@ static void handle_touch_motion(struct wl_listener *listener, void *data) {
 	struct wlr_touch_motion_event *event = data;
 	struct wlr_cursor_device *device;
 	device = wl_container_of(listener, device, touch_motion);
+	struct wlr_cursor *cur = device->cursor;
+	struct wlr_cursor_state *state = cur->state;
+	cursor_flush_pointer_motion(cur);
 
 	struct wlr_output *output =
 		get_mapped_output(device);
 	if (output) {
 		apply_output_transform(&event->x, &event->y, output->transform);
 	}
-	wl_signal_emit_mutable(&device->cursor->events.touch_motion, event);
+
+	struct cursor_touch_point *point = NULL;
+	if (state->resample_touch) {
+		point = cursor_get_touch_point(cur, event->touch, event->touch_id, true);
+	}
+	if (point == NULL) {
+		cursor_flush_touch_motion(cur, NULL);
+		wl_signal_emit_mutable(&cur->events.touch_motion, event);
+		return;
+	}
+
+	touch_point_add_sample(point, event->time_msec, event->x, event->y);
+	if (point->motion_pending) {
+		return;
+	}
+
+	// Without an output to wait for, there is nothing to resample for
+	if (!state->touch_motion_pending && !cursor_schedule_motion(cur)) {
+		wl_signal_emit_mutable(&cur->events.touch_motion, event);
+		return;
+	}
+
+	point->motion_pending = true;
+	state->touch_motion_pending = true;
 }
 
 static void handle_touch_cancel(struct wl_listener *listener, void *data) {
 	struct wlr_touch_cancel_event *event = data;
 	struct wlr_cursor_device *device;
 	device = wl_container_of(listener, device, touch_cancel);
+	wlr_cursor_flush_motion(device->cursor);
+	cursor_remove_touch_points(device->cursor, event->touch,
+		event->touch_id, false);
 	wl_signal_emit_mutable(&device->cursor->events.touch_cancel, event);
 }
 
 static void handle_touch_frame(struct wl_listener *listener, void *data) {
 	struct wlr_cursor_device *device =
 		wl_container_of(listener, device, touch_frame);
+	struct wlr_cursor_state *state = device->cursor->state;
+	if (state->touch_motion_pending) {
+		// Sent along with the resampled motion
+		state->touch_frame_pending = true;
+		return;
+	}
+	wlr_cursor_flush_motion(device->cursor);
 	wl_signal_emit_mutable(&device->cursor->events.touch_frame, NULL);
 }
 
@@ -891,6 +1437,7 @@ static void handle_tablet_tool_tip(struct wl_listener *listener, void *data) {
 	struct wlr_tablet_tool_tip_event *event = data;
 	struct wlr_cursor_device *device;
 	device = wl_container_of(listener, device, tablet_tool_tip);
+	wlr_cursor_flush_motion(device->cursor);
 
 	struct wlr_output *output =
 		get_mapped_output(device);
@@ -904,6 +1451,7 @@ static void handle_tablet_tool_axis(struct wl_listener *listener, void *data) {
 	struct wlr_tablet_tool_axis_event *event = data;
 	struct wlr_cursor_device *device;
 	device = wl_container_of(listener, device, tablet_tool_axis);
+	wlr_cursor_flush_motion(device->cursor);
 
 	struct wlr_output *output = get_mapped_output(device);
 	if (output) {
@@ -940,6 +1488,7 @@ static void handle_tablet_tool_button(struct wl_listener *listener,
 	struct wlr_tablet_tool_button *event = data;
 	struct wlr_cursor_device *device;
 	device = wl_container_of(listener, device, tablet_tool_button);
+	wlr_cursor_flush_motion(device->cursor);
 	wl_signal_emit_mutable(&device->cursor->events.tablet_tool_button, event);
 }
 
@@ -948,6 +1497,7 @@ static void handle_tablet_tool_proximity(struct wl_listener *listener,
 	struct wlr_tablet_tool_proximity_event *event = data;
 	struct wlr_cursor_device *device;
 	device = wl_container_of(listener, device, tablet_tool_proximity);
+	wlr_cursor_flush_motion(device->cursor);
 
 	struct wlr_output *output =
 		get_mapped_output(device);
@@ -1149,6 +1699,14 @@ static void layout_add(struct wlr_cursor_state *state,
 		&output_cursor->output_commit);
 	output_cursor->output_commit.notify = output_cursor_output_handle_output_commit;
 
+	wl_signal_add(&output_cursor->output_cursor->output->events.frame,
+		&output_cursor->output_frame);
+	output_cursor->output_frame.notify = output_cursor_output_handle_output_frame;
+
+	wl_signal_add(&output_cursor->output_cursor->output->events.present,
+		&output_cursor->output_present);
+	output_cursor->output_present.notify = output_cursor_output_handle_output_present;
+
 	output_cursor_move(output_cursor);
 	cursor_output_cursor_update(output_cursor);
 }
@@ -7,9 +7,13 @@
 #include <wlr/util/box.h>
 
 #define WLR_DAMAGE_RING_MAX_RECTS 20
+#define WLR_DAMAGE_RING_MAX_WASTE 0.5f
 
 void wlr_damage_ring_init(struct wlr_damage_ring *ring) {
-	*ring = (struct wlr_damage_ring){ 0 };
+	*ring = (struct wlr_damage_ring){
+		.max_rects = WLR_DAMAGE_RING_MAX_RECTS,
+		.max_waste = WLR_DAMAGE_RING_MAX_WASTE,
+	};
 	pixman_region32_init(&ring->current);
 	wl_list_init(&ring->buffers);
 }
@@ -55,6 +59,70 @@ void wlr_damage_ring_add_whole(struct wlr_damage_ring *ring) {
 		&ring->current, 0, 0, width, height);
 }
 
+static uint64_t box_area(const pixman_box32_t *box) {
+	return (uint64_t)(box->x2 - box->x1) * (uint64_t)(box->y2 - box->y1);
+}
+
+static uint64_t region_area(const pixman_region32_t *region) {
+	int rects_len;
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+	uint64_t area = 0;
+	for (int i = 0; i < rects_len; i++) {
+		area += box_area(&rects[i]);
+	}
+	return area;
+}
+
+// Reduces the number of rectangles of a region by growing it, and returns the
+// number of pixels which were added
+static uint64_t ring_simplify_region(struct wlr_damage_ring *ring,
+		pixman_region32_t *region) {
+	int rects_len = pixman_region32_n_rects(region);
+	int max_rects = ring->max_rects > 0 ? ring->max_rects : 1;
+	if (rects_len <= max_rects) {
+		return 0;
+	}
+
+	uint64_t area = region_area(region);
+	pixman_box32_t extents = *pixman_region32_extents(region);
+	uint64_t extents_area = box_area(&extents);
+	if ((double)(extents_area - area) <= (double)ring->max_waste * extents_area ||
+			max_rects == 1) {
+		pixman_region32_reset(region, &extents);
+		return extents_area - area;
+	}
+
+	pixman_box32_t *merged = calloc(max_rects, sizeof(*merged));
+	if (merged == NULL) {
+		pixman_region32_reset(region, &extents);
+		return extents_area - area;
+	}
+
+	// Rectangles are sorted by bands, so consecutive rectangles are close
+	// to each other: merge runs of them into their bounding boxes. This
+	// keeps e.g. separate lines of text apart.
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+	int merged_len = 0;
+	for (int i = 0; i < rects_len; merged_len++) {
+		int end = (int)((int64_t)rects_len * (merged_len + 1) / max_rects);
+		pixman_box32_t box = rects[i];
+		for (i++; i < end; i++) {
+			box.x1 = rects[i].x1 < box.x1 ? rects[i].x1 : box.x1;
+			box.y1 = rects[i].y1 < box.y1 ? rects[i].y1 : box.y1;
+			box.x2 = rects[i].x2 > box.x2 ? rects[i].x2 : box.x2;
+			box.y2 = rects[i].y2 > box.y2 ? rects[i].y2 : box.y2;
+		}
+		merged[merged_len] = box;
+	}
+
+	pixman_region32_t simplified;
+	pixman_region32_init_rects(&simplified, merged, merged_len);
+	free(merged);
+	pixman_region32_copy(region, &simplified);
+	pixman_region32_fini(&simplified);
+	return region_area(region) - area;
+}
+
 static void entry_squash_damage(struct wlr_damage_ring_buffer *entry) {
 	pixman_region32_t *prev;
 	if (entry->link.prev == &entry->ring->buffers) {
@@ -67,6 +135,7 @@ static void entry_squash_damage(struct wlr_damage_ring_buffer *entry) {
 	}
 
 	pixman_region32_union(prev, prev, &entry->damage);
+	ring_simplify_region(entry->ring, prev);
 }
 
 static void buffer_handle_destroy(struct wl_listener *listener, void *data) {
@@ -88,15 +157,7 @@ void wlr_damage_ring_rotate_buffer(struct wlr_damage_ring *ring,
 
 		pixman_region32_intersect_rect(damage, damage, 0, 0, buffer->width, buffer->height);
 
-		// Check the number of rectangles
-		int n_rects = pixman_region32_n_rects(damage);
-		if (n_rects > WLR_DAMAGE_RING_MAX_RECTS) {
-			pixman_box32_t *extents = pixman_region32_extents(damage);
-			pixman_region32_union_rect(damage, damage,
-				extents->x1, extents->y1,
-				extents->x2 - extents->x1,
-				extents->y2 - extents->y1);
-		}
+		ring->overpainted_pixels += ring_simplify_region(ring, damage);
 
 		// rotate
 		entry_squash_damage(entry);
@@ -3,8 +3,11 @@
 #include <unistd.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/dmabuf.h>
+#include <wlr/render/drm_syncobj.h>
+#include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_export_dmabuf_v1.h>
 #include <wlr/util/log.h>
+#include "render/dmabuf.h"
 #include "wlr-export-dmabuf-unstable-v1-protocol.h"
 
 #define EXPORT_DMABUF_MANAGER_VERSION 1
@@ -32,7 +35,7 @@ static void frame_destroy(struct wlr_export_dmabuf_frame_v1 *frame) {
 	if (frame == NULL) {
 		return;
 	}
-	if (frame->output != NULL) {
+	if (frame->output != NULL && frame->capturing) {
 		wlr_output_lock_attach_render(frame->output, false);
 		if (frame->cursor_locked) {
 			wlr_output_lock_software_cursors(frame->output, false);
@@ -41,11 +44,42 @@ static void frame_destroy(struct wlr_export_dmabuf_frame_v1 *frame) {
 	wl_list_remove(&frame->link);
 	wl_list_remove(&frame->output_commit.link);
 	wl_list_remove(&frame->output_destroy.link);
+	wlr_buffer_unlock(frame->held_buffer);
 	// Make the frame resource inert
 	wl_resource_set_user_data(frame->resource, NULL);
 	free(frame);
 }
 
+static size_t output_count_held_buffers(struct wlr_export_dmabuf_manager_v1 *manager,
+		struct wlr_output *output) {
+	size_t n = 0;
+	struct wlr_export_dmabuf_frame_v1 *frame;
+	wl_list_for_each(frame, &manager->frames, link) {
+		if (frame->output == output && frame->held_buffer != NULL) {
+			n++;
+		}
+	}
+	return n;
+}
+
+static void attach_render_fence(const struct wlr_output_state *state,
+		const struct wlr_dmabuf_attributes *attribs) {
+	if (!(state->committed & WLR_OUTPUT_STATE_WAIT_TIMELINE) ||
+			!dmabuf_check_sync_file_import_export()) {
+		return;
+	}
+
+	int sync_file_fd = wlr_drm_syncobj_timeline_export_sync_file(
+		state->wait_timeline, state->wait_point);
+	if (sync_file_fd < 0) {
+		return;
+	}
+	for (int i = 0; i < attribs->n_planes; i++) {
+		dmabuf_import_sync_file(attribs->fd[i], DMA_BUF_SYNC_WRITE, sync_file_fd);
+	}
+	close(sync_file_fd);
+}
+
 static void frame_handle_resource_destroy(struct wl_resource *resource) {
 	struct wlr_export_dmabuf_frame_v1 *frame = frame_from_resource(resource);
 	frame_destroy(frame);
@@ -73,6 +107,14 @@ static void frame_output_handle_commit(struct wl_listener *listener,
 	}
 
 	uint32_t frame_flags = ZWLR_EXPORT_DMABUF_FRAME_V1_FLAGS_TRANSIENT;
+	if (output_count_held_buffers(frame->manager, frame->output) <
+			frame->manager->max_held_buffers) {
+		// Keep the buffer out of the swapchain until the client is done
+		// with it, and make importers wait for rendering to finish
+		frame->held_buffer = wlr_buffer_lock(event->state->buffer);
+		attach_render_fence(event->state, &attribs);
+		frame_flags = 0;
+	}
 	uint32_t mod_high = attribs.modifier >> 32;
 	uint32_t mod_low = attribs.modifier & 0xFFFFFFFF;
 	zwlr_export_dmabuf_frame_v1_send_frame(frame->resource,
@@ -90,7 +132,18 @@ static void frame_output_handle_commit(struct wl_listener *listener,
 	uint32_t tv_sec_lo = tv_sec & 0xFFFFFFFF;
 	zwlr_export_dmabuf_frame_v1_send_ready(frame->resource,
 		tv_sec_hi, tv_sec_lo, event->when->tv_nsec);
-	frame_destroy(frame);
+	if (frame->held_buffer == NULL) {
+		frame_destroy(frame);
+		return;
+	}
+
+	// Stop capturing, but keep the frame until the client destroys it
+	wlr_output_lock_attach_render(frame->output, false);
+	if (frame->cursor_locked) {
+		wlr_output_lock_software_cursors(frame->output, false);
+		frame->cursor_locked = false;
+	}
+	frame->capturing = false;
 }
 
 static void frame_output_handle_destroy(struct wl_listener *listener, void *data) {
@@ -145,6 +198,7 @@ static void manager_handle_capture_output(struct wl_client *client,
 	}
 
 	frame->output = output;
+	frame->capturing = true;
 
 	wlr_output_lock_attach_render(frame->output, true);
 	if (overlay_cursor) {
@@ -219,3 +273,8 @@ struct wlr_export_dmabuf_manager_v1 *wlr_export_dmabuf_manager_v1_create(
 
 	return manager;
 }
+
+void wlr_export_dmabuf_manager_v1_set_max_held_buffers(
+		struct wlr_export_dmabuf_manager_v1 *manager, size_t max) {
+	manager->max_held_buffers = max;
+}
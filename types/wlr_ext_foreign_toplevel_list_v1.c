@@ -8,6 +8,7 @@
 #include <wlr/util/log.h>
 #include "ext-foreign-toplevel-list-v1-protocol.h"
 
+#include "util/time.h"
 #include "util/token.h"
 
 #define FOREIGN_TOPLEVEL_LIST_V1_VERSION 1
@@ -61,25 +62,85 @@ struct wlr_ext_foreign_toplevel_handle_v1 *wlr_ext_foreign_toplevel_handle_v1_fr
 	return wl_resource_get_user_data(resource);
 }
 
+static void toplevel_send_update(struct wlr_ext_foreign_toplevel_handle_v1 *toplevel,
+		bool changed_app_id, bool changed_title) {
+	if (changed_title) {
+		toplevel->title_pending = false;
+		toplevel->title_sent_msec = get_current_time_msec();
+	}
+
+	struct wl_resource *resource;
+	wl_resource_for_each(resource, &toplevel->resources) {
+		if (changed_app_id) {
+			ext_foreign_toplevel_handle_v1_send_app_id(resource,
+				toplevel->app_id ? toplevel->app_id : "");
+		}
+		if (changed_title) {
+			ext_foreign_toplevel_handle_v1_send_title(resource,
+				toplevel->title ? toplevel->title : "");
+		}
+		ext_foreign_toplevel_handle_v1_send_done(resource);
+	}
+}
+
+static int toplevel_handle_title_timer(void *data) {
+	struct wlr_ext_foreign_toplevel_handle_v1 *toplevel = data;
+	if (toplevel->title_pending) {
+		toplevel_send_update(toplevel, false, true);
+	}
+	return 0;
+}
+
+// Returns true if the title can be sent now, otherwise arms the title timer
+static bool toplevel_title_rate_check(
+		struct wlr_ext_foreign_toplevel_handle_v1 *toplevel) {
+	if (toplevel->title_max_rate == 0) {
+		return true;
+	}
+
+	int64_t interval_msec = 1000 / toplevel->title_max_rate;
+	int64_t elapsed_msec = get_current_time_msec() - toplevel->title_sent_msec;
+	if (elapsed_msec >= interval_msec) {
+		return true;
+	}
+
+	if (toplevel->title_timer == NULL) {
+		toplevel->title_timer = wl_event_loop_add_timer(
+			toplevel->list->event_loop, toplevel_handle_title_timer, toplevel);
+		if (toplevel->title_timer == NULL) {
+			return true;
+		}
+	}
+	wl_event_source_timer_update(toplevel->title_timer,
+		interval_msec - elapsed_msec);
+	return false;
+}
+
 void wlr_ext_foreign_toplevel_handle_v1_update_state(
 		struct wlr_ext_foreign_toplevel_handle_v1 *toplevel,
 		const struct wlr_ext_foreign_toplevel_handle_v1_state *state) {
 	bool changed_app_id = update_string(toplevel, &toplevel->app_id, state->app_id);
 	bool changed_title = update_string(toplevel, &toplevel->title, state->title);
 
+	if (changed_title && !toplevel_title_rate_check(toplevel)) {
+		toplevel->title_pending = true;
+		changed_title = false;
+	}
+
 	if (!changed_app_id && !changed_title) {
 		return;
 	}
 
-	struct wl_resource *resource;
-	wl_resource_for_each(resource, &toplevel->resources) {
-		if (changed_app_id) {
-			ext_foreign_toplevel_handle_v1_send_app_id(resource, state->app_id ? state->app_id : "");
-		}
-		if (changed_title) {
-			ext_foreign_toplevel_handle_v1_send_title(resource, state->title ? state->title : "");
-		}
-		ext_foreign_toplevel_handle_v1_send_done(resource);
+	toplevel_send_update(toplevel, changed_app_id, changed_title);
+}
+
+void wlr_ext_foreign_toplevel_handle_v1_set_title_rate_limit(
+		struct wlr_ext_foreign_toplevel_handle_v1 *toplevel, uint32_t max_rate) {
+	toplevel->title_max_rate = max_rate;
+	if (max_rate == 0 && toplevel->title_pending) {
+		// Send the held back title right away
+		wl_event_source_timer_update(toplevel->title_timer, 0);
+		toplevel_send_update(toplevel, false, true);
 	}
 }
 
@@ -101,6 +162,10 @@ void wlr_ext_foreign_toplevel_handle_v1_destroy(
 
 	wl_list_remove(&toplevel->link);
 
+	if (toplevel->title_timer) {
+		wl_event_source_remove(toplevel->title_timer);
+	}
+
 	free(toplevel->title);
 	free(toplevel->app_id);
 	free(toplevel->identifier);
@@ -276,6 +341,8 @@ struct wlr_ext_foreign_toplevel_list_v1 *wlr_ext_foreign_toplevel_list_v1_create
 		return NULL;
 	}
 
+	list->event_loop = wl_display_get_event_loop(display);
+
 	wl_signal_init(&list->events.destroy);
 	wl_list_init(&list->resources);
 	wl_list_init(&list->toplevels);
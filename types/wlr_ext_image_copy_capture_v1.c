@@ -0,0 +1,855 @@
+#include <assert.h>
+#include <drm_fourcc.h>
+#include <stdlib.h>
+#include <wlr/interfaces/wlr_ext_image_capture_source_v1.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/render/pass.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_ext_image_copy_capture_v1.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/util/log.h>
+#include "ext-image-copy-capture-v1-protocol.h"
+#include "render/pixel_format.h"
+
+#define IMAGE_COPY_CAPTURE_MANAGER_V1_VERSION 1
+
+struct wlr_ext_image_copy_capture_session_v1 {
+	struct wl_resource *resource;
+	struct wlr_ext_image_capture_source_v1 *source; // NULL if stopped
+	bool with_cursors;
+	struct wlr_ext_image_copy_capture_frame_v1 *frame;
+
+	// Damage accumulated since the last frame, buffer-local coordinates
+	pixman_region32_t damage;
+
+	// Client buffers which have been checked against the current buffer
+	// constraints, and captured at least once
+	struct wl_list buffers; // session_buffer.link
+
+	struct wl_listener source_constraints_update;
+	struct wl_listener source_frame;
+	struct wl_listener source_destroy;
+};
+
+struct session_buffer {
+	struct wl_list link; // wlr_ext_image_copy_capture_session_v1.buffers
+	struct wlr_buffer *buffer;
+	struct wl_listener buffer_destroy;
+};
+
+struct wlr_ext_image_copy_capture_cursor_session_v1 {
+	struct wl_resource *resource;
+	struct wlr_ext_image_capture_source_v1_cursor *cursor; // NULL if inert
+	bool capture_session_created;
+
+	// Last state sent to the client
+	bool entered;
+	int32_t x, y;
+	struct {
+		int32_t x, y;
+	} hotspot;
+
+	struct wl_listener cursor_update;
+	struct wl_listener cursor_destroy;
+};
+
+static const struct ext_image_copy_capture_frame_v1_interface frame_impl;
+static const struct ext_image_copy_capture_session_v1_interface session_impl;
+static const struct ext_image_copy_capture_cursor_session_v1_interface cursor_session_impl;
+static const struct ext_image_copy_capture_manager_v1_interface manager_impl;
+
+static struct wlr_ext_image_copy_capture_frame_v1 *frame_from_resource(
+		struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource,
+		&ext_image_copy_capture_frame_v1_interface, &frame_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+static struct wlr_ext_image_copy_capture_session_v1 *session_from_resource(
+		struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource,
+		&ext_image_copy_capture_session_v1_interface, &session_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+static struct wlr_ext_image_copy_capture_cursor_session_v1 *cursor_session_from_resource(
+		struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource,
+		&ext_image_copy_capture_cursor_session_v1_interface, &cursor_session_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+static void session_buffer_destroy(struct session_buffer *session_buffer) {
+	wl_list_remove(&session_buffer->buffer_destroy.link);
+	wl_list_remove(&session_buffer->link);
+	free(session_buffer);
+}
+
+static void session_buffer_handle_buffer_destroy(struct wl_listener *listener,
+		void *data) {
+	struct session_buffer *session_buffer =
+		wl_container_of(listener, session_buffer, buffer_destroy);
+	session_buffer_destroy(session_buffer);
+}
+
+static struct session_buffer *session_find_buffer(
+		struct wlr_ext_image_copy_capture_session_v1 *session,
+		struct wlr_buffer *buffer) {
+	struct session_buffer *session_buffer;
+	wl_list_for_each(session_buffer, &session->buffers, link) {
+		if (session_buffer->buffer == buffer) {
+			return session_buffer;
+		}
+	}
+	return NULL;
+}
+
+static void session_clear_buffers(struct wlr_ext_image_copy_capture_session_v1 *session) {
+	struct session_buffer *session_buffer, *tmp;
+	wl_list_for_each_safe(session_buffer, tmp, &session->buffers, link) {
+		session_buffer_destroy(session_buffer);
+	}
+}
+
+static bool session_check_buffer(struct wlr_ext_image_copy_capture_session_v1 *session,
+		struct wlr_buffer *buffer) {
+	struct wlr_ext_image_capture_source_v1 *source = session->source;
+	if ((uint32_t)buffer->width != source->width ||
+			(uint32_t)buffer->height != source->height) {
+		return false;
+	}
+
+	struct wlr_dmabuf_attributes dmabuf;
+	struct wlr_shm_attributes shm;
+	if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+		return wlr_drm_format_set_has(&source->dmabuf_formats,
+			dmabuf.format, dmabuf.modifier);
+	} else if (wlr_buffer_get_shm(buffer, &shm)) {
+		bool found = false;
+		for (size_t i = 0; i < source->shm_formats_len; i++) {
+			if (source->shm_formats[i] == shm.format) {
+				found = true;
+				break;
+			}
+		}
+		const struct wlr_pixel_format_info *info =
+			drm_get_pixel_format_info(shm.format);
+		return found && info != NULL &&
+			pixel_format_info_check_stride(info, shm.stride, shm.width);
+	}
+	return false;
+}
+
+static void frame_destroy(struct wlr_ext_image_copy_capture_frame_v1 *frame) {
+	if (frame == NULL) {
+		return;
+	}
+
+	wl_signal_emit_mutable(&frame->events.destroy, NULL);
+	assert(wl_list_empty(&frame->events.destroy.listener_list));
+
+	// Make the frame resource inert
+	wl_resource_set_user_data(frame->resource, NULL);
+
+	wlr_buffer_unlock(frame->buffer);
+	pixman_region32_fini(&frame->buffer_damage);
+	if (frame->session != NULL) {
+		frame->session->frame = NULL;
+	}
+	free(frame);
+}
+
+void wlr_ext_image_copy_capture_frame_v1_ready(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		enum wl_output_transform transform, const struct timespec *presentation_time) {
+	assert(frame->capturing);
+	struct wlr_ext_image_copy_capture_session_v1 *session = frame->session;
+
+	ext_image_copy_capture_frame_v1_send_transform(frame->resource, transform);
+
+	int rects_len = 0;
+	const pixman_box32_t *rects =
+		pixman_region32_rectangles(&session->damage, &rects_len);
+	for (int i = 0; i < rects_len; i++) {
+		const pixman_box32_t *rect = &rects[i];
+		ext_image_copy_capture_frame_v1_send_damage(frame->resource,
+			rect->x1, rect->y1, rect->x2 - rect->x1, rect->y2 - rect->y1);
+	}
+	pixman_region32_clear(&session->damage);
+
+	if (presentation_time != NULL) {
+		uint64_t tv_sec = (uint64_t)presentation_time->tv_sec;
+		ext_image_copy_capture_frame_v1_send_presentation_time(frame->resource,
+			tv_sec >> 32, tv_sec & 0xFFFFFFFF, presentation_time->tv_nsec);
+	}
+
+	ext_image_copy_capture_frame_v1_send_ready(frame->resource);
+	frame_destroy(frame);
+}
+
+void wlr_ext_image_copy_capture_frame_v1_fail(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		enum ext_image_copy_capture_frame_v1_failure_reason reason) {
+	struct wlr_ext_image_copy_capture_session_v1 *session = frame->session;
+	if (session != NULL && frame->buffer != NULL) {
+		// The buffer content is unknown now
+		struct session_buffer *session_buffer =
+			session_find_buffer(session, frame->buffer);
+		if (session_buffer != NULL) {
+			session_buffer_destroy(session_buffer);
+		}
+	}
+
+	ext_image_copy_capture_frame_v1_send_failed(frame->resource, reason);
+	frame_destroy(frame);
+}
+
+static bool copy_texture(struct wlr_buffer *dst, struct wlr_texture *texture,
+		struct wlr_renderer *renderer, const pixman_region32_t *region) {
+	struct wlr_dmabuf_attributes dmabuf;
+	if (wlr_buffer_get_dmabuf(dst, &dmabuf)) {
+		struct wlr_render_pass *pass =
+			wlr_renderer_begin_buffer_pass(renderer, dst, NULL);
+		if (pass == NULL) {
+			return false;
+		}
+		wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
+			.texture = texture,
+			.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+			.dst_box = {
+				.width = dst->width,
+				.height = dst->height,
+			},
+			.clip = region,
+		});
+		return wlr_render_pass_submit(pass);
+	}
+
+	void *data;
+	uint32_t format;
+	size_t stride;
+	if (!wlr_buffer_begin_data_ptr_access(dst,
+			WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &data, &format, &stride)) {
+		return false;
+	}
+
+	bool ok = true;
+	int rects_len = 0;
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+	for (int i = 0; i < rects_len && ok; i++) {
+		const pixman_box32_t *rect = &rects[i];
+		ok = wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options){
+			.data = data,
+			.format = format,
+			.stride = stride,
+			.dst_x = rect->x1,
+			.dst_y = rect->y1,
+			.src_box = {
+				.x = rect->x1,
+				.y = rect->y1,
+				.width = rect->x2 - rect->x1,
+				.height = rect->y2 - rect->y1,
+			},
+		});
+	}
+
+	wlr_buffer_end_data_ptr_access(dst);
+	return ok;
+}
+
+bool wlr_ext_image_copy_capture_frame_v1_copy_buffer(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		struct wlr_buffer *src, struct wlr_renderer *renderer) {
+	struct wlr_buffer *dst = frame->buffer;
+	struct wlr_ext_image_copy_capture_session_v1 *session = frame->session;
+	if (src->width != dst->width || src->height != dst->height) {
+		return false;
+	}
+
+	// Buffers captured before in this session only need the pixels damaged
+	// since, as reported by the client and the source. Other buffers are
+	// filled entirely, in case the client doesn't track damage.
+	pixman_region32_t region;
+	struct session_buffer *session_buffer = session_find_buffer(session, dst);
+	if (session_buffer != NULL) {
+		pixman_region32_init(&region);
+		pixman_region32_union(&region, &frame->buffer_damage, &session->damage);
+		pixman_region32_intersect_rect(&region, &region,
+			0, 0, dst->width, dst->height);
+	} else {
+		pixman_region32_init_rect(&region, 0, 0, dst->width, dst->height);
+	}
+
+	bool ok = true;
+	if (pixman_region32_not_empty(&region)) {
+		struct wlr_texture *texture = wlr_texture_from_buffer(renderer, src);
+		ok = texture != NULL && copy_texture(dst, texture, renderer, &region);
+		wlr_texture_destroy(texture);
+	}
+	pixman_region32_fini(&region);
+
+	if (!ok) {
+		if (session_buffer != NULL) {
+			session_buffer_destroy(session_buffer);
+		}
+		return false;
+	}
+
+	if (session_buffer == NULL) {
+		session_buffer = calloc(1, sizeof(*session_buffer));
+		if (session_buffer != NULL) {
+			session_buffer->buffer = dst;
+			session_buffer->buffer_destroy.notify = session_buffer_handle_buffer_destroy;
+			wl_signal_add(&dst->events.destroy, &session_buffer->buffer_destroy);
+			wl_list_insert(&session->buffers, &session_buffer->link);
+		}
+	}
+
+	return true;
+}
+
+static void frame_handle_destroy(struct wl_client *client,
+		struct wl_resource *frame_resource) {
+	wl_resource_destroy(frame_resource);
+}
+
+static void frame_handle_attach_buffer(struct wl_client *client,
+		struct wl_resource *frame_resource, struct wl_resource *buffer_resource) {
+	struct wlr_ext_image_copy_capture_frame_v1 *frame = frame_from_resource(frame_resource);
+	if (frame == NULL) {
+		return;
+	}
+
+	if (frame->capturing) {
+		wl_resource_post_error(frame->resource,
+			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_ERROR_ALREADY_CAPTURED,
+			"attach_buffer sent after capture");
+		return;
+	}
+
+	struct wlr_buffer *buffer = wlr_buffer_try_from_resource(buffer_resource);
+	if (buffer == NULL) {
+		wl_resource_post_no_memory(frame->resource);
+		return;
+	}
+
+	wlr_buffer_unlock(frame->buffer);
+	frame->buffer = buffer;
+}
+
+static void frame_handle_damage_buffer(struct wl_client *client,
+		struct wl_resource *frame_resource, int32_t x, int32_t y,
+		int32_t width, int32_t height) {
+	struct wlr_ext_image_copy_capture_frame_v1 *frame = frame_from_resource(frame_resource);
+	if (frame == NULL) {
+		return;
+	}
+
+	if (frame->capturing) {
+		wl_resource_post_error(frame->resource,
+			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_ERROR_ALREADY_CAPTURED,
+			"damage_buffer sent after capture");
+		return;
+	}
+
+	if (x < 0 || y < 0 || width <= 0 || height <= 0) {
+		wl_resource_post_error(frame->resource,
+			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_ERROR_INVALID_BUFFER_DAMAGE,
+			"Invalid buffer damage coordinates");
+		return;
+	}
+
+	pixman_region32_union_rect(&frame->buffer_damage, &frame->buffer_damage,
+		x, y, width, height);
+}
+
+static void frame_handle_capture(struct wl_client *client,
+		struct wl_resource *frame_resource) {
+	struct wlr_ext_image_copy_capture_frame_v1 *frame = frame_from_resource(frame_resource);
+	if (frame == NULL) {
+		return;
+	}
+
+	if (frame->capturing) {
+		wl_resource_post_error(frame->resource,
+			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_ERROR_ALREADY_CAPTURED,
+			"capture sent twice");
+		return;
+	}
+
+	if (frame->buffer == NULL) {
+		wl_resource_post_error(frame->resource,
+			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_ERROR_NO_BUFFER,
+			"capture sent without attach_buffer");
+		return;
+	}
+
+	frame->capturing = true;
+
+	struct wlr_ext_image_copy_capture_session_v1 *session = frame->session;
+	if (session->source == NULL) {
+		wlr_ext_image_copy_capture_frame_v1_fail(frame,
+			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_STOPPED);
+		return;
+	}
+
+	// Buffers reused by the client have already been checked
+	if (session_find_buffer(session, frame->buffer) == NULL &&
+			!session_check_buffer(session, frame->buffer)) {
+		wlr_ext_image_copy_capture_frame_v1_fail(frame,
+			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_BUFFER_CONSTRAINTS);
+		return;
+	}
+
+	session->source->impl->schedule_frame(session->source);
+}
+
+static const struct ext_image_copy_capture_frame_v1_interface frame_impl = {
+	.destroy = frame_handle_destroy,
+	.attach_buffer = frame_handle_attach_buffer,
+	.damage_buffer = frame_handle_damage_buffer,
+	.capture = frame_handle_capture,
+};
+
+static void frame_handle_resource_destroy(struct wl_resource *frame_resource) {
+	struct wlr_ext_image_copy_capture_frame_v1 *frame = frame_from_resource(frame_resource);
+	frame_destroy(frame);
+}
+
+static void session_send_constraints(struct wlr_ext_image_copy_capture_session_v1 *session) {
+	struct wlr_ext_image_capture_source_v1 *source = session->source;
+
+	ext_image_copy_capture_session_v1_send_buffer_size(session->resource,
+		source->width, source->height);
+
+	for (size_t i = 0; i < source->shm_formats_len; i++) {
+		ext_image_copy_capture_session_v1_send_shm_format(session->resource,
+			convert_drm_format_to_wl_shm(source->shm_formats[i]));
+	}
+
+	if (source->dmabuf_formats.len > 0) {
+		struct wl_array dev_array = {
+			.size = sizeof(source->dmabuf_device),
+			.data = &source->dmabuf_device,
+		};
+		ext_image_copy_capture_session_v1_send_dmabuf_device(session->resource,
+			&dev_array);
+	}
+
+	for (size_t i = 0; i < source->dmabuf_formats.len; i++) {
+		const struct wlr_drm_format *format = &source->dmabuf_formats.formats[i];
+		struct wl_array modifiers_array = {
+			.size = format->len * sizeof(format->modifiers[0]),
+			.data = format->modifiers,
+		};
+		ext_image_copy_capture_session_v1_send_dmabuf_format(session->resource,
+			format->format, &modifiers_array);
+	}
+
+	ext_image_copy_capture_session_v1_send_done(session->resource);
+}
+
+static void session_stop(struct wlr_ext_image_copy_capture_session_v1 *session) {
+	if (session->source == NULL) {
+		return;
+	}
+
+	session->source->impl->stop(session->source, session->with_cursors);
+
+	wl_list_remove(&session->source_constraints_update.link);
+	wl_list_remove(&session->source_frame.link);
+	wl_list_remove(&session->source_destroy.link);
+	session->source = NULL;
+
+	session_clear_buffers(session);
+}
+
+static void session_destroy(struct wlr_ext_image_copy_capture_session_v1 *session) {
+	if (session == NULL) {
+		return;
+	}
+
+	if (session->frame != NULL) {
+		session->frame->session = NULL;
+		// The frame resource can't be used anymore
+		frame_destroy(session->frame);
+	}
+
+	session_stop(session);
+	wl_resource_set_user_data(session->resource, NULL);
+	pixman_region32_fini(&session->damage);
+	free(session);
+}
+
+static void session_handle_source_constraints_update(struct wl_listener *listener,
+		void *data) {
+	struct wlr_ext_image_copy_capture_session_v1 *session =
+		wl_container_of(listener, session, source_constraints_update);
+
+	// Everything needs to be copied into buffers matching the new constraints
+	session_clear_buffers(session);
+	pixman_region32_union_rect(&session->damage, &session->damage, 0, 0,
+		session->source->width, session->source->height);
+
+	session_send_constraints(session);
+}
+
+static void session_handle_source_frame(struct wl_listener *listener,
+		void *data) {
+	struct wlr_ext_image_copy_capture_session_v1 *session =
+		wl_container_of(listener, session, source_frame);
+	struct wlr_ext_image_capture_source_v1_frame_event *event = data;
+	struct wlr_ext_image_capture_source_v1 *source = session->source;
+
+	pixman_region32_union(&session->damage, &session->damage, event->damage);
+	pixman_region32_intersect_rect(&session->damage, &session->damage,
+		0, 0, source->width, source->height);
+
+	struct wlr_ext_image_copy_capture_frame_v1 *frame = session->frame;
+	if (frame == NULL || !frame->capturing ||
+			!pixman_region32_not_empty(&session->damage)) {
+		return;
+	}
+
+	source->impl->copy_frame(source, frame, event);
+}
+
+static void session_handle_source_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_ext_image_copy_capture_session_v1 *session =
+		wl_container_of(listener, session, source_destroy);
+
+	session_stop(session);
+	ext_image_copy_capture_session_v1_send_stopped(session->resource);
+
+	if (session->frame != NULL && session->frame->capturing) {
+		wlr_ext_image_copy_capture_frame_v1_fail(session->frame,
+			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_STOPPED);
+	}
+}
+
+static void session_handle_create_frame(struct wl_client *client,
+		struct wl_resource *session_resource, uint32_t new_id) {
+	struct wlr_ext_image_copy_capture_session_v1 *session =
+		session_from_resource(session_resource);
+
+	uint32_t version = wl_resource_get_version(session_resource);
+	struct wl_resource *frame_resource = wl_resource_create(client,
+		&ext_image_copy_capture_frame_v1_interface, version, new_id);
+	if (frame_resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(frame_resource, &frame_impl, NULL,
+		frame_handle_resource_destroy);
+
+	if (session == NULL) {
+		ext_image_copy_capture_frame_v1_send_failed(frame_resource,
+			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_STOPPED);
+		return;
+	}
+
+	if (session->frame != NULL) {
+		wl_resource_post_error(session_resource,
+			EXT_IMAGE_COPY_CAPTURE_SESSION_V1_ERROR_DUPLICATE_FRAME,
+			"session already has a frame object");
+		return;
+	}
+
+	struct wlr_ext_image_copy_capture_frame_v1 *frame = calloc(1, sizeof(*frame));
+	if (frame == NULL) {
+		wl_resource_post_no_memory(session_resource);
+		return;
+	}
+
+	frame->resource = frame_resource;
+	frame->session = session;
+	pixman_region32_init(&frame->buffer_damage);
+	wl_signal_init(&frame->events.destroy);
+	wl_resource_set_user_data(frame_resource, frame);
+
+	session->frame = frame;
+}
+
+static void session_handle_destroy(struct wl_client *client,
+		struct wl_resource *session_resource) {
+	wl_resource_destroy(session_resource);
+}
+
+static const struct ext_image_copy_capture_session_v1_interface session_impl = {
+	.create_frame = session_handle_create_frame,
+	.destroy = session_handle_destroy,
+};
+
+static void session_handle_resource_destroy(struct wl_resource *session_resource) {
+	struct wlr_ext_image_copy_capture_session_v1 *session =
+		session_from_resource(session_resource);
+	session_destroy(session);
+}
+
+static void session_create(struct wl_client *client, uint32_t version,
+		uint32_t new_id, struct wlr_ext_image_capture_source_v1 *source,
+		bool with_cursors) {
+	struct wl_resource *session_resource = wl_resource_create(client,
+		&ext_image_copy_capture_session_v1_interface, version, new_id);
+	if (session_resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(session_resource, &session_impl, NULL,
+		session_handle_resource_destroy);
+
+	if (source == NULL) {
+		ext_image_copy_capture_session_v1_send_stopped(session_resource);
+		return;
+	}
+
+	struct wlr_ext_image_copy_capture_session_v1 *session = calloc(1, sizeof(*session));
+	if (session == NULL) {
+		wl_resource_post_no_memory(session_resource);
+		return;
+	}
+
+	session->resource = session_resource;
+	session->source = source;
+	session->with_cursors = with_cursors;
+	wl_list_init(&session->buffers);
+	pixman_region32_init_rect(&session->damage, 0, 0,
+		source->width, source->height);
+	wl_resource_set_user_data(session_resource, session);
+
+	session->source_constraints_update.notify = session_handle_source_constraints_update;
+	wl_signal_add(&source->events.constraints_update, &session->source_constraints_update);
+	session->source_frame.notify = session_handle_source_frame;
+	wl_signal_add(&source->events.frame, &session->source_frame);
+	session->source_destroy.notify = session_handle_source_destroy;
+	wl_signal_add(&source->events.destroy, &session->source_destroy);
+
+	session_send_constraints(session);
+
+	source->impl->start(source, with_cursors);
+}
+
+static void cursor_session_send_update(
+		struct wlr_ext_image_copy_capture_cursor_session_v1 *cursor_session) {
+	struct wlr_ext_image_capture_source_v1_cursor *cursor = cursor_session->cursor;
+
+	if (!cursor->entered) {
+		if (cursor_session->entered) {
+			ext_image_copy_capture_cursor_session_v1_send_leave(cursor_session->resource);
+			cursor_session->entered = false;
+		}
+		return;
+	}
+
+	bool entered = cursor_session->entered;
+	if (!entered) {
+		ext_image_copy_capture_cursor_session_v1_send_enter(cursor_session->resource);
+		cursor_session->entered = true;
+	}
+
+	if (!entered || cursor->x != cursor_session->x || cursor->y != cursor_session->y) {
+		ext_image_copy_capture_cursor_session_v1_send_position(cursor_session->resource,
+			cursor->x, cursor->y);
+		cursor_session->x = cursor->x;
+		cursor_session->y = cursor->y;
+	}
+
+	if (!entered || cursor->hotspot.x != cursor_session->hotspot.x ||
+			cursor->hotspot.y != cursor_session->hotspot.y) {
+		ext_image_copy_capture_cursor_session_v1_send_hotspot(cursor_session->resource,
+			cursor->hotspot.x, cursor->hotspot.y);
+		cursor_session->hotspot.x = cursor->hotspot.x;
+		cursor_session->hotspot.y = cursor->hotspot.y;
+	}
+}
+
+static void cursor_session_handle_cursor_update(struct wl_listener *listener,
+		void *data) {
+	struct wlr_ext_image_copy_capture_cursor_session_v1 *cursor_session =
+		wl_container_of(listener, cursor_session, cursor_update);
+	cursor_session_send_update(cursor_session);
+}
+
+static void cursor_session_reset(
+		struct wlr_ext_image_copy_capture_cursor_session_v1 *cursor_session) {
+	if (cursor_session->cursor == NULL) {
+		return;
+	}
+	wl_list_remove(&cursor_session->cursor_update.link);
+	wl_list_remove(&cursor_session->cursor_destroy.link);
+	cursor_session->cursor = NULL;
+}
+
+static void cursor_session_handle_cursor_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_ext_image_copy_capture_cursor_session_v1 *cursor_session =
+		wl_container_of(listener, cursor_session, cursor_destroy);
+	if (cursor_session->entered) {
+		ext_image_copy_capture_cursor_session_v1_send_leave(cursor_session->resource);
+		cursor_session->entered = false;
+	}
+	cursor_session_reset(cursor_session);
+}
+
+static void cursor_session_handle_get_capture_session(struct wl_client *client,
+		struct wl_resource *cursor_session_resource, uint32_t new_id) {
+	struct wlr_ext_image_copy_capture_cursor_session_v1 *cursor_session =
+		cursor_session_from_resource(cursor_session_resource);
+
+	uint32_t version = wl_resource_get_version(cursor_session_resource);
+	if (cursor_session == NULL) {
+		session_create(client, version, new_id, NULL, false);
+		return;
+	}
+
+	if (cursor_session->capture_session_created) {
+		wl_resource_post_error(cursor_session_resource,
+			EXT_IMAGE_COPY_CAPTURE_CURSOR_SESSION_V1_ERROR_DUPLICATE_SESSION,
+			"get_capture_session sent twice");
+		return;
+	}
+	cursor_session->capture_session_created = true;
+
+	struct wlr_ext_image_capture_source_v1 *source = NULL;
+	if (cursor_session->cursor != NULL) {
+		source = &cursor_session->cursor->base;
+	}
+	session_create(client, version, new_id, source, false);
+}
+
+static void cursor_session_handle_destroy(struct wl_client *client,
+		struct wl_resource *cursor_session_resource) {
+	wl_resource_destroy(cursor_session_resource);
+}
+
+static const struct ext_image_copy_capture_cursor_session_v1_interface cursor_session_impl = {
+	.destroy = cursor_session_handle_destroy,
+	.get_capture_session = cursor_session_handle_get_capture_session,
+};
+
+static void cursor_session_handle_resource_destroy(struct wl_resource *resource) {
+	struct wlr_ext_image_copy_capture_cursor_session_v1 *cursor_session =
+		cursor_session_from_resource(resource);
+	if (cursor_session == NULL) {
+		return;
+	}
+	cursor_session_reset(cursor_session);
+	free(cursor_session);
+}
+
+static void manager_handle_create_session(struct wl_client *client,
+		struct wl_resource *manager_resource, uint32_t new_id,
+		struct wl_resource *source_resource, uint32_t options) {
+	struct wlr_ext_image_capture_source_v1 *source =
+		wlr_ext_image_capture_source_v1_from_resource(source_resource);
+
+	if (options & ~EXT_IMAGE_COPY_CAPTURE_MANAGER_V1_OPTIONS_PAINT_CURSORS) {
+		wl_resource_post_error(manager_resource,
+			EXT_IMAGE_COPY_CAPTURE_MANAGER_V1_ERROR_INVALID_OPTION,
+			"invalid options");
+		return;
+	}
+
+	session_create(client, wl_resource_get_version(manager_resource), new_id,
+		source, options & EXT_IMAGE_COPY_CAPTURE_MANAGER_V1_OPTIONS_PAINT_CURSORS);
+}
+
+static void manager_handle_create_pointer_cursor_session(struct wl_client *client,
+		struct wl_resource *manager_resource, uint32_t new_id,
+		struct wl_resource *source_resource, struct wl_resource *pointer_resource) {
+	struct wlr_ext_image_capture_source_v1 *source =
+		wlr_ext_image_capture_source_v1_from_resource(source_resource);
+	struct wlr_seat_client *seat_client =
+		wlr_seat_client_from_pointer_resource(pointer_resource);
+
+	uint32_t version = wl_resource_get_version(manager_resource);
+	struct wl_resource *cursor_session_resource = wl_resource_create(client,
+		&ext_image_copy_capture_cursor_session_v1_interface, version, new_id);
+	if (cursor_session_resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(cursor_session_resource, &cursor_session_impl,
+		NULL, cursor_session_handle_resource_destroy);
+
+	struct wlr_ext_image_capture_source_v1_cursor *cursor = NULL;
+	if (source != NULL && seat_client != NULL && source->impl->get_pointer_cursor != NULL) {
+		cursor = source->impl->get_pointer_cursor(source, seat_client->seat);
+	}
+
+	struct wlr_ext_image_copy_capture_cursor_session_v1 *cursor_session =
+		calloc(1, sizeof(*cursor_session));
+	if (cursor_session == NULL) {
+		wl_resource_post_no_memory(cursor_session_resource);
+		return;
+	}
+
+	cursor_session->resource = cursor_session_resource;
+	wl_resource_set_user_data(cursor_session_resource, cursor_session);
+
+	if (cursor == NULL) {
+		// The cursor is never entered
+		return;
+	}
+
+	cursor_session->cursor = cursor;
+	cursor_session->cursor_update.notify = cursor_session_handle_cursor_update;
+	wl_signal_add(&cursor->events.update, &cursor_session->cursor_update);
+	cursor_session->cursor_destroy.notify = cursor_session_handle_cursor_destroy;
+	wl_signal_add(&cursor->base.events.destroy, &cursor_session->cursor_destroy);
+
+	cursor_session_send_update(cursor_session);
+}
+
+static void manager_handle_destroy(struct wl_client *client,
+		struct wl_resource *manager_resource) {
+	wl_resource_destroy(manager_resource);
+}
+
+static const struct ext_image_copy_capture_manager_v1_interface manager_impl = {
+	.create_session = manager_handle_create_session,
+	.create_pointer_cursor_session = manager_handle_create_pointer_cursor_session,
+	.destroy = manager_handle_destroy,
+};
+
+static void manager_bind(struct wl_client *client, void *data,
+		uint32_t version, uint32_t id) {
+	struct wlr_ext_image_copy_capture_manager_v1 *manager = data;
+
+	struct wl_resource *resource = wl_resource_create(client,
+		&ext_image_copy_capture_manager_v1_interface, version, id);
+	if (resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &manager_impl, manager, NULL);
+}
+
+static void manager_handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_ext_image_copy_capture_manager_v1 *manager =
+		wl_container_of(listener, manager, display_destroy);
+	wl_list_remove(&manager->display_destroy.link);
+	wl_global_destroy(manager->global);
+	free(manager);
+}
+
+struct wlr_ext_image_copy_capture_manager_v1 *wlr_ext_image_copy_capture_manager_v1_create(
+		struct wl_display *display, uint32_t version) {
+	assert(version <= IMAGE_COPY_CAPTURE_MANAGER_V1_VERSION);
+
+	struct wlr_ext_image_copy_capture_manager_v1 *manager = calloc(1, sizeof(*manager));
+	if (manager == NULL) {
+		return NULL;
+	}
+
+	manager->global = wl_global_create(display,
+		&ext_image_copy_capture_manager_v1_interface, version, manager, manager_bind);
+	if (manager->global == NULL) {
+		free(manager);
+		return NULL;
+	}
+
+	manager->display_destroy.notify = manager_handle_display_destroy;
+	wl_display_add_destroy_listener(display, &manager->display_destroy);
+
+	return manager;
+}
@@ -5,6 +5,7 @@
 #include <wlr/types/wlr_foreign_toplevel_management_v1.h>
 #include <wlr/types/wlr_seat.h>
 #include <wlr/util/log.h>
+#include "util/time.h"
 #include "wlr-foreign-toplevel-management-unstable-v1-protocol.h"
 
 #define FOREIGN_TOPLEVEL_MANAGEMENT_V1_VERSION 3
@@ -174,24 +175,153 @@ static const struct zwlr_foreign_toplevel_handle_v1_interface toplevel_handle_im
 	.unset_fullscreen = foreign_toplevel_handle_unset_fullscreen,
 };
 
-static void toplevel_idle_send_done(void *data) {
+static bool str_equal(const char *a, const char *b) {
+	if (a == NULL || b == NULL) {
+		return a == b;
+	}
+	return strcmp(a, b) == 0;
+}
+
+static void update_sent_str(char **sent, const char *value) {
+	free(*sent);
+	*sent = strdup(value);
+	if (*sent == NULL) {
+		wlr_log(WLR_ERROR, "failed to allocate memory for toplevel string");
+	}
+}
+
+static void fill_array_from_toplevel_state(struct wl_array *states,
+		uint32_t data[], uint32_t state, uint32_t version) {
+	size_t nstates = 0;
+	if (state & WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MAXIMIZED) {
+		data[nstates++] = ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MAXIMIZED;
+	}
+	if (state & WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED) {
+		data[nstates++] = ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED;
+	}
+	if (state & WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_ACTIVATED) {
+		data[nstates++] = ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_ACTIVATED;
+	}
+	if (version >= ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN_SINCE_VERSION
+			&& (state & WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN)) {
+		data[nstates++] = ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN;
+	}
+	assert(nstates <= FOREIGN_TOPLEVEL_HANDLE_V1_STATE_COUNT);
+
+	*states = (struct wl_array){
+		.data = data,
+		.size = nstates * sizeof(data[0])
+	};
+}
+
+static void toplevel_update_idle_source(
+	struct wlr_foreign_toplevel_handle_v1 *toplevel);
+
+static int toplevel_handle_title_timer(void *data) {
 	struct wlr_foreign_toplevel_handle_v1 *toplevel = data;
+	toplevel_update_idle_source(toplevel);
+	return 0;
+}
+
+// Returns true if the title can be sent now, otherwise arms the title timer
+static bool toplevel_title_rate_check(
+		struct wlr_foreign_toplevel_handle_v1 *toplevel) {
+	if (toplevel->title_max_rate == 0 || toplevel->sent_title == NULL) {
+		return true;
+	}
+
+	int64_t interval_msec = 1000 / toplevel->title_max_rate;
+	int64_t elapsed_msec = get_current_time_msec() - toplevel->title_sent_msec;
+	if (elapsed_msec >= interval_msec) {
+		return true;
+	}
+
+	if (toplevel->title_timer == NULL) {
+		toplevel->title_timer = wl_event_loop_add_timer(
+			toplevel->manager->event_loop, toplevel_handle_title_timer, toplevel);
+		if (toplevel->title_timer == NULL) {
+			return true;
+		}
+	}
+	wl_event_source_timer_update(toplevel->title_timer,
+		interval_msec - elapsed_msec);
+	return false;
+}
+
+static void toplevel_flush(struct wlr_foreign_toplevel_handle_v1 *toplevel) {
+	bool changed = toplevel->needs_done;
+	toplevel->needs_done = false;
+
 	struct wl_resource *resource;
+	if (toplevel->title != NULL &&
+			!str_equal(toplevel->title, toplevel->sent_title) &&
+			toplevel_title_rate_check(toplevel)) {
+		wl_resource_for_each(resource, &toplevel->resources) {
+			zwlr_foreign_toplevel_handle_v1_send_title(resource, toplevel->title);
+		}
+		update_sent_str(&toplevel->sent_title, toplevel->title);
+		toplevel->title_sent_msec = get_current_time_msec();
+		changed = true;
+	}
+
+	if (toplevel->app_id != NULL &&
+			!str_equal(toplevel->app_id, toplevel->sent_app_id)) {
+		wl_resource_for_each(resource, &toplevel->resources) {
+			zwlr_foreign_toplevel_handle_v1_send_app_id(resource, toplevel->app_id);
+		}
+		update_sent_str(&toplevel->sent_app_id, toplevel->app_id);
+		changed = true;
+	}
+
+	if (toplevel->state != toplevel->sent_state) {
+		struct wl_array state_array;
+		uint32_t states[FOREIGN_TOPLEVEL_HANDLE_V1_STATE_COUNT];
+		wl_resource_for_each(resource, &toplevel->resources) {
+			fill_array_from_toplevel_state(&state_array, states,
+				toplevel->state, wl_resource_get_version(resource));
+			zwlr_foreign_toplevel_handle_v1_send_state(resource, &state_array);
+		}
+		toplevel->sent_state = toplevel->state;
+		changed = true;
+	}
+
+	if (!changed) {
+		return;
+	}
 	wl_resource_for_each(resource, &toplevel->resources) {
 		zwlr_foreign_toplevel_handle_v1_send_done(resource);
 	}
+}
 
-	toplevel->idle_source = NULL;
+static void manager_idle_flush(void *data) {
+	struct wlr_foreign_toplevel_manager_v1 *manager = data;
+	manager->idle_source = NULL;
+
+	struct wlr_foreign_toplevel_handle_v1 *toplevel, *tmp;
+	wl_list_for_each_safe(toplevel, tmp, &manager->dirty_toplevels, dirty_link) {
+		wl_list_remove(&toplevel->dirty_link);
+		wl_list_init(&toplevel->dirty_link);
+		toplevel_flush(toplevel);
+	}
 }
 
+/**
+ * Changes to all toplevels are flushed at once from a single idle source,
+ * with only the fields which differ from what was last sent.
+ */
 static void toplevel_update_idle_source(
 	struct wlr_foreign_toplevel_handle_v1 *toplevel) {
-	if (toplevel->idle_source) {
+	struct wlr_foreign_toplevel_manager_v1 *manager = toplevel->manager;
+	if (wl_list_empty(&toplevel->dirty_link)) {
+		wl_list_insert(manager->dirty_toplevels.prev, &toplevel->dirty_link);
+	}
+
+	if (manager->idle_source) {
 		return;
 	}
 
-	toplevel->idle_source = wl_event_loop_add_idle(toplevel->manager->event_loop,
-		toplevel_idle_send_done, toplevel);
+	manager->idle_source = wl_event_loop_add_idle(manager->event_loop,
+		manager_idle_flush, manager);
 }
 
 void wlr_foreign_toplevel_handle_v1_set_title(
@@ -203,14 +333,19 @@ void wlr_foreign_toplevel_handle_v1_set_title(
 		return;
 	}
 
-	struct wl_resource *resource;
-	wl_resource_for_each(resource, &toplevel->resources) {
-		zwlr_foreign_toplevel_handle_v1_send_title(resource, title);
-	}
-
 	toplevel_update_idle_source(toplevel);
 }
 
+void wlr_foreign_toplevel_handle_v1_set_title_rate_limit(
+		struct wlr_foreign_toplevel_handle_v1 *toplevel, uint32_t max_rate) {
+	toplevel->title_max_rate = max_rate;
+	if (max_rate == 0 && toplevel->title_timer != NULL) {
+		// Send any held back title right away
+		wl_event_source_timer_update(toplevel->title_timer, 0);
+		toplevel_update_idle_source(toplevel);
+	}
+}
+
 void wlr_foreign_toplevel_handle_v1_set_app_id(
 		struct wlr_foreign_toplevel_handle_v1 *toplevel, const char *app_id) {
 	free(toplevel->app_id);
@@ -220,11 +355,6 @@ void wlr_foreign_toplevel_handle_v1_set_app_id(
 		return;
 	}
 
-	struct wl_resource *resource;
-	wl_resource_for_each(resource, &toplevel->resources) {
-		zwlr_foreign_toplevel_handle_v1_send_app_id(resource, app_id);
-	}
-
 	toplevel_update_idle_source(toplevel);
 }
 
@@ -253,6 +383,7 @@ static void toplevel_send_output(struct wlr_foreign_toplevel_handle_v1 *toplevel
 		send_output_to_resource(resource, output, enter);
 	}
 
+	toplevel->needs_done = true;
 	toplevel_update_idle_source(toplevel);
 }
 
@@ -270,6 +401,7 @@ static void toplevel_handle_output_bind(struct wl_listener *listener,
 		}
 	}
 
+	toplevel_output->toplevel->needs_done = true;
 	toplevel_update_idle_source(toplevel_output->toplevel);
 }
 
@@ -339,43 +471,6 @@ void wlr_foreign_toplevel_handle_v1_output_leave(
 	}
 }
 
-static void fill_array_from_toplevel_state(struct wl_array *states,
-		uint32_t data[], uint32_t state, uint32_t version) {
-	size_t nstates = 0;
-	if (state & WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MAXIMIZED) {
-		data[nstates++] = ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MAXIMIZED;
-	}
-	if (state & WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED) {
-		data[nstates++] = ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED;
-	}
-	if (state & WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_ACTIVATED) {
-		data[nstates++] = ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_ACTIVATED;
-	}
-	if (version >= ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN_SINCE_VERSION
-			&& (state & WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN)) {
-		data[nstates++] = ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN;
-	}
-	assert(nstates <= FOREIGN_TOPLEVEL_HANDLE_V1_STATE_COUNT);
-
-	*states = (struct wl_array){
-		.data = data,
-		.size = nstates * sizeof(data[0])
-	};
-}
-
-static void toplevel_send_state(struct wlr_foreign_toplevel_handle_v1 *toplevel) {
-	struct wl_array state_array;
-	uint32_t states[FOREIGN_TOPLEVEL_HANDLE_V1_STATE_COUNT];
-
-	struct wl_resource *resource;
-	wl_resource_for_each(resource, &toplevel->resources) {
-		fill_array_from_toplevel_state(&state_array, states,
-			toplevel->state, wl_resource_get_version(resource));
-		zwlr_foreign_toplevel_handle_v1_send_state(resource, &state_array);
-	}
-	toplevel_update_idle_source(toplevel);
-}
-
 static void set_state(struct wlr_foreign_toplevel_handle_v1 *toplevel,
 		bool new_state_val, enum wlr_foreign_toplevel_handle_v1_state state) {
 	if (new_state_val == !!(toplevel->state & state)) {
@@ -386,7 +481,7 @@ static void set_state(struct wlr_foreign_toplevel_handle_v1 *toplevel,
 	} else {
 		toplevel->state &= ~state;
 	}
-	toplevel_send_state(toplevel);
+	toplevel_update_idle_source(toplevel);
 }
 
 void wlr_foreign_toplevel_handle_v1_set_maximized(
@@ -441,6 +536,7 @@ void wlr_foreign_toplevel_handle_v1_set_parent(
 		toplevel_resource_send_parent(toplevel_resource, parent);
 	}
 	toplevel->parent = parent;
+	toplevel->needs_done = true;
 	toplevel_update_idle_source(toplevel);
 }
 
@@ -465,10 +561,6 @@ void wlr_foreign_toplevel_handle_v1_destroy(
 		toplevel_output_destroy(toplevel_output);
 	}
 
-	if (toplevel->idle_source) {
-		wl_event_source_remove(toplevel->idle_source);
-	}
-
 	wl_list_remove(&toplevel->link);
 
 	/* need to ensure no other toplevels hold a pointer to this one as
@@ -484,8 +576,15 @@ void wlr_foreign_toplevel_handle_v1_destroy(
 		}
 	}
 
+	wl_list_remove(&toplevel->dirty_link);
+	if (toplevel->title_timer) {
+		wl_event_source_remove(toplevel->title_timer);
+	}
+
 	free(toplevel->title);
 	free(toplevel->app_id);
+	free(toplevel->sent_title);
+	free(toplevel->sent_app_id);
 	free(toplevel);
 }
 
@@ -526,6 +625,7 @@ wlr_foreign_toplevel_handle_v1_create(
 
 	wl_list_init(&toplevel->resources);
 	wl_list_init(&toplevel->outputs);
+	wl_list_init(&toplevel->dirty_link);
 
 	wl_signal_init(&toplevel->events.request_maximize);
 	wl_signal_init(&toplevel->events.request_minimize);
@@ -627,6 +727,9 @@ static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_foreign_toplevel_manager_v1 *manager =
 		wl_container_of(listener, manager, display_destroy);
 	wl_signal_emit_mutable(&manager->events.destroy, manager);
+	if (manager->idle_source) {
+		wl_event_source_remove(manager->idle_source);
+	}
 	wl_list_remove(&manager->display_destroy.link);
 	wl_global_destroy(manager->global);
 	free(manager);
@@ -652,6 +755,7 @@ struct wlr_foreign_toplevel_manager_v1 *wlr_foreign_toplevel_manager_v1_create(
 	wl_signal_init(&manager->events.destroy);
 	wl_list_init(&manager->resources);
 	wl_list_init(&manager->toplevels);
+	wl_list_init(&manager->dirty_toplevels);
 
 	manager->display_destroy.notify = handle_display_destroy;
 	wl_display_add_destroy_listener(display, &manager->display_destroy);
@@ -3,23 +3,44 @@
 #include <wlr/types/wlr_idle_notify_v1.h>
 #include <wlr/types/wlr_seat.h>
 #include "ext-idle-notify-v1-protocol.h"
+#include "util/time.h"
 
 #define IDLE_NOTIFIER_VERSION 1
 
-struct wlr_idle_notification_v1 {
-	struct wl_resource *resource;
-	struct wl_list link; // wlr_idle_notifier_v1.notifications
+/**
+ * Idle state of a seat. All notifications of a seat share the time of the
+ * last activity, so a single timer armed for the earliest pending deadline
+ * is enough.
+ */
+struct wlr_idle_notifier_v1_seat {
 	struct wlr_idle_notifier_v1 *notifier;
 	struct wlr_seat *seat;
+	struct wl_list link; // wlr_idle_notifier_v1.seats
 
-	uint32_t timeout_ms;
-	struct wl_event_source *timer;
+	struct wl_list notifications; // wlr_idle_notification_v1.link
+	size_t num_idle;
 
-	bool idle;
+	// The timer may be armed for a deadline computed from an older
+	// activity, in which case it re-arms itself when it fires
+	int64_t last_activity_ms;
+	struct wl_event_source *timer;
 
 	struct wl_listener seat_destroy;
 };
 
+struct wlr_idle_notification_v1 {
+	struct wl_resource *resource;
+	struct wl_list link; // wlr_idle_notifier_v1_seat.notifications
+	struct wlr_idle_notifier_v1_seat *idle_seat;
+
+	uint32_t timeout_ms;
+	// The timeout starts from the last activity or from the creation of the
+	// notification, whichever comes last
+	int64_t created_ms;
+
+	bool idle;
+};
+
 static void resource_handle_destroy(struct wl_client *client,
 		struct wl_resource *resource) {
 	wl_resource_destroy(resource);
@@ -54,59 +75,151 @@ static void notification_set_idle(struct wlr_idle_notification_v1 *notification,
 
 	if (idle) {
 		ext_idle_notification_v1_send_idled(notification->resource);
+		notification->idle_seat->num_idle++;
 	} else {
 		ext_idle_notification_v1_send_resumed(notification->resource);
+		notification->idle_seat->num_idle--;
 	}
 
 	notification->idle = idle;
 }
 
-static int notification_handle_timer(void *data) {
-	struct wlr_idle_notification_v1 *notification = data;
-	notification_set_idle(notification, true);
+/**
+ * Mark the notifications whose deadline has passed as idle, and arm the
+ * timer for the next deadline.
+ */
+static void idle_seat_update(struct wlr_idle_notifier_v1_seat *idle_seat,
+		int64_t now_ms) {
+	if (idle_seat->notifier->inhibited) {
+		wl_event_source_timer_update(idle_seat->timer, 0);
+		return;
+	}
+
+	int64_t next_deadline_ms = -1;
+	struct wlr_idle_notification_v1 *notification;
+	wl_list_for_each(notification, &idle_seat->notifications, link) {
+		if (notification->idle) {
+			continue;
+		}
+		int64_t start_ms = idle_seat->last_activity_ms;
+		if (notification->created_ms > start_ms) {
+			start_ms = notification->created_ms;
+		}
+		int64_t deadline_ms = start_ms + notification->timeout_ms;
+		if (deadline_ms > now_ms) {
+			if (next_deadline_ms < 0 || deadline_ms < next_deadline_ms) {
+				next_deadline_ms = deadline_ms;
+			}
+			continue;
+		}
+		notification_set_idle(notification, true);
+	}
+
+	int delay_ms = next_deadline_ms >= 0 ? next_deadline_ms - now_ms : 0;
+	wl_event_source_timer_update(idle_seat->timer, delay_ms);
+}
+
+static int idle_seat_handle_timer(void *data) {
+	struct wlr_idle_notifier_v1_seat *idle_seat = data;
+	idle_seat_update(idle_seat, get_current_time_msec());
 	return 0;
 }
 
-static void notification_destroy(struct wlr_idle_notification_v1 *notification) {
-	if (notification == NULL) {
+static void idle_seat_reset(struct wlr_idle_notifier_v1_seat *idle_seat) {
+	int64_t now_ms = get_current_time_msec();
+	idle_seat->last_activity_ms = now_ms;
+
+	struct wlr_idle_notification_v1 *notification;
+	wl_list_for_each(notification, &idle_seat->notifications, link) {
+		notification_set_idle(notification, false);
+	}
+
+	idle_seat_update(idle_seat, now_ms);
+}
+
+static void idle_seat_handle_activity(struct wlr_idle_notifier_v1_seat *idle_seat) {
+	// Activity only postpones the deadlines: unless a notification needs
+	// to resume, the armed timer will pick up the new activity time when
+	// it fires
+	if (idle_seat->num_idle == 0) {
+		idle_seat->last_activity_ms = get_current_time_msec();
 		return;
 	}
-	wl_list_remove(&notification->link);
-	wl_list_remove(&notification->seat_destroy.link);
-	if (notification->timer != NULL) {
-		wl_event_source_remove(notification->timer);
+
+	idle_seat_reset(idle_seat);
+}
+
+static void notification_finish(struct wlr_idle_notification_v1 *notification) {
+	if (notification->idle) {
+		notification->idle_seat->num_idle--;
 	}
+	wl_list_remove(&notification->link);
 	wl_resource_set_user_data(notification->resource, NULL); // make inert
 	free(notification);
 }
 
-static void notification_reset_timer(struct wlr_idle_notification_v1 *notification) {
-	if (notification->notifier->inhibited) {
-		notification_set_idle(notification, false);
-		if (notification->timer != NULL) {
-			wl_event_source_timer_update(notification->timer, 0);
+static void idle_seat_destroy(struct wlr_idle_notifier_v1_seat *idle_seat) {
+	struct wlr_idle_notification_v1 *notification, *tmp;
+	wl_list_for_each_safe(notification, tmp, &idle_seat->notifications, link) {
+		notification_finish(notification);
+	}
+
+	wl_list_remove(&idle_seat->link);
+	wl_list_remove(&idle_seat->seat_destroy.link);
+	wl_event_source_remove(idle_seat->timer);
+	free(idle_seat);
+}
+
+static void idle_seat_handle_seat_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_idle_notifier_v1_seat *idle_seat =
+		wl_container_of(listener, idle_seat, seat_destroy);
+	idle_seat_destroy(idle_seat);
+}
+
+static struct wlr_idle_notifier_v1_seat *idle_seat_get_or_create(
+		struct wlr_idle_notifier_v1 *notifier, struct wlr_seat *seat) {
+	struct wlr_idle_notifier_v1_seat *idle_seat;
+	wl_list_for_each(idle_seat, &notifier->seats, link) {
+		if (idle_seat->seat == seat) {
+			return idle_seat;
 		}
-		return;
 	}
 
-	if (notification->timer != NULL) {
-		wl_event_source_timer_update(notification->timer,
-			notification->timeout_ms);
-	} else {
-		notification_set_idle(notification, true);
+	idle_seat = calloc(1, sizeof(*idle_seat));
+	if (idle_seat == NULL) {
+		return NULL;
 	}
-}
 
-static void notification_handle_activity(struct wlr_idle_notification_v1 *notification) {
-	notification_set_idle(notification, false);
-	notification_reset_timer(notification);
+	idle_seat->timer = wl_event_loop_add_timer(notifier->event_loop,
+		idle_seat_handle_timer, idle_seat);
+	if (idle_seat->timer == NULL) {
+		free(idle_seat);
+		return NULL;
+	}
+
+	idle_seat->notifier = notifier;
+	idle_seat->seat = seat;
+	idle_seat->last_activity_ms = get_current_time_msec();
+	wl_list_init(&idle_seat->notifications);
+
+	idle_seat->seat_destroy.notify = idle_seat_handle_seat_destroy;
+	wl_signal_add(&seat->events.destroy, &idle_seat->seat_destroy);
+
+	wl_list_insert(&notifier->seats, &idle_seat->link);
+	return idle_seat;
 }
 
-static void notification_handle_seat_destroy(struct wl_listener *listener,
-		void *data) {
-	struct wlr_idle_notification_v1 *notification =
-		wl_container_of(listener, notification, seat_destroy);
-	notification_destroy(notification);
+static void notification_destroy(struct wlr_idle_notification_v1 *notification) {
+	if (notification == NULL) {
+		return;
+	}
+
+	struct wlr_idle_notifier_v1_seat *idle_seat = notification->idle_seat;
+	notification_finish(notification);
+	if (wl_list_empty(&idle_seat->notifications)) {
+		idle_seat_destroy(idle_seat);
+	}
 }
 
 static void notification_handle_resource_destroy(struct wl_resource *resource) {
@@ -137,37 +250,33 @@ static void notifier_handle_get_idle_notification(struct wl_client *client,
 		return; // leave the resource inert
 	}
 
+	struct wlr_idle_notifier_v1_seat *idle_seat =
+		idle_seat_get_or_create(notifier, seat_client->seat);
+	if (idle_seat == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+
 	struct wlr_idle_notification_v1 *notification =
 		calloc(1, sizeof(*notification));
 	if (notification == NULL) {
+		if (wl_list_empty(&idle_seat->notifications)) {
+			idle_seat_destroy(idle_seat);
+		}
 		wl_client_post_no_memory(client);
 		return;
 	}
 
-	notification->notifier = notifier;
+	int64_t now_ms = get_current_time_msec();
+	notification->idle_seat = idle_seat;
 	notification->resource = resource;
 	notification->timeout_ms = timeout;
-	notification->seat = seat_client->seat;
-
-	if (timeout > 0) {
-		struct wl_display *display = wl_client_get_display(client);
-		struct wl_event_loop *loop = wl_display_get_event_loop(display);
-		notification->timer = wl_event_loop_add_timer(loop,
-			notification_handle_timer, notification);
-		if (notification->timer == NULL) {
-			free(notification);
-			wl_client_post_no_memory(client);
-			return;
-		}
-	}
-
-	notification->seat_destroy.notify = notification_handle_seat_destroy;
-	wl_signal_add(&seat_client->seat->events.destroy, &notification->seat_destroy);
+	notification->created_ms = now_ms;
 
 	wl_resource_set_user_data(resource, notification);
-	wl_list_insert(&notifier->notifications, &notification->link);
+	wl_list_insert(&idle_seat->notifications, &notification->link);
 
-	notification_reset_timer(notification);
+	idle_seat_update(idle_seat, now_ms);
 }
 
 static const struct ext_idle_notifier_v1_interface notifier_impl = {
@@ -209,7 +318,8 @@ struct wlr_idle_notifier_v1 *wlr_idle_notifier_v1_create(struct wl_display *disp
 		return NULL;
 	}
 
-	wl_list_init(&notifier->notifications);
+	wl_list_init(&notifier->seats);
+	notifier->event_loop = wl_display_get_event_loop(display);
 
 	notifier->display_destroy.notify = handle_display_destroy;
 	wl_display_add_destroy_listener(display, &notifier->display_destroy);
@@ -225,9 +335,10 @@ void wlr_idle_notifier_v1_set_inhibited(struct wlr_idle_notifier_v1 *notifier,
 
 	notifier->inhibited = inhibited;
 
-	struct wlr_idle_notification_v1 *notification;
-	wl_list_for_each(notification, &notifier->notifications, link) {
-		notification_reset_timer(notification);
+	// Lifting the inhibition restarts the timeouts, like activity does
+	struct wlr_idle_notifier_v1_seat *idle_seat;
+	wl_list_for_each(idle_seat, &notifier->seats, link) {
+		idle_seat_reset(idle_seat);
 	}
 }
 
@@ -237,10 +348,11 @@ void wlr_idle_notifier_v1_notify_activity(struct wlr_idle_notifier_v1 *notifier,
 		return;
 	}
 
-	struct wlr_idle_notification_v1 *notification;
-	wl_list_for_each(notification, &notifier->notifications, link) {
-		if (notification->seat == seat) {
-			notification_handle_activity(notification);
+	struct wlr_idle_notifier_v1_seat *idle_seat;
+	wl_list_for_each(idle_seat, &notifier->seats, link) {
+		if (idle_seat->seat == seat) {
+			idle_seat_handle_activity(idle_seat);
+			break;
 		}
 	}
 }
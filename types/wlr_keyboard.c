@@ -142,17 +142,120 @@ void wlr_keyboard_init(struct wlr_keyboard *kb,
 	wl_signal_init(&kb->events.repeat_info);
 }
 
+struct wlr_keyboard_keymap_file {
+	struct xkb_keymap *keymap; // last keymap resolved to this file
+	char *string;
+	size_t size;
+	int fd; // read-only
+	size_t refcount;
+	struct wl_list link; // keymap_files
+};
+
+// Keyboard groups and virtual keyboards usually share the same keymap: keep a
+// single serialized copy and read-only file for all of them
+static struct wl_list keymap_files = { &keymap_files, &keymap_files };
+
+static struct wlr_keyboard_keymap_file *keymap_file_create(char *string,
+		size_t size) {
+	struct wlr_keyboard_keymap_file *file = calloc(1, sizeof(*file));
+	if (file == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	int rw_fd = -1, ro_fd = -1;
+	if (!allocate_shm_file_pair(size, &rw_fd, &ro_fd)) {
+		wlr_log(WLR_ERROR, "Failed to allocate shm file for keymap");
+		free(file);
+		return NULL;
+	}
+
+	void *dst = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, rw_fd, 0);
+	close(rw_fd);
+	if (dst == MAP_FAILED) {
+		wlr_log_errno(WLR_ERROR, "mmap failed");
+		close(ro_fd);
+		free(file);
+		return NULL;
+	}
+
+	memcpy(dst, string, size);
+	munmap(dst, size);
+
+	file->string = string;
+	file->size = size;
+	file->fd = ro_fd;
+	wl_list_insert(&keymap_files, &file->link);
+	return file;
+}
+
+static struct wlr_keyboard_keymap_file *keymap_file_acquire(
+		struct xkb_keymap *keymap) {
+	struct wlr_keyboard_keymap_file *file;
+	wl_list_for_each(file, &keymap_files, link) {
+		if (file->keymap == keymap) {
+			file->refcount++;
+			return file;
+		}
+	}
+
+	char *string = xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
+	if (string == NULL) {
+		wlr_log(WLR_ERROR, "Failed to get string version of keymap");
+		return NULL;
+	}
+	size_t size = strlen(string) + 1;
+
+	bool found = false;
+	wl_list_for_each(file, &keymap_files, link) {
+		if (file->size == size && memcmp(file->string, string, size) == 0) {
+			found = true;
+			break;
+		}
+	}
+	if (found) {
+		free(string);
+	} else {
+		file = keymap_file_create(string, size);
+		if (file == NULL) {
+			free(string);
+			return NULL;
+		}
+	}
+
+	xkb_keymap_unref(file->keymap);
+	file->keymap = xkb_keymap_ref(keymap);
+	file->refcount++;
+	return file;
+}
+
+static void keymap_file_release(struct wlr_keyboard_keymap_file *file) {
+	if (file == NULL) {
+		return;
+	}
+
+	assert(file->refcount > 0);
+	file->refcount--;
+	if (file->refcount > 0) {
+		return;
+	}
+
+	wl_list_remove(&file->link);
+	xkb_keymap_unref(file->keymap);
+	free(file->string);
+	close(file->fd);
+	free(file);
+}
+
 static void keyboard_unset_keymap(struct wlr_keyboard *kb) {
 	xkb_keymap_unref(kb->keymap);
 	kb->keymap = NULL;
 	xkb_state_unref(kb->xkb_state);
 	kb->xkb_state = NULL;
-	free(kb->keymap_string);
+	keymap_file_release(kb->keymap_file);
+	kb->keymap_file = NULL;
 	kb->keymap_string = NULL;
 	kb->keymap_size = 0;
-	if (kb->keymap_fd >= 0) {
-		close(kb->keymap_fd);
-	}
 	kb->keymap_fd = -1;
 }
 
@@ -199,36 +302,19 @@ bool wlr_keyboard_set_keymap(struct wlr_keyboard *kb, struct xkb_keymap *keymap)
 		return false;
 	}
 
-	char *keymap_str = xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
-	if (keymap_str == NULL) {
-		wlr_log(WLR_ERROR, "Failed to get string version of keymap");
-		goto error_xkb_state;
-	}
-	size_t keymap_size = strlen(keymap_str) + 1;
-
-	int rw_fd = -1, ro_fd = -1;
-	if (!allocate_shm_file_pair(keymap_size, &rw_fd, &ro_fd)) {
-		wlr_log(WLR_ERROR, "Failed to allocate shm file for keymap");
-		goto error_keymap_str;
-	}
-
-	void *dst = mmap(NULL, keymap_size, PROT_READ | PROT_WRITE, MAP_SHARED, rw_fd, 0);
-	close(rw_fd);
-	if (dst == MAP_FAILED) {
-		wlr_log_errno(WLR_ERROR, "mmap failed");
-		close(ro_fd);
-		goto error_keymap_str;
+	struct wlr_keyboard_keymap_file *keymap_file = keymap_file_acquire(keymap);
+	if (keymap_file == NULL) {
+		xkb_state_unref(xkb_state);
+		return false;
 	}
 
-	memcpy(dst, keymap_str, keymap_size);
-	munmap(dst, keymap_size);
-
 	keyboard_unset_keymap(kb);
 	kb->keymap = xkb_keymap_ref(keymap);
 	kb->xkb_state = xkb_state;
-	kb->keymap_string = keymap_str;
-	kb->keymap_size = keymap_size;
-	kb->keymap_fd = ro_fd;
+	kb->keymap_file = keymap_file;
+	kb->keymap_string = keymap_file->string;
+	kb->keymap_size = keymap_file->size;
+	kb->keymap_fd = keymap_file->fd;
 
 	const char *led_names[WLR_LED_COUNT] = {
 		XKB_LED_NAME_NUM,
@@ -264,12 +350,6 @@ bool wlr_keyboard_set_keymap(struct wlr_keyboard *kb, struct xkb_keymap *keymap)
 	wl_signal_emit_mutable(&kb->events.keymap, kb);
 
 	return true;
-
-error_keymap_str:
-	free(keymap_str);
-error_xkb_state:
-	xkb_state_unref(xkb_state);
-	return false;
 }
 
 void wlr_keyboard_set_repeat_info(struct wlr_keyboard *kb, int32_t rate,
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <linux/input-event-codes.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
@@ -48,6 +49,13 @@ struct wlr_keyboard_group *wlr_keyboard_group_create(void) {
 		return NULL;
 	}
 
+	group->key_counts = calloc(KEY_CNT, sizeof(group->key_counts[0]));
+	if (!group->key_counts) {
+		wlr_log(WLR_ERROR, "Failed to allocate wlr_keyboard_group key counts");
+		free(group);
+		return NULL;
+	}
+
 	wlr_keyboard_init(&group->keyboard, &impl, "wlr_keyboard_group");
 	wl_list_init(&group->devices);
 	wl_list_init(&group->keys);
@@ -71,6 +79,18 @@ static bool process_key(struct keyboard_group_device *group_device,
 		struct wlr_keyboard_key_event *event) {
 	struct wlr_keyboard_group *group = group_device->keyboard->group;
 
+	if (event->keycode < KEY_CNT) {
+		uint16_t *count = &group->key_counts[event->keycode];
+		if (event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+			return (*count)++ == 0;
+		}
+		if (*count == 0) {
+			return true;
+		}
+		return --(*count) == 0;
+	}
+
+	// Keycodes outside of the evdev range are tracked in a list
 	struct keyboard_group_key *key, *tmp;
 	wl_list_for_each_safe(key, tmp, &group->keys, link) {
 		if (key->keycode != event->keycode) {
@@ -180,12 +200,14 @@ static void handle_keyboard_repeat_info(struct wl_listener *listener,
 
 static void refresh_state(struct keyboard_group_device *device,
 		enum wl_keyboard_key_state state) {
+	struct wlr_keyboard *group_kb = &device->keyboard->group->keyboard;
 	struct wl_array keys;
 	wl_array_init(&keys);
 
+	int64_t time_msec = get_current_time_msec();
 	for (size_t i = 0; i < device->keyboard->num_keycodes; i++) {
 		struct wlr_keyboard_key_event event = {
-			.time_msec = get_current_time_msec(),
+			.time_msec = time_msec,
 			.keycode = device->keyboard->keycodes[i],
 			.update_state = true,
 			.state = state
@@ -195,9 +217,7 @@ static void refresh_state(struct keyboard_group_device *device,
 		// key that needs to be passed on to the compositor
 		if (process_key(device, &event)) {
 			// Update state for wlr_keyboard_group's keyboard
-			keyboard_key_update(&device->keyboard->group->keyboard, &event);
-			keyboard_modifier_update(&device->keyboard->group->keyboard);
-			keyboard_led_update(&device->keyboard->group->keyboard);
+			keyboard_key_update(group_kb, &event);
 
 			// Add the key to the array
 			uint32_t *key = wl_array_add(&keys, sizeof(uint32_t));
@@ -207,6 +227,10 @@ static void refresh_state(struct keyboard_group_device *device,
 
 	// If there are any unique keys, emit the enter/leave event
 	if (keys.size > 0) {
+		// The modifiers and LEDs only need to be derived from the final state
+		keyboard_modifier_update(group_kb);
+		keyboard_led_update(group_kb);
+
 		if (state == WL_KEYBOARD_KEY_STATE_PRESSED) {
 			wl_signal_emit_mutable(&device->keyboard->group->events.enter, &keys);
 		} else {
@@ -313,5 +337,6 @@ void wlr_keyboard_group_destroy(struct wlr_keyboard_group *group) {
 	wlr_keyboard_finish(&group->keyboard);
 	wl_list_remove(&group->events.enter.listener_list);
 	wl_list_remove(&group->events.leave.listener_list);
+	free(group->key_counts);
 	free(group);
 }
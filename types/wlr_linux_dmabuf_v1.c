@@ -2,7 +2,9 @@
 #include <drm_fourcc.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <wlr/backend.h>
 #include <wlr/config.h>
@@ -23,6 +25,16 @@
 
 #define LINUX_DMABUF_VERSION 5
 
+// A DMA-BUF which has been successfully imported into the main device. It's
+// kept around while buffers reference it: this keeps the DMA-BUF alive, so
+// that its inode can't be re-used for another DMA-BUF.
+struct wlr_linux_dmabuf_v1_checked_dmabuf {
+	dev_t dev;
+	ino_t ino;
+	size_t n_refs;
+	struct wl_list link; // wlr_linux_dmabuf_v1.checked_dmabufs, empty if orphaned
+};
+
 struct wlr_linux_buffer_params_v1 {
 	struct wl_resource *resource;
 	struct wlr_linux_dmabuf_v1 *linux_dmabuf;
@@ -34,6 +46,8 @@ struct wlr_linux_dmabuf_feedback_v1_compiled_tranche {
 	dev_t target_device;
 	uint32_t flags; // bitfield of enum zwp_linux_dmabuf_feedback_v1_tranche_flags
 	struct wl_array indices; // uint16_t
+	// Formats the tranche was compiled from, to look up compiled feedbacks
+	struct wlr_drm_format_set formats;
 };
 
 struct wlr_linux_dmabuf_feedback_v1_compiled {
@@ -41,6 +55,9 @@ struct wlr_linux_dmabuf_feedback_v1_compiled {
 	int table_fd;
 	size_t table_size;
 
+	size_t n_refs;
+	struct wl_list link; // wlr_linux_dmabuf_v1.compiled_feedbacks
+
 	size_t tranches_len;
 	struct wlr_linux_dmabuf_feedback_v1_compiled_tranche tranches[];
 };
@@ -97,11 +114,27 @@ static struct wlr_dmabuf_v1_buffer *dmabuf_v1_buffer_from_buffer(
 	return buffer;
 }
 
+static void checked_dmabuf_unref(struct wlr_linux_dmabuf_v1_checked_dmabuf *checked) {
+	if (checked == NULL) {
+		return;
+	}
+	assert(checked->n_refs > 0);
+	checked->n_refs--;
+	if (checked->n_refs == 0) {
+		wl_list_remove(&checked->link);
+		free(checked);
+	}
+}
+
 static void buffer_destroy(struct wlr_buffer *wlr_buffer) {
 	struct wlr_dmabuf_v1_buffer *buffer =
 		dmabuf_v1_buffer_from_buffer(wlr_buffer);
 	wl_list_remove(&buffer->release.link);
 
+	for (size_t i = 0; i < WLR_DMABUF_MAX_PLANES; i++) {
+		checked_dmabuf_unref(buffer->checked[i]);
+	}
+
 	wlr_buffer_finish(wlr_buffer);
 
 	if (buffer->resource != NULL) {
@@ -205,6 +238,20 @@ static void buffer_handle_resource_destroy(struct wl_resource *buffer_resource)
 	wlr_buffer_drop(&buffer->base);
 }
 
+static bool check_import_dmabuf_plane(struct wlr_linux_dmabuf_v1 *linux_dmabuf,
+		int fd, int plane) {
+	uint32_t handle = 0;
+	if (drmPrimeFDToHandle(linux_dmabuf->main_device_fd, fd, &handle) != 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to import DMA-BUF FD for plane %d", plane);
+		return false;
+	}
+	if (drmCloseBufferHandle(linux_dmabuf->main_device_fd, handle) != 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to close buffer handle for plane %d", plane);
+		return false;
+	}
+	return true;
+}
+
 static bool check_import_dmabuf(struct wlr_dmabuf_attributes *attribs, void *data) {
 	struct wlr_linux_dmabuf_v1 *linux_dmabuf = data;
 
@@ -214,17 +261,72 @@ static bool check_import_dmabuf(struct wlr_dmabuf_attributes *attribs, void *dat
 
 	// TODO: check number of planes
 	for (int i = 0; i < attribs->n_planes; i++) {
-		uint32_t handle = 0;
-		if (drmPrimeFDToHandle(linux_dmabuf->main_device_fd, attribs->fd[i], &handle) != 0) {
-			wlr_log_errno(WLR_ERROR, "Failed to import DMA-BUF FD for plane %d", i);
+		if (!check_import_dmabuf_plane(linux_dmabuf, attribs->fd[i], i)) {
 			return false;
 		}
-		if (drmCloseBufferHandle(linux_dmabuf->main_device_fd, handle) != 0) {
-			wlr_log_errno(WLR_ERROR, "Failed to close buffer handle for plane %d", i);
-			return false;
+	}
+	return true;
+}
+
+/**
+ * Same as check_import_dmabuf(), but skips the import of DMA-BUFs which are
+ * already referenced by a valid buffer. Clients re-creating wl_buffers for the
+ * same DMA-BUF don't pay for the import every time.
+ */
+static bool check_import_dmabuf_cached(struct wlr_linux_dmabuf_v1 *linux_dmabuf,
+		struct wlr_dmabuf_attributes *attribs,
+		struct wlr_linux_dmabuf_v1_checked_dmabuf *checked[static WLR_DMABUF_MAX_PLANES]) {
+	for (int i = 0; i < WLR_DMABUF_MAX_PLANES; i++) {
+		checked[i] = NULL;
+	}
+	if (linux_dmabuf->main_device_fd < 0) {
+		return true;
+	}
+
+	for (int i = 0; i < attribs->n_planes; i++) {
+		struct stat st;
+		if (fstat(attribs->fd[i], &st) != 0) {
+			if (!check_import_dmabuf_plane(linux_dmabuf, attribs->fd[i], i)) {
+				goto error;
+			}
+			continue;
+		}
+
+		struct wlr_linux_dmabuf_v1_checked_dmabuf *entry;
+		bool found = false;
+		wl_list_for_each(entry, &linux_dmabuf->checked_dmabufs, link) {
+			if (entry->dev == st.st_dev && entry->ino == st.st_ino) {
+				found = true;
+				break;
+			}
 		}
+
+		if (!found) {
+			if (!check_import_dmabuf_plane(linux_dmabuf, attribs->fd[i], i)) {
+				goto error;
+			}
+
+			entry = calloc(1, sizeof(*entry));
+			if (entry == NULL) {
+				// The plane is valid, it just can't be cached
+				continue;
+			}
+			entry->dev = st.st_dev;
+			entry->ino = st.st_ino;
+			wl_list_insert(&linux_dmabuf->checked_dmabufs, &entry->link);
+		}
+
+		entry->n_refs++;
+		checked[i] = entry;
 	}
 	return true;
+
+error:
+	for (int i = 0; i < WLR_DMABUF_MAX_PLANES; i++) {
+		checked_dmabuf_unref(checked[i]);
+		checked[i] = NULL;
+	}
+	return false;
 }
 
 static void params_create_common(struct wl_resource *params_resource,
@@ -343,16 +445,23 @@ static void params_create_common(struct wl_resource *params_resource,
 	}
 
 	/* Check if dmabuf is usable */
-	if (!linux_dmabuf->check_dmabuf_callback(&attribs,
-				linux_dmabuf->check_dmabuf_callback_data)) {
+	struct wlr_linux_dmabuf_v1_checked_dmabuf *checked[WLR_DMABUF_MAX_PLANES] = {0};
+	if (linux_dmabuf->check_dmabuf_callback == check_import_dmabuf &&
+			linux_dmabuf->check_dmabuf_callback_data == linux_dmabuf) {
+		if (!check_import_dmabuf_cached(linux_dmabuf, &attribs, checked)) {
+			goto err_failed;
+		}
+	} else if (!linux_dmabuf->check_dmabuf_callback(&attribs,
+			linux_dmabuf->check_dmabuf_callback_data)) {
 		goto err_failed;
 	}
 
 	struct wlr_dmabuf_v1_buffer *buffer = calloc(1, sizeof(*buffer));
 	if (!buffer) {
 		wl_resource_post_no_memory(params_resource);
-		goto err_failed;
+		goto err_checked;
 	}
+	memcpy(buffer->checked, checked, sizeof(checked));
 	wlr_buffer_init(&buffer->base, &buffer_impl, attribs.width, attribs.height);
 
 	struct wl_client *client = wl_resource_get_client(params_resource);
@@ -361,7 +470,7 @@ static void params_create_common(struct wl_resource *params_resource,
 	if (!buffer->resource) {
 		wl_resource_post_no_memory(params_resource);
 		free(buffer);
-		goto err_failed;
+		goto err_checked;
 	}
 	wl_resource_set_implementation(buffer->resource,
 		&wl_buffer_impl, buffer, buffer_handle_resource_destroy);
@@ -380,6 +489,10 @@ static void params_create_common(struct wl_resource *params_resource,
 
 	return;
 
+err_checked:
+	for (size_t i = 0; i < WLR_DMABUF_MAX_PLANES; i++) {
+		checked_dmabuf_unref(checked[i]);
+	}
 err_failed:
 	if (buffer_id == 0) {
 		zwp_linux_buffer_params_v1_send_failed(params_resource);
@@ -591,6 +704,10 @@ static struct wlr_linux_dmabuf_feedback_v1_compiled *feedback_compile(
 			wlr_log(WLR_ERROR, "Failed to allocate tranche indices array");
 			goto error_compiled;
 		}
+		if (!wlr_drm_format_set_copy(&compiled_tranche->formats, &tranche->formats)) {
+			wlr_log(WLR_ERROR, "Failed to copy tranche formats");
+			goto error_compiled;
+		}
 
 		n = 0;
 		uint16_t *indices = compiled_tranche->indices.data;
@@ -618,6 +735,10 @@ static struct wlr_linux_dmabuf_feedback_v1_compiled *feedback_compile(
 	return compiled;
 
 error_compiled:
+	for (size_t i = 0; i < tranches_len; i++) {
+		wl_array_release(&compiled->tranches[i].indices);
+		wlr_drm_format_set_finish(&compiled->tranches[i].formats);
+	}
 	close(compiled->table_fd);
 	free(compiled);
 err_all_formats:
@@ -625,18 +746,89 @@ err_all_formats:
 	return NULL;
 }
 
-static void compiled_feedback_destroy(
+static void compiled_feedback_unref(
 		struct wlr_linux_dmabuf_feedback_v1_compiled *feedback) {
 	if (feedback == NULL) {
 		return;
 	}
+	assert(feedback->n_refs > 0);
+	feedback->n_refs--;
+	if (feedback->n_refs > 0) {
+		return;
+	}
+
+	wl_list_remove(&feedback->link);
 	for (size_t i = 0; i < feedback->tranches_len; i++) {
 		wl_array_release(&feedback->tranches[i].indices);
+		wlr_drm_format_set_finish(&feedback->tranches[i].formats);
 	}
 	close(feedback->table_fd);
 	free(feedback);
 }
 
+static bool drm_format_set_equal(const struct wlr_drm_format_set *a,
+		const struct wlr_drm_format_set *b) {
+	if (a->len != b->len) {
+		return false;
+	}
+	// Formats and modifiers are sorted
+	for (size_t i = 0; i < a->len; i++) {
+		const struct wlr_drm_format *fmt_a = &a->formats[i], *fmt_b = &b->formats[i];
+		if (fmt_a->format != fmt_b->format || fmt_a->len != fmt_b->len ||
+				memcmp(fmt_a->modifiers, fmt_b->modifiers,
+					fmt_a->len * sizeof(fmt_a->modifiers[0])) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool compiled_feedback_matches(
+		const struct wlr_linux_dmabuf_feedback_v1_compiled *compiled,
+		const struct wlr_linux_dmabuf_feedback_v1 *feedback) {
+	const struct wlr_linux_dmabuf_feedback_v1_tranche *tranches = feedback->tranches.data;
+	size_t tranches_len = feedback->tranches.size / sizeof(tranches[0]);
+	if (compiled->main_device != feedback->main_device ||
+			compiled->tranches_len != tranches_len) {
+		return false;
+	}
+	for (size_t i = 0; i < tranches_len; i++) {
+		const struct wlr_linux_dmabuf_feedback_v1_compiled_tranche *compiled_tranche =
+			&compiled->tranches[i];
+		if (compiled_tranche->target_device != tranches[i].target_device ||
+				compiled_tranche->flags != tranches[i].flags ||
+				!drm_format_set_equal(&compiled_tranche->formats, &tranches[i].formats)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Get a reference to the compiled version of a feedback. Compiled feedbacks
+ * are shared by content: surfaces with the same feedback share the format
+ * table.
+ */
+static struct wlr_linux_dmabuf_feedback_v1_compiled *linux_dmabuf_get_compiled_feedback(
+		struct wlr_linux_dmabuf_v1 *linux_dmabuf,
+		const struct wlr_linux_dmabuf_feedback_v1 *feedback) {
+	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled;
+	wl_list_for_each(compiled, &linux_dmabuf->compiled_feedbacks, link) {
+		if (compiled_feedback_matches(compiled, feedback)) {
+			compiled->n_refs++;
+			return compiled;
+		}
+	}
+
+	compiled = feedback_compile(feedback);
+	if (compiled == NULL) {
+		return NULL;
+	}
+	compiled->n_refs = 1;
+	wl_list_insert(&linux_dmabuf->compiled_feedbacks, &compiled->link);
+	return compiled;
+}
+
 static void feedback_tranche_send(
 		const struct wlr_linux_dmabuf_feedback_v1_compiled_tranche *tranche,
 		struct wl_resource *resource) {
@@ -695,7 +887,7 @@ static void surface_destroy(struct wlr_linux_dmabuf_v1_surface *surface) {
 		wl_list_init(link);
 	}
 
-	compiled_feedback_destroy(surface->feedback);
+	compiled_feedback_unref(surface->feedback);
 
 	wlr_addon_finish(&surface->addon);
 	wl_list_remove(&surface->link);
@@ -864,7 +1056,15 @@ static void linux_dmabuf_v1_destroy(struct wlr_linux_dmabuf_v1 *linux_dmabuf) {
 		surface_destroy(surface);
 	}
 
-	compiled_feedback_destroy(linux_dmabuf->default_feedback);
+	// Buffers may outlive the global, they free the entries once unused
+	struct wlr_linux_dmabuf_v1_checked_dmabuf *checked, *checked_tmp;
+	wl_list_for_each_safe(checked, checked_tmp, &linux_dmabuf->checked_dmabufs, link) {
+		wl_list_remove(&checked->link);
+		wl_list_init(&checked->link);
+	}
+
+	compiled_feedback_unref(linux_dmabuf->default_feedback);
+	assert(wl_list_empty(&linux_dmabuf->compiled_feedbacks));
 	wlr_drm_format_set_finish(&linux_dmabuf->default_formats);
 	if (linux_dmabuf->main_device_fd >= 0) {
 		close(linux_dmabuf->main_device_fd);
@@ -884,7 +1084,8 @@ static void handle_display_destroy(struct wl_listener *listener, void *data) {
 
 static bool set_default_feedback(struct wlr_linux_dmabuf_v1 *linux_dmabuf,
 		const struct wlr_linux_dmabuf_feedback_v1 *feedback) {
-	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled = feedback_compile(feedback);
+	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled =
+		linux_dmabuf_get_compiled_feedback(linux_dmabuf, feedback);
 	if (compiled == NULL) {
 		return false;
 	}
@@ -926,7 +1127,7 @@ static bool set_default_feedback(struct wlr_linux_dmabuf_v1 *linux_dmabuf,
 		}
 	}
 
-	compiled_feedback_destroy(linux_dmabuf->default_feedback);
+	compiled_feedback_unref(linux_dmabuf->default_feedback);
 	linux_dmabuf->default_feedback = compiled;
 
 	if (linux_dmabuf->main_device_fd >= 0) {
@@ -942,7 +1143,7 @@ static bool set_default_feedback(struct wlr_linux_dmabuf_v1 *linux_dmabuf,
 error_formats:
 	wlr_drm_format_set_finish(&formats);
 error_compiled:
-	compiled_feedback_destroy(compiled);
+	compiled_feedback_unref(compiled);
 	return false;
 }
 
@@ -958,6 +1159,8 @@ struct wlr_linux_dmabuf_v1 *wlr_linux_dmabuf_v1_create(struct wl_display *displa
 	linux_dmabuf->main_device_fd = -1;
 
 	wl_list_init(&linux_dmabuf->surfaces);
+	wl_list_init(&linux_dmabuf->compiled_feedbacks);
+	wl_list_init(&linux_dmabuf->checked_dmabufs);
 	wl_signal_init(&linux_dmabuf->events.destroy);
 
 	linux_dmabuf->global = wl_global_create(display, &zwp_linux_dmabuf_v1_interface,
@@ -1022,13 +1225,19 @@ bool wlr_linux_dmabuf_v1_set_surface_feedback(
 
 	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled = NULL;
 	if (feedback != NULL) {
-		compiled = feedback_compile(feedback);
+		compiled = linux_dmabuf_get_compiled_feedback(linux_dmabuf, feedback);
 		if (compiled == NULL) {
 			return false;
 		}
 	}
 
-	compiled_feedback_destroy(surface->feedback);
+	if (compiled == surface->feedback) {
+		// Same feedback as before, nothing to send
+		compiled_feedback_unref(compiled);
+		return true;
+	}
+
+	compiled_feedback_unref(surface->feedback);
 	surface->feedback = compiled;
 
 	struct wl_resource *resource;
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <wlr/render/dmabuf.h>
 #include <wlr/render/drm_syncobj.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_linux_drm_syncobj_v1.h>
@@ -10,6 +11,7 @@
 #include <xf86drm.h>
 #include "config.h"
 #include "linux-drm-syncobj-v1-protocol.h"
+#include "render/dmabuf.h"
 
 #define LINUX_DRM_SYNCOBJ_V1_VERSION 1
 
@@ -20,6 +22,7 @@ struct wlr_linux_drm_syncobj_surface_v1 {
 
 	struct wlr_addon addon;
 	struct wlr_surface_synced synced;
+	bool latch_signaled; // copied from the manager
 
 	struct wl_listener client_commit;
 };
@@ -215,7 +218,11 @@ static void surface_commit_handle_surface_destroy(struct wl_listener *listener,
 // Block the surface commit until the fence materializes
 static bool lock_surface_commit(struct wlr_linux_drm_syncobj_surface_v1 *surface,
 		struct wlr_drm_syncobj_timeline *timeline, uint64_t point) {
-	uint32_t flags = DRM_SYNCOBJ_WAIT_FLAGS_WAIT_AVAILABLE;
+	// Without latch_signaled, the commit is applied as soon as the fence
+	// exists and the renderer or the backend waits for it. With it, the
+	// commit stays pending until the fence is signaled, so the previous
+	// buffer is kept on screen instead of stalling the whole frame.
+	uint32_t flags = surface->latch_signaled ? 0 : DRM_SYNCOBJ_WAIT_FLAGS_WAIT_AVAILABLE;
 
 	bool already_materialized = false;
 	if (!wlr_drm_syncobj_timeline_check(timeline, point, flags, &already_materialized)) {
@@ -335,6 +342,7 @@ static void manager_handle_get_surface(struct wl_client *client,
 		&surface_impl, surface, surface_handle_resource_destroy);
 
 	surface->surface = wlr_surface;
+	surface->latch_signaled = manager_from_resource(resource)->latch_signaled;
 
 	surface->client_commit.notify = surface_handle_client_commit;
 	wl_signal_add(&wlr_surface->events.client_commit, &surface->client_commit);
@@ -460,6 +468,11 @@ error_manager:
 	return NULL;
 }
 
+void wlr_linux_drm_syncobj_manager_v1_set_latch_signaled(
+		struct wlr_linux_drm_syncobj_manager_v1 *manager, bool latch_signaled) {
+	manager->latch_signaled = latch_signaled;
+}
+
 struct wlr_linux_drm_syncobj_surface_v1_state *
 wlr_linux_drm_syncobj_v1_get_surface_state(struct wlr_surface *wlr_surface) {
 	struct wlr_linux_drm_syncobj_surface_v1 *surface =
@@ -471,15 +484,40 @@ wlr_linux_drm_syncobj_v1_get_surface_state(struct wlr_surface *wlr_surface) {
 }
 
 struct release_signaller {
+	struct wlr_buffer *buffer;
 	struct wlr_drm_syncobj_timeline *timeline;
 	uint64_t point;
 	struct wl_listener buffer_release;
 };
 
+// Make the release point signal once the GPU is done with the buffer, instead
+// of right away: the renderer may still be sampling from it when the last
+// lock is dropped. The fences attached to the DMA-BUF cover these reads.
+// DMA_BUF_IOCTL_EXPORT_SYNC_FILE is always available, since it predates the
+// drm_syncobj eventfd IOCTL required by this protocol.
+static bool release_signaller_transfer_dmabuf_fence(struct release_signaller *signaller) {
+	struct wlr_dmabuf_attributes dmabuf = {0};
+	if (!wlr_buffer_get_dmabuf(signaller->buffer, &dmabuf)) {
+		return false;
+	}
+
+	// Exporting for writing returns a fence for all readers and writers
+	int sync_file_fd = dmabuf_export_sync_file(dmabuf.fd[0], DMA_BUF_SYNC_WRITE);
+	if (sync_file_fd < 0) {
+		return false;
+	}
+
+	bool ok = wlr_drm_syncobj_timeline_import_sync_file(signaller->timeline,
+		signaller->point, sync_file_fd);
+	close(sync_file_fd);
+	return ok;
+}
+
 static void release_signaller_handle_buffer_release(struct wl_listener *listener, void *data) {
 	struct release_signaller *signaller = wl_container_of(listener, signaller, buffer_release);
 
-	if (drmSyncobjTimelineSignal(signaller->timeline->drm_fd, &signaller->timeline->handle,
+	if (!release_signaller_transfer_dmabuf_fence(signaller) &&
+			drmSyncobjTimelineSignal(signaller->timeline->drm_fd, &signaller->timeline->handle,
 			&signaller->point, 1) != 0) {
 		wlr_log(WLR_ERROR, "drmSyncobjTimelineSignal() failed");
 	}
@@ -504,6 +542,7 @@ bool wlr_linux_drm_syncobj_v1_state_signal_release_with_buffer(
 		return false;
 	}
 
+	signaller->buffer = buffer;
 	signaller->timeline = wlr_drm_syncobj_timeline_ref(state->release_timeline);
 	signaller->point = state->release_point;
 
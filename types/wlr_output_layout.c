@@ -33,8 +33,21 @@ struct wlr_output_layout *wlr_output_layout_create(struct wl_display *display) {
 	return layout;
 }
 
+static void output_layout_index_finish(struct wlr_output_layout *layout) {
+	layout->index_valid = false;
+	free(layout->index_x);
+	free(layout->index_y);
+	free(layout->index_cells);
+	layout->index_x = layout->index_y = NULL;
+	layout->index_x_len = layout->index_y_len = 0;
+	layout->index_cells = NULL;
+}
+
 static void output_layout_output_destroy(
 		struct wlr_output_layout_output *l_output) {
+	// The index references the output, fall back to linear scans until the
+	// layout is reconfigured
+	l_output->layout->index_valid = false;
 	wl_signal_emit_mutable(&l_output->events.destroy, l_output);
 	wlr_output_destroy_global(l_output->output);
 	wl_list_remove(&l_output->commit.link);
@@ -55,6 +68,7 @@ void wlr_output_layout_destroy(struct wlr_output_layout *layout) {
 		output_layout_output_destroy(l_output);
 	}
 
+	output_layout_index_finish(layout);
 	wl_list_remove(&layout->display_destroy.link);
 	free(layout);
 }
@@ -68,6 +82,160 @@ static void output_layout_output_get_box(
 		&box->width, &box->height);
 }
 
+static int compare_int(const void *a, const void *b) {
+	int ia = *(const int *)a, ib = *(const int *)b;
+	return (ia > ib) - (ia < ib);
+}
+
+// Sorts the edges and removes duplicates, returns the new length
+static size_t sort_edges(int *edges, size_t len) {
+	if (len == 0) {
+		return 0;
+	}
+	qsort(edges, len, sizeof(edges[0]), compare_int);
+	size_t j = 1;
+	for (size_t i = 1; i < len; i++) {
+		if (edges[i] != edges[j - 1]) {
+			edges[j++] = edges[i];
+		}
+	}
+	return j;
+}
+
+// Returns the number of edges lower than v (or equal, if inclusive is set)
+static size_t count_edges_below(const int *edges, size_t len, double v,
+		bool inclusive) {
+	size_t lo = 0, hi = len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (edges[mid] < v || (inclusive && edges[mid] == v)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static void output_layout_index_build(struct wlr_output_layout *layout) {
+	output_layout_index_finish(layout);
+
+	size_t outputs_len = wl_list_length(&layout->outputs);
+	if (outputs_len == 0) {
+		layout->index_valid = true;
+		return;
+	}
+
+	int *xs = calloc(2 * outputs_len, sizeof(xs[0]));
+	int *ys = calloc(2 * outputs_len, sizeof(ys[0]));
+	if (xs == NULL || ys == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(xs);
+		free(ys);
+		return;
+	}
+
+	size_t xs_len = 0, ys_len = 0;
+	struct wlr_output_layout_output *l_output;
+	wl_list_for_each(l_output, &layout->outputs, link) {
+		struct wlr_box box;
+		output_layout_output_get_box(l_output, &box);
+		if (wlr_box_empty(&box)) {
+			continue;
+		}
+		xs[xs_len++] = box.x;
+		xs[xs_len++] = box.x + box.width;
+		ys[ys_len++] = box.y;
+		ys[ys_len++] = box.y + box.height;
+	}
+	xs_len = sort_edges(xs, xs_len);
+	ys_len = sort_edges(ys, ys_len);
+
+	struct wlr_output_layout_output **cells = NULL;
+	if (xs_len >= 2 && ys_len >= 2) {
+		cells = calloc((xs_len - 1) * (ys_len - 1), sizeof(cells[0]));
+		if (cells == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			free(xs);
+			free(ys);
+			return;
+		}
+	}
+
+	// Walk the outputs backwards, so that the first output in the list wins
+	// where outputs overlap
+	wl_list_for_each_reverse(l_output, &layout->outputs, link) {
+		struct wlr_box box;
+		output_layout_output_get_box(l_output, &box);
+		if (wlr_box_empty(&box)) {
+			continue;
+		}
+		size_t x1 = count_edges_below(xs, xs_len, box.x, false);
+		size_t x2 = count_edges_below(xs, xs_len, box.x + box.width, false);
+		size_t y1 = count_edges_below(ys, ys_len, box.y, false);
+		size_t y2 = count_edges_below(ys, ys_len, box.y + box.height, false);
+		for (size_t y = y1; y < y2; y++) {
+			for (size_t x = x1; x < x2; x++) {
+				cells[y * (xs_len - 1) + x] = l_output;
+			}
+		}
+	}
+
+	layout->index_x = xs;
+	layout->index_x_len = xs_len;
+	layout->index_y = ys;
+	layout->index_y_len = ys_len;
+	layout->index_cells = cells;
+	layout->index_valid = true;
+}
+
+static struct wlr_output_layout_output *output_layout_index_at(
+		struct wlr_output_layout *layout, double lx, double ly) {
+	size_t x_len = layout->index_x_len, y_len = layout->index_y_len;
+	// Also rejects NaN
+	if (x_len < 2 || y_len < 2 ||
+			!(lx >= layout->index_x[0] && lx < layout->index_x[x_len - 1]) ||
+			!(ly >= layout->index_y[0] && ly < layout->index_y[y_len - 1])) {
+		return NULL;
+	}
+	size_t x = count_edges_below(layout->index_x, x_len, lx, true) - 1;
+	size_t y = count_edges_below(layout->index_y, y_len, ly, true) - 1;
+	return layout->index_cells[y * (x_len - 1) + x];
+}
+
+static bool output_layout_index_intersects(struct wlr_output_layout *layout,
+		const struct wlr_box *box) {
+	size_t x_len = layout->index_x_len, y_len = layout->index_y_len;
+	if (x_len < 2 || y_len < 2 || wlr_box_empty(box)) {
+		return false;
+	}
+
+	// Cells overlapping the box
+	size_t x1 = count_edges_below(layout->index_x, x_len, box->x, true);
+	size_t x2 = count_edges_below(layout->index_x, x_len,
+		(double)box->x + box->width, false);
+	size_t y1 = count_edges_below(layout->index_y, y_len, box->y, true);
+	size_t y2 = count_edges_below(layout->index_y, y_len,
+		(double)box->y + box->height, false);
+	x1 = x1 > 0 ? x1 - 1 : 0;
+	y1 = y1 > 0 ? y1 - 1 : 0;
+	if (x2 > x_len - 1) {
+		x2 = x_len - 1;
+	}
+	if (y2 > y_len - 1) {
+		y2 = y_len - 1;
+	}
+
+	for (size_t y = y1; y < y2; y++) {
+		for (size_t x = x1; x < x2; x++) {
+			if (layout->index_cells[y * (x_len - 1) + x] != NULL) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
 /**
  * This must be called whenever the layout changes to reconfigure the auto
  * configured outputs and emit the `changed` event.
@@ -112,6 +280,8 @@ static void output_layout_reconfigure(struct wlr_output_layout *layout) {
 		max_x += output_box.width;
 	}
 
+	output_layout_index_build(layout);
+
 	wl_signal_emit_mutable(&layout->events.change, layout);
 }
 
@@ -255,6 +425,10 @@ bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 	struct wlr_box out_box;
 
 	if (reference == NULL) {
+		if (layout->index_valid) {
+			return output_layout_index_intersects(layout, target_lbox);
+		}
+
 		struct wlr_output_layout_output *l_output;
 		wl_list_for_each(l_output, &layout->outputs, link) {
 			struct wlr_box output_box;
@@ -280,6 +454,11 @@ bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 struct wlr_output *wlr_output_layout_output_at(struct wlr_output_layout *layout,
 		double lx, double ly) {
 	struct wlr_output_layout_output *l_output;
+	if (layout->index_valid) {
+		l_output = output_layout_index_at(layout, lx, ly);
+		return l_output != NULL ? l_output->output : NULL;
+	}
+
 	wl_list_for_each(l_output, &layout->outputs, link) {
 		struct wlr_box output_box;
 		output_layout_output_get_box(l_output, &output_box);
@@ -315,6 +494,23 @@ void wlr_output_layout_closest_point(struct wlr_output_layout *layout,
 
 	double min_x = lx, min_y = ly, min_distance = DBL_MAX;
 	struct wlr_output_layout_output *l_output;
+
+	// Points inside the layout are their own closest point: no output before
+	// the first one containing the point can be closer
+	if (reference == NULL && layout->index_valid) {
+		l_output = output_layout_index_at(layout, lx, ly);
+		if (l_output != NULL) {
+			struct wlr_box output_box;
+			output_layout_output_get_box(l_output, &output_box);
+			wlr_box_closest_point(&output_box, lx, ly, &min_x, &min_y);
+			if (min_x == lx && min_y == ly) {
+				goto out;
+			}
+			min_x = lx;
+			min_y = ly;
+		}
+	}
+
 	wl_list_for_each(l_output, &layout->outputs, link) {
 		if (reference != NULL && reference != l_output->output) {
 			continue;
@@ -340,6 +536,7 @@ void wlr_output_layout_closest_point(struct wlr_output_layout *layout,
 		}
 	}
 
+out:
 	if (dest_lx) {
 		*dest_lx = min_x;
 	}
@@ -0,0 +1,179 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <wlr/render/pass.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/render/wlr_texture.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_mirror.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+#include <wlr/util/transform.h>
+
+static bool mirror_try_scanout(struct wlr_output_mirror *mirror,
+		struct wlr_buffer *buffer) {
+	struct wlr_output *src = mirror->src, *dst = mirror->dst;
+	if (src->transform != dst->transform ||
+			buffer->width != dst->width || buffer->height != dst->height) {
+		return false;
+	}
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_buffer(&state, buffer);
+	bool ok = wlr_output_test_state(dst, &state) &&
+		wlr_output_commit_state(dst, &state);
+	wlr_output_state_finish(&state);
+	return ok;
+}
+
+static bool mirror_blit(struct wlr_output_mirror *mirror,
+		struct wlr_buffer *buffer) {
+	struct wlr_output *src = mirror->src, *dst = mirror->dst;
+	if (dst->renderer == NULL) {
+		return false;
+	}
+
+	struct wlr_texture *texture = wlr_texture_from_buffer(dst->renderer, buffer);
+	if (texture == NULL) {
+		wlr_log(WLR_DEBUG, "Failed to import buffer of output %s for mirroring",
+			src->name);
+		return false;
+	}
+
+	// Fit the source into the destination in logical coordinates, keeping
+	// its aspect ratio
+	int src_width, src_height, dst_width, dst_height;
+	wlr_output_transformed_resolution(src, &src_width, &src_height);
+	wlr_output_transformed_resolution(dst, &dst_width, &dst_height);
+	struct wlr_box box = { .width = dst_width, .height = dst_height };
+	if ((int64_t)src_width * dst_height > (int64_t)src_height * dst_width) {
+		box.height = (int64_t)src_height * dst_width / src_width;
+	} else {
+		box.width = (int64_t)src_width * dst_height / src_height;
+	}
+	box.x = (dst_width - box.width) / 2;
+	box.y = (dst_height - box.height) / 2;
+	wlr_box_transform(&box, &box, wlr_output_transform_invert(dst->transform),
+		dst_width, dst_height);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+
+	bool ok = false;
+	struct wlr_render_pass *pass = wlr_output_begin_render_pass(dst, &state, NULL);
+	if (pass == NULL) {
+		goto out;
+	}
+
+	if (box.width != dst->width || box.height != dst->height) {
+		wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
+			.box = { .width = dst->width, .height = dst->height },
+			.color = { .a = 1 },
+		});
+	}
+	wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
+		.texture = texture,
+		.dst_box = box,
+		.transform = wlr_output_transform_compose(
+			wlr_output_transform_invert(src->transform), dst->transform),
+		.filter_mode = WLR_SCALE_FILTER_BILINEAR,
+		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+	});
+	if (!wlr_render_pass_submit(pass)) {
+		goto out;
+	}
+
+	ok = wlr_output_commit_state(dst, &state);
+
+out:
+	wlr_output_state_finish(&state);
+	wlr_texture_destroy(texture);
+	return ok;
+}
+
+static void mirror_handle_dst_frame(struct wl_listener *listener, void *data) {
+	struct wlr_output_mirror *mirror = wl_container_of(listener, mirror, dst_frame);
+	struct wlr_buffer *buffer = mirror->pending_buffer;
+	if (buffer == NULL) {
+		return;
+	}
+	mirror->pending_buffer = NULL;
+
+	if (!mirror_try_scanout(mirror, buffer) && !mirror_blit(mirror, buffer)) {
+		wlr_log(WLR_DEBUG, "Failed to mirror output %s onto %s",
+			mirror->src->name, mirror->dst->name);
+	}
+	wlr_buffer_unlock(buffer);
+}
+
+static void mirror_handle_src_commit(struct wl_listener *listener, void *data) {
+	struct wlr_output_mirror *mirror = wl_container_of(listener, mirror, src_commit);
+	const struct wlr_output_event_commit *event = data;
+	if (!(event->state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		return;
+	}
+
+	wlr_buffer_unlock(mirror->pending_buffer);
+	mirror->pending_buffer = wlr_buffer_lock(event->state->buffer);
+	wlr_output_schedule_frame(mirror->dst);
+}
+
+static void mirror_handle_src_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_output_mirror *mirror = wl_container_of(listener, mirror, src_destroy);
+	wlr_output_mirror_destroy(mirror);
+}
+
+static void mirror_handle_dst_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_output_mirror *mirror = wl_container_of(listener, mirror, dst_destroy);
+	wlr_output_mirror_destroy(mirror);
+}
+
+struct wlr_output_mirror *wlr_output_mirror_create(struct wlr_output *src,
+		struct wlr_output *dst) {
+	assert(src != dst);
+	if (src->frame_leader != NULL) {
+		wlr_log(WLR_ERROR, "Cannot mirror output %s: its frames are driven "
+			"by another output", src->name);
+		return NULL;
+	}
+
+	struct wlr_output_mirror *mirror = calloc(1, sizeof(*mirror));
+	if (mirror == NULL) {
+		return NULL;
+	}
+
+	mirror->src = src;
+	mirror->dst = dst;
+	wl_signal_init(&mirror->events.destroy);
+
+	mirror->src_commit.notify = mirror_handle_src_commit;
+	wl_signal_add(&src->events.commit, &mirror->src_commit);
+	mirror->src_destroy.notify = mirror_handle_src_destroy;
+	wl_signal_add(&src->events.destroy, &mirror->src_destroy);
+	mirror->dst_frame.notify = mirror_handle_dst_frame;
+	wl_signal_add(&dst->events.frame, &mirror->dst_frame);
+	mirror->dst_destroy.notify = mirror_handle_dst_destroy;
+	wl_signal_add(&dst->events.destroy, &mirror->dst_destroy);
+
+	wlr_output_set_frame_leader(dst, src);
+
+	return mirror;
+}
+
+void wlr_output_mirror_destroy(struct wlr_output_mirror *mirror) {
+	if (mirror == NULL) {
+		return;
+	}
+
+	wl_signal_emit_mutable(&mirror->events.destroy, NULL);
+
+	wl_list_remove(&mirror->src_commit.link);
+	wl_list_remove(&mirror->src_destroy.link);
+	wl_list_remove(&mirror->dst_frame.link);
+	wl_list_remove(&mirror->dst_destroy.link);
+
+	wlr_output_set_frame_leader(mirror->dst, NULL);
+	wlr_buffer_unlock(mirror->pending_buffer);
+	free(mirror);
+}
@@ -6,9 +6,35 @@
 #include <wlr/render/allocator.h>
 #include <wlr/render/swapchain.h>
 #include <wlr/types/wlr_output_swapchain_manager.h>
+#include <wlr/util/addon.h>
 #include <wlr/util/log.h>
 #include "render/drm_format_set.h"
 #include "types/wlr_output.h"
+#include "util/cache.h"
+
+#define PREPARE_CACHE_SIZE 8
+
+struct prepare_cache_entry {
+	uint64_t key;
+	bool failed;
+	enum output_modifier_tier tier; // modifiers which passed the test
+};
+
+/**
+ * Results of previous wlr_output_swapchain_manager_prepare() calls, attached
+ * to the first output of each configuration. Compositors often go through the
+ * same configurations again (e.g. when docking), and each attempt can take
+ * several test commits.
+ */
+struct prepare_cache {
+	struct wlr_addon addon;
+	// Identifies the output in cache keys, unlike its address this is never
+	// re-used by another output
+	uint64_t serial;
+
+	struct prepare_cache_entry entries[PREPARE_CACHE_SIZE];
+	size_t entries_len, next_entry;
+};
 
 struct wlr_output_swapchain_manager_output {
 	struct wlr_output *output;
@@ -59,6 +85,112 @@ static struct wlr_output_swapchain_manager_output *manager_get_or_add_output(
 	return manager_output;
 }
 
+static void prepare_cache_addon_destroy(struct wlr_addon *addon) {
+	struct prepare_cache *cache = wl_container_of(addon, cache, addon);
+	wlr_addon_finish(&cache->addon);
+	free(cache);
+}
+
+static const struct wlr_addon_interface prepare_cache_addon_impl = {
+	.name = "wlr_output_swapchain_manager_prepare_cache",
+	.destroy = prepare_cache_addon_destroy,
+};
+
+static struct prepare_cache *prepare_cache_get(struct wlr_output *output) {
+	static uint64_t next_serial = 1;
+
+	struct wlr_addon *addon =
+		wlr_addon_find(&output->addons, NULL, &prepare_cache_addon_impl);
+	if (addon != NULL) {
+		struct prepare_cache *cache = wl_container_of(addon, cache, addon);
+		return cache;
+	}
+
+	struct prepare_cache *cache = calloc(1, sizeof(*cache));
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->serial = next_serial++;
+	wlr_addon_init(&cache->addon, &output->addons, NULL, &prepare_cache_addon_impl);
+	return cache;
+}
+
+static bool prepare_cache_key(const struct wlr_backend_output_state *states,
+		size_t states_len, uint64_t *key) {
+	uint64_t hash = CACHE_HASH_INIT;
+	for (size_t i = 0; i < states_len; i++) {
+		struct wlr_output *output = states[i].output;
+		const struct wlr_output_state *state = &states[i].base;
+
+		struct prepare_cache *cache = prepare_cache_get(output);
+		if (cache == NULL) {
+			return false;
+		}
+
+		bool enabled = output_pending_enabled(output, state);
+		int width = 0, height = 0, refresh = 0;
+		uint32_t render_format = 0;
+		if (enabled) {
+			output_pending_resolution(output, state, &width, &height);
+			refresh = output->refresh;
+			if (state->committed & WLR_OUTPUT_STATE_MODE) {
+				if (state->mode_type == WLR_OUTPUT_STATE_MODE_FIXED) {
+					refresh = state->mode->refresh;
+				} else {
+					refresh = state->custom_mode.refresh;
+				}
+			}
+			render_format = output->render_format;
+			if (state->committed & WLR_OUTPUT_STATE_RENDER_FORMAT) {
+				render_format = state->render_format;
+			}
+		}
+
+		hash = cache_hash(hash, &cache->serial, sizeof(cache->serial));
+		hash = cache_hash(hash, &enabled, sizeof(enabled));
+		hash = cache_hash(hash, &width, sizeof(width));
+		hash = cache_hash(hash, &height, sizeof(height));
+		hash = cache_hash(hash, &refresh, sizeof(refresh));
+		hash = cache_hash(hash, &render_format, sizeof(render_format));
+	}
+	*key = hash;
+	return true;
+}
+
+static const struct prepare_cache_entry *prepare_cache_find(
+		struct prepare_cache *cache, uint64_t key) {
+	for (size_t i = 0; i < cache->entries_len; i++) {
+		if (cache->entries[i].key == key) {
+			return &cache->entries[i];
+		}
+	}
+	return NULL;
+}
+
+static void prepare_cache_add(struct prepare_cache *cache, uint64_t key,
+		bool failed, enum output_modifier_tier tier) {
+	struct prepare_cache_entry *entry = NULL;
+	for (size_t i = 0; i < cache->entries_len; i++) {
+		if (cache->entries[i].key == key) {
+			entry = &cache->entries[i];
+			break;
+		}
+	}
+	if (entry == NULL) {
+		// Replace the oldest entry once full
+		entry = &cache->entries[cache->next_entry];
+		cache->next_entry = (cache->next_entry + 1) % PREPARE_CACHE_SIZE;
+		if (cache->entries_len < PREPARE_CACHE_SIZE) {
+			cache->entries_len++;
+		}
+	}
+	*entry = (struct prepare_cache_entry){
+		.key = key,
+		.failed = failed,
+		.tier = tier,
+	};
+}
+
 static bool swapchain_is_compatible(struct wlr_swapchain *swapchain,
 		int width, int height, const struct wlr_drm_format *format) {
 	if (swapchain == NULL) {
@@ -96,11 +228,12 @@ static struct wlr_swapchain *manager_output_get_swapchain(
 }
 
 static bool manager_output_prepare(struct wlr_output_swapchain_manager_output *manager_output,
-		struct wlr_output_state *state, bool explicit_modifiers) {
+		struct wlr_output_state *state, enum output_modifier_tier tier, bool *changed) {
 	struct wlr_output *output = manager_output->output;
 	struct wlr_allocator *allocator = output->allocator;
 	assert(allocator != NULL);
 
+	*changed = false;
 	if (!output_pending_enabled(output, state)) {
 		manager_output->pending_swapchain = NULL;
 		return true;
@@ -121,19 +254,9 @@ static bool manager_output_prepare(struct wlr_output_swapchain_manager_output *m
 		return false;
 	}
 
-	if (!explicit_modifiers && (format.len != 1 || format.modifiers[0] != DRM_FORMAT_MOD_LINEAR)) {
-		if (!wlr_drm_format_has(&format, DRM_FORMAT_MOD_INVALID)) {
-			wlr_log(WLR_DEBUG, "Implicit modifiers not supported");
-			wlr_drm_format_finish(&format);
-			return false;
-		}
-
-		format.len = 0;
-		if (!wlr_drm_format_add(&format, DRM_FORMAT_MOD_INVALID)) {
-			wlr_log(WLR_DEBUG, "Failed to add implicit modifier to format");
-			wlr_drm_format_finish(&format);
-			return false;
-		}
+	if (!output_format_restrict_modifiers(&format, tier, changed)) {
+		wlr_drm_format_finish(&format);
+		return false;
 	}
 
 	struct wlr_swapchain *swapchain =
@@ -154,17 +277,33 @@ static bool manager_output_prepare(struct wlr_output_swapchain_manager_output *m
 	return true;
 }
 
+static const char *const modifier_tier_names[] = {
+	[OUTPUT_MODIFIER_TIER_ALL] = "all",
+	[OUTPUT_MODIFIER_TIER_UNCOMPRESSED] = "uncompressed",
+	[OUTPUT_MODIFIER_TIER_IMPLICIT] = "implicit",
+};
+
+/**
+ * Allocate buffers and test the configuration. tested is set if the backend
+ * test was reached, ie. the configuration is rejected by the backend if false
+ * is returned. A tier giving the same modifiers as the ALL tier for every
+ * output counts as tested when it isn't the first tier tried, since the
+ * configuration was already rejected.
+ */
 static bool manager_test(struct wlr_output_swapchain_manager *manager,
 		struct wlr_backend_output_state *states, size_t states_len,
-		bool explicit_modifiers) {
+		enum output_modifier_tier tier, bool first, bool *tested) {
+	*tested = false;
+
 	wlr_log(WLR_DEBUG, "Preparing test commit for %zu outputs with %s modifiers",
-		states_len, explicit_modifiers ? "explicit": "implicit");
+		states_len, modifier_tier_names[tier]);
 
 	struct wlr_output_swapchain_manager_output *manager_output;
 	wl_array_for_each(manager_output, &manager->outputs) {
 		manager_output->test_success = false;
 	}
 
+	bool changed = false;
 	for (size_t i = 0; i < states_len; i++) {
 		struct wlr_backend_output_state *state = &states[i];
 		struct wlr_output_swapchain_manager_output *manager_output =
@@ -172,12 +311,22 @@ static bool manager_test(struct wlr_output_swapchain_manager *manager,
 		if (manager_output == NULL) {
 			return false;
 		}
-		if (!manager_output_prepare(manager_output, &state->base, explicit_modifiers)) {
+		bool output_changed = false;
+		if (!manager_output_prepare(manager_output, &state->base, tier,
+				&output_changed)) {
 			return false;
 		}
+		changed = changed || output_changed;
+	}
+
+	if (!first && tier != OUTPUT_MODIFIER_TIER_ALL && !changed) {
+		wlr_log(WLR_DEBUG, "Skipping test commit with the same modifiers");
+		*tested = true;
+		return false;
 	}
 
 	bool ok = wlr_backend_test(manager->backend, states, states_len);
+	*tested = true;
 	wlr_log(WLR_DEBUG, "Test commit for %zu outputs %s",
 		states_len, ok ? "succeeded" : "failed");
 	if (!ok) {
@@ -196,7 +345,32 @@ static bool manager_test(struct wlr_output_swapchain_manager *manager,
 
 bool wlr_output_swapchain_manager_prepare(struct wlr_output_swapchain_manager *manager,
 		const struct wlr_backend_output_state *states, size_t states_len) {
-	bool ok = false;
+	struct prepare_cache *cache = NULL;
+	uint64_t key = 0;
+	const struct prepare_cache_entry *cached = NULL;
+	if (states_len > 0 && prepare_cache_key(states, states_len, &key)) {
+		cache = prepare_cache_get(states[0].output);
+		cached = prepare_cache_find(cache, key);
+	}
+
+	if (cached != NULL && cached->failed) {
+		wlr_log(WLR_DEBUG, "Output configuration previously rejected by the backend");
+		return false;
+	}
+
+	// Try modifiers in order of expected memory bandwidth usage, starting
+	// with the ones which worked last time for this configuration
+	enum output_modifier_tier order[OUTPUT_MODIFIER_TIER_COUNT];
+	size_t order_len = 0;
+	if (cached != NULL) {
+		order[order_len++] = cached->tier;
+	}
+	for (int tier = 0; tier < OUTPUT_MODIFIER_TIER_COUNT; tier++) {
+		if (cached == NULL || (enum output_modifier_tier)tier != cached->tier) {
+			order[order_len++] = tier;
+		}
+	}
+
 	struct wlr_backend_output_state *pending = malloc(states_len * sizeof(states[0]));
 	if (pending == NULL) {
 		return false;
@@ -206,9 +380,23 @@ bool wlr_output_swapchain_manager_prepare(struct wlr_output_swapchain_manager *m
 		pending[i].base.buffer = NULL;
 	}
 
-	ok = manager_test(manager, pending, states_len, true);
-	if (!ok) {
-		ok = manager_test(manager, pending, states_len, false);
+	bool ok = false, all_tested = true;
+	enum output_modifier_tier tier = OUTPUT_MODIFIER_TIER_ALL;
+	for (size_t i = 0; i < order_len && !ok; i++) {
+		tier = order[i];
+		bool tested = false;
+		ok = manager_test(manager, pending, states_len, tier, i == 0, &tested);
+		all_tested = all_tested && tested;
+	}
+
+	if (cache != NULL) {
+		if (ok) {
+			prepare_cache_add(cache, key, false, tier);
+		} else if (all_tested) {
+			// Don't remember failures which may be transient, e.g. allocation
+			// failures
+			prepare_cache_add(cache, key, true, tier);
+		}
 	}
 
 	for (size_t i = 0; i < states_len; i++) {
@@ -18,6 +18,27 @@ struct wlr_presentation_surface {
 
 	struct wlr_addon addon; // wlr_surface.addons
 	struct wlr_surface_synced synced;
+
+	// Clients usually request feedback for each frame, keep a destroyed
+	// feedback around to avoid an allocation per commit
+	struct wl_list feedbacks; // wlr_presentation_feedback.surface_link
+	struct wlr_presentation_feedback *spare_feedback;
+};
+
+/**
+ * Feedbacks queued on an output via the
+ * wlr_presentation_surface_{textured,scanned_out}_on_output() helpers. They
+ * are all handled in one pass when the output is committed and presented,
+ * rather than each listening to the output.
+ */
+struct presentation_output {
+	struct wlr_output *output;
+	struct wlr_addon addon; // wlr_output.addons
+
+	struct wl_list feedbacks; // wlr_presentation_feedback.output_link
+
+	struct wl_listener output_commit;
+	struct wl_listener output_present;
 };
 
 static void feedback_handle_resource_destroy(struct wl_resource *resource) {
@@ -62,6 +83,14 @@ static void presentation_surface_addon_destroy(struct wlr_addon *addon) {
 	wlr_addon_finish(addon);
 	wlr_surface_synced_finish(&p_surface->synced);
 
+	struct wlr_presentation_feedback *feedback, *tmp;
+	wl_list_for_each_safe(feedback, tmp, &p_surface->feedbacks, surface_link) {
+		feedback->surface = NULL;
+		wl_list_remove(&feedback->surface_link);
+		wl_list_init(&feedback->surface_link);
+	}
+	free(p_surface->spare_feedback);
+
 	free(p_surface);
 }
 
@@ -104,25 +133,35 @@ static void presentation_handle_feedback(struct wl_client *client,
 			wl_client_post_no_memory(client);
 			return;
 		}
-		wlr_addon_init(&p_surface->addon, &surface->addons,
-			NULL, &presentation_surface_addon_impl);
 		if (!wlr_surface_synced_init(&p_surface->synced, surface,
 				&surface_synced_impl, &p_surface->pending, &p_surface->current)) {
 			free(p_surface);
 			wl_client_post_no_memory(client);
 			return;
 		}
+		wlr_addon_init(&p_surface->addon, &surface->addons,
+			NULL, &presentation_surface_addon_impl);
+		wl_list_init(&p_surface->feedbacks);
 	}
 
 	struct wlr_presentation_feedback *feedback = p_surface->pending.feedback;
 	if (feedback == NULL) {
-		feedback = calloc(1, sizeof(*feedback));
+		feedback = p_surface->spare_feedback;
+		p_surface->spare_feedback = NULL;
 		if (feedback == NULL) {
-			wl_client_post_no_memory(client);
-			return;
+			feedback = malloc(sizeof(*feedback));
+			if (feedback == NULL) {
+				wl_client_post_no_memory(client);
+				return;
+			}
 		}
 
+		*feedback = (struct wlr_presentation_feedback){
+			.surface = p_surface,
+		};
 		wl_list_init(&feedback->resources);
+		wl_list_init(&feedback->output_link);
+		wl_list_insert(&p_surface->feedbacks, &feedback->surface_link);
 		p_surface->pending.feedback = feedback;
 	}
 
@@ -234,7 +273,14 @@ void wlr_presentation_feedback_destroy(
 	assert(wl_list_empty(&feedback->resources));
 
 	feedback_unset_output(feedback);
-	free(feedback);
+	wl_list_remove(&feedback->surface_link);
+
+	struct wlr_presentation_surface *p_surface = feedback->surface;
+	if (p_surface != NULL && p_surface->spare_feedback == NULL) {
+		p_surface->spare_feedback = feedback;
+	} else {
+		free(feedback);
+	}
 }
 
 void wlr_presentation_event_from_output(struct wlr_presentation_event *event,
@@ -255,54 +301,106 @@ static void feedback_unset_output(struct wlr_presentation_feedback *feedback) {
 	}
 
 	feedback->output = NULL;
-	wl_list_remove(&feedback->output_commit.link);
-	wl_list_remove(&feedback->output_present.link);
-	wl_list_remove(&feedback->output_destroy.link);
+	wl_list_remove(&feedback->output_link);
+	wl_list_init(&feedback->output_link);
 }
 
-static void feedback_handle_output_commit(struct wl_listener *listener,
+static void presentation_output_handle_commit(struct wl_listener *listener,
 		void *data) {
-	struct wlr_presentation_feedback *feedback =
-		wl_container_of(listener, feedback, output_commit);
-	if (feedback->output_committed) {
-		return;
+	struct presentation_output *p_output =
+		wl_container_of(listener, p_output, output_commit);
+
+	struct wlr_presentation_feedback *feedback;
+	wl_list_for_each(feedback, &p_output->feedbacks, output_link) {
+		if (feedback->output_committed) {
+			continue;
+		}
+		feedback->output_committed = true;
+		feedback->output_commit_seq = p_output->output->commit_seq;
 	}
-	feedback->output_committed = true;
-	feedback->output_commit_seq = feedback->output->commit_seq;
 }
 
-static void feedback_handle_output_present(struct wl_listener *listener,
+static void presentation_output_handle_present(struct wl_listener *listener,
 		void *data) {
-	struct wlr_presentation_feedback *feedback =
-		wl_container_of(listener, feedback, output_present);
+	struct presentation_output *p_output =
+		wl_container_of(listener, p_output, output_present);
 	struct wlr_output_event_present *output_event = data;
 
-	if (!feedback->output_committed ||
-			output_event->commit_seq != feedback->output_commit_seq) {
-		return;
-	}
-
+	struct wlr_presentation_event event = {0};
 	if (output_event->presented) {
-		struct wlr_presentation_event event = {0};
 		wlr_presentation_event_from_output(&event, output_event);
-		struct wl_resource *resource = wl_resource_from_link(feedback->resources.next);
-		if (wl_resource_get_version(resource) == 1 &&
-				event.output->adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED) {
-			event.refresh = 0;
+	}
+
+	struct wlr_presentation_feedback *feedback, *tmp;
+	wl_list_for_each_safe(feedback, tmp, &p_output->feedbacks, output_link) {
+		if (!feedback->output_committed ||
+				output_event->commit_seq != feedback->output_commit_seq) {
+			continue;
 		}
-		if (!feedback->zero_copy) {
-			event.flags &= ~WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY;
+
+		if (output_event->presented) {
+			struct wlr_presentation_event feedback_event = event;
+			struct wl_resource *resource =
+				wl_resource_from_link(feedback->resources.next);
+			if (wl_resource_get_version(resource) == 1 &&
+					event.output->adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED) {
+				feedback_event.refresh = 0;
+			}
+			if (!feedback->zero_copy) {
+				feedback_event.flags &= ~WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY;
+			}
+			wlr_presentation_feedback_send_presented(feedback, &feedback_event);
 		}
-		wlr_presentation_feedback_send_presented(feedback, &event);
+		wlr_presentation_feedback_destroy(feedback);
 	}
-	wlr_presentation_feedback_destroy(feedback);
 }
 
-static void feedback_handle_output_destroy(struct wl_listener *listener,
-		void *data) {
-	struct wlr_presentation_feedback *feedback =
-		wl_container_of(listener, feedback, output_destroy);
-	wlr_presentation_feedback_destroy(feedback);
+static void presentation_output_addon_destroy(struct wlr_addon *addon) {
+	struct presentation_output *p_output =
+		wl_container_of(addon, p_output, addon);
+
+	struct wlr_presentation_feedback *feedback, *tmp;
+	wl_list_for_each_safe(feedback, tmp, &p_output->feedbacks, output_link) {
+		wlr_presentation_feedback_destroy(feedback);
+	}
+
+	wlr_addon_finish(&p_output->addon);
+	wl_list_remove(&p_output->output_commit.link);
+	wl_list_remove(&p_output->output_present.link);
+	free(p_output);
+}
+
+static const struct wlr_addon_interface presentation_output_addon_impl = {
+	.name = "wlr_presentation_output",
+	.destroy = presentation_output_addon_destroy,
+};
+
+static struct presentation_output *presentation_output_get_or_create(
+		struct wlr_output *output) {
+	struct wlr_addon *addon =
+		wlr_addon_find(&output->addons, NULL, &presentation_output_addon_impl);
+	if (addon != NULL) {
+		struct presentation_output *p_output =
+			wl_container_of(addon, p_output, addon);
+		return p_output;
+	}
+
+	struct presentation_output *p_output = calloc(1, sizeof(*p_output));
+	if (p_output == NULL) {
+		return NULL;
+	}
+
+	p_output->output = output;
+	wl_list_init(&p_output->feedbacks);
+	wlr_addon_init(&p_output->addon, &output->addons, NULL,
+		&presentation_output_addon_impl);
+
+	p_output->output_commit.notify = presentation_output_handle_commit;
+	wl_signal_add(&output->events.commit, &p_output->output_commit);
+	p_output->output_present.notify = presentation_output_handle_present;
+	wl_signal_add(&output->events.present, &p_output->output_present);
+
+	return p_output;
 }
 
 static void presentation_surface_queued_on_output(struct wlr_surface *surface,
@@ -313,16 +411,16 @@ static void presentation_surface_queued_on_output(struct wlr_surface *surface,
 		return;
 	}
 
+	struct presentation_output *p_output = presentation_output_get_or_create(output);
+	if (p_output == NULL) {
+		wlr_presentation_feedback_destroy(feedback);
+		return;
+	}
+
 	assert(feedback->output == NULL);
 	feedback->output = output;
 	feedback->zero_copy = zero_copy;
-
-	feedback->output_commit.notify = feedback_handle_output_commit;
-	wl_signal_add(&output->events.commit, &feedback->output_commit);
-	feedback->output_present.notify = feedback_handle_output_present;
-	wl_signal_add(&output->events.present, &feedback->output_present);
-	feedback->output_destroy.notify = feedback_handle_output_destroy;
-	wl_signal_add(&output->events.destroy, &feedback->output_destroy);
+	wl_list_insert(p_output->feedbacks.prev, &feedback->output_link);
 }
 
 void wlr_presentation_surface_textured_on_output(struct wlr_surface *surface,
@@ -199,5 +199,7 @@ void wlr_relative_pointer_manager_v1_send_relative_motion(
 			(uint32_t)(time_usec >> 32), (uint32_t)time_usec,
 			wl_fixed_from_double(dx), wl_fixed_from_double(dy),
 			wl_fixed_from_double(dx_unaccel), wl_fixed_from_double(dy_unaccel));
+		// Relative motion is grouped by wl_pointer.frame as well
+		focused->needs_pointer_frame = true;
 	}
 }
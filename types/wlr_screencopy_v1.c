@@ -1,6 +1,8 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <drm_fourcc.h>
+#include <wlr/config.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/allocator.h>
 #include <wlr/render/swapchain.h>
@@ -14,18 +16,173 @@
 #include "render/pixel_format.h"
 #include "render/wlr_renderer.h"
 
+#if WLR_HAS_DRM_BACKEND
+#include <wlr/backend/drm.h>
+#endif
+
 #define SCREENCOPY_MANAGER_VERSION 3
 
+#define SCREENCOPY_MAX_TRACKED_BUFFERS 4
+
 struct screencopy_damage {
 	struct wl_list link;
 	struct wlr_output *output;
 	struct pixman_region32 damage;
+	struct wl_list buffers; // screencopy_buffer_damage.link, most recent first
 	struct wl_listener output_precommit;
 	struct wl_listener output_destroy;
 };
 
+/**
+ * A client buffer filled by a copy_with_damage frame. Once the client reuses
+ * it for another frame, only the pixels damaged in the meantime need to be
+ * copied.
+ */
+struct screencopy_buffer_damage {
+	struct wl_list link; // screencopy_damage.buffers
+	struct wlr_buffer *buffer;
+	uint32_t format;
+	struct wlr_box box;
+	// Damage since the buffer was filled, in output buffer coordinates
+	struct pixman_region32 damage;
+	struct wl_listener buffer_destroy;
+};
+
+/**
+ * Pixels of an output commit read back in one format and region. Frames
+ * capturing the same region in the same format share the readback.
+ */
+struct wlr_screencopy_v1_readback {
+	struct wl_list link; // screencopy_capture.readbacks
+	int n_refs;
+
+	uint32_t format;
+	struct wlr_box box;
+
+	// Pending asynchronous readback, or NULL if the renderer doesn't support
+	// them
+	struct wlr_texture_readback *readback;
+	// Otherwise, the buffer the pixels have been synchronously read into
+	struct wlr_buffer *buffer;
+};
+
+/**
+ * A buffer committed on an output, captured by one or more frames. The
+ * buffer is imported once, and only lives until the commit has been
+ * processed by all frames.
+ */
+struct screencopy_capture {
+	struct wl_list link; // wlr_screencopy_manager_v1.captures
+	struct wlr_output *output;
+	struct wlr_buffer *buffer;
+	uint32_t commit_seq;
+
+	struct wlr_texture *texture;
+	struct wl_list readbacks; // wlr_screencopy_v1_readback.link
+
+	struct wl_event_source *idle;
+	struct wl_listener output_destroy;
+};
+
 static const struct zwlr_screencopy_frame_v1_interface frame_impl;
 
+static void readback_unref(struct wlr_screencopy_v1_readback *readback) {
+	if (readback == NULL || --readback->n_refs > 0) {
+		return;
+	}
+	wl_list_remove(&readback->link);
+	wlr_texture_readback_destroy(readback->readback);
+	wlr_buffer_unlock(readback->buffer);
+	free(readback);
+}
+
+static void capture_destroy(struct screencopy_capture *capture) {
+	struct wlr_screencopy_v1_readback *readback, *tmp;
+	wl_list_for_each_safe(readback, tmp, &capture->readbacks, link) {
+		// Frames still waiting for the readback keep it alive
+		wl_list_remove(&readback->link);
+		wl_list_init(&readback->link);
+		readback_unref(readback);
+	}
+	if (capture->idle != NULL) {
+		wl_event_source_remove(capture->idle);
+	}
+	wlr_texture_destroy(capture->texture);
+	wl_list_remove(&capture->output_destroy.link);
+	wl_list_remove(&capture->link);
+	free(capture);
+}
+
+static void capture_handle_idle(void *data) {
+	struct screencopy_capture *capture = data;
+	capture->idle = NULL;
+	capture_destroy(capture);
+}
+
+static void capture_handle_output_destroy(struct wl_listener *listener,
+		void *data) {
+	struct screencopy_capture *capture =
+		wl_container_of(listener, capture, output_destroy);
+	capture_destroy(capture);
+}
+
+static struct screencopy_capture *capture_get_or_create(
+		struct wlr_screencopy_manager_v1 *manager, struct wlr_output *output,
+		struct wlr_buffer *buffer) {
+	struct screencopy_capture *capture;
+	wl_list_for_each(capture, &manager->captures, link) {
+		if (capture->output == output && capture->buffer == buffer &&
+				capture->commit_seq == output->commit_seq) {
+			return capture;
+		}
+	}
+
+	capture = calloc(1, sizeof(*capture));
+	if (capture == NULL) {
+		return NULL;
+	}
+
+	// All frames capturing this commit are handled in the same output commit
+	// event, release the buffer's texture right after it
+	capture->idle = wl_event_loop_add_idle(output->event_loop,
+		capture_handle_idle, capture);
+	if (capture->idle == NULL) {
+		free(capture);
+		return NULL;
+	}
+
+	capture->output = output;
+	capture->buffer = buffer;
+	capture->commit_seq = output->commit_seq;
+	wl_list_init(&capture->readbacks);
+
+	capture->output_destroy.notify = capture_handle_output_destroy;
+	wl_signal_add(&output->events.destroy, &capture->output_destroy);
+
+	wl_list_insert(&manager->captures, &capture->link);
+	return capture;
+}
+
+static struct wlr_texture *capture_get_texture(struct screencopy_capture *capture) {
+	if (capture->texture == NULL) {
+		capture->texture = wlr_texture_from_buffer(capture->output->renderer,
+			capture->buffer);
+	}
+	return capture->texture;
+}
+
+static struct wlr_screencopy_v1_readback *capture_find_readback(
+		struct screencopy_capture *capture, uint32_t format,
+		const struct wlr_box *box) {
+	struct wlr_screencopy_v1_readback *readback;
+	wl_list_for_each(readback, &capture->readbacks, link) {
+		if (readback->format == format && wlr_box_equal(&readback->box, box)) {
+			return readback;
+		}
+	}
+	return NULL;
+}
+
 static struct screencopy_damage *screencopy_damage_find(
 		struct wlr_screencopy_v1_client *client,
 		struct wlr_output *output) {
@@ -40,11 +197,8 @@ static struct screencopy_damage *screencopy_damage_find(
 	return NULL;
 }
 
-static void screencopy_damage_accumulate(struct screencopy_damage *damage,
-		const struct wlr_output_state *state) {
-	struct pixman_region32 *region = &damage->damage;
-	struct wlr_output *output = damage->output;
-
+static void accumulate_output_damage(struct pixman_region32 *region,
+		struct wlr_output *output, const struct wlr_output_state *state) {
 	if (state->committed & WLR_OUTPUT_STATE_DAMAGE) {
 		// If the compositor submitted damage, copy it over
 		pixman_region32_union(region, region, &state->damage);
@@ -58,6 +212,41 @@ static void screencopy_damage_accumulate(struct screencopy_damage *damage,
 	}
 }
 
+static void buffer_damage_destroy(struct screencopy_buffer_damage *buffer_damage) {
+	wl_list_remove(&buffer_damage->buffer_destroy.link);
+	wl_list_remove(&buffer_damage->link);
+	pixman_region32_fini(&buffer_damage->damage);
+	free(buffer_damage);
+}
+
+static void buffer_damage_handle_buffer_destroy(struct wl_listener *listener,
+		void *data) {
+	struct screencopy_buffer_damage *buffer_damage =
+		wl_container_of(listener, buffer_damage, buffer_destroy);
+	buffer_damage_destroy(buffer_damage);
+}
+
+static struct screencopy_buffer_damage *screencopy_damage_find_buffer(
+		struct screencopy_damage *damage, struct wlr_buffer *buffer) {
+	struct screencopy_buffer_damage *buffer_damage;
+	wl_list_for_each(buffer_damage, &damage->buffers, link) {
+		if (buffer_damage->buffer == buffer) {
+			return buffer_damage;
+		}
+	}
+	return NULL;
+}
+
+static void screencopy_damage_accumulate(struct screencopy_damage *damage,
+		const struct wlr_output_state *state) {
+	accumulate_output_damage(&damage->damage, damage->output, state);
+
+	struct screencopy_buffer_damage *buffer_damage;
+	wl_list_for_each(buffer_damage, &damage->buffers, link) {
+		accumulate_output_damage(&buffer_damage->damage, damage->output, state);
+	}
+}
+
 static void screencopy_damage_handle_output_precommit(
 		struct wl_listener *listener, void *data) {
 	struct screencopy_damage *damage =
@@ -67,6 +256,10 @@ static void screencopy_damage_handle_output_precommit(
 }
 
 static void screencopy_damage_destroy(struct screencopy_damage *damage) {
+	struct screencopy_buffer_damage *buffer_damage, *tmp;
+	wl_list_for_each_safe(buffer_damage, tmp, &damage->buffers, link) {
+		buffer_damage_destroy(buffer_damage);
+	}
 	wl_list_remove(&damage->output_destroy.link);
 	wl_list_remove(&damage->output_precommit.link);
 	wl_list_remove(&damage->link);
@@ -92,6 +285,7 @@ static struct screencopy_damage *screencopy_damage_create(
 	damage->output = output;
 	pixman_region32_init_rect(&damage->damage, 0, 0, output->width,
 		output->height);
+	wl_list_init(&damage->buffers);
 	wl_list_insert(&client->damages, &damage->link);
 
 	wl_signal_add(&output->events.precommit, &damage->output_precommit);
@@ -143,6 +337,16 @@ static void frame_destroy(struct wlr_screencopy_frame_v1 *frame) {
 			wlr_output_lock_software_cursors(frame->output, false);
 		}
 	}
+	if (frame->readback != NULL) {
+		wl_list_remove(&frame->readback_ready.link);
+		readback_unref(frame->readback);
+	}
+#if WLR_HAS_DRM_BACKEND
+	if (frame->writeback != NULL) {
+		wl_list_remove(&frame->writeback_done.link);
+		wlr_drm_writeback_destroy(frame->writeback);
+	}
+#endif
 	wl_list_remove(&frame->link);
 	wl_list_remove(&frame->output_commit.link);
 	wl_list_remove(&frame->output_destroy.link);
@@ -182,6 +386,83 @@ static void frame_send_damage(struct wlr_screencopy_frame_v1 *frame) {
 	pixman_region32_clear(&damage->damage);
 }
 
+/**
+ * Get the pixels of the frame's buffer which are out of date, in output buffer
+ * coordinates. Returns false if the buffer content is unknown and it needs to
+ * be filled entirely.
+ */
+static bool frame_get_buffer_damage(struct wlr_screencopy_frame_v1 *frame,
+		struct pixman_region32 *region) {
+	if (!frame->with_damage) {
+		return false;
+	}
+
+	struct screencopy_damage *damage =
+		screencopy_damage_find(frame->client, frame->output);
+	if (damage == NULL) {
+		return false;
+	}
+	struct screencopy_buffer_damage *buffer_damage =
+		screencopy_damage_find_buffer(damage, frame->buffer);
+	if (buffer_damage == NULL || buffer_damage->format != frame->shm_format ||
+			!wlr_box_equal(&buffer_damage->box, &frame->box)) {
+		return false;
+	}
+
+	pixman_region32_intersect_rect(region, &buffer_damage->damage,
+		frame->box.x, frame->box.y, frame->box.width, frame->box.height);
+	return true;
+}
+
+/**
+ * Remember that the frame's buffer holds the pixels of the current commit, or
+ * forget about it if the copy failed.
+ */
+static void frame_track_buffer(struct wlr_screencopy_frame_v1 *frame, bool filled) {
+	if (!frame->with_damage || frame->buffer_cap != WLR_BUFFER_CAP_DATA_PTR) {
+		return;
+	}
+
+	struct screencopy_damage *damage =
+		screencopy_damage_find(frame->client, frame->output);
+	if (damage == NULL) {
+		return;
+	}
+
+	struct screencopy_buffer_damage *buffer_damage =
+		screencopy_damage_find_buffer(damage, frame->buffer);
+	if (!filled) {
+		if (buffer_damage != NULL) {
+			buffer_damage_destroy(buffer_damage);
+		}
+		return;
+	}
+
+	if (buffer_damage == NULL) {
+		if (wl_list_length(&damage->buffers) >= SCREENCOPY_MAX_TRACKED_BUFFERS) {
+			struct screencopy_buffer_damage *oldest =
+				wl_container_of(damage->buffers.prev, oldest, link);
+			buffer_damage_destroy(oldest);
+		}
+
+		buffer_damage = calloc(1, sizeof(*buffer_damage));
+		if (buffer_damage == NULL) {
+			return;
+		}
+		buffer_damage->buffer = frame->buffer;
+		pixman_region32_init(&buffer_damage->damage);
+		buffer_damage->buffer_destroy.notify = buffer_damage_handle_buffer_destroy;
+		wl_signal_add(&frame->buffer->events.destroy, &buffer_damage->buffer_destroy);
+	} else {
+		wl_list_remove(&buffer_damage->link);
+	}
+	wl_list_insert(&damage->buffers, &buffer_damage->link);
+
+	buffer_damage->format = frame->shm_format;
+	buffer_damage->box = frame->box;
+	pixman_region32_clear(&buffer_damage->damage);
+}
+
 static void frame_send_ready(struct wlr_screencopy_frame_v1 *frame,
 		struct timespec *when) {
 	time_t tv_sec = when->tv_sec;
@@ -191,11 +472,116 @@ static void frame_send_ready(struct wlr_screencopy_frame_v1 *frame,
 		tv_sec_hi, tv_sec_lo, when->tv_nsec);
 }
 
-static bool frame_shm_copy(struct wlr_screencopy_frame_v1 *frame,
+static void frame_handle_readback_ready(struct wl_listener *listener,
+		void *data) {
+	struct wlr_screencopy_frame_v1 *frame =
+		wl_container_of(listener, frame, readback_ready);
+	struct wlr_screencopy_v1_readback *readback = frame->readback;
+
+	wl_list_remove(&frame->readback_ready.link);
+	frame->readback = NULL;
+
+	bool ok = false;
+	void *ptr;
+	uint32_t format;
+	size_t stride;
+	if (wlr_buffer_begin_data_ptr_access(frame->buffer,
+			WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &ptr, &format, &stride)) {
+		ok = wlr_texture_readback_copy(readback->readback, ptr, stride);
+		wlr_buffer_end_data_ptr_access(frame->buffer);
+	}
+	readback_unref(readback);
+
+	if (ok) {
+		frame_send_ready(frame, &frame->readback_when);
+	} else {
+		frame_track_buffer(frame, false);
+		wlr_log(WLR_DEBUG, "Failed to copy to destination during shm screencopy");
+		zwlr_screencopy_frame_v1_send_failed(frame->resource);
+	}
+	frame_destroy(frame);
+}
+
+static void frame_wait_readback(struct wlr_screencopy_frame_v1 *frame,
+		struct wlr_screencopy_v1_readback *readback, const struct timespec *when) {
+	readback->n_refs++;
+	frame->readback = readback;
+	frame->readback_when = *when;
+	frame->readback_ready.notify = frame_handle_readback_ready;
+	wl_signal_add(&readback->readback->events.ready, &frame->readback_ready);
+}
+
+/**
+ * Copy pixels read back synchronously for another frame to the frame's shm
+ * buffer.
+ */
+static bool frame_shm_copy_from(struct wlr_screencopy_frame_v1 *frame,
 		struct wlr_buffer *src_buffer) {
-	struct wlr_output *output = frame->output;
-	struct wlr_renderer *renderer = output->renderer;
-	assert(renderer);
+	void *src, *dst;
+	uint32_t src_format, dst_format;
+	size_t src_stride, dst_stride;
+	if (!wlr_buffer_begin_data_ptr_access(src_buffer,
+			WLR_BUFFER_DATA_PTR_ACCESS_READ, &src, &src_format, &src_stride)) {
+		return false;
+	}
+	if (!wlr_buffer_begin_data_ptr_access(frame->buffer,
+			WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &dst, &dst_format, &dst_stride)) {
+		wlr_buffer_end_data_ptr_access(src_buffer);
+		return false;
+	}
+
+	// Both buffers use the frame's format and minimum stride
+	assert(src_stride == dst_stride);
+	memcpy(dst, src, dst_stride * frame->box.height);
+
+	wlr_buffer_end_data_ptr_access(frame->buffer);
+	wlr_buffer_end_data_ptr_access(src_buffer);
+	return true;
+}
+
+/**
+ * Only copy the damaged pixels to a frame's shm buffer which already holds an
+ * older capture. Asynchronous readbacks read the extents of the damage, so
+ * that the frame only waits for a single readback.
+ */
+static bool frame_shm_copy_damage(struct wlr_screencopy_frame_v1 *frame,
+		struct screencopy_capture *capture, const struct pixman_region32 *damage,
+		const struct timespec *when) {
+	if (!pixman_region32_not_empty(damage)) {
+		return true;
+	}
+
+	struct wlr_texture *texture = capture_get_texture(capture);
+	if (!texture) {
+		wlr_log(WLR_DEBUG, "Failed to grab a texture from a buffer during shm screencopy");
+		return false;
+	}
+
+	const pixman_box32_t *extents = pixman_region32_extents(damage);
+	struct wlr_texture_readback *texture_readback = wlr_texture_read_pixels_async(texture,
+		&(struct wlr_texture_read_pixels_options) {
+			.format = frame->shm_format,
+			.dst_x = extents->x1 - frame->box.x,
+			.dst_y = extents->y1 - frame->box.y,
+			.src_box = {
+				.x = extents->x1,
+				.y = extents->y1,
+				.width = extents->x2 - extents->x1,
+				.height = extents->y2 - extents->y1,
+			},
+		}, capture->output->event_loop);
+	if (texture_readback != NULL) {
+		// Specific to this frame's buffer, not shared with other frames
+		struct wlr_screencopy_v1_readback *readback = calloc(1, sizeof(*readback));
+		if (readback == NULL) {
+			wlr_texture_readback_destroy(texture_readback);
+			return false;
+		}
+		readback->readback = texture_readback;
+		wl_list_init(&readback->link);
+		frame_wait_readback(frame, readback, when);
+		return true;
+	}
 
 	void *data;
 	uint32_t format;
@@ -205,42 +591,125 @@ static bool frame_shm_copy(struct wlr_screencopy_frame_v1 *frame,
 		return false;
 	}
 
-	bool ok = false;
+	bool ok = true;
+	int rects_len;
+	const pixman_box32_t *rects = pixman_region32_rectangles(damage, &rects_len);
+	for (int i = 0; i < rects_len && ok; i++) {
+		const pixman_box32_t *rect = &rects[i];
+		ok = wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options) {
+			.data = data,
+			.format = format,
+			.stride = stride,
+			.dst_x = rect->x1 - frame->box.x,
+			.dst_y = rect->y1 - frame->box.y,
+			.src_box = {
+				.x = rect->x1,
+				.y = rect->y1,
+				.width = rect->x2 - rect->x1,
+				.height = rect->y2 - rect->y1,
+			},
+		});
+	}
+	wlr_buffer_end_data_ptr_access(frame->buffer);
 
-	struct wlr_texture *texture = wlr_texture_from_buffer(renderer, src_buffer);
+	if (!ok) {
+		wlr_log(WLR_DEBUG, "Failed to copy to destination during shm screencopy");
+	}
+	return ok;
+}
+
+/**
+ * Copy the captured buffer to the frame's shm buffer. Each region is only read
+ * back once per format, frames capturing the same region reuse the pixels. If
+ * the renderer supports it, the pixels are read back asynchronously:
+ * frame->readback is then set and the frame becomes ready once the readback
+ * completes.
+ */
+static bool frame_shm_copy(struct wlr_screencopy_frame_v1 *frame,
+		struct screencopy_capture *capture, const struct timespec *when) {
+	struct pixman_region32 damage;
+	pixman_region32_init(&damage);
+	if (frame_get_buffer_damage(frame, &damage)) {
+		bool ok = frame_shm_copy_damage(frame, capture, &damage, when);
+		pixman_region32_fini(&damage);
+		return ok;
+	}
+	pixman_region32_fini(&damage);
+
+	struct wlr_screencopy_v1_readback *readback =
+		capture_find_readback(capture, frame->shm_format, &frame->box);
+	if (readback != NULL) {
+		if (readback->readback != NULL) {
+			frame_wait_readback(frame, readback, when);
+			return true;
+		}
+		if (frame_shm_copy_from(frame, readback->buffer)) {
+			return true;
+		}
+		wlr_log(WLR_DEBUG, "Failed to copy to destination during shm screencopy");
+		return false;
+	}
+
+	struct wlr_texture *texture = capture_get_texture(capture);
 	if (!texture) {
 		wlr_log(WLR_DEBUG, "Failed to grab a texture from a buffer during shm screencopy");
-		goto out;
+		return false;
 	}
 
-	ok = wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options) {
-		.data = data,
-		.format = format,
-		.stride = stride,
-		.src_box = frame->box,
-	});
-
-	wlr_texture_destroy(texture);
+	readback = calloc(1, sizeof(*readback));
+	if (readback == NULL) {
+		return false;
+	}
+	readback->n_refs = 1;
+	readback->format = frame->shm_format;
+	readback->box = frame->box;
+
+	readback->readback = wlr_texture_read_pixels_async(texture,
+		&(struct wlr_texture_read_pixels_options) {
+			.format = frame->shm_format,
+			.src_box = frame->box,
+		}, capture->output->event_loop);
+	if (readback->readback != NULL) {
+		wl_list_insert(&capture->readbacks, &readback->link);
+		frame_wait_readback(frame, readback, when);
+		return true;
+	}
 
-out:
-	wlr_buffer_end_data_ptr_access(frame->buffer);
+	void *data;
+	uint32_t format;
+	size_t stride;
+	bool ok = false;
+	if (wlr_buffer_begin_data_ptr_access(frame->buffer,
+			WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &data, &format, &stride)) {
+		ok = wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options) {
+			.data = data,
+			.format = format,
+			.stride = stride,
+			.src_box = frame->box,
+		});
+		wlr_buffer_end_data_ptr_access(frame->buffer);
+	}
 
 	if (!ok) {
 		wlr_log(WLR_DEBUG, "Failed to copy to destination during shm screencopy");
+		free(readback);
+		return false;
 	}
 
-	return ok;
+	// Other frames capturing the same region copy from this frame's buffer
+	readback->buffer = wlr_buffer_lock(frame->buffer);
+	wl_list_insert(&capture->readbacks, &readback->link);
+	return true;
 }
 
 static bool frame_dma_copy(struct wlr_screencopy_frame_v1 *frame,
-		struct wlr_buffer *src_buffer) {
+		struct screencopy_capture *capture) {
 	struct wlr_buffer *dst_buffer = frame->buffer;
 	struct wlr_output *output = frame->output;
 	struct wlr_renderer *renderer = output->renderer;
 	assert(renderer);
 
-	struct wlr_texture *src_tex =
-		wlr_texture_from_buffer(renderer, src_buffer);
+	struct wlr_texture *src_tex = capture_get_texture(capture);
 	if (src_tex == NULL) {
 		wlr_log(WLR_DEBUG, "Failed to grab a texture from a buffer during dma screencopy");
 		return false;
@@ -272,8 +741,6 @@ static bool frame_dma_copy(struct wlr_screencopy_frame_v1 *frame,
 	ok = wlr_render_pass_submit(pass);
 
 out:
-	wlr_texture_destroy(src_tex);
-
 	if (!ok) {
 		wlr_log(WLR_DEBUG, "Failed to render to destination during dma screencopy");
 	}
@@ -314,16 +781,24 @@ static void frame_handle_output_commit(struct wl_listener *listener,
 		goto err;
 	}
 
+	struct screencopy_capture *capture =
+		capture_get_or_create(frame->client->manager, output, src_buffer);
+	if (capture == NULL) {
+		goto err;
+	}
+
 	switch (frame->buffer_cap) {
 	case WLR_BUFFER_CAP_DMABUF:
-		if (!frame_dma_copy(frame, src_buffer)) {
+		if (!frame_dma_copy(frame, capture)) {
 			goto err;
 		}
 		break;
 	case WLR_BUFFER_CAP_DATA_PTR:
-		if (!frame_shm_copy(frame, src_buffer)) {
+		if (!frame_shm_copy(frame, capture, event->when)) {
+			frame_track_buffer(frame, false);
 			goto err;
 		}
+		frame_track_buffer(frame, true);
 		break;
 	default:
 		abort(); // unreachable
@@ -331,6 +806,10 @@ static void frame_handle_output_commit(struct wl_listener *listener,
 
 	zwlr_screencopy_frame_v1_send_flags(frame->resource, 0);
 	frame_send_damage(frame);
+	if (frame->readback != NULL) {
+		// The ready event is sent once the pixels have been read back
+		return;
+	}
 	frame_send_ready(frame, event->when);
 	frame_destroy(frame);
 	return;
@@ -340,6 +819,64 @@ err:
 	frame_destroy(frame);
 }
 
+#if WLR_HAS_DRM_BACKEND
+static void frame_handle_writeback_done(struct wl_listener *listener,
+		void *data) {
+	struct wlr_screencopy_frame_v1 *frame =
+		wl_container_of(listener, frame, writeback_done);
+	struct wlr_drm_writeback *writeback = frame->writeback;
+
+	wl_list_remove(&frame->writeback_done.link);
+	frame->writeback = NULL;
+	bool success = writeback->success;
+	wlr_drm_writeback_destroy(writeback);
+
+	if (!success) {
+		// Copy the next frame with the renderer instead
+		wl_signal_add(&frame->output->events.commit, &frame->output_commit);
+		frame->output_commit.notify = frame_handle_output_commit;
+		wlr_output_update_needs_frame(frame->output);
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	zwlr_screencopy_frame_v1_send_flags(frame->resource, 0);
+	frame_send_ready(frame, &now);
+	frame_destroy(frame);
+}
+#endif
+
+/**
+ * Let a KMS writeback connector capture the next frame, without any GPU
+ * copy. Only used when the capture is exactly what the CRTC scans out: the
+ * whole output, including the cursor.
+ */
+static bool frame_start_writeback(struct wlr_screencopy_frame_v1 *frame) {
+#if WLR_HAS_DRM_BACKEND
+	struct wlr_output *output = frame->output;
+	if (frame->buffer_cap != WLR_BUFFER_CAP_DMABUF || frame->with_damage ||
+			!frame->overlay_cursor || !wlr_output_is_drm(output) ||
+			frame->box.x != 0 || frame->box.y != 0 ||
+			frame->box.width != output->width ||
+			frame->box.height != output->height) {
+		return false;
+	}
+
+	frame->writeback = wlr_drm_writeback_create(output, frame->buffer);
+	if (frame->writeback == NULL) {
+		return false;
+	}
+
+	frame->writeback_done.notify = frame_handle_writeback_done;
+	wl_signal_add(&frame->writeback->events.done, &frame->writeback_done);
+	return true;
+#else
+	return false;
+#endif
+}
+
 static void frame_handle_output_enable(struct wl_listener *listener,
 		void *data) {
 	struct wlr_screencopy_frame_v1 *frame =
@@ -438,12 +975,14 @@ static void frame_handle_copy(struct wl_client *wl_client,
 	frame->buffer = buffer;
 	frame->buffer_cap = cap;
 
-	wl_signal_add(&output->events.commit, &frame->output_commit);
-	frame->output_commit.notify = frame_handle_output_commit;
-
 	wl_signal_add(&output->events.destroy, &frame->output_enable);
 	frame->output_enable.notify = frame_handle_output_enable;
 
+	if (!frame_start_writeback(frame)) {
+		wl_signal_add(&output->events.commit, &frame->output_commit);
+		frame->output_commit.notify = frame_handle_output_commit;
+	}
+
 	// Request a frame because we can't assume that the current front buffer is still usable. It may
 	// have been released already, and we shouldn't lock it here because compositors want to render
 	// into the least damaged buffer.
@@ -700,6 +1239,10 @@ static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_screencopy_manager_v1 *manager =
 		wl_container_of(listener, manager, display_destroy);
 	wl_signal_emit_mutable(&manager->events.destroy, manager);
+	struct screencopy_capture *capture, *tmp_capture;
+	wl_list_for_each_safe(capture, tmp_capture, &manager->captures, link) {
+		capture_destroy(capture);
+	}
 	wl_list_remove(&manager->display_destroy.link);
 	wl_global_destroy(manager->global);
 	free(manager);
@@ -720,6 +1263,7 @@ struct wlr_screencopy_manager_v1 *wlr_screencopy_manager_v1_create(
 		return NULL;
 	}
 	wl_list_init(&manager->frames);
+	wl_list_init(&manager->captures);
 
 	wl_signal_init(&manager->events.destroy);
 
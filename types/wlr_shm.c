@@ -1,19 +1,27 @@
 #undef _POSIX_C_SOURCE
-#define _DEFAULT_SOURCE // for MAP_ANONYMOUS
+#define _GNU_SOURCE // for MAP_ANONYMOUS and mremap()
 #include <assert.h>
 #include <drm_fourcc.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <stdatomic.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 #include <unistd.h>
 #include <wayland-server-protocol.h>
+#include <wlr/config.h>
 #include <wlr/interfaces/wlr_buffer.h>
 #include <wlr/render/drm_format_set.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_shm.h>
 #include <wlr/util/log.h>
 #include "render/pixel_format.h"
+#include "util/env.h"
+
+#if WLR_HAS_UDMABUF_ALLOCATOR
+#include <linux/udmabuf.h>
+#include <sys/ioctl.h>
+#endif
 
 #ifdef __STDC_NO_ATOMICS__
 #error "C11 atomics are required"
@@ -30,6 +38,11 @@ struct wlr_shm_pool {
 	struct wl_list buffers; // wlr_shm_buffer.link
 	int fd;
 	struct wlr_shm_mapping *mapping;
+
+	// DMA-BUF wrapping the whole pool, created on demand, -1 if none
+	int udmabuf_fd;
+	size_t udmabuf_size;
+	bool udmabuf_failed;
 };
 
 /**
@@ -48,7 +61,6 @@ struct wlr_shm_mapping {
 
 struct wlr_shm_sigbus_data {
 	struct wlr_shm_mapping *mapping;
-	struct sigaction prev_action;
 	struct wlr_shm_sigbus_data *_Atomic next;
 };
 
@@ -64,11 +76,16 @@ struct wlr_shm_buffer {
 	struct wl_listener release;
 
 	struct wlr_shm_sigbus_data sigbus_data;
+	bool prefaulted;
 };
 
 // Needs to be a lock-free atomic because it's accessed from a signal handler
 static struct wlr_shm_sigbus_data *_Atomic sigbus_data = NULL;
 
+// The SIGBUS handler is installed on first access and stays installed
+static bool sigbus_handler_installed = false;
+static struct sigaction sigbus_prev_action;
+
 static const struct wl_buffer_interface wl_buffer_impl;
 static const struct wl_shm_pool_interface pool_impl;
 static const struct wl_shm_interface shm_impl;
@@ -98,12 +115,25 @@ static struct wlr_shm *shm_from_resource(struct wl_resource *resource) {
 	return wl_resource_get_user_data(resource);
 }
 
+// Large pools are usually backed by memfds: let the kernel use huge pages for
+// them if it's configured to do so on request.
+#define SHM_HUGEPAGE_MIN_SIZE (2 * 1024 * 1024)
+
+static void mapping_advise(void *data, size_t size) {
+#ifdef MADV_HUGEPAGE
+	if (size >= SHM_HUGEPAGE_MIN_SIZE) {
+		madvise(data, size, MADV_HUGEPAGE);
+	}
+#endif
+}
+
 static struct wlr_shm_mapping *mapping_create(int fd, size_t size) {
 	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 	if (data == MAP_FAILED) {
 		wlr_log_errno(WLR_DEBUG, "mmap failed");
 		return NULL;
 	}
+	mapping_advise(data, size);
 
 	struct wlr_shm_mapping *mapping = calloc(1, sizeof(*mapping));
 	if (mapping == NULL) {
@@ -116,16 +146,44 @@ static struct wlr_shm_mapping *mapping_create(int fd, size_t size) {
 	return mapping;
 }
 
-static void mapping_consider_destroy(struct wlr_shm_mapping *mapping) {
-	if (!mapping->dropped) {
-		return;
-	}
-
+static bool mapping_is_accessed(struct wlr_shm_mapping *mapping) {
 	for (struct wlr_shm_sigbus_data *cur = sigbus_data; cur != NULL; cur = cur->next) {
 		if (cur->mapping == mapping) {
-			return;
+			return true;
 		}
 	}
+	return false;
+}
+
+/**
+ * Grow a mapping in place. This is only possible if nobody is accessing the
+ * mapping, since its address may change.
+ */
+static bool mapping_resize(struct wlr_shm_mapping *mapping, size_t size) {
+#ifdef MREMAP_MAYMOVE
+	if (mapping_is_accessed(mapping)) {
+		return false;
+	}
+
+	void *data = mremap(mapping->data, mapping->size, size, MREMAP_MAYMOVE);
+	if (data == MAP_FAILED) {
+		wlr_log_errno(WLR_DEBUG, "mremap failed");
+		return false;
+	}
+	mapping_advise(data, size);
+
+	mapping->data = data;
+	mapping->size = size;
+	return true;
+#else
+	return false;
+#endif
+}
+
+static void mapping_consider_destroy(struct wlr_shm_mapping *mapping) {
+	if (!mapping->dropped || mapping_is_accessed(mapping)) {
+		return;
+	}
 
 	munmap(mapping->data, mapping->size);
 	free(mapping);
@@ -179,9 +237,73 @@ static bool buffer_get_shm(struct wlr_buffer *wlr_buffer,
 	return true;
 }
 
+#if WLR_HAS_UDMABUF_ALLOCATOR
+static bool pool_ensure_udmabuf(struct wlr_shm_pool *pool) {
+	if (pool->udmabuf_fd >= 0) {
+		return true;
+	} else if (pool->udmabuf_failed) {
+		return false;
+	}
+
+	// udmabuf only accepts memfds which can't shrink and can still be
+	// written to, and only whole pages
+	int seals = fcntl(pool->fd, F_GET_SEALS);
+	long page_size = sysconf(_SC_PAGE_SIZE);
+	if (seals < 0 || !(seals & F_SEAL_SHRINK) || (seals & F_SEAL_WRITE) ||
+			page_size <= 0) {
+		pool->udmabuf_failed = true;
+		return false;
+	}
+
+	size_t size = pool->mapping->size - pool->mapping->size % page_size;
+	struct udmabuf_create udmabuf_create = {
+		.memfd = pool->fd,
+		.flags = UDMABUF_FLAGS_CLOEXEC,
+		.offset = 0,
+		.size = size,
+	};
+	int fd = ioctl(pool->shm->udmabuf_fd, UDMABUF_CREATE, &udmabuf_create);
+	if (fd < 0) {
+		wlr_log_errno(WLR_DEBUG, "ioctl(UDMABUF_CREATE) failed");
+		pool->udmabuf_failed = true;
+		return false;
+	}
+
+	pool->udmabuf_fd = fd;
+	pool->udmabuf_size = size;
+	return true;
+}
+
+static bool buffer_get_dmabuf(struct wlr_buffer *wlr_buffer,
+		struct wlr_dmabuf_attributes *attribs) {
+	struct wlr_shm_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
+	struct wlr_shm_pool *pool = buffer->pool;
+
+	if (pool->shm->udmabuf_fd < 0 ||
+			!wlr_drm_format_set_has(&pool->shm->udmabuf_formats,
+				buffer->drm_format, DRM_FORMAT_MOD_LINEAR) ||
+			!pool_ensure_udmabuf(pool) ||
+			(size_t)buffer->offset + (size_t)buffer->stride * buffer->base.height >
+				pool->udmabuf_size) {
+		return false;
+	}
+
+	*attribs = (struct wlr_dmabuf_attributes){
+		.width = buffer->base.width,
+		.height = buffer->base.height,
+		.format = buffer->drm_format,
+		.modifier = DRM_FORMAT_MOD_LINEAR,
+		.n_planes = 1,
+		.offset[0] = buffer->offset,
+		.stride[0] = buffer->stride,
+		.fd[0] = pool->udmabuf_fd,
+	};
+	return true;
+}
+#endif
+
 static void handle_sigbus(int sig, siginfo_t *info, void *context) {
-	assert(sigbus_data != NULL);
-	struct sigaction prev_action = sigbus_data->prev_action;
+	struct sigaction prev_action = sigbus_prev_action;
 
 	// Check whether the offending address is inside of the wl_shm_pool's mapped
 	// space
@@ -212,6 +334,10 @@ static void handle_sigbus(int sig, siginfo_t *info, void *context) {
 reraise:
 	if (prev_action.sa_flags & SA_SIGINFO) {
 		prev_action.sa_sigaction(sig, info, context);
+	} else if (prev_action.sa_handler == SIG_DFL || prev_action.sa_handler == SIG_IGN) {
+		// Restore the default action, the faulting access will be retried
+		// once we return
+		sigaction(SIGBUS, &prev_action, NULL);
 	} else {
 		prev_action.sa_handler(sig);
 	}
@@ -227,31 +353,43 @@ static bool buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer,
 	}
 
 	// Install a SIGBUS handler. SIGBUS is triggered if the client shrinks the
-	// backing file, and then we try to access the mapping.
-	struct sigaction prev_action;
-	if (sigbus_data == NULL) {
+	// backing file, and then we try to access the mapping. Accesses happen
+	// on every upload, so the handler is kept around afterwards instead of
+	// being swapped in and out each time. It forwards signals it doesn't
+	// handle to the previous handler.
+	if (!sigbus_handler_installed) {
 		struct sigaction new_action = {
 			.sa_sigaction = handle_sigbus,
 			.sa_flags = SA_SIGINFO | SA_NODEFER,
 		};
-		if (sigaction(SIGBUS, &new_action, &prev_action) != 0) {
+		if (sigaction(SIGBUS, &new_action, &sigbus_prev_action) != 0) {
 			wlr_log_errno(WLR_ERROR, "sigaction failed");
 			return false;
 		}
-	} else {
-		prev_action = sigbus_data->prev_action;
+		sigbus_handler_installed = true;
 	}
 
 	struct wlr_shm_mapping *mapping = buffer->pool->mapping;
 
 	buffer->sigbus_data = (struct wlr_shm_sigbus_data){
 		.mapping = mapping,
-		.prev_action = prev_action,
 		.next = sigbus_data,
 	};
 	sigbus_data = &buffer->sigbus_data;
 
 	*data = (char *)mapping->data + buffer->offset;
+
+	// Ask the kernel to fault in the pages of the buffer ahead of the first
+	// read, rather than one page at a time during the upload
+	if (!buffer->prefaulted && (flags & WLR_BUFFER_DATA_PTR_ACCESS_READ)) {
+		uintptr_t page_size = sysconf(_SC_PAGESIZE);
+		uintptr_t start = (uintptr_t)*data & ~(page_size - 1);
+		uintptr_t end = (uintptr_t)*data +
+			(size_t)buffer->stride * buffer->base.height;
+		madvise((void *)start, end - start, MADV_WILLNEED);
+		buffer->prefaulted = true;
+	}
+
 	*format = buffer->drm_format;
 	*stride = buffer->stride;
 	return true;
@@ -271,18 +409,15 @@ static void buffer_end_data_ptr_access(struct wlr_buffer *wlr_buffer) {
 		}
 	}
 
-	if (sigbus_data == NULL) {
-		if (sigaction(SIGBUS, &buffer->sigbus_data.prev_action, NULL) != 0) {
-			wlr_log_errno(WLR_ERROR, "sigaction failed");
-		}
-	}
-
 	mapping_consider_destroy(buffer->sigbus_data.mapping);
 }
 
 static const struct wlr_buffer_impl buffer_impl = {
 	.destroy = buffer_destroy,
 	.get_shm = buffer_get_shm,
+#if WLR_HAS_UDMABUF_ALLOCATOR
+	.get_dmabuf = buffer_get_dmabuf,
+#endif
 	.begin_data_ptr_access = buffer_begin_data_ptr_access,
 	.end_data_ptr_access = buffer_end_data_ptr_access,
 };
@@ -383,6 +518,22 @@ static void pool_handle_resize(struct wl_client *client,
 		return;
 	}
 
+	if ((size_t)size == pool->mapping->size) {
+		return;
+	}
+
+	// The DMA-BUF only covers the old size, re-create it on next use.
+	// Textures imported from it keep a reference to the old one.
+	if (pool->udmabuf_fd >= 0) {
+		close(pool->udmabuf_fd);
+		pool->udmabuf_fd = -1;
+	}
+	pool->udmabuf_failed = false;
+
+	if (mapping_resize(pool->mapping, size)) {
+		return;
+	}
+
 	struct wlr_shm_mapping *mapping = mapping_create(pool->fd, size);
 	if (mapping == NULL) {
 		wl_resource_post_error(pool_resource, WL_SHM_ERROR_INVALID_FD,
@@ -406,6 +557,9 @@ static void pool_consider_destroy(struct wlr_shm_pool *pool) {
 	}
 
 	mapping_drop(pool->mapping);
+	if (pool->udmabuf_fd >= 0) {
+		close(pool->udmabuf_fd);
+	}
 	close(pool->fd);
 	free(pool);
 }
@@ -452,6 +606,7 @@ static void shm_handle_create_pool(struct wl_client *client,
 	pool->mapping = mapping;
 	pool->shm = shm;
 	pool->fd = fd;
+	pool->udmabuf_fd = -1;
 	wl_list_init(&pool->buffers);
 	return;
 
@@ -494,6 +649,10 @@ static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_shm *shm = wl_container_of(listener, shm, display_destroy);
 	wl_list_remove(&shm->display_destroy.link);
 	wl_global_destroy(shm->global);
+	if (shm->udmabuf_fd >= 0) {
+		close(shm->udmabuf_fd);
+	}
+	wlr_drm_format_set_finish(&shm->udmabuf_formats);
 	free(shm->formats);
 	free(shm);
 }
@@ -521,6 +680,7 @@ struct wlr_shm *wlr_shm_create(struct wl_display *display, uint32_t version,
 		wlr_log(WLR_ERROR, "Allocation failed");
 		return NULL;
 	}
+	shm->udmabuf_fd = -1;
 
 	shm->formats_len = formats_len;
 	shm->formats = malloc(formats_len * sizeof(uint32_t));
@@ -550,6 +710,35 @@ struct wlr_shm *wlr_shm_create(struct wl_display *display, uint32_t version,
 	return shm;
 }
 
+#if WLR_HAS_UDMABUF_ALLOCATOR
+static void shm_init_udmabuf(struct wlr_shm *shm, struct wlr_renderer *renderer) {
+	const struct wlr_drm_format_set *dmabuf_formats =
+		wlr_renderer_get_texture_formats(renderer, WLR_BUFFER_CAP_DMABUF);
+	if (dmabuf_formats == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < shm->formats_len; i++) {
+		uint32_t format = convert_wl_shm_format_to_drm(shm->formats[i]);
+		if (wlr_drm_format_set_has(dmabuf_formats, format, DRM_FORMAT_MOD_LINEAR)) {
+			wlr_drm_format_set_add(&shm->udmabuf_formats, format,
+				DRM_FORMAT_MOD_LINEAR);
+		}
+	}
+	if (shm->udmabuf_formats.len == 0) {
+		wlr_log(WLR_DEBUG, "Renderer can't import linear DMA-BUFs, "
+			"not importing shm buffers via udmabuf");
+		return;
+	}
+
+	shm->udmabuf_fd = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+	if (shm->udmabuf_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to open /dev/udmabuf");
+		wlr_drm_format_set_finish(&shm->udmabuf_formats);
+	}
+}
+#endif
+
 struct wlr_shm *wlr_shm_create_with_renderer(struct wl_display *display,
 		uint32_t version, struct wlr_renderer *renderer) {
 	const struct wlr_drm_format_set *format_set =
@@ -572,6 +761,16 @@ struct wlr_shm *wlr_shm_create_with_renderer(struct wl_display *display,
 
 	struct wlr_shm *shm = wlr_shm_create(display, version, formats, formats_len);
 	free(formats);
+	if (shm == NULL) {
+		return NULL;
+	}
+
+#if WLR_HAS_UDMABUF_ALLOCATOR
+	if (env_parse_bool("WLR_SHM_UDMABUF")) {
+		shm_init_udmabuf(shm, renderer);
+	}
+#endif
+
 	return shm;
 }
 
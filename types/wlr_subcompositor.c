@@ -69,6 +69,7 @@ static void subsurface_handle_set_position(struct wl_client *client,
 
 	subsurface->pending.x = x;
 	subsurface->pending.y = y;
+	subsurface->parent->pending.committed |= WLR_SURFACE_STATE_SUBSURFACES;
 }
 
 static struct wlr_subsurface *subsurface_find_sibling(
@@ -118,6 +119,7 @@ static void subsurface_handle_place_above(struct wl_client *client,
 
 	wl_list_remove(&subsurface->pending.link);
 	wl_list_insert(node, &subsurface->pending.link);
+	subsurface->parent->pending.committed |= WLR_SURFACE_STATE_SUBSURFACES;
 }
 
 static void subsurface_handle_place_below(struct wl_client *client,
@@ -148,6 +150,7 @@ static void subsurface_handle_place_below(struct wl_client *client,
 
 	wl_list_remove(&subsurface->pending.link);
 	wl_list_insert(node->prev, &subsurface->pending.link);
+	subsurface->parent->pending.committed |= WLR_SURFACE_STATE_SUBSURFACES;
 }
 
 static void subsurface_handle_set_sync(struct wl_client *client,
@@ -381,6 +384,7 @@ static void subcompositor_handle_get_subsurface(struct wl_client *client,
 	wl_list_remove(&subsurface->pending.link);
 	wl_list_insert(parent->pending.subsurfaces_above.prev,
 		&subsurface->pending.link);
+	parent->pending.committed |= WLR_SURFACE_STATE_SUBSURFACES;
 }
 
 static const struct wl_subcompositor_interface subcompositor_impl = {
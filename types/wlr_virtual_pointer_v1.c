@@ -20,6 +20,50 @@ static struct wlr_virtual_pointer_v1 *virtual_pointer_from_resource(
 	return wl_resource_get_user_data(resource);
 }
 
+static void virtual_pointer_flush_motion(struct wlr_virtual_pointer_v1 *pointer) {
+	if (pointer->motion_pending) {
+		pointer->motion_pending = false;
+		wl_signal_emit_mutable(&pointer->pointer.events.motion,
+			&pointer->pending_motion);
+	}
+	if (pointer->motion_absolute_pending) {
+		pointer->motion_absolute_pending = false;
+		wl_signal_emit_mutable(&pointer->pointer.events.motion_absolute,
+			&pointer->pending_motion_absolute);
+	}
+}
+
+static void virtual_pointer_flush_frame(struct wlr_virtual_pointer_v1 *pointer) {
+	if (pointer->idle_frame != NULL) {
+		wl_event_source_remove(pointer->idle_frame);
+		pointer->idle_frame = NULL;
+	}
+
+	virtual_pointer_flush_motion(pointer);
+
+	for (size_t i = 0;
+			i < sizeof(pointer->axis_valid) / sizeof(pointer->axis_valid[0]);
+			++i) {
+		if (pointer->axis_valid[i]) {
+			/* Deliver pending axis event */
+			wl_signal_emit_mutable(&pointer->pointer.events.axis,
+					&pointer->axis_event[i]);
+			pointer->axis_event[i] = (struct wlr_pointer_axis_event){0};
+			pointer->axis_valid[i] = false;
+		}
+	}
+
+	pointer->needs_frame = false;
+	wl_signal_emit_mutable(&pointer->pointer.events.frame, &pointer->pointer);
+}
+
+static int virtual_pointer_handle_idle_frame(void *data) {
+	struct wlr_virtual_pointer_v1 *pointer = data;
+	pointer->idle_frame = NULL;
+	virtual_pointer_flush_frame(pointer);
+	return 0;
+}
+
 static void virtual_pointer_motion(struct wl_client *client,
 		struct wl_resource *resource, uint32_t time,
 		wl_fixed_t dx, wl_fixed_t dy) {
@@ -36,7 +80,24 @@ static void virtual_pointer_motion(struct wl_client *client,
 		.unaccel_dx = wl_fixed_to_double(dx),
 		.unaccel_dy = wl_fixed_to_double(dy),
 	};
-	wl_signal_emit_mutable(&pointer->pointer.events.motion, &event);
+	if (!pointer->batching) {
+		wl_signal_emit_mutable(&pointer->pointer.events.motion, &event);
+		return;
+	}
+
+	if (pointer->motion_absolute_pending) {
+		virtual_pointer_flush_motion(pointer);
+	}
+	if (pointer->motion_pending) {
+		pointer->pending_motion.time_msec = event.time_msec;
+		pointer->pending_motion.delta_x += event.delta_x;
+		pointer->pending_motion.delta_y += event.delta_y;
+		pointer->pending_motion.unaccel_dx += event.unaccel_dx;
+		pointer->pending_motion.unaccel_dy += event.unaccel_dy;
+	} else {
+		pointer->pending_motion = event;
+		pointer->motion_pending = true;
+	}
 }
 
 static void virtual_pointer_motion_absolute(struct wl_client *client,
@@ -56,7 +117,16 @@ static void virtual_pointer_motion_absolute(struct wl_client *client,
 		.x = (double)x / x_extent,
 		.y = (double)y / y_extent,
 	};
-	wl_signal_emit_mutable(&pointer->pointer.events.motion_absolute, &event);
+	if (!pointer->batching) {
+		wl_signal_emit_mutable(&pointer->pointer.events.motion_absolute, &event);
+		return;
+	}
+
+	if (pointer->motion_pending) {
+		virtual_pointer_flush_motion(pointer);
+	}
+	pointer->pending_motion_absolute = event;
+	pointer->motion_absolute_pending = true;
 }
 
 static void virtual_pointer_button(struct wl_client *client,
@@ -73,6 +143,9 @@ static void virtual_pointer_button(struct wl_client *client,
 		.button = button,
 		.state = state ? WL_POINTER_BUTTON_STATE_PRESSED : WL_POINTER_BUTTON_STATE_RELEASED,
 	};
+	// The button applies at the current position
+	virtual_pointer_flush_motion(pointer);
+	pointer->needs_frame = true;
 	wlr_pointer_notify_button(&pointer->pointer, &event);
 }
 
@@ -106,19 +179,21 @@ static void virtual_pointer_frame(struct wl_client *client,
 		return;
 	}
 
-	for (size_t i = 0;
-			i < sizeof(pointer->axis_valid) / sizeof(pointer->axis_valid[0]);
-			++i) {
-		if (pointer->axis_valid[i]) {
-			/* Deliver pending axis event */
-			wl_signal_emit_mutable(&pointer->pointer.events.axis,
-					&pointer->axis_event[i]);
-			pointer->axis_event[i] = (struct wlr_pointer_axis_event){0};
-			pointer->axis_valid[i] = false;
+	if (pointer->batching && !pointer->needs_frame &&
+			!pointer->axis_valid[0] && !pointer->axis_valid[1]) {
+		// Only motion so far, wait for the rest of the client's requests
+		if (pointer->idle_frame == NULL) {
+			struct wl_event_loop *loop =
+				wl_display_get_event_loop(wl_client_get_display(client));
+			pointer->idle_frame = wl_event_loop_add_idle(loop,
+				virtual_pointer_handle_idle_frame, pointer);
+		}
+		if (pointer->idle_frame != NULL) {
+			return;
 		}
 	}
 
-	wl_signal_emit_mutable(&pointer->pointer.events.frame, &pointer->pointer);
+	virtual_pointer_flush_frame(pointer);
 }
 
 static void virtual_pointer_axis_source(struct wl_client *client,
@@ -191,6 +266,10 @@ static void virtual_pointer_destroy_resource(struct wl_resource *resource) {
 		return;
 	}
 
+	if (pointer->idle_frame != NULL) {
+		wl_event_source_remove(pointer->idle_frame);
+	}
+
 	wlr_pointer_finish(&pointer->pointer);
 
 	wl_resource_set_user_data(pointer->resource, NULL);
@@ -341,3 +420,14 @@ struct wlr_virtual_pointer_manager_v1* wlr_virtual_pointer_manager_v1_create(
 	wl_display_add_destroy_listener(display, &manager->display_destroy);
 	return manager;
 }
+
+void wlr_virtual_pointer_v1_set_batching(struct wlr_virtual_pointer_v1 *pointer,
+		bool batching) {
+	if (!batching && pointer->idle_frame != NULL) {
+		virtual_pointer_flush_frame(pointer);
+	} else if (!batching) {
+		// The client will send a frame for this motion later
+		virtual_pointer_flush_motion(pointer);
+	}
+	pointer->batching = batching;
+}
@@ -1,6 +1,95 @@
+#include <assert.h>
+#include <drm_fourcc.h>
 #include <stdlib.h>
 #include <string.h>
+#include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_xcursor_manager.h>
+#include "types/wlr_buffer.h"
+#include "types/wlr_xcursor_manager.h"
+
+/**
+ * A theme loaded at a given size, shared by all managers (e.g. one per seat)
+ * and all scales resolving to the same theme name and size. Cursors are
+ * decoded lazily by the theme, and the buffers wrapping their images are
+ * created once.
+ */
+struct xcursor_shared_theme {
+	char *name; // may be NULL
+	int size;
+	size_t refs;
+	struct wlr_xcursor_theme *theme;
+	struct wl_list image_buffers; // xcursor_image_buffer.link
+	struct wl_list link; // shared_themes
+};
+
+struct xcursor_image_buffer {
+	struct wlr_xcursor_image *image;
+	struct wlr_readonly_data_buffer *buffer;
+	struct wl_list link; // xcursor_shared_theme.image_buffers
+};
+
+static struct wl_list shared_themes = { &shared_themes, &shared_themes };
+
+static bool theme_name_equal(const char *a, const char *b) {
+	if (a == NULL || b == NULL) {
+		return a == b;
+	}
+	return strcmp(a, b) == 0;
+}
+
+static struct xcursor_shared_theme *shared_theme_get(const char *name,
+		int size) {
+	struct xcursor_shared_theme *shared;
+	wl_list_for_each(shared, &shared_themes, link) {
+		if (shared->size == size && theme_name_equal(shared->name, name)) {
+			shared->refs++;
+			return shared;
+		}
+	}
+
+	shared = calloc(1, sizeof(*shared));
+	if (shared == NULL) {
+		return NULL;
+	}
+	if (name != NULL) {
+		shared->name = strdup(name);
+		if (shared->name == NULL) {
+			free(shared);
+			return NULL;
+		}
+	}
+	shared->theme = wlr_xcursor_theme_load(name, size);
+	if (shared->theme == NULL) {
+		free(shared->name);
+		free(shared);
+		return NULL;
+	}
+	shared->size = size;
+	shared->refs = 1;
+	wl_list_init(&shared->image_buffers);
+	wl_list_insert(&shared_themes, &shared->link);
+	return shared;
+}
+
+static void shared_theme_unref(struct xcursor_shared_theme *shared) {
+	assert(shared->refs > 0);
+	shared->refs--;
+	if (shared->refs > 0) {
+		return;
+	}
+
+	// Drop the buffers first: they reference the theme images
+	struct xcursor_image_buffer *image_buffer, *tmp;
+	wl_list_for_each_safe(image_buffer, tmp, &shared->image_buffers, link) {
+		wl_list_remove(&image_buffer->link);
+		readonly_data_buffer_drop(image_buffer->buffer);
+		free(image_buffer);
+	}
+	wl_list_remove(&shared->link);
+	wlr_xcursor_theme_destroy(shared->theme);
+	free(shared->name);
+	free(shared);
+}
 
 struct wlr_xcursor_manager *wlr_xcursor_manager_create(const char *name,
 		uint32_t size) {
@@ -23,7 +112,7 @@ void wlr_xcursor_manager_destroy(struct wlr_xcursor_manager *manager) {
 	struct wlr_xcursor_manager_theme *theme, *tmp;
 	wl_list_for_each_safe(theme, tmp, &manager->scaled_themes, link) {
 		wl_list_remove(&theme->link);
-		wlr_xcursor_theme_destroy(theme->theme);
+		shared_theme_unref(theme->shared);
 		free(theme);
 	}
 	free(manager->name);
@@ -44,11 +133,12 @@ bool wlr_xcursor_manager_load(struct wlr_xcursor_manager *manager,
 		return false;
 	}
 	theme->scale = scale;
-	theme->theme = wlr_xcursor_theme_load(manager->name, manager->size * scale);
-	if (theme->theme == NULL) {
+	theme->shared = shared_theme_get(manager->name, manager->size * scale);
+	if (theme->shared == NULL) {
 		free(theme);
 		return false;
 	}
+	theme->theme = theme->shared->theme;
 	wl_list_insert(&manager->scaled_themes, &theme->link);
 	return true;
 }
@@ -63,3 +153,51 @@ struct wlr_xcursor *wlr_xcursor_manager_get_xcursor(
 	}
 	return NULL;
 }
+
+static struct xcursor_shared_theme *manager_find_image_theme(
+		struct wlr_xcursor_manager *manager, struct wlr_xcursor_image *image) {
+	struct wlr_xcursor_manager_theme *theme;
+	wl_list_for_each(theme, &manager->scaled_themes, link) {
+		for (unsigned int i = 0; i < theme->theme->cursor_count; i++) {
+			struct wlr_xcursor *cursor = theme->theme->cursors[i];
+			for (unsigned int j = 0; j < cursor->image_count; j++) {
+				if (cursor->images[j] == image) {
+					return theme->shared;
+				}
+			}
+		}
+	}
+	return NULL;
+}
+
+struct wlr_buffer *xcursor_manager_get_image_buffer(
+		struct wlr_xcursor_manager *manager, struct wlr_xcursor_image *image) {
+	struct wlr_xcursor_manager_theme *theme;
+	struct xcursor_image_buffer *image_buffer;
+	wl_list_for_each(theme, &manager->scaled_themes, link) {
+		wl_list_for_each(image_buffer, &theme->shared->image_buffers, link) {
+			if (image_buffer->image == image) {
+				return &image_buffer->buffer->base;
+			}
+		}
+	}
+
+	struct xcursor_shared_theme *shared = manager_find_image_theme(manager, image);
+	if (shared == NULL) {
+		return NULL;
+	}
+
+	image_buffer = calloc(1, sizeof(*image_buffer));
+	if (image_buffer == NULL) {
+		return NULL;
+	}
+	image_buffer->buffer = readonly_data_buffer_create(DRM_FORMAT_ARGB8888,
+		4 * image->width, image->width, image->height, image->buffer);
+	if (image_buffer->buffer == NULL) {
+		free(image_buffer);
+		return NULL;
+	}
+	image_buffer->image = image;
+	wl_list_insert(&shared->image_buffers, &image_buffer->link);
+	return &image_buffer->buffer->base;
+}
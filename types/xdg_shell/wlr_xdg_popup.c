@@ -509,6 +509,40 @@ void wlr_xdg_popup_get_toplevel_coords(struct wlr_xdg_popup *popup,
 	*toplevel_sy = popup_sy;
 }
 
+static bool positioner_rules_equal(const struct wlr_xdg_positioner_rules *a,
+		const struct wlr_xdg_positioner_rules *b) {
+	// Only the fields used to unconstrain the box are compared
+	return wlr_box_equal(&a->anchor_rect, &b->anchor_rect) &&
+		a->anchor == b->anchor && a->gravity == b->gravity &&
+		a->constraint_adjustment == b->constraint_adjustment &&
+		a->size.width == b->size.width && a->size.height == b->size.height &&
+		a->offset.x == b->offset.x && a->offset.y == b->offset.y;
+}
+
+static void popup_unconstrain_box(struct wlr_xdg_popup *popup,
+		const struct wlr_box *constraint) {
+	struct wlr_xdg_positioner_rules *rules = &popup->scheduled.rules;
+	struct wlr_box *box = &popup->scheduled.geometry;
+
+	// Reactive popups are unconstrained again on every parent move, most of
+	// the time with the same inputs
+	if (popup->unconstrain_cache.valid &&
+			positioner_rules_equal(&popup->unconstrain_cache.rules, rules) &&
+			wlr_box_equal(&popup->unconstrain_cache.constraint, constraint) &&
+			wlr_box_equal(&popup->unconstrain_cache.box, box)) {
+		*box = popup->unconstrain_cache.result;
+		return;
+	}
+
+	popup->unconstrain_cache.valid = true;
+	popup->unconstrain_cache.rules = *rules;
+	popup->unconstrain_cache.constraint = *constraint;
+	popup->unconstrain_cache.box = *box;
+
+	wlr_xdg_positioner_rules_unconstrain_box(rules, constraint, box);
+	popup->unconstrain_cache.result = *box;
+}
+
 void wlr_xdg_popup_unconstrain_from_box(struct wlr_xdg_popup *popup,
 		const struct wlr_box *toplevel_space_box) {
 	int toplevel_sx, toplevel_sy;
@@ -520,7 +554,6 @@ void wlr_xdg_popup_unconstrain_from_box(struct wlr_xdg_popup *popup,
 		.width = toplevel_space_box->width,
 		.height = toplevel_space_box->height,
 	};
-	wlr_xdg_positioner_rules_unconstrain_box(&popup->scheduled.rules,
-		&popup_constraint, &popup->scheduled.geometry);
+	popup_unconstrain_box(popup, &popup_constraint);
 	wlr_xdg_surface_schedule_configure(popup->base);
 }
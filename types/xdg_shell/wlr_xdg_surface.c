@@ -41,6 +41,7 @@ static void reset_xdg_surface(struct wlr_xdg_surface *surface) {
 		wl_event_source_remove(surface->configure_idle);
 		surface->configure_idle = NULL;
 	}
+	surface->configure_throttled = false;
 }
 
 static void reset_xdg_surface_role_object(struct wlr_xdg_surface *surface) {
@@ -128,6 +129,16 @@ static void surface_send_configure(void *user_data) {
 
 	surface->configure_idle = NULL;
 
+	// During an interactive resize, only send the latest size once the client
+	// has acked and committed the previous configure
+	if (surface->role == WLR_XDG_SURFACE_ROLE_TOPLEVEL &&
+			surface->toplevel != NULL &&
+			xdg_toplevel_should_throttle_configure(surface->toplevel)) {
+		surface->configure_throttled = true;
+		return;
+	}
+	surface->configure_throttled = false;
+
 	struct wlr_xdg_surface_configure *configure = calloc(1, sizeof(*configure));
 	if (configure == NULL) {
 		wl_client_post_no_memory(surface->client->client);
@@ -181,6 +192,22 @@ uint32_t wlr_xdg_surface_schedule_configure(struct wlr_xdg_surface *surface) {
 	return surface->scheduled_serial;
 }
 
+static void resume_throttled_configure(struct wlr_xdg_surface *surface) {
+	if (!surface->configure_throttled || surface->configure_idle != NULL) {
+		return;
+	}
+
+	// Keep the serial returned to the compositor when the configure was
+	// scheduled
+	struct wl_display *display = wl_client_get_display(surface->client->client);
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	surface->configure_idle = wl_event_loop_add_idle(loop,
+		surface_send_configure, surface);
+	if (surface->configure_idle == NULL) {
+		wl_client_post_no_memory(surface->client->client);
+	}
+}
+
 static void xdg_surface_handle_get_popup(struct wl_client *client,
 		struct wl_resource *resource, uint32_t id,
 		struct wl_resource *parent_resource,
@@ -340,6 +367,8 @@ static void xdg_surface_role_commit(struct wlr_surface *wlr_surface) {
 	} else if (wlr_surface_has_buffer(wlr_surface)) {
 		wlr_surface_map(wlr_surface);
 	}
+
+	resume_throttled_configure(surface);
 }
 
 static void xdg_surface_role_map(struct wlr_surface *wlr_surface) {
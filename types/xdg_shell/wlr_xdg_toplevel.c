@@ -20,6 +20,47 @@ void handle_xdg_toplevel_ack_configure(
 	toplevel->pending.height = configure->height;
 }
 
+static bool configure_state_equal(const struct wlr_xdg_toplevel_configure *a,
+		bool maximized, bool fullscreen, bool activated, uint32_t tiled,
+		bool suspended) {
+	return a->maximized == maximized && a->fullscreen == fullscreen &&
+		a->activated == activated && a->tiled == tiled &&
+		a->suspended == suspended;
+}
+
+bool xdg_toplevel_should_throttle_configure(struct wlr_xdg_toplevel *toplevel) {
+	struct wlr_xdg_surface *surface = toplevel->base;
+	struct wlr_xdg_toplevel_configure *scheduled = &toplevel->scheduled;
+
+	// Only size changes during an interactive resize are held back, anything
+	// else is sent right away
+	if (!scheduled->resizing || scheduled->fields != 0) {
+		return false;
+	}
+
+	if (!wl_list_empty(&surface->configure_list)) {
+		// The client hasn't acked the last configure yet
+		struct wlr_xdg_surface_configure *last =
+			wl_container_of(surface->configure_list.prev, last, link);
+		const struct wlr_xdg_toplevel_configure *sent = last->toplevel_configure;
+		return sent != NULL && sent->resizing &&
+			configure_state_equal(sent, scheduled->maximized,
+				scheduled->fullscreen, scheduled->activated,
+				scheduled->tiled, scheduled->suspended);
+	}
+
+	if (surface->pending.configure_serial != surface->current.configure_serial) {
+		// The client has acked the last configure but hasn't committed yet
+		const struct wlr_xdg_toplevel_state *acked = &toplevel->pending;
+		return acked->resizing &&
+			configure_state_equal(scheduled, acked->maximized,
+				acked->fullscreen, acked->activated, acked->tiled,
+				acked->suspended);
+	}
+
+	return false;
+}
+
 struct wlr_xdg_toplevel_configure *send_xdg_toplevel_configure(
 		struct wlr_xdg_toplevel *toplevel) {
 	struct wlr_xdg_toplevel_configure *configure =
@@ -1,10 +1,17 @@
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wayland-server-core.h>
 #include <wlr/util/addon.h>
 #include <wlr/util/log.h>
 
+static size_t cache_index(const void *owner, const struct wlr_addon_interface *impl) {
+	uint64_t key = (uint64_t)(uintptr_t)owner ^ ((uint64_t)(uintptr_t)impl << 1);
+	key *= 0x9e3779b97f4a7c15;
+	return (size_t)(key >> 32) % WLR_ADDON_SET_CACHE_LEN;
+}
+
 void wlr_addon_set_init(struct wlr_addon_set *set) {
 	*set = (struct wlr_addon_set){0};
 	wl_list_init(&set->addons);
@@ -29,6 +36,7 @@ void wlr_addon_init(struct wlr_addon *addon, struct wlr_addon_set *set,
 	*addon = (struct wlr_addon){
 		.impl = impl,
 		.owner = owner,
+		.set = set,
 	};
 	struct wlr_addon *iter;
 	wl_list_for_each(iter, &set->addons, link) {
@@ -37,17 +45,29 @@ void wlr_addon_init(struct wlr_addon *addon, struct wlr_addon_set *set,
 		}
 	}
 	wl_list_insert(&set->addons, &addon->link);
+	set->cache[cache_index(owner, impl)] = addon;
 }
 
 void wlr_addon_finish(struct wlr_addon *addon) {
+	struct wlr_addon **slot =
+		&addon->set->cache[cache_index(addon->owner, addon->impl)];
+	if (*slot == addon) {
+		*slot = NULL;
+	}
 	wl_list_remove(&addon->link);
 }
 
 struct wlr_addon *wlr_addon_find(struct wlr_addon_set *set, const void *owner,
 		const struct wlr_addon_interface *impl) {
+	struct wlr_addon **slot = &set->cache[cache_index(owner, impl)];
+	if (*slot != NULL && (*slot)->owner == owner && (*slot)->impl == impl) {
+		return *slot;
+	}
+
 	struct wlr_addon *addon;
 	wl_list_for_each(addon, &set->addons, link) {
 		if (addon->owner == owner && addon->impl == impl) {
+			*slot = addon;
 			return addon;
 		}
 	}
@@ -0,0 +1,128 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "util/cache.h"
+
+static bool make_dir(const char *path) {
+	if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+		wlr_log_errno(WLR_DEBUG, "Failed to create directory %s", path);
+		return false;
+	}
+	return true;
+}
+
+char *cache_file_get_path(const char *name) {
+	char cache_home[PATH_MAX];
+	const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	if (xdg_cache_home != NULL && xdg_cache_home[0] == '/') {
+		snprintf(cache_home, sizeof(cache_home), "%s", xdg_cache_home);
+	} else if (home != NULL && home[0] == '/') {
+		snprintf(cache_home, sizeof(cache_home), "%s/.cache", home);
+	} else {
+		return NULL;
+	}
+
+	char dir[PATH_MAX];
+	snprintf(dir, sizeof(dir), "%s/wlroots", cache_home);
+	if (!make_dir(cache_home) || !make_dir(dir)) {
+		return NULL;
+	}
+
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	char *path_copy = strdup(path);
+	if (path_copy == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+	}
+	return path_copy;
+}
+
+void *cache_file_read(const char *path, size_t *size) {
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		if (errno != ENOENT) {
+			wlr_log_errno(WLR_DEBUG, "Failed to open %s", path);
+		}
+		return NULL;
+	}
+
+	void *data = NULL;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		goto out;
+	}
+
+	data = malloc(st.st_size);
+	if (data == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		goto out;
+	}
+
+	size_t n = 0;
+	while (n < (size_t)st.st_size) {
+		ssize_t ret = read(fd, (char *)data + n, st.st_size - n);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		} else if (ret <= 0) {
+			wlr_log_errno(WLR_DEBUG, "Failed to read %s", path);
+			free(data);
+			data = NULL;
+			goto out;
+		}
+		n += ret;
+	}
+	*size = n;
+
+out:
+	close(fd);
+	return data;
+}
+
+bool cache_file_write(const char *path, const void *data, size_t size) {
+	char tmp_path[PATH_MAX];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)getpid());
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		wlr_log_errno(WLR_DEBUG, "Failed to open %s", tmp_path);
+		return false;
+	}
+
+	size_t n = 0;
+	while (n < size) {
+		ssize_t ret = write(fd, (const char *)data + n, size - n);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		} else if (ret < 0) {
+			break;
+		}
+		n += ret;
+	}
+	close(fd);
+
+	if (n != size || rename(tmp_path, path) != 0) {
+		wlr_log_errno(WLR_DEBUG, "Failed to write %s", path);
+		unlink(tmp_path);
+		return false;
+	}
+	return true;
+}
+
+uint64_t cache_hash(uint64_t hash, const void *data, size_t size) {
+	const unsigned char *p = data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+uint64_t cache_hash_str(uint64_t hash, const char *str) {
+	return cache_hash(hash, str, strlen(str) + 1);
+}
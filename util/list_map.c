@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <wlr/util/log.h>
+#include "util/list_map.h"
+
+#define LIST_MAP_INITIAL_BUCKETS 64
+
+static size_t hash_key(uint64_t key) {
+	// Finalizer of MurmurHash3, keys are often sequential
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return (size_t)key;
+}
+
+bool list_map_init(struct list_map *map,
+		uint64_t (*get_key)(struct wl_list *link)) {
+	map->buckets = calloc(LIST_MAP_INITIAL_BUCKETS, sizeof(map->buckets[0]));
+	if (map->buckets == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	for (size_t i = 0; i < LIST_MAP_INITIAL_BUCKETS; i++) {
+		wl_list_init(&map->buckets[i]);
+	}
+	map->buckets_len = LIST_MAP_INITIAL_BUCKETS;
+	map->len = 0;
+	map->get_key = get_key;
+	return true;
+}
+
+void list_map_finish(struct list_map *map) {
+	free(map->buckets);
+}
+
+struct wl_list *list_map_get_bucket(struct list_map *map, uint64_t key) {
+	return &map->buckets[hash_key(key) & (map->buckets_len - 1)];
+}
+
+static void list_map_grow(struct list_map *map) {
+	size_t buckets_len = 2 * map->buckets_len;
+	struct wl_list *buckets = calloc(buckets_len, sizeof(buckets[0]));
+	if (buckets == NULL) {
+		// Keep using the current buckets, only lookups get slower
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+	for (size_t i = 0; i < buckets_len; i++) {
+		wl_list_init(&buckets[i]);
+	}
+
+	for (size_t i = 0; i < map->buckets_len; i++) {
+		struct wl_list *link, *tmp;
+		for (link = map->buckets[i].next, tmp = link->next;
+				link != &map->buckets[i]; link = tmp, tmp = link->next) {
+			size_t j = hash_key(map->get_key(link)) & (buckets_len - 1);
+			wl_list_insert(buckets[j].prev, link);
+		}
+	}
+
+	free(map->buckets);
+	map->buckets = buckets;
+	map->buckets_len = buckets_len;
+}
+
+void list_map_insert(struct list_map *map, struct wl_list *link) {
+	if (map->len >= map->buckets_len) {
+		list_map_grow(map);
+	}
+	wl_list_insert(list_map_get_bucket(map, map->get_key(link)), link);
+	map->len++;
+}
+
+void list_map_remove(struct list_map *map, struct wl_list *link) {
+	if (wl_list_empty(link)) {
+		return;
+	}
+	wl_list_remove(link);
+	wl_list_init(link);
+	map->len--;
+}
@@ -1,5 +1,10 @@
 #include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,7 +15,7 @@
 #include "util/time.h"
 
 static bool colored = true;
-static enum wlr_log_importance log_importance = WLR_ERROR;
+enum wlr_log_importance _wlr_log_importance = WLR_ERROR;
 static struct timespec start_time = {-1};
 
 static const char *verbosity_colors[] = {
@@ -34,17 +39,21 @@ static void init_start_time(void) {
 	clock_gettime(CLOCK_MONOTONIC, &start_time);
 }
 
+static void get_log_time(struct timespec *ts) {
+	clock_gettime(CLOCK_MONOTONIC, ts);
+	timespec_sub(ts, ts, &start_time);
+}
+
 static void log_stderr(enum wlr_log_importance verbosity, const char *fmt,
 		va_list args) {
 	init_start_time();
 
-	if (verbosity > log_importance) {
+	if (verbosity > _wlr_log_importance) {
 		return;
 	}
 
 	struct timespec ts = {0};
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-	timespec_sub(&ts, &ts, &start_time);
+	get_log_time(&ts);
 
 	fprintf(stderr, "%02d:%02d:%02d.%03ld ", (int)(ts.tv_sec / 60 / 60),
 		(int)(ts.tv_sec / 60 % 60), (int)(ts.tv_sec % 60),
@@ -66,8 +75,228 @@ static void log_stderr(enum wlr_log_importance verbosity, const char *fmt,
 	fprintf(stderr, "\n");
 }
 
+#define ASYNC_LOG_QUEUE_LEN 1024 // must be a power of two
+#define ASYNC_LOG_MESSAGE_LEN 512
+
+struct async_log_entry {
+	enum wlr_log_importance verbosity;
+	struct timespec ts;
+	char message[ASYNC_LOG_MESSAGE_LEN];
+};
+
+struct async_log_slot {
+	// Equal to the queue position when the slot is free, and to the
+	// position + 1 once the entry is ready to be written
+	atomic_size_t seq;
+	struct async_log_entry entry;
+};
+
+// Bounded multi-producer single-consumer queue, drained by a background
+// thread. Producers never block: messages are dropped when it is full.
+static struct {
+	struct async_log_slot *slots;
+	atomic_size_t head;
+	size_t tail; // only accessed by the background thread
+	atomic_uint_least64_t dropped, dropped_total;
+	sem_t pending;
+	pthread_t thread;
+	atomic_bool stop;
+	bool started;
+	bool tty;
+
+	// Last written entries, only written by the background thread
+	struct async_log_entry *history;
+	size_t history_len, history_next;
+	atomic_size_t history_count;
+} async_log;
+
+static int format_entry(char *buf, size_t size, const struct async_log_entry *entry,
+		bool tty) {
+	const struct timespec *ts = &entry->ts;
+	unsigned c = (entry->verbosity < WLR_LOG_IMPORTANCE_LAST) ?
+		entry->verbosity : WLR_LOG_IMPORTANCE_LAST - 1;
+	int n = snprintf(buf, size, "%02d:%02d:%02d.%03ld %s%s%s%s\n",
+		(int)(ts->tv_sec / 60 / 60), (int)(ts->tv_sec / 60 % 60),
+		(int)(ts->tv_sec % 60), ts->tv_nsec / 1000000,
+		tty ? verbosity_colors[c] : verbosity_headers[c], tty ? "" : " ",
+		entry->message, tty ? "\x1B[0m" : "");
+	if (n < 0) {
+		return 0;
+	}
+	return (size_t)n < size ? n : (int)size - 1;
+}
+
+static void async_log_write_entry(const struct async_log_entry *entry) {
+	char buf[ASYNC_LOG_MESSAGE_LEN + 64];
+	int len = format_entry(buf, sizeof(buf), entry, colored && async_log.tty);
+	fwrite(buf, 1, len, stderr);
+
+	if (async_log.history_len > 0) {
+		async_log.history[async_log.history_next] = *entry;
+		async_log.history_next = (async_log.history_next + 1) % async_log.history_len;
+		if (atomic_load(&async_log.history_count) < async_log.history_len) {
+			atomic_fetch_add(&async_log.history_count, 1);
+		}
+	}
+}
+
+static bool async_log_pop(void) {
+	struct async_log_slot *slot =
+		&async_log.slots[async_log.tail & (ASYNC_LOG_QUEUE_LEN - 1)];
+	size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+	if (seq != async_log.tail + 1) {
+		return false;
+	}
+
+	async_log_write_entry(&slot->entry);
+
+	atomic_store_explicit(&slot->seq, async_log.tail + ASYNC_LOG_QUEUE_LEN,
+		memory_order_release);
+	async_log.tail++;
+	return true;
+}
+
+static void *async_log_run(void *data) {
+	while (true) {
+		sem_wait(&async_log.pending);
+
+		while (async_log_pop()) {
+			// Keep draining
+		}
+
+		uint64_t dropped = atomic_exchange(&async_log.dropped, 0);
+		if (dropped > 0) {
+			struct async_log_entry entry = { .verbosity = WLR_ERROR };
+			get_log_time(&entry.ts);
+			snprintf(entry.message, sizeof(entry.message),
+				"[log] %" PRIu64 " messages dropped", dropped);
+			async_log_write_entry(&entry);
+		}
+		fflush(stderr);
+
+		if (atomic_load(&async_log.stop)) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+static void log_async(enum wlr_log_importance verbosity, const char *fmt,
+		va_list args) {
+	if (verbosity > _wlr_log_importance) {
+		return;
+	}
+
+	size_t pos = atomic_load_explicit(&async_log.head, memory_order_relaxed);
+	struct async_log_slot *slot;
+	while (true) {
+		slot = &async_log.slots[pos & (ASYNC_LOG_QUEUE_LEN - 1)];
+		size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(&async_log.head, &pos,
+					pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// The queue is full
+			atomic_fetch_add(&async_log.dropped, 1);
+			atomic_fetch_add(&async_log.dropped_total, 1);
+			return;
+		} else {
+			pos = atomic_load_explicit(&async_log.head, memory_order_relaxed);
+		}
+	}
+
+	slot->entry.verbosity = verbosity;
+	get_log_time(&slot->entry.ts);
+	vsnprintf(slot->entry.message, sizeof(slot->entry.message), fmt, args);
+
+	atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+	sem_post(&async_log.pending);
+}
+
 static wlr_log_func_t log_callback = log_stderr;
 
+static void async_log_stop(void) {
+	if (log_callback == log_async) {
+		log_callback = log_stderr;
+	}
+	atomic_store(&async_log.stop, true);
+	sem_post(&async_log.pending);
+	pthread_join(async_log.thread, NULL);
+}
+
+bool wlr_log_init_async(enum wlr_log_importance verbosity, size_t history_len) {
+	wlr_log_init(verbosity, NULL);
+	if (async_log.started) {
+		log_callback = log_async;
+		return true;
+	}
+
+	async_log.slots = calloc(ASYNC_LOG_QUEUE_LEN, sizeof(async_log.slots[0]));
+	if (async_log.slots == NULL) {
+		goto error;
+	}
+	for (size_t i = 0; i < ASYNC_LOG_QUEUE_LEN; i++) {
+		atomic_init(&async_log.slots[i].seq, i);
+	}
+
+	if (history_len > 0) {
+		async_log.history = calloc(history_len, sizeof(async_log.history[0]));
+		if (async_log.history == NULL) {
+			goto error_slots;
+		}
+		async_log.history_len = history_len;
+	}
+
+	if (sem_init(&async_log.pending, 0, 0) != 0) {
+		goto error_history;
+	}
+
+	async_log.tty = isatty(STDERR_FILENO);
+	if (pthread_create(&async_log.thread, NULL, async_log_run, NULL) != 0) {
+		goto error_sem;
+	}
+
+	async_log.started = true;
+	log_callback = log_async;
+	atexit(async_log_stop);
+	return true;
+
+error_sem:
+	sem_destroy(&async_log.pending);
+error_history:
+	free(async_log.history);
+	async_log.history = NULL;
+	async_log.history_len = 0;
+error_slots:
+	free(async_log.slots);
+	async_log.slots = NULL;
+error:
+	wlr_log(WLR_ERROR, "Failed to start asynchronous logging");
+	return false;
+}
+
+uint64_t wlr_log_get_dropped_count(void) {
+	return atomic_load(&async_log.dropped_total);
+}
+
+void wlr_log_dump_history(int fd) {
+	size_t count = atomic_load(&async_log.history_count);
+	size_t start = (async_log.history_next + async_log.history_len - count) %
+		(async_log.history_len > 0 ? async_log.history_len : 1);
+	for (size_t i = 0; i < count; i++) {
+		const struct async_log_entry *entry =
+			&async_log.history[(start + i) % async_log.history_len];
+		char buf[ASYNC_LOG_MESSAGE_LEN + 64];
+		int len = format_entry(buf, sizeof(buf), entry, false);
+		if (write(fd, buf, len) < 0) {
+			return;
+		}
+	}
+}
+
 static void log_wl(const char *fmt, va_list args) {
 	static char wlr_fmt[1024];
 	int n = snprintf(wlr_fmt, sizeof(wlr_fmt), "[wayland] %s", fmt);
@@ -82,7 +311,7 @@ void wlr_log_init(enum wlr_log_importance verbosity, wlr_log_func_t callback) {
 	init_start_time();
 
 	if (verbosity < WLR_LOG_IMPORTANCE_LAST) {
-		log_importance = verbosity;
+		_wlr_log_importance = verbosity;
 	}
 	if (callback) {
 		log_callback = callback;
@@ -103,5 +332,5 @@ void _wlr_log(enum wlr_log_importance verbosity, const char *fmt, ...) {
 }
 
 enum wlr_log_importance wlr_log_get_verbosity(void) {
-	return log_importance;
+	return _wlr_log_importance;
 }
@@ -0,0 +1,94 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/pool.h"
+
+// Size of the chunks objects are allocated from, including the header
+#define CHUNK_SIZE 16384
+
+struct object_pool_chunk {
+	struct wl_list link; // object_pool.chunks
+	_Alignas(max_align_t) unsigned char data[];
+};
+
+void object_pool_init(struct object_pool *pool, size_t object_size) {
+	// Free objects store the pointer to the next free object
+	if (object_size < sizeof(void *)) {
+		object_size = sizeof(void *);
+	}
+	size_t align = _Alignof(max_align_t);
+	object_size = (object_size + align - 1) / align * align;
+
+	size_t chunk_len = (CHUNK_SIZE - sizeof(struct object_pool_chunk)) / object_size;
+	if (chunk_len == 0) {
+		chunk_len = 1;
+	}
+
+	*pool = (struct object_pool){
+		.object_size = object_size,
+		.chunk_len = chunk_len,
+	};
+	wl_list_init(&pool->chunks);
+}
+
+static void pool_release_chunks(struct object_pool *pool) {
+	struct object_pool_chunk *chunk, *tmp;
+	wl_list_for_each_safe(chunk, tmp, &pool->chunks, link) {
+		wl_list_remove(&chunk->link);
+		free(chunk);
+	}
+	pool->free_list = NULL;
+}
+
+void object_pool_finish(struct object_pool *pool) {
+	assert(pool->len == 0);
+	pool_release_chunks(pool);
+}
+
+static bool pool_add_chunk(struct object_pool *pool) {
+	struct object_pool_chunk *chunk =
+		malloc(sizeof(*chunk) + pool->chunk_len * pool->object_size);
+	if (chunk == NULL) {
+		return false;
+	}
+	wl_list_insert(&pool->chunks, &chunk->link);
+
+	// Thread the objects in address order, so that consecutive allocations
+	// are adjacent
+	for (size_t i = pool->chunk_len; i > 0; i--) {
+		void **object = (void **)&chunk->data[(i - 1) * pool->object_size];
+		*object = pool->free_list;
+		pool->free_list = object;
+	}
+	return true;
+}
+
+void *object_pool_alloc(struct object_pool *pool) {
+	if (pool->free_list == NULL && !pool_add_chunk(pool)) {
+		return NULL;
+	}
+
+	void **object = pool->free_list;
+	pool->free_list = *object;
+	pool->len++;
+
+	memset(object, 0, pool->object_size);
+	return object;
+}
+
+void object_pool_free(struct object_pool *pool, void *object) {
+	assert(pool->len > 0);
+	pool->len--;
+
+	if (pool->len == 0) {
+		// Give the memory back once the pool is unused
+		pool_release_chunks(pool);
+		return;
+	}
+
+	void **entry = object;
+	*entry = pool->free_list;
+	pool->free_list = entry;
+}
@@ -1,4 +1,5 @@
 #include <limits.h>
+#include <string.h>
 #include "util/rect_union.h"
 
 static void box_union(pixman_box32_t *dst, pixman_box32_t box) {
@@ -8,6 +9,13 @@ static void box_union(pixman_box32_t *dst, pixman_box32_t box) {
 	dst->y2 = dst->y2 > box.y2 ? dst->y2 : box.y2;
 }
 
+static void box_intersect(pixman_box32_t *dst, pixman_box32_t box) {
+	dst->x1 = dst->x1 > box.x1 ? dst->x1 : box.x1;
+	dst->y1 = dst->y1 > box.y1 ? dst->y1 : box.y1;
+	dst->x2 = dst->x2 < box.x2 ? dst->x2 : box.x2;
+	dst->y2 = dst->y2 < box.y2 ? dst->y2 : box.y2;
+}
+
 static bool box_empty_or_invalid(pixman_box32_t box) {
 	return box.x1 >= box.x2 || box.y1 >= box.y2;
 }
@@ -89,3 +97,60 @@ bounding_box:
 	return &ru->region;
 }
 
+
+void rect_union_add_region(struct rect_union *ru, const pixman_region32_t *region) {
+	int rects_len;
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+	if (rects_len == 0) {
+		return;
+	}
+
+	const pixman_box32_t *extents = pixman_region32_extents(region);
+	box_union(&ru->bounding_box, *extents);
+
+	if (!ru->alloc_failure) {
+		pixman_box32_t *entries =
+			wl_array_add(&ru->unsorted, rects_len * sizeof(*entries));
+		if (entries) {
+			memcpy(entries, rects, rects_len * sizeof(*entries));
+		} else {
+			handle_alloc_failure(ru);
+		}
+	}
+}
+
+static void update_bounding_box(struct rect_union *ru) {
+	if (ru->alloc_failure || !pixman_region32_not_empty(&ru->region)) {
+		// Keep the bounding box, it's used as the fallback result
+		if (!ru->alloc_failure) {
+			rect_union_finish(ru);
+			rect_union_init(ru);
+		}
+		return;
+	}
+	ru->bounding_box = *pixman_region32_extents(&ru->region);
+}
+
+void rect_union_subtract(struct rect_union *ru, const pixman_region32_t *region) {
+	rect_union_evaluate(ru);
+	if (ru->alloc_failure) {
+		return;
+	}
+	if (!pixman_region32_subtract(&ru->region, &ru->region, region)) {
+		handle_alloc_failure(ru);
+	}
+	update_bounding_box(ru);
+}
+
+void rect_union_intersect(struct rect_union *ru, const pixman_region32_t *region) {
+	rect_union_evaluate(ru);
+	if (ru->alloc_failure) {
+		// The bounding box can still be narrowed down
+		box_intersect(&ru->bounding_box, *pixman_region32_extents(region));
+		return;
+	}
+	if (!pixman_region32_intersect(&ru->region, &ru->region, region)) {
+		handle_alloc_failure(ru);
+	}
+	update_bounding_box(ru);
+}
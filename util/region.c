@@ -1,9 +1,203 @@
 #include <assert.h>
 #include <math.h>
 #include <limits.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <wlr/util/region.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// pixman_box32_t is made of 4 int32_t (x1, y1, x2, y2), so that each box fits
+// in a single 128-bit vector. The SIMD kernels below return the number of
+// boxes they have processed, the rest is left to the scalar loops.
+static_assert(sizeof(pixman_box32_t) == 4 * sizeof(int32_t),
+	"pixman_box32_t must be made of 4 int32_t");
+
+#if defined(__SSE2__)
+// Multiplies the box by (scale_x, scale_y), rounding x1/y1 down and x2/y2 up.
+// This matches the scalar float multiplication followed by floor()/ceil().
+static int scale_boxes_sse2(pixman_box32_t *dst, const pixman_box32_t *src,
+		int len, float scale_x, float scale_y) {
+	const __m128 scale = _mm_setr_ps(scale_x, scale_y, scale_x, scale_y);
+	const __m128i lo = _mm_setr_epi32(-1, -1, 0, 0);
+	const __m128i hi = _mm_setr_epi32(0, 0, -1, -1);
+
+	for (int i = 0; i < len; i++) {
+		__m128 v = _mm_mul_ps(_mm_cvtepi32_ps(
+			_mm_loadu_si128((const __m128i *)&src[i])), scale);
+		// SSE2 has no floor/ceil: truncate, then fix up the lanes which were
+		// rounded the wrong way (comparisons yield -1 when true)
+		__m128i t = _mm_cvttps_epi32(v);
+		__m128 tf = _mm_cvtepi32_ps(t);
+		__m128i down = _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(tf, v)), lo);
+		__m128i up = _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(tf, v)), hi);
+		t = _mm_sub_epi32(_mm_add_epi32(t, down), up);
+		_mm_storeu_si128((__m128i *)&dst[i], t);
+	}
+	return len;
+}
+
+static int translate_boxes_sse2(pixman_box32_t *dst, const pixman_box32_t *src,
+		int len, const int32_t offset[static 4]) {
+	const __m128i off = _mm_loadu_si128((const __m128i *)offset);
+	for (int i = 0; i < len; i++) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+		_mm_storeu_si128((__m128i *)&dst[i], _mm_add_epi32(v, off));
+	}
+	return len;
+}
+
+static int transform_boxes_sse2(pixman_box32_t *dst, const pixman_box32_t *src,
+		int len, bool swap, const int32_t flip[static 4], const int32_t offset[static 4]) {
+	const __m128i mask = _mm_loadu_si128((const __m128i *)flip);
+	const __m128i off = _mm_loadu_si128((const __m128i *)offset);
+	for (int i = 0; i < len; i++) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+		if (swap) {
+			v = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+		}
+		// Flipping an axis swaps and negates its two coordinates
+		__m128i r = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+		v = _mm_or_si128(_mm_and_si128(mask, r), _mm_andnot_si128(mask, v));
+		v = _mm_sub_epi32(_mm_xor_si128(v, mask), mask);
+		_mm_storeu_si128((__m128i *)&dst[i], _mm_add_epi32(v, off));
+	}
+	return len;
+}
+#elif defined(__ARM_NEON)
+static int scale_boxes_neon(pixman_box32_t *dst, const pixman_box32_t *src,
+		int len, float scale_x, float scale_y) {
+	const float scale_arr[4] = { scale_x, scale_y, scale_x, scale_y };
+	const float32x4_t scale = vld1q_f32(scale_arr);
+	const uint32_t lo_arr[4] = { UINT32_MAX, UINT32_MAX, 0, 0 };
+	const uint32x4_t lo = vld1q_u32(lo_arr);
+	const uint32x4_t hi = vmvnq_u32(lo);
+
+	for (int i = 0; i < len; i++) {
+		float32x4_t v = vmulq_f32(vcvtq_f32_s32(
+			vld1q_s32((const int32_t *)&src[i])), scale);
+		// Truncate, then fix up the lanes which were rounded the wrong way
+		// (comparisons yield -1 when true). This doesn't require ARMv8.
+		int32x4_t t = vcvtq_s32_f32(v);
+		float32x4_t tf = vcvtq_f32_s32(t);
+		int32x4_t down = vreinterpretq_s32_u32(vandq_u32(vcgtq_f32(tf, v), lo));
+		int32x4_t up = vreinterpretq_s32_u32(vandq_u32(vcltq_f32(tf, v), hi));
+		t = vsubq_s32(vaddq_s32(t, down), up);
+		vst1q_s32((int32_t *)&dst[i], t);
+	}
+	return len;
+}
+
+static int translate_boxes_neon(pixman_box32_t *dst, const pixman_box32_t *src,
+		int len, const int32_t offset[static 4]) {
+	const int32x4_t off = vld1q_s32(offset);
+	for (int i = 0; i < len; i++) {
+		int32x4_t v = vld1q_s32((const int32_t *)&src[i]);
+		vst1q_s32((int32_t *)&dst[i], vaddq_s32(v, off));
+	}
+	return len;
+}
+
+static int transform_boxes_neon(pixman_box32_t *dst, const pixman_box32_t *src,
+		int len, bool swap, const int32_t flip[static 4], const int32_t offset[static 4]) {
+	const uint32x4_t mask = vld1q_u32((const uint32_t *)flip);
+	const int32x4_t off = vld1q_s32(offset);
+	for (int i = 0; i < len; i++) {
+		int32x4_t v = vld1q_s32((const int32_t *)&src[i]);
+		if (swap) {
+			v = vrev64q_s32(v);
+		}
+		// Flipping an axis swaps and negates its two coordinates
+		v = vbslq_s32(mask, vnegq_s32(vextq_s32(v, v, 2)), v);
+		vst1q_s32((int32_t *)&dst[i], vaddq_s32(v, off));
+	}
+	return len;
+}
+#endif
+
+static int scale_boxes_simd(pixman_box32_t *dst, const pixman_box32_t *src,
+		int len, float scale_x, float scale_y) {
+#if defined(__SSE2__)
+	return scale_boxes_sse2(dst, src, len, scale_x, scale_y);
+#elif defined(__ARM_NEON)
+	return scale_boxes_neon(dst, src, len, scale_x, scale_y);
+#else
+	return 0;
+#endif
+}
+
+// Every transform can be applied to a box by optionally swapping its axes, and
+// then optionally flipping each axis
+static int transform_boxes_simd(pixman_box32_t *dst, const pixman_box32_t *src,
+		int len, enum wl_output_transform transform, int width, int height) {
+	bool swap = transform & WL_OUTPUT_TRANSFORM_90;
+	bool flip_x, flip_y;
+	switch (transform) {
+	case WL_OUTPUT_TRANSFORM_NORMAL:
+		flip_x = false;
+		flip_y = false;
+		break;
+	case WL_OUTPUT_TRANSFORM_90:
+	case WL_OUTPUT_TRANSFORM_FLIPPED:
+		flip_x = true;
+		flip_y = false;
+		break;
+	case WL_OUTPUT_TRANSFORM_180:
+	case WL_OUTPUT_TRANSFORM_FLIPPED_270:
+		flip_x = true;
+		flip_y = true;
+		break;
+	case WL_OUTPUT_TRANSFORM_270:
+	case WL_OUTPUT_TRANSFORM_FLIPPED_180:
+		flip_x = false;
+		flip_y = true;
+		break;
+	case WL_OUTPUT_TRANSFORM_FLIPPED_90:
+		flip_x = false;
+		flip_y = false;
+		break;
+	default:
+		return 0;
+	}
+
+	int x_size = swap ? height : width;
+	int y_size = swap ? width : height;
+	const int32_t flip[4] = {
+		flip_x ? -1 : 0, flip_y ? -1 : 0,
+		flip_x ? -1 : 0, flip_y ? -1 : 0,
+	};
+	const int32_t offset[4] = {
+		flip_x ? x_size : 0, flip_y ? y_size : 0,
+		flip_x ? x_size : 0, flip_y ? y_size : 0,
+	};
+
+#if defined(__SSE2__)
+	return transform_boxes_sse2(dst, src, len, swap, flip, offset);
+#elif defined(__ARM_NEON)
+	return transform_boxes_neon(dst, src, len, swap, flip, offset);
+#else
+	(void)swap;
+	(void)flip;
+	(void)offset;
+	return 0;
+#endif
+}
+
+static int translate_boxes_simd(pixman_box32_t *dst, const pixman_box32_t *src,
+		int len, const int32_t offset[static 4]) {
+#if defined(__SSE2__)
+	return translate_boxes_sse2(dst, src, len, offset);
+#elif defined(__ARM_NEON)
+	return translate_boxes_neon(dst, src, len, offset);
+#else
+	return 0;
+#endif
+}
+
 void wlr_region_scale(pixman_region32_t *dst, const pixman_region32_t *src,
 		float scale) {
 	wlr_region_scale_xy(dst, src, scale, scale);
@@ -24,7 +218,8 @@ void wlr_region_scale_xy(pixman_region32_t *dst, const pixman_region32_t *src,
 		return;
 	}
 
-	for (int i = 0; i < nrects; ++i) {
+	int i = scale_boxes_simd(dst_rects, src_rects, nrects, scale_x, scale_y);
+	for (; i < nrects; ++i) {
 		dst_rects[i].x1 = floor(src_rects[i].x1 * scale_x);
 		dst_rects[i].x2 = ceil(src_rects[i].x2 * scale_x);
 		dst_rects[i].y1 = floor(src_rects[i].y1 * scale_y);
@@ -51,7 +246,9 @@ void wlr_region_transform(pixman_region32_t *dst, const pixman_region32_t *src,
 		return;
 	}
 
-	for (int i = 0; i < nrects; ++i) {
+	int i = transform_boxes_simd(dst_rects, src_rects, nrects,
+		transform, width, height);
+	for (; i < nrects; ++i) {
 		switch (transform) {
 		case WL_OUTPUT_TRANSFORM_NORMAL:
 			dst_rects[i].x1 = src_rects[i].x1;
@@ -126,7 +323,9 @@ void wlr_region_expand(pixman_region32_t *dst, const pixman_region32_t *src,
 		return;
 	}
 
-	for (int i = 0; i < nrects; ++i) {
+	const int32_t offset[4] = { -distance, -distance, distance, distance };
+	int i = translate_boxes_simd(dst_rects, src_rects, nrects, offset);
+	for (; i < nrects; ++i) {
 		dst_rects[i].x1 = src_rects[i].x1 - distance;
 		dst_rects[i].x2 = src_rects[i].x2 + distance;
 		dst_rects[i].y1 = src_rects[i].y1 - distance;
@@ -153,23 +352,25 @@ void wlr_region_rotated_bounds(pixman_region32_t *dst, const pixman_region32_t *
 		return;
 	}
 
+	double c = cos(rotation);
+	double s = sin(rotation);
 	for (int i = 0; i < nrects; ++i) {
 		double x1 = src_rects[i].x1 - ox;
 		double y1 = src_rects[i].y1 - oy;
 		double x2 = src_rects[i].x2 - ox;
 		double y2 = src_rects[i].y2 - oy;
 
-		double rx1 = x1 * cos(rotation) - y1 * sin(rotation);
-		double ry1 = x1 * sin(rotation) + y1 * cos(rotation);
+		double rx1 = x1 * c - y1 * s;
+		double ry1 = x1 * s + y1 * c;
 
-		double rx2 = x2 * cos(rotation) - y1 * sin(rotation);
-		double ry2 = x2 * sin(rotation) + y1 * cos(rotation);
+		double rx2 = x2 * c - y1 * s;
+		double ry2 = x2 * s + y1 * c;
 
-		double rx3 = x2 * cos(rotation) - y2 * sin(rotation);
-		double ry3 = x2 * sin(rotation) + y2 * cos(rotation);
+		double rx3 = x2 * c - y2 * s;
+		double ry3 = x2 * s + y2 * c;
 
-		double rx4 = x1 * cos(rotation) - y2 * sin(rotation);
-		double ry4 = x1 * sin(rotation) + y2 * cos(rotation);
+		double rx4 = x1 * c - y2 * s;
+		double ry4 = x1 * s + y2 * c;
 
 		x1 = fmin(fmin(rx1, rx2), fmin(rx3, rx4));
 		y1 = fmin(fmin(ry1, ry2), fmin(ry3, ry4));
@@ -0,0 +1,138 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <wlr/util/log.h>
+#include "util/thread_pool.h"
+
+struct thread_pool {
+	pthread_t *threads;
+	int threads_len;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond, done_cond;
+	bool stop;
+
+	// Current batch of tasks, protected by mutex
+	thread_pool_func_t func;
+	void *data;
+	int tasks_len;
+	int next_task;
+	int pending_tasks;
+};
+
+// Runs tasks of the current batch until there are none left. Must be called
+// with the mutex locked.
+static void run_tasks_locked(struct thread_pool *pool) {
+	while (pool->next_task < pool->tasks_len) {
+		int index = pool->next_task++;
+		thread_pool_func_t func = pool->func;
+		void *data = pool->data;
+
+		pthread_mutex_unlock(&pool->mutex);
+		func(data, index);
+		pthread_mutex_lock(&pool->mutex);
+
+		pool->pending_tasks--;
+		if (pool->pending_tasks == 0) {
+			pthread_cond_signal(&pool->done_cond);
+		}
+	}
+}
+
+static void *worker_run(void *data) {
+	struct thread_pool *pool = data;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (true) {
+		while (!pool->stop && pool->next_task >= pool->tasks_len) {
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+		}
+		if (pool->stop) {
+			break;
+		}
+		run_tasks_locked(pool);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+struct thread_pool *thread_pool_create(int threads_len) {
+	struct thread_pool *pool = calloc(1, sizeof(*pool));
+	if (pool == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	// The calling thread runs tasks as well
+	pool->threads = calloc(threads_len - 1, sizeof(*pool->threads));
+	if (pool->threads == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	for (int i = 0; i < threads_len - 1; i++) {
+		if (pthread_create(&pool->threads[i], NULL, worker_run, pool) != 0) {
+			wlr_log(WLR_ERROR, "Failed to spawn worker thread");
+			break;
+		}
+		pool->threads_len++;
+	}
+
+	if (pool->threads_len == 0) {
+		thread_pool_destroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+void thread_pool_destroy(struct thread_pool *pool) {
+	if (pool == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (int i = 0; i < pool->threads_len; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->threads);
+	free(pool);
+}
+
+int thread_pool_get_size(struct thread_pool *pool) {
+	return pool->threads_len + 1;
+}
+
+void thread_pool_run(struct thread_pool *pool,
+		thread_pool_func_t func, void *data, int tasks_len) {
+	pthread_mutex_lock(&pool->mutex);
+
+	pool->func = func;
+	pool->data = data;
+	pool->tasks_len = tasks_len;
+	pool->next_task = 0;
+	pool->pending_tasks = tasks_len;
+	pthread_cond_broadcast(&pool->work_cond);
+
+	run_tasks_locked(pool);
+	while (pool->pending_tasks > 0) {
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	}
+
+	pool->tasks_len = 0;
+	pool->next_task = 0;
+	pthread_mutex_unlock(&pool->mutex);
+}
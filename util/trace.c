@@ -0,0 +1,67 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "util/env.h"
+#include "util/trace.h"
+
+static const char *const marker_paths[] = {
+	"/sys/kernel/tracing/trace_marker",
+	"/sys/kernel/debug/tracing/trace_marker",
+};
+
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static int trace_fd = -1;
+
+static void trace_init(void) {
+	if (!env_parse_bool("WLR_TRACE")) {
+		return;
+	}
+
+	for (size_t i = 0; i < sizeof(marker_paths) / sizeof(marker_paths[0]); i++) {
+		trace_fd = open(marker_paths[i], O_WRONLY | O_CLOEXEC);
+		if (trace_fd >= 0) {
+			wlr_log(WLR_INFO, "Writing traces to %s", marker_paths[i]);
+			return;
+		}
+	}
+	wlr_log_errno(WLR_ERROR, "Failed to open the ftrace marker file");
+}
+
+static void trace_write(const char *buf, int len) {
+	if (len <= 0) {
+		return;
+	}
+	// Each write() is a single event, partial writes can't be resumed
+	while (write(trace_fd, buf, len) < 0 && errno == EINTR) {
+		// Retry
+	}
+}
+
+void trace_begin(const char *name) {
+	pthread_once(&trace_once, trace_init);
+	if (trace_fd < 0) {
+		return;
+	}
+
+	char buf[128];
+	int len = snprintf(buf, sizeof(buf), "B|%d|%s", (int)getpid(), name);
+	if (len >= (int)sizeof(buf)) {
+		len = sizeof(buf) - 1;
+	}
+	trace_write(buf, len);
+}
+
+void trace_end(void) {
+	pthread_once(&trace_once, trace_init);
+	if (trace_fd < 0) {
+		return;
+	}
+
+	char buf[32];
+	int len = snprintf(buf, sizeof(buf), "E|%d", (int)getpid());
+	trace_write(buf, len);
+}
@@ -24,6 +24,7 @@
  */
 
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,6 +32,14 @@
 #include <wlr/xcursor.h>
 #include "xcursor/xcursor.h"
 
+struct wlr_xcursor_theme_entry {
+	char *name;
+	char *path;
+	size_t order; // order of precedence, lower is preferred
+	bool loaded;
+	struct wlr_xcursor *cursor; // NULL if not loaded or failed to load
+};
+
 static void xcursor_destroy(struct wlr_xcursor *cursor) {
 	for (size_t i = 0; i < cursor->image_count; i++) {
 		free(cursor->images[i]->buffer);
@@ -169,32 +178,105 @@ static struct wlr_xcursor *xcursor_create_from_xcursor_images(
 	return cursor;
 }
 
-static struct wlr_xcursor *xcursor_theme_get_cursor(struct wlr_xcursor_theme *theme,
-	const char *name);
-
-static void load_callback(struct xcursor_images *images, void *data) {
+static void index_callback(const char *name, const char *path, void *data) {
 	struct wlr_xcursor_theme *theme = data;
 
-	if (xcursor_theme_get_cursor(theme, images->name)) {
-		xcursor_images_destroy(images);
+	if (theme->entries_len == theme->entries_cap) {
+		size_t cap = theme->entries_cap == 0 ? 64 : theme->entries_cap * 2;
+		struct wlr_xcursor_theme_entry *entries =
+			realloc(theme->entries, cap * sizeof(entries[0]));
+		if (entries == NULL) {
+			return;
+		}
+		theme->entries = entries;
+		theme->entries_cap = cap;
+	}
+
+	struct wlr_xcursor_theme_entry entry = {
+		.name = strdup(name),
+		.path = strdup(path),
+		.order = theme->entries_len,
+	};
+	if (entry.name == NULL || entry.path == NULL) {
+		free(entry.name);
+		free(entry.path);
 		return;
 	}
+	theme->entries[theme->entries_len++] = entry;
+}
+
+static int entry_compare(const void *data_a, const void *data_b) {
+	const struct wlr_xcursor_theme_entry *a = data_a, *b = data_b;
+	int ret = strcmp(a->name, b->name);
+	if (ret != 0) {
+		return ret;
+	}
+	return a->order < b->order ? -1 : a->order > b->order;
+}
+
+static void entry_finish(struct wlr_xcursor_theme_entry *entry) {
+	free(entry->name);
+	free(entry->path);
+}
 
-	struct wlr_xcursor *cursor = xcursor_create_from_xcursor_images(images, theme);
-	if (cursor) {
-		theme->cursor_count++;
-		struct wlr_xcursor **cursors = realloc(theme->cursors,
-			theme->cursor_count * sizeof(theme->cursors[0]));
-		if (cursors == NULL) {
-			theme->cursor_count--;
-			xcursor_destroy(cursor);
-		} else {
-			theme->cursors = cursors;
-			theme->cursors[theme->cursor_count - 1] = cursor;
+static void index_theme(struct wlr_xcursor_theme *theme, const char *name) {
+	xcursor_index_theme(name, index_callback, theme);
+
+	// Sort by name, then only keep the entry with the highest precedence
+	qsort(theme->entries, theme->entries_len, sizeof(theme->entries[0]),
+		entry_compare);
+	size_t len = 0;
+	for (size_t i = 0; i < theme->entries_len; i++) {
+		struct wlr_xcursor_theme_entry *entry = &theme->entries[i];
+		if (len > 0 && strcmp(theme->entries[len - 1].name, entry->name) == 0) {
+			entry_finish(entry);
+			continue;
 		}
+		theme->entries[len++] = *entry;
 	}
+	theme->entries_len = len;
+}
+
+static int entry_search_compare(const void *key, const void *data) {
+	const struct wlr_xcursor_theme_entry *entry = data;
+	return strcmp(key, entry->name);
+}
+
+static bool theme_add_cursor(struct wlr_xcursor_theme *theme,
+		struct wlr_xcursor *cursor) {
+	struct wlr_xcursor **cursors = realloc(theme->cursors,
+		(theme->cursor_count + 1) * sizeof(theme->cursors[0]));
+	if (cursors == NULL) {
+		return false;
+	}
+	theme->cursors = cursors;
+	theme->cursors[theme->cursor_count++] = cursor;
+	return true;
+}
 
+static struct wlr_xcursor *theme_load_entry(struct wlr_xcursor_theme *theme,
+		struct wlr_xcursor_theme_entry *entry) {
+	entry->loaded = true;
+
+	struct xcursor_images *images = xcursor_load_file(entry->path, theme->size);
+	if (images == NULL) {
+		wlr_log(WLR_DEBUG, "Failed to load cursor file '%s'", entry->path);
+		return NULL;
+	}
+	images->name = strdup(entry->name);
+
+	struct wlr_xcursor *cursor = NULL;
+	if (images->name != NULL) {
+		cursor = xcursor_create_from_xcursor_images(images, theme);
+	}
 	xcursor_images_destroy(images);
+
+	if (cursor != NULL && !theme_add_cursor(theme, cursor)) {
+		xcursor_destroy(cursor);
+		cursor = NULL;
+	}
+	entry->cursor = cursor;
+	return cursor;
 }
 
 struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
@@ -215,14 +297,18 @@ struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
 	theme->cursor_count = 0;
 	theme->cursors = NULL;
 
-	xcursor_load_theme(name, size, load_callback, theme);
+	index_theme(theme, name);
 
-	if (theme->cursor_count == 0) {
+	size_t available;
+	if (theme->entries_len > 0) {
+		available = theme->entries_len;
+	} else {
 		load_default_theme(theme);
+		available = theme->cursor_count;
 	}
 
-	wlr_log(WLR_DEBUG, "Loaded cursor theme '%s' at size %d (%d available cursors)",
-			theme->name, size, theme->cursor_count);
+	wlr_log(WLR_DEBUG, "Loaded cursor theme '%s' at size %d (%zu available cursors)",
+			theme->name, size, available);
 
 	return theme;
 
@@ -236,20 +322,37 @@ void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme) {
 		xcursor_destroy(theme->cursors[i]);
 	}
 
+	for (size_t i = 0; i < theme->entries_len; i++) {
+		entry_finish(&theme->entries[i]);
+	}
+
 	free(theme->name);
 	free(theme->cursors);
+	free(theme->entries);
 	free(theme);
 }
 
 static struct wlr_xcursor *xcursor_theme_get_cursor(struct wlr_xcursor_theme *theme,
 		const char *name) {
-	for (unsigned int i = 0; i < theme->cursor_count; i++) {
-		if (strcmp(name, theme->cursors[i]->name) == 0) {
-			return theme->cursors[i];
+	if (theme->entries_len == 0) {
+		// Built-in default theme
+		for (unsigned int i = 0; i < theme->cursor_count; i++) {
+			if (strcmp(name, theme->cursors[i]->name) == 0) {
+				return theme->cursors[i];
+			}
 		}
+		return NULL;
 	}
 
-	return NULL;
+	struct wlr_xcursor_theme_entry *entry = bsearch(name, theme->entries,
+		theme->entries_len, sizeof(theme->entries[0]), entry_search_compare);
+	if (entry == NULL) {
+		return NULL;
+	}
+	if (!entry->loaded) {
+		return theme_load_entry(theme, entry);
+	}
+	return entry->cursor;
 }
 
 struct wlr_xcursor *wlr_xcursor_theme_get_cursor(struct wlr_xcursor_theme *theme,
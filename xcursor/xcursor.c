@@ -30,6 +30,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "config.h"
 #include "xcursor/xcursor.h"
 
@@ -136,6 +140,15 @@ struct xcursor_chunk_header {
 #define XCURSOR_IMAGE_HEADER_LEN (XCURSOR_CHUNK_HEADER_LEN + (5*4))
 #define XCURSOR_IMAGE_MAX_SIZE 0x7fff /* 32767x32767 max cursor size */
 
+/*
+ * Cursor files are memory-mapped and read in place
+ */
+struct xcursor_file {
+	const unsigned char *data;
+	size_t size;
+	size_t pos;
+};
+
 /*
  * From libXcursor/src/file.c
  */
@@ -199,15 +212,26 @@ xcursor_images_destroy(struct xcursor_images *images)
 }
 
 static bool
-xcursor_read_uint(FILE *file, uint32_t *u)
+xcursor_file_seek(struct xcursor_file *file, size_t pos)
 {
-	unsigned char bytes[4];
+	if (pos > file->size)
+		return false;
+	file->pos = pos;
+	return true;
+}
+
+static bool
+xcursor_read_uint(struct xcursor_file *file, uint32_t *u)
+{
+	const unsigned char *bytes;
 
 	if (!file || !u)
 		return false;
 
-	if (fread(bytes, 1, 4, file) != 4)
+	if (file->size - file->pos < 4)
 		return false;
+	bytes = file->data + file->pos;
+	file->pos += 4;
 
 	*u = ((uint32_t)(bytes[0]) << 0) |
 		 ((uint32_t)(bytes[1]) << 8) |
@@ -242,7 +266,7 @@ xcursor_file_header_create(uint32_t ntoc)
 }
 
 static struct xcursor_file_header *
-xcursor_read_file_header(FILE *file)
+xcursor_read_file_header(struct xcursor_file *file)
 {
 	struct xcursor_file_header head, *file_header;
 	uint32_t skip;
@@ -261,9 +285,11 @@ xcursor_read_file_header(FILE *file)
 		return NULL;
 	if (!xcursor_read_uint(file, &head.ntoc))
 		return NULL;
+	if (head.header < XCURSOR_FILE_HEADER_LEN)
+		return NULL;
 	skip = head.header - XCURSOR_FILE_HEADER_LEN;
 	if (skip)
-		if (fseek(file, skip, SEEK_CUR) == EOF)
+		if (!xcursor_file_seek(file, file->pos + skip))
 			return NULL;
 	file_header = xcursor_file_header_create(head.ntoc);
 	if (!file_header)
@@ -288,18 +314,18 @@ xcursor_read_file_header(FILE *file)
 }
 
 static bool
-xcursor_seek_to_toc(FILE *file,
+xcursor_seek_to_toc(struct xcursor_file *file,
 		    struct xcursor_file_header *file_header,
 		    int toc)
 {
 	if (!file || !file_header ||
-	    fseek(file, file_header->tocs[toc].position, SEEK_SET) == EOF)
+	    !xcursor_file_seek(file, file_header->tocs[toc].position))
 		return false;
 	return true;
 }
 
 static bool
-xcursor_file_read_chunk_header(FILE *file,
+xcursor_file_read_chunk_header(struct xcursor_file *file,
 			       struct xcursor_file_header *file_header,
 			       int toc,
 			       struct xcursor_chunk_header *chunk_header)
@@ -382,7 +408,7 @@ xcursor_find_image_toc(struct xcursor_file_header *file_header,
 }
 
 static struct xcursor_image *
-xcursor_read_image(FILE *file,
+xcursor_read_image(struct xcursor_file *file,
 		   struct xcursor_file_header *file_header,
 		   int toc)
 {
@@ -428,18 +454,24 @@ xcursor_read_image(FILE *file,
 	image->delay = head.delay;
 	n = image->width * image->height;
 	p = image->pixels;
+	if ((file->size - file->pos) / 4 < (size_t)n) {
+		xcursor_image_destroy(image);
+		return NULL;
+	}
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(p, file->data + file->pos, (size_t)n * 4);
+	file->pos += (size_t)n * 4;
+#else
 	while (n--) {
-		if (!xcursor_read_uint(file, p)) {
-			xcursor_image_destroy(image);
-			return NULL;
-		}
+		xcursor_read_uint(file, p);
 		p++;
 	}
+#endif
 	return image;
 }
 
 static struct xcursor_images *
-xcursor_xc_file_load_images(FILE *file, int size)
+xcursor_xc_file_load_images(struct xcursor_file *file, int size)
 {
 	struct xcursor_file_header *file_header;
 	uint32_t best_size;
@@ -678,20 +710,20 @@ xcursor_theme_inherits(const char *full)
 }
 
 static void
-load_all_cursors_from_dir(const char *path, int size,
-			  void (*load_callback)(struct xcursor_images *, void *),
-			  void *user_data)
+index_cursors_in_dir(const char *path,
+		     void (*index_callback)(const char *, const char *, void *),
+		     void *user_data)
 {
-	FILE *f;
 	DIR *dir = opendir(path);
 	struct dirent *ent;
 	char *full;
-	struct xcursor_images *images;
 
 	if (!dir)
 		return;
 
 	for (ent = readdir(dir); ent; ent = readdir(dir)) {
+		if (ent->d_name[0] == '.')
+			continue;
 #ifdef _DIRENT_HAVE_D_TYPE
 		if (ent->d_type != DT_UNKNOWN &&
 		    ent->d_type != DT_REG &&
@@ -703,20 +735,7 @@ load_all_cursors_from_dir(const char *path, int size,
 		if (!full)
 			continue;
 
-		f = fopen(full, "r");
-		if (!f) {
-			free(full);
-			continue;
-		}
-
-		images = xcursor_xc_file_load_images(f, size);
-
-		if (images) {
-			images->name = strdup(ent->d_name);
-			load_callback(images, user_data);
-		}
-
-		fclose(f);
+		index_callback(ent->d_name, full, user_data);
 		free(full);
 	}
 
@@ -740,11 +759,10 @@ nodelist_contains(struct xcursor_nodelist *nodelist, const char *s, size_t ss) {
 }
 
 static void
-xcursor_load_theme_protected(const char *theme,
-			     int size,
-			     void (*load_callback)(struct xcursor_images *, void *),
-			     void *user_data,
-			     struct xcursor_nodelist *visited_nodes)
+xcursor_index_theme_protected(const char *theme,
+			      void (*index_callback)(const char *, const char *, void *),
+			      void *user_data,
+			      struct xcursor_nodelist *visited_nodes)
 {
 	char *full, *dir;
 	char *inherits = NULL;
@@ -771,8 +789,7 @@ xcursor_load_theme_protected(const char *theme,
 
 		full = xcursor_build_fullname(dir, "cursors", "");
 		if (full) {
-			load_all_cursors_from_dir(full, size, load_callback,
-						  user_data);
+			index_cursors_in_dir(full, index_callback, user_data);
 			free(full);
 		}
 
@@ -789,35 +806,66 @@ xcursor_load_theme_protected(const char *theme,
 		si = strlen(i);
 		if (nodelist_contains(visited_nodes, i, si))
 			continue;
-		xcursor_load_theme_protected(i, size, load_callback, user_data, visited_nodes);
+		xcursor_index_theme_protected(i, index_callback, user_data, visited_nodes);
 	}
 
 	free(inherits);
 	free(xcursor_path);
 }
 
-/** Load all the cursor of a theme
+/** Index all the cursors of a theme
  *
- * This function loads all the cursor images of a given theme and its
- * inherited themes. Each cursor is loaded into an struct xcursor_images object
- * which is passed to the caller's load callback. If a cursor appears
- * more than once across all the inherited themes, the load callback
- * will be called multiple times, with possibly different struct xcursor_images
- * object which have the same name. The user is expected to destroy the
- * struct xcursor_images objects passed to the callback with
- * xcursor_images_destroy().
+ * This function lists the cursor files of a given theme and its inherited
+ * themes, without reading them. The index callback is called with the name
+ * and the path of each cursor file. If a cursor appears more than once across
+ * all the inherited themes, the callback will be called multiple times, in
+ * order of precedence: the first path should be preferred.
  *
- * \param theme The name of theme that should be loaded
- * \param size The desired size of the cursor images
- * \param load_callback A callback function that will be called
- * for each cursor loaded. The first parameter is the struct xcursor_images
- * object representing the loaded cursor and the second is a pointer
- * to data provided by the user.
- * \param user_data The data that should be passed to the load callback
+ * \param theme The name of theme that should be indexed
+ * \param index_callback A callback function that will be called for each
+ * cursor file. The first parameter is the cursor name, the second one is the
+ * path of the file and the third one is a pointer to data provided by the
+ * user.
+ * \param user_data The data that should be passed to the index callback
  */
 void
-xcursor_load_theme(const char *theme, int size,
-		   void (*load_callback)(struct xcursor_images *, void *),
-		   void *user_data) {
-	return xcursor_load_theme_protected(theme, size, load_callback, user_data, NULL);
+xcursor_index_theme(const char *theme,
+		    void (*index_callback)(const char *, const char *, void *),
+		    void *user_data) {
+	xcursor_index_theme_protected(theme, index_callback, user_data, NULL);
+}
+
+/** Load the images of a cursor file
+ *
+ * The file is memory-mapped and only the images closest to the desired size
+ * are decoded. Returns NULL if the file can't be read or isn't a valid cursor
+ * file. The caller is responsible for destroying the returned object with
+ * xcursor_images_destroy().
+ */
+struct xcursor_images *
+xcursor_load_file(const char *path, int size)
+{
+	struct xcursor_file file = {0};
+	struct xcursor_images *images;
+	struct stat st;
+	void *data;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	file.data = data;
+	file.size = st.st_size;
+	images = xcursor_xc_file_load_images(&file, size);
+	munmap(data, st.st_size);
+	return images;
 }
@@ -10,6 +10,11 @@
 #include "xwayland/selection.h"
 #include "xwayland/xwm.h"
 
+// Non-INCR selection properties are read in chunks of this size, so that large
+// transfers don't block on a huge reply nor hold it in memory all at once.
+// Must be a multiple of 4.
+#define INCOMING_CHUNK_SIZE (64 * 1024)
+
 static struct wlr_xwm_selection_transfer *
 xwm_selection_transfer_create_incoming(struct wlr_xwm_selection *selection) {
 	struct wlr_xwm_selection_transfer *transfer = calloc(1, sizeof(*transfer));
@@ -56,17 +61,18 @@ xwm_selection_find_incoming_transfer_by_window(
 }
 
 static bool xwm_selection_transfer_get_incoming_selection_property(
-		struct wlr_xwm_selection_transfer *transfer, bool delete) {
+		struct wlr_xwm_selection_transfer *transfer, uint32_t long_offset,
+		uint32_t long_length) {
 	struct wlr_xwm *xwm = transfer->selection->xwm;
 
 	xcb_get_property_cookie_t cookie = xcb_get_property(
 		xwm->xcb_conn,
-		delete,
+		0, // delete
 		transfer->incoming_window,
 		xwm->atoms[WL_SELECTION],
 		XCB_GET_PROPERTY_TYPE_ANY,
-		0, // offset
-		0x1fffffff // length
+		long_offset,
+		long_length
 	);
 
 	transfer->property_start = 0;
@@ -95,6 +101,27 @@ static void xwm_notify_ready_for_next_incr_chunk(
 	xwm_selection_transfer_destroy_property_reply(transfer);
 }
 
+static void xwm_write_selection_property_to_wl_client(
+	struct wlr_xwm_selection_transfer *transfer);
+
+static void xwm_get_next_property_chunk(
+		struct wlr_xwm_selection_transfer *transfer) {
+	assert(!transfer->incr);
+
+	transfer->property_offset +=
+		xcb_get_property_value_length(transfer->property_reply) / 4;
+	xwm_selection_transfer_remove_event_source(transfer);
+	xwm_selection_transfer_destroy_property_reply(transfer);
+
+	if (!xwm_selection_transfer_get_incoming_selection_property(transfer,
+			transfer->property_offset, INCOMING_CHUNK_SIZE / 4)) {
+		xwm_selection_transfer_destroy(transfer);
+		return;
+	}
+
+	xwm_write_selection_property_to_wl_client(transfer);
+}
+
 /**
  * Write the X11 selection to a Wayland client. Returns a nonzero value if the
  * Wayland client might become writeable again in the future.
@@ -124,6 +151,8 @@ static int write_selection_property_to_wl_client(int fd, uint32_t mask,
 		return 1;
 	} else if (transfer->incr) {
 		xwm_notify_ready_for_next_incr_chunk(transfer);
+	} else if (transfer->property_reply->bytes_after > 0) {
+		xwm_get_next_property_chunk(transfer);
 	} else {
 		wlr_log(WLR_DEBUG, "transfer complete");
 		xwm_selection_transfer_destroy(transfer);
@@ -163,7 +192,8 @@ void xwm_get_incr_chunk(struct wlr_xwm_selection_transfer *transfer) {
 		return;
 	}
 
-	if (!xwm_selection_transfer_get_incoming_selection_property(transfer, false)) {
+	if (!xwm_selection_transfer_get_incoming_selection_property(transfer,
+			0, 0x1fffffff)) {
 		return;
 	}
 
@@ -179,11 +209,17 @@ static void xwm_selection_transfer_get_data(
 		struct wlr_xwm_selection_transfer *transfer) {
 	struct wlr_xwm *xwm = transfer->selection->xwm;
 
-	if (!xwm_selection_transfer_get_incoming_selection_property(transfer, true)) {
+	if (!xwm_selection_transfer_get_incoming_selection_property(transfer,
+			0, INCOMING_CHUNK_SIZE / 4)) {
 		return;
 	}
 
 	if (transfer->property_reply->type == xwm->atoms[INCR]) {
+		// Deleting the property starts the incremental transfer
+		xcb_delete_property(xwm->xcb_conn, transfer->incoming_window,
+			xwm->atoms[WL_SELECTION]);
+		xwm_schedule_flush(xwm);
+
 		transfer->incr = true;
 		xwm_selection_transfer_destroy_property_reply(transfer);
 	} else {
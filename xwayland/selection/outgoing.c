@@ -415,7 +415,7 @@ void xwm_handle_selection_request(struct wlr_xwm *xwm,
 
 	// No xwayland surface focused, deny access to clipboard
 	if (xwm->focus_surface == NULL && !dnd_allowed) {
-		if (wlr_log_get_verbosity() >= WLR_DEBUG) {
+		if (wlr_log_enabled(WLR_DEBUG)) {
 			char *selection_name = xwm_get_atom_name(xwm, selection->atom);
 			wlr_log(WLR_DEBUG, "denying read access to selection %u (%s): "
 				"no xwayland surface focused", selection->atom, selection_name);
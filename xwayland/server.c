@@ -209,14 +209,20 @@ static void handle_client_destroy(struct wl_listener *listener, void *data) {
 
 	server_finish_process(server);
 
+	bool prewarm = server->options.lazy && server->options.prewarm_delay > 0;
 	if (time(NULL) - server->server_start > 5) {
-		if (server->options.lazy) {
+		if (server->options.lazy && !prewarm) {
 			wlr_log(WLR_INFO, "Restarting Xwayland (lazy)");
 			server_start_lazy(server);
 		} else  {
 			wlr_log(WLR_INFO, "Restarting Xwayland");
 			server_start(server);
 		}
+	} else if (prewarm) {
+		// Don't respawn an Xwayland which keeps failing in a loop, but
+		// still start it if an X11 client connects
+		wlr_log(WLR_INFO, "Restarting Xwayland (lazy)");
+		server_start_lazy(server);
 	}
 }
 
@@ -409,13 +415,40 @@ static bool server_start(struct wlr_xwayland_server *server) {
 	return true;
 }
 
+static void server_remove_prewarm_timer(struct wlr_xwayland_server *server) {
+	if (server->prewarm_timer != NULL) {
+		wl_event_source_remove(server->prewarm_timer);
+		server->prewarm_timer = NULL;
+	}
+}
+
 static int xwayland_socket_connected(int fd, uint32_t mask, void *data) {
 	struct wlr_xwayland_server *server = data;
 
+	wl_event_source_remove(server->x_fd_read_event[0]);
+	wl_event_source_remove(server->x_fd_read_event[1]);
+	server->x_fd_read_event[0] = server->x_fd_read_event[1] = NULL;
+	server_remove_prewarm_timer(server);
+
+	server_start(server);
+
+	return 0;
+}
+
+static int handle_prewarm_timer(void *data) {
+	struct wlr_xwayland_server *server = data;
+	server_remove_prewarm_timer(server);
+
+	if (server->x_fd_read_event[0] == NULL) {
+		// Already started by a client
+		return 0;
+	}
+
 	wl_event_source_remove(server->x_fd_read_event[0]);
 	wl_event_source_remove(server->x_fd_read_event[1]);
 	server->x_fd_read_event[0] = server->x_fd_read_event[1] = NULL;
 
+	wlr_log(WLR_DEBUG, "Starting Xwayland in the background");
 	server_start(server);
 
 	return 0;
@@ -453,6 +486,7 @@ void wlr_xwayland_server_destroy(struct wlr_xwayland_server *server) {
 	if (server->idle_source != NULL) {
 		wl_event_source_remove(server->idle_source);
 	}
+	server_remove_prewarm_timer(server);
 	server_finish_process(server);
 	server_finish_display(server);
 	wl_signal_emit_mutable(&server->events.destroy, NULL);
@@ -495,6 +529,18 @@ struct wlr_xwayland_server *wlr_xwayland_server_create(
 		if (!server_start_lazy(server)) {
 			goto error_display;
 		}
+
+		if (server->options.prewarm_delay > 0) {
+			struct wl_event_loop *loop = wl_display_get_event_loop(wl_display);
+			server->prewarm_timer = wl_event_loop_add_timer(loop,
+				handle_prewarm_timer, server);
+			if (server->prewarm_timer == NULL) {
+				wlr_log(WLR_ERROR, "Failed to create Xwayland prewarm timer");
+			} else {
+				wl_event_source_timer_update(server->prewarm_timer,
+					server->options.prewarm_delay);
+			}
+		}
 	} else {
 		struct wl_event_loop *loop = wl_display_get_event_loop(wl_display);
 		server->idle_source = wl_event_loop_add_idle(loop, handle_idle, server);
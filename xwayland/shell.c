@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/xwayland/shell.h>
+#include "util/list_map.h"
 
 #include "xwayland-shell-v1-protocol.h"
 
@@ -15,7 +16,14 @@ static void destroy_resource(struct wl_client *client,
 static const struct xwayland_shell_v1_interface shell_impl;
 static const struct xwayland_surface_v1_interface xwl_surface_impl;
 
+static uint64_t xwl_surface_serial_get_key(struct wl_list *link) {
+	struct wlr_xwayland_surface_v1 *xwl_surface =
+		wl_container_of(link, xwl_surface, serial_link);
+	return xwl_surface->serial;
+}
+
 static void xwl_surface_destroy(struct wlr_xwayland_surface_v1 *xwl_surface) {
+	list_map_remove(xwl_surface->shell->serial_map, &xwl_surface->serial_link);
 	wl_list_remove(&xwl_surface->link);
 	wl_resource_set_user_data(xwl_surface->resource, NULL); // make inert
 	free(xwl_surface);
@@ -87,6 +95,8 @@ static void xwl_surface_handle_set_serial(struct wl_client *client,
 	}
 
 	xwl_surface->serial = ((uint64_t)serial_hi << 32) | serial_lo;
+
+	list_map_insert(xwl_surface->shell->serial_map, &xwl_surface->serial_link);
 }
 
 static const struct xwayland_surface_v1_interface xwl_surface_impl = {
@@ -114,6 +124,7 @@ static void shell_handle_get_xwayland_surface(struct wl_client *client,
 
 	xwl_surface->surface = surface;
 	xwl_surface->shell = shell;
+	wl_list_init(&xwl_surface->serial_link);
 
 	uint32_t version = wl_resource_get_version(shell_resource);
 	xwl_surface->resource = wl_resource_create(client,
@@ -170,9 +181,22 @@ struct wlr_xwayland_shell_v1 *wlr_xwayland_shell_v1_create(
 		return NULL;
 	}
 
+	shell->serial_map = calloc(1, sizeof(*shell->serial_map));
+	if (shell->serial_map == NULL) {
+		free(shell);
+		return NULL;
+	}
+	if (!list_map_init(shell->serial_map, xwl_surface_serial_get_key)) {
+		free(shell->serial_map);
+		free(shell);
+		return NULL;
+	}
+
 	shell->global = wl_global_create(display, &xwayland_shell_v1_interface,
 		version, shell, shell_bind);
 	if (shell->global == NULL) {
+		list_map_finish(shell->serial_map);
+		free(shell->serial_map);
 		free(shell);
 		return NULL;
 	}
@@ -204,6 +228,8 @@ void wlr_xwayland_shell_v1_destroy(struct wlr_xwayland_shell_v1 *shell) {
 	wl_list_remove(&shell->display_destroy.link);
 	wl_list_remove(&shell->client_destroy.link);
 	wl_global_destroy(shell->global);
+	list_map_finish(shell->serial_map);
+	free(shell->serial_map);
 	free(shell);
 }
 
@@ -228,7 +254,7 @@ void wlr_xwayland_shell_v1_set_client(struct wlr_xwayland_shell_v1 *shell,
 struct wlr_surface *wlr_xwayland_shell_v1_surface_from_serial(
 		struct wlr_xwayland_shell_v1 *shell, uint64_t serial) {
 	struct wlr_xwayland_surface_v1 *xwl_surface;
-	wl_list_for_each(xwl_surface, &shell->surfaces, link) {
+	wl_list_for_each(xwl_surface, list_map_get_bucket(shell->serial_map, serial), serial_link) {
 		if (xwl_surface->serial == serial) {
 			return xwl_surface->surface;
 		}
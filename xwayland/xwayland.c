@@ -203,6 +203,18 @@ static void xwayland_handle_seat_destroy(struct wl_listener *listener,
 	wlr_xwayland_set_seat(xwayland, NULL);
 }
 
+void wlr_xwayland_begin_configure_batch(struct wlr_xwayland *xwayland) {
+	if (xwayland->xwm) {
+		xwm_begin_configure_batch(xwayland->xwm);
+	}
+}
+
+void wlr_xwayland_commit_configure_batch(struct wlr_xwayland *xwayland) {
+	if (xwayland->xwm) {
+		xwm_commit_configure_batch(xwayland->xwm);
+	}
+}
+
 void wlr_xwayland_set_seat(struct wlr_xwayland *xwayland,
 		struct wlr_seat *seat) {
 	if (xwayland->seat) {
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <wlr/config.h>
 #include <wlr/types/wlr_compositor.h>
@@ -14,8 +15,13 @@
 #include <xcb/render.h>
 #include <xcb/res.h>
 #include <xcb/xfixes.h>
+#include "util/list_map.h"
+#include "util/time.h"
 #include "xwayland/xwm.h"
 
+// Flushes taking longer than this are logged as stalls
+#define XWM_FLUSH_STALL_NSEC 2000000
+
 static const char *const atom_map[ATOM_LAST] = {
 	[WL_SURFACE_ID] = "WL_SURFACE_ID",
 	[WL_SURFACE_SERIAL] = "WL_SURFACE_SERIAL",
@@ -110,6 +116,17 @@ struct pending_startup_id {
 	struct wl_list link;
 };
 
+// A property request, processed once the reply arrives. Replies arrive in
+// request order.
+struct xwm_property_request {
+	struct wlr_xwayland_surface *xsurface; // NULL if destroyed
+	xcb_atom_t property;
+	xcb_get_property_cookie_t cookie;
+	// Last request of the batch sent on association
+	bool associate;
+	struct wl_list link; // wlr_xwm.property_requests
+};
+
 static const struct wlr_addon_interface surface_addon_impl;
 
 struct wlr_xwayland_surface *wlr_xwayland_surface_try_from_wlr_surface(
@@ -122,11 +139,29 @@ struct wlr_xwayland_surface *wlr_xwayland_surface_try_from_wlr_surface(
 	return xsurface;
 }
 
-// TODO: replace this with hash table?
+static uint64_t surface_window_get_key(struct wl_list *link) {
+	struct wlr_xwayland_surface *surface =
+		wl_container_of(link, surface, window_link);
+	return surface->window_id;
+}
+
+static uint64_t surface_id_get_key(struct wl_list *link) {
+	struct wlr_xwayland_surface *surface =
+		wl_container_of(link, surface, surface_id_link);
+	return surface->surface_id;
+}
+
+static uint64_t surface_serial_get_key(struct wl_list *link) {
+	struct wlr_xwayland_surface *surface =
+		wl_container_of(link, surface, serial_link);
+	return surface->serial;
+}
+
 static struct wlr_xwayland_surface *lookup_surface(struct wlr_xwm *xwm,
 		xcb_window_t window_id) {
+	struct wl_list *bucket = list_map_get_bucket(&xwm->surfaces_by_window, window_id);
 	struct wlr_xwayland_surface *surface;
-	wl_list_for_each(surface, &xwm->surfaces, link) {
+	wl_list_for_each(surface, bucket, window_link) {
 		if (surface->window_id == window_id) {
 			return surface;
 		}
@@ -134,6 +169,14 @@ static struct wlr_xwayland_surface *lookup_surface(struct wlr_xwm *xwm,
 	return NULL;
 }
 
+static void xwayland_surface_remove_unpaired(struct wlr_xwayland_surface *xsurface) {
+	struct wlr_xwm *xwm = xsurface->xwm;
+	wl_list_remove(&xsurface->unpaired_link);
+	wl_list_init(&xsurface->unpaired_link);
+	list_map_remove(&xwm->unpaired_by_surface_id, &xsurface->surface_id_link);
+	list_map_remove(&xwm->unpaired_by_serial, &xsurface->serial_link);
+}
+
 static int xwayland_surface_handle_ping_timeout(void *data) {
 	struct wlr_xwayland_surface *surface = data;
 
@@ -209,6 +252,9 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 	wl_list_init(&surface->stack_link);
 	wl_list_init(&surface->parent_link);
 	wl_list_init(&surface->unpaired_link);
+	wl_list_init(&surface->window_link);
+	wl_list_init(&surface->surface_id_link);
+	wl_list_init(&surface->serial_link);
 	wl_signal_init(&surface->events.destroy);
 	wl_signal_init(&surface->events.request_configure);
 	wl_signal_init(&surface->events.request_move);
@@ -261,6 +307,7 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 	}
 
 	wl_list_insert(&xwm->surfaces, &surface->link);
+	list_map_insert(&xwm->surfaces_by_window, &surface->window_link);
 
 	if (xwm->xres) {
 		read_surface_client_id(xwm, surface, client_id_cookie);
@@ -318,7 +365,7 @@ static void xwm_send_wm_message(struct wlr_xwayland_surface *surface,
 	xwm_schedule_flush(xwm);
 }
 
-static void xwm_set_net_client_list(struct wlr_xwm *xwm) {
+static void xwm_send_net_client_list(struct wlr_xwm *xwm) {
 	// FIXME: _NET_CLIENT_LIST is expected to be ordered by map time, but the
 	// order of surfaces in `xwm->surfaces` is by creation time. The order of
 	// windows _NET_CLIENT_LIST exposed by wlroots is wrong.
@@ -352,7 +399,7 @@ static void xwm_set_net_client_list(struct wlr_xwm *xwm) {
 	free(windows);
 }
 
-static void xwm_set_net_client_list_stacking(struct wlr_xwm *xwm) {
+static void xwm_send_net_client_list_stacking(struct wlr_xwm *xwm) {
 	size_t num_surfaces = wl_list_length(&xwm->surfaces_in_stack_order);
 	xcb_window_t *windows = malloc(sizeof(xcb_window_t) * num_surfaces);
 	if (!windows) {
@@ -371,6 +418,47 @@ static void xwm_set_net_client_list_stacking(struct wlr_xwm *xwm) {
 	free(windows);
 }
 
+static void xwm_handle_client_list_idle(void *data) {
+	struct wlr_xwm *xwm = data;
+	xwm->client_list_idle = NULL;
+
+	if (xwm->client_list_dirty) {
+		xwm->client_list_dirty = false;
+		xwm_send_net_client_list(xwm);
+	}
+	if (xwm->client_list_stacking_dirty) {
+		xwm->client_list_stacking_dirty = false;
+		xwm_send_net_client_list_stacking(xwm);
+	}
+	xwm_schedule_flush(xwm);
+}
+
+// The client lists are sent at most once per event loop iteration, windows
+// are often mapped or restacked in batches
+static void xwm_schedule_client_list_update(struct wlr_xwm *xwm) {
+	if (xwm->client_list_idle != NULL) {
+		return;
+	}
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(xwm->xwayland->wl_display);
+	xwm->client_list_idle =
+		wl_event_loop_add_idle(loop, xwm_handle_client_list_idle, xwm);
+	if (xwm->client_list_idle == NULL) {
+		wlr_log(WLR_ERROR, "Failed to schedule client list update");
+		xwm_handle_client_list_idle(xwm);
+	}
+}
+
+static void xwm_set_net_client_list(struct wlr_xwm *xwm) {
+	xwm->client_list_dirty = true;
+	xwm_schedule_client_list_update(xwm);
+}
+
+static void xwm_set_net_client_list_stacking(struct wlr_xwm *xwm) {
+	xwm->client_list_stacking_dirty = true;
+	xwm_schedule_client_list_update(xwm);
+}
+
 static void xsurface_set_net_wm_state(struct wlr_xwayland_surface *xsurface);
 
 // Gives input (keyboard) focus to a window.
@@ -539,10 +627,29 @@ static void xsurface_set_net_wm_state(struct wlr_xwayland_surface *xsurface) {
 		i, property);
 }
 
+static void xwayland_surface_cancel_property_requests(
+		struct wlr_xwayland_surface *xsurface, bool destroyed) {
+	struct xwm_property_request *request;
+	wl_list_for_each(request, &xsurface->xwm->property_requests, link) {
+		if (request->xsurface != xsurface) {
+			continue;
+		}
+		request->associate = false;
+		if (destroyed) {
+			request->xsurface = NULL;
+		}
+	}
+}
+
 static void xwayland_surface_dissociate(struct wlr_xwayland_surface *xsurface) {
 	if (xsurface->surface != NULL) {
 		wlr_surface_unmap(xsurface->surface);
-		wl_signal_emit_mutable(&xsurface->events.dissociate, NULL);
+		if (xsurface->associate_pending) {
+			xsurface->associate_pending = false;
+			xwayland_surface_cancel_property_requests(xsurface, false);
+		} else {
+			wl_signal_emit_mutable(&xsurface->events.dissociate, NULL);
+		}
 
 		wl_list_remove(&xsurface->surface_commit.link);
 		wl_list_remove(&xsurface->surface_map.link);
@@ -554,8 +661,7 @@ static void xwayland_surface_dissociate(struct wlr_xwayland_surface *xsurface) {
 	// Make sure we're not on the unpaired surface list or we
 	// could be assigned a surface during surface creation that
 	// was mapped before this unmap request.
-	wl_list_remove(&xsurface->unpaired_link);
-	wl_list_init(&xsurface->unpaired_link);
+	xwayland_surface_remove_unpaired(xsurface);
 	xsurface->surface_id = 0;
 	xsurface->serial = 0;
 
@@ -566,6 +672,7 @@ static void xwayland_surface_dissociate(struct wlr_xwayland_surface *xsurface) {
 
 static void xwayland_surface_destroy(struct wlr_xwayland_surface *xsurface) {
 	xwayland_surface_dissociate(xsurface);
+	xwayland_surface_cancel_property_requests(xsurface, true);
 
 	wl_signal_emit_mutable(&xsurface->events.destroy, NULL);
 
@@ -577,6 +684,7 @@ static void xwayland_surface_destroy(struct wlr_xwayland_surface *xsurface) {
 	}
 
 	wl_list_remove(&xsurface->link);
+	list_map_remove(&xsurface->xwm->surfaces_by_window, &xsurface->window_link);
 	wl_list_remove(&xsurface->parent_link);
 
 	struct wlr_xwayland_surface *child, *next;
@@ -586,7 +694,7 @@ static void xwayland_surface_destroy(struct wlr_xwayland_surface *xsurface) {
 		child->parent = NULL;
 	}
 
-	wl_list_remove(&xsurface->unpaired_link);
+	xwayland_surface_remove_unpaired(xsurface);
 
 	wl_event_source_remove(xsurface->ping_timer);
 
@@ -983,7 +1091,7 @@ static void read_surface_property(struct wlr_xwm *xwm,
 		read_surface_role(xwm, xsurface, reply);
 	} else if (property == xwm->atoms[NET_STARTUP_ID]) {
 		read_surface_startup_id(xwm, xsurface, reply);
-	} else if (wlr_log_get_verbosity() >= WLR_DEBUG) {
+	} else if (wlr_log_enabled(WLR_DEBUG)) {
 		char *prop_name = xwm_get_atom_name(xwm, property);
 		wlr_log(WLR_DEBUG, "unhandled X11 property %" PRIu32 " (%s) for window %" PRIu32,
 			property, prop_name ? prop_name : "(null)", xsurface->window_id);
@@ -991,8 +1099,90 @@ static void read_surface_property(struct wlr_xwm *xwm,
 	}
 }
 
+static void xwayland_surface_emit_associate(struct wlr_xwayland_surface *xsurface) {
+	xsurface->associate_pending = false;
+	wl_signal_emit_mutable(&xsurface->events.associate, NULL);
+
+	// Commits were ignored until compositors had a chance to listen to the
+	// map event
+	if (xsurface->surface != NULL && wlr_surface_has_buffer(xsurface->surface)) {
+		wlr_surface_map(xsurface->surface);
+	}
+}
+
+static void xwm_handle_property_reply(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *xsurface, xcb_atom_t property,
+		bool associate, xcb_get_property_reply_t *reply) {
+	if (xsurface == NULL) {
+		return;
+	}
+
+	if (reply != NULL) {
+		read_surface_property(xwm, xsurface, property, reply);
+	} else {
+		wlr_log(WLR_ERROR, "Failed to get window property");
+	}
+
+	if (associate && xsurface->associate_pending) {
+		xwayland_surface_emit_associate(xsurface);
+	}
+}
+
+static void xwm_request_property(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *xsurface, xcb_atom_t property,
+		bool associate) {
+	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn, 0,
+		xsurface->window_id, property, XCB_ATOM_ANY, 0, 2048);
+
+	struct xwm_property_request *request = calloc(1, sizeof(*request));
+	if (request == NULL) {
+		// Fall back to waiting for the reply
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		xcb_get_property_reply_t *reply =
+			xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
+		xwm_handle_property_reply(xwm, xsurface, property, associate, reply);
+		free(reply);
+		return;
+	}
+
+	request->xsurface = xsurface;
+	request->property = property;
+	request->cookie = cookie;
+	request->associate = associate;
+	wl_list_insert(xwm->property_requests.prev, &request->link);
+}
+
+// Processes the property replies which have already arrived, without
+// blocking. Returns the number of processed replies.
+static int read_property_replies(struct wlr_xwm *xwm) {
+	int count = 0;
+
+	struct xwm_property_request *request, *tmp;
+	wl_list_for_each_safe(request, tmp, &xwm->property_requests, link) {
+		void *reply = NULL;
+		xcb_generic_error_t *error = NULL;
+		if (!xcb_poll_for_reply(xwm->xcb_conn, request->cookie.sequence,
+				&reply, &error)) {
+			break;
+		}
+		free(error);
+		count++;
+
+		wl_list_remove(&request->link);
+		xwm_handle_property_reply(xwm, request->xsurface, request->property,
+			request->associate, reply);
+		free(reply);
+		free(request);
+	}
+
+	return count;
+}
+
 static void xwayland_surface_handle_commit(struct wl_listener *listener, void *data) {
 	struct wlr_xwayland_surface *xsurface = wl_container_of(listener, xsurface, surface_commit);
+	if (xsurface->associate_pending) {
+		return;
+	}
 	if (wlr_surface_has_buffer(xsurface->surface)) {
 		wlr_surface_map(xsurface->surface);
 	}
@@ -1022,8 +1212,7 @@ static void xwayland_surface_associate(struct wlr_xwm *xwm,
 		struct wlr_xwayland_surface *xsurface, struct wlr_surface *surface) {
 	assert(xsurface->surface == NULL);
 
-	wl_list_remove(&xsurface->unpaired_link);
-	wl_list_init(&xsurface->unpaired_link);
+	xwayland_surface_remove_unpaired(xsurface);
 	xsurface->surface_id = 0;
 
 	xsurface->surface = surface;
@@ -1038,7 +1227,8 @@ static void xwayland_surface_associate(struct wlr_xwm *xwm,
 	xsurface->surface_unmap.notify = xwayland_surface_handle_unmap;
 	wl_signal_add(&surface->events.unmap, &xsurface->surface_unmap);
 
-	// read all surface properties
+	// Read all surface properties. The associate event is emitted once the
+	// last reply has arrived, without blocking on the X server.
 	const xcb_atom_t props[] = {
 		XCB_ATOM_WM_CLASS,
 		XCB_ATOM_WM_NAME,
@@ -1054,24 +1244,12 @@ static void xwayland_surface_associate(struct wlr_xwm *xwm,
 		xwm->atoms[NET_WM_NAME],
 	};
 
-	xcb_get_property_cookie_t cookies[sizeof(props) / sizeof(props[0])] = {0};
-	for (size_t i = 0; i < sizeof(props) / sizeof(props[0]); i++) {
-		cookies[i] = xcb_get_property(xwm->xcb_conn, 0, xsurface->window_id,
-			props[i], XCB_ATOM_ANY, 0, 2048);
+	size_t props_len = sizeof(props) / sizeof(props[0]);
+	xsurface->associate_pending = true;
+	for (size_t i = 0; i < props_len; i++) {
+		xwm_request_property(xwm, xsurface, props[i], i == props_len - 1);
 	}
-
-	for (size_t i = 0; i < sizeof(props) / sizeof(props[0]); i++) {
-		xcb_get_property_reply_t *reply =
-			xcb_get_property_reply(xwm->xcb_conn, cookies[i], NULL);
-		if (reply == NULL) {
-			wlr_log(WLR_ERROR, "Failed to get window property");
-			continue;
-		}
-		read_surface_property(xwm, xsurface, props[i], reply);
-		free(reply);
-	}
-
-	wl_signal_emit_mutable(&xsurface->events.associate, NULL);
+	xwm_schedule_flush(xwm);
 }
 
 static void xwm_handle_create_notify(struct wlr_xwm *xwm,
@@ -1208,13 +1386,18 @@ void wlr_xwayland_surface_restack(struct wlr_xwayland_surface *xsurface,
 		return;
 	}
 
-	if (sibling != NULL) {
-		values[idx++] = sibling->window_id;
-		flags |= XCB_CONFIG_WINDOW_SIBLING;
-	}
-	values[idx++] = mode;
+	if (xwm->configure_batch) {
+		// The final position in the stack is sent on commit
+		xsurface->batch_restack = true;
+	} else {
+		if (sibling != NULL) {
+			values[idx++] = sibling->window_id;
+			flags |= XCB_CONFIG_WINDOW_SIBLING;
+		}
+		values[idx++] = mode;
 
-	xcb_configure_window(xwm->xcb_conn, xsurface->window_id, flags, values);
+		xcb_configure_window(xwm->xcb_conn, xsurface->window_id, flags, values);
+	}
 
 	wl_list_remove(&xsurface->stack_link);
 
@@ -1235,7 +1418,9 @@ void wlr_xwayland_surface_restack(struct wlr_xwayland_surface *xsurface,
 
 	wl_list_insert(node, &xsurface->stack_link);
 	xwm_set_net_client_list_stacking(xwm);
-	xwm_schedule_flush(xwm);
+	if (!xwm->configure_batch) {
+		xwm_schedule_flush(xwm);
+	}
 }
 
 static void xwm_handle_map_request(struct wlr_xwm *xwm,
@@ -1285,17 +1470,7 @@ static void xwm_handle_property_notify(struct wlr_xwm *xwm,
 		return;
 	}
 
-	xcb_get_property_cookie_t cookie =
-		xcb_get_property(xwm->xcb_conn, 0, xsurface->window_id, ev->atom, XCB_ATOM_ANY, 0, 2048);
-	xcb_get_property_reply_t *reply =
-		xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
-	if (reply == NULL) {
-		wlr_log(WLR_ERROR, "Failed to get window property");
-		return;
-	}
-
-	read_surface_property(xwm, xsurface, ev->atom, reply);
-	free(reply);
+	xwm_request_property(xwm, xsurface, ev->atom, false);
 }
 
 static void xwm_handle_surface_id_message(struct wlr_xwm *xwm,
@@ -1315,7 +1490,9 @@ static void xwm_handle_surface_id_message(struct wlr_xwm *xwm,
 		struct wlr_surface *surface = wlr_surface_from_resource(resource);
 		xwayland_surface_associate(xwm, xsurface, surface);
 	} else {
+		list_map_remove(&xwm->unpaired_by_surface_id, &xsurface->surface_id_link);
 		xsurface->surface_id = id;
+		list_map_insert(&xwm->unpaired_by_surface_id, &xsurface->surface_id_link);
 		wl_list_remove(&xsurface->unpaired_link);
 		wl_list_insert(&xwm->unpaired_surfaces, &xsurface->unpaired_link);
 	}
@@ -1345,6 +1522,7 @@ static void xwm_handle_surface_serial_message(struct wlr_xwm *xwm,
 	if (surface != NULL) {
 		xwayland_surface_associate(xwm, xsurface, surface);
 	} else {
+		list_map_insert(&xwm->unpaired_by_serial, &xsurface->serial_link);
 		wl_list_remove(&xsurface->unpaired_link);
 		wl_list_insert(&xwm->unpaired_surfaces, &xsurface->unpaired_link);
 	}
@@ -1497,7 +1675,7 @@ static void xwm_handle_net_wm_state_message(struct wlr_xwm *xwm,
 			changed = update_state(action, &xsurface->below);
 		} else if (property == xwm->atoms[NET_WM_STATE_DEMANDS_ATTENTION]) {
 			changed = update_state(action, &xsurface->demands_attention);
-		} else if (property != XCB_ATOM_NONE && wlr_log_get_verbosity() >= WLR_DEBUG) {
+		} else if (property != XCB_ATOM_NONE && wlr_log_enabled(WLR_DEBUG)) {
 			char *prop_name = xwm_get_atom_name(xwm, property);
 			wlr_log(WLR_DEBUG, "Unhandled NET_WM_STATE property change "
 				"%"PRIu32" (%s)", property, prop_name ? prop_name : "(null)");
@@ -1575,7 +1753,7 @@ static void xwm_handle_wm_protocols_message(struct wlr_xwm *xwm,
 
 		wl_event_source_timer_update(surface->ping_timer, 0);
 		surface->pinging = false;
-	} else if (wlr_log_get_verbosity() >= WLR_DEBUG) {
+	} else if (wlr_log_enabled(WLR_DEBUG)) {
 		char *type_name = xwm_get_atom_name(xwm, type);
 		wlr_log(WLR_DEBUG, "unhandled WM_PROTOCOLS client message %" PRIu32 " (%s)",
 			type, type_name ? type_name : "(null)");
@@ -1716,7 +1894,7 @@ static void xwm_handle_client_message(struct wlr_xwm *xwm,
 	} else if (ev->type == xwm->atoms[WM_CHANGE_STATE]) {
 		xwm_handle_wm_change_state_message(xwm, ev);
 	} else if (!xwm_handle_selection_client_message(xwm, ev) &&
-			wlr_log_get_verbosity() >= WLR_DEBUG) {
+			wlr_log_enabled(WLR_DEBUG)) {
 		char *type_name = xwm_get_atom_name(xwm, ev->type);
 		wlr_log(WLR_DEBUG, "unhandled x11 client message %" PRIu32 " (%s)", ev->type,
 			type_name ? type_name : "(null)");
@@ -1908,7 +2086,12 @@ static int x11_event_handler(int fd, uint32_t mask, void *data) {
 
 	int count = 0;
 	if (mask & WL_EVENT_READABLE) {
-		count = read_x11_events(xwm);
+		// Handling events or replies may read more of them from the socket
+		int n;
+		do {
+			n = read_x11_events(xwm) + read_property_replies(xwm);
+			count += n;
+		} while (n > 0);
 		if (count) {
 			xwm_schedule_flush(xwm);
 		}
@@ -1916,8 +2099,23 @@ static int x11_event_handler(int fd, uint32_t mask, void *data) {
 
 	if (mask & WL_EVENT_WRITABLE) {
 		// xcb_flush() always blocks until it's written all pending requests,
-		// but it's the only thing we have
+		// but it's the only thing we have: xcb has no non-blocking write path,
+		// and xcb_take_socket() would require marshalling requests ourselves.
+		// At least make stalls visible.
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
 		xcb_flush(xwm->xcb_conn);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		struct timespec duration;
+		timespec_sub(&duration, &end, &start);
+		int64_t duration_nsec = timespec_to_nsec(&duration);
+		if (duration_nsec >= XWM_FLUSH_STALL_NSEC) {
+			xwm->flush_stalls++;
+			wlr_log(WLR_DEBUG, "Flushing the X11 connection blocked for %.1fms "
+				"(%zu stalls so far)", duration_nsec / 1e6, xwm->flush_stalls);
+		}
+
 		wl_event_source_fd_update(xwm->event_source, WL_EVENT_READABLE);
 	}
 
@@ -1938,8 +2136,10 @@ static void handle_compositor_new_surface(struct wl_listener *listener,
 	wlr_log(WLR_DEBUG, "New xwayland surface: %p", surface);
 
 	uint32_t surface_id = wl_resource_get_id(surface->resource);
+	struct wl_list *bucket =
+		list_map_get_bucket(&xwm->unpaired_by_surface_id, surface_id);
 	struct wlr_xwayland_surface *xsurface;
-	wl_list_for_each(xsurface, &xwm->unpaired_surfaces, unpaired_link) {
+	wl_list_for_each(xsurface, bucket, surface_id_link) {
 		if (xsurface->surface_id == surface_id) {
 			xwayland_surface_associate(xwm, xsurface, surface);
 			xwm_schedule_flush(xwm);
@@ -1963,8 +2163,10 @@ static void handle_shell_v1_new_surface(struct wl_listener *listener,
 	struct wlr_xwm *xwm = wl_container_of(listener, xwm, shell_v1_new_surface);
 	struct wlr_xwayland_surface_v1 *shell_surface = data;
 
+	struct wl_list *bucket =
+		list_map_get_bucket(&xwm->unpaired_by_serial, shell_surface->serial);
 	struct wlr_xwayland_surface *xsurface;
-	wl_list_for_each(xsurface, &xwm->unpaired_surfaces, unpaired_link) {
+	wl_list_for_each(xsurface, bucket, serial_link) {
 		if (xsurface->serial == shell_surface->serial) {
 			xwayland_surface_associate(xwm, xsurface, shell_surface->surface);
 			return;
@@ -1992,6 +2194,35 @@ void wlr_xwayland_surface_activate(struct wlr_xwayland_surface *xsurface,
 	}
 }
 
+/**
+ * If the window size did not change, then we cannot rely on the X server to
+ * generate a ConfigureNotify event. Instead, we are supposed to send a
+ * synthetic event. See ICCCM part 4.1.5. But we ignore override-redirect
+ * windows as ICCCM does not apply to them.
+ */
+static void xsurface_send_configure_notify(struct wlr_xwayland_surface *xsurface,
+		int old_width, int old_height) {
+	if (xsurface->width != old_width || xsurface->height != old_height ||
+			xsurface->override_redirect) {
+		return;
+	}
+
+	xcb_configure_notify_event_t configure_notify = {
+		.response_type = XCB_CONFIGURE_NOTIFY,
+		.event = xsurface->window_id,
+		.window = xsurface->window_id,
+		.x = xsurface->x,
+		.y = xsurface->y,
+		.width = xsurface->width,
+		.height = xsurface->height,
+	};
+
+	xwm_send_event_with_size(xsurface->xwm->xcb_conn, 0, xsurface->window_id,
+		XCB_EVENT_MASK_STRUCTURE_NOTIFY,
+		&configure_notify,
+		sizeof(configure_notify));
+}
+
 void wlr_xwayland_surface_configure(struct wlr_xwayland_surface *xsurface,
 		int16_t x, int16_t y, uint16_t width, uint16_t height) {
 	int old_w = xsurface->width;
@@ -2003,32 +2234,90 @@ void wlr_xwayland_surface_configure(struct wlr_xwayland_surface *xsurface,
 	xsurface->height = height;
 
 	struct wlr_xwm *xwm = xsurface->xwm;
+	if (xwm->configure_batch) {
+		if (!xsurface->batch_configure) {
+			xsurface->batch_configure = true;
+			xsurface->batch_old_width = old_w;
+			xsurface->batch_old_height = old_h;
+		}
+		return;
+	}
+
 	uint32_t mask = XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
 		XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT |
 		XCB_CONFIG_WINDOW_BORDER_WIDTH;
 	uint32_t values[] = {x, y, width, height, 0};
 	xcb_configure_window(xwm->xcb_conn, xsurface->window_id, mask, values);
 
-	// If the window size did not change, then we cannot rely on
-	// the X server to generate a ConfigureNotify event. Instead,
-	// we are supposed to send a synthetic event. See ICCCM part
-	// 4.1.5. But we ignore override-redirect windows as ICCCM does
-	// not apply to them.
-	if (width == old_w && height == old_h && !xsurface->override_redirect) {
-		xcb_configure_notify_event_t configure_notify = {
-			.response_type = XCB_CONFIGURE_NOTIFY,
-			.event = xsurface->window_id,
-			.window = xsurface->window_id,
-			.x = x,
-			.y = y,
-			.width = width,
-			.height = height,
-		};
+	xsurface_send_configure_notify(xsurface, old_w, old_h);
+
+	xwm_schedule_flush(xwm);
+}
+
+void xwm_begin_configure_batch(struct wlr_xwm *xwm) {
+	xwm->configure_batch = true;
+}
+
+// Restacked surfaces are placed right above the surface below them
+static void xsurface_send_batch(struct wlr_xwayland_surface *xsurface,
+		struct wlr_xwayland_surface *below) {
+	uint32_t mask = 0;
+	uint32_t values[7];
+	size_t idx = 0;
+
+	if (xsurface->batch_configure) {
+		mask |= XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+			XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT |
+			XCB_CONFIG_WINDOW_BORDER_WIDTH;
+		values[idx++] = (uint32_t)xsurface->x;
+		values[idx++] = (uint32_t)xsurface->y;
+		values[idx++] = xsurface->width;
+		values[idx++] = xsurface->height;
+		values[idx++] = 0;
+	}
+	if (xsurface->batch_restack) {
+		mask |= XCB_CONFIG_WINDOW_STACK_MODE;
+		if (below != NULL) {
+			mask |= XCB_CONFIG_WINDOW_SIBLING;
+			values[idx++] = below->window_id;
+			values[idx++] = XCB_STACK_MODE_ABOVE;
+		} else {
+			values[idx++] = XCB_STACK_MODE_BELOW;
+		}
+	}
+
+	xcb_configure_window(xsurface->xwm->xcb_conn, xsurface->window_id, mask, values);
+
+	if (xsurface->batch_configure) {
+		xsurface_send_configure_notify(xsurface,
+			xsurface->batch_old_width, xsurface->batch_old_height);
+	}
+
+	xsurface->batch_configure = false;
+	xsurface->batch_restack = false;
+}
+
+void xwm_commit_configure_batch(struct wlr_xwm *xwm) {
+	if (!xwm->configure_batch) {
+		return;
+	}
+	xwm->configure_batch = false;
+
+	// Going from bottom to top, each restacked surface ends up in its final
+	// position once placed above the one below it
+	struct wlr_xwayland_surface *xsurface, *below = NULL;
+	wl_list_for_each(xsurface, &xwm->surfaces_in_stack_order, stack_link) {
+		if (xsurface->batch_configure || xsurface->batch_restack) {
+			xsurface_send_batch(xsurface, below);
+		}
+		below = xsurface;
+	}
 
-		xwm_send_event_with_size(xwm->xcb_conn, 0, xsurface->window_id,
-			XCB_EVENT_MASK_STRUCTURE_NOTIFY,
-			&configure_notify,
-			sizeof(configure_notify));
+	// Surfaces which aren't part of the stack
+	wl_list_for_each(xsurface, &xwm->surfaces, link) {
+		if (xsurface->batch_configure || xsurface->batch_restack) {
+			xsurface_send_batch(xsurface, NULL);
+		}
 	}
 
 	xwm_schedule_flush(xwm);
@@ -2119,6 +2408,20 @@ void xwm_destroy(struct wlr_xwm *xwm) {
 		pending_startup_id_destroy(pending);
 	}
 
+	if (xwm->client_list_idle != NULL) {
+		wl_event_source_remove(xwm->client_list_idle);
+	}
+
+	struct xwm_property_request *request, *request_tmp;
+	wl_list_for_each_safe(request, request_tmp, &xwm->property_requests, link) {
+		wl_list_remove(&request->link);
+		free(request);
+	}
+
+	list_map_finish(&xwm->surfaces_by_window);
+	list_map_finish(&xwm->unpaired_by_surface_id);
+	list_map_finish(&xwm->unpaired_by_serial);
+
 	xwm->xwayland->xwm = NULL;
 	free(xwm);
 }
@@ -2361,10 +2664,21 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *xwayland, int wm_fd) {
 	wl_list_init(&xwm->surfaces_in_stack_order);
 	wl_list_init(&xwm->unpaired_surfaces);
 	wl_list_init(&xwm->pending_startup_ids);
+	wl_list_init(&xwm->property_requests);
 	wl_list_init(&xwm->seat_drag_source_destroy.link);
 	wl_list_init(&xwm->drag_focus_destroy.link);
 	wl_list_init(&xwm->drop_focus_destroy.link);
 
+	if (!list_map_init(&xwm->surfaces_by_window, surface_window_get_key)) {
+		goto error_xwm;
+	}
+	if (!list_map_init(&xwm->unpaired_by_surface_id, surface_id_get_key)) {
+		goto error_surfaces_by_window;
+	}
+	if (!list_map_init(&xwm->unpaired_by_serial, surface_serial_get_key)) {
+		goto error_unpaired_by_surface_id;
+	}
+
 	xwm->ping_timeout = 10000;
 
 	xwm->xcb_conn = xcb_connect_to_fd(wm_fd, NULL);
@@ -2372,8 +2686,7 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *xwayland, int wm_fd) {
 	int rc = xcb_connection_has_error(xwm->xcb_conn);
 	if (rc) {
 		wlr_log(WLR_ERROR, "xcb connect failed: %d", rc);
-		free(xwm);
-		return NULL;
+		goto error_unpaired_by_serial;
 	}
 
 #if HAVE_XCB_ERRORS
@@ -2477,6 +2790,16 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *xwayland, int wm_fd) {
 	xcb_flush(xwm->xcb_conn);
 
 	return xwm;
+
+error_unpaired_by_serial:
+	list_map_finish(&xwm->unpaired_by_serial);
+error_unpaired_by_surface_id:
+	list_map_finish(&xwm->unpaired_by_surface_id);
+error_surfaces_by_window:
+	list_map_finish(&xwm->surfaces_by_window);
+error_xwm:
+	free(xwm);
+	return NULL;
 }
 
 void wlr_xwayland_surface_set_withdrawn(struct wlr_xwayland_surface *surface,